@@ -1,5 +1,10 @@
-#include <chrono>
+#include <cstdlib>
+
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <gflags/gflags.h>
@@ -10,54 +15,259 @@
 template <typename T>
 using vector = std::vector<T, tapa::aligned_allocator<T>>;
 
-void Bandwidth(tapa::mmaps<Elem, kBankCount> chan, uint64_t n, uint64_t flags);
+void Bandwidth(tapa::mmaps<Elem, kBankCount> chan, uint64_t n, uint64_t flags,
+               uint64_t stride, uint64_t window, uint64_t num_banks,
+               uint64_t max_outstanding);
 
 DEFINE_string(bitstream, "", "path to bitstream file, run csim if empty");
+DEFINE_uint64(stride, 1, "elements between consecutive sequential accesses");
+DEFINE_uint64(window, 0,
+              "power-of-2 number of elements that random accesses are "
+              "confined to; 0 for the number of accesses");
+DEFINE_uint64(banks, kBankCount, "number of banks accessed");
+DEFINE_uint64(max_outstanding, 0,
+              "maximum number of reads and writes each in flight per bank; "
+              "0 for unlimited");
 
-int main(int argc, char* argv[]) {
-  gflags::ParseCommandLineFlags(&argc, &argv, true);
+DEFINE_bool(sweep, false,
+            "measure every combination of the comma-separated --sweep_* lists "
+            "instead of a single configuration");
+DEFINE_string(sweep_n, "65536", "numbers of accesses per bank to sweep");
+DEFINE_string(sweep_flags, "2,4,6,3,5,7",
+              "access flags to sweep; see the second positional argument");
+DEFINE_string(sweep_stride, "1", "strides to sweep");
+DEFINE_string(sweep_window, "0", "random windows to sweep");
+DEFINE_string(sweep_banks, "1,2,4", "numbers of banks to sweep");
+DEFINE_string(sweep_max_outstanding, "0",
+              "limits of outstanding requests to sweep");
+DEFINE_string(sweep_burst_len, "0",
+              "maximum burst lengths to sweep in software simulation, which "
+              "are modeled by tapa::memory_model::ddr(); 0 for the default. "
+              "The burst length of a bitstream is fixed when it is built");
+DEFINE_string(sweep_output, "",
+              "file to write the bandwidth matrix to, as JSON if it ends with "
+              "'.json' or CSV otherwise; stdout (CSV) if empty");
+
+namespace {
+
+struct Config {
+  uint64_t n;
+  uint64_t flags;
+  uint64_t stride;
+  uint64_t window;
+  uint64_t banks;
+  uint64_t max_outstanding;
+  uint64_t burst_len;  // only used with a memory model
+};
+
+struct Result {
+  Config config;
+  uint64_t bytes;              // transferred between the kernel and memory
+  double kernel_seconds;       // wall time in software simulation
+  uint64_t simulated_cycles;   // 0 without a memory model
+  int64_t num_errors;          // -1 if not verified
+};
 
-  const uint64_t n = argc > 1 ? atoll(argv[1]) : 1024 * 1024;
-  const uint64_t flags = argc > 2 ? atoll(argv[2]) : 6LL;
+bool IsValid(const Config& config) {
+  if (config.stride == 0) {
+    LOG(ERROR) << "stride must be positive";
+  } else if (config.window != 0 &&
+             ((config.window & (config.window - 1)) != 0 ||
+              config.window > kMaxWindow)) {
+    LOG(ERROR) << "window must be 0 or a power of 2 up to " << kMaxWindow;
+  } else if (config.banks == 0 || config.banks > kBankCount) {
+    LOG(ERROR) << "number of banks must be in [1, " << kBankCount << "]";
+  } else if (config.burst_len > 256) {
+    LOG(ERROR) << "burst length must be at most 256";
+  } else {
+    return true;
+  }
+  return false;
+}
 
+Result Run(const Config& config, bool use_memory_model) {
+  // Each bank holds every element that may be accessed.
+  const uint64_t size = std::max(config.n * config.stride, config.window);
   vector<float> chan[kBankCount];
   for (int64_t i = 0; i < kBankCount; ++i) {
-    chan[i].resize(n * Elem::length);
-    for (int64_t j = 0; j < n * Elem::length; ++j) {
+    chan[i].resize(size * Elem::length);
+    for (int64_t j = 0; j < size * Elem::length; ++j) {
       chan[i][j] = i ^ j;
     }
   }
 
-  tapa::invoke(Bandwidth, FLAGS_bitstream,
-               tapa::read_write_mmaps<float, kBankCount>(chan)
-                   .vectorized<Elem::length>(),
-               n, flags);
+  auto mmaps = tapa::read_write_mmaps<float, kBankCount>(chan)
+                   .vectorized<Elem::length>();
+  if (use_memory_model) {
+    auto model = tapa::memory_model::ddr();
+    model.max_burst_len = config.burst_len;
+    for (int i = 0; i < kBankCount; ++i) {
+      mmaps[i].set_memory_model(model);
+    }
+  }
+  const auto profile = tapa::invoke_with_profile(
+      Bandwidth, FLAGS_bitstream, mmaps, config.n, config.flags, config.stride,
+      config.window, config.banks, config.max_outstanding);
+
+  Result result = {config};
+  const int directions =
+      bool(config.flags & kRead) + bool(config.flags & kWrite);
+  result.bytes = config.banks * config.n * sizeof(Elem) * directions;
+  result.kernel_seconds = profile.times.compute_ns * 1e-9;
+  result.simulated_cycles =
+      use_memory_model && FLAGS_bitstream.empty() ? tapa::simulated_cycles() : 0;
+  result.num_errors = -1;
 
-  if (!((flags & kRead) && (flags & kWrite))) return 0;
+  // A copy writes what it reads back to the same address.
+  if (!((config.flags & kRead) && (config.flags & kWrite))) return result;
 
-  int64_t num_errors = 0;
+  result.num_errors = 0;
   const int64_t threshold = 10;  // only report up to these errors
   for (int64_t i = 0; i < kBankCount; ++i) {
-    for (int64_t j = 0; j < n * Elem::length; ++j) {
+    for (int64_t j = 0; j < size * Elem::length; ++j) {
       int64_t expected = i ^ j;
       int64_t actual = chan[i][j];
       if (actual != expected) {
-        if (num_errors < threshold) {
+        if (result.num_errors < threshold) {
           LOG(ERROR) << "expected: " << expected << ", actual: " << actual;
-        } else if (num_errors == threshold) {
+        } else if (result.num_errors == threshold) {
           LOG(ERROR) << "...";
         }
-        ++num_errors;
+        ++result.num_errors;
       }
     }
   }
-  if (num_errors == 0) {
-    LOG(INFO) << "PASS!";
+  if (result.num_errors > threshold) {
+    LOG(WARNING) << " (+" << (result.num_errors - threshold)
+                 << " more errors)";
+  }
+  return result;
+}
+
+std::vector<uint64_t> ParseList(const std::string& list) {
+  std::vector<uint64_t> values;
+  std::istringstream is(list);
+  for (std::string value; std::getline(is, value, ',');) {
+    values.push_back(strtoull(value.c_str(), nullptr, 0));
+  }
+  return values;
+}
+
+// Bandwidth in GB/s, i.e., bytes per nanosecond.
+double GetGbps(const Result& result) {
+  return result.kernel_seconds > 0 ? result.bytes / result.kernel_seconds * 1e-9
+                                   : 0;
+}
+
+void WriteCsv(std::ostream& os, const std::vector<Result>& results) {
+  os << "n,flags,stride,window,banks,max_outstanding,burst_len,bytes,"
+        "kernel_seconds,gbps,simulated_cycles,num_errors\n";
+  for (const auto& result : results) {
+    const auto& config = result.config;
+    os << config.n << "," << config.flags << "," << config.stride << ","
+       << config.window << "," << config.banks << ","
+       << config.max_outstanding << "," << config.burst_len << ","
+       << result.bytes << "," << result.kernel_seconds << ","
+       << GetGbps(result) << "," << result.simulated_cycles << ","
+       << result.num_errors << "\n";
+  }
+}
+
+void WriteJson(std::ostream& os, const std::vector<Result>& results) {
+  os << "[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto& result = results[i];
+    const auto& config = result.config;
+    os << (i == 0 ? "\n" : ",\n") << "  {\"n\": " << config.n
+       << ", \"flags\": " << config.flags << ", \"stride\": " << config.stride
+       << ", \"window\": " << config.window << ", \"banks\": " << config.banks
+       << ", \"max_outstanding\": " << config.max_outstanding
+       << ", \"burst_len\": " << config.burst_len
+       << ", \"bytes\": " << result.bytes
+       << ", \"kernel_seconds\": " << result.kernel_seconds
+       << ", \"gbps\": " << GetGbps(result)
+       << ", \"simulated_cycles\": " << result.simulated_cycles
+       << ", \"num_errors\": " << result.num_errors << "}";
+  }
+  os << "\n]\n";
+}
+
+int Sweep() {
+  std::vector<Result> results;
+  int64_t num_failures = 0;
+  for (uint64_t n : ParseList(FLAGS_sweep_n)) {
+    for (uint64_t flags : ParseList(FLAGS_sweep_flags)) {
+      for (uint64_t stride : ParseList(FLAGS_sweep_stride)) {
+        for (uint64_t window : ParseList(FLAGS_sweep_window)) {
+          for (uint64_t banks : ParseList(FLAGS_sweep_banks)) {
+            for (uint64_t max_outstanding :
+                 ParseList(FLAGS_sweep_max_outstanding)) {
+              for (uint64_t burst_len : ParseList(FLAGS_sweep_burst_len)) {
+                const Config config = {n,     flags,           stride,
+                                       window, banks, max_outstanding,
+                                       burst_len};
+                if (!IsValid(config)) return 1;
+                results.push_back(Run(config, /*use_memory_model=*/true));
+                LOG(INFO) << "n=" << n << " flags=" << flags
+                          << " stride=" << stride << " window=" << window
+                          << " banks=" << banks
+                          << " max_outstanding=" << max_outstanding
+                          << " burst_len=" << burst_len << ": "
+                          << GetGbps(results.back()) << " GB/s";
+                if (results.back().num_errors > 0) ++num_failures;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  const auto& path = FLAGS_sweep_output;
+  const bool is_json =
+      path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+  if (path.empty()) {
+    WriteCsv(std::cout, results);
   } else {
-    if (num_errors > threshold) {
-      LOG(WARNING) << " (+" << (num_errors - threshold) << " more errors)";
+    std::ofstream os(path);
+    is_json ? WriteJson(os, results) : WriteCsv(os, results);
+    if (!os) {
+      LOG(ERROR) << "failed to write " << path;
+      return 1;
     }
+  }
+  return num_failures > 0 ? 1 : 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_sweep) return Sweep();
+
+  const Config config = {
+      /*n=*/argc > 1 ? uint64_t(atoll(argv[1])) : 1024 * 1024,
+      /*flags=*/argc > 2 ? uint64_t(atoll(argv[2])) : 6ULL,
+      FLAGS_stride,
+      FLAGS_window,
+      FLAGS_banks,
+      FLAGS_max_outstanding,
+      /*burst_len=*/0,
+  };
+  if (!IsValid(config)) return 1;
+
+  const Result result = Run(config, /*use_memory_model=*/false);
+  if (!FLAGS_bitstream.empty()) {
+    LOG(INFO) << "kernel time: " << result.kernel_seconds
+              << " s, bandwidth: " << GetGbps(result) << " GB/s";
+  }
+
+  if (result.num_errors < 0) return 0;
+  if (result.num_errors == 0) {
+    LOG(INFO) << "PASS!";
+  } else {
     LOG(INFO) << "FAIL!";
   }
-  return num_errors > 0 ? 1 : 0;
+  return result.num_errors > 0 ? 1 : 0;
 }
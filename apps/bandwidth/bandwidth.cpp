@@ -6,17 +6,25 @@
 #include "bandwidth.h"
 #include "lfsr.h"
 
-void Copy(tapa::async_mmap<Elem>& mem, uint64_t n, uint64_t flags) {
+// Accesses n elements of bank `index` if it is one of the first `num_banks`.
+// Sequential accesses are `stride` elements apart. Random accesses are confined
+// to the largest power of 2 not exceeding `window`, or n if `window` is 0. At
+// most `max_outstanding` reads and writes each are in flight, or unlimited if
+// it is 0.
+void Copy(int index, tapa::async_mmap<Elem>& mem, uint64_t n, uint64_t flags,
+          uint64_t stride, uint64_t window, uint64_t num_banks,
+          uint64_t max_outstanding) {
   const bool random = flags & kRandom;
   const bool read = flags & kRead;
   const bool write = flags & kWrite;
 
-  if (!read && !write) return;
+  if (uint64_t(index) >= num_banks || (!read && !write)) return;
 
+  const uint64_t range = window != 0 ? window : n;
   uint16_t mask = 0xffffu;
   for (int i = 16; i > 0; --i) {
 #pragma HLS unroll
-    if (n < (1ULL << i)) {
+    if (range < (1ULL << i)) {
       mask >>= 1;
     }
   }
@@ -26,16 +34,23 @@ void Copy(tapa::async_mmap<Elem>& mem, uint64_t n, uint64_t flags) {
   Elem elem;
 
   [[tapa::pipeline(1)]]  //
-  for (uint64_t i_rd_req = 0, i_rd_resp = 0, i_wr_req = 0, i_wr_resp = 0;
+  for (uint64_t i_rd_req = 0, i_rd_resp = 0, i_wr_req = 0, i_wr_resp = 0,
+                seq_rd_addr = 0, seq_wr_addr = 0;
        write ? (i_wr_resp < n) : (i_rd_resp < n);) {
     bool can_read = !mem.read_data.empty();
-    bool can_write = !mem.write_addr.full() && !mem.write_data.full();
-    int64_t read_addr = random ? uint64_t(lfsr_rd & mask) : i_rd_req;
-    int64_t write_addr = random ? uint64_t(lfsr_wr & mask) : i_wr_req;
+    bool can_write = !mem.write_addr.full() && !mem.write_data.full() &&
+                     (max_outstanding == 0 ||
+                      i_wr_req - i_wr_resp < max_outstanding);
+    bool can_read_req = max_outstanding == 0 ||
+                        i_rd_req - i_rd_resp < max_outstanding;
+    int64_t read_addr = random ? uint64_t(lfsr_rd & mask) : seq_rd_addr;
+    int64_t write_addr = random ? uint64_t(lfsr_wr & mask) : seq_wr_addr;
 
-    if (read && i_rd_req < n && mem.read_addr.try_write(read_addr)) {
+    if (read && i_rd_req < n && can_read_req &&
+        mem.read_addr.try_write(read_addr)) {
       ++i_rd_req;
       ++lfsr_rd;
+      seq_rd_addr += stride;
       VLOG(3) << "RD REQ [" << std::setw(5) << read_addr << "]";
     }
 
@@ -50,6 +65,7 @@ void Copy(tapa::async_mmap<Elem>& mem, uint64_t n, uint64_t flags) {
       mem.write_data.write(elem);
       ++i_wr_req;
       ++lfsr_wr;
+      seq_wr_addr += stride;
       VLOG(3) << "WR REQ [" << std::setw(5) << write_addr << "]";
     }
 
@@ -60,6 +76,10 @@ void Copy(tapa::async_mmap<Elem>& mem, uint64_t n, uint64_t flags) {
   }
 }
 
-void Bandwidth(tapa::mmaps<Elem, kBankCount> chan, uint64_t n, uint64_t flags) {
-  tapa::task().invoke<tapa::join, kBankCount>(Copy, chan, n, flags);
+void Bandwidth(tapa::mmaps<Elem, kBankCount> chan, uint64_t n, uint64_t flags,
+               uint64_t stride, uint64_t window, uint64_t num_banks,
+               uint64_t max_outstanding) {
+  tapa::task().invoke<tapa::join, kBankCount>(Copy, tapa::seq(), chan, n, flags,
+                                              stride, window, num_banks,
+                                              max_outstanding);
 }
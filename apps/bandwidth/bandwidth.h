@@ -6,3 +6,7 @@ constexpr int kBankCount = 4;
 constexpr uint64_t kRandom = 1 << 0;
 constexpr uint64_t kRead = 1 << 1;
 constexpr uint64_t kWrite = 1 << 2;
+
+// Random addresses are generated by a 16-bit LFSR, so a random window has at
+// most this many elements.
+constexpr uint64_t kMaxWindow = 1 << 16;
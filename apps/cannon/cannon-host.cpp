@@ -1,4 +1,5 @@
 #include <cmath>
+#include <cstdlib>
 
 #include <chrono>
 #include <iostream>
@@ -7,72 +8,82 @@
 
 #include <tapa.h>
 
+#include "cannon.h"
+
 using std::abs;
 using std::clog;
 using std::endl;
-using std::vector;
 using std::chrono::duration;
 using std::chrono::high_resolution_clock;
 
-void Cannon(tapa::mmap<const float> a, tapa::mmap<const float> b,
-            tapa::mmap<float> c, uint64_t n);
+template <typename T>
+using vector = std::vector<T, tapa::aligned_allocator<T>>;
+
+void Cannon(tapa::mmap<const Vec> a, tapa::mmap<const Vec> b,
+            tapa::mmap<Vec> c, uint64_t n);
 
 DEFINE_string(bitstream, "", "path to bitstream file, run csim if empty");
 
+// Returns the offset of element (i, j) of an n x n matrix in the memory layout
+// of the kernel, where block (bi, bj) of each tile is sent to PE (bi, bj).
+uint64_t GetOffset(uint64_t n, uint64_t i, uint64_t j) {
+  const uint64_t tile = i / kTile * (n / kTile) + j / kTile;
+  const uint64_t pe = i % kTile / kBlock * kP + j % kTile / kBlock;
+  return ((tile * kNumPes + pe) * kBlock + i % kBlock) * kBlock + j % kBlock;
+}
+
 int main(int argc, char* argv[]) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
-  const uint64_t n = 64;  // Hardcoded for efficient hardware generation.
-  vector<float> a_vec(n * n);
-  vector<float> b_vec(n * n);
-  vector<float> c_vec(n * n);
-  auto a = reinterpret_cast<float(*)[n]>(a_vec.data());
-  auto b = reinterpret_cast<float(*)[n]>(b_vec.data());
-  auto c = reinterpret_cast<float(*)[n]>(c_vec.data());
+  const uint64_t n = argc > 1 ? atoll(argv[1]) : kTile * 2;
+  if (n == 0 || n % kTile != 0) {
+    clog << "matrix size must be a positive multiple of " << kTile << endl;
+    return 1;
+  }
+  std::vector<float> a(n * n);
+  std::vector<float> b(n * n);
+  std::vector<float> c(n * n);
   for (uint64_t i = 0; i < n; ++i) {
     for (uint64_t j = 0; j < n; ++j) {
       auto shuffle = [](uint64_t x, uint64_t n) -> float {
         return static_cast<float>((n / 2 - x) * (n / 2 - x));
       };
-      a[i][j] = pow(shuffle(i, n), 1.8f) + shuffle(j, n);
-      b[i][j] = pow(shuffle(j, n), 1.2f) + shuffle(i, n);
-      c[i][j] = 0.f;
+      a[i * n + j] = pow(shuffle(i, n), 1.8f) + shuffle(j, n);
+      b[i * n + j] = pow(shuffle(j, n), 1.2f) + shuffle(i, n);
     }
   }
 
   auto start = high_resolution_clock::now();
-  // reshape the matrices into 2x2 blocks (each has size n/2 x n/2)
-  const int p = 2;
+  // reshape the matrices into tiles of kP x kP blocks, skewing the blocks of
+  // each tile so that PE (i, j) starts with the blocks multiplied at step
+  // (i + j) % kP of Cannon's algorithm
   vector<float> a_buf(n * n);
   vector<float> b_buf(n * n);
   vector<float> c_buf(n * n);
-  auto a_block = reinterpret_cast<float(*)[p][n / p][n / p]>(a_buf.data());
-  auto b_block = reinterpret_cast<float(*)[p][n / p][n / p]>(b_buf.data());
-  auto c_block = reinterpret_cast<float(*)[p][n / p][n / p]>(c_buf.data());
-
-  for (uint64_t i = 0; i < p; ++i) {
-    for (uint64_t j = 0; j < p; ++j) {
-      for (uint64_t ii = 0; ii < n / p; ++ii) {
-        for (uint64_t jj = 0; jj < n / p; ++jj) {
-          a_block[i][(i + j) % p][ii][jj] = a[i * n / p + ii][j * n / p + jj];
-          b_block[(i + j) % p][j][ii][jj] = b[i * n / p + ii][j * n / p + jj];
-        }
-      }
+  for (uint64_t i = 0; i < n; ++i) {
+    for (uint64_t j = 0; j < n; ++j) {
+      const uint64_t tile_i = i / kTile * kTile;
+      const uint64_t tile_j = j / kTile * kTile;
+      const uint64_t bi = i % kTile / kBlock;
+      const uint64_t bj = j % kTile / kBlock;
+      const uint64_t skew = (bi + bj) % kP;
+      // PE (bi, bj) receives block (bi, skew) of A and (skew, bj) of B
+      const uint64_t a_j = tile_j + skew * kBlock + j % kBlock;
+      const uint64_t b_i = tile_i + skew * kBlock + i % kBlock;
+      a_buf[GetOffset(n, i, j)] = a[i * n + a_j];
+      b_buf[GetOffset(n, i, j)] = b[b_i * n + j];
     }
   }
 
-  tapa::invoke(Cannon, FLAGS_bitstream,
-               tapa::read_only_mmap<const float>(a_buf),
-               tapa::read_only_mmap<const float>(b_buf),
-               tapa::write_only_mmap<float>(c_buf), n);
+  tapa::invoke(
+      Cannon, FLAGS_bitstream,
+      tapa::read_only_mmap<const float>(a_buf).reinterpret<const Vec>(),
+      tapa::read_only_mmap<const float>(b_buf).reinterpret<const Vec>(),
+      tapa::write_only_mmap<float>(c_buf).vectorized<kLanes>(), n);
 
-  for (uint64_t i = 0; i < p; ++i) {
-    for (uint64_t j = 0; j < p; ++j) {
-      for (uint64_t ii = 0; ii < n / p; ++ii) {
-        for (uint64_t jj = 0; jj < n / p; ++jj) {
-          c[i * n / p + ii][j * n / p + jj] = c_block[i][j][ii][jj];
-        }
-      }
+  for (uint64_t i = 0; i < n; ++i) {
+    for (uint64_t j = 0; j < n; ++j) {
+      c[i * n + j] = c_buf[GetOffset(n, i, j)];
     }
   }
   auto stop = high_resolution_clock::now();
@@ -85,9 +96,9 @@ int main(int argc, char* argv[]) {
     for (uint64_t j = 0; j < n; ++j) {
       auto expected = 0.f;
       for (uint64_t k = 0; k < n; ++k) {
-        expected += a[i][k] * b[k][j];
+        expected += a[i * n + k] * b[k * n + j];
       }
-      auto actual = c[i][j];
+      auto actual = c[i * n + j];
       if (abs(actual - expected) > 1e-4 * abs(expected)) {
         if (num_errors < threshold) {
           clog << "expected: " << expected << ", actual: " << actual << endl;
@@ -1,144 +1,162 @@
 #include <cassert>
-#include <cstring>
+#include <cstdint>
 
 #include <tapa.h>
 
-// p x p PEs
-const int p = 2;
+#include "cannon.h"
 
-// Handles kN x kN matrices maximum.
-const int kN = 64;  // Use fixed value for efficient hardware generation.
+using tapa::istream;
+using tapa::istreams;
+using tapa::join;
+using tapa::mmap;
+using tapa::ostream;
+using tapa::ostreams;
+using tapa::streams;
+using tapa::task;
 
-// Scatter n*n matrix into p*p blocks, each block.
-void Scatter(tapa::mmap<const float> matrix_ptr, tapa::ostream<float>& block_00,
-             tapa::ostream<float>& block_01, tapa::ostream<float>& block_10,
-             tapa::ostream<float>& block_11) {
-  const uint64_t kNumElems = (kN / p) * (kN / p);
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    block_00.write(*matrix_ptr);
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    block_01.write(*matrix_ptr);
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    block_10.write(*matrix_ptr);
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    block_11.write(*matrix_ptr);
-    ++matrix_ptr;
+// An n x n matrix is stored as (n / kTile) x (n / kTile) tiles in row-major
+// order, each of which stores its kP x kP blocks in the row-major order of the
+// PEs that they are sent to, and each block stores its elements in row-major
+// order. The host skews the blocks of a tile as Cannon's algorithm requires,
+// i.e., PE (i, j) receives block (i, (i + j) % kP) of a tile of A and block
+// ((i + j) % kP, j) of a tile of B.
+
+// Sends the blocks of the tiles of A (if !is_b) or B (if is_b) that are
+// multiplied to produce each tile of C.
+void Scatter(mmap<const Vec> matrix, uint64_t n, bool is_b,
+             ostreams<Vec, kNumPes>& block_q) {
+  const uint64_t num_tiles = n / kTile;
+  for (uint64_t i = 0; i < num_tiles; ++i) {
+    for (uint64_t j = 0; j < num_tiles; ++j) {
+      for (uint64_t k = 0; k < num_tiles; ++k) {
+        const uint64_t tile = is_b ? k * num_tiles + j : i * num_tiles + k;
+        for (int pe = 0; pe < kNumPes; ++pe) {
+          [[tapa::pipeline(1)]] for (int e = 0; e < kBlockVecs; ++e) {
+            block_q[pe].write(
+                matrix[(tile * kNumPes + pe) * kBlockVecs + e]);
+          }
+        }
+      }
+    }
   }
 }
 
-void Gather(tapa::mmap<float> matrix_ptr, tapa::istream<float>& block_00,
-            tapa::istream<float>& block_01, tapa::istream<float>& block_10,
-            tapa::istream<float>& block_11) {
-  const uint64_t kNumElems = (kN / p) * (kN / p);
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    *matrix_ptr = block_00.read();
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    *matrix_ptr = block_01.read();
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    *matrix_ptr = block_10.read();
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    *matrix_ptr = block_11.read();
-    ++matrix_ptr;
+// Receives the blocks of each tile of C.
+void Gather(mmap<Vec> matrix, uint64_t n, istreams<Vec, kNumPes>& block_q) {
+  const uint64_t num_tiles = n / kTile;
+  for (uint64_t tile = 0; tile < num_tiles * num_tiles; ++tile) {
+    for (int pe = 0; pe < kNumPes; ++pe) {
+      [[tapa::pipeline(1)]] for (int e = 0; e < kBlockVecs; ++e) {
+        matrix[(tile * kNumPes + pe) * kBlockVecs + e] = block_q[pe].read();
+      }
+    }
   }
 }
 
-// Each PE processes n/p * n/p block of matrix.
-void ProcElem(tapa::istream<float>& a_fifo, tapa::istream<float>& b_fifo,
-              tapa::ostream<float>& c_fifo, tapa::ostream<float>& i_prev,
-              tapa::istream<float>& i_next, tapa::ostream<float>& j_prev,
-              tapa::istream<float>& j_next) {
-  const uint64_t kNumElems = (kN / p) * (kN / p);
-  float a[kN / p * kN / p];
-  float b[kN / p * kN / p];
-  float c[kN / p * kN / p];
-#pragma HLS array_partition variable = a cyclic factor = 32
-#pragma HLS array_partition variable = b block factor = 32
-#pragma HLS array_partition variable = c cyclic factor = 32
-
-  // Initialize local a, b, and c.
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    a[i] = a_fifo.read();
-    b[i] = b_fifo.read();
-    c[i] = 0.f;
-  }
+// Each PE accumulates a kBlock x kBlock block of each tile of C. Blocks of A
+// are shifted to the PE on the left (j_prev) and received from the one on the
+// right (j_next); blocks of B are shifted to the PE above (i_prev) and
+// received from the one below (i_next).
+void ProcElem(uint64_t n, istream<Vec>& a_fifo, istream<Vec>& b_fifo,
+              ostream<Vec>& c_fifo, istream<Vec>& j_next, ostream<Vec>& j_prev,
+              istream<Vec>& i_next, ostream<Vec>& i_prev) {
+  Vec a[kBlockVecs];
+  Vec b[kBlockVecs];
+  Vec c[kBlockVecs];
+#pragma HLS array_partition variable = a cyclic factor = kRowVecs
+#pragma HLS array_partition variable = b block factor = kBlock
+
+  const uint64_t num_tiles = n / kTile;
+  for (uint64_t tile = 0; tile < num_tiles * num_tiles; ++tile) {
+    for (int i = 0; i < kBlockVecs; ++i) {
+      c[i] = 0.f;
+    }
 
-  for (int l = 0; l < p; ++l) {
-    for (uint64_t i = 0; i < kN / p; ++i) {
-      [[tapa::pipeline(1)]] for (uint64_t j = 0; j < kN / p; ++j) {
+    for (uint64_t k = 0; k < num_tiles; ++k) {
+      for (int i = 0; i < kBlockVecs; ++i) {
+        a[i] = a_fifo.read();
+        b[i] = b_fifo.read();
+      }
+
+      for (int l = 0; l < kP; ++l) {
+        for (int i = 0; i < kBlock; ++i) {
+          [[tapa::pipeline(1)]] for (int j = 0; j < kRowVecs; ++j) {
 #pragma HLS dependence false variable = c
-        float tmp = c[i * (kN / p) + j];
-        for (uint64_t k = 0; k < kN / p; ++k) {
-          tmp += a[i * (kN / p) + k] * b[k * (kN / p) + j];
+            Vec tmp = c[i * kRowVecs + j];
+            for (int kk = 0; kk < kBlock; ++kk) {
+              tmp += b[kk * kRowVecs + j] *
+                     a[i * kRowVecs + kk / kLanes][kk % kLanes];
+            }
+            c[i * kRowVecs + j] = tmp;
+          }
         }
-        c[i * (kN / p) + j] = tmp;
-      }
-    }
-    for (uint64_t a_wr = 0, b_wr = 0, a_rd = 0, b_rd = 0;
-         a_wr < kNumElems || b_wr < kNumElems || a_rd < kNumElems ||
-         b_rd < kNumElems;) {
-#pragma HLS loop_tripcount min = kNumElems max = kNumElems
+
+        // The blocks are reloaded for the next tile after the last round.
+        if (l == kP - 1) break;
+        for (int a_wr = 0, b_wr = 0, a_rd = 0, b_rd = 0;
+             a_wr < kBlockVecs || b_wr < kBlockVecs || a_rd < kBlockVecs ||
+             b_rd < kBlockVecs;) {
+#pragma HLS loop_tripcount min = kBlockVecs max = kBlockVecs
 #pragma HLS dependence false variable = a
 #pragma HLS dependence false variable = b
-      if (b_wr < kNumElems && i_prev.try_write(b[b_wr])) ++b_wr;
-      if (a_wr < kNumElems && j_prev.try_write(a[a_wr])) ++a_wr;
-      if (b_rd < b_wr && i_next.try_read(b[b_rd])) ++b_rd;
-      if (a_rd < a_wr && j_next.try_read(a[a_rd])) ++a_rd;
+          if (b_wr < kBlockVecs && i_prev.try_write(b[b_wr])) ++b_wr;
+          if (a_wr < kBlockVecs && j_prev.try_write(a[a_wr])) ++a_wr;
+          if (b_rd < b_wr && i_next.try_read(b[b_rd])) ++b_rd;
+          if (a_rd < a_wr && j_next.try_read(a[a_rd])) ++a_rd;
+        }
+      }
     }
-  }
 
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    c_fifo.write(c[i]);
+    for (int i = 0; i < kBlockVecs; ++i) {
+      c_fifo.write(c[i]);
+    }
   }
 }
 
-void Cannon(tapa::mmap<const float> a_vec, tapa::mmap<const float> b_vec,
-            tapa::mmap<float> c_vec, uint64_t n) {
-  assert(kN % p == 0);
-  assert(n <= kN);
-
-  tapa::stream<float, 2> a_00("a->PE00");
-  tapa::stream<float, 2> a_01("a->PE01");
-  tapa::stream<float, 2> a_10("a->PE10");
-  tapa::stream<float, 2> a_11("a->PE11");
-  tapa::stream<float, 2> b_00("b->PE00");
-  tapa::stream<float, 2> b_01("b->PE01");
-  tapa::stream<float, 2> b_10("b->PE10");
-  tapa::stream<float, 2> b_11("b->PE11");
-  tapa::stream<float, 2> c_00("c->PE00");
-  tapa::stream<float, 2> c_01("c->PE01");
-  tapa::stream<float, 2> c_10("c->PE10");
-  tapa::stream<float, 2> c_11("c->PE11");
-  tapa::stream<float, 8> fifo_00_01("PE00->PE01");
-  tapa::stream<float, 8> fifo_01_00("PE01->PE00");
-  tapa::stream<float, 8> fifo_10_11("PE10->PE11");
-  tapa::stream<float, 8> fifo_11_10("PE11->PE10");
-  tapa::stream<float, 8> fifo_00_10("PE00->PE10");
-  tapa::stream<float, 8> fifo_10_00("PE10->PE00");
-  tapa::stream<float, 8> fifo_01_11("PE01->PE11");
-  tapa::stream<float, 8> fifo_11_01("PE11->PE01");
-
-  tapa::task()
-      .invoke(Scatter, a_vec, a_00, a_01, a_10, a_11)
-      .invoke(Scatter, b_vec, b_00, b_01, b_10, b_11)
-      .invoke(ProcElem, a_00, b_00, c_00, fifo_00_10, fifo_10_00,
-              fifo_00_01, fifo_01_00)
-      .invoke(ProcElem, a_01, b_01, c_01, fifo_01_11, fifo_11_01,
-              fifo_01_00, fifo_00_01)
-      .invoke(ProcElem, a_10, b_10, c_10, fifo_10_00, fifo_00_10,
-              fifo_10_11, fifo_11_10)
-      .invoke(ProcElem, a_11, b_11, c_11, fifo_11_01, fifo_01_11,
-              fifo_11_10, fifo_10_11)
-      .invoke(Gather, c_vec, c_00, c_01, c_10, c_11);
+// A row of PEs, each of which receives blocks of A from j_next and shifts them
+// to j_prev. The PE on the left wraps around to the one on the right, so the
+// first PE writes j_prev_tail, and the others write j_prev_head in order.
+void Row(uint64_t n, istreams<Vec, kP>& a_q, istreams<Vec, kP>& b_q,
+         ostreams<Vec, kP>& c_q, istreams<Vec, kP>& j_next,
+         ostreams<Vec, kP - 1>& j_prev_head, ostream<Vec>& j_prev_tail,
+         istreams<Vec, kP>& i_next, ostreams<Vec, kP>& i_prev) {
+  task()
+      .invoke(ProcElem, n, a_q, b_q, c_q, j_next, j_prev_tail, i_next, i_prev)
+      .invoke<join, kP - 1>(ProcElem, n, a_q, b_q, c_q, j_next, j_prev_head,
+                            i_next, i_prev);
+}
+
+// The kP x kP PEs in rows, each of which receives blocks of B from i_next and
+// shifts them to i_prev. The row on the top wraps around to the one on the
+// bottom, so the first row writes i_prev_tail, and the others write
+// i_prev_head in order.
+void Grid(uint64_t n, istreams<Vec, kNumPes>& a_q,
+          istreams<Vec, kNumPes>& b_q, ostreams<Vec, kNumPes>& c_q,
+          istreams<Vec, kNumPes>& j_next, ostreams<Vec, kNumPes>& j_prev,
+          istreams<Vec, kNumPes>& i_next,
+          ostreams<Vec, kNumPes - kP>& i_prev_head,
+          ostreams<Vec, kP>& i_prev_tail) {
+  task()
+      .invoke(Row, n, a_q, b_q, c_q, j_next, j_prev, j_prev, i_next,
+              i_prev_tail)
+      .invoke<join, kP - 1>(Row, n, a_q, b_q, c_q, j_next, j_prev, j_prev,
+                            i_next, i_prev_head);
+}
+
+void Cannon(mmap<const Vec> a_vec, mmap<const Vec> b_vec, mmap<Vec> c_vec,
+            uint64_t n) {
+  assert(n % kTile == 0);
+
+  streams<Vec, kNumPes, 2> a_q("a->PE");
+  streams<Vec, kNumPes, 2> b_q("b->PE");
+  streams<Vec, kNumPes, 2> c_q("PE->c");
+  streams<Vec, kNumPes, 8> a_shift_q("a_shift");
+  streams<Vec, kNumPes, 8> b_shift_q("b_shift");
+
+  task()
+      .invoke(Scatter, a_vec, n, false, a_q)
+      .invoke(Scatter, b_vec, n, true, b_q)
+      .invoke(Grid, n, a_q, b_q, c_q, a_shift_q, a_shift_q, b_shift_q,
+              b_shift_q, b_shift_q)
+      .invoke(Gather, c_vec, n, c_q);
 }
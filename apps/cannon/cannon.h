@@ -0,0 +1,25 @@
+#include <cstdint>
+
+#include <tapa.h>
+
+// kP x kP processing elements (PEs). Cannon's algorithm shifts blocks around
+// rings of kP PEs, which needs at least 2 of them.
+constexpr int kP = 2;
+constexpr int kNumPes = kP * kP;
+static_assert(kP >= 2, "need at least 2 x 2 PEs");
+
+// Each PE holds a kBlock x kBlock block of each matrix on chip, so all PEs
+// process a kTile x kTile tile of the matrices at a time. Matrices are
+// processed tile by tile, so their size must be a multiple of kTile.
+constexpr int kBlock = 32;
+constexpr int kTile = kP * kBlock;
+
+// Number of floats in a token, which is also the number of columns a PE
+// updates per cycle.
+constexpr int kLanes = 4;
+static_assert(kBlock % kLanes == 0, "kBlock must be a multiple of kLanes");
+using Vec = tapa::vec_t<float, kLanes>;
+
+// Number of tokens in a row and in a block.
+constexpr int kRowVecs = kBlock / kLanes;
+constexpr int kBlockVecs = kBlock * kRowVecs;
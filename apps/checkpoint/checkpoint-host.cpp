@@ -0,0 +1,56 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+using std::vector;
+
+void Scale(tapa::istream<int>& in_q, tapa::ostream<int>& out_q, int factor);
+
+DEFINE_string(bitstream, "", "path to bitstream file, run csim if empty");
+
+// Invokes `Scale` with `input` and returns the number of mismatched outputs.
+// Streams are not part of the checkpoint digest, so each invocation must be
+// simulated even if `TAPA_CHECKPOINT_DIR` is set.
+uint64_t Check(const vector<int>& input, int factor) {
+  tapa::host_stream<int> in_q("in_q"), out_q("out_q");
+  in_q.write(input.data(), input.size());
+  in_q.close();
+  tapa::invoke(Scale, FLAGS_bitstream, in_q, out_q, factor);
+
+  vector<int> output(input.size() + 1);
+  const uint64_t n = out_q.read(output.data(), output.size());
+  uint64_t num_errors = n == input.size() ? 0 : 1;
+  if (num_errors != 0) {
+    clog << "expected " << input.size() << " tokens, got " << n << endl;
+  }
+  for (uint64_t i = 0; i < n && i < input.size(); ++i) {
+    if (output[i] != input[i] * factor) {
+      clog << "expected: " << input[i] * factor << ", actual: " << output[i]
+           << endl;
+      ++num_errors;
+    }
+  }
+  return num_errors;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const uint64_t n = argc > 1 ? atoll(argv[1]) : 1024;
+  vector<int> input(n);
+  for (uint64_t i = 0; i < n; ++i) input[i] = static_cast<int>(i);
+  uint64_t num_errors = Check(input, 2);
+
+  // Same scalar arguments, different tokens.
+  for (auto& value : input) value += 1000;
+  input.pop_back();
+  num_errors += Check(input, 2);
+
+  clog << (num_errors == 0 ? "PASS!" : "FAIL!") << endl;
+  return num_errors > 0 ? 1 : 0;
+}
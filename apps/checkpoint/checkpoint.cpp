@@ -0,0 +1,7 @@
+#include <tapa.h>
+
+void Scale(tapa::istream<int>& in_q, tapa::ostream<int>& out_q, int factor) {
+  TAPA_WHILE_NOT_EOT(in_q) { out_q.write(in_q.read(nullptr) * factor); }
+  in_q.open();
+  out_q.close();
+}
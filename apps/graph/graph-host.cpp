@@ -1,54 +1,52 @@
 #include <cmath>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <limits>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include <tapa.h>
 
+#include "graph.h"
 #include "nxgraph.hpp"
 
 using std::clog;
 using std::endl;
 using std::numeric_limits;
 using std::runtime_error;
-using std::vector;
 using std::chrono::duration;
 using std::chrono::high_resolution_clock;
 
-using Vid = uint32_t;
-using Eid = uint32_t;
-using Pid = uint16_t;
+template <typename T>
+using vector = std::vector<T, tapa::aligned_allocator<T>>;
 
-using VertexAttr = Vid;
-
-struct Edge {
-  Vid src;
-  Vid dst;
-};
-
-struct Update {
-  Vid dst;
-  Vid value;
-};
+using ShardedGraph = nxgraph::ShardedGraph<Vid, Eid, vector<Edge>>;
 
 DEFINE_string(bitstream, "", "path to bitstream file, run csim if empty");
+DEFINE_string(partition_cache, "",
+              "path to cache the partitioned graph across runs, e.g., "
+              "graph.cache; disabled if empty");
 
 void Graph(Pid num_partitions, tapa::mmap<const Vid> num_vertices,
-           tapa::mmap<const Eid> num_edges, tapa::mmap<VertexAttr> vertices,
-           tapa::mmap<const Edge> edges, tapa::mmap<Update> updates);
+           tapa::mmap<const Eid> num_edges,
+           tapa::mmaps<VertexAttr, kNumPes> vertices,
+           tapa::mmaps<const Edge, kNumPes> edges,
+           tapa::mmaps<Update, kNumPes> updates);
 
 void GraphBaseline(Vid base_vid, vector<VertexAttr>& vertices,
-                   const vector<Edge>& edges) {
+                   const ShardedGraph& graph) {
   bool has_update = true;
   while (has_update) {
     has_update = false;
-    for (const auto& edge : edges) {
-      if (vertices[edge.src - base_vid] < vertices[edge.dst - base_vid]) {
-        vertices[edge.dst - base_vid] = vertices[edge.src - base_vid];
-        has_update = true;
+    for (const auto& shard : graph.shards) {
+      for (const auto& edge : shard) {
+        if (vertices[edge.src - base_vid] < vertices[edge.dst - base_vid]) {
+          vertices[edge.dst - base_vid] = vertices[edge.src - base_vid];
+          has_update = true;
+        }
       }
     }
   }
@@ -58,29 +56,34 @@ int main(int argc, char* argv[]) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
   const size_t partition_size = argc > 2 ? atoi(argv[2]) : 1024;
-  auto partitions =
-      nxgraph::LoadEdgeList<Vid, Eid, VertexAttr>(argv[1], partition_size);
-  for (const auto& partition : partitions) {
-    VLOG(6) << "partition";
-    VLOG(6) << "num vertices: " << partition.num_vertices;
-    for (Eid i = 0; i < partition.num_edges; ++i) {
-      auto edge = partition.shard.get()[i];
-      VLOG(6) << "src: " << edge.src << " dst: " << edge.dst;
-    }
+  auto start = high_resolution_clock::now();
+  // Edges of each PE are partitioned directly into the buffer of its memory
+  // channel; see kNumPes.
+  auto graph = nxgraph::LoadShardedEdgeList<Vid, Eid, vector<Edge>>(
+      argv[1], partition_size, kNumPes, FLAGS_partition_cache);
+  clog << "loaded " << argv[1] << " in "
+       << duration<double>(high_resolution_clock::now() - start).count()
+       << " s" << endl;
+  const size_t num_partitions = graph.num_partitions();
+  if (num_partitions > kMaxNumPartitions) {
+    throw runtime_error("too many partitions; increase the partition size");
+  }
+  if (partition_size > kMaxPartitionSize) {
+    throw runtime_error("partition size must not exceed " +
+                        std::to_string(kMaxPartitionSize));
+  }
+  for (size_t i = 0; i < num_partitions; ++i) {
+    VLOG(6) << "partition " << i << ": num edges: " << graph.num_edges[i];
   }
-  const size_t num_partitions = partitions.size();
 
-  vector<Vid> num_vertices(num_partitions + 1);
-  vector<Eid> num_edges(num_partitions);
-  Vid total_num_vertices = 0;
-  Eid total_num_edges = 0;
-  num_vertices[0] = partitions[0].base_vid;
+  vector<Vid> num_vertices(num_partitions + 1, partition_size);
+  num_vertices[0] = graph.base_vid;
   const auto& base_vid = num_vertices[0];
-  for (size_t i = 0; i < num_partitions; ++i) {
-    num_vertices[i + 1] = partitions[i].num_vertices;
-    num_edges[i] = partitions[i].num_edges;
-    total_num_vertices += partitions[i].num_vertices;
-    total_num_edges += partitions[i].num_edges;
+  const Vid total_num_vertices = partition_size * num_partitions;
+  vector<Eid> num_edges(graph.num_edges.begin(), graph.num_edges.end());
+  Eid total_num_edges = 0;
+  for (auto n : num_edges) {
+    total_num_edges += n;
   }
 
   vector<VertexAttr> vertices(total_num_vertices);
@@ -90,48 +93,41 @@ int main(int argc, char* argv[]) {
     vertices_baseline[i] = base_vid + i;
   }
 
-  vector<Edge> edges(total_num_edges);
-  if (sizeof(Edge) != sizeof(nxgraph::Edge<Vid>)) {
-    throw runtime_error("inconsistent Edge type");
-  }
-  auto edge_ptr = edges.data();
-  for (size_t i = 0; i < num_partitions; ++i) {
-    memcpy(edge_ptr, partitions[i].shard.get(), num_edges[i] * sizeof(Edge));
-    edge_ptr += num_edges[i];
-  }
-  vector<Update> updates(total_num_edges * num_partitions);
-  VLOG(10) << "num_vertices";
-  for (auto n : num_vertices) {
-    VLOG(10) << n;
-  }
-  VLOG(10) << "num_edges";
-  for (auto n : num_edges) {
-    VLOG(10) << n;
-  }
-  VLOG(10) << "vertices: ";
-  for (auto v : vertices) {
-    VLOG(10) << v;
-  }
-  VLOG(10) << "edges: ";
-  for (auto e : edges) {
-    VLOG(10) << e.src << " -> " << e.dst;
-  }
-  VLOG(10) << "updates: " << updates.size();
+  // Lays out the vertices and updates of each PE in its own memory channels,
+  // in parallel.
+  vector<VertexAttr> vertices_pe[kNumPes];
+  vector<Update> updates_pe[kNumPes];
+  nxgraph::ParallelFor(kNumPes, [&](int pe) {
+    size_t num_partitions_pe = 0;
+    for (size_t i = pe; i < num_partitions; i += kNumPes) {
+      vertices_pe[pe].insert(vertices_pe[pe].end(),
+                             vertices.begin() + i * partition_size,
+                             vertices.begin() + (i + 1) * partition_size);
+      ++num_partitions_pe;
+    }
+    // Each partition may receive an update from every edge.
+    updates_pe[pe].resize(total_num_edges * num_partitions_pe);
+  });
+
   tapa::invoke(Graph, FLAGS_bitstream, num_partitions,
                tapa::read_only_mmap<const Vid>(num_vertices),
                tapa::read_only_mmap<const Eid>(num_edges),
-               tapa::read_only_mmap<VertexAttr>(vertices),
-               tapa::read_only_mmap<const Edge>(edges),
-               tapa::write_only_mmap<Update>(updates));
-  GraphBaseline(base_vid, vertices_baseline, edges);
+               tapa::read_write_mmaps<VertexAttr, kNumPes>(vertices_pe),
+               tapa::read_only_mmaps<const Edge, kNumPes>(graph.shards),
+               tapa::placeholder_mmaps<Update, kNumPes>(updates_pe));
+  nxgraph::ParallelFor(kNumPes, [&](int pe) {
+    auto vertex_ptr = vertices_pe[pe].begin();
+    for (size_t i = pe; i < num_partitions; i += kNumPes) {
+      std::copy(vertex_ptr, vertex_ptr + partition_size,
+                vertices.begin() + i * partition_size);
+      vertex_ptr += partition_size;
+    }
+  });
+  GraphBaseline(base_vid, vertices_baseline, graph);
   VLOG(10) << "vertices: ";
   for (auto v : vertices) {
     VLOG(10) << v;
   }
-  VLOG(10) << "updates: ";
-  for (auto v : updates) {
-    VLOG(10) << "dst: " << v.dst << " value: " << v.value;
-  }
 
   uint64_t num_errors = 0;
   const uint64_t threshold = 10;  // only report up to these errors
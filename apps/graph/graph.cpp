@@ -5,19 +5,10 @@
 
 #include <tapa.h>
 
-using Vid = uint32_t;
-using Eid = uint32_t;
-using Pid = uint16_t;
-
-using VertexAttr = Vid;
+#include "graph.h"
 
 using std::ostream;
 
-struct Edge {
-  Vid src;
-  Vid dst;
-};
-
 struct TaskReq {
   enum Phase { kScatter = 0, kGather = 1 };
   Phase phase;
@@ -55,11 +46,6 @@ ostream& operator<<(ostream& os, const TaskResp& obj) {
             << ", active: " << obj.active << "}";
 }
 
-struct Update {
-  Vid dst;
-  Vid value;
-};
-
 ostream& operator<<(ostream& os, const Update& obj) {
   return os << "{dst: " << obj.dst << ", value: " << obj.value << "}";
 }
@@ -109,13 +95,15 @@ ostream& operator<<(ostream& os, const UpdateReq& obj) {
   return os << "{phase: " << obj.phase << ", pid: " << obj.pid << "}";
 }
 
-const int kMaxNumPartitions = 1024;
-const int kMaxPartitionSize = 1024 * 32;
+// Returns the PE that processes partition pid.
+int GetPe(Pid pid) { return pid % kNumPes; }
 
 void Control(Pid num_partitions, tapa::mmap<const Vid> num_vertices,
              tapa::mmap<const Eid> num_edges,
-             tapa::ostream<UpdateConfig>& update_config_q,
-             tapa::ostream<TaskReq>& req_q, tapa::istream<TaskResp>& resp_q) {
+             tapa::ostreams<UpdateConfig, kNumPes>& update_config_q,
+             tapa::ostream<UpdateConfig>& shuffle_config_q,
+             tapa::ostreams<TaskReq, kNumPes>& req_q,
+             tapa::istreams<TaskResp, kNumPes>& resp_q) {
   // Keeps track of all partitions.
 
   // Vid of the 0-th vertex in each partition.
@@ -124,68 +112,86 @@ void Control(Pid num_partitions, tapa::mmap<const Vid> num_vertices,
   Vid num_vertices_local[kMaxNumPartitions];
   // Number of edges in each partition.
   Eid num_edges_local[kMaxNumPartitions];
-  // Memory offset of the 0-th vertex in each partition.
+  // Memory offset of the 0-th vertex in each partition, in the memory of its
+  // PE.
   Vid vid_offsets[kMaxNumPartitions];
-  // Memory offset of the 0-th edge in each partition.
+  // Memory offset of the 0-th edge in each partition, in the memory of its PE.
   Eid eid_offsets[kMaxNumPartitions];
 
   Vid base_vid_acc = num_vertices[0];
-  Vid vid_offset_acc = 0;
-  Eid eid_offset_acc = 0;
+  Vid vid_offset_acc[kNumPes] = {};
+  Eid eid_offset_acc[kNumPes] = {};
+  Eid total_num_edges = 0;
   bool done[kMaxNumPartitions] = {};
   [[tapa::pipeline(1)]] for (Pid pid = 0; pid < num_partitions; ++pid) {
     Vid num_vertices_delta = num_vertices[pid + 1];
     Eid num_edges_delta = num_edges[pid];
+    const int pe = GetPe(pid);
 
     base_vids[pid] = base_vid_acc;
     num_vertices_local[pid] = num_vertices_delta;
     num_edges_local[pid] = num_edges_delta;
-    vid_offsets[pid] = vid_offset_acc;
-    eid_offsets[pid] = eid_offset_acc;
+    vid_offsets[pid] = vid_offset_acc[pe];
+    eid_offsets[pid] = eid_offset_acc[pe];
 
     base_vid_acc += num_vertices_delta;
-    vid_offset_acc += num_vertices_delta;
-    eid_offset_acc += num_edges_delta;
+    vid_offset_acc[pe] += num_vertices_delta;
+    eid_offset_acc[pe] += num_edges_delta;
+    total_num_edges += num_edges_delta;
   }
 
-  // Initialize UpdateHandler, needed only once per execution.
-  update_config_q.write({UpdateConfig::kBaseVid, base_vids[0], 0});
-  update_config_q.write(
+  // Initialize UpdateShuffle and UpdateHandler, needed only once per
+  // execution.
+  shuffle_config_q.write({UpdateConfig::kBaseVid, base_vids[0], 0});
+  shuffle_config_q.write(
       {UpdateConfig::kPartitionSize, num_vertices_local[0], 0});
+  shuffle_config_q.close();
+  for (int pe = 0; pe < kNumPes; ++pe) {
+    update_config_q[pe].write({UpdateConfig::kBaseVid, base_vids[0], 0});
+    update_config_q[pe].write(
+        {UpdateConfig::kPartitionSize, num_vertices_local[0], 0});
+  }
   for (Pid pid = 0; pid < num_partitions; ++pid) {
-    VLOG(8) << "info@Control: eid offset[" << pid
-            << "]: " << eid_offset_acc * pid;
-    UpdateConfig info{UpdateConfig::kUpdateOffset, 0, eid_offset_acc * pid};
-    update_config_q.write(info);
+    // Each partition may receive an update from every edge.
+    const Eid update_offset = total_num_edges * (pid / kNumPes);
+    VLOG(8) << "info@Control: eid offset[" << pid << "]: " << update_offset;
+    UpdateConfig info{UpdateConfig::kUpdateOffset, 0, update_offset};
+    update_config_q[GetPe(pid)].write(info);
+  }
+  for (int pe = 0; pe < kNumPes; ++pe) {
+    update_config_q[pe].close();
   }
-  update_config_q.close();
+
+  // Partitions are processed in rounds, in each of which PE pe processes
+  // partition round * kNumPes + pe.
+  const Pid num_rounds = (num_partitions - 1) / kNumPes + 1;
 
   bool all_done = false;
   while (!all_done) {
     all_done = true;
 
-    // Do the scatter phase for each partition, if active.
-    for (Pid pid = 0; pid < num_partitions; ++pid) {
-      if (!done[pid]) {
-        TaskReq req{TaskReq::kScatter,    pid,
-                    base_vids[pid],       num_vertices_local[pid],
-                    num_edges_local[pid], vid_offsets[pid],
-                    eid_offsets[pid]};
-        req_q.write(req);
+    // Do the scatter phase for each partition, if active. Each PE receives one
+    // request per round, which is empty if its partition is inactive or does
+    // not exist, so that UpdateShuffle can tell the rounds apart.
+    for (Pid round = 0; round < num_rounds; ++round) {
+      for (int pe = 0; pe < kNumPes; ++pe) {
+        const Pid pid = round * kNumPes + pe;
+        TaskReq req{TaskReq::kScatter, pid, 0, 0, 0, 0, 0};
+        if (pid < num_partitions && !done[pid]) {
+          req = {TaskReq::kScatter,    pid,
+                 base_vids[pid],       num_vertices_local[pid],
+                 num_edges_local[pid], vid_offsets[pid],
+                 eid_offsets[pid]};
+        }
+        req_q[pe].write(req);
       }
     }
 
     // Wait until all partitions are done with the scatter phase.
-    for (Pid pid = 0; pid < num_partitions;) {
-      if (!done[pid]) {
-        bool succeeded;
-        TaskResp resp = resp_q.read(succeeded);
-        if (succeeded) {
-          assert(resp.phase == TaskReq::kScatter);
-          ++pid;
-        }
-      } else {
-        ++pid;
+    for (Pid round = 0; round < num_rounds; ++round) {
+      for (int pe = 0; pe < kNumPes; ++pe) {
+        TaskResp resp = resp_q[pe].read();
+        assert(resp.phase == TaskReq::kScatter);
       }
     }
 
@@ -195,29 +201,80 @@ void Control(Pid num_partitions, tapa::mmap<const Vid> num_vertices,
                   base_vids[pid],       num_vertices_local[pid],
                   num_edges_local[pid], vid_offsets[pid],
                   eid_offsets[pid]};
-      req_q.write(req);
+      req_q[GetPe(pid)].write(req);
     }
 
     // Wait until all partitions are done with the gather phase.
-    for (Pid pid = 0; pid < num_partitions;) {
-      bool succeeded;
-      TaskResp resp = resp_q.read(succeeded);
-      if (succeeded) {
-        assert(resp.phase == TaskReq::kGather);
-        VLOG(3) << "recv@Control: " << resp;
-        if (resp.active) {
-          all_done = false;
-        } else {
-          done[pid] = true;
-        }
-        ++pid;
+    for (Pid pid = 0; pid < num_partitions; ++pid) {
+      TaskResp resp = resp_q[GetPe(pid)].read();
+      assert(resp.phase == TaskReq::kGather);
+      assert(resp.pid == pid);
+      VLOG(3) << "recv@Control: " << resp;
+      if (resp.active) {
+        all_done = false;
+      } else {
+        done[pid] = true;
       }
     }
     VLOG(3) << "info@Control: " << (all_done ? "" : "not ") << "all done";
   }
 
   // Terminates the ProcElem.
-  req_q.close();
+  for (int pe = 0; pe < kNumPes; ++pe) {
+    req_q[pe].close();
+  }
+}
+
+void UpdateShuffle(tapa::istream<UpdateConfig>& config_q,
+                   tapa::istreams<Update, kNumPes>& update_in_q,
+                   tapa::ostreams<Update, kNumPes>& update_out_q) {
+  // Base vid of all vertices; used to determine dst partition id.
+  Vid base_vid = 0;
+  // Used to determine dst partition id.
+  Vid partition_size = 1;
+
+  TAPA_WHILE_NOT_EOT(config_q) {
+    auto config = config_q.read(nullptr);
+    VLOG(5) << "recv@UpdateShuffle: UpdateConfig: " << config;
+    switch (config.item) {
+      case UpdateConfig::kBaseVid:
+        base_vid = config.vid;
+        break;
+      case UpdateConfig::kPartitionSize:
+        partition_size = config.vid;
+        break;
+      case UpdateConfig::kUpdateOffset:
+        break;
+    }
+  }
+
+  // Forwards the Updates of each scatter round from all PEs to the
+  // UpdateHandler of the PE of their dst partition, and closes all outputs once
+  // all PEs are done with the round.
+  for (;;) {
+    bool is_done[kNumPes] = {};
+    int num_done = 0;
+    for (int pe = 0; num_done < kNumPes; pe = pe + 1 == kNumPes ? 0 : pe + 1) {
+      bool is_eot;
+      if (is_done[pe] || !update_in_q[pe].try_eot(is_eot)) continue;
+      if (is_eot) {
+        update_in_q[pe].open();
+        is_done[pe] = true;
+        ++num_done;
+        continue;
+      }
+      const Update update = update_in_q[pe].peek(nullptr);
+      const Pid pid = (update.dst - base_vid) / partition_size;
+      if (update_out_q[GetPe(pid)].try_write(update)) {
+        VLOG(5) << "info@UpdateShuffle: Update: " << update << " from PE " << pe
+                << " to PE " << GetPe(pid);
+        update_in_q[pe].read(nullptr);
+      }
+    }
+    for (int pe = 0; pe < kNumPes; ++pe) {
+      update_out_q[pe].close();
+    }
+  }
 }
 
 void UpdateHandler(Pid num_partitions,
@@ -237,10 +294,12 @@ void UpdateHandler(Pid num_partitions,
   Vid base_vid = 0;
   // Used to determine dst partition id.
   Vid partition_size = 1;
-  // Memory offsets of each update partition.
-  Eid update_offsets[kMaxNumPartitions] = {};
-  // Number of updates of each update partition in memory.
-  Eid num_updates[kMaxNumPartitions] = {};
+  // Memory offsets of each update partition of this PE, indexed by
+  // pid / kNumPes.
+  Eid update_offsets[kMaxNumPartitions / kNumPes] = {};
+  // Number of updates of each update partition of this PE in memory, indexed
+  // by pid / kNumPes.
+  Eid num_updates[kMaxNumPartitions / kNumPes] = {};
 
   // Initialization; needed only once per execution.
   int update_offset_idx = 0;
@@ -262,9 +321,9 @@ void UpdateHandler(Pid num_partitions,
   }
 
   TAPA_WHILE_NOT_EOT(update_req_q) {
-    // Each UpdateReq either requests forwarding all Updates from ProcElem to
-    // the memory (scatter phase), or requests forwarding all Updates from the
-    // memory to ProcElem (gather phase).
+    // Each UpdateReq either requests forwarding all Updates of a scatter round
+    // from UpdateShuffle to the memory (scatter phase), or requests forwarding
+    // all Updates of a partition from the memory to ProcElem (gather phase).
     const auto update_req = update_req_q.read();
     VLOG(5) << "recv@UpdateHandler: UpdateReq: " << update_req;
     if (update_req.phase == TaskReq::kScatter) {
@@ -273,26 +332,28 @@ void UpdateHandler(Pid num_partitions,
         VLOG(5) << "recv@UpdateHandler: Update: " << update;
         Pid pid = (update.dst - base_vid) / partition_size;
         VLOG(5) << "info@UpdateHandler: dst partition id: " << pid;
-        Eid update_idx = num_updates[pid];
-        Eid update_offset = update_offsets[pid] + update_idx;
+        Pid idx = pid / kNumPes;
+        Eid update_idx = num_updates[idx];
+        Eid update_offset = update_offsets[idx] + update_idx;
 
         updates[update_offset] = update;
 
-        num_updates[pid] = update_idx + 1;
+        num_updates[idx] = update_idx + 1;
       }
       update_in_q.open();
     } else {
       const auto pid = update_req.pid;
-      auto num_updates_pid = num_updates[pid];
+      const Pid idx = pid / kNumPes;
+      auto num_updates_pid = num_updates[idx];
       VLOG(6) << "info@UpdateHandler: num_updates[" << pid
               << "]: " << num_updates_pid;
       for (Eid update_idx = 0; update_idx < num_updates_pid; ++update_idx) {
-        Eid update_offset = update_offsets[pid] + update_idx;
+        Eid update_offset = update_offsets[idx] + update_idx;
         VLOG(5) << "send@UpdateHandler: update_offset: " << update_offset
                 << " Update: " << updates[update_offset];
         update_out_q.write(updates[update_offset]);
       }
-      num_updates[pid] = 0;  // Reset for the next scatter phase.
+      num_updates[idx] = 0;  // Reset for the next scatter phase.
       update_out_q.close();
     }
   }
@@ -357,22 +418,31 @@ void ProcElem(tapa::istream<TaskReq>& req_q, tapa::ostream<TaskResp>& resp_q,
 }
 
 void Graph(Pid num_partitions, tapa::mmap<const Vid> num_vertices,
-           tapa::mmap<const Eid> num_edges, tapa::mmap<VertexAttr> vertices,
-           tapa::mmap<const Edge> edges, tapa::mmap<Update> updates) {
-  tapa::stream<TaskReq, kMaxNumPartitions> task_req("task_req");
-  tapa::stream<TaskResp, 32> task_resp("task_resp");
-  tapa::stream<Update, 32> update_pe2handler("update_pe2handler");
-  tapa::stream<Update, 32> update_handler2pe("update_handler2pe");
-  tapa::stream<UpdateConfig, 32> update_config("update_config");
-  tapa::stream<UpdateReq, 32> update_req("update_req");
+           tapa::mmap<const Eid> num_edges,
+           tapa::mmaps<VertexAttr, kNumPes> vertices,
+           tapa::mmaps<const Edge, kNumPes> edges,
+           tapa::mmaps<Update, kNumPes> updates) {
+  tapa::streams<TaskReq, kNumPes, kMaxNumPartitions / kNumPes> task_req(
+      "task_req");
+  tapa::streams<TaskResp, kNumPes, 32> task_resp("task_resp");
+  tapa::streams<Update, kNumPes, 32> update_pe2shuffle("update_pe2shuffle");
+  tapa::streams<Update, kNumPes, 32> update_shuffle2handler(
+      "update_shuffle2handler");
+  tapa::streams<Update, kNumPes, 32> update_handler2pe("update_handler2pe");
+  tapa::streams<UpdateConfig, kNumPes, 32> update_config("update_config");
+  tapa::stream<UpdateConfig, 2> shuffle_config("shuffle_config");
+  tapa::streams<UpdateReq, kNumPes, 32> update_req("update_req");
 
   tapa::task()
       .invoke(Control, num_partitions, num_vertices, num_edges,
-              update_config, task_req, task_resp)
-      .invoke(UpdateHandler, num_partitions, update_config,
-              update_req, update_pe2handler, update_handler2pe,
-              updates)
-      .invoke(ProcElem, task_req, task_resp, update_req,
-              update_handler2pe, update_pe2handler, vertices,
-              edges);
+              update_config, shuffle_config, task_req, task_resp)
+      .invoke<tapa::detach>(UpdateShuffle, shuffle_config, update_pe2shuffle,
+                            update_shuffle2handler)
+      .invoke<tapa::join, kNumPes>(UpdateHandler, num_partitions,
+                                   update_config, update_req,
+                                   update_shuffle2handler, update_handler2pe,
+                                   updates)
+      .invoke<tapa::join, kNumPes>(ProcElem, task_req, task_resp, update_req,
+                                   update_handler2pe, update_pe2shuffle,
+                                   vertices, edges);
 }
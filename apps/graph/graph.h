@@ -0,0 +1,28 @@
+#include <cstdint>
+
+#include <tapa.h>
+
+using Vid = uint32_t;
+using Eid = uint32_t;
+using Pid = uint16_t;
+
+using VertexAttr = Vid;
+
+struct Edge {
+  Vid src;
+  Vid dst;
+};
+
+struct Update {
+  Vid dst;
+  Vid value;
+};
+
+// Number of processing elements (PEs). Each PE has its own memory channels for
+// vertices, edges, and updates, and processes partitions pid where
+// pid % kNumPes is its index; their vertices and edges are stored in the order
+// of pid in the memory of the PE.
+constexpr int kNumPes = 4;
+
+const int kMaxNumPartitions = 1024;
+const int kMaxPartitionSize = 1024 * 32;
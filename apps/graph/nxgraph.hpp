@@ -3,11 +3,12 @@
 #include <cstdlib>
 
 #include <algorithm>
-#include <functional>
+#include <fstream>
 #include <limits>
-#include <memory>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <fcntl.h>
@@ -43,15 +44,6 @@ struct Edge<Vid, std::nullptr_t> {
   }
 };
 
-template <typename Vid, typename Eid, typename VertexAttr, typename EdgeAttr>
-struct Partition {
-  using EdgeType = Edge<Vid, EdgeAttr>;
-  Vid base_vid;
-  Vid num_vertices;
-  Eid num_edges;
-  std::unique_ptr<EdgeType, std::function<void(EdgeType*)>> shard;
-};
-
 // Processes text between begin_ptr and end_ptr and return the edge array as a
 // unique_ptr. If max_vid or min_vid is not nullptr, it will be updated.
 template <typename Vid, typename EdgeAttr = std::nullptr_t>
@@ -139,78 +131,343 @@ inline std::vector<Edge<Vid, EdgeAttr>> ProcessEdgeList(
   return edges;
 }
 
-template <typename Vid, typename Eid, typename VertexAttr,
-          typename EdgeAttr = std::nullptr_t>
-std::vector<Partition<Vid, Eid, VertexAttr, EdgeAttr>> LoadEdgeList(
-    const std::string& filename, Vid partition_size) {
-  using std::runtime_error;
-  using PartitionType = Partition<Vid, Eid, VertexAttr, EdgeAttr>;
-  using EdgeType = Edge<Vid, EdgeAttr>;
+// Number of threads used to load and partition edge lists.
+inline size_t GetNumThreads() {
+  return std::max(1U, std::min(std::thread::hardware_concurrency(), 64U));
+}
 
-  int fd = open(filename.c_str(), O_RDONLY);
-  if (fd == -1) {
-    throw runtime_error("cannot open file " + filename);
+// Calls f(i) in a new thread for each i in [0, n) and waits for all of them.
+template <typename Func>
+inline void ParallelFor(size_t n, Func&& f) {
+  std::vector<std::thread> threads;
+  threads.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    threads.emplace_back(f, i);
+  }
+  for (auto& t : threads) {
+    t.join();
   }
+}
 
-  struct stat sb;
-  if (fstat(fd, &sb) == -1) {
-    throw runtime_error("failed to stat " + filename);
+// A read-only memory-mapped file.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& filename) : filename_(filename) {
+    using std::runtime_error;
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ == -1) {
+      throw runtime_error("cannot open file " + filename);
+    }
+
+    struct stat sb;
+    if (fstat(fd_, &sb) == -1) {
+      throw runtime_error("failed to stat " + filename);
+    }
+
+    size_ = sb.st_size;
+    if (size_ == 0) {
+      return;
+    }
+    data_ = reinterpret_cast<char*>(
+        mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, /*offset=*/0));
+    if (data_ == MAP_FAILED) {
+      throw runtime_error("failed to mmap " + filename);
+    }
   }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() {
+    if (data_ != nullptr && munmap(data_, size_) != 0) {
+      LOG(ERROR) << "failed to munmap " << filename_;
+    }
+    if (close(fd_) != 0) {
+      LOG(ERROR) << "failed to close " << filename_;
+    }
+  }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  std::string filename_;
+  int fd_ = -1;
+  char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// An edge list loaded from a file, which is either a text file parsed by
+// ProcessEdgeList, or a binary file (with extension ".bin") of Edge<Vid>,
+// i.e., pairs of native-endian src and dst, which is used in place.
+template <typename Vid>
+class EdgeList {
+ public:
+  using EdgeType = Edge<Vid>;
+
+  explicit EdgeList(const std::string& filename) : file_(filename) {
+    const size_t num_threads = GetNumThreads();
+    std::vector<Vid> max_vids(num_threads, std::numeric_limits<Vid>::min());
+    std::vector<Vid> min_vids(num_threads, std::numeric_limits<Vid>::max());
+    const char* const begin = file_.data();
+    const char* const end = begin + file_.size();
+
+    if (filename.size() >= 4 &&
+        filename.compare(filename.size() - 4, 4, ".bin") == 0) {
+      if (file_.size() % sizeof(EdgeType) != 0) {
+        throw std::runtime_error("incomplete edge in " + filename);
+      }
+      edges_ = reinterpret_cast<const EdgeType*>(begin);
+      num_edges_ = file_.size() / sizeof(EdgeType);
+      ParallelFor(num_threads, [&](size_t tid) {
+        for (size_t i = num_edges_ * tid / num_threads;
+             i < num_edges_ * (tid + 1) / num_threads; ++i) {
+          max_vids[tid] = std::max({max_vids[tid], edges_[i].src,
+                                    edges_[i].dst});
+          min_vids[tid] = std::min({min_vids[tid], edges_[i].src,
+                                    edges_[i].dst});
+        }
+      });
+    } else {
+      // Each thread parses the lines that start in its chunk of the file.
+      auto get_line_begin = [&](size_t tid) {
+        const char* ptr = begin + file_.size() * tid / num_threads;
+        if (tid == 0 || ptr[-1] == '\n') {
+          return ptr;
+        }
+        ptr = std::find(ptr, end, '\n');
+        return ptr == end ? end : ptr + 1;
+      };
+      std::vector<std::vector<EdgeType>> chunks(num_threads);
+      ParallelFor(num_threads, [&](size_t tid) {
+        chunks[tid] = ProcessEdgeList<Vid>(get_line_begin(tid),
+                                           get_line_begin(tid + 1),
+                                           &max_vids[tid], &min_vids[tid]);
+      });
+      for (const auto& chunk : chunks) {
+        parsed_edges_.insert(parsed_edges_.end(), chunk.begin(), chunk.end());
+      }
+      edges_ = parsed_edges_.data();
+      num_edges_ = parsed_edges_.size();
+    }
 
-  const size_t mmap_length = sb.st_size;
-  auto mmap_ptr = reinterpret_cast<char*>(
-      mmap(nullptr, mmap_length, PROT_READ, MAP_SHARED, fd, /*offset=*/0));
-  if (mmap_ptr == MAP_FAILED) {
-    throw runtime_error("failed to mmap " + filename);
+    max_vid_ = *std::max_element(max_vids.begin(), max_vids.end());
+    min_vid_ = *std::min_element(min_vids.begin(), min_vids.end());
+    if (num_edges_ == 0) {
+      throw std::runtime_error("no edges in " + filename);
+    }
+    VLOG(8) << "max: " << max_vid_ << " min: " << min_vid_
+            << " num edges: " << num_edges_;
   }
 
-  Vid max_vid;
-  Vid min_vid;
-  std::vector<EdgeType> edges = ProcessEdgeList<Vid, EdgeAttr>(
-      mmap_ptr, mmap_ptr + mmap_length, &max_vid, &min_vid);
-  Vid num_vertices = max_vid - min_vid + 1;
-  VLOG(8) << "max: " << max_vid << " min: " << min_vid
-          << " num vertices: " << num_vertices;
+  const EdgeType* edges() const { return edges_; }
+  size_t num_edges() const { return num_edges_; }
+  Vid max_vid() const { return max_vid_; }
+  Vid min_vid() const { return min_vid_; }
+
+ private:
+  MappedFile file_;
+  std::vector<EdgeType> parsed_edges_;
+  const EdgeType* edges_ = nullptr;
+  size_t num_edges_ = 0;
+  Vid max_vid_ = 0;
+  Vid min_vid_ = 0;
+};
+
+// A graph partitioned by the src of edges, whose partition pid is stored in
+// shard pid % shards.size(), after the partitions of that shard with smaller
+// pid. Shard is a container of edges, e.g., a std::vector with an aligned
+// allocator, so that each shard can be used as a memory channel as is.
+template <typename Vid, typename Eid, typename Shard>
+struct ShardedGraph {
+  // Vid of the 0-th vertex in partition 0.
+  Vid base_vid = 0;
+  // Number of vertices in each partition.
+  Vid partition_size = 0;
+  // Number of edges in each partition.
+  std::vector<Eid> num_edges;
+  // Offset of the 0-th edge of each partition in its shard.
+  std::vector<Eid> eid_offsets;
+  std::vector<Shard> shards;
+
+  size_t num_partitions() const { return num_edges.size(); }
+  size_t GetShard(size_t pid) const { return pid % shards.size(); }
+};
 
+// Partitions the edges into partitions of partition_size vertices, in
+// parallel, writing them directly into num_shards shards. Vertices are
+// renumbered so that partitions of consecutive vids are balanced. The order of
+// edges in each partition does not depend on the number of threads.
+template <typename Vid, typename Eid, typename Shard>
+ShardedGraph<Vid, Eid, Shard> PartitionEdgeList(const EdgeList<Vid>& edges,
+                                                Vid partition_size,
+                                                size_t num_shards) {
+  const Vid min_vid = edges.min_vid();
+  const Vid num_vertices = edges.max_vid() - min_vid + 1;
   const size_t num_partitions = (num_vertices - 1) / partition_size + 1;
-  std::vector<std::vector<EdgeType>*> shards(num_partitions);
-  for (auto& shard : shards) {
-    shard = new std::vector<EdgeType>;
-  }
-  for (const auto& edge : edges) {
-    VLOG(10) << "src: " << edge.src << " dst: " << edge.dst;
-    const size_t pid = (edge.src - min_vid) % num_partitions;
-    auto map = [&](Vid vid) -> Vid {
-      // do not use 0 as vid
-      return std::max(Vid(1), min_vid) +
-             (vid - min_vid) % num_partitions * partition_size +
-             (vid - min_vid) / num_partitions;
-    };
-    shards[pid]->push_back({map(edge.src), map(edge.dst)});
+  const size_t num_threads = GetNumThreads();
+
+  ShardedGraph<Vid, Eid, Shard> graph;
+  // do not use 0 as vid
+  graph.base_vid = std::max(Vid(1), min_vid);
+  graph.partition_size = partition_size;
+  graph.num_edges.resize(num_partitions);
+  graph.eid_offsets.resize(num_partitions);
+  graph.shards.resize(num_shards);
+
+  auto get_pid = [&](Vid vid) -> size_t {
+    return (vid - min_vid) % num_partitions;
+  };
+  auto map = [&](Vid vid) -> Vid {
+    return graph.base_vid + get_pid(vid) * partition_size +
+           (vid - min_vid) / num_partitions;
+  };
+  auto get_range = [&](size_t tid) {
+    return std::make_pair(edges.num_edges() * tid / num_threads,
+                          edges.num_edges() * (tid + 1) / num_threads);
+  };
+
+  // Counts the edges of each partition in the chunk of each thread.
+  std::vector<std::vector<Eid>> counts(num_threads,
+                                       std::vector<Eid>(num_partitions));
+  ParallelFor(num_threads, [&](size_t tid) {
+    const auto range = get_range(tid);
+    for (size_t i = range.first; i < range.second; ++i) {
+      ++counts[tid][get_pid(edges.edges()[i].src)];
+    }
+  });
+
+  // Lays out the partitions and the chunks within each partition.
+  std::vector<Eid> shard_sizes(num_shards);
+  for (size_t pid = 0; pid < num_partitions; ++pid) {
+    auto& shard_size = shard_sizes[graph.GetShard(pid)];
+    graph.eid_offsets[pid] = shard_size;
+    for (size_t tid = 0; tid < num_threads; ++tid) {
+      const Eid count = counts[tid][pid];
+      counts[tid][pid] = shard_size;  // becomes the write cursor of the chunk
+      shard_size += count;
+      graph.num_edges[pid] += count;
+    }
   }
+  ParallelFor(num_shards, [&](size_t i) {
+    graph.shards[i].resize(shard_sizes[i]);
+  });
 
-  std::vector<PartitionType> partitions;
-  partitions.reserve(num_partitions);
-  for (size_t i = 0; i < num_partitions; ++i) {
-    Vid base_vid = min_vid + partition_size * i;
-    auto shard = shards[i];
-    auto shard_ptr = shards[i]->data();
-    auto shard_deleter = [shard](EdgeType*) { delete shard; };
-    partitions.push_back({base_vid,
-                          Vid(partition_size),
-                          Eid(shards[i]->size()),
-                          {shard_ptr, shard_deleter}});
+  ParallelFor(num_threads, [&](size_t tid) {
+    const auto range = get_range(tid);
+    for (size_t i = range.first; i < range.second; ++i) {
+      const auto& edge = edges.edges()[i];
+      VLOG(10) << "src: " << edge.src << " dst: " << edge.dst;
+      const size_t pid = get_pid(edge.src);
+      graph.shards[graph.GetShard(pid)][counts[tid][pid]++] = {map(edge.src),
+                                                               map(edge.dst)};
+    }
+  });
+  return graph;
+}
+
+// Magic of the files written by SaveShardedGraph, which must be changed if
+// their layout changes.
+constexpr char kShardedGraphMagic[8] = {'N', 'X', 'G', 'R', 'A', 'P', 'H', '1'};
+
+// Writes the graph to filename, so that partitioning can be skipped in later
+// runs; see LoadShardedGraph.
+template <typename Vid, typename Eid, typename Shard>
+void SaveShardedGraph(const std::string& filename,
+                      const ShardedGraph<Vid, Eid, Shard>& graph) {
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  auto write = [&file](const void* data, size_t size) {
+    file.write(reinterpret_cast<const char*>(data), size);
+  };
+  const uint64_t header[] = {sizeof(Vid),
+                             sizeof(Eid),
+                             sizeof(typename Shard::value_type),
+                             graph.base_vid,
+                             graph.partition_size,
+                             graph.num_partitions(),
+                             graph.shards.size()};
+  write(kShardedGraphMagic, sizeof(kShardedGraphMagic));
+  write(header, sizeof(header));
+  write(graph.num_edges.data(), graph.num_edges.size() * sizeof(Eid));
+  write(graph.eid_offsets.data(), graph.eid_offsets.size() * sizeof(Eid));
+  for (const auto& shard : graph.shards) {
+    const uint64_t size = shard.size();
+    write(&size, sizeof(size));
+    write(shard.data(), size * sizeof(shard[0]));
   }
+  if (!file) {
+    throw std::runtime_error("failed to write " + filename);
+  }
+}
 
-  if (munmap(mmap_ptr, mmap_length) != 0) {
-    throw runtime_error("failed to munmap " + filename);
+// Reads a graph written by SaveShardedGraph into graph, and returns whether it
+// has the given partition size and number of shards.
+template <typename Vid, typename Eid, typename Shard>
+bool LoadShardedGraph(const std::string& filename, Vid partition_size,
+                      size_t num_shards, ShardedGraph<Vid, Eid, Shard>& graph) {
+  std::ifstream file(filename, std::ios::binary);
+  auto read = [&file](void* data, size_t size) {
+    return bool(file.read(reinterpret_cast<char*>(data), size));
+  };
+  char magic[sizeof(kShardedGraphMagic)];
+  uint64_t header[7];
+  if (!read(magic, sizeof(magic)) ||
+      !std::equal(magic, magic + sizeof(magic), kShardedGraphMagic) ||
+      !read(header, sizeof(header)) || header[0] != sizeof(Vid) ||
+      header[1] != sizeof(Eid) ||
+      header[2] != sizeof(typename Shard::value_type) ||
+      header[4] != partition_size || header[6] != num_shards) {
+    return false;
+  }
+  graph.base_vid = header[3];
+  graph.partition_size = header[4];
+  graph.num_edges.resize(header[5]);
+  graph.eid_offsets.resize(header[5]);
+  graph.shards.resize(header[6]);
+  if (!read(graph.num_edges.data(), graph.num_edges.size() * sizeof(Eid)) ||
+      !read(graph.eid_offsets.data(),
+            graph.eid_offsets.size() * sizeof(Eid))) {
+    return false;
   }
+  for (auto& shard : graph.shards) {
+    uint64_t size;
+    if (!read(&size, sizeof(size))) {
+      return false;
+    }
+    shard.resize(size);
+    if (!read(shard.data(), size * sizeof(shard[0]))) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  if (close(fd) != 0) {
-    throw runtime_error("failed to close " + filename);
+// Loads and partitions an edge list; see EdgeList and PartitionEdgeList. If
+// cache_filename is not empty, the partitioned graph is loaded from it if it is
+// newer than the edge list and has the same partitioning, or is written to it
+// otherwise.
+template <typename Vid, typename Eid, typename Shard>
+ShardedGraph<Vid, Eid, Shard> LoadShardedEdgeList(
+    const std::string& filename, Vid partition_size, size_t num_shards,
+    const std::string& cache_filename = "") {
+  ShardedGraph<Vid, Eid, Shard> graph;
+  if (!cache_filename.empty()) {
+    struct stat input_stat;
+    struct stat cache_stat;
+    if (stat(filename.c_str(), &input_stat) == 0 &&
+        stat(cache_filename.c_str(), &cache_stat) == 0 &&
+        cache_stat.st_mtime >= input_stat.st_mtime &&
+        LoadShardedGraph(cache_filename, partition_size, num_shards, graph)) {
+      VLOG(3) << "loaded partitioned graph from " << cache_filename;
+      return graph;
+    }
   }
 
-  return partitions;
+  graph = PartitionEdgeList<Vid, Eid, Shard>(EdgeList<Vid>(filename),
+                                             partition_size, num_shards);
+  if (!cache_filename.empty()) {
+    SaveShardedGraph(cache_filename, graph);
+    VLOG(3) << "saved partitioned graph to " << cache_filename;
+  }
+  return graph;
 }
 
 }  // namespace nxgraph
@@ -1,67 +1,96 @@
 #include <cmath>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <vector>
 
 #include <tapa.h>
 
+#include "jacobi.h"
+
 using std::clog;
 using std::endl;
-using std::vector;
 using std::chrono::duration;
 using std::chrono::high_resolution_clock;
 
-void Jacobi(tapa::mmap<float> bank_0_t0, tapa::mmap<const float> bank_0_t1,
-            uint64_t coalesced_data_num);
+template <typename T>
+using vector = std::vector<T, tapa::aligned_allocator<T>>;
+
+void Jacobi(tapa::mmap<Vec> t0, tapa::mmap<const Vec> t1, uint64_t n,
+            uint64_t steps);
 
 DEFINE_string(bitstream, "", "path to bitstream file, run csim if empty");
 
+// Computes one time step of the grid in t1 into t0; see Stage.
+void JacobiBaseline(std::vector<float>& t0, const std::vector<float>& t1,
+                    uint64_t height) {
+  const uint64_t width = kWidth;
+  for (uint64_t i = 0; i < height; ++i) {
+    for (uint64_t j = 0; j < width; ++j) {
+      auto at = [&](uint64_t i, uint64_t j) { return t1[i * width + j]; };
+      t0[i * width + j] =
+          i == 0 || i == height - 1 || j == 0 || j == width - 1
+              ? at(i, j)
+              : (at(i - 1, j) + at(i, j - 1) + at(i, j) + at(i + 1, j) +
+                 at(i, j + 1)) *
+                    .2f;
+    }
+  }
+}
+
 int main(int argc, char* argv[]) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
-  const uint64_t width = 100;
+  const uint64_t width = kWidth;
   const uint64_t height = argc > 1 ? atoll(argv[1]) : 100;
-  vector<float> t1_vec(height * width);
-  vector<float> t0_vec(
-      height * width +
-      (width * 2 + 1));  // additional space is stencil distance
-  auto t1 = reinterpret_cast<float(*)[width]>(t1_vec.data());
-  auto t0 = reinterpret_cast<float(*)[width]>(t0_vec.data() + width);
+  // Total number of time steps, computed kSteps at a time.
+  const uint64_t steps = argc > 2 ? atoll(argv[2]) : kSteps;
+  // The grid is updated back and forth between grid[0] and grid[1].
+  vector<float> grid[2] = {vector<float>(height * width),
+                           vector<float>(height * width)};
   for (uint64_t i = 0; i < height; ++i) {
     for (uint64_t j = 0; j < width; ++j) {
       auto shuffle = [](uint64_t x, uint64_t n) -> float {
         return static_cast<float>((n / 2 - x) * (n / 2 - x));
       };
-      t1[i][j] = pow(shuffle(i, height), 1.5f) + shuffle(j, width);
-      t0[i][j] = 0.f;
+      grid[0][i * width + j] = pow(shuffle(i, height), 1.5f) + shuffle(j, width);
     }
   }
 
+  std::vector<float> expected(grid[0].begin(), grid[0].end());
+  std::vector<float> expected_next(height * width);
+  for (uint64_t step = 0; step < steps; ++step) {
+    JacobiBaseline(expected_next, expected, height);
+    std::swap(expected, expected_next);
+  }
+
   auto start = high_resolution_clock::now();
-  tapa::invoke(Jacobi, FLAGS_bitstream, tapa::write_only_mmap<float>(t0_vec),
-               tapa::read_only_mmap<const float>(t1_vec), height * width / 2);
+  int src = 0;
+  for (uint64_t step = 0; step < steps; step += kSteps, src = 1 - src) {
+    tapa::invoke(
+        Jacobi, FLAGS_bitstream,
+        tapa::write_only_mmap<float>(grid[1 - src]).vectorized<kLanes>(),
+        tapa::read_only_mmap<const float>(grid[src]).reinterpret<const Vec>(),
+        height * width / kLanes, std::min<uint64_t>(steps - step, kSteps));
+  }
   auto stop = high_resolution_clock::now();
   duration<double> elapsed = stop - start;
   clog << "elapsed time: " << elapsed.count() << " s" << endl;
 
+  const auto& actual = grid[src];
   uint64_t num_errors = 0;
   const uint64_t threshold = 10;  // only report up to these errors
-  for (uint64_t i = 1; i < height - 1; ++i) {
-    for (uint64_t j = 1; j < width - 1; ++j) {
-      auto expected =
-          static_cast<uint64_t>((t1[i - 1][j] + t1[i][j - 1] + t1[i][j] +
-                                 t1[i + 1][j] + t1[i][j + 1]) *
-                                .2f);
-      auto actual = static_cast<uint64_t>(t0[i][j]);
-      if (actual != expected) {
-        if (num_errors < threshold) {
-          clog << "expected: " << expected << ", actual: " << actual << endl;
-        } else if (num_errors == threshold) {
-          clog << "...";
-        }
-        ++num_errors;
+  for (uint64_t i = 0; i < height * width; ++i) {
+    if (std::fabs(actual[i] - expected[i]) > std::fabs(expected[i]) * 1e-5f) {
+      if (num_errors < threshold) {
+        clog << "cell (" << i / width << ", " << i % width
+             << "): expected: " << expected[i] << ", actual: " << actual[i]
+             << endl;
+      } else if (num_errors == threshold) {
+        clog << "...";
       }
+      ++num_errors;
     }
   }
   if (num_errors == 0) {
@@ -0,0 +1,11 @@
+#include <tapa.h>
+
+// Width of the grid. Each row is streamed as kWidth / kLanes vectors.
+constexpr int kWidth = 128;
+constexpr int kLanes = 16;
+static_assert(kWidth % kLanes == 0, "rows must consist of whole vectors");
+
+// Number of time steps fused in each invocation, each computed by a Stage.
+constexpr int kSteps = 4;
+
+using Vec = tapa::vec_t<float, kLanes>;
@@ -6,10 +6,12 @@
 
 using std::clog;
 using std::endl;
-using std::vector;
 using std::chrono::duration;
 using std::chrono::high_resolution_clock;
 
+template <typename T>
+using vector = std::vector<T, tapa::aligned_allocator<T>>;
+
 void VecAddNested(tapa::mmap<float> a_array, tapa::mmap<float> b_array,
                   tapa::mmap<float> c_array, uint64_t n);
 
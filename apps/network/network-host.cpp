@@ -11,20 +11,26 @@
 #include <gflags/gflags.h>
 #include <tapa.h>
 
+#include "network.h"
+
 using std::abs;
 using std::clog;
 using std::endl;
-using std::vector;
 using std::chrono::duration;
 using std::chrono::high_resolution_clock;
 
-using pkt_t = uint64_t;
-constexpr int kN = 8;  // kN x kN network
-using pkt_vec_t = tapa::vec_t<pkt_t, kN>;
+template <typename T>
+using vector = std::vector<T, tapa::aligned_allocator<T>>;
 
-void Network(tapa::mmap<pkt_vec_t> input, tapa::mmap<pkt_vec_t> output,
+void Network(tapa::mmap<pkt_vec_t> input, tapa::mmap<pkt_t> output,
              uint64_t n);
 
+// Returns word i of a packet whose first word is `header`, so that a packet
+// corrupted in the network can be detected.
+uint64_t GetPayload(uint64_t header, int i) {
+  return header * 0x9e3779b97f4a7c15ULL + i;
+}
+
 DEFINE_string(bitstream, "", "path to bitstream file, run csim if empty");
 
 int main(int argc, char* argv[]) {
@@ -36,9 +42,12 @@ int main(int argc, char* argv[]) {
   std::mt19937 gen;
   std::uniform_int_distribution<uint64_t> dist(0, 1ULL << 32);
   for (uint64_t i = 0; i < n; ++i) {
-    input[i] = (dist(gen) & ~7) | i;
+    input[i].set(0, (dist(gen) & ~uint64_t(kN - 1)) | (i % kN));
+    for (int j = 1; j < kPktWords; ++j) {
+      input[i].set(j, GetPayload(input[i][0], j));
+    }
   }
-  std::random_shuffle(input.begin(), input.end());
+  std::shuffle(input.begin(), input.end(), gen);
 
   vector<pkt_t> output(n);
 
@@ -46,7 +55,7 @@ int main(int argc, char* argv[]) {
 
   tapa::invoke(Network, FLAGS_bitstream,
                tapa::read_only_mmap<pkt_t>(input).vectorized<kN>(),
-               tapa::write_only_mmap<pkt_t>(output).vectorized<kN>(), n / kN);
+               tapa::write_only_mmap<pkt_t>(output), n / kN);
 
   const auto stop = high_resolution_clock::now();
 
@@ -55,20 +64,36 @@ int main(int argc, char* argv[]) {
 
   uint64_t num_errors = 0;
   const uint64_t threshold = 10;  // only report up to these errors
-  for (uint64_t i = 0; i < n / kN; ++i) {
-    for (uint64_t j = 0; j < kN; ++j) {
-      std::bitset<3> actual = output[i * kN + j];
-      std::bitset<3> expected = j;
-      if (expected != actual) {
-        if (num_errors < threshold) {
-          clog << "expected: " << expected << ", actual: " << actual << endl;
-        } else if (num_errors == threshold) {
-          clog << "...";
-        }
-        ++num_errors;
+  auto report = [&](uint64_t i, const char* what) {
+    if (num_errors < threshold) {
+      clog << "packet #" << i << ": " << what << endl;
+    } else if (num_errors == threshold) {
+      clog << "...";
+    }
+    ++num_errors;
+  };
+  for (uint64_t i = 0; i < n; ++i) {
+    if (std::bitset<kLogN>(output[i][0]) != std::bitset<kLogN>(i % kN)) {
+      report(i, "delivered to a wrong output");
+    }
+    for (int j = 1; j < kPktWords; ++j) {
+      if (output[i][j] != GetPayload(output[i][0], j)) {
+        report(i, "corrupted");
+        break;
       }
     }
   }
+
+  // each packet must be delivered exactly once
+  vector<uint64_t> sent(n);
+  vector<uint64_t> received(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    sent[i] = input[i][0];
+    received[i] = output[i][0];
+  }
+  std::sort(sent.begin(), sent.end());
+  std::sort(received.begin(), received.end());
+  if (sent != received) report(n, "packets are lost or duplicated");
   if (num_errors == 0) {
     clog << "PASS!" << endl;
   } else {
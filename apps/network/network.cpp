@@ -1,29 +1,57 @@
 #include <tapa.h>
 
-using tapa::detach;
+#include "network.h"
+
 using tapa::istream;
 using tapa::istreams;
+using tapa::join;
 using tapa::mmap;
 using tapa::ostream;
 using tapa::ostreams;
+using tapa::seq;
 using tapa::streams;
 using tapa::task;
-using tapa::vec_t;
-
-using pkt_t = uint64_t;
-constexpr int kN = 8;  // kN x kN network
 
-void Switch2x2(int b, istream<pkt_t>& pkt_in_q0, istream<pkt_t>& pkt_in_q1,
-               ostreams<pkt_t, 2>& pkt_out_q) {
+// Routes packets by bit kLogN - 1 - stage of their destinations, and sends a
+// credit upstream for each token read. Finishes once both inputs are closed
+// and all tokens written are consumed.
+void Switch2x2(int stage, istream<pkt_t>& pkt_in_q0, istream<pkt_t>& pkt_in_q1,
+               ostream<credit_t>& credit_out_q0,
+               ostream<credit_t>& credit_out_q1, ostreams<pkt_t, 2>& pkt_out_q,
+               istreams<credit_t, 2>& credit_in_q) {
+  const int b = kLogN - 1 - stage;
   uint8_t priority = 0;
-  [[tapa::pipeline(1)]] for (bool valid_0, valid_1;;) {
+  int credits_0 = kDepth;
+  int credits_1 = kDepth;
+
+switch_main:
+  [[tapa::pipeline(1)]] for (bool done_0 = false, done_1 = false;
+                             !done_0 || !done_1;) {
 #pragma HLS latency max = 0
-    auto pkt_0 = pkt_in_q0.peek(valid_0);
-    auto pkt_1 = pkt_in_q1.peek(valid_1);
-    bool fwd_0_0 = valid_0 && (pkt_0 & (1 << b)) == 0;
-    bool fwd_0_1 = valid_0 && (pkt_0 & (1 << b)) != 0;
-    bool fwd_1_0 = valid_1 && (pkt_1 & (1 << b)) == 0;
-    bool fwd_1_1 = valid_1 && (pkt_1 & (1 << b)) != 0;
+    credit_t credit;
+    if (credit_in_q[0].try_read(credit)) ++credits_0;
+    if (credit_in_q[1].try_read(credit)) ++credits_1;
+
+    bool valid_0, valid_1, eot_0, eot_1;
+    auto pkt_0 = pkt_in_q0.peek(valid_0, eot_0);
+    auto pkt_1 = pkt_in_q1.peek(valid_1, eot_1);
+    if (eot_0) {
+      pkt_in_q0.open();
+      credit_out_q0.write(true);
+      done_0 = true;
+    }
+    if (eot_1) {
+      pkt_in_q1.open();
+      credit_out_q1.write(true);
+      done_1 = true;
+    }
+    valid_0 = valid_0 && !eot_0;
+    valid_1 = valid_1 && !eot_1;
+
+    bool fwd_0_0 = valid_0 && (pkt_0[0] & (1 << b)) == 0;
+    bool fwd_0_1 = valid_0 && (pkt_0[0] & (1 << b)) != 0;
+    bool fwd_1_0 = valid_1 && (pkt_1[0] & (1 << b)) == 0;
+    bool fwd_1_1 = valid_1 && (pkt_1[0] & (1 << b)) != 0;
 
     bool conflict =
         valid_0 && valid_1 && fwd_0_0 == fwd_1_0 && fwd_0_1 == fwd_1_1;
@@ -36,70 +64,158 @@ void Switch2x2(int b, istream<pkt_t>& pkt_in_q0, istream<pkt_t>& pkt_in_q1,
     bool write_0_0 = fwd_0_0 && (!fwd_1_0 || !prioritize_1);
     bool write_1_1 = fwd_1_1 && (!fwd_0_1 || prioritize_1);
 
-    // if can forward through (0->0 or 1->1), do it
-    // otherwise, check for conflict
-    const bool written_0 =
-        write_0 && pkt_out_q[0].try_write(write_0_0 ? pkt_0 : pkt_1);
-    const bool written_1 =
-        write_1 && pkt_out_q[1].try_write(write_1_1 ? pkt_1 : pkt_0);
+    // an output is written only if the downstream has room for the packet
+    const bool written_0 = write_0 && credits_0 > 0;
+    const bool written_1 = write_1 && credits_1 > 0;
+    if (written_0) {
+      pkt_out_q[0].write(write_0_0 ? pkt_0 : pkt_1);
+      --credits_0;
+    }
+    if (written_1) {
+      pkt_out_q[1].write(write_1_1 ? pkt_1 : pkt_0);
+      --credits_1;
+    }
 
     // if can forward through (0->0 or 1->1), do it
     // otherwise, round robin priority of both ins
     if (read_0 && (write_0_0 ? written_0 : written_1)) {
       pkt_in_q0.read(nullptr);
+      credit_out_q0.write(true);
     }
     if (read_1 && (write_1_1 ? written_1 : written_0)) {
       pkt_in_q1.read(nullptr);
+      credit_out_q1.write(true);
     }
 
     if (conflict) ++priority;
   }
+
+  // EoT takes a slot downstream as packets do, and all credits are collected
+  // so that none is left in the streams
+switch_close:
+  for (bool closed_0 = false, closed_1 = false;
+       !closed_0 || !closed_1 || credits_0 < kDepth || credits_1 < kDepth;) {
+    credit_t credit;
+    if (credit_in_q[0].try_read(credit)) ++credits_0;
+    if (credit_in_q[1].try_read(credit)) ++credits_1;
+    if (!closed_0 && credits_0 > 0) {
+      pkt_out_q[0].close();
+      --credits_0;
+      closed_0 = true;
+    }
+    if (!closed_1 && credits_1 > 0) {
+      pkt_out_q[1].close();
+      --credits_1;
+      closed_1 = true;
+    }
+  }
 }
 
-void InnerStage(int b, istreams<pkt_t, kN / 2>& in_q0,
-                istreams<pkt_t, kN / 2>& in_q1, ostreams<pkt_t, kN> out_q) {
-  task().invoke<detach, kN / 2>(Switch2x2, b, in_q0, in_q1, out_q);
+// Switch i reads input i of each half and writes outputs 2i and 2i+1, which
+// shuffles the packets between stages.
+void InnerStage(int stage, istreams<pkt_t, kN / 2>& in_q0,
+                istreams<pkt_t, kN / 2>& in_q1,
+                ostreams<credit_t, kN / 2>& credit_out_q0,
+                ostreams<credit_t, kN / 2>& credit_out_q1,
+                ostreams<pkt_t, kN>& out_q,
+                istreams<credit_t, kN>& credit_in_q) {
+  task().invoke<join, kN / 2>(Switch2x2, stage, in_q0, in_q1, credit_out_q0,
+                              credit_out_q1, out_q, credit_in_q);
 }
 
-void Stage(int b, istreams<pkt_t, kN>& in_q, ostreams<pkt_t, kN> out_q) {
-  task().invoke<detach>(InnerStage, b, in_q, in_q, out_q);
+void Stage(int stage, istreams<pkt_t, kN>& in_q,
+           ostreams<credit_t, kN>& credit_out_q, ostreams<pkt_t, kN>& out_q,
+           istreams<credit_t, kN>& credit_in_q) {
+  task().invoke(InnerStage, stage, in_q, in_q, credit_out_q, credit_out_q,
+                out_q, credit_in_q);
 }
 
-void Produce(mmap<vec_t<pkt_t, kN>> mmap_in, uint64_t n,
-             ostreams<pkt_t, kN>& out_q) {
+void Produce(mmap<pkt_vec_t> mmap_in, uint64_t n, ostreams<pkt_t, kN>& out_q,
+             istreams<credit_t, kN>& credit_q) {
+  int credits[kN];
+  bool closed[kN];
+#pragma HLS array_partition variable = credits complete
+#pragma HLS array_partition variable = closed complete
+  for (int j = 0; j < kN; ++j) {
+    credits[j] = kDepth;
+    closed[j] = false;
+  }
+
 produce:
-  [[tapa::pipeline(1)]] for (uint64_t i = 0; i < n; ++i) {
-    auto buf = mmap_in[i];
+  [[tapa::pipeline(1)]] for (uint64_t i = 0; i < n;) {
+    bool is_ready = true;
     for (int j = 0; j < kN; ++j) {
-      out_q[j].write(buf[j]);
+      credit_t credit;
+      if (credit_q[j].try_read(credit)) ++credits[j];
+      is_ready = is_ready && credits[j] > 0;
+    }
+    if (is_ready) {
+      auto buf = mmap_in[i];
+      for (int j = 0; j < kN; ++j) {
+        out_q[j].write(buf[j]);
+        --credits[j];
+      }
+      ++i;
+    }
+  }
+
+produce_close:
+  for (bool is_done = false; !is_done;) {
+    is_done = true;
+    for (int j = 0; j < kN; ++j) {
+      credit_t credit;
+      if (credit_q[j].try_read(credit)) ++credits[j];
+      if (!closed[j] && credits[j] > 0) {
+        out_q[j].close();
+        --credits[j];
+        closed[j] = true;
+      }
+      is_done = is_done && closed[j] && credits[j] == kDepth;
     }
   }
 }
 
-void Consume(mmap<vec_t<pkt_t, kN>> mmap_out, uint64_t n,
-             istreams<pkt_t, kN> in_q) {
+// Stores the i-th packet that output j receives at mmap_out[i * kN + j]. The
+// outputs are drained independently, so that a slow one does not block the
+// others through the shared stages.
+void Consume(mmap<pkt_t> mmap_out, uint64_t n, istreams<pkt_t, kN>& in_q,
+             ostreams<credit_t, kN>& credit_q) {
+  uint64_t counts[kN];
+#pragma HLS array_partition variable = counts complete
+  for (int j = 0; j < kN; ++j) {
+    counts[j] = 0;
+  }
+
 consume:
-  [[tapa::pipeline(1)]] for (uint64_t i = 0; i < n; ++i) {
-    vec_t<pkt_t, kN> buf;
+  [[tapa::pipeline(1)]] for (int num_closed = 0; num_closed < kN;) {
     for (int j = 0; j < kN; ++j) {
-      buf.set(j, in_q[j].read());
-      CHECK_EQ(buf[j] % kN, j);
+      bool is_eot;
+      if (in_q[j].try_eot(is_eot)) {
+        if (is_eot) {
+          in_q[j].open();
+          ++num_closed;
+        } else {
+          const pkt_t pkt = in_q[j].read();
+          CHECK_EQ(pkt[0] % kN, j);
+          CHECK_LT(counts[j], n);
+          mmap_out[counts[j] * kN + j] = pkt;
+          ++counts[j];
+        }
+        credit_q[j].write(true);
+      }
     }
-    mmap_out[i] = buf;
   }
 }
 
-void Network(mmap<vec_t<pkt_t, kN>> mmap_in, mmap<vec_t<pkt_t, kN>> mmap_out,
-             uint64_t n) {
-  streams<pkt_t, kN, 4096> q0("q0");
-  streams<pkt_t, kN, 4096> q1("q1");
-  streams<pkt_t, kN, 4096> q2("q2");
-  streams<pkt_t, kN, 4096> q3("q3");
+// Each link between two stages is a slice of kN streams of each array. Produce
+// sends to the first slice, stage i receives from slice i and sends to slice
+// i + 1, and Consume receives from the last slice.
+void Network(mmap<pkt_vec_t> mmap_in, mmap<pkt_t> mmap_out, uint64_t n) {
+  streams<pkt_t, kN * (kLogN + 1), kDepth> pkt_q("pkt_q");
+  streams<credit_t, kN * (kLogN + 1), kDepth> credit_q("credit_q");
 
   task()
-      .invoke(Produce, mmap_in, n, q0)
-      .invoke(Stage, 2, q0, q1)
-      .invoke(Stage, 1, q1, q2)
-      .invoke(Stage, 0, q2, q3)
-      .invoke(Consume, mmap_out, n, q3);
+      .invoke(Produce, mmap_in, n, pkt_q, credit_q)
+      .invoke<join, kLogN>(Stage, seq(), pkt_q, credit_q, pkt_q, credit_q)
+      .invoke(Consume, mmap_out, n, pkt_q, credit_q);
 }
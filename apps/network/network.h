@@ -0,0 +1,19 @@
+#include <cstdint>
+
+#include <tapa.h>
+
+// kN x kN butterfly network built from kLogN stages of kN / 2 switches each.
+constexpr int kLogN = 3;
+constexpr int kN = 1 << kLogN;
+
+// A packet is kPktWords 64-bit words, the first of which holds its destination
+// in the lowest kLogN bits.
+constexpr int kPktWords = 4;
+using pkt_t = tapa::vec_t<uint64_t, kPktWords>;
+using pkt_vec_t = tapa::vec_t<pkt_t, kN>;
+
+// Number of packets that a link between two stages buffers. The sender of a
+// link holds one credit per free slot, so it never writes a full stream, and
+// the receiver returns a credit each time it reads a token.
+constexpr int kDepth = 32;
+using credit_t = bool;
@@ -15,18 +15,35 @@ void Add(istream<float>& a, istream<float>& b, ostream<float>& c) {
   c.close();
 }
 
-void Mmap2Stream(mmap<float> mmap, int offset, uint64_t n,
+// The three arrays of `VecAdd` share one mmap and thus one memory port. Each
+// accessor is a separate async_mmap, so the loads and the store run
+// concurrently; tapac arbitrates them in hardware through an AXI interconnect
+// that tags the requests of each accessor with its own ID and routes the
+// responses back, and software simulation shares the memory model among them.
+void Mmap2Stream(tapa::async_mmap<float>& mmap, int offset, uint64_t n,
                  ostream<float>& stream) {
-  for (uint64_t i = 0; i < n; ++i) {
-    stream.write(mmap[n * offset + i]);
+  [[tapa::pipeline(1)]] for (uint64_t i_req = 0, i_resp = 0; i_resp < n;) {
+    if (i_req < n && mmap.read_addr.try_write(n * offset + i_req)) ++i_req;
+    float elem;
+    if (mmap.read_data.try_read(elem)) {
+      stream.write(elem);
+      ++i_resp;
+    }
   }
   stream.close();
 }
 
-void Stream2Mmap(istream<float>& stream, mmap<float> mmap, int offset,
-                 uint64_t n) {
-  for (uint64_t i = 0; i < n; ++i) {
-    mmap[n * offset + i] = stream.read();
+void Stream2Mmap(istream<float>& stream, tapa::async_mmap<float>& mmap,
+                 int offset, uint64_t n) {
+  [[tapa::pipeline(1)]] for (uint64_t i_req = 0, i_resp = 0; i_resp < n;) {
+    if (i_req < n && !stream.empty() && !mmap.write_addr.full() &&
+        !mmap.write_data.full()) {
+      mmap.write_addr.write(n * offset + i_req);
+      mmap.write_data.write(stream.read(nullptr));
+      ++i_req;
+    }
+    uint8_t n_resp;
+    if (mmap.write_resp.try_read(n_resp)) i_resp += n_resp + 1;
   }
 }
 
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+#include "vec-sort.h"
+
+using std::clog;
+using std::endl;
+
+template <typename T>
+using vector = std::vector<T, tapa::aligned_allocator<T>>;
+
+void VecSort(tapa::mmap<Int8Vec> int8_vecs, tapa::mmap<UintVec> uint_vecs,
+             tapa::mmap<FloatVec> float_vecs, tapa::mmap<PairVec> pair_vecs,
+             uint64_t n);
+
+DEFINE_string(bitstream, "", "path to bitstream file, run csim if empty");
+
+// Returns the number of vectors in `actual` that are not `expected` sorted by
+// `comp`, which must not have equivalent elements.
+template <typename Vec, typename Compare, typename Equal>
+uint64_t Check(const char* name, const vector<Vec>& expected,
+               const vector<Vec>& actual, Compare comp, Equal equal) {
+  uint64_t num_errors = 0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    Vec vec = expected[i];
+    std::sort(&vec[0], &vec[0] + Vec::length, comp);
+    bool is_correct = true;
+    for (int j = 0; j < Vec::length; ++j) {
+      is_correct = is_correct && equal(vec[j], actual[i][j]);
+    }
+    if (!is_correct) {
+      if (num_errors == 0) {
+        clog << name << " vector #" << i << " is not sorted" << endl;
+      }
+      ++num_errors;
+    }
+  }
+  return num_errors;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const uint64_t n = argc > 1 ? atoll(argv[1]) : 1024;
+  vector<Int8Vec> int8_vecs(n);
+  vector<UintVec> uint_vecs(n);
+  vector<FloatVec> float_vecs(n);
+  vector<PairVec> pair_vecs(n);
+  std::mt19937 gen;
+  for (uint64_t i = 0; i < n; ++i) {
+    // Elements of each vector are distinct.
+    int keys[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    std::shuffle(std::begin(keys), std::end(keys), gen);
+    for (int j = 0; j < 8; ++j) {
+      const int key = keys[j] * 16 + int(i % 16);
+      if (j < Int8Vec::length) int8_vecs[i][j] = int8_t(key - 64);
+      uint_vecs[i][j] = key * 31;
+      float_vecs[i][j] = key * -0.5f;
+      if (j < PairVec::length) pair_vecs[i][j] = {uint16_t(key), uint16_t(j)};
+    }
+  }
+  const auto int8_expected = int8_vecs;
+  const auto uint_expected = uint_vecs;
+  const auto float_expected = float_vecs;
+  const auto pair_expected = pair_vecs;
+
+  tapa::invoke(VecSort, FLAGS_bitstream,
+               tapa::read_write_mmap<Int8Vec>(int8_vecs),
+               tapa::read_write_mmap<UintVec>(uint_vecs),
+               tapa::read_write_mmap<FloatVec>(float_vecs),
+               tapa::read_write_mmap<PairVec>(pair_vecs), n);
+
+  auto equal = std::equal_to<>();
+  uint64_t num_errors = 0;
+  num_errors += Check("int8", int8_expected, int8_vecs, std::less<>(), equal);
+  num_errors += Check("uint", uint_expected, uint_vecs,
+                      std::greater<ap_uint<12>>(), equal);
+  num_errors +=
+      Check("float", float_expected, float_vecs, std::less<>(), equal);
+  num_errors += Check("pair", pair_expected, pair_vecs, PairLess(),
+                      [](const Pair& lhs, const Pair& rhs) {
+                        return lhs.key == rhs.key && lhs.value == rhs.value;
+                      });
+  clog << (num_errors == 0 ? "PASS!" : "FAIL!") << endl;
+  return num_errors > 0 ? 1 : 0;
+}
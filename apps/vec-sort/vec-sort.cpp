@@ -0,0 +1,49 @@
+#include <functional>
+
+#include "vec-sort.h"
+
+void SortInt8(tapa::mmap<Int8Vec> vecs, uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+#pragma HLS pipeline II = 1
+    Int8Vec vec = vecs[i];
+    tapa::sort(vec);
+    vecs[i] = vec;
+  }
+}
+
+void SortUint(tapa::mmap<UintVec> vecs, uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+#pragma HLS pipeline II = 1
+    UintVec vec = vecs[i];
+    tapa::sort(vec, std::greater<ap_uint<12>>());
+    vecs[i] = vec;
+  }
+}
+
+void SortFloat(tapa::mmap<FloatVec> vecs, uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+#pragma HLS pipeline II = 1
+    FloatVec vec = vecs[i];
+    tapa::sort(vec);
+    vecs[i] = vec;
+  }
+}
+
+void SortPair(tapa::mmap<PairVec> vecs, uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+#pragma HLS pipeline II = 1
+    PairVec vec = vecs[i];
+    tapa::sort(vec, PairLess());
+    vecs[i] = vec;
+  }
+}
+
+void VecSort(tapa::mmap<Int8Vec> int8_vecs, tapa::mmap<UintVec> uint_vecs,
+             tapa::mmap<FloatVec> float_vecs, tapa::mmap<PairVec> pair_vecs,
+             uint64_t n) {
+  tapa::task()
+      .invoke(SortInt8, int8_vecs, n)
+      .invoke(SortUint, uint_vecs, n)
+      .invoke(SortFloat, float_vecs, n)
+      .invoke(SortPair, pair_vecs, n);
+}
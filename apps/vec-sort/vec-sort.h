@@ -0,0 +1,24 @@
+#include <cstdint>
+
+#include <ap_int.h>
+#include <tapa.h>
+
+// Vectors of element types that `tapa::sort` handles differently in software
+// simulation: one that does not fill a SIMD register, an arbitrary-precision
+// integer, a struct with a custom comparator, and one sorted via SIMD.
+using Int8Vec = tapa::vec_t<int8_t, 4>;
+using UintVec = tapa::vec_t<ap_uint<12>, 8>;
+using FloatVec = tapa::vec_t<float, 8>;
+
+struct Pair {
+  uint16_t key;
+  uint16_t value;
+};
+
+struct PairLess {
+  bool operator()(const Pair& lhs, const Pair& rhs) const {
+    return lhs.key < rhs.key;
+  }
+};
+
+using PairVec = tapa::vec_t<Pair, 4>;
@@ -437,6 +437,66 @@ static void handleTapaTargetAttr(Sema &S, Decl *D, const ParsedAttr &AL) {
                                 AL.getAttributeSpellingListIndex()));
 }
 
+static void handleTapaPartitionAttr(Sema &S, Decl *D, const ParsedAttr &AL) {
+  StringRef TypeStr;
+  SourceLocation ArgLoc;
+
+  if (!S.checkStringLiteralArgumentAttr(AL, 0, TypeStr, &ArgLoc)) return;
+
+  TapaPartitionAttr::PartitionType Type;
+  if (!TapaPartitionAttr::ConvertStrToPartitionType(TypeStr, Type)) {
+    S.Diag(AL.getLoc(), diag::warn_attribute_type_not_supported)
+        << AL << TypeStr << ArgLoc;
+    return;
+  }
+
+  uint32_t Factor = 0, Dim = 1;
+  if (AL.getNumArgs() > 1 &&
+      !checkUInt32Argument(S, AL, AL.getArgAsExpr(1), Factor, 2))
+    return;
+  if (AL.getNumArgs() > 2 &&
+      !checkUInt32Argument(S, AL, AL.getArgAsExpr(2), Dim, 3))
+    return;
+
+  if ((Type == TapaPartitionAttr::Complete) != (Factor == 0)) {
+    S.Diag(AL.getLoc(), diag::warn_attribute_type_not_supported)
+        << AL << "partition factor" << ArgLoc;
+    return;
+  }
+
+  D->addAttr(::new (S.Context)
+                 TapaPartitionAttr(AL.getRange(), S.Context, Type, Factor, Dim,
+                                   AL.getAttributeSpellingListIndex()));
+}
+
+static void handleTapaAxiAttr(Sema &S, Decl *D, const ParsedAttr &AL) {
+  // Zero leaves the default of the target.
+  uint32_t Args[3] = {};
+  for (unsigned I = 0; I < AL.getNumArgs(); ++I) {
+    if (!checkUInt32Argument(S, AL, AL.getArgAsExpr(I), Args[I], I + 1))
+      return;
+  }
+
+  // AXI4 bursts are at most 256 beats.
+  if (Args[0] > 256) {
+    S.Diag(AL.getLoc(), diag::err_attribute_argument_out_of_bounds)
+        << AL << 1 << AL.getArgAsExpr(0)->getSourceRange();
+    return;
+  }
+
+  D->addAttr(::new (S.Context)
+                 TapaAxiAttr(AL.getRange(), S.Context, Args[0], Args[1],
+                             Args[2], AL.getAttributeSpellingListIndex()));
+}
+
+static void handleTapaRtlAttr(Sema &S, Decl *D, const ParsedAttr &AL) {
+  StringRef File;
+  if (!S.checkStringLiteralArgumentAttr(AL, 0, File)) return;
+
+  D->addAttr(::new (S.Context) TapaRtlAttr(
+      AL.getRange(), S.Context, File, AL.getAttributeSpellingListIndex()));
+}
+
 template <typename... DiagnosticArgs>
 static const Sema::SemaDiagnosticBuilder &appendDiagnostics(
     const Sema::SemaDiagnosticBuilder &Bldr) {
@@ -6744,6 +6804,22 @@ static void ProcessDeclAttribute(Sema &S, Scope *scope, Decl *D,
     case ParsedAttr::AT_TapaTarget:
       handleTapaTargetAttr(S, D, AL);
       break;
+
+    case ParsedAttr::AT_TapaPartition:
+      handleTapaPartitionAttr(S, D, AL);
+      break;
+
+    case ParsedAttr::AT_TapaAxi:
+      handleTapaAxiAttr(S, D, AL);
+      break;
+
+    case ParsedAttr::AT_TapaRtl:
+      handleTapaRtlAttr(S, D, AL);
+      break;
+
+    case ParsedAttr::AT_TapaDoublePump:
+      handleSimpleAttribute<TapaDoublePumpAttr>(S, D, AL);
+      break;
   }
 }
 
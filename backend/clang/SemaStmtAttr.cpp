@@ -222,6 +222,19 @@ static Attr *handleLoopHintAttr(Sema &S, Stmt *St, const ParsedAttr &A,
                                       ValueExpr, A.getRange());
 }
 
+static bool checkTapaLoopAttr(Sema &S, Stmt *St, const ParsedAttr &AL,
+                              StringRef Name) {
+  if (St->getStmtClass() != Stmt::DoStmtClass &&
+      St->getStmtClass() != Stmt::ForStmtClass &&
+      St->getStmtClass() != Stmt::CXXForRangeStmtClass &&
+      St->getStmtClass() != Stmt::WhileStmtClass) {
+    S.Diag(St->getBeginLoc(), diag::warn_attribute_type_not_supported)
+        << AL << ("unsupported " + Name + " target").str();
+    return false;
+  }
+  return true;
+}
+
 static Attr *handleTapaPipelineAttr(Sema &S, Stmt *St,
         const ParsedAttr &AL, SourceRange Range) {
   uint32_t ii = 0;
@@ -229,19 +242,59 @@ static Attr *handleTapaPipelineAttr(Sema &S, Stmt *St,
     if (!checkUInt32Argument(S, AL, AL.getArgAsExpr(0), ii)) return nullptr;
   }
 
-  if (St->getStmtClass() != Stmt::DoStmtClass &&
-      St->getStmtClass() != Stmt::ForStmtClass &&
-      St->getStmtClass() != Stmt::CXXForRangeStmtClass &&
-      St->getStmtClass() != Stmt::WhileStmtClass) {
-    S.Diag(St->getBeginLoc(), diag::warn_attribute_type_not_supported)
-        << AL << "unsupported pipeline target";
-    return nullptr;
-  }
+  if (!checkTapaLoopAttr(S, St, AL, "pipeline")) return nullptr;
 
   return ::new (S.Context) TapaPipelineAttr(
       AL.getRange(), S.Context, ii, AL.getAttributeSpellingListIndex());
 }
 
+static Attr *handleTapaTripcountAttr(Sema &S, Stmt *St,
+        const ParsedAttr &AL, SourceRange Range) {
+  uint32_t min = 0, max = 0, avg = 0;
+  if (AL.getNumArgs() < 2) {
+    S.Diag(AL.getLoc(), diag::err_attribute_too_few_arguments) << AL << 2;
+    return nullptr;
+  }
+  if (!checkUInt32Argument(S, AL, AL.getArgAsExpr(0), min, 1) ||
+      !checkUInt32Argument(S, AL, AL.getArgAsExpr(1), max, 2))
+    return nullptr;
+  if (AL.getNumArgs() > 2 &&
+      !checkUInt32Argument(S, AL, AL.getArgAsExpr(2), avg, 3))
+    return nullptr;
+
+  if (min > max || (avg && (avg < min || avg > max))) {
+    S.Diag(AL.getLoc(), diag::warn_attribute_type_not_supported)
+        << AL << "inconsistent trip counts";
+    return nullptr;
+  }
+
+  if (!checkTapaLoopAttr(S, St, AL, "tripcount")) return nullptr;
+
+  return ::new (S.Context) TapaTripcountAttr(
+      AL.getRange(), S.Context, min, max, avg,
+      AL.getAttributeSpellingListIndex());
+}
+
+static Attr *handleTapaIndependentAttr(Sema &S, Stmt *St,
+        const ParsedAttr &AL, SourceRange Range) {
+  SmallVector<Expr *, 4> vars;
+  for (unsigned i = 0; i < AL.getNumArgs(); ++i) {
+    Expr *var = AL.getArgAsExpr(i);
+    if (!isa<DeclRefExpr>(var->IgnoreParenImpCasts())) {
+      S.Diag(var->getBeginLoc(), diag::err_attribute_argument_type)
+          << AL << AANT_ArgumentIdentifier << var->getSourceRange();
+      return nullptr;
+    }
+    vars.push_back(var);
+  }
+
+  if (!checkTapaLoopAttr(S, St, AL, "independent")) return nullptr;
+
+  return ::new (S.Context) TapaIndependentAttr(
+      AL.getRange(), S.Context, vars.data(), vars.size(),
+      AL.getAttributeSpellingListIndex());
+}
+
 static void
 CheckForIncompatibleAttributes(Sema &S,
                                const SmallVectorImpl<const Attr *> &Attrs) {
@@ -403,6 +456,10 @@ static Attr *ProcessStmtAttribute(Sema &S, Stmt *St, const ParsedAttr &A,
     return handleSuppressAttr(S, St, A, Range);
   case ParsedAttr::AT_TapaPipeline:
     return handleTapaPipelineAttr(S, St, A, Range);
+  case ParsedAttr::AT_TapaTripcount:
+    return handleTapaTripcountAttr(S, St, A, Range);
+  case ParsedAttr::AT_TapaIndependent:
+    return handleTapaIndependentAttr(S, St, A, Range);
   default:
     // if we're here, then we parsed a known attribute, but didn't recognize
     // it as a statement attribute => it is declaration attribute
@@ -0,0 +1,405 @@
+#ifndef TAPA_VERILATOR_H_
+#define TAPA_VERILATOR_H_
+
+// Testbench of the RTL simulator generated by `tapac --verilator`. The host
+// program runs the simulator with a directory, which has the arguments in
+// `args.txt`, one per line:
+//
+//   <index> scalar <little-endian hex bytes>
+//   <index> buffer <bytes> <path>
+//
+// The simulator writes the buffers back in place and the number of simulated
+// cycles to `cycles.txt` once the kernel is done.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <verilated.h>
+
+namespace tapa {
+namespace verilator {
+
+[[noreturn]] inline void fail(const std::string& message) {
+  std::cerr << "tapa::verilator: " << message << std::endl;
+  std::exit(EXIT_FAILURE);
+}
+
+// Copies the `bytes` least significant bytes of a signal from or to memory.
+template <typename T>
+void load(T& signal, const uint8_t* ptr, size_t bytes) {
+  signal = 0;
+  std::memcpy(&signal, ptr, std::min(bytes, sizeof(T)));
+}
+template <std::size_t N>
+void load(VlWide<N>& signal, const uint8_t* ptr, size_t bytes) {
+  std::memset(signal.data(), 0, sizeof(EData) * N);
+  std::memcpy(signal.data(), ptr, std::min(bytes, sizeof(EData) * N));
+}
+template <typename T>
+void store(const T& signal, uint8_t* ptr, size_t bytes) {
+  std::memcpy(ptr, &signal, std::min(bytes, sizeof(T)));
+}
+template <std::size_t N>
+void store(const VlWide<N>& signal, uint8_t* ptr, size_t bytes) {
+  std::memcpy(ptr, signal.data(), std::min(bytes, sizeof(EData) * N));
+}
+
+// Memory of an mmap argument behind an AXI port, which responds to requests
+// without latency. Bursts must be incremental and of the full data width.
+class memory {
+ public:
+  virtual ~memory() = default;
+
+  // Drives the inputs of the kernel for the next cycle.
+  virtual void drive() = 0;
+
+  // Takes the handshakes of this cycle, before the rising edge.
+  virtual void update() = 0;
+
+  void load_buffer(const std::string& path, uint64_t bytes, uint64_t base) {
+    path_ = path;
+    base_ = base;
+    data_.resize(bytes);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(data_.data()), bytes)) {
+      fail("cannot read " + path);
+    }
+  }
+
+  void store_buffer() const {
+    if (path_.empty()) return;
+    std::ofstream file(path_, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(data_.data()),
+                    data_.size())) {
+      fail("cannot write " + path_);
+    }
+  }
+
+ protected:
+  uint8_t* at(uint64_t addr, uint64_t bytes) {
+    if (addr < base_ || addr - base_ + bytes > data_.size()) {
+      std::ostringstream message;
+      message << "out-of-bound access to 0x" << std::hex << addr
+              << " of mmap at 0x" << base_;
+      fail(message.str());
+    }
+    return data_.data() + (addr - base_);
+  }
+
+ private:
+  std::string path_;
+  uint64_t base_ = 0;
+  std::vector<uint8_t> data_;
+};
+
+template <typename Data, typename Strb>
+class m_axi : public memory {
+ public:
+  struct ports {
+    QData& araddr;
+    CData& arid;
+    CData& arlen;
+    CData& arready;
+    CData& arvalid;
+    QData& awaddr;
+    CData& awid;
+    CData& awlen;
+    CData& awready;
+    CData& awvalid;
+    CData& bid;
+    CData& bready;
+    CData& bresp;
+    CData& bvalid;
+    Data& rdata;
+    CData& rid;
+    CData& rlast;
+    CData& rready;
+    CData& rresp;
+    CData& rvalid;
+    Data& wdata;
+    CData& wlast;
+    CData& wready;
+    Strb& wstrb;
+    CData& wvalid;
+  };
+
+  m_axi(const ports& ports, uint64_t data_bytes)
+      : p_(ports), data_bytes_(data_bytes) {}
+
+  void drive() override {
+    p_.arready = reads_.size() < kMaxOutstanding;
+    p_.awready = writes_.size() < kMaxOutstanding;
+    p_.rvalid = !reads_.empty();
+    if (p_.rvalid) {
+      const burst& read = reads_.front();
+      load(p_.rdata, at(read.addr + read.beat * data_bytes_, data_bytes_),
+           data_bytes_);
+      p_.rid = read.id;
+      p_.rlast = read.beat + 1 == read.len;
+      p_.rresp = 0;
+    }
+    p_.wready = !writes_.empty();
+    p_.bvalid = !responses_.empty();
+    if (p_.bvalid) {
+      p_.bid = responses_.front();
+      p_.bresp = 0;
+    }
+  }
+
+  void update() override {
+    if (p_.rvalid && p_.rready && ++reads_.front().beat == reads_.front().len) {
+      reads_.pop_front();
+    }
+    if (p_.wvalid && p_.wready) {
+      burst& write = writes_.front();
+      uint8_t data[sizeof(Data)];
+      uint8_t strb[sizeof(Strb)];
+      store(p_.wdata, data, data_bytes_);
+      store(p_.wstrb, strb, (data_bytes_ + 7) / 8);
+      uint8_t* ptr = at(write.addr + write.beat * data_bytes_, data_bytes_);
+      for (uint64_t i = 0; i < data_bytes_; ++i) {
+        if (strb[i / 8] >> (i % 8) & 1) ptr[i] = data[i];
+      }
+      if (++write.beat == write.len) {
+        responses_.push_back(write.id);
+        writes_.pop_front();
+      }
+    }
+    if (p_.bvalid && p_.bready) responses_.pop_front();
+    if (p_.arvalid && p_.arready) {
+      reads_.push_back({p_.araddr, uint64_t(p_.arlen) + 1, p_.arid});
+    }
+    if (p_.awvalid && p_.awready) {
+      writes_.push_back({p_.awaddr, uint64_t(p_.awlen) + 1, p_.awid});
+    }
+  }
+
+ private:
+  static constexpr size_t kMaxOutstanding = 64;
+
+  struct burst {
+    uint64_t addr;
+    uint64_t len;
+    CData id;
+    uint64_t beat = 0;
+  };
+
+  ports p_;
+  const uint64_t data_bytes_;
+  std::deque<burst> reads_;
+  std::deque<burst> writes_;
+  std::deque<CData> responses_;
+};
+
+// Runs the kernel `Top` as the host would via its control interface.
+template <typename Top>
+class kernel {
+ public:
+  kernel(int argc, char** argv)
+      : context_(new VerilatedContext), top_(new Top(context_.get())) {
+    context_->commandArgs(argc, argv);
+    if (argc < 2) fail("usage: " + std::string(argv[0]) + " <directory>");
+    dir_ = argv[1];
+  }
+
+  Top& top() { return *top_; }
+
+  // Registers an argument that is set at each of `words`, which are pairs of
+  // the offset of a control register and the bit of the argument it starts.
+  void add_scalar(int idx, std::vector<std::pair<uint32_t, int>> words) {
+    arg(idx).words = std::move(words);
+  }
+
+  // Registers an mmap argument, of which the address is set at `words`.
+  void add_mmap(int idx, memory* model,
+                std::vector<std::pair<uint32_t, int>> words) {
+    arg(idx).model = model;
+    arg(idx).words = std::move(words);
+  }
+
+  // Called with the clock before each evaluation, e.g., to drive other
+  // clocks.
+  void set_clock_hook(void (*hook)(Top& top, bool clk)) { clock_hook_ = hook; }
+
+  int run() {
+    read_args();
+
+    top_->ap_rst_n = 0;
+    for (int i = 0; i < 16; ++i) cycle();
+    top_->ap_rst_n = 1;
+    cycle();
+
+    for (const auto& arg : args_) {
+      for (const auto& word : arg.words) {
+        uint32_t value = 0;
+        if (word.second / 8 < int(arg.value.size())) {
+          std::memcpy(&value, arg.value.data() + word.second / 8,
+                      std::min<size_t>(4, arg.value.size() - word.second / 8));
+        }
+        write(word.first, value);
+      }
+    }
+
+    const uint64_t start = cycles_;
+    write(0x00, 1);  // ap_start
+    while (!(read(0x00) & 0x2)) {  // ap_done
+      for (int i = 0; i < 64; ++i) cycle();
+    }
+    top_->final();
+
+    for (const auto& arg : args_) {
+      if (arg.model != nullptr) arg.model->store_buffer();
+    }
+    std::ofstream(dir_ + "/cycles.txt") << cycles_ - start << "\n";
+    return EXIT_SUCCESS;
+  }
+
+ private:
+  struct arg_t {
+    std::vector<std::pair<uint32_t, int>> words;
+    memory* model = nullptr;
+    std::string value;  // Little-endian bytes.
+  };
+
+  arg_t& arg(int idx) {
+    if (size_t(idx) >= args_.size()) args_.resize(idx + 1);
+    return args_[idx];
+  }
+
+  void read_args() {
+    std::ifstream args_txt(dir_ + "/args.txt");
+    if (!args_txt) fail("cannot read " + dir_ + "/args.txt");
+    int idx;
+    std::string kind;
+    while (args_txt >> idx >> kind) {
+      if (kind == "scalar") {
+        std::string hex;
+        args_txt >> hex;
+        for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+          arg(idx).value.push_back(char(std::stoi(hex.substr(i, 2), 0, 16)));
+        }
+      } else if (kind == "buffer") {
+        uint64_t bytes;
+        std::string path;
+        args_txt >> bytes >> path;
+        if (arg(idx).model == nullptr) {
+          fail("argument #" + std::to_string(idx) + " is not an mmap");
+        }
+
+        // Each mmap is placed in its own 64 GiB range.
+        const uint64_t base = uint64_t(idx + 1) << 36;
+        arg(idx).model->load_buffer(path, bytes, base);
+        arg(idx).value.assign(reinterpret_cast<const char*>(&base),
+                              sizeof(base));
+      } else {
+        fail("unknown argument kind " + kind);
+      }
+    }
+  }
+
+  void cycle() {
+    for (const auto& arg : args_) {
+      if (arg.model != nullptr) arg.model->drive();
+    }
+    set_clock(false);
+    top_->eval();
+    for (const auto& arg : args_) {
+      if (arg.model != nullptr) arg.model->update();
+    }
+    set_clock(true);
+    top_->eval();
+    context_->timeInc(1);
+    ++cycles_;
+  }
+
+  void set_clock(bool clk) {
+    top_->ap_clk = clk;
+    if (clock_hook_ != nullptr) clock_hook_(*top_, clk);
+  }
+
+  // Accesses a control register via AXI-Lite.
+  void write(uint32_t addr, uint32_t data) {
+    top_->s_axi_control_AWADDR = addr;
+    top_->s_axi_control_AWVALID = 1;
+    top_->s_axi_control_WDATA = data;
+    top_->s_axi_control_WSTRB = 0xf;
+    top_->s_axi_control_WVALID = 1;
+    top_->s_axi_control_BREADY = 1;
+    bool is_aw_done = false, is_w_done = false, is_b_done = false;
+    while (!is_b_done) {
+      set_clock(false);
+      top_->eval();
+      is_aw_done |= top_->s_axi_control_AWVALID && top_->s_axi_control_AWREADY;
+      is_w_done |= top_->s_axi_control_WVALID && top_->s_axi_control_WREADY;
+      is_b_done = top_->s_axi_control_BVALID;
+      cycle();
+      top_->s_axi_control_AWVALID = !is_aw_done;
+      top_->s_axi_control_WVALID = !is_w_done;
+    }
+    top_->s_axi_control_BREADY = 0;
+  }
+  uint32_t read(uint32_t addr) {
+    top_->s_axi_control_ARADDR = addr;
+    top_->s_axi_control_ARVALID = 1;
+    top_->s_axi_control_RREADY = 1;
+    bool is_ar_done = false;
+    for (;;) {
+      set_clock(false);
+      top_->eval();
+      is_ar_done |= top_->s_axi_control_ARVALID && top_->s_axi_control_ARREADY;
+      if (top_->s_axi_control_RVALID) {
+        const uint32_t data = top_->s_axi_control_RDATA;
+        cycle();
+        top_->s_axi_control_RREADY = 0;
+        return data;
+      }
+      cycle();
+      top_->s_axi_control_ARVALID = !is_ar_done;
+    }
+  }
+
+  std::unique_ptr<VerilatedContext> context_;
+  std::unique_ptr<Top> top_;
+  std::string dir_;
+  std::vector<arg_t> args_;
+  void (*clock_hook_)(Top& top, bool clk) = nullptr;
+  uint64_t cycles_ = 0;
+};
+
+}  // namespace verilator
+}  // namespace tapa
+
+// Type and ports of the AXI memory of mmap `name` of `top`.
+#define TAPA_M_AXI(top, name)                               \
+  tapa::verilator::m_axi<decltype((top).m_axi_##name##_RDATA), \
+                         decltype((top).m_axi_##name##_WSTRB)>
+#define TAPA_M_AXI_PORTS(top, name)                                       \
+  {                                                                       \
+    (top).m_axi_##name##_ARADDR, (top).m_axi_##name##_ARID,               \
+        (top).m_axi_##name##_ARLEN, (top).m_axi_##name##_ARREADY,         \
+        (top).m_axi_##name##_ARVALID, (top).m_axi_##name##_AWADDR,        \
+        (top).m_axi_##name##_AWID, (top).m_axi_##name##_AWLEN,            \
+        (top).m_axi_##name##_AWREADY, (top).m_axi_##name##_AWVALID,       \
+        (top).m_axi_##name##_BID, (top).m_axi_##name##_BREADY,            \
+        (top).m_axi_##name##_BRESP, (top).m_axi_##name##_BVALID,          \
+        (top).m_axi_##name##_RDATA, (top).m_axi_##name##_RID,             \
+        (top).m_axi_##name##_RLAST, (top).m_axi_##name##_RREADY,          \
+        (top).m_axi_##name##_RRESP, (top).m_axi_##name##_RVALID,          \
+        (top).m_axi_##name##_WDATA, (top).m_axi_##name##_WLAST,           \
+        (top).m_axi_##name##_WREADY, (top).m_axi_##name##_WSTRB,          \
+        (top).m_axi_##name##_WVALID                                       \
+  }
+
+#endif  // TAPA_VERILATOR_H_
@@ -0,0 +1,92 @@
+`default_nettype none
+
+// relays the ap_ctrl_hs handshake between an instance in the m_clk domain and
+// its parent in the s_clk domain
+module ap_ctrl_cdc (
+  input  wire s_clk,
+  input  wire s_rst_n,
+  input  wire s_ap_start,
+  output wire s_ap_done,
+  output wire s_ap_idle,
+  output wire s_ap_ready,
+
+  input  wire m_clk,
+  input  wire m_rst_n,
+  output wire m_ap_start,
+  input  wire m_ap_done,
+  input  wire m_ap_idle,
+  input  wire m_ap_ready
+);
+
+  // each event is relayed by flipping a toggle register in the source domain
+  // and detecting the flip after synchronizing it to the destination domain
+  reg start_toggle;
+  reg ready_toggle;
+  reg done_toggle;
+
+  (* ASYNC_REG = "TRUE" *) reg [2:0] start_sync;
+  (* ASYNC_REG = "TRUE" *) reg [2:0] ready_sync;
+  (* ASYNC_REG = "TRUE" *) reg [2:0] done_sync;
+  (* ASYNC_REG = "TRUE" *) reg [1:0] idle_sync;
+
+  // s_clk domain
+  reg busy;          // start is relayed but ready is not yet
+  reg done_pending;  // done arrived before ready; hold it until ready arrives
+
+  wire ready_event = ready_sync[2] ^ ready_sync[1];
+  wire done_event  = done_sync[2] ^ done_sync[1];
+
+  assign s_ap_ready = ready_event;
+  assign s_ap_done  = (done_event || done_pending) && (!busy || ready_event);
+  assign s_ap_idle  = idle_sync[1];
+
+  always @(posedge s_clk) begin
+    if (!s_rst_n) begin
+      start_toggle <= 1'b0;
+      busy         <= 1'b0;
+      done_pending <= 1'b0;
+      ready_sync   <= 3'b0;
+      done_sync    <= 3'b0;
+      idle_sync    <= 2'b11;
+    end else begin
+      ready_sync   <= {ready_sync[1:0], ready_toggle};
+      done_sync    <= {done_sync[1:0], done_toggle};
+      idle_sync    <= {idle_sync[0], m_ap_idle};
+      done_pending <= (done_event || done_pending) && !s_ap_done;
+      if (s_ap_start && !busy) begin
+        start_toggle <= ~start_toggle;
+        busy         <= 1'b1;
+      end else if (ready_event) begin
+        busy <= 1'b0;
+      end
+    end
+  end
+
+  // m_clk domain
+  reg start_q;
+
+  assign m_ap_start = start_q;
+
+  always @(posedge m_clk) begin
+    if (!m_rst_n) begin
+      start_q      <= 1'b0;
+      ready_toggle <= 1'b0;
+      done_toggle  <= 1'b0;
+      start_sync   <= 3'b0;
+    end else begin
+      start_sync <= {start_sync[1:0], start_toggle};
+      if (start_sync[2] ^ start_sync[1]) begin
+        start_q <= 1'b1;
+      end else if (start_q && m_ap_ready) begin
+        start_q      <= 1'b0;
+        ready_toggle <= ~ready_toggle;
+      end
+      if (m_ap_done) begin
+        done_toggle <= ~done_toggle;
+      end
+    end
+  end
+
+endmodule  // ap_ctrl_cdc
+
+`default_nettype wire
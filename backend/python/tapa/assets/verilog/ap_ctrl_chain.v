@@ -0,0 +1,81 @@
+`default_nettype none
+
+// ap_ctrl_chain control of a top-level task: the next invocation is accepted
+// once every child has started the last one, so that invocations overlap, and
+// each invocation is done once every child has finished it
+module ap_ctrl_chain #(
+  parameter ChildCount    = 1,
+  parameter Latency       = 8,  // cycles from ap_ready to fresh ap_start and
+                                // child_busy, must be less than 2 ** 8
+  parameter InFlightLog   = 2   // up to 2 ** InFlightLog - 1 invocations
+) (
+  input  wire clk,
+  input  wire rst,  // active high
+
+  input  wire ap_start,
+  output wire ap_ready,
+  output wire ap_done,
+  output wire ap_idle,
+  input  wire ap_continue,
+
+  // whether each child has an invocation to start
+  input  wire [ChildCount-1:0] child_busy,
+  // pulsed when each child finishes an invocation
+  input  wire [ChildCount-1:0] child_done
+);
+
+  reg [InFlightLog-1:0] started;   // invocations accepted
+  reg [InFlightLog-1:0] finished;  // invocations acknowledged by ap_continue
+  reg [7:0]             blackout;  // ap_start and child_busy may be stale
+
+  // invocations finished by each child
+  reg [ChildCount*InFlightLog-1:0] child_finished;
+
+  wire [InFlightLog-1:0] in_flight = started - finished;
+
+  reg all_finished;
+  integer i;
+  always @ (*) begin
+    all_finished = started != finished;
+    for (i = 0; i < ChildCount; i = i + 1) begin
+      if (child_finished[i*InFlightLog +: InFlightLog] == finished) begin
+        all_finished = 1'b0;
+      end
+    end
+  end
+
+  wire accept = ap_start && blackout == 0 && child_busy == 0 &&
+                in_flight != {InFlightLog{1'b1}};
+
+  assign ap_ready = accept;
+  assign ap_done  = all_finished;
+  assign ap_idle  = in_flight == 0;
+
+  always @ (posedge clk) begin
+    if (rst) begin
+      started        <= 0;
+      finished       <= 0;
+      blackout       <= 0;
+      child_finished <= 0;
+    end
+    else begin
+      if (accept) begin
+        started  <= started + 1;
+        blackout <= Latency;
+      end
+      else if (blackout != 0) begin
+        blackout <= blackout - 1;
+      end
+      if (all_finished && ap_continue) finished <= finished + 1;
+      for (i = 0; i < ChildCount; i = i + 1) begin
+        if (child_done[i]) begin
+          child_finished[i*InFlightLog +: InFlightLog] <=
+              child_finished[i*InFlightLog +: InFlightLog] + 1;
+        end
+      end
+    end
+  end
+
+endmodule  // ap_ctrl_chain
+
+`default_nettype wire
@@ -0,0 +1,113 @@
+`default_nettype none
+
+// first-word fall-through (FWFT) FIFO whose write and read sides are in
+// different clock domains
+module async_fifo #(
+  parameter DATA_WIDTH = 32,
+  parameter ADDR_WIDTH = 4,
+  parameter DEPTH      = 16  // must be 2 ** ADDR_WIDTH and ADDR_WIDTH >= 2
+) (
+  input wire wr_clk,
+  input wire wr_reset,
+  input wire rd_clk,
+  input wire rd_reset,
+
+  // write
+  output wire                  if_full_n,
+  input  wire                  if_write_ce,
+  input  wire                  if_write,
+  input  wire [DATA_WIDTH-1:0] if_din,
+
+  // read
+  output wire                  if_empty_n,
+  input  wire                  if_read_ce,
+  input  wire                  if_read,
+  output wire [DATA_WIDTH-1:0] if_dout
+);
+
+  function [ADDR_WIDTH:0] bin2gray(input [ADDR_WIDTH:0] bin);
+    bin2gray = bin ^ (bin >> 1);
+  endfunction
+
+  (* ram_style = "distributed" *)
+  reg [DATA_WIDTH-1:0] mem [0:DEPTH-1];
+
+  // pointers have one extra bit to tell a full FIFO from an empty one; only
+  // the gray-coded pointers cross clock domains
+  reg [ADDR_WIDTH:0] wr_bin;
+  reg [ADDR_WIDTH:0] wr_gray;
+  reg [ADDR_WIDTH:0] rd_bin;
+  reg [ADDR_WIDTH:0] rd_gray;
+
+  (* ASYNC_REG = "TRUE" *) reg [ADDR_WIDTH:0] rd_gray_q0;
+  (* ASYNC_REG = "TRUE" *) reg [ADDR_WIDTH:0] rd_gray_q1;
+  (* ASYNC_REG = "TRUE" *) reg [ADDR_WIDTH:0] wr_gray_q0;
+  (* ASYNC_REG = "TRUE" *) reg [ADDR_WIDTH:0] wr_gray_q1;
+
+  // write domain
+  wire [ADDR_WIDTH:0] wr_bin_next = wr_bin + 1'b1;
+  wire full = wr_gray == {~rd_gray_q1[ADDR_WIDTH:ADDR_WIDTH-1],
+                          rd_gray_q1[ADDR_WIDTH-2:0]};
+  wire push = if_write_ce && if_write && !full;
+
+  assign if_full_n = !full;
+
+  always @(posedge wr_clk) begin
+    if (wr_reset) begin
+      wr_bin     <= 0;
+      wr_gray    <= 0;
+      rd_gray_q0 <= 0;
+      rd_gray_q1 <= 0;
+    end else begin
+      rd_gray_q0 <= rd_gray;
+      rd_gray_q1 <= rd_gray_q0;
+      if (push) begin
+        wr_bin  <= wr_bin_next;
+        wr_gray <= bin2gray(wr_bin_next);
+      end
+    end
+  end
+
+  always @(posedge wr_clk) begin
+    if (push) mem[wr_bin[ADDR_WIDTH-1:0]] <= if_din;
+  end
+
+  // read domain; the output register makes the FIFO first-word fall-through
+  reg                  dout_valid;
+  reg [DATA_WIDTH-1:0] dout;
+
+  wire [ADDR_WIDTH:0] rd_bin_next = rd_bin + 1'b1;
+  wire mem_empty = rd_gray == wr_gray_q1;
+  wire pop = if_read_ce && if_read && dout_valid;
+  wire fetch = !mem_empty && (!dout_valid || pop);
+
+  assign if_empty_n = dout_valid;
+  assign if_dout    = dout;
+
+  always @(posedge rd_clk) begin
+    if (rd_reset) begin
+      rd_bin     <= 0;
+      rd_gray    <= 0;
+      wr_gray_q0 <= 0;
+      wr_gray_q1 <= 0;
+      dout_valid <= 1'b0;
+    end else begin
+      wr_gray_q0 <= wr_gray;
+      wr_gray_q1 <= wr_gray_q0;
+      if (fetch) begin
+        rd_bin     <= rd_bin_next;
+        rd_gray    <= bin2gray(rd_bin_next);
+        dout_valid <= 1'b1;
+      end else if (pop) begin
+        dout_valid <= 1'b0;
+      end
+    end
+  end
+
+  always @(posedge rd_clk) begin
+    if (fetch) dout <= mem[rd_bin[ADDR_WIDTH-1:0]];
+  end
+
+endmodule  // async_fifo
+
+`default_nettype wire
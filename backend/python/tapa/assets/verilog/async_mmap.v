@@ -12,7 +12,22 @@ module async_mmap #(
   // implement the FIFOs for the read channel
   // if set to 0: disconnect the data link
   parameter EnableReadChannel = 1,
-  parameter EnableWriteChannel= 1
+  parameter EnableWriteChannel= 1,
+  // read bursts are issued round-robin on 2 ** IdWidth AXI IDs and may
+  // complete out of order across IDs; a reorder buffer restores the order
+  parameter IdWidth                  = 1,
+  parameter MaxOutstandingReads      = 64,  // must be >= 2 ** IdWidth
+  parameter MaxOutstandingReadsLog   = 6,   // must equal log2(MaxOutstandingReads)
+  parameter ReorderBufferDepth       = 64,  // in beats; must hold a whole burst
+  parameter ReorderBufferDepthLog    = 6,   // must equal log2(ReorderBufferDepth)
+  // writes to the same line of 2 ** WriteCombineLineLenLog elements that
+  // arrive less than WriteCombineWindow cycles apart are combined into one
+  // burst with byte strobes; set WriteCombineLineLenLog to 0 to disable
+  parameter WriteCombineLineLenLog   = 0,
+  parameter WriteCombineWindow       = 16,
+  // if set to 1: the user writes {byte strobes, data} to write_data_din, so
+  // that only the bytes whose strobes are set are written
+  parameter WriteStrobe              = 0
 ) (
   input wire clk,
   input wire rst, // active high
@@ -25,7 +40,7 @@ module async_mmap #(
   output wire                 m_axi_AWVALID,
   input  wire                 m_axi_AWREADY,
   output wire [AxiSideAddrWidth-1:0] m_axi_AWADDR,
-  output wire [0:0]           m_axi_AWID,
+  output wire [IdWidth-1:0]   m_axi_AWID,
   output wire [7:0]           m_axi_AWLEN,
   output wire [2:0]           m_axi_AWSIZE,
   output wire [1:0]           m_axi_AWBURST,
@@ -45,13 +60,13 @@ module async_mmap #(
   input  wire       m_axi_BVALID,
   output wire       m_axi_BREADY,
   input  wire [1:0] m_axi_BRESP,
-  input  wire [0:0] m_axi_BID,
+  input  wire [IdWidth-1:0] m_axi_BID,
 
   // axi read addr channel
   output wire                 m_axi_ARVALID,
   input  wire                 m_axi_ARREADY,
   output wire [AxiSideAddrWidth-1:0] m_axi_ARADDR,
-  output wire [0:0]           m_axi_ARID,
+  output wire [IdWidth-1:0]   m_axi_ARID,
   output wire [7:0]           m_axi_ARLEN,
   output wire [2:0]           m_axi_ARSIZE,
   output wire [1:0]           m_axi_ARBURST,
@@ -65,7 +80,7 @@ module async_mmap #(
   output wire                 m_axi_RREADY,
   input  wire [DataWidth-1:0] m_axi_RDATA,
   input  wire                 m_axi_RLAST,
-  input  wire [0:0]           m_axi_RID,
+  input  wire [IdWidth-1:0]   m_axi_RID,
   input  wire [1:0]           m_axi_RRESP,
 
   // push read addr here
@@ -82,7 +97,8 @@ module async_mmap #(
   input  wire [AddrWidth-1:0] write_addr_din,
   input  wire                 write_addr_write,
   output wire                 write_addr_full_n,
-  input  wire [DataWidth-1:0] write_data_din,
+  // UserDataWidth bits wide, which cannot be used before its declaration
+  input  wire [(WriteStrobe ? DataWidth + DataWidth / 8 : DataWidth)-1:0] write_data_din,
   input  wire                 write_data_write,
   output wire                 write_data_full_n,
 
@@ -92,40 +108,11 @@ module async_mmap #(
   output wire       write_resp_empty_n
 );
 
-  // add flow control between the read_addr channel and the read_data channel
-  // if the read_data channel is close to full, stop issuing more read requests
-  // buffer size set by FlowControlBufferDepth
-  parameter FlowControlThreshold = 48;
-  parameter FlowControlThresholdLog2 = $clog2(FlowControlThreshold)+1; // make the counter larger in case overflow
-  reg [FlowControlThresholdLog2: 0] counter; // # of outstanding read
+  // write data with byte strobes, i.e., {strobes, data}
+  localparam StrbDataWidth = DataWidth + DataWidth / 8;
+  localparam UserDataWidth = WriteStrobe ? StrbDataWidth : DataWidth;
 
-  wire allow_issue_read_addr = counter < FlowControlThreshold;
-  reg allow_issue_read_addr_q;
-  always @ (posedge clk) allow_issue_read_addr_q <= allow_issue_read_addr;
-
-  wire read_addr_write_internal;
-  wire read_addr_full_n_internal;
-  assign read_addr_write_internal = read_addr_write & allow_issue_read_addr_q;
-  assign read_addr_full_n = read_addr_full_n_internal & allow_issue_read_addr_q;
-
-  wire addr_write_en = read_addr_write_internal & read_addr_full_n_internal;
-  wire data_read_en = read_data_read & read_data_empty_n;
-
-  always @ (posedge clk) begin
-    if (rst) begin
-      counter <= 0;
-    end
-    else begin
-      if (addr_write_en & !data_read_en) begin
-        counter <= counter + 1;
-      end
-      else if (!addr_write_en & data_read_en) begin
-        counter <= counter - 1;
-      end
-    end
-  end
-
-  // write addr buffer, from user to burst detector
+  // write addr buffer, from user to write combiner
   wire [AddrWidth-1:0] write_addr_dout;
   wire                 write_addr_empty_n;
   wire                 write_addr_read;
@@ -145,7 +132,7 @@ module async_mmap #(
     .if_write   (write_addr_write),
     .if_din     (write_addr_din),
 
-    // to burst detector
+    // to write combiner
     .if_empty_n(write_addr_empty_n),
     .if_read_ce(1'b1),
     .if_read   (write_addr_read),
@@ -181,6 +168,144 @@ module async_mmap #(
   wire burst_write_last_dout;
   wire burst_write_last_empty_n;
 
+  // write data buffer, from user to write combiner
+  wire [UserDataWidth-1:0] write_data_dout;
+  wire                 write_data_empty_n;
+  wire                 write_data_read;
+  relay_station #(
+    .DATA_WIDTH(UserDataWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableWriteChannel)
+  ) write_data (
+    .clk  (clk),
+    .reset(rst),
+
+    // from user
+    .if_full_n  (write_data_full_n),
+    .if_write_ce(1'b1),
+    .if_write   (write_data_write),
+    .if_din     (write_data_din),
+
+    // to write combiner
+    .if_empty_n(write_data_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (write_data_read),
+    .if_dout   (write_data_dout)
+  );
+
+  // write data with byte strobes, all set unless the user provides them
+  wire [StrbDataWidth-1:0] strb_write_data_dout;
+
+  generate
+    if (WriteStrobe) begin : user_strb
+      assign strb_write_data_dout = write_data_dout;
+    end
+    else begin : full_strb
+      assign strb_write_data_dout = {{(DataWidth/8){1'b1}}, write_data_dout};
+    end
+  endgenerate
+
+  // combined write addr and data, from write combiner to burst detector and
+  // axi; the MSB of data tells whether the element is written, or is a hole
+  // in a combined line whose byte strobes are cleared
+  wire [AddrWidth-1:0] combined_write_addr_dout;
+  wire                 combined_write_addr_empty_n;
+  wire                 combined_write_addr_read;
+  wire [StrbDataWidth:0] combined_write_data_dout;
+  wire                 combined_write_data_empty_n;
+  wire                 combined_write_data_read;
+
+  generate
+    if (WriteCombineLineLenLog > 0) begin : combine
+      wire [AddrWidth-1:0] addr_din;
+      wire                 addr_full_n;
+      wire                 addr_write;
+      wire [StrbDataWidth:0] data_din;
+      wire                 data_full_n;
+      wire                 data_write;
+
+      write_combine #(
+        .AddrWidth        (AddrWidth),
+        .DataWidth        (StrbDataWidth),
+        .DataWidthBytesLog(DataWidthBytesLog),
+        .LineLenLog       (WriteCombineLineLenLog),
+        .WindowCycles     (WriteCombineWindow)
+      ) unit (
+        .clk(clk),
+        .rst(rst),
+
+        // input: individual writes
+        .addr_dout   (write_addr_dout),
+        .addr_empty_n(write_addr_empty_n),
+        .addr_read   (write_addr_read),
+        .data_dout   (strb_write_data_dout),
+        .data_empty_n(write_data_empty_n),
+        .data_read   (write_data_read),
+
+        // output: combined writes
+        .addr_din   (addr_din),
+        .addr_full_n(addr_full_n),
+        .addr_write (addr_write),
+        .data_din   (data_din),
+        .data_full_n(data_full_n),
+        .data_write (data_write)
+      );
+
+      relay_station #(
+        .DATA_WIDTH(AddrWidth),
+        .ADDR_WIDTH(BufferSizeLog),
+        .DEPTH     (BufferSize),
+        .CONNECT   (EnableWriteChannel)
+      ) addr (
+        .clk  (clk),
+        .reset(rst),
+
+        // from write combiner
+        .if_full_n  (addr_full_n),
+        .if_write_ce(1'b1),
+        .if_write   (addr_write),
+        .if_din     (addr_din),
+
+        // to burst detector
+        .if_empty_n(combined_write_addr_empty_n),
+        .if_read_ce(1'b1),
+        .if_read   (combined_write_addr_read),
+        .if_dout   (combined_write_addr_dout)
+      );
+
+      relay_station #(
+        .DATA_WIDTH(StrbDataWidth + 1),
+        .ADDR_WIDTH(BufferSizeLog),
+        .DEPTH     (BufferSize),
+        .CONNECT   (EnableWriteChannel)
+      ) data (
+        .clk  (clk),
+        .reset(rst),
+
+        // from write combiner
+        .if_full_n  (data_full_n),
+        .if_write_ce(1'b1),
+        .if_write   (data_write),
+        .if_din     (data_din),
+
+        // to axi
+        .if_empty_n(combined_write_data_empty_n),
+        .if_read_ce(1'b1),
+        .if_read   (combined_write_data_read),
+        .if_dout   (combined_write_data_dout)
+      );
+    end
+    else begin : bypass
+      assign combined_write_addr_dout    = write_addr_dout;
+      assign combined_write_addr_empty_n = write_addr_empty_n;
+      assign write_addr_read             = combined_write_addr_read;
+      assign combined_write_data_dout    = {1'b1, strb_write_data_dout};
+      assign combined_write_data_empty_n = write_data_empty_n;
+      assign write_data_read             = combined_write_data_read;
+    end
+  endgenerate
+
   detect_burst #(
     .AddrWidth        (AddrWidth),
     .DataWidthBytesLog(DataWidthBytesLog),
@@ -194,9 +319,9 @@ module async_mmap #(
     .max_burst_len(max_burst_len),
 
     // input: individual addresses
-    .addr_dout   (write_addr_dout),
-    .addr_empty_n(write_addr_empty_n),
-    .addr_read   (write_addr_read),
+    .addr_dout   (combined_write_addr_dout),
+    .addr_empty_n(combined_write_addr_empty_n),
+    .addr_read   (combined_write_addr_read),
 
     // output: inferred burst addresses
     .addr_din   (burst_write_addr_din),
@@ -317,40 +442,60 @@ module async_mmap #(
     .if_empty_n(burst_write_last_empty_n),
     .if_read_ce(1'b1),
     // deal with when last-relay_station is non-empty while data-relay_station is empty
-    .if_read   (m_axi_WREADY && write_data_empty_n),
+    .if_read   (m_axi_WREADY && combined_write_data_empty_n),
     .if_dout   (burst_write_last_dout)
   );
 
-  // write data buffer
-  wire [DataWidth-1:0] write_data_dout;
-  wire                 write_data_empty_n;
+  // deal with when data-relay_station is non empty but last-relay_station is empty
+  assign combined_write_data_read = m_axi_WREADY && burst_write_last_empty_n;
+
+  // number of elements written by each burst, excluding holes of combined
+  // lines; this buffer never overflows because it holds no more bursts than
+  // the write req buffer
+  reg  [BurstLenWidth:0] write_count;
+  wire [BurstLenWidth:0] write_count_din =
+      write_count + combined_write_data_dout[StrbDataWidth];
+  wire                   write_count_write = m_axi_WVALID && m_axi_WREADY && m_axi_WLAST;
+  wire [BurstLenWidth:0] write_count_dout;
+  wire                   write_count_empty_n;
+
+  always @ (posedge clk) begin
+    if (rst) begin
+      write_count <= 0;
+    end
+    else if (m_axi_WVALID && m_axi_WREADY) begin
+      write_count <= m_axi_WLAST ? 0 : write_count_din;
+    end
+  end
+
   relay_station #(
-    .DATA_WIDTH(DataWidth),
+    .DATA_WIDTH(BurstLenWidth + 1),
     .ADDR_WIDTH(BufferSizeLog),
     .DEPTH     (BufferSize),
     .CONNECT   (EnableWriteChannel)
-  ) write_data (
+  ) write_count_buf (
     .clk  (clk),
     .reset(rst),
 
-    // from user
-    .if_full_n  (write_data_full_n),
+    // from axi W channel
+    .if_full_n  (),
     .if_write_ce(1'b1),
-    .if_write   (write_data_write),
-    .if_din     (write_data_din),
+    .if_write   (write_count_write),
+    .if_din     (write_count_din),
 
-    // to axi
-    .if_empty_n(write_data_empty_n),
+    // to write resp buffer
+    .if_empty_n(write_count_empty_n),
     .if_read_ce(1'b1),
-    // deal with when data-relay_station is non empty but last-relay_station is empty
-    .if_read   (m_axi_WREADY && burst_write_last_empty_n),
-    .if_dout   (write_data_dout)
+    .if_read   (write_req_read),
+    .if_dout   (write_count_dout)
   );
 
-  // write resp buffer
-  wire [BurstLenWidth-1:0] write_resp_din   = write_req_dout;
-  wire                     write_resp_write = m_axi_BVALID && write_req_empty_n;
+  // write resp buffer; bursts that consist of holes only are not responded
   wire                     write_resp_full_n;
+  wire                     write_resp_skip  = write_count_dout == 0;
+  wire [BurstLenWidth-1:0] write_resp_din   = write_count_dout - 1;
+  wire                     write_resp_write =
+      m_axi_BVALID && m_axi_BREADY && !write_resp_skip;
   relay_station #(
     .DATA_WIDTH(BurstLenWidth),
     .ADDR_WIDTH(BufferSizeLog),
@@ -387,14 +532,17 @@ module async_mmap #(
   assign m_axi_AWQOS    = 0;
 
   // W channel
-  assign m_axi_WVALID = write_data_empty_n && burst_write_last_empty_n;
-  assign m_axi_WDATA  = write_data_dout;
-  assign m_axi_WSTRB  = {(DataWidth/8){1'b1}};  // assume every bit is valid
+  assign m_axi_WVALID = combined_write_data_empty_n && burst_write_last_empty_n;
+  assign m_axi_WDATA  = combined_write_data_dout[DataWidth-1:0];
+  assign m_axi_WSTRB  =
+      combined_write_data_dout[StrbDataWidth-1:DataWidth] &
+      {(DataWidth/8){combined_write_data_dout[StrbDataWidth]}};
   assign m_axi_WLAST  = burst_write_last_dout;
 
   // B channel
-  assign m_axi_BREADY   = write_resp_full_n && write_req_empty_n;
-  assign write_req_read = write_resp_full_n && m_axi_BVALID;
+  assign m_axi_BREADY   = (write_resp_full_n || write_resp_skip) &&
+                          write_req_empty_n && write_count_empty_n;
+  assign write_req_read = m_axi_BVALID && m_axi_BREADY;
 
   // read addr buffer, from user to burst detector
   wire [AddrWidth-1:0] read_addr_dout;
@@ -411,9 +559,9 @@ module async_mmap #(
     .reset(rst),
 
     // from user
-    .if_full_n  (read_addr_full_n_internal),
+    .if_full_n  (read_addr_full_n),
     .if_write_ce(1'b1),
-    .if_write   (read_addr_write_internal),
+    .if_write   (read_addr_write),
     .if_din     (read_addr_din),
 
     // to axi
@@ -512,11 +660,38 @@ module async_mmap #(
     .if_dout   (read_data_dout)
   );
 
+  // reorder buffer (ROB) for read responses; each burst is assigned a tag in
+  // issue order, and its beats are reserved in the ROB before it is issued,
+  // so that responses can always be accepted
+  localparam NumIds = 1 << IdWidth;
+
+  reg [DataWidth-1:0] rob_mem [0:ReorderBufferDepth-1];
+  reg [ReorderBufferDepth-1:0] rob_valid;
+
+  // pointers have one extra bit to tell a full ROB from an empty one
+  reg [ReorderBufferDepthLog:0] rob_alloc_ptr;  // next beat to reserve
+  reg [ReorderBufferDepthLog:0] rob_head_ptr;   // next beat to drain
+
+  // per-tag state
+  reg [MaxOutstandingReads-1:0]  tag_busy;
+  reg [ReorderBufferDepthLog-1:0] tag_base [0:MaxOutstandingReads-1];
+  reg [MaxOutstandingReadsLog-1:0] issue_tag;
+
+  // per-ID state; responses with the same ID arrive in issue order, so each
+  // ID only needs to track its oldest burst in flight
+  reg [MaxOutstandingReadsLog-1:0] resp_tag    [0:NumIds-1];
+  reg [BurstLenWidth-1:0]          resp_offset [0:NumIds-1];
+
   // AR channel
-  assign burst_read_addr_read = m_axi_ARREADY;
-  assign m_axi_ARVALID        = burst_read_addr_empty_n;
+  wire [ReorderBufferDepthLog:0] rob_used = rob_alloc_ptr - rob_head_ptr;
+  wire [BurstLenWidth:0] burst_read_beats = burst_read_addr_dout_burst_len + 1;
+  wire rob_fits = rob_used + burst_read_beats <= ReorderBufferDepth;
+  wire ar_fire = m_axi_ARVALID && m_axi_ARREADY;
+
+  assign burst_read_addr_read = m_axi_ARREADY && !tag_busy[issue_tag] && rob_fits;
+  assign m_axi_ARVALID        = burst_read_addr_empty_n && !tag_busy[issue_tag] && rob_fits;
   assign m_axi_ARADDR         = {{(AxiSideAddrWidth - AddrWidth){1'b0}}, burst_read_addr_dout_addr};
-  assign m_axi_ARID           = 0;
+  assign m_axi_ARID           = issue_tag[IdWidth-1:0];
   assign m_axi_ARLEN          = burst_read_addr_dout_burst_len;
   assign m_axi_ARSIZE         = DataWidthBytesLog;
   assign m_axi_ARBURST        = 1;        // INCR mode
@@ -525,17 +700,90 @@ module async_mmap #(
   assign m_axi_ARPROT         = 0;
   assign m_axi_ARQOS          = 0;
 
-  // R channel
-  assign m_axi_RREADY    = read_data_full_n;
-  assign read_data_write = m_axi_RVALID;
-  assign read_data_din   = m_axi_RDATA;
+  // R channel; ROB space is reserved at issue time, so responses are always
+  // accepted and registered once before they are written into the ROB
+  assign m_axi_RREADY = 1'b1;
+
+  reg                 r_valid_q;
+  reg [DataWidth-1:0] r_data_q;
+  reg [IdWidth-1:0]   r_id_q;
+  reg                 r_last_q;
+
+  always @ (posedge clk) begin
+    r_valid_q <= !rst && m_axi_RVALID;
+    r_data_q  <= m_axi_RDATA;
+    r_id_q    <= m_axi_RID;
+    r_last_q  <= m_axi_RLAST;
+  end
+
+  wire [MaxOutstandingReadsLog-1:0] r_tag = resp_tag[r_id_q];
+  wire [ReorderBufferDepthLog-1:0]  r_addr = tag_base[r_tag] + resp_offset[r_id_q];
+
+  // drain the ROB in issue order to the read resp buffer through an output
+  // register
+  reg                 rob_dout_valid;
+  reg [DataWidth-1:0] rob_dout;
+
+  wire [ReorderBufferDepthLog-1:0] rob_head = rob_head_ptr[ReorderBufferDepthLog-1:0];
+  wire rob_pop = rob_valid[rob_head] && (!rob_dout_valid || read_data_full_n);
+
+  assign read_data_write = rob_dout_valid && read_data_full_n;
+  assign read_data_din   = rob_dout;
+
+  integer i;
+  always @ (posedge clk) begin
+    if (rst) begin
+      rob_valid      <= 0;
+      rob_alloc_ptr  <= 0;
+      rob_head_ptr   <= 0;
+      tag_busy       <= 0;
+      issue_tag      <= 0;
+      rob_dout_valid <= 1'b0;
+      for (i = 0; i < NumIds; i = i + 1) begin
+        resp_tag[i]    <= i;
+        resp_offset[i] <= 0;
+      end
+    end
+    else begin
+      if (ar_fire) begin
+        tag_busy[issue_tag] <= 1'b1;
+        tag_base[issue_tag] <= rob_alloc_ptr[ReorderBufferDepthLog-1:0];
+        rob_alloc_ptr       <= rob_alloc_ptr + burst_read_beats;
+        issue_tag           <= issue_tag + 1;
+      end
+
+      if (r_valid_q) begin
+        rob_valid[r_addr] <= 1'b1;
+        if (r_last_q) begin
+          tag_busy[r_tag]     <= 1'b0;
+          resp_tag[r_id_q]    <= r_tag + NumIds;
+          resp_offset[r_id_q] <= 0;
+        end
+        else begin
+          resp_offset[r_id_q] <= resp_offset[r_id_q] + 1;
+        end
+      end
+
+      if (rob_pop) begin
+        rob_valid[rob_head] <= 1'b0;
+        rob_head_ptr        <= rob_head_ptr + 1;
+        rob_dout_valid      <= 1'b1;
+      end
+      else if (read_data_full_n) begin
+        rob_dout_valid <= 1'b0;
+      end
+    end
+  end
+
+  always @ (posedge clk) begin
+    if (r_valid_q) rob_mem[r_addr] <= r_data_q;
+    if (rob_pop) rob_dout <= rob_mem[rob_head];
+  end
 
   // unused input signals
   wire _unused = &{1'b0,
     m_axi_BRESP,
     m_axi_BID,
-    m_axi_RLAST,
-    m_axi_RID,
     m_axi_RRESP,
     1'b0};
 
@@ -0,0 +1,468 @@
+`default_nettype none
+
+// async_mmap whose writes are updates that add their data to memory, served by
+// a read-modify-write unit in front of its channels
+module atomic_async_mmap #(
+  parameter BufferSize        = 32,
+  parameter BufferSizeLog     = 5,
+  parameter AddrWidth         = 64,
+  parameter AxiSideAddrWidth  = 64,
+  parameter DataWidth         = 512,
+  parameter DataWidthBytesLog = 6,  // must equal log2(DataWidth/8)
+  parameter WaitTimeWidth     = 4,
+  parameter BurstLenWidth     = 8,
+  // implement the FIFOs for the read channel
+  // if set to 0: disconnect the data link
+  parameter EnableReadChannel = 1,
+  parameter EnableWriteChannel= 1,
+  // read bursts are issued round-robin on 2 ** IdWidth AXI IDs and may
+  // complete out of order across IDs; a reorder buffer restores the order
+  parameter IdWidth                  = 1,
+  parameter MaxOutstandingReads      = 64,  // must be >= 2 ** IdWidth
+  parameter MaxOutstandingReadsLog   = 6,   // must equal log2(MaxOutstandingReads)
+  parameter ReorderBufferDepth       = 64,  // in beats; must hold a whole burst
+  parameter ReorderBufferDepthLog    = 6,   // must equal log2(ReorderBufferDepth)
+  // maximum number of requests between being accepted and being served
+  parameter RequestBufferSize        = 128,
+  parameter RequestBufferSizeLog     = 7,   // must equal log2(RequestBufferSize)
+  // maximum number of updates between being accepted and being acknowledged
+  parameter UpdateSlots              = 16,  // must be a power of 2
+  parameter UpdateSlotsLog           = 4    // must equal log2(UpdateSlots)
+) (
+  input wire clk,
+  input wire rst, // active high
+
+  // for burst inference
+  input wire [WaitTimeWidth-1:0] max_wait_time,
+  input wire [BurstLenWidth-1:0] max_burst_len,
+
+  // axi write addr channel
+  output wire                 m_axi_AWVALID,
+  input  wire                 m_axi_AWREADY,
+  output wire [AxiSideAddrWidth-1:0] m_axi_AWADDR,
+  output wire [IdWidth-1:0]   m_axi_AWID,
+  output wire [7:0]           m_axi_AWLEN,
+  output wire [2:0]           m_axi_AWSIZE,
+  output wire [1:0]           m_axi_AWBURST,
+  output wire [0:0]           m_axi_AWLOCK,
+  output wire [3:0]           m_axi_AWCACHE,
+  output wire [2:0]           m_axi_AWPROT,
+  output wire [3:0]           m_axi_AWQOS,
+
+  // axi write data channel
+  output wire                   m_axi_WVALID,
+  input  wire                   m_axi_WREADY,
+  output wire [DataWidth-1:0]   m_axi_WDATA,
+  output wire [DataWidth/8-1:0] m_axi_WSTRB,
+  output wire                   m_axi_WLAST,
+
+  // axi write acknowledge channel
+  input  wire       m_axi_BVALID,
+  output wire       m_axi_BREADY,
+  input  wire [1:0] m_axi_BRESP,
+  input  wire [IdWidth-1:0] m_axi_BID,
+
+  // axi read addr channel
+  output wire                 m_axi_ARVALID,
+  input  wire                 m_axi_ARREADY,
+  output wire [AxiSideAddrWidth-1:0] m_axi_ARADDR,
+  output wire [IdWidth-1:0]   m_axi_ARID,
+  output wire [7:0]           m_axi_ARLEN,
+  output wire [2:0]           m_axi_ARSIZE,
+  output wire [1:0]           m_axi_ARBURST,
+  output wire [0:0]           m_axi_ARLOCK,
+  output wire [3:0]           m_axi_ARCACHE,
+  output wire [2:0]           m_axi_ARPROT,
+  output wire [3:0]           m_axi_ARQOS,
+
+  // axi read response channel
+  input  wire                 m_axi_RVALID,
+  output wire                 m_axi_RREADY,
+  input  wire [DataWidth-1:0] m_axi_RDATA,
+  input  wire                 m_axi_RLAST,
+  input  wire [IdWidth-1:0]   m_axi_RID,
+  input  wire [1:0]           m_axi_RRESP,
+
+  // push read addr here
+  input  wire [AddrWidth-1:0] read_addr_din,
+  input  wire                 read_addr_write,
+  output wire                 read_addr_full_n,
+
+  // pop read resp here
+  output wire [DataWidth-1:0] read_data_dout,
+  input  wire                 read_data_read,
+  output wire                 read_data_empty_n,
+
+  // push update addr and data here
+  input  wire [AddrWidth-1:0] write_addr_din,
+  input  wire                 write_addr_write,
+  output wire                 write_addr_full_n,
+  input  wire [DataWidth-1:0] write_data_din,
+  input  wire                 write_data_write,
+  output wire                 write_data_full_n,
+
+  // pop update resp here
+  output wire [7:0] write_resp_dout,
+  input  wire       write_resp_read,
+  output wire       write_resp_empty_n
+);
+
+  // reads and updates are accepted in order into the request buffer, and are
+  // served in that order. An update reads its element from memory and writes
+  // back the sum. Each update takes a slot until its write is acknowledged; an
+  // update to the address of the latest update in the slots takes the result
+  // of that update instead of reading memory, which may not have it yet.
+
+  // user requests; update addresses and data are paired here
+  wire [AddrWidth-1:0] user_read_addr_dout;
+  wire                 user_read_addr_empty_n;
+  wire                 user_read_addr_read;
+  wire [AddrWidth-1:0] update_addr_dout;
+  wire                 update_addr_empty_n;
+  wire                 update_addr_read;
+  wire [DataWidth-1:0] update_data_dout;
+  wire                 update_data_empty_n;
+  wire                 update_data_read;
+
+  relay_station #(
+    .DATA_WIDTH(AddrWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableReadChannel)
+  ) user_read_addr (
+    .clk  (clk),
+    .reset(rst),
+
+    // from user
+    .if_full_n  (read_addr_full_n),
+    .if_write_ce(1'b1),
+    .if_write   (read_addr_write),
+    .if_din     (read_addr_din),
+
+    // to request buffer
+    .if_empty_n(user_read_addr_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (user_read_addr_read),
+    .if_dout   (user_read_addr_dout)
+  );
+
+  relay_station #(
+    .DATA_WIDTH(AddrWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableWriteChannel)
+  ) update_addr (
+    .clk  (clk),
+    .reset(rst),
+
+    // from user
+    .if_full_n  (write_addr_full_n),
+    .if_write_ce(1'b1),
+    .if_write   (write_addr_write),
+    .if_din     (write_addr_din),
+
+    // to request buffer
+    .if_empty_n(update_addr_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (update_addr_read),
+    .if_dout   (update_addr_dout)
+  );
+
+  relay_station #(
+    .DATA_WIDTH(DataWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableWriteChannel)
+  ) update_data (
+    .clk  (clk),
+    .reset(rst),
+
+    // from user
+    .if_full_n  (write_data_full_n),
+    .if_write_ce(1'b1),
+    .if_write   (write_data_write),
+    .if_din     (write_data_din),
+
+    // to request buffer
+    .if_empty_n(update_data_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (update_data_read),
+    .if_dout   (update_data_dout)
+  );
+
+  // request buffer credits; a credit is taken when a request is accepted and
+  // returned when it is served, so neither the request buffer nor the memory
+  // read address buffer can overflow
+  reg [RequestBufferSizeLog:0] credits;
+
+  // update slots, allocated and acknowledged in order
+  reg [UpdateSlotsLog:0]   slots_used;
+  reg [UpdateSlotsLog-1:0] slot_head;  // oldest unacknowledged update
+  reg [UpdateSlotsLog-1:0] slot_tail;  // next update
+  reg [UpdateSlots-1:0]    slot_valid;
+  reg [UpdateSlots-1:0]    slot_latest;  // latest update of its address
+  reg [AddrWidth-1:0]      slot_addr [0:UpdateSlots-1];
+  (* ram_style = "distributed" *)
+  reg [DataWidth-1:0]      slot_result [0:UpdateSlots-1];
+
+  // accept a read or an update per cycle, alternating if both are pending
+  reg  prefer_read;
+  wire update_ready = update_addr_empty_n && update_data_empty_n &&
+                      slots_used != UpdateSlots;
+  wire accept_update = credits != 0 && update_ready &&
+                       (!user_read_addr_empty_n || !prefer_read);
+  wire accept_read = credits != 0 && user_read_addr_empty_n && !accept_update;
+
+  assign user_read_addr_read = accept_read;
+  assign update_addr_read    = accept_update;
+  assign update_data_read    = accept_update;
+
+  // hazard detection; at most one slot is the latest of an address
+  reg [UpdateSlots-1:0]    update_match;
+  reg [UpdateSlotsLog-1:0] update_source;
+  integer i;
+  always @ (*) begin
+    update_source = 0;
+    for (i = 0; i < UpdateSlots; i = i + 1) begin
+      update_match[i] = slot_valid[i] && slot_latest[i] &&
+                        slot_addr[i] == update_addr_dout;
+      if (update_match[i]) update_source = i;
+    end
+  end
+  wire update_forward = |update_match;
+
+  // request buffer: {is update, is forwarded, source slot, slot, addr, data}
+  localparam ReqWidth = 2 + UpdateSlotsLog * 2 + AddrWidth + DataWidth;
+
+  wire                      req_empty_n;
+  wire                      req_read;
+  wire                      req_dout_update;
+  wire                      req_dout_forward;
+  wire [UpdateSlotsLog-1:0] req_dout_source;
+  wire [UpdateSlotsLog-1:0] req_dout_slot;
+  wire [AddrWidth-1:0]      req_dout_addr;
+  wire [DataWidth-1:0]      req_dout_data;
+
+  fifo #(
+    .DATA_WIDTH(ReqWidth),
+    .ADDR_WIDTH(RequestBufferSizeLog),
+    .DEPTH     (RequestBufferSize)
+  ) req (
+    .clk  (clk),
+    .reset(rst),
+
+    // from user
+    .if_full_n  (),
+    .if_write_ce(1'b1),
+    .if_write   (accept_read || accept_update),
+    .if_din     ({accept_update, update_forward, update_source, slot_tail,
+                  update_addr_dout, update_data_dout}),
+
+    // to memory
+    .if_empty_n(req_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (req_read),
+    .if_dout   ({req_dout_update, req_dout_forward, req_dout_source,
+                 req_dout_slot, req_dout_addr, req_dout_data})
+  );
+
+  // memory read address buffer, for reads and updates not forwarded
+  wire [AddrWidth-1:0] mem_read_addr_dout;
+  wire                 mem_read_addr_empty_n;
+  wire                 mem_read_addr_full_n;
+
+  fifo #(
+    .DATA_WIDTH(AddrWidth),
+    .ADDR_WIDTH(RequestBufferSizeLog),
+    .DEPTH     (RequestBufferSize)
+  ) mem_read_addr (
+    .clk  (clk),
+    .reset(rst),
+
+    // from user
+    .if_full_n  (),
+    .if_write_ce(1'b1),
+    .if_write   (accept_read || accept_update && !update_forward),
+    .if_din     (accept_update ? update_addr_dout : user_read_addr_dout),
+
+    // to memory
+    .if_empty_n(mem_read_addr_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (mem_read_addr_full_n),
+    .if_dout   (mem_read_addr_dout)
+  );
+
+  // the memory
+  wire [DataWidth-1:0] mem_read_data_dout;
+  wire                 mem_read_data_empty_n;
+  wire                 mem_read_data_read;
+  wire [AddrWidth-1:0] mem_write_addr_din;
+  wire                 mem_write_addr_full_n;
+  wire [DataWidth-1:0] mem_write_data_din;
+  wire                 mem_write_data_full_n;
+  wire                 mem_write_write;
+
+  async_mmap #(
+    .BufferSize            (BufferSize),
+    .BufferSizeLog         (BufferSizeLog),
+    .AddrWidth             (AddrWidth),
+    .AxiSideAddrWidth      (AxiSideAddrWidth),
+    .DataWidth             (DataWidth),
+    .DataWidthBytesLog     (DataWidthBytesLog),
+    .WaitTimeWidth         (WaitTimeWidth),
+    .BurstLenWidth         (BurstLenWidth),
+    .EnableReadChannel     (1),
+    .EnableWriteChannel    (EnableWriteChannel),
+    .IdWidth               (IdWidth),
+    .MaxOutstandingReads   (MaxOutstandingReads),
+    .MaxOutstandingReadsLog(MaxOutstandingReadsLog),
+    .ReorderBufferDepth    (ReorderBufferDepth),
+    .ReorderBufferDepthLog (ReorderBufferDepthLog)
+  ) mem (
+    .clk               (clk),
+    .rst               (rst),
+    .max_wait_time     (max_wait_time),
+    .max_burst_len     (max_burst_len),
+    .m_axi_AWVALID     (m_axi_AWVALID),
+    .m_axi_AWREADY     (m_axi_AWREADY),
+    .m_axi_AWADDR      (m_axi_AWADDR),
+    .m_axi_AWID        (m_axi_AWID),
+    .m_axi_AWLEN       (m_axi_AWLEN),
+    .m_axi_AWSIZE      (m_axi_AWSIZE),
+    .m_axi_AWBURST     (m_axi_AWBURST),
+    .m_axi_AWLOCK      (m_axi_AWLOCK),
+    .m_axi_AWCACHE     (m_axi_AWCACHE),
+    .m_axi_AWPROT      (m_axi_AWPROT),
+    .m_axi_AWQOS       (m_axi_AWQOS),
+    .m_axi_WVALID      (m_axi_WVALID),
+    .m_axi_WREADY      (m_axi_WREADY),
+    .m_axi_WDATA       (m_axi_WDATA),
+    .m_axi_WSTRB       (m_axi_WSTRB),
+    .m_axi_WLAST       (m_axi_WLAST),
+    .m_axi_BVALID      (m_axi_BVALID),
+    .m_axi_BREADY      (m_axi_BREADY),
+    .m_axi_BRESP       (m_axi_BRESP),
+    .m_axi_BID         (m_axi_BID),
+    .m_axi_ARVALID     (m_axi_ARVALID),
+    .m_axi_ARREADY     (m_axi_ARREADY),
+    .m_axi_ARADDR      (m_axi_ARADDR),
+    .m_axi_ARID        (m_axi_ARID),
+    .m_axi_ARLEN       (m_axi_ARLEN),
+    .m_axi_ARSIZE      (m_axi_ARSIZE),
+    .m_axi_ARBURST     (m_axi_ARBURST),
+    .m_axi_ARLOCK      (m_axi_ARLOCK),
+    .m_axi_ARCACHE     (m_axi_ARCACHE),
+    .m_axi_ARPROT      (m_axi_ARPROT),
+    .m_axi_ARQOS       (m_axi_ARQOS),
+    .m_axi_RVALID      (m_axi_RVALID),
+    .m_axi_RREADY      (m_axi_RREADY),
+    .m_axi_RDATA       (m_axi_RDATA),
+    .m_axi_RLAST       (m_axi_RLAST),
+    .m_axi_RID         (m_axi_RID),
+    .m_axi_RRESP       (m_axi_RRESP),
+    .read_addr_din     (mem_read_addr_dout),
+    .read_addr_write   (mem_read_addr_empty_n && mem_read_addr_full_n),
+    .read_addr_full_n  (mem_read_addr_full_n),
+    .read_data_dout    (mem_read_data_dout),
+    .read_data_read    (mem_read_data_read),
+    .read_data_empty_n (mem_read_data_empty_n),
+    .write_addr_din    (mem_write_addr_din),
+    .write_addr_write  (mem_write_write),
+    .write_addr_full_n (mem_write_addr_full_n),
+    .write_data_din    (mem_write_data_din),
+    .write_data_write  (mem_write_write),
+    .write_data_full_n (mem_write_data_full_n),
+    .write_resp_dout   (write_resp_dout),
+    .write_resp_read   (write_resp_read),
+    .write_resp_empty_n(write_resp_empty_n)
+  );
+
+  // serve the requests in order; a forwarded update takes the result of its
+  // source slot, which is older and thus already served
+  wire read_data_full_n_internal;
+  wire serve_read = req_empty_n && !req_dout_update &&
+                    mem_read_data_empty_n && read_data_full_n_internal;
+  wire serve_update = req_empty_n && req_dout_update &&
+                      (req_dout_forward || mem_read_data_empty_n) &&
+                      mem_write_addr_full_n && mem_write_data_full_n;
+
+  wire [DataWidth-1:0] update_old =
+      req_dout_forward ? slot_result[req_dout_source] : mem_read_data_dout;
+  wire [DataWidth-1:0] update_new = update_old + req_dout_data;
+
+  assign req_read           = serve_read || serve_update;
+  assign mem_read_data_read = serve_read || serve_update && !req_dout_forward;
+  assign mem_write_write    = serve_update;
+  assign mem_write_addr_din = req_dout_addr;
+  assign mem_write_data_din = update_new;
+
+  relay_station #(
+    .DATA_WIDTH(DataWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableReadChannel)
+  ) read_data (
+    .clk  (clk),
+    .reset(rst),
+
+    // from memory
+    .if_full_n  (read_data_full_n_internal),
+    .if_write_ce(1'b1),
+    .if_write   (serve_read),
+    .if_din     (mem_read_data_dout),
+
+    // to user
+    .if_empty_n(read_data_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (read_data_read),
+    .if_dout   (read_data_dout)
+  );
+
+  // each write response acknowledges write_resp_dout + 1 updates in order
+  wire       ack = write_resp_read && write_resp_empty_n;
+  wire [8:0] ack_count = write_resp_dout + 1;
+
+  reg [UpdateSlots-1:0]    slot_acked;
+  reg [UpdateSlotsLog-1:0] slot_offset;
+  always @ (*) begin
+    for (i = 0; i < UpdateSlots; i = i + 1) begin
+      slot_offset   = i - slot_head;
+      slot_acked[i] = ack && slot_offset < ack_count;
+    end
+  end
+
+  wire [UpdateSlots-1:0] slot_alloc =
+      accept_update ? {{(UpdateSlots-1){1'b0}}, 1'b1} << slot_tail : 0;
+  wire [UpdateSlots-1:0] slot_outdated = accept_update ? update_match : 0;
+
+  always @ (posedge clk) begin
+    if (accept_update) slot_addr[slot_tail] <= update_addr_dout;
+    if (serve_update) slot_result[req_dout_slot] <= update_new;
+  end
+
+  always @ (posedge clk) begin
+    if (rst) begin
+      credits     <= RequestBufferSize;
+      slots_used  <= 0;
+      slot_head   <= 0;
+      slot_tail   <= 0;
+      slot_valid  <= 0;
+      slot_latest <= 0;
+      prefer_read <= 1'b0;
+    end
+    else begin
+      credits <= credits - (accept_read || accept_update) +
+                 (serve_read || serve_update);
+      slots_used <= slots_used + accept_update - (ack ? ack_count : 0);
+      if (ack) slot_head <= slot_head + ack_count;
+      if (accept_update) slot_tail <= slot_tail + 1;
+      slot_valid  <= slot_valid & ~slot_acked | slot_alloc;
+      slot_latest <= slot_latest & ~slot_outdated | slot_alloc;
+      if (accept_update) prefer_read <= 1'b1;
+      else if (accept_read) prefer_read <= 1'b0;
+    end
+  end
+
+endmodule  // atomic_async_mmap
+
+`default_nettype wire
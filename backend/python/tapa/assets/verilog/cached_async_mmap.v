@@ -0,0 +1,401 @@
+`default_nettype none
+
+// async_mmap with a read-only cache in front of its read channel
+module cached_async_mmap #(
+  parameter BufferSize        = 32,
+  parameter BufferSizeLog     = 5,
+  parameter AddrWidth         = 64,
+  parameter AxiSideAddrWidth  = 64,
+  parameter DataWidth         = 512,
+  parameter DataWidthBytesLog = 6,  // must equal log2(DataWidth/8)
+  parameter WaitTimeWidth     = 4,
+  parameter BurstLenWidth     = 8,
+  // implement the FIFOs for the read channel
+  // if set to 0: disconnect the data link
+  parameter EnableReadChannel = 1,
+  parameter EnableWriteChannel= 1,
+  // read bursts are issued round-robin on 2 ** IdWidth AXI IDs and may
+  // complete out of order across IDs; a reorder buffer restores the order
+  parameter IdWidth                  = 1,
+  parameter MaxOutstandingReads      = 64,  // must be >= 2 ** IdWidth
+  parameter MaxOutstandingReadsLog   = 6,   // must equal log2(MaxOutstandingReads)
+  parameter ReorderBufferDepth       = 64,  // in beats; must hold a whole burst
+  parameter ReorderBufferDepthLog    = 6,   // must equal log2(ReorderBufferDepth)
+  // the cache holds CacheSets * CacheWays lines of one element each
+  parameter CacheWays                = 1,   // must be a power of 2
+  parameter CacheSets                = 256, // must be a power of 2 and >= 2
+  parameter CacheSetsLog             = 8,   // must equal log2(CacheSets)
+  parameter CacheMemStyle            = "block",
+  // maximum number of read requests between read_addr and read_data
+  parameter RequestBufferSize        = 128,
+  parameter RequestBufferSizeLog     = 7,   // must equal log2(RequestBufferSize)
+  // see async_mmap
+  parameter WriteCombineLineLenLog   = 0,
+  parameter WriteCombineWindow       = 16
+) (
+  input wire clk,
+  input wire rst, // active high
+
+  // the cache is invalidated whenever start rises
+  input wire start,
+
+  // for burst inference
+  input wire [WaitTimeWidth-1:0] max_wait_time,
+  input wire [BurstLenWidth-1:0] max_burst_len,
+
+  // axi write addr channel
+  output wire                 m_axi_AWVALID,
+  input  wire                 m_axi_AWREADY,
+  output wire [AxiSideAddrWidth-1:0] m_axi_AWADDR,
+  output wire [IdWidth-1:0]   m_axi_AWID,
+  output wire [7:0]           m_axi_AWLEN,
+  output wire [2:0]           m_axi_AWSIZE,
+  output wire [1:0]           m_axi_AWBURST,
+  output wire [0:0]           m_axi_AWLOCK,
+  output wire [3:0]           m_axi_AWCACHE,
+  output wire [2:0]           m_axi_AWPROT,
+  output wire [3:0]           m_axi_AWQOS,
+
+  // axi write data channel
+  output wire                   m_axi_WVALID,
+  input  wire                   m_axi_WREADY,
+  output wire [DataWidth-1:0]   m_axi_WDATA,
+  output wire [DataWidth/8-1:0] m_axi_WSTRB,
+  output wire                   m_axi_WLAST,
+
+  // axi write acknowledge channel
+  input  wire       m_axi_BVALID,
+  output wire       m_axi_BREADY,
+  input  wire [1:0] m_axi_BRESP,
+  input  wire [IdWidth-1:0] m_axi_BID,
+
+  // axi read addr channel
+  output wire                 m_axi_ARVALID,
+  input  wire                 m_axi_ARREADY,
+  output wire [AxiSideAddrWidth-1:0] m_axi_ARADDR,
+  output wire [IdWidth-1:0]   m_axi_ARID,
+  output wire [7:0]           m_axi_ARLEN,
+  output wire [2:0]           m_axi_ARSIZE,
+  output wire [1:0]           m_axi_ARBURST,
+  output wire [0:0]           m_axi_ARLOCK,
+  output wire [3:0]           m_axi_ARCACHE,
+  output wire [2:0]           m_axi_ARPROT,
+  output wire [3:0]           m_axi_ARQOS,
+
+  // axi read response channel
+  input  wire                 m_axi_RVALID,
+  output wire                 m_axi_RREADY,
+  input  wire [DataWidth-1:0] m_axi_RDATA,
+  input  wire                 m_axi_RLAST,
+  input  wire [IdWidth-1:0]   m_axi_RID,
+  input  wire [1:0]           m_axi_RRESP,
+
+  // push read addr here
+  input  wire [AddrWidth-1:0] read_addr_din,
+  input  wire                 read_addr_write,
+  output wire                 read_addr_full_n,
+
+  // pop read resp here
+  output wire [DataWidth-1:0] read_data_dout,
+  input  wire                 read_data_read,
+  output wire                 read_data_empty_n,
+
+  // push write addr and data here
+  input  wire [AddrWidth-1:0] write_addr_din,
+  input  wire                 write_addr_write,
+  output wire                 write_addr_full_n,
+  input  wire [DataWidth-1:0] write_data_din,
+  input  wire                 write_data_write,
+  output wire                 write_data_full_n,
+
+  // pop write resp here
+  output wire [7:0] write_resp_dout,
+  input  wire       write_resp_read,
+  output wire       write_resp_empty_n
+);
+
+  localparam TagWidth = AddrWidth - DataWidthBytesLog - CacheSetsLog;
+
+  // read requests are looked up in the cache in order; hits carry their data
+  // and misses carry their address through the request buffer, which is
+  // drained in order, so that read_data stays in the order of read_addr
+
+  // request buffer credits; a credit is taken when a request is accepted and
+  // returned when its data is sent, so neither the request buffer nor the
+  // miss address buffer can overflow
+  reg [RequestBufferSizeLog:0] credits;
+
+  wire req_accept = read_addr_write && read_addr_full_n;
+  wire [CacheSetsLog-1:0] req_set =
+      read_addr_din[DataWidthBytesLog +: CacheSetsLog];
+
+  assign read_addr_full_n = credits != 0;
+
+  // writes invalidate the set of the written address
+  wire write_invalidate = write_addr_write && write_addr_full_n;
+  wire [CacheSetsLog-1:0] write_set =
+      write_addr_din[DataWidthBytesLog +: CacheSetsLog];
+
+  reg  start_q;
+  wire flush = start && !start_q;
+
+  // lookup stage; lines filled or invalidated in the cycle a request is
+  // accepted are not looked up, and such requests miss instead
+  reg                 lookup_valid;
+  reg [AddrWidth-1:0] lookup_addr;
+  reg                 lookup_conflict;
+
+  wire [TagWidth-1:0] lookup_tag = lookup_addr[AddrWidth-1 -: TagWidth];
+
+  // fill stage
+  wire                    fill;
+  wire [AddrWidth-1:0]    fill_addr;
+  wire [DataWidth-1:0]    fill_data;
+  reg  [7:0]              fill_way;  // round-robin replacement
+  wire [CacheSetsLog-1:0] fill_set =
+      fill_addr[DataWidthBytesLog +: CacheSetsLog];
+  wire [TagWidth-1:0]     fill_tag = fill_addr[AddrWidth-1 -: TagWidth];
+
+  wire [CacheWays-1:0]           way_hit;
+  wire [CacheWays*DataWidth-1:0] way_data;
+
+  genvar w;
+  generate
+    for (w = 0; w < CacheWays; w = w + 1) begin : way
+      (* ram_style = CacheMemStyle *)
+      reg [TagWidth+DataWidth-1:0] lines [0:CacheSets-1];
+      reg [TagWidth+DataWidth-1:0] line_q;
+      reg [CacheSets-1:0]          line_valid;
+      reg                          line_valid_q;
+
+      always @ (posedge clk) begin
+        if (fill && fill_way == w) lines[fill_set] <= {fill_tag, fill_data};
+        if (req_accept) line_q <= lines[req_set];
+      end
+
+      always @ (posedge clk) begin
+        if (rst || flush) begin
+          line_valid <= 0;
+        end
+        else begin
+          if (fill && fill_way == w) line_valid[fill_set] <= 1'b1;
+          if (write_invalidate) line_valid[write_set] <= 1'b0;
+        end
+        if (req_accept) line_valid_q <= line_valid[req_set];
+      end
+
+      assign way_hit[w] = line_valid_q && !lookup_conflict &&
+          line_q[TagWidth+DataWidth-1:DataWidth] == lookup_tag;
+      assign way_data[w*DataWidth +: DataWidth] = line_q[DataWidth-1:0];
+    end
+  endgenerate
+
+  reg [DataWidth-1:0] hit_data;
+  integer i;
+  always @ (*) begin
+    hit_data = 0;
+    for (i = 0; i < CacheWays; i = i + 1) begin
+      hit_data = hit_data |
+          (way_data[i*DataWidth +: DataWidth] & {DataWidth{way_hit[i]}});
+    end
+  end
+
+  always @ (posedge clk) begin
+    if (rst) begin
+      lookup_valid <= 1'b0;
+    end
+    else begin
+      lookup_valid <= req_accept;
+    end
+    lookup_addr     <= read_addr_din;
+    lookup_conflict <= fill && fill_set == req_set ||
+                       write_invalidate && write_set == req_set || flush;
+  end
+
+  wire lookup_hit = |way_hit;
+
+  // request buffer: {hit, addr, data}
+  wire                 req_empty_n;
+  wire                 req_read;
+  wire                 req_dout_hit;
+  wire [AddrWidth-1:0] req_dout_addr;
+  wire [DataWidth-1:0] req_dout_data;
+
+  fifo #(
+    .DATA_WIDTH(1 + AddrWidth + DataWidth),
+    .ADDR_WIDTH(RequestBufferSizeLog),
+    .DEPTH     (RequestBufferSize)
+  ) req (
+    .clk  (clk),
+    .reset(rst),
+
+    // from lookup
+    .if_full_n  (),
+    .if_write_ce(1'b1),
+    .if_write   (lookup_valid),
+    .if_din     ({lookup_hit, lookup_addr, hit_data}),
+
+    // to read_data
+    .if_empty_n(req_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (req_read),
+    .if_dout   ({req_dout_hit, req_dout_addr, req_dout_data})
+  );
+
+  // miss address buffer, from lookup to memory
+  wire [AddrWidth-1:0] miss_addr_dout;
+  wire                 miss_addr_empty_n;
+  wire                 mem_read_addr_full_n;
+
+  fifo #(
+    .DATA_WIDTH(AddrWidth),
+    .ADDR_WIDTH(RequestBufferSizeLog),
+    .DEPTH     (RequestBufferSize)
+  ) miss_addr (
+    .clk  (clk),
+    .reset(rst),
+
+    // from lookup
+    .if_full_n  (),
+    .if_write_ce(1'b1),
+    .if_write   (lookup_valid && !lookup_hit),
+    .if_din     (lookup_addr),
+
+    // to memory
+    .if_empty_n(miss_addr_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (mem_read_addr_full_n),
+    .if_dout   (miss_addr_dout)
+  );
+
+  // the uncached memory
+  wire [DataWidth-1:0] mem_read_data_dout;
+  wire                 mem_read_data_empty_n;
+  wire                 mem_read_data_read;
+
+  async_mmap #(
+    .BufferSize            (BufferSize),
+    .BufferSizeLog         (BufferSizeLog),
+    .AddrWidth             (AddrWidth),
+    .AxiSideAddrWidth      (AxiSideAddrWidth),
+    .DataWidth             (DataWidth),
+    .DataWidthBytesLog     (DataWidthBytesLog),
+    .WaitTimeWidth         (WaitTimeWidth),
+    .BurstLenWidth         (BurstLenWidth),
+    .EnableReadChannel     (EnableReadChannel),
+    .EnableWriteChannel    (EnableWriteChannel),
+    .IdWidth               (IdWidth),
+    .MaxOutstandingReads   (MaxOutstandingReads),
+    .MaxOutstandingReadsLog(MaxOutstandingReadsLog),
+    .ReorderBufferDepth    (ReorderBufferDepth),
+    .ReorderBufferDepthLog (ReorderBufferDepthLog),
+    .WriteCombineLineLenLog(WriteCombineLineLenLog),
+    .WriteCombineWindow    (WriteCombineWindow)
+  ) mem (
+    .clk               (clk),
+    .rst               (rst),
+    .max_wait_time     (max_wait_time),
+    .max_burst_len     (max_burst_len),
+    .m_axi_AWVALID     (m_axi_AWVALID),
+    .m_axi_AWREADY     (m_axi_AWREADY),
+    .m_axi_AWADDR      (m_axi_AWADDR),
+    .m_axi_AWID        (m_axi_AWID),
+    .m_axi_AWLEN       (m_axi_AWLEN),
+    .m_axi_AWSIZE      (m_axi_AWSIZE),
+    .m_axi_AWBURST     (m_axi_AWBURST),
+    .m_axi_AWLOCK      (m_axi_AWLOCK),
+    .m_axi_AWCACHE     (m_axi_AWCACHE),
+    .m_axi_AWPROT      (m_axi_AWPROT),
+    .m_axi_AWQOS       (m_axi_AWQOS),
+    .m_axi_WVALID      (m_axi_WVALID),
+    .m_axi_WREADY      (m_axi_WREADY),
+    .m_axi_WDATA       (m_axi_WDATA),
+    .m_axi_WSTRB       (m_axi_WSTRB),
+    .m_axi_WLAST       (m_axi_WLAST),
+    .m_axi_BVALID      (m_axi_BVALID),
+    .m_axi_BREADY      (m_axi_BREADY),
+    .m_axi_BRESP       (m_axi_BRESP),
+    .m_axi_BID         (m_axi_BID),
+    .m_axi_ARVALID     (m_axi_ARVALID),
+    .m_axi_ARREADY     (m_axi_ARREADY),
+    .m_axi_ARADDR      (m_axi_ARADDR),
+    .m_axi_ARID        (m_axi_ARID),
+    .m_axi_ARLEN       (m_axi_ARLEN),
+    .m_axi_ARSIZE      (m_axi_ARSIZE),
+    .m_axi_ARBURST     (m_axi_ARBURST),
+    .m_axi_ARLOCK      (m_axi_ARLOCK),
+    .m_axi_ARCACHE     (m_axi_ARCACHE),
+    .m_axi_ARPROT      (m_axi_ARPROT),
+    .m_axi_ARQOS       (m_axi_ARQOS),
+    .m_axi_RVALID      (m_axi_RVALID),
+    .m_axi_RREADY      (m_axi_RREADY),
+    .m_axi_RDATA       (m_axi_RDATA),
+    .m_axi_RLAST       (m_axi_RLAST),
+    .m_axi_RID         (m_axi_RID),
+    .m_axi_RRESP       (m_axi_RRESP),
+    .read_addr_din     (miss_addr_dout),
+    .read_addr_write   (miss_addr_empty_n && mem_read_addr_full_n),
+    .read_addr_full_n  (mem_read_addr_full_n),
+    .read_data_dout    (mem_read_data_dout),
+    .read_data_read    (mem_read_data_read),
+    .read_data_empty_n (mem_read_data_empty_n),
+    .write_addr_din    (write_addr_din),
+    .write_addr_write  (write_addr_write),
+    .write_addr_full_n (write_addr_full_n),
+    .write_data_din    (write_data_din),
+    .write_data_write  (write_data_write),
+    .write_data_full_n (write_data_full_n),
+    .write_resp_dout   (write_resp_dout),
+    .write_resp_read   (write_resp_read),
+    .write_resp_empty_n(write_resp_empty_n)
+  );
+
+  // read resp buffer; misses are filled into the cache as they are sent
+  wire read_data_full_n_internal;
+  wire read_data_write = req_empty_n && read_data_full_n_internal &&
+                         (req_dout_hit || mem_read_data_empty_n);
+
+  assign req_read           = read_data_write;
+  assign mem_read_data_read = read_data_write && !req_dout_hit;
+  assign fill               = mem_read_data_read;
+  assign fill_addr          = req_dout_addr;
+  assign fill_data          = mem_read_data_dout;
+
+  relay_station #(
+    .DATA_WIDTH(DataWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableReadChannel)
+  ) read_data (
+    .clk  (clk),
+    .reset(rst),
+
+    // from request buffer and memory
+    .if_full_n  (read_data_full_n_internal),
+    .if_write_ce(1'b1),
+    .if_write   (read_data_write),
+    .if_din     (req_dout_hit ? req_dout_data : mem_read_data_dout),
+
+    // to user
+    .if_empty_n(read_data_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (read_data_read),
+    .if_dout   (read_data_dout)
+  );
+
+  always @ (posedge clk) begin
+    if (rst) begin
+      credits  <= RequestBufferSize;
+      fill_way <= 0;
+      start_q  <= 1'b0;
+    end
+    else begin
+      credits <= credits - req_accept + read_data_write;
+      if (fill) fill_way <= fill_way == CacheWays - 1 ? 0 : fill_way + 1;
+      start_q <= start;
+    end
+  end
+
+endmodule  // cached_async_mmap
+
+`default_nettype wire
@@ -1,6 +1,8 @@
 `default_nettype none
 
-// Detect burst from address stream.
+// Detect burst from address stream. An address whose top BurstLenWidth bits
+// are non-zero is an explicit burst request of that many beats plus 1, which
+// is issued as is, split into bursts of at most max_burst_len + 1 beats.
 module detect_burst #(
   parameter AddrWidth         = 64,
   parameter DataWidthBytesLog = 6,
@@ -38,6 +40,9 @@ module detect_burst #(
   reg [BurstLenWidth-1:0] burst_len;
   reg [WaitTimeWidth-1:0] wait_time;
   reg [NextAddrWidth-1:0] next_addr;
+  reg [AddrWidth-1:0]     explicit_addr;
+  reg [BurstLenWidth-1:0] explicit_len;  // beats left minus 1
+  reg                     explicit_valid;
 
   // logic
   reg                     write_enable;
@@ -45,8 +50,20 @@ module detect_burst #(
   reg                     base_valid_next;
   reg [BurstLenWidth-1:0] burst_len_next;
   reg [WaitTimeWidth-1:0] wait_time_next;
+  reg [AddrWidth-1:0]     explicit_addr_next;
+  reg [BurstLenWidth-1:0] explicit_len_next;
+  reg                     explicit_valid_next;
 
   wire [AddrWidth-1:0] curr_addr = addr_dout;
+  wire [BurstLenWidth-1:0] curr_len =
+      curr_addr[AddrWidth-1:AddrWidth-BurstLenWidth];
+  wire curr_explicit = curr_len != 0;
+
+  // the explicit burst fits in one issued burst
+  wire explicit_last = explicit_len <= max_burst_len;
+  wire [BurstLenWidth-1:0] out_len =
+      explicit_valid ? (explicit_last ? explicit_len : max_burst_len) :
+                       burst_len;
 
   wire [NextAddrWidth-1:0] next_addr_next =
       base_addr_next[AddrWidth-1:DataWidthBytesLog] +
@@ -56,9 +73,9 @@ module detect_burst #(
   assign addr_write = write_enable;
   assign burst_len_0_write = write_enable;
   assign burst_len_1_write = write_enable;
-  assign addr_din = {burst_len, base_addr};
-  assign burst_len_0_din = burst_len;
-  assign burst_len_1_din = burst_len;
+  assign addr_din = {out_len, explicit_valid ? explicit_addr : base_addr};
+  assign burst_len_0_din = out_len;
+  assign burst_len_1_din = out_len;
 
   always @* begin
     // defaults
@@ -68,8 +85,36 @@ module detect_burst #(
     base_valid_next = base_valid;
     wait_time_next = wait_time;
     burst_len_next = burst_len;
+    explicit_addr_next = explicit_addr;
+    explicit_len_next = explicit_len;
+    explicit_valid_next = explicit_valid;
     if (!addr_full_n || !burst_len_0_full_n || !burst_len_1_full_n) begin
       // output FIFO full, do nothing
+    end else if (explicit_valid) begin
+      // issue the explicit burst, or its next part
+      write_enable = 1'b1;
+      if (explicit_last) begin
+        explicit_valid_next = 1'b0;
+      end else begin
+        explicit_addr_next = explicit_addr +
+            (({{(AddrWidth-BurstLenWidth){1'b0}}, max_burst_len} + 1) <<
+             DataWidthBytesLog);
+        explicit_len_next = explicit_len - max_burst_len - 1;
+      end
+    end else if (addr_empty_n && curr_explicit) begin
+      if (base_valid) begin
+        // issue the detected burst first
+        write_enable = 1'b1;
+        wait_time_next = 0;
+        base_valid_next = 1'b0;
+        burst_len_next = 0;
+      end else begin
+        addr_read = 1'b1;
+        explicit_addr_next =
+            {{BurstLenWidth{1'b0}}, curr_addr[AddrWidth-BurstLenWidth-1:0]};
+        explicit_len_next = curr_len;
+        explicit_valid_next = 1'b1;
+      end
     end else if (addr_empty_n) begin
       // read new item if non-empty
       addr_read = 1'b1;
@@ -124,12 +169,18 @@ module detect_burst #(
       burst_len <= {BurstLenWidth{1'b0}};
       wait_time <= {WaitTimeWidth{1'b0}};
       next_addr <= {{(NextAddrWidth-1){1'b0}}, 1'b1};
+      explicit_addr <= {AddrWidth{1'b0}};
+      explicit_len <= {BurstLenWidth{1'b0}};
+      explicit_valid <= 1'b0;
     end else begin
       base_addr <= base_addr_next;
       base_valid <= base_valid_next;
       burst_len <= burst_len_next;
       wait_time <= wait_time_next;
       next_addr <= next_addr_next;
+      explicit_addr <= explicit_addr_next;
+      explicit_len <= explicit_len_next;
+      explicit_valid <= explicit_valid_next;
     end
   end
 
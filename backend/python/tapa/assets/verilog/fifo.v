@@ -4,7 +4,8 @@
 module fifo #(
   parameter DATA_WIDTH = 32,
   parameter ADDR_WIDTH = 5,
-  parameter DEPTH      = 32
+  parameter DEPTH      = 32,
+  parameter IMPL       = "auto"  // "auto", "srl", "lutram", "bram" or "uram"
 ) (
   input wire clk,
   input wire reset,
@@ -22,6 +23,17 @@ module fifo #(
   output wire [DATA_WIDTH-1:0] if_dout
 );
 
+// the memory is chosen by IMPL, or by the width and depth if IMPL is "auto":
+// URAM for deep and wide FIFOs, BRAM for deep FIFOs that fill at least a
+// quarter of a BRAM36, and SRL otherwise, which is the cheapest for shallow
+// FIFOs however wide they are
+localparam USE_URAM   = IMPL == "uram" ||
+                        IMPL == "auto" && DATA_WIDTH >= 36 && DEPTH >= 4096;
+localparam USE_BRAM   = IMPL == "bram" ||
+                        IMPL == "auto" && DEPTH >= 128 &&
+                        DATA_WIDTH * DEPTH >= 9216;
+localparam USE_LUTRAM = IMPL == "lutram";
+
 generate
   if (DEPTH == 1) begin : d1
     fifo_fwd #(
@@ -40,7 +52,7 @@ generate
       .if_read   (if_read),
       .if_dout   (if_dout)
     );
-  end else if (DATA_WIDTH >= 36 && DEPTH >= 4096) begin : uram
+  end else if (USE_URAM) begin : uram
     fifo_bram #(
       .MEM_STYLE ("ultra"),
       .DATA_WIDTH(DATA_WIDTH),
@@ -60,7 +72,7 @@ generate
       .if_read   (if_read),
       .if_dout   (if_dout)
     );
-  end else if (DEPTH >=128) begin : bram
+  end else if (USE_BRAM) begin : bram
     fifo_bram #(
       .MEM_STYLE ("block"),
       .DATA_WIDTH(DATA_WIDTH),
@@ -75,6 +87,26 @@ generate
       .if_write   (if_write),
       .if_din     (if_din),
 
+      .if_empty_n(if_empty_n),
+      .if_read_ce(if_read_ce),
+      .if_read   (if_read),
+      .if_dout   (if_dout)
+    );
+  end else if (USE_LUTRAM) begin : lutram
+    fifo_bram #(
+      .MEM_STYLE ("distributed"),
+      .DATA_WIDTH(DATA_WIDTH),
+      .ADDR_WIDTH(ADDR_WIDTH),
+      .DEPTH     (DEPTH)
+    ) unit (
+      .clk  (clk),
+      .reset(reset),
+
+      .if_full_n  (if_full_n),
+      .if_write_ce(if_write_ce),
+      .if_write   (if_write),
+      .if_din     (if_din),
+
       .if_empty_n(if_empty_n),
       .if_read_ce(if_read_ce),
       .if_read   (if_read),
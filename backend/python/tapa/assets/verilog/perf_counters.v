@@ -0,0 +1,157 @@
+`default_nettype none
+
+// per-cycle events of an AXI master: read and write beats, and the read and
+// write bursts in flight, whose sums over time divided by the beats give the
+// average latency
+module axi_perf_probe #(
+  parameter IncWidth = 16
+) (
+  input wire clk,
+  input wire rst_n,
+
+  input wire ARVALID,
+  input wire ARREADY,
+  input wire RVALID,
+  input wire RREADY,
+  input wire RLAST,
+  input wire AWVALID,
+  input wire AWREADY,
+  input wire WVALID,
+  input wire WREADY,
+  input wire BVALID,
+  input wire BREADY,
+
+  // {outstanding writes, outstanding reads, write beat, read beat}
+  output wire [4*IncWidth-1:0] inc
+);
+
+  reg [IncWidth-1:0] outstanding_reads;
+  reg [IncWidth-1:0] outstanding_writes;
+
+  wire ar = ARVALID && ARREADY;
+  wire r  = RVALID && RREADY;
+  wire aw = AWVALID && AWREADY;
+  wire w  = WVALID && WREADY;
+  wire b  = BVALID && BREADY;
+
+  assign inc = {outstanding_writes, outstanding_reads,
+                {{(IncWidth-1){1'b0}}, w}, {{(IncWidth-1){1'b0}}, r}};
+
+  always @ (posedge clk) begin
+    if (!rst_n) begin
+      outstanding_reads  <= 0;
+      outstanding_writes <= 0;
+    end
+    else begin
+      outstanding_reads  <= outstanding_reads + ar - (r && RLAST);
+      outstanding_writes <= outstanding_writes + aw - b;
+    end
+  end
+
+endmodule  // axi_perf_probe
+
+// 64-bit counters, each incremented by its slice of inc every cycle while
+// enable is set and cleared when enable rises; they are read through an
+// AXI-Lite read channel in front of that of the control slave, at BaseAddr +
+// 8 * i (low word) and BaseAddr + 8 * i + 4 (high word) for counter i, and
+// reads below BaseAddr are forwarded to the control slave
+module perf_counters #(
+  parameter NumCounters = 1,
+  parameter IncWidth    = 16,
+  parameter AddrWidth   = 12,
+  parameter BaseAddr    = 'h800  // NumCounters * 8 must fit above it
+) (
+  input wire clk,
+  input wire rst_n,
+
+  input wire                            enable,
+  input wire [NumCounters*IncWidth-1:0] inc,
+
+  // from host
+  input  wire                 s_axi_ARVALID,
+  output wire                 s_axi_ARREADY,
+  input  wire [AddrWidth-1:0] s_axi_ARADDR,
+  output wire                 s_axi_RVALID,
+  input  wire                 s_axi_RREADY,
+  output wire [31:0]          s_axi_RDATA,
+  output wire [1:0]           s_axi_RRESP,
+
+  // to control slave
+  output wire                 m_axi_ARVALID,
+  input  wire                 m_axi_ARREADY,
+  output wire [AddrWidth-1:0] m_axi_ARADDR,
+  input  wire                 m_axi_RVALID,
+  output wire                 m_axi_RREADY,
+  input  wire [31:0]          m_axi_RDATA,
+  input  wire [1:0]           m_axi_RRESP
+);
+
+  reg [63:0] count [0:NumCounters-1];
+  reg        enable_q;
+
+  integer i;
+  always @ (posedge clk) begin
+    for (i = 0; i < NumCounters; i = i + 1) begin
+      if (!rst_n || enable && !enable_q) begin
+        count[i] <= 0;
+      end
+      else if (enable) begin
+        count[i] <= count[i] + inc[i*IncWidth +: IncWidth];
+      end
+    end
+  end
+
+  // one read is in flight at a time
+  reg        busy;
+  reg        perf;  // the read in flight is served by the counters
+  reg        perf_rvalid;
+  reg [31:0] perf_rdata;
+
+  wire is_perf = s_axi_ARADDR >= BaseAddr;
+  wire [AddrWidth-1:0] perf_idx = (s_axi_ARADDR - BaseAddr) >> 3;
+
+  assign m_axi_ARVALID = s_axi_ARVALID && !busy && !is_perf;
+  assign m_axi_ARADDR  = s_axi_ARADDR;
+  assign s_axi_ARREADY = !busy && (is_perf || m_axi_ARREADY);
+  assign s_axi_RVALID  = perf ? perf_rvalid : busy && m_axi_RVALID;
+  assign s_axi_RDATA   = perf ? perf_rdata : m_axi_RDATA;
+  assign s_axi_RRESP   = perf ? 2'b00 : m_axi_RRESP;
+  assign m_axi_RREADY  = busy && !perf && s_axi_RREADY;
+
+  always @ (posedge clk) begin
+    if (!rst_n) begin
+      enable_q    <= 1'b0;
+      busy        <= 1'b0;
+      perf        <= 1'b0;
+      perf_rvalid <= 1'b0;
+    end
+    else begin
+      enable_q <= enable;
+      if (s_axi_ARVALID && s_axi_ARREADY) begin
+        busy        <= 1'b1;
+        perf        <= is_perf;
+        perf_rvalid <= is_perf;
+      end
+      else if (s_axi_RVALID && s_axi_RREADY) begin
+        busy        <= 1'b0;
+        perf        <= 1'b0;
+        perf_rvalid <= 1'b0;
+      end
+    end
+  end
+
+  always @ (posedge clk) begin
+    if (s_axi_ARVALID && s_axi_ARREADY) begin
+      if (perf_idx < NumCounters) begin
+        perf_rdata <= s_axi_ARADDR[2] ? count[perf_idx][63:32] :
+                                        count[perf_idx][31:0];
+      end
+      else begin
+        perf_rdata <= 0;
+      end
+    end
+  end
+
+endmodule  // perf_counters
+
+`default_nettype wire
@@ -0,0 +1,196 @@
+`default_nettype none
+
+// Memory of a tapa::buffer, shared by its producer and its consumer. The memory
+// holds Sections sections of Depth words. The producer acquires free sections
+// and the consumer acquires full sections, both in round-robin order, so the
+// producer fills one section while the consumer drains another.
+//
+// Each side issues requests in order on its request FIFO: the op in bits [7:0],
+// the address in [39:8], and the data from bit 40. Acquires are answered once
+// a section is available, and loads with the data, on its response FIFO.
+module ping_pong_buffer #(
+  parameter DataWidth    = 32,
+  parameter RequestWidth = DataWidth + 41,  // with EoT as the MSB
+  parameter Depth        = 1024,
+  parameter Sections     = 2
+) (
+  input wire clk,
+  input wire reset,
+
+  // from the tapa::obuffer of the producer
+  input  wire [RequestWidth-1:0] producer_request_din,
+  output wire                    producer_request_full_n,
+  input  wire                    producer_request_write,
+  output wire [DataWidth-1:0]    producer_response_dout,
+  output wire                    producer_response_empty_n,
+  input  wire                    producer_response_read,
+
+  // from the tapa::ibuffer of the consumer
+  input  wire [RequestWidth-1:0] consumer_request_din,
+  output wire                    consumer_request_full_n,
+  input  wire                    consumer_request_write,
+  output wire [DataWidth-1:0]    consumer_response_dout,
+  output wire                    consumer_response_empty_n,
+  input  wire                    consumer_response_read
+);
+
+  localparam OpAcquire = 0;
+  localparam OpRelease = 1;
+  localparam OpLoad    = 2;
+  localparam OpStore   = 3;
+
+  localparam OffsetWidth  = Depth > 1 ? $clog2(Depth) : 1;
+  localparam SectionWidth = Sections > 1 ? $clog2(Sections) : 1;
+  localparam AddrWidth    = Depth * Sections > 1 ? $clog2(Depth * Sections) : 1;
+  localparam CountWidth   = $clog2(Sections + 1);
+
+  // [0] is the producer and [1] is the consumer
+  wire [RequestWidth-1:0] request_din      [0:1];
+  wire [1:0]              request_full_n;
+  wire [1:0]              request_write;
+  wire [DataWidth-1:0]    response_dout    [0:1];
+  wire [1:0]              response_empty_n;
+  wire [1:0]              response_read;
+
+  assign request_din[0]   = producer_request_din;
+  assign request_write[0] = producer_request_write;
+  assign response_read[0] = producer_response_read;
+  assign request_din[1]   = consumer_request_din;
+  assign request_write[1] = consumer_request_write;
+  assign response_read[1] = consumer_response_read;
+
+  assign producer_request_full_n   = request_full_n[0];
+  assign producer_response_dout    = response_dout[0];
+  assign producer_response_empty_n = response_empty_n[0];
+  assign consumer_request_full_n   = request_full_n[1];
+  assign consumer_response_dout    = response_dout[1];
+  assign consumer_response_empty_n = response_empty_n[1];
+
+  // requests issued to the memory this cycle
+  wire [1:0]           is_acquire;
+  wire [1:0]           is_release;
+  wire [1:0]           is_load;
+  wire [1:0]           is_store;
+  wire [AddrWidth-1:0] addr [0:1];
+  wire [DataWidth-1:0] data [0:1];
+
+  // sections that the producer may acquire, and that the consumer may acquire
+  reg [CountWidth-1:0] free_count;
+  reg [CountWidth-1:0] full_count;
+
+  always @(posedge clk) begin
+    if (reset) begin
+      free_count <= Sections;
+      full_count <= 0;
+    end else begin
+      free_count <= free_count - is_acquire[0] + is_release[1];
+      full_count <= full_count - is_acquire[1] + is_release[0];
+    end
+  end
+
+  (* ram_style = "block" *) reg [DataWidth-1:0] mem [0:Depth*Sections-1];
+  reg [DataWidth-1:0] q [0:1];
+
+  always @(posedge clk) begin
+    if (is_store[0]) mem[addr[0]] <= data[0];
+    if (is_load[0]) q[0] <= mem[addr[0]];
+  end
+
+  always @(posedge clk) begin
+    if (is_store[1]) mem[addr[1]] <= data[1];
+    if (is_load[1]) q[1] <= mem[addr[1]];
+  end
+
+  genvar g;
+  generate
+    for (g = 0; g < 2; g = g + 1) begin : side
+      wire                    request_empty_n;
+      wire                    request_read;
+      wire [RequestWidth-1:0] request;
+
+      fifo #(
+        .DATA_WIDTH(RequestWidth),
+        .ADDR_WIDTH(1),
+        .DEPTH     (2)
+      ) request_fifo (
+        .clk  (clk),
+        .reset(reset),
+
+        .if_full_n  (request_full_n[g]),
+        .if_write_ce(1'b1),
+        .if_write   (request_write[g]),
+        .if_din     (request_din[g]),
+
+        .if_empty_n(request_empty_n),
+        .if_read_ce(1'b1),
+        .if_read   (request_read),
+        .if_dout   (request)
+      );
+
+      wire [7:0] op = request[7:0];
+
+      // the section held by this side, valid between acquire and release
+      reg [SectionWidth-1:0] section;
+
+      // acquires and loads are answered one cycle after they are issued, once
+      // the response of the last one is in the response FIFO
+      reg  response_valid;
+      reg  response_is_load;
+      wire response_full_n;
+
+      wire is_answered = op == OpAcquire || op == OpLoad;
+      wire is_available = g == 0 ? free_count != 0 : full_count != 0;
+
+      assign request_read = request_empty_n &&
+                            (!is_answered || !response_valid ||
+                             response_full_n) &&
+                            (op != OpAcquire || is_available);
+
+      assign is_acquire[g] = request_read && op == OpAcquire;
+      assign is_release[g] = request_read && op == OpRelease;
+      assign is_load[g]    = request_read && op == OpLoad;
+      assign is_store[g]   = request_read && op == OpStore;
+      assign addr[g] = section * Depth + request[8 +: OffsetWidth];
+      assign data[g] = request[40 +: DataWidth];
+
+      always @(posedge clk) begin
+        if (reset) begin
+          section <= 0;
+          response_valid <= 1'b0;
+        end else begin
+          if (is_release[g]) begin
+            section <= section == Sections - 1 ? 0 : section + 1;
+          end
+          if (request_read && is_answered) begin
+            response_valid <= 1'b1;
+            response_is_load <= op == OpLoad;
+          end else if (response_full_n) begin
+            response_valid <= 1'b0;
+          end
+        end
+      end
+
+      fifo #(
+        .DATA_WIDTH(DataWidth),
+        .ADDR_WIDTH(1),
+        .DEPTH     (2)
+      ) response_fifo (
+        .clk  (clk),
+        .reset(reset),
+
+        .if_full_n  (response_full_n),
+        .if_write_ce(1'b1),
+        .if_write   (response_valid && response_full_n),
+        .if_din     (response_is_load ? q[g] : {DataWidth{1'b0}}),
+
+        .if_empty_n(response_empty_n[g]),
+        .if_read_ce(1'b1),
+        .if_read   (response_read[g]),
+        .if_dout   (response_dout[g])
+      );
+    end
+  endgenerate
+
+endmodule  // ping_pong_buffer
+
+`default_nettype wire
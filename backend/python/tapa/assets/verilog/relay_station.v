@@ -6,7 +6,8 @@ module relay_station #(
     parameter ADDR_WIDTH = 5,
     parameter DEPTH      = 2,
     parameter LEVEL      = 2,
-    parameter CONNECT    = 1   // add api to disconnect the relay station
+    parameter CONNECT    = 1,  // add api to disconnect the relay station
+    parameter IMPL       = "auto"  // see fifo
 ) (
   input wire clk,
   input wire reset,
@@ -65,7 +66,8 @@ module relay_station #(
             .DATA_WIDTH(DATA_WIDTH),
             .ADDR_WIDTH(REAL_ADDR_WIDTH),
             .DEPTH(REAL_DEPTH),
-            .GRACE_PERIOD(GRACE_PERIOD)
+            .GRACE_PERIOD(GRACE_PERIOD),
+            .IMPL(IMPL)
           ) unit (
             .clk(clk),
             .reset(reset),
@@ -86,8 +88,17 @@ module relay_station #(
       end
 
       // write
-      assign if_full_n  = full_n[0];  // output
-      assign empty_n[0] = if_write & full_n[0];   // input
+      if (LEVEL == 1) begin : full_n_q
+        // full_n of the almost-full fifo is registered once more, so that it
+        // never forms a combinational path to the producer; the grace period
+        // covers the write issued in the extra cycle
+        reg q;
+        always @ (posedge clk) q <= reset ? 1'b0 : full_n[0];
+        assign if_full_n = q;   // output
+      end else begin
+        assign if_full_n = full_n[0];  // output
+      end
+      assign empty_n[0] = if_write & if_full_n;   // input
       assign data[0]    = if_din;     // input
 
       // read
@@ -155,7 +166,8 @@ module fifo_almost_full #(
   parameter DATA_WIDTH = 32,
   parameter ADDR_WIDTH = 5,
   parameter DEPTH      = 32,
-  parameter GRACE_PERIOD = 2
+  parameter GRACE_PERIOD = 2,
+  parameter IMPL       = "auto"  // see fifo
 ) (
   input wire clk,
   input wire reset,
@@ -173,8 +185,19 @@ module fifo_almost_full #(
   output wire [DATA_WIDTH-1:0] if_dout
 );
 
+// the memory is chosen by IMPL, or by the width and depth if IMPL is "auto":
+// URAM for deep and wide FIFOs, BRAM for deep FIFOs that fill at least a
+// quarter of a BRAM36, and SRL otherwise, which is the cheapest for shallow
+// FIFOs however wide they are
+localparam USE_URAM   = IMPL == "uram" ||
+                        IMPL == "auto" && DATA_WIDTH >= 36 && DEPTH >= 4096;
+localparam USE_BRAM   = IMPL == "bram" ||
+                        IMPL == "auto" && DEPTH >= 128 &&
+                        DATA_WIDTH * DEPTH >= 9216;
+localparam USE_LUTRAM = IMPL == "lutram";
+
 generate
-  if (DATA_WIDTH >= 36 && DEPTH >= 4096) begin : uram
+  if (USE_URAM) begin : uram
     fifo_bram_almost_full #(
       .MEM_STYLE   ("ultra"),
       .DATA_WIDTH  (DATA_WIDTH),
@@ -195,7 +218,7 @@ generate
       .if_read   (if_read),
       .if_dout   (if_dout)
     );
-  end else if (DEPTH >= 128) begin : bram
+  end else if (USE_BRAM) begin : bram
     fifo_bram_almost_full #(
       .MEM_STYLE ("block"),
       .DATA_WIDTH(DATA_WIDTH),
@@ -211,6 +234,27 @@ generate
       .if_write   (if_write),
       .if_din     (if_din),
 
+      .if_empty_n(if_empty_n),
+      .if_read_ce(if_read_ce),
+      .if_read   (if_read),
+      .if_dout   (if_dout)
+    );
+  end else if (USE_LUTRAM) begin : lutram
+    fifo_bram_almost_full #(
+      .MEM_STYLE   ("distributed"),
+      .DATA_WIDTH  (DATA_WIDTH),
+      .ADDR_WIDTH  (ADDR_WIDTH),
+      .DEPTH       (DEPTH),
+      .GRACE_PERIOD(GRACE_PERIOD)
+    ) unit (
+      .clk  (clk),
+      .reset(reset),
+
+      .if_full_n  (if_full_n),
+      .if_write_ce(if_write_ce),
+      .if_write   (if_write),
+      .if_din     (if_din),
+
       .if_empty_n(if_empty_n),
       .if_read_ce(if_read_ce),
       .if_read   (if_read),
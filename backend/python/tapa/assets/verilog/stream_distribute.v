@@ -0,0 +1,61 @@
+`default_nettype none
+
+// Distributes the tokens that a task writes as if to a FIFO among FIFOs, each
+// token to one output that is not full, in round-robin order: after a write,
+// or while the selected output is full, the nearest non-full output after it
+// is selected. An EoT token, i.e., one whose MSB is set, is written to all
+// outputs at once. The data of the tokens is connected to the outputs
+// directly.
+module stream_distribute #(
+  parameter DATA_WIDTH = 32,
+  parameter FANOUT     = 2
+) (
+  input wire clk,
+  input wire reset,
+
+  // written by the task
+  input  wire [DATA_WIDTH-1:0] if_din,
+  output wire                  if_full_n,
+  input  wire                  if_write,
+
+  // write to the outputs
+  input  wire [FANOUT-1:0] if_full_n_out,
+  output wire [FANOUT-1:0] if_write_out
+);
+
+  parameter SEL_WIDTH = FANOUT > 1 ? $clog2(FANOUT) : 1;
+
+  wire eot = if_din[DATA_WIDTH-1];
+
+  reg [SEL_WIDTH-1:0] sel;
+  reg [SEL_WIDTH-1:0] sel_next;
+  integer i;
+
+  // the nearest non-full output after `sel`, or `sel` if there is none
+  always @* begin
+    sel_next = sel;
+    for (i = FANOUT - 1; i > 0; i = i - 1) begin
+      if (if_full_n_out[sel + i >= FANOUT ? sel + i - FANOUT : sel + i]) begin
+        sel_next = sel + i >= FANOUT ? sel + i - FANOUT : sel + i;
+      end
+    end
+  end
+
+  always @(posedge clk) begin
+    if (reset) begin
+      sel <= 0;
+    end else if ((if_write && !eot) || !if_full_n_out[sel]) begin
+      sel <= sel_next;
+    end
+  end
+
+  assign if_full_n = eot ? &if_full_n_out : if_full_n_out[sel];
+
+  genvar g;
+  generate
+    for (g = 0; g < FANOUT; g = g + 1) begin : write
+      assign if_write_out[g] = if_write && (eot || sel == g);
+    end
+  endgenerate
+
+endmodule  // stream_distribute
@@ -0,0 +1,60 @@
+`default_nettype none
+
+// Merges FIFOs into one, from which a task reads as if it were a FIFO. Inputs
+// are taken in round-robin order: after a read, or while the selected input
+// is empty, the nearest non-empty input after it is selected. So a token seen
+// by the reader stays at the head until it is read, and a single busy input
+// is read every cycle.
+module stream_merge #(
+  parameter DATA_WIDTH = 32,
+  parameter FANIN      = 2
+) (
+  input wire clk,
+  input wire reset,
+
+  // read from the inputs
+  input  wire [FANIN*DATA_WIDTH-1:0] if_dout_in,
+  input  wire [FANIN-1:0]            if_empty_n_in,
+  output wire [FANIN-1:0]            if_read_in,
+
+  // read by the task
+  output wire [DATA_WIDTH-1:0] if_dout,
+  output wire                  if_empty_n,
+  input  wire                  if_read
+);
+
+  parameter SEL_WIDTH = FANIN > 1 ? $clog2(FANIN) : 1;
+
+  reg [SEL_WIDTH-1:0] sel;
+  reg [SEL_WIDTH-1:0] sel_next;
+  integer i;
+
+  // the nearest non-empty input after `sel`, or `sel` if there is none
+  always @* begin
+    sel_next = sel;
+    for (i = FANIN - 1; i > 0; i = i - 1) begin
+      if (if_empty_n_in[sel + i >= FANIN ? sel + i - FANIN : sel + i]) begin
+        sel_next = sel + i >= FANIN ? sel + i - FANIN : sel + i;
+      end
+    end
+  end
+
+  always @(posedge clk) begin
+    if (reset) begin
+      sel <= 0;
+    end else if (if_read || !if_empty_n) begin
+      sel <= sel_next;
+    end
+  end
+
+  assign if_dout    = if_dout_in[sel * DATA_WIDTH +: DATA_WIDTH];
+  assign if_empty_n = if_empty_n_in[sel];
+
+  genvar g;
+  generate
+    for (g = 0; g < FANIN; g = g + 1) begin : read
+      assign if_read_in[g] = if_read && sel == g;
+    end
+  endgenerate
+
+endmodule  // stream_merge
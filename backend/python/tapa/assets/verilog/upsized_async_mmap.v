@@ -0,0 +1,510 @@
+`default_nettype none
+
+// async_mmap whose elements are narrower than its AXI data path; each
+// element is a lane of a DataWidth-bit bus word
+//
+// reads to the same bus word in a row share one bus read; consecutive writes
+// to the same bus word are packed into one bus write with byte strobes
+module upsized_async_mmap #(
+  parameter BufferSize        = 32,
+  parameter BufferSizeLog     = 5,
+  parameter AddrWidth         = 64,
+  parameter AxiSideAddrWidth  = 64,
+  parameter DataWidth         = 512,
+  parameter DataWidthBytesLog = 6,  // must equal log2(DataWidth/8)
+  parameter ElemWidth         = 32,  // must be less than DataWidth
+  parameter ElemWidthBytesLog = 2,  // must equal log2(ElemWidth/8)
+  parameter WaitTimeWidth     = 4,
+  parameter BurstLenWidth     = 8,
+  // implement the FIFOs for the read channel
+  // if set to 0: disconnect the data link
+  parameter EnableReadChannel = 1,
+  parameter EnableWriteChannel= 1,
+  // see async_mmap
+  parameter IdWidth                  = 1,
+  parameter MaxOutstandingReads      = 64,
+  parameter MaxOutstandingReadsLog   = 6,
+  parameter ReorderBufferDepth       = 64,
+  parameter ReorderBufferDepthLog    = 6,
+  parameter WriteCombineLineLenLog   = 0,
+  parameter WriteCombineWindow       = 16,
+  // maximum number of element reads between read_addr and read_data
+  parameter LaneBufferSize           = 512,
+  parameter LaneBufferSizeLog        = 9,   // must equal log2(LaneBufferSize)
+  // a packed bus write is sent after PackWindow cycles without a write to it
+  parameter PackWindow               = 16   // must be less than 2 ** 16
+) (
+  input wire clk,
+  input wire rst, // active high
+
+  // for burst inference
+  input wire [WaitTimeWidth-1:0] max_wait_time,
+  input wire [BurstLenWidth-1:0] max_burst_len,
+
+  // axi write addr channel
+  output wire                 m_axi_AWVALID,
+  input  wire                 m_axi_AWREADY,
+  output wire [AxiSideAddrWidth-1:0] m_axi_AWADDR,
+  output wire [IdWidth-1:0]   m_axi_AWID,
+  output wire [7:0]           m_axi_AWLEN,
+  output wire [2:0]           m_axi_AWSIZE,
+  output wire [1:0]           m_axi_AWBURST,
+  output wire [0:0]           m_axi_AWLOCK,
+  output wire [3:0]           m_axi_AWCACHE,
+  output wire [2:0]           m_axi_AWPROT,
+  output wire [3:0]           m_axi_AWQOS,
+
+  // axi write data channel
+  output wire                   m_axi_WVALID,
+  input  wire                   m_axi_WREADY,
+  output wire [DataWidth-1:0]   m_axi_WDATA,
+  output wire [DataWidth/8-1:0] m_axi_WSTRB,
+  output wire                   m_axi_WLAST,
+
+  // axi write acknowledge channel
+  input  wire       m_axi_BVALID,
+  output wire       m_axi_BREADY,
+  input  wire [1:0] m_axi_BRESP,
+  input  wire [IdWidth-1:0] m_axi_BID,
+
+  // axi read addr channel
+  output wire                 m_axi_ARVALID,
+  input  wire                 m_axi_ARREADY,
+  output wire [AxiSideAddrWidth-1:0] m_axi_ARADDR,
+  output wire [IdWidth-1:0]   m_axi_ARID,
+  output wire [7:0]           m_axi_ARLEN,
+  output wire [2:0]           m_axi_ARSIZE,
+  output wire [1:0]           m_axi_ARBURST,
+  output wire [0:0]           m_axi_ARLOCK,
+  output wire [3:0]           m_axi_ARCACHE,
+  output wire [2:0]           m_axi_ARPROT,
+  output wire [3:0]           m_axi_ARQOS,
+
+  // axi read response channel
+  input  wire                 m_axi_RVALID,
+  output wire                 m_axi_RREADY,
+  input  wire [DataWidth-1:0] m_axi_RDATA,
+  input  wire                 m_axi_RLAST,
+  input  wire [IdWidth-1:0]   m_axi_RID,
+  input  wire [1:0]           m_axi_RRESP,
+
+  // push read addr here
+  input  wire [AddrWidth-1:0] read_addr_din,
+  input  wire                 read_addr_write,
+  output wire                 read_addr_full_n,
+
+  // pop read resp here
+  output wire [ElemWidth-1:0] read_data_dout,
+  input  wire                 read_data_read,
+  output wire                 read_data_empty_n,
+
+  // push write addr and data here
+  input  wire [AddrWidth-1:0] write_addr_din,
+  input  wire                 write_addr_write,
+  output wire                 write_addr_full_n,
+  input  wire [ElemWidth-1:0] write_data_din,
+  input  wire                 write_data_write,
+  output wire                 write_data_full_n,
+
+  // pop write resp here
+  output wire [7:0] write_resp_dout,
+  input  wire       write_resp_read,
+  output wire       write_resp_empty_n
+);
+
+  localparam LaneLog   = DataWidthBytesLog - ElemWidthBytesLog;
+  localparam ElemBytes = ElemWidth / 8;
+
+  // the bus memory; its write data carry byte strobes
+  wire [AddrWidth-1:0]               mem_read_addr_din;
+  wire                               mem_read_addr_write;
+  wire                               mem_read_addr_full_n;
+  wire [DataWidth-1:0]               mem_read_data_dout;
+  wire                               mem_read_data_read;
+  wire                               mem_read_data_empty_n;
+  wire [AddrWidth-1:0]               mem_write_addr_din;
+  wire                               mem_write_addr_write;
+  wire                               mem_write_addr_full_n;
+  wire [DataWidth+DataWidth/8-1:0]   mem_write_data_din;
+  wire                               mem_write_data_write;
+  wire                               mem_write_data_full_n;
+  wire [7:0]                         mem_write_resp_dout;
+  wire                               mem_write_resp_read;
+  wire                               mem_write_resp_empty_n;
+
+  async_mmap #(
+    .BufferSize            (BufferSize),
+    .BufferSizeLog         (BufferSizeLog),
+    .AddrWidth             (AddrWidth),
+    .AxiSideAddrWidth      (AxiSideAddrWidth),
+    .DataWidth             (DataWidth),
+    .DataWidthBytesLog     (DataWidthBytesLog),
+    .WaitTimeWidth         (WaitTimeWidth),
+    .BurstLenWidth         (BurstLenWidth),
+    .EnableReadChannel     (EnableReadChannel),
+    .EnableWriteChannel    (EnableWriteChannel),
+    .IdWidth               (IdWidth),
+    .MaxOutstandingReads   (MaxOutstandingReads),
+    .MaxOutstandingReadsLog(MaxOutstandingReadsLog),
+    .ReorderBufferDepth    (ReorderBufferDepth),
+    .ReorderBufferDepthLog (ReorderBufferDepthLog),
+    .WriteCombineLineLenLog(WriteCombineLineLenLog),
+    .WriteCombineWindow    (WriteCombineWindow),
+    .WriteStrobe           (1)
+  ) mem (
+    .clk               (clk),
+    .rst               (rst),
+    .max_wait_time     (max_wait_time),
+    .max_burst_len     (max_burst_len),
+    .m_axi_AWVALID     (m_axi_AWVALID),
+    .m_axi_AWREADY     (m_axi_AWREADY),
+    .m_axi_AWADDR      (m_axi_AWADDR),
+    .m_axi_AWID        (m_axi_AWID),
+    .m_axi_AWLEN       (m_axi_AWLEN),
+    .m_axi_AWSIZE      (m_axi_AWSIZE),
+    .m_axi_AWBURST     (m_axi_AWBURST),
+    .m_axi_AWLOCK      (m_axi_AWLOCK),
+    .m_axi_AWCACHE     (m_axi_AWCACHE),
+    .m_axi_AWPROT      (m_axi_AWPROT),
+    .m_axi_AWQOS       (m_axi_AWQOS),
+    .m_axi_WVALID      (m_axi_WVALID),
+    .m_axi_WREADY      (m_axi_WREADY),
+    .m_axi_WDATA       (m_axi_WDATA),
+    .m_axi_WSTRB       (m_axi_WSTRB),
+    .m_axi_WLAST       (m_axi_WLAST),
+    .m_axi_BVALID      (m_axi_BVALID),
+    .m_axi_BREADY      (m_axi_BREADY),
+    .m_axi_BRESP       (m_axi_BRESP),
+    .m_axi_BID         (m_axi_BID),
+    .m_axi_ARVALID     (m_axi_ARVALID),
+    .m_axi_ARREADY     (m_axi_ARREADY),
+    .m_axi_ARADDR      (m_axi_ARADDR),
+    .m_axi_ARID        (m_axi_ARID),
+    .m_axi_ARLEN       (m_axi_ARLEN),
+    .m_axi_ARSIZE      (m_axi_ARSIZE),
+    .m_axi_ARBURST     (m_axi_ARBURST),
+    .m_axi_ARLOCK      (m_axi_ARLOCK),
+    .m_axi_ARCACHE     (m_axi_ARCACHE),
+    .m_axi_ARPROT      (m_axi_ARPROT),
+    .m_axi_ARQOS       (m_axi_ARQOS),
+    .m_axi_RVALID      (m_axi_RVALID),
+    .m_axi_RREADY      (m_axi_RREADY),
+    .m_axi_RDATA       (m_axi_RDATA),
+    .m_axi_RLAST       (m_axi_RLAST),
+    .m_axi_RID         (m_axi_RID),
+    .m_axi_RRESP       (m_axi_RRESP),
+    .read_addr_din     (mem_read_addr_din),
+    .read_addr_write   (mem_read_addr_write),
+    .read_addr_full_n  (mem_read_addr_full_n),
+    .read_data_dout    (mem_read_data_dout),
+    .read_data_read    (mem_read_data_read),
+    .read_data_empty_n (mem_read_data_empty_n),
+    .write_addr_din    (mem_write_addr_din),
+    .write_addr_write  (mem_write_addr_write),
+    .write_addr_full_n (mem_write_addr_full_n),
+    .write_data_din    (mem_write_data_din),
+    .write_data_write  (mem_write_data_write),
+    .write_data_full_n (mem_write_data_full_n),
+    .write_resp_dout   (mem_write_resp_dout),
+    .write_resp_read   (mem_write_resp_read),
+    .write_resp_empty_n(mem_write_resp_empty_n)
+  );
+
+  // read addr buffer, from user to bus memory
+  wire [AddrWidth-1:0] read_addr_dout;
+  wire                 read_addr_empty_n;
+  wire                 read_addr_read;
+
+  relay_station #(
+    .DATA_WIDTH(AddrWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableReadChannel)
+  ) read_addr (
+    .clk  (clk),
+    .reset(rst),
+
+    // from user
+    .if_full_n  (read_addr_full_n),
+    .if_write_ce(1'b1),
+    .if_write   (read_addr_write),
+    .if_din     (read_addr_din),
+
+    // to bus memory
+    .if_empty_n(read_addr_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (read_addr_read),
+    .if_dout   (read_addr_dout)
+  );
+
+  // lanes of the reads in flight, and whether each read needs a new bus word
+  wire               lane_full_n;
+  wire [LaneLog:0]   lane_dout;
+  wire               lane_empty_n;
+  wire               lane_read;
+  wire               lane_dout_new = lane_dout[LaneLog];
+  wire [LaneLog-1:0] lane_dout_lane = lane_dout[LaneLog-1:0];
+
+  reg                                 last_read_valid;
+  reg [AddrWidth-1:DataWidthBytesLog] last_read_word;
+  wire [AddrWidth-1:DataWidthBytesLog] read_word =
+      read_addr_dout[AddrWidth-1:DataWidthBytesLog];
+  wire [LaneLog-1:0] read_lane =
+      read_addr_dout[DataWidthBytesLog-1:ElemWidthBytesLog];
+  wire read_new = !last_read_valid || read_word != last_read_word;
+
+  assign read_addr_read      = read_addr_empty_n && lane_full_n &&
+                               mem_read_addr_full_n;
+  assign mem_read_addr_write = read_addr_read && read_new;
+  assign mem_read_addr_din   = {read_word, {DataWidthBytesLog{1'b0}}};
+
+  always @ (posedge clk) begin
+    if (rst) begin
+      last_read_valid <= 1'b0;
+    end
+    else if (read_addr_read) begin
+      last_read_valid <= 1'b1;
+      last_read_word  <= read_word;
+    end
+  end
+
+  fifo #(
+    .DATA_WIDTH(LaneLog + 1),
+    .ADDR_WIDTH(LaneBufferSizeLog),
+    .DEPTH     (LaneBufferSize)
+  ) lane (
+    .clk  (clk),
+    .reset(rst),
+
+    // from read addr buffer
+    .if_full_n  (lane_full_n),
+    .if_write_ce(1'b1),
+    .if_write   (read_addr_read),
+    .if_din     ({read_new, read_lane}),
+
+    // to read data buffer
+    .if_empty_n(lane_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (lane_read),
+    .if_dout   (lane_dout)
+  );
+
+  // read data buffer, from bus memory to user
+  reg  [DataWidth-1:0] last_read_data;
+  wire [DataWidth-1:0] read_data_word =
+      lane_dout_new ? mem_read_data_dout : last_read_data;
+  wire read_data_full_n_internal;
+  wire read_data_write = lane_empty_n && read_data_full_n_internal &&
+                         (!lane_dout_new || mem_read_data_empty_n);
+
+  assign lane_read          = read_data_write;
+  assign mem_read_data_read = read_data_write && lane_dout_new;
+
+  always @ (posedge clk) begin
+    if (mem_read_data_read) last_read_data <= mem_read_data_dout;
+  end
+
+  relay_station #(
+    .DATA_WIDTH(ElemWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableReadChannel)
+  ) read_data (
+    .clk  (clk),
+    .reset(rst),
+
+    // from bus memory
+    .if_full_n  (read_data_full_n_internal),
+    .if_write_ce(1'b1),
+    .if_write   (read_data_write),
+    .if_din     (read_data_word[lane_dout_lane*ElemWidth +: ElemWidth]),
+
+    // to user
+    .if_empty_n(read_data_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (read_data_read),
+    .if_dout   (read_data_dout)
+  );
+
+  // write addr and data buffers, from user to write packer
+  wire [AddrWidth-1:0] write_addr_dout;
+  wire                 write_addr_empty_n;
+  wire [ElemWidth-1:0] write_data_dout;
+  wire                 write_data_empty_n;
+  wire                 write_read;
+
+  relay_station #(
+    .DATA_WIDTH(AddrWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableWriteChannel)
+  ) write_addr (
+    .clk  (clk),
+    .reset(rst),
+
+    // from user
+    .if_full_n  (write_addr_full_n),
+    .if_write_ce(1'b1),
+    .if_write   (write_addr_write),
+    .if_din     (write_addr_din),
+
+    // to write packer
+    .if_empty_n(write_addr_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (write_read),
+    .if_dout   (write_addr_dout)
+  );
+
+  relay_station #(
+    .DATA_WIDTH(ElemWidth),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableWriteChannel)
+  ) write_data (
+    .clk  (clk),
+    .reset(rst),
+
+    // from user
+    .if_full_n  (write_data_full_n),
+    .if_write_ce(1'b1),
+    .if_write   (write_data_write),
+    .if_din     (write_data_din),
+
+    // to write packer
+    .if_empty_n(write_data_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (write_read),
+    .if_dout   (write_data_dout)
+  );
+
+  // write packer; a packed bus write is sent when it is full, when the next
+  // write is to another bus word, when it has packed 256 writes, or when the
+  // window expires, and an element written twice keeps its last value
+  reg                                 pack_valid;
+  reg [AddrWidth-1:DataWidthBytesLog] pack_word;
+  reg [DataWidth-1:0]                 pack_data;
+  reg [DataWidth/8-1:0]               pack_strb;
+  reg [7:0]                           pack_count;  // number of writes - 1
+  reg [15:0]                          pack_idle;
+
+  wire write_count_full_n;
+
+  wire in_valid = write_addr_empty_n && write_data_empty_n;
+  wire [AddrWidth-1:DataWidthBytesLog] in_word =
+      write_addr_dout[AddrWidth-1:DataWidthBytesLog];
+  wire [LaneLog-1:0] in_lane =
+      write_addr_dout[DataWidthBytesLog-1:ElemWidthBytesLog];
+  wire [DataWidth/8-1:0] in_strb =
+      {{(DataWidth/8-ElemBytes){1'b0}}, {ElemBytes{1'b1}}} <<
+      (in_lane * ElemBytes);
+
+  wire flush = pack_valid && (&pack_strb || &pack_count ||
+                              pack_idle == PackWindow - 1 ||
+                              in_valid && in_word != pack_word);
+  wire emit  = flush && mem_write_addr_full_n && mem_write_data_full_n &&
+               write_count_full_n;
+  wire merge = pack_valid && !flush;
+
+  // when the packed write is flushed, the next write starts a new one
+  assign write_read = in_valid && (!flush || emit);
+
+  assign mem_write_addr_write = emit;
+  assign mem_write_addr_din   = {pack_word, {DataWidthBytesLog{1'b0}}};
+  assign mem_write_data_write = emit;
+  assign mem_write_data_din   = {pack_strb, pack_data};
+
+  always @ (posedge clk) begin
+    if (rst) begin
+      pack_valid <= 1'b0;
+    end
+    else if (write_read) begin
+      pack_valid <= 1'b1;
+      pack_word  <= in_word;
+      pack_count <= merge ? pack_count + 1 : 0;
+      pack_idle  <= 0;
+    end
+    else if (emit) begin
+      pack_valid <= 1'b0;
+    end
+    else if (pack_valid && !flush) begin
+      pack_idle <= pack_idle + 1;
+    end
+  end
+
+  always @ (posedge clk) begin
+    if (write_read) begin
+      pack_data[in_lane*ElemWidth +: ElemWidth] <= write_data_dout;
+      pack_strb <= (merge ? pack_strb : 0) | in_strb;
+    end
+  end
+
+  // number of writes packed in each bus write in flight, minus 1
+  wire [7:0] write_count_dout;
+  wire       write_count_empty_n;
+  wire       write_count_read;
+
+  fifo #(
+    .DATA_WIDTH(8),
+    .ADDR_WIDTH(LaneBufferSizeLog),
+    .DEPTH     (LaneBufferSize)
+  ) write_count (
+    .clk  (clk),
+    .reset(rst),
+
+    // from write packer
+    .if_full_n  (write_count_full_n),
+    .if_write_ce(1'b1),
+    .if_write   (emit),
+    .if_din     (pack_count),
+
+    // to write resp buffer
+    .if_empty_n(write_count_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (write_count_read),
+    .if_dout   (write_count_dout)
+  );
+
+  // each resp of the bus memory acknowledges one or more bus writes, and each
+  // bus write is acknowledged to the user as the writes packed in it
+  reg [15:0] write_acked;  // bus writes acknowledged but not to the user yet
+  wire write_resp_full_n_internal;
+
+  assign mem_write_resp_read = mem_write_resp_empty_n && !write_acked[15];
+  assign write_count_read    = write_acked != 0 && write_count_empty_n &&
+                               write_resp_full_n_internal;
+
+  always @ (posedge clk) begin
+    if (rst) begin
+      write_acked <= 0;
+    end
+    else begin
+      write_acked <= write_acked - write_count_read +
+                     (mem_write_resp_read ? mem_write_resp_dout + 1 : 0);
+    end
+  end
+
+  relay_station #(
+    .DATA_WIDTH(8),
+    .ADDR_WIDTH(BufferSizeLog),
+    .DEPTH     (BufferSize),
+    .CONNECT   (EnableWriteChannel)
+  ) write_resp (
+    .clk  (clk),
+    .reset(rst),
+
+    // from write packer
+    .if_full_n  (write_resp_full_n_internal),
+    .if_write_ce(1'b1),
+    .if_write   (write_count_read),
+    .if_din     (write_count_dout),
+
+    // to user
+    .if_empty_n(write_resp_empty_n),
+    .if_read_ce(1'b1),
+    .if_read   (write_resp_read),
+    .if_dout   (write_resp_dout)
+  );
+
+endmodule  // upsized_async_mmap
+
+`default_nettype wire
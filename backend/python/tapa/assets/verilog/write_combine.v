@@ -0,0 +1,131 @@
+`default_nettype none
+
+// Combine writes to the same line, i.e., 2 ** LineLenLog consecutive elements,
+// that arrive less than WindowCycles cycles apart. A line is written out as
+// consecutive elements from its first to its last written element, so that
+// detect_burst turns it into one burst; the elements in between that are not
+// written are marked so that their byte strobes can be cleared.
+module write_combine #(
+  parameter AddrWidth         = 64,
+  parameter DataWidth         = 512,
+  parameter DataWidthBytesLog = 6,  // log2 of the element size in bytes
+  parameter LineLenLog        = 3,
+  parameter WindowCycles      = 16  // must be less than 2 ** 16
+) (
+  input wire clk,
+  input wire rst,
+
+  // input: individual writes
+  input  wire [AddrWidth-1:0] addr_dout,
+  input  wire                 addr_empty_n,
+  output wire                 addr_read,
+  input  wire [DataWidth-1:0] data_dout,
+  input  wire                 data_empty_n,
+  output wire                 data_read,
+
+  // output: writes of combined lines; the MSB of data tells whether the
+  // element is written
+  output wire [AddrWidth-1:0] addr_din,
+  input  wire                 addr_full_n,
+  output wire                 addr_write,
+  output wire [DataWidth:0]   data_din,
+  input  wire                 data_full_n,
+  output wire                 data_write
+);
+
+  localparam LineLen     = 1 << LineLenLog;
+  localparam LineAddrLsb = DataWidthBytesLog + LineLenLog;
+
+  // state
+  reg                           line_open;
+  reg                           flushing;
+  reg [AddrWidth-1:LineAddrLsb] line_tag;
+  reg [LineLen-1:0]             written;
+  reg [15:0]                    idle_cycles;
+  reg [LineLenLog-1:0]          flush_idx;
+  reg [LineLenLog-1:0]          flush_last_idx;
+
+  (* ram_style = "distributed" *)
+  reg [DataWidth-1:0] line [0:LineLen-1];
+
+  // first and last written elements of the open line
+  reg [LineLenLog-1:0] first_written;
+  reg [LineLenLog-1:0] last_written;
+  integer i;
+  always @* begin
+    first_written = 0;
+    last_written  = 0;
+    for (i = LineLen - 1; i >= 0; i = i - 1) begin
+      if (written[i]) first_written = i;
+    end
+    for (i = 0; i < LineLen; i = i + 1) begin
+      if (written[i]) last_written = i;
+    end
+  end
+
+  // input; an element written twice closes the line, so that each element of
+  // a combined line stands for exactly one write
+  wire                         in_valid = addr_empty_n && data_empty_n;
+  wire [AddrWidth-1:LineAddrLsb] in_tag = addr_dout[AddrWidth-1:LineAddrLsb];
+  wire [LineLenLog-1:0]          in_idx =
+      addr_dout[LineAddrLsb-1:DataWidthBytesLog];
+  wire in_hit    = line_open && in_tag == line_tag && !written[in_idx];
+  wire in_accept = in_valid && !flushing && (!line_open || in_hit);
+
+  assign addr_read = in_accept;
+  assign data_read = in_accept;
+
+  // output
+  wire out_write  = flushing && addr_full_n && data_full_n;
+  wire flush_done = out_write && flush_idx == flush_last_idx;
+
+  assign addr_write = out_write;
+  assign data_write = out_write;
+  assign addr_din   = {line_tag, flush_idx, {DataWidthBytesLog{1'b0}}};
+  assign data_din   = {written[flush_idx], line[flush_idx]};
+
+  always @ (posedge clk) begin
+    if (rst) begin
+      line_open   <= 1'b0;
+      flushing    <= 1'b0;
+      written     <= 0;
+      idle_cycles <= 0;
+    end
+    else begin
+      if (in_accept) begin
+        line_open       <= 1'b1;
+        line_tag        <= in_tag;
+        written[in_idx] <= 1'b1;
+        idle_cycles     <= 0;
+      end
+      else if (line_open && !flushing) begin
+        // close the line if it is full, the window expires, or the next write
+        // cannot be combined
+        if (&written || idle_cycles == WindowCycles - 1 || in_valid) begin
+          flushing       <= 1'b1;
+          flush_idx      <= first_written;
+          flush_last_idx <= last_written;
+        end
+        else begin
+          idle_cycles <= idle_cycles + 1;
+        end
+      end
+
+      if (flush_done) begin
+        line_open <= 1'b0;
+        flushing  <= 1'b0;
+        written   <= 0;
+      end
+      else if (out_write) begin
+        flush_idx <= flush_idx + 1;
+      end
+    end
+  end
+
+  always @ (posedge clk) begin
+    if (in_accept) line[in_idx] <= data_dout;
+  end
+
+endmodule  // write_combine
+
+`default_nettype wire
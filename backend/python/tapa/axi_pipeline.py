@@ -1,4 +1,4 @@
-from typing import List
+from typing import List, Optional, Sequence
 
 from pyverilog.vparser.ast import Input, Output, Parameter
 from pyverilog.ast_code_generator.codegen import ASTCodeGenerator
@@ -15,6 +15,30 @@ class AXI:
     self.addr_width = addr_width
     self.pipeline_level = pipeline_level
 
+# hardware performance counters, read through the AXI-Lite control interface
+PERF_PREFIX = 'tapa_perf_'
+PERF_ADDR_WIDTH = 12
+PERF_BASE_ADDR = 0x800
+PERF_INC_WIDTH = 16
+PERF_FIFO_EVENTS = ('full', 'empty', 'active')
+PERF_LOOP_EVENTS = ('iterations', 'stalls')
+PERF_AXI_EVENTS = ('read_beats', 'write_beats', 'outstanding_reads',
+                   'outstanding_writes')
+PERF_MAX_COUNTERS = ((1 << PERF_ADDR_WIDTH) - PERF_BASE_ADDR) // 8
+PERF_S_AXI_AR_R = ('_ARVALID', '_ARREADY', '_ARADDR', '_RVALID', '_RREADY',
+                   '_RDATA', '_RRESP')
+
+
+def get_perf_counter_names(fifos: Sequence[str], loops: Sequence[str],
+                           axi_names: Sequence[str]) -> List[str]:
+  """Names of the performance counters, in the order of their addresses."""
+  names = ['cycles']
+  names += [f'{fifo}.{event}' for fifo in fifos for event in PERF_FIFO_EVENTS]
+  names += [f'{loop}.{event}' for loop in loops for event in PERF_LOOP_EVENTS]
+  names += [f'{axi}.{event}' for axi in axi_names for event in PERF_AXI_EVENTS]
+  return names
+
+
 class IOPort:
   def __init__(self, name: str, direction: str, width: str):
     self.name = name
@@ -53,13 +77,18 @@ def parse_ports(ast) -> List[IOPort]:
   return io_list
 
 
-def get_top(top_name, io_list: List[IOPort]):
+def get_top(top_name, io_list: List[IOPort], perf: bool = False):
   top = []
 
   top.append(f'`timescale 1 ns / 1 ps ')
   top.append(f'module {top_name} (')
   for io in io_list:
-    top.append(f'  {io.direction} {io.width} {io.name},')
+    if io.name.startswith(PERF_PREFIX):
+      continue
+    width = io.width
+    if perf and io.name in {'s_axi_control_ARADDR', 's_axi_control_AWADDR'}:
+      width = f'[{PERF_ADDR_WIDTH - 1}:0]'
+    top.append(f'  {io.direction} {width} {io.name},')
   top[-1] = top[-1].replace(',', '')
   top.append(f');')
 
@@ -76,11 +105,20 @@ def get_params(ast) -> List[str]:
   return indented(params)
 
 
-def get_wire_decl(io_list: List[IOPort]):
+def get_wire_decl(io_list: List[IOPort], perf: bool = False):
   wire_decl = []
   for io in io_list:
     if 'm_axi' in io.name:
       wire_decl.append(f'wire {io.width} {io.name}_inner;')
+    elif io.name.startswith(PERF_PREFIX):
+      wire_decl.append(f'wire {io.width} {io.name};')
+  if perf:
+    for suffix in PERF_S_AXI_AR_R:
+      io = next(x for x in io_list if x.name == f's_axi_control{suffix}')
+      width = io.width
+      if suffix == '_ARADDR':
+        width = f'[{PERF_ADDR_WIDTH - 1}:0]'
+      wire_decl.append(f'wire {width} {io.name}_inner;')
 
   return indented(wire_decl)
 
@@ -106,7 +144,57 @@ def get_pipeline_inst(axi_list: List[AXI]):
   return indented(pp_inst)
 
 
-def get_top_inst(top_name, io_list: List[IOPort]):
+def get_perf_inst(fifos: Sequence[str], loops: Sequence[str],
+                  axi_list: List[AXI]):
+  """Count the events of FIFOs, loops, and AXI interfaces while the kernel
+  runs."""
+  perf_inst = []
+  inc = [f"{PERF_INC_WIDTH}'d1"]
+  for idx, _ in enumerate(fifos):
+    for event_idx, _ in enumerate(PERF_FIFO_EVENTS):
+      bit = idx * len(PERF_FIFO_EVENTS) + event_idx
+      inc.append(f"{{{PERF_INC_WIDTH - 1}'d0, {PERF_PREFIX}fifo[{bit}]}}")
+  for idx, _ in enumerate(loops):
+    for event_idx, _ in enumerate(PERF_LOOP_EVENTS):
+      bit = idx * len(PERF_LOOP_EVENTS) + event_idx
+      inc.append(f"{{{PERF_INC_WIDTH - 1}'d0, {PERF_PREFIX}loop[{bit}]}}")
+  for axi in axi_list:
+    inc.append(f'{PERF_PREFIX}{axi.name}_inc')
+    perf_inst.append(
+        f'wire [{len(PERF_AXI_EVENTS) * PERF_INC_WIDTH - 1}:0] '
+        f'{PERF_PREFIX}{axi.name}_inc;')
+    perf_inst.append(f'axi_perf_probe #(')
+    perf_inst.append(f'  .IncWidth({PERF_INC_WIDTH})')
+    perf_inst.append(f') {PERF_PREFIX}{axi.name} (')
+    perf_inst.append(f'  .clk    (ap_clk),')
+    perf_inst.append(f'  .rst_n  (ap_rst_n),')
+    for port in ('ARVALID', 'ARREADY', 'RVALID', 'RREADY', 'RLAST', 'AWVALID',
+                 'AWREADY', 'WVALID', 'WREADY', 'BVALID', 'BREADY'):
+      perf_inst.append(f'  .{port}(m_axi_{axi.name}_{port}),')
+    perf_inst.append(f'  .inc    ({PERF_PREFIX}{axi.name}_inc)')
+    perf_inst.append(f');')
+
+  perf_inst.append(f'perf_counters #(')
+  perf_inst.append(f'  .NumCounters({len(inc)}),')
+  perf_inst.append(f'  .IncWidth   ({PERF_INC_WIDTH}),')
+  perf_inst.append(f'  .AddrWidth  ({PERF_ADDR_WIDTH}),')
+  perf_inst.append(f"  .BaseAddr   ({PERF_ADDR_WIDTH}'h{PERF_BASE_ADDR:x})")
+  perf_inst.append(f') {PERF_PREFIX}counters (')
+  perf_inst.append(f'  .clk   (ap_clk),')
+  perf_inst.append(f'  .rst_n (ap_rst_n),')
+  perf_inst.append(f'  .enable({PERF_PREFIX}running),')
+  perf_inst.append(f'  .inc   ({{{", ".join(reversed(inc))}}}),')
+  for suffix in PERF_S_AXI_AR_R:
+    perf_inst.append(f'  .s_axi{suffix}(s_axi_control{suffix}),')
+  for suffix in PERF_S_AXI_AR_R:
+    perf_inst.append(f'  .m_axi{suffix}(s_axi_control{suffix}_inner),')
+  perf_inst[-1] = perf_inst[-1][:-1]
+  perf_inst.append(f');')
+
+  return indented(perf_inst)
+
+
+def get_top_inst(top_name, io_list: List[IOPort], perf: bool = False):
   top_inst = []
 
   top_inst.append(f'{top_name} {top_name}_0 (')
@@ -114,6 +202,13 @@ def get_top_inst(top_name, io_list: List[IOPort]):
   for io in io_list:
     if 'm_axi' in io.name:
       top_inst.append(f'  .{io.name}({io.name}_inner),')
+    elif perf and io.name == 's_axi_control_ARADDR':
+      top_inst.append(
+          f'  .{io.name}({io.name}_inner{io.width.replace(" ", "")}),')
+    elif perf and io.name == 's_axi_control_AWADDR':
+      top_inst.append(f'  .{io.name}({io.name}{io.width.replace(" ", "")}),')
+    elif perf and io.name[len('s_axi_control'):] in PERF_S_AXI_AR_R:
+      top_inst.append(f'  .{io.name}({io.name}_inner),')
     else:
       top_inst.append(f'  .{io.name}({io.name}),')
 
@@ -126,12 +221,17 @@ def get_end():
   return ['endmodule']
 
 
-def get_axi_pipeline_wrapper(orig_top_name: str, top_name_suffix: str, top_task, part_num: str):
+def get_axi_pipeline_wrapper(orig_top_name: str, top_name_suffix: str, top_task, part_num: str,
+                             perf_fifos: Optional[Sequence[str]] = None,
+                             perf_loops: Sequence[str] = ()):
   """
   Given the original top RTL module
   Generate a wrapper that (1) instantiate the previous top module
   (2) pipeline all AXI interfaces
+  (3) if perf_fifos is not None, count the events of these FIFOs, of the
+  loops in perf_loops, and of all AXI interfaces; see get_perf_counter_names
   """
+  perf = perf_fifos is not None
   addr_width = get_max_addr_width(part_num)
 
   ast = top_task.module.ast
@@ -144,11 +244,13 @@ def get_axi_pipeline_wrapper(orig_top_name: str, top_name_suffix: str, top_task,
   io_list = parse_ports(ast)
 
   wrapper = []
-  wrapper += get_top(orig_top_name, io_list) + ['\n\n']
+  wrapper += get_top(orig_top_name, io_list, perf) + ['\n\n']
   wrapper += get_params(ast)
-  wrapper += get_wire_decl(io_list) + ['\n\n']
+  wrapper += get_wire_decl(io_list, perf) + ['\n\n']
   wrapper += get_pipeline_inst(axi_list) + ['\n\n']
-  wrapper += get_top_inst(f'{orig_top_name}{top_name_suffix}', io_list) + ['\n\n']
+  if perf:
+    wrapper += get_perf_inst(perf_fifos, perf_loops, axi_list) + ['\n\n']
+  wrapper += get_top_inst(f'{orig_top_name}{top_name_suffix}', io_list, perf) + ['\n\n']
   wrapper += get_end()
 
   return '\n'.join(wrapper)
@@ -0,0 +1,101 @@
+"""Synthesize several tasks in one Vitis HLS session.
+
+Each Vitis HLS session spends tens of seconds starting the tool and checking
+out a license, which dominates the synthesis of small tasks. A batch
+synthesizes each task in its own project within one session, with the same
+configuration as `haoda.backend.xilinx.RunHls`, and packs the results of each
+task into its own tarball.
+"""
+
+import logging
+import os.path
+import subprocess
+import tarfile
+import tempfile
+from typing import Iterable, NamedTuple, Set, Tuple, Union
+
+_logger = logging.getLogger().getChild(__name__)
+
+FAILED_MARKER = 'TAPA_BATCH_HLS_FAILED'
+
+TASK_TCL = '''
+open_project -reset {name}
+set_top {name}
+add_files "{cpp}" -cflags "-std={std} {cflags}"
+open_solution -reset {name}
+set_part {{{part_num}}}
+create_clock -period {clock_period} -name default
+config_compile -name_max_length 253
+config_interface -m_axi_addr64
+config_rtl -disable_start_propagation
+config_rtl -module_auto_prefix
+if {{[catch csynth_design]}} {{
+  puts "{marker} {name}"
+}}
+close_project
+'''
+
+
+class BatchedTask(NamedTuple):
+  name: str
+  cpp: str
+  cflags: str
+  clock_period: Union[int, float, str]
+  tar: str
+
+
+def run_batch_hls(
+    tasks: Iterable[BatchedTask],
+    part_num: str,
+    hls: str = 'vitis_hls',
+    std: str = 'c++17',
+) -> Tuple[Set[str], bytes]:
+  """Synthesizes `tasks` in one HLS session and writes their tarballs.
+
+  A task that fails does not stop the others. Tasks without results, e.g.,
+  because they failed or the session crashed, are left to the caller, which
+  should synthesize them one at a time to report their errors.
+
+  Returns:
+    The names of the tasks whose tarballs are written, and the output of the
+    session.
+  """
+  tasks = tuple(tasks)
+  script = ''.join(
+      TASK_TCL.format(
+          name=task.name,
+          cpp=task.cpp,
+          std=std,
+          cflags=task.cflags.replace('"', r'\"'),
+          part_num=part_num,
+          clock_period=task.clock_period,
+          marker=FAILED_MARKER,
+      ) for task in tasks) + 'exit\n'
+  done: Set[str] = set()
+  with tempfile.TemporaryDirectory(prefix='tapa-batch-hls-') as project_dir:
+    proc = subprocess.run(
+        [hls, '-f', '/dev/stdin'],
+        input=script.encode(),
+        cwd=project_dir,
+        stdout=subprocess.PIPE,
+        stderr=subprocess.STDOUT,
+        check=False,
+    )
+    failed = {
+        line.split()[-1]
+        for line in proc.stdout.decode('utf-8', 'replace').splitlines()
+        if line.startswith(FAILED_MARKER)
+    }
+    for task in tasks:
+      solution_dir = os.path.join(project_dir, task.name, task.name)
+      report_dir = os.path.join(solution_dir, 'syn', 'report')
+      verilog_dir = os.path.join(solution_dir, 'syn', 'verilog')
+      if task.name in failed or not os.path.isdir(verilog_dir):
+        _logger.debug('batched HLS produced no result for %s', task.name)
+        continue
+      with open(task.tar, 'wb') as tarfileobj:
+        with tarfile.open(mode='w', fileobj=tarfileobj) as tar:
+          tar.add(report_dir, arcname='report')
+          tar.add(verilog_dir, arcname='hdl')
+      done.add(task.name)
+  return done, proc.stdout
@@ -1,35 +1,76 @@
 import collections
 import decimal
+import fractions
+import functools
+import hashlib
+import io
 import itertools
 import json
 import logging
+import math
+import multiprocessing
 import os.path
 import os
+import pickle
+import re
 import shutil
+import subprocess
 import sys
 import tarfile
 import tempfile
+import threading
+import time
 import xml.etree.ElementTree as ET
 from concurrent import futures
-from typing import (Any, BinaryIO, Dict, List, Optional, Set, TextIO, Tuple,
-                    Union)
+from typing import (Any, BinaryIO, Dict, Iterable, Iterator, List, Optional,
+                    Set, TextIO, Tuple, Union)
 
 import toposort
 import yaml
 from haoda.backend import xilinx as hls
 
-from tapa import util
-from tapa.floorplan import get_floorplan_result, generate_floorplan, checkpoint_floorplan
+from tapa import batch_hls, util
+from tapa.floorplan import (get_floorplan_result, generate_floorplan, checkpoint_floorplan,
+                            load_timing_refinement, refine_from_timing,
+                            generate_connectivity, get_floorplan_config,
+                            DEFAULT_FIFO_MAX_USAGE)
+from tapa.multi_device import partition_devices
 from tapa.verilog import ast
 from tapa.verilog import xilinx as rtl
 
+from .hardware import is_versal
 from .instance import Instance, Port
-from .axi_pipeline import get_axi_pipeline_wrapper
+from .axi_pipeline import (PERF_BASE_ADDR, PERF_MAX_COUNTERS, PERF_PREFIX,
+                           get_axi_pipeline_wrapper, get_perf_counter_names)
 from .task import Task
-from .safety_check import check_mmap_arg_name
+from .task_graph import make_autobridge_area
+from .safety_check import check_mmap_arg_name, check_stream_rates
 
 _logger = logging.getLogger().getChild(__name__)
 
+# Tasks whose HLS took longer than this many seconds are never batched.
+HLS_BATCH_MAX_DURATION = 60.
+
+# HLS report of an RTL task, whose area and latency are unknown.
+RTL_TASK_REPORT = '''<profile>
+  <PerformanceEstimates>
+    <SummaryOfTimingAnalysis>
+      <EstimatedClockPeriod>{clock_period}</EstimatedClockPeriod>
+    </SummaryOfTimingAnalysis>
+  </PerformanceEstimates>
+  <AreaEstimates>
+    <Resources>
+      <BRAM_18K>0</BRAM_18K>
+      <DSP>0</DSP>
+      <FF>0</FF>
+      <LUT>0</LUT>
+      <URAM>0</URAM>
+    </Resources>
+    <AvailableResources />
+  </AreaEstimates>
+</profile>
+'''
+
 STATE00 = ast.IntConst("2'b00")
 STATE01 = ast.IntConst("2'b01")
 STATE11 = ast.IntConst("2'b11")
@@ -40,6 +81,143 @@ class InputError(Exception):
   pass
 
 
+@functools.lru_cache(maxsize=None)
+def get_hls_version(hls_exe: str) -> str:
+  """Returns the version banner of the HLS tool, or '' if it cannot be run."""
+  # The tool writes its log into the working directory.
+  with tempfile.TemporaryDirectory(prefix='tapa-hls-version-') as tmp_dir:
+    try:
+      return subprocess.check_output(
+          [hls_exe, '-version'],
+          cwd=tmp_dir,
+          stderr=subprocess.DEVNULL,
+          universal_newlines=True,
+      ).strip()
+    except (OSError, subprocess.CalledProcessError):
+      return ''
+
+
+def get_control_registers(s_axi_rtl: str) -> Dict[str, List[Tuple[int, int]]]:
+  """Returns the control registers of each argument of the top-level task.
+
+  Args:
+    s_axi_rtl: Content of the ``*_control_s_axi.v`` file generated by HLS,
+        of which the comments document the address map, e.g.,
+        ``// 0x14 : Data signal of a`` and ``//        bit 31~0 - a[63:32]``.
+
+  Returns:
+    Dict mapping argument names to lists of (offset, lsb) of each register,
+    where lsb is the first bit of the argument in the register.
+  """
+  registers: Dict[str, List[Tuple[int, int]]] = collections.defaultdict(list)
+  offset = None
+  for line in s_axi_rtl.splitlines():
+    match = re.match(r'//\s*0x([0-9a-fA-F]+)\s*:\s*Data signal of (\w+)', line)
+    if match is not None:
+      offset = int(match[1], 16)
+      continue
+    match = re.match(r'//\s*bit \d+~0 - (\w+)\[\d+:(\d+)\]', line)
+    if match is not None and offset is not None:
+      registers[match[1]].append((offset, int(match[2])))
+    offset = None
+  return registers
+
+
+def get_autotune_cflags(params: Dict[str, Any]) -> str:
+  """Returns the cflags defining autotuned parameters as macros."""
+  return ' '.join(f'-D{name}={value}' for name, value in sorted(params.items()))
+
+
+def get_hls_report_metrics(tree: ET.ElementTree) -> Dict[str, Any]:
+  """Returns the clock period, latency, II, and area estimated by HLS.
+
+  The latency is None if it is unknown, e.g., for tasks with unbounded loops,
+  and the II is that of the slowest pipelined loop, or None if no loop is
+  pipelined.
+  """
+  performance = tree.find('./PerformanceEstimates')
+  latency = performance.find('./SummaryOfOverallLatency/Worst-caseLatency')
+  iis = [
+      int(x.text)
+      for x in performance.iterfind('./SummaryOfLoopLatency//PipelineII')
+      if x.text and x.text.isdigit()
+  ]
+  return {
+      'estimated_clock_period': performance.find(
+          './SummaryOfTimingAnalysis/EstimatedClockPeriod').text,
+      'latency': (int(latency.text) if latency is not None and latency.text and
+                  latency.text.isdigit() else None),
+      'ii': max(iis) if iis else None,
+      'area': {
+          x.tag: int(x.text) for x in tree.find('./AreaEstimates/Resources')
+      },
+      'available': {
+          x.tag: int(x.text)
+          for x in tree.find('./AreaEstimates/AvailableResources')
+      },
+  }
+
+
+def deduplicate_tasks(tasks: Dict[str, Any], top: str) -> None:
+  """Merge lower-level tasks whose code is identical up to their names.
+
+  Instances of each duplicate are appended to those of the first task, in
+  alphabetical order, with the same code and metadata, so that each distinct
+  task is synthesized and parsed only once.
+
+  Args:
+    tasks: Dict mapping task names to task metadata generated by tapacc,
+        modified in place.
+    top: Name of the top-level task, which is never merged.
+  """
+  canonical_names: Dict[str, str] = {}
+  aliases: Dict[str, str] = {}
+  for name, task in sorted(tasks.items()):
+    # Each RTL task is implemented by its own Verilog module.
+    if task['level'] != 'lower' or name == top or 'rtl' in task:
+      continue
+    if 'code' in task:
+      code = task['code']
+    else:
+      with open(task['code_file']) as fp:
+        code = fp.read()
+    key = json.dumps(
+        {
+            'code': re.sub(rf'\b{re.escape(name)}\b', '\0', code),
+            **{
+                k: v
+                for k, v in task.items()
+                if k not in {'code', 'code_file', 'hash'}
+            },
+        },
+        sort_keys=True,
+    )
+    canonical_name = canonical_names.setdefault(key, name)
+    if canonical_name != name:
+      _logger.info('task %s is identical to %s', name, canonical_name)
+      aliases[name] = canonical_name
+  if not aliases:
+    return
+
+  for task in tasks.values():
+    if 'tasks' not in task:
+      continue
+    new_indices: Dict[Tuple[str, int], List[Union[str, int]]] = {}
+    for name in list(task['tasks']):
+      if name not in aliases:
+        continue
+      instances = task['tasks'].setdefault(aliases[name], [])
+      for idx, instance in enumerate(task['tasks'].pop(name)):
+        new_indices[name, idx] = [aliases[name], len(instances)]
+        instances.append(instance)
+    for fifo in task.get('fifos', {}).values():
+      for direction in 'produced_by', 'consumed_by':
+        if direction in fifo and tuple(fifo[direction]) in new_indices:
+          fifo[direction] = new_indices[tuple(fifo[direction])]
+  for name in aliases:
+    del tasks[name]
+
+
 class Program:
   """Describes a TAPA program.
 
@@ -67,6 +245,7 @@ class Program:
     """
     obj = json.load(fp)
     self.top: str = obj['top']
+    deduplicate_tasks(obj['tasks'], self.top)
     self.cflags = cflags
     self.headers: Dict[str, str] = obj.get('headers', {})
     if work_dir is None:
@@ -86,6 +265,17 @@ class Program:
     self.frt_interface = obj['tasks'][self.top].get('frt_interface')
     self.files: Dict[str, str] = {}
     self._hls_report_xmls: Dict[str, ET.ElementTree] = {}
+    self._are_fifo_depths_inferred = False
+    self._clk_2_tasks: Set[str] = set()
+    self._async_mmap_max_outstanding = 64
+    self._async_mmap_write_combine_window = 0
+    self._async_mmap_bus_width = 0
+    # FIFOs of the top-level task with performance counters, if enabled
+    self._perf_fifos: Optional[List[str]] = None
+    # (instance, loop) of the top-level task with performance counters
+    self._perf_loops: List[Tuple[str, str]] = []
+    # element widths of the mmap ports widened to the async_mmap bus width
+    self._mmap_elem_widths: Dict[Tuple[str, str], int] = {}
 
   def __del__(self):
     if self.is_temp:
@@ -135,6 +325,25 @@ class Program:
     os.makedirs(os.path.join(self.work_dir, 'tar'), exist_ok=True)
     return os.path.join(self.work_dir, 'tar', name + '.tar')
 
+  def get_tar_hash(self, name: str) -> str:
+    return self.get_tar(name) + '.hash'
+
+  @staticmethod
+  def get_cached_tar(cache_dir: str, hls_hash: str) -> str:
+    return os.path.join(cache_dir, hls_hash[:2], hls_hash + '.tar')
+
+  @property
+  def autotune_json(self) -> str:
+    return os.path.join(self.work_dir, 'autotune.json')
+
+  @property
+  def clock_domains_json(self) -> str:
+    return os.path.join(self.work_dir, 'clock_domains.json')
+
+  def get_rtl_cache(self, name: str) -> str:
+    os.makedirs(os.path.join(self.work_dir, 'rtl_cache'), exist_ok=True)
+    return os.path.join(self.work_dir, 'rtl_cache', name + '.pickle')
+
   def get_rtl(self, name: str, prefix: bool = True) -> str:
     return os.path.join(self.rtl_dir,
                         (util.get_module_name(name) if prefix else name) +
@@ -160,10 +369,30 @@ class Program:
                                             '/SummaryOfTimingAnalysis'
                                             '/EstimatedClockPeriod').text)
 
+  def get_latency(self, name: str) -> int:
+    """Latency in cycles before a task produces outputs, estimated by HLS.
+
+    This is the depth of the deepest pipelined loop, or the worst-case latency
+    of the task if it has no pipelined loops, or 1 if neither is known.
+    """
+    performance = self._get_hls_report_xml(name).find('./PerformanceEstimates')
+    depths = [
+        int(x.text)
+        for x in performance.iterfind('./SummaryOfLoopLatency//PipelineDepth')
+        if x.text and x.text.isdigit()
+    ]
+    if depths:
+      return max(depths)
+    node = performance.find('./SummaryOfOverallLatency/Worst-caseLatency')
+    if node is not None and node.text and node.text.isdigit():
+      return max(int(node.text), 1)
+    return 1
+
   def extract_cpp(self) -> 'Program':
     """Extract HLS C++ files."""
     _logger.info('extracting HLS C++ files')
     check_mmap_arg_name(self._tasks.values())
+    check_stream_rates(self._tasks.values())
 
     for task in self._tasks.values():
       with open(self.get_cpp(task.name), 'w') as src_code:
@@ -175,108 +404,806 @@ class Program:
         header_fp.write(content)
     return self
 
-  def run_hls(self, clock_period: Union[int, float, str],
-              part_num: str) -> 'Program':
-    """Run HLS with extracted HLS C++ files and generate tarballs."""
+  def run_hls(
+      self,
+      clock_period: Union[int, float, str],
+      part_num: str,
+      cache_dir: Optional[str] = None,
+      jobs: Optional[int] = None,
+      mem_per_job: float = 8.,
+      task_clock_periods: Optional[Dict[str, Union[int, float, str]]] = None,
+      parse_rtl: bool = False,
+      hls_batch_size: int = 1,
+  ) -> 'Program':
+    """Run HLS with extracted HLS C++ files and generate tarballs.
+
+    Tasks that took longest to synthesize last time are started first, and
+    tasks never synthesized before are started before them. If any task fails,
+    tasks not started yet are cancelled.
+
+    Args:
+      clock_period: Target clock period in nanoseconds.
+      part_num: Target FPGA part number.
+      cache_dir: Optional directory shared by work directories and users, in
+          which tarballs are stored by the hash of everything that affects
+          HLS, so that an identical task is synthesized only once.
+      jobs: Maximum number of concurrent HLS jobs. Defaults to the number of
+          CPUs, further limited by the available memory.
+      mem_per_job: Memory in GiB reserved for each HLS job, used to limit the
+          number of concurrent jobs if `jobs` is not set.
+      task_clock_periods: Clock periods of lower-level tasks that run on
+          `ap_clk_2` instead of `ap_clk`, keyed by task name. At most one
+          period other than `clock_period` is allowed.
+      parse_rtl: Whether to extract and parse the RTL of each task as soon as
+          its HLS finishes, overlapping with the remaining HLS jobs, so that
+          `generate_task_rtl` finds it cached.
+      hls_batch_size: Maximum number of tasks synthesized in one HLS session
+          to amortize the startup of the tool. Only tasks that took less than
+          `HLS_BATCH_MAX_DURATION` seconds last time, or were never
+          synthesized, are batched. Tasks that fail in a batch are synthesized
+          again alone.
+    """
     self.extract_cpp()
+    clock_periods = self._assign_clock_domains(clock_period,
+                                               task_clock_periods or {})
+
+    if jobs is None:
+      jobs = util.get_max_jobs(mem_per_job)
+    _logger.info('running HLS with up to %d concurrent jobs', jobs)
+
+    durations_json = os.path.join(self.work_dir, 'hls_durations.json')
+    durations: Dict[str, float] = {}
+    try:
+      with open(durations_json) as durations_fp:
+        durations = json.load(durations_fp)
+    except (FileNotFoundError, ValueError):
+      pass
+    tasks = sorted(
+        self._tasks.values(),
+        key=lambda task: (durations.get(task.name, math.inf), len(task.code)),
+        reverse=True,
+    )
+
+    tuned_configs: Dict[str, Dict[str, Any]] = {}
+    try:
+      with open(self.autotune_json) as autotune_fp:
+        tuned_configs = json.load(autotune_fp)
+    except FileNotFoundError:
+      pass
+
+    hls_exe = 'vitis_hls'
+    hls_version = get_hls_version(hls_exe)
+    def get_hls_config(
+        task: Task) -> Tuple[str, Union[int, float, str], str]:
+      """Returns the cflags, clock period, and HLS hash of `task`."""
+      tuned_config = tuned_configs.get(task.name, {})
+      cflags = ' '.join(
+          filter(None, (self.cflags,
+                        get_autotune_cflags(tuned_config.get('params', {})))))
+      task_clock_period = tuned_config.get('clock_period',
+                                           clock_periods[task.name])
+      hls_hash = ''
+      if task.hash:
+        hls_hash = hashlib.sha256('\0'.join((
+            task.name,
+            task.hash,
+            cflags,
+            str(task_clock_period),
+            part_num,
+            hls_version,
+        )).encode()).hexdigest()
+      return cflags, task_clock_period, hls_hash
+
+    def reuse_tar(task: Task, hls_hash: str) -> bool:
+      """Returns whether the tarball of `task` is reused, either because the
+      task is unchanged since it was generated or from the cache."""
+      if not hls_hash:
+        return False
+      try:
+        with open(self.get_tar_hash(task.name)) as hash_fp:
+          if (hash_fp.read() == hls_hash and
+              os.path.isfile(self.get_tar(task.name))):
+            _logger.info('skipping HLS for unchanged task %s', task.name)
+            return True
+      except FileNotFoundError:
+        pass
+      if cache_dir is not None:
+        cached_tar = self.get_cached_tar(cache_dir, hls_hash)
+        try:
+          shutil.copyfile(cached_tar, self.get_tar(task.name))
+        except FileNotFoundError:
+          pass
+        else:
+          _logger.info('reusing cached HLS result for task %s', task.name)
+          with open(self.get_tar_hash(task.name), 'w') as hash_fp:
+            hash_fp.write(hls_hash)
+          return True
+      # Invalidate the cached tarball before it is overwritten.
+      if os.path.exists(self.get_tar_hash(task.name)):
+        os.remove(self.get_tar_hash(task.name))
+      return False
+
+    def save_tar(task: Task, hls_hash: str) -> None:
+      if hls_hash:
+        with open(self.get_tar_hash(task.name), 'w') as hash_fp:
+          hash_fp.write(hls_hash)
+        if cache_dir is not None:
+          self._add_to_cache(cache_dir, hls_hash, self.get_tar(task.name))
+
+    def worker(task: Task, idx: int, retries: int = 2) -> None:
+      cflags, task_clock_period, hls_hash = get_hls_config(task)
+      if task.rtl is not None:
+        self._pack_rtl_task(task, task_clock_period)
+        return
+      if reuse_tar(task, hls_hash):
+        return
 
-    _logger.info('running HLS')
-    def worker(task: Task, idx: int) -> None:
       os.nice(idx % 19)
+      start_time = time.monotonic()
       with open(self.get_tar(task.name), 'wb') as tarfileobj:
         with hls.RunHls(
             tarfileobj,
-            kernel_files=[(self.get_cpp(task.name), self.cflags)],
+            kernel_files=[(self.get_cpp(task.name), cflags)],
             top_name=task.name,
-            clock_period=clock_period,
+            clock_period=task_clock_period,
             part_num=part_num,
             auto_prefix=True,
-            hls='vitis_hls',
+            hls=hls_exe,
             std='c++17',
         ) as proc:
           stdout, stderr = proc.communicate()
       if proc.returncode != 0:
-        if b'Pre-synthesis failed.' in stdout and b'\nERROR:' not in stdout:
+        if (retries > 0 and b'Pre-synthesis failed.' in stdout and
+            b'\nERROR:' not in stdout):
           _logger.error(
               'HLS failed for %s, but the failure may be flaky; retrying',
               task.name,
           )
-          worker(task, 0)
+          worker(task, 0, retries - 1)
           return
         sys.stdout.write(stdout.decode('utf-8'))
         sys.stderr.write(stderr.decode('utf-8'))
         raise RuntimeError('HLS failed for {}'.format(task.name))
+      durations[task.name] = time.monotonic() - start_time
+      save_tar(task, hls_hash)
 
-    with futures.ThreadPoolExecutor(max_workers=os.cpu_count()) as executor:
-      any(executor.map(worker, self._tasks.values(), itertools.count(0)))
+    def batch_worker(batch: List[Task], idx: int) -> None:
+      configs = [get_hls_config(task) for task in batch]
+      os.nice(idx % 19)
+      _logger.info('running HLS for %s in one session',
+                   ', '.join(task.name for task in batch))
+      start_time = time.monotonic()
+      done, stdout = batch_hls.run_batch_hls(
+          (batch_hls.BatchedTask(
+              name=task.name,
+              cpp=self.get_cpp(task.name),
+              cflags=cflags,
+              clock_period=task_clock_period,
+              tar=self.get_tar(task.name),
+          ) for task, (cflags, task_clock_period, _) in zip(batch, configs)),
+          part_num=part_num,
+          hls=hls_exe,
+      )
+      # The duration of each task is unknown, so the batch is split evenly.
+      duration = (time.monotonic() - start_time) / len(batch)
+      for task, (_, _, hls_hash) in zip(batch, configs):
+        if task.name in done:
+          durations[task.name] = duration
+          save_tar(task, hls_hash)
+        else:
+          _logger.warning('batched HLS failed for %s; running it alone',
+                          task.name)
+          _logger.debug('%s', stdout.decode('utf-8', 'replace'))
+          worker(task, idx)
+
+    # Tasks that took less than `HLS_BATCH_MAX_DURATION` last time, or were
+    # never synthesized, are synthesized in batches.
+    units: List[List[Task]] = []
+    reused: Set[str] = set()
+    batch: List[Task] = []
+    for task in tasks:
+      if (hls_batch_size > 1 and task.rtl is None and
+          durations.get(task.name, 0.) < HLS_BATCH_MAX_DURATION):
+        if reuse_tar(task, get_hls_config(task)[2]):
+          reused.add(task.name)
+          units.append([task])
+          continue
+        batch.append(task)
+        if len(batch) == hls_batch_size:
+          units.append(batch)
+          batch = []
+      else:
+        units.append([task])
+    if batch:
+      units.append(batch)
+
+    # Parsers are not forked from this process, whose HLS threads may hold
+    # locks at the time.
+    rtl_executor = futures.ProcessPoolExecutor(
+        mp_context=multiprocessing.get_context('forkserver'),
+    ) if parse_rtl else None
+    parsed_modules: List[Tuple[Task, str, str, futures.Future]] = []
+    # Tarballs may contain the same auxiliary files.
+    extract_lock = threading.Lock()
+
+    def pipelined_worker(unit: List[Task], idx: int) -> None:
+      if len(unit) > 1:
+        batch_worker(unit, idx)
+      elif unit[0].name not in reused:
+        worker(unit[0], idx)
+      if rtl_executor is not None:
+        for task in unit:
+          prepare_rtl(task)
+
+    def prepare_rtl(task: Task) -> None:
+      tar_hash = self._hash_tar(task.name)
+      if self._get_cached_module(task.name, tar_hash) is not None:
+        return
+      with extract_lock, tarfile.open(self.get_tar(task.name),
+                                      'r') as tarfileobj:
+        tarfileobj.extractall(path=self.work_dir)
+      self._get_hls_report_xml(task.name)
+      rtl_hash = self._get_rtl_hash(task)
+      module = self._get_module_by_content(rtl_hash)
+      if module is not None:
+        self._cache_module(task, tar_hash, rtl_hash, module)
+        return
+      parsed_modules.append((task, tar_hash, rtl_hash,
+                             rtl_executor.submit(rtl.Module,
+                                                 [self.get_rtl(task.name)],
+                                                 not task.is_upper)))
+
+    try:
+      with futures.ThreadPoolExecutor(max_workers=jobs) as executor:
+        done, not_done = futures.wait(
+            [
+                executor.submit(pipelined_worker, unit, idx)
+                for idx, unit in enumerate(units)
+            ],
+            return_when=futures.FIRST_EXCEPTION,
+        )
+        for future in not_done:
+          future.cancel()
+        for future in done:
+          future.result()
+      for task, tar_hash, rtl_hash, future in parsed_modules:
+        _logger.debug('parsed %s', task.name)
+        self._cache_module(task, tar_hash, rtl_hash, future.result())
+    finally:
+      if rtl_executor is not None:
+        rtl_executor.shutdown()
+      with open(durations_json, 'w') as durations_fp:
+        json.dump(durations, durations_fp, indent=2)
 
     return self
 
+  def _pack_rtl_task(self, task: Task,
+                     clock_period: Union[int, float, str]) -> None:
+    """Packs the Verilog of an RTL task as if it were generated by HLS.
+
+    The Verilog file must define a module named after the task, with the ports
+    that HLS would generate for the task, i.e., `ap_clk`, `ap_rst_n`, the
+    `ap_ctrl_hs` handshake, and stream, mmap, and scalar ports named after the
+    task parameters. Its HLS report claims no area and meets `clock_period`.
+    The tarball is deterministic so that unchanged RTL is not parsed again.
+    """
+    with open(task.rtl, 'rb') as rtl_fp:
+      verilog = rtl_fp.read()
+    module_name = util.get_module_name(task.name)
+    if not re.search(rb'\bmodule\s+' + re.escape(module_name.encode()) + rb'\b',
+                     verilog):
+      raise ValueError(
+          f'{task.rtl} does not define module {module_name} of RTL task '
+          f'{task.name}')
+    _logger.info('using %s for RTL task %s instead of HLS', task.rtl,
+                 task.name)
+    report = RTL_TASK_REPORT.format(clock_period=clock_period).encode()
+    with tarfile.open(self.get_tar(task.name), 'w') as tar:
+      for arcname, content in (
+          (f'hdl/{module_name}{rtl.RTL_SUFFIX}', verilog),
+          (f'report/{task.name}_csynth.xml', report),
+      ):
+        info = tarfile.TarInfo(arcname)
+        info.size = len(content)
+        tar.addfile(info, io.BytesIO(content))
+
+  def autotune_hls(
+      self,
+      space: TextIO,
+      clock_period: Union[int, float, str],
+      part_num: str,
+      max_usage: Optional[float] = None,
+      jobs: Optional[int] = None,
+      mem_per_job: float = 8.,
+  ) -> 'Program':
+    """Synthesize variants of tasks and choose the best variant of each task.
+
+    Every combination of parameter values is synthesized with the parameters
+    defined as macros, so that the task code may use them in pragmas, e.g.,
+    ``#pragma HLS unroll factor=UNROLL``. The special parameter
+    ``clock_period`` sets the HLS target clock period of the variant instead.
+
+    Among variants whose instances fit in `max_usage` of the device, the
+    Pareto front of time and resource usage is computed, and the fastest
+    variant is chosen. Time is the estimated latency, or the II if the latency
+    of some variant is unknown, multiplied by the estimated clock period. The
+    choices, together with all results, are saved in ``autotune.json`` in the
+    work directory and used by `run_hls`.
+
+    Args:
+      space: JSON object mapping task names to parameter spaces, each mapping
+          parameter names to lists of values, e.g.,
+          ``{"PE": {"UNROLL": [2, 4, 8], "clock_period": ["3.33", "2.5"]}}``.
+      clock_period: Default HLS target clock period in nanoseconds.
+      part_num: Target FPGA part number.
+      max_usage: Maximum fraction of any resource of the device used by all
+          instances of a task. Defaults to 1.
+      jobs: Maximum number of concurrent HLS jobs. Defaults to the number of
+          CPUs, further limited by the available memory.
+      mem_per_job: Memory in GiB reserved for each HLS job, used to limit the
+          number of concurrent jobs if `jobs` is not set.
+    """
+    self.extract_cpp()
+    if max_usage is None:
+      max_usage = 1.
+    if jobs is None:
+      jobs = util.get_max_jobs(mem_per_job)
+
+    variants: List[Tuple[str, Dict[str, Any], Union[int, float, str]]] = []
+    period_tuned_tasks: Set[str] = set()
+    for task_name, params in json.load(space).items():
+      if task_name not in self._tasks:
+        raise ValueError(f'cannot autotune unknown task {task_name}')
+      params = dict(params)
+      if 'clock_period' in params:
+        period_tuned_tasks.add(task_name)
+      periods = params.pop('clock_period', [clock_period])
+      names = sorted(params)
+      for period in periods:
+        for values in itertools.product(*(params[x] for x in names)):
+          variants.append((task_name, dict(zip(names, values)), period))
+    _logger.info('autotuning %d variants with up to %d concurrent jobs',
+                 len(variants), jobs)
+
+    hls_exe = 'vitis_hls'
+    hls_version = get_hls_version(hls_exe)
+    def worker(
+        variant: Tuple[str, Dict[str, Any], Union[int, float, str]],
+        idx: int,
+    ) -> Optional[Dict[str, Any]]:
+      task_name, params, period = variant
+      cflags = ' '.join(filter(None, (self.cflags, get_autotune_cflags(params))))
+      variant_hash = hashlib.sha256('\0'.join((
+          task_name,
+          self._tasks[task_name].code,
+          cflags,
+          str(period),
+          part_num,
+          hls_version,
+      )).encode()).hexdigest()
+      variant_dir = os.path.join(self.work_dir, 'autotune', task_name)
+      os.makedirs(variant_dir, exist_ok=True)
+      report_xml = os.path.join(variant_dir, f'{variant_hash}_csynth.xml')
+
+      # Reuse the report if the variant was synthesized before.
+      if not os.path.isfile(report_xml):
+        os.nice(idx % 19)
+        with tempfile.TemporaryFile() as tarfileobj:
+          with hls.RunHls(
+              tarfileobj,
+              kernel_files=[(self.get_cpp(task_name), cflags)],
+              top_name=task_name,
+              clock_period=period,
+              part_num=part_num,
+              auto_prefix=True,
+              hls=hls_exe,
+              std='c++17',
+          ) as proc:
+            stdout, _ = proc.communicate()
+          if proc.returncode != 0:
+            _logger.warning('HLS failed for %s with %s and clock period %s',
+                            task_name, cflags, period)
+            _logger.debug('%s', stdout.decode('utf-8'))
+            return None
+          tarfileobj.seek(0)
+          with tarfile.open(fileobj=tarfileobj) as tar:
+            member = next(
+                x for x in tar.getmembers()
+                if x.name.endswith(f'report/{task_name}_csynth.xml'))
+            util.write_if_changed(report_xml,
+                                  tar.extractfile(member).read().decode())
+      return {
+          'params': params,
+          'clock_period': str(period),
+          **get_hls_report_metrics(ET.parse(report_xml)),
+      }
+
+    with futures.ThreadPoolExecutor(max_workers=jobs) as executor:
+      results = list(executor.map(worker, variants, itertools.count(0)))
+
+    results_by_task: Dict[str, List[Dict[str, Any]]] = collections.defaultdict(
+        list)
+    for (task_name, _, _), result in zip(variants, results):
+      if result is not None:
+        results_by_task[task_name].append(result)
+
+    instance_counts: Dict[str, int] = collections.Counter()
+    for task in self._tasks.values():
+      for name, instances in task.tasks.items():
+        instance_counts[name] += len(instances)
+
+    tuned_configs: Dict[str, Dict[str, Any]] = {}
+    for task_name, task_results in results_by_task.items():
+      for result in task_results:
+        result['usage'] = max(
+            (amount / result['available'][resource]
+             for resource, amount in result['area'].items()
+             if result['available'].get(resource)),
+            default=0.,
+        ) * max(instance_counts[task_name], 1)
+      feasible = [x for x in task_results if x['usage'] <= max_usage]
+      if not feasible:
+        _logger.warning('no variant of %s fits in the area budget', task_name)
+        continue
+
+      cycle_key = ('latency' if all(x['latency'] is not None for x in feasible)
+                   else 'ii')
+      for result in feasible:
+        result['time'] = (result[cycle_key] or math.inf) * float(
+            result['estimated_clock_period'])
+      pareto: List[Dict[str, Any]] = []
+      for result in sorted(feasible, key=lambda x: (x['time'], x['usage'])):
+        if not pareto or result['usage'] < pareto[-1]['usage']:
+          pareto.append(result)
+      best = pareto[0]
+      _logger.info(
+          'chose %s with clock period %s for %s: %s %s, %.1f%% of the device',
+          best['params'], best['clock_period'], task_name, cycle_key,
+          best[cycle_key], best['usage'] * 100)
+      tuned_configs[task_name] = {
+          'params': best['params'],
+          'pareto': pareto,
+          'results': task_results,
+      }
+      if task_name in period_tuned_tasks:
+        tuned_configs[task_name]['clock_period'] = best['clock_period']
+
+    with open(self.autotune_json, 'w') as autotune_fp:
+      json.dump(tuned_configs, autotune_fp, indent=2)
+    return self
+
+  def _assign_clock_domains(
+      self,
+      clock_period: Union[int, float, str],
+      task_clock_periods: Dict[str, Union[int, float, str]],
+  ) -> Dict[str, Union[int, float, str]]:
+    """Assign each task to `ap_clk` or `ap_clk_2` and return its clock period.
+
+    Tasks on `ap_clk_2` are recorded in the work directory so that later steps
+    can insert clock domain crossings. Double-pumped tasks run on `ap_clk_2`
+    at half of `clock_period`.
+    """
+    clock_periods: Dict[str, Union[int, float, str]] = {
+        name: clock_period for name in self._tasks
+    }
+    task_clock_periods = dict(task_clock_periods)
+    double_pump_period = decimal.Decimal(str(clock_period)) / 2
+    for name, task in self._tasks.items():
+      if not task.double_pump:
+        continue
+      period = task_clock_periods.setdefault(name, str(double_pump_period))
+      if decimal.Decimal(str(period)) != double_pump_period:
+        raise ValueError(
+            f'cannot set clock period of double-pumped task {name} to '
+            f'{period}; it runs at half of --clock-period')
+    secondary_periods: Set[decimal.Decimal] = set()
+    self._clk_2_tasks = set()
+    for name, period in task_clock_periods.items():
+      if name not in self._tasks:
+        raise ValueError(f'cannot set clock period of unknown task {name}')
+      if decimal.Decimal(str(period)) == decimal.Decimal(str(clock_period)):
+        continue
+      if self._tasks[name].is_upper:
+        raise ValueError(
+            f'cannot set clock period of upper-level task {name}; set it '
+            'for its children instead')
+      secondary_periods.add(decimal.Decimal(str(period)))
+      clock_periods[name] = period
+      self._clk_2_tasks.add(name)
+    if len(secondary_periods) > 1:
+      raise ValueError(
+          'at most one clock period other than --clock-period is supported, '
+          f'got {", ".join(map(str, sorted(secondary_periods)))}')
+    for name in sorted(self._clk_2_tasks):
+      _logger.info('task %s runs on %s with clock period %s', name,
+                   rtl.HANDSHAKE_CLK_2, clock_periods[name])
+    with open(self.clock_domains_json, 'w') as clock_domains_fp:
+      json.dump(sorted(self._clk_2_tasks), clock_domains_fp, indent=2)
+    return clock_periods
+
+  @classmethod
+  def _add_to_cache(cls, cache_dir: str, hls_hash: str, tar: str) -> None:
+    """Atomically store `tar` in the shared HLS cache.
+
+    Failures are logged but not raised, since the cache is only an
+    optimization.
+    """
+    cached_tar = cls.get_cached_tar(cache_dir, hls_hash)
+    try:
+      os.makedirs(os.path.dirname(cached_tar), exist_ok=True)
+      fd, tmp_tar = tempfile.mkstemp(dir=os.path.dirname(cached_tar),
+                                     suffix='.tmp')
+      try:
+        with open(tar, 'rb') as src_fp, os.fdopen(fd, 'wb') as dst_fp:
+          shutil.copyfileobj(src_fp, dst_fp)
+        # Concurrent writers of the same hash produce equivalent tarballs, so
+        # whichever is renamed last wins.
+        os.replace(tmp_tar, cached_tar)
+      except BaseException:
+        os.remove(tmp_tar)
+        raise
+    except OSError as e:
+      _logger.warning('cannot cache HLS result in %s: %s', cache_dir, e)
+
+  def _hash_tar(self, name: str) -> str:
+    with open(self.get_tar(name), 'rb') as tar_fp:
+      return hashlib.sha256(tar_fp.read()).hexdigest()
+
+  def _get_cached_module(self, name: str,
+                         tar_hash: str) -> Optional[rtl.Module]:
+    """Returns the parsed RTL of task `name` if it is cached and extracted from
+    the tarball of `tar_hash`, or None otherwise."""
+    try:
+      with open(self.get_rtl_cache(name), 'rb') as cache_fp:
+        cached_tar_hash, module = pickle.load(cache_fp)
+    except (OSError, EOFError, pickle.UnpicklingError):
+      return None
+    if cached_tar_hash != tar_hash or not os.path.isfile(self.get_rtl(name)):
+      return None
+    return module
+
+  def get_rtl_content_cache(self, rtl_hash: str) -> str:
+    os.makedirs(os.path.join(self.work_dir, 'rtl_cache', 'content'),
+                exist_ok=True)
+    return os.path.join(self.work_dir, 'rtl_cache', 'content',
+                        rtl_hash + '.pickle')
+
+  def _get_rtl_hash(self, task: Task) -> str:
+    """Returns the digest of the extracted RTL of `task` and how it is parsed.
+
+    HLS may generate identical RTL in different tarballs, e.g., if it is rerun
+    with flags that do not affect the task, so parsed RTL is also cached by
+    this digest.
+    """
+    with open(self.get_rtl(task.name), 'rb') as rtl_fp:
+      return hashlib.sha256(rtl_fp.read() +
+                            str(task.is_upper).encode()).hexdigest()
+
+  def _get_module_by_content(self, rtl_hash: str) -> Optional[rtl.Module]:
+    try:
+      with open(self.get_rtl_content_cache(rtl_hash), 'rb') as cache_fp:
+        return pickle.load(cache_fp)
+    except (OSError, EOFError, pickle.UnpicklingError):
+      return None
+
+  def _cache_module(self, task: Task, tar_hash: str, rtl_hash: str,
+                    module: rtl.Module) -> None:
+    """Caches the parsed RTL of `task` by its tarball and by its content."""
+    with open(self.get_rtl_cache(task.name), 'wb') as cache_fp:
+      pickle.dump((tar_hash, module), cache_fp)
+    with open(self.get_rtl_content_cache(rtl_hash), 'wb') as cache_fp:
+      pickle.dump(module, cache_fp)
+
   def generate_task_rtl(
     self,
     additional_fifo_pipelining: bool = False,
     part_num: str = '',
+    auto_fifo_depth: bool = False,
+    async_mmap_id_width: int = 1,
+    async_mmap_max_outstanding: int = 64,
+    async_mmap_write_combine_window: int = 0,
+    almost_full_fifo: bool = False,
+    async_mmap_bus_width: int = 0,
   ) -> 'Program':
-    """Extract HDL files from tarballs generated from HLS."""
+    """Extract HDL files from tarballs generated from HLS.
+
+    The parsed RTL of each task is cached in the work directory together with
+    the hash of its tarball, and by the hash of the RTL itself. Tasks whose
+    tarballs are unchanged since the last run are neither extracted nor parsed
+    again, tasks whose RTL is unchanged are not parsed again, and generated
+    files are only rewritten if their content changes, so that iterating on
+    FIFO depths or floorplans only re-emits the affected modules.
+
+    Each async_mmap instance issues read bursts on 2 ** `async_mmap_id_width`
+    AXI IDs and keeps at most `async_mmap_max_outstanding` of them in flight.
+    If `async_mmap_write_combine_window` is set, writes to nearby addresses
+    that arrive within as many cycles are combined into one burst. If
+    `async_mmap_bus_width` is set, mmap ports accessed only as async_mmap are
+    widened to as many bits, with narrower elements packed as lanes.
+    """
     _logger.info('extracting RTL files')
+    try:
+      with open(self.clock_domains_json) as clock_domains_fp:
+        self._clk_2_tasks = set(json.load(clock_domains_fp))
+    except FileNotFoundError:
+      self._clk_2_tasks = set()
+    self._async_mmap_max_outstanding = async_mmap_max_outstanding
+    self._async_mmap_write_combine_window = async_mmap_write_combine_window
+    self._async_mmap_bus_width = async_mmap_bus_width
+    modules: Dict[str, rtl.Module] = {}
+    tar_hashes: Dict[str, str] = {}
     for task in self._tasks.values():
+      tar_hashes[task.name] = self._hash_tar(task.name)
+      module = self._get_cached_module(task.name, tar_hashes[task.name])
+      if module is not None:
+        _logger.debug('reusing parsed RTL of %s', task.name)
+        modules[task.name] = module
+        continue
       with tarfile.open(self.get_tar(task.name), 'r') as tarfileobj:
         tarfileobj.extractall(path=self.work_dir)
 
     # these files are needed before running RTL synthesis for resource report
     _logger.info('writing basic auxiliary RTL files')
     for name, content in rtl.OTHER_MODULES.items():
-      with open(self.get_rtl(name, prefix=False), 'w') as rtl_code:
-        rtl_code.write(content)
+      util.write_if_changed(self.get_rtl(name, prefix=False), content)
 
     for file_name in (
+        'ap_ctrl_cdc.v',
+        'ap_ctrl_chain.v',
+        'async_fifo.v',
         'async_mmap.v',
+        'atomic_async_mmap.v',
         'axi_pipeline.v',
+        'cached_async_mmap.v',
         'detect_burst.v',
         'fifo_fwd.v',
         'fifo.v',
         'generate_last.v',
+        'perf_counters.v',
+        'ping_pong_buffer.v',
         'relay_station.v',
+        'stream_distribute.v',
+        'stream_merge.v',
+        'upsized_async_mmap.v',
+        'write_combine.v',
     ):
-      shutil.copy(
-          os.path.join(os.path.dirname(util.__file__), 'assets', 'verilog',
-                       file_name), self.rtl_dir)
+      with open(os.path.join(os.path.dirname(util.__file__), 'assets',
+                             'verilog', file_name)) as asset_fp:
+        util.write_if_changed(os.path.join(self.rtl_dir, file_name),
+                              asset_fp.read())
 
     # extract and parse RTL and populate tasks
     _logger.info('parsing RTL files and populating tasks')
+    rtl_hashes: Dict[str, str] = {}
+    for task in self._tasks.values():
+      if task.name in modules:
+        continue
+      rtl_hashes[task.name] = self._get_rtl_hash(task)
+      module = self._get_module_by_content(rtl_hashes[task.name])
+      if module is not None:
+        _logger.debug('reusing parsed RTL of %s with unchanged content',
+                      task.name)
+        modules[task.name] = module
+        self._cache_module(task, tar_hashes[task.name],
+                           rtl_hashes[task.name], module)
+    tasks_to_parse = [x for x in self._tasks.values() if x.name not in modules]
     for task, module in zip(
-        self._tasks.values(),
+        tasks_to_parse,
         futures.ProcessPoolExecutor().map(
             rtl.Module,
-            ([self.get_rtl(x.name)] for x in self._tasks.values()),
-            (not x.is_upper for x in self._tasks.values()),
+            ([self.get_rtl(x.name)] for x in tasks_to_parse),
+            (not x.is_upper for x in tasks_to_parse),
         ),
     ):
       _logger.debug('parsing %s', task.name)
-      task.module = module
+      modules[task.name] = module
+      self._cache_module(task, tar_hashes[task.name], rtl_hashes[task.name],
+                         module)
+    for task in self._tasks.values():
+      task.module = modules[task.name]
+      task.async_mmap_id_width = async_mmap_id_width
       task.self_area = self.get_area(task.name)
       task.clock_period = self.get_clock_period(task.name)
       _logger.debug('populating %s', task.name)
       self._populate_task(task)
+    self._widen_async_mmap_ports()
+
+    if auto_fifo_depth:
+      self._infer_fifo_depths()
 
     # instrument the upper-level RTL except the top-level
     _logger.info('instrumenting upper-level RTL')
     for task in self._tasks.values():
       if task.is_upper and task.name != self.top:
-        self._instrument_task(task, part_num, additional_fifo_pipelining)
+        self._instrument_task(task, part_num, additional_fifo_pipelining,
+                              almost_full_fifo)
 
     return self
 
+  def generate_connectivity(
+      self,
+      part_num: str,
+      connectivity: Optional[TextIO],
+      compute_units: int = 1,
+      host_arg_names: Iterable[str] = (),
+      stream_connects: Iterable[str] = (),
+  ) -> str:
+    """Bind the mmaps missing from `connectivity` to memory channels.
+
+    If `compute_units` > 1, the top-level task is replicated as that many
+    compute units, whose mmaps are bound in turn. Mmaps in `host_arg_names`
+    are bound to host memory. Stream ports are connected to other kernels as
+    specified by `stream_connects`.
+
+    Returns the complete connectivity specification, which is also saved in
+    the work directory.
+    """
+    _logger.info('generating connectivity')
+    connectivity_ini = generate_connectivity(
+      part_num,
+      connectivity,
+      self.top_task,
+      compute_units,
+      host_arg_names,
+      stream_connects,
+    )
+    util.write_if_changed(f'{self.work_dir}/connectivity.ini',
+                          connectivity_ini)
+    return connectivity_ini
+
   def run_floorplanning(
       self,
       part_num,
       connectivity: TextIO,
       enable_synth_util: bool = False,
       floorplan_pre_assignments: TextIO = None,
+      timing_report: Optional[TextIO] = None,
+      warm_start: Optional[TextIO] = None,
+      max_fifo_slice_width: int = 0,
+      balance_fifo_memory: bool = False,
       **kwargs,
   ) -> 'Program':
+    """Floorplan the top-level task.
+
+    If `timing_report` of the previous implementation is given, its critical
+    paths are mapped back to the previous floorplan to tighten the failing
+    edges; see `refine_from_timing`.
+
+    If `warm_start` is given, the solver is seeded from that previous
+    `post-floorplan-config.json`, and only the vertices perturbed since then
+    are placed again.
+
+    If `max_fifo_slice_width` is positive, FIFOs wider than it are split into
+    slices that are floorplanned and pipelined independently, and moved in
+    lock step by `Module.add_fifo_instance`.
+
+    If `balance_fifo_memory` is set, the memory of each FIFO whose stream type
+    does not choose one is chosen jointly with the floorplan, so that no
+    region runs out of one memory while another is unused.
+    """
     _logger.info('Running floorplanning')
 
+    if is_versal(part_num):
+      raise InputError(
+          f'floorplanning is not supported on {part_num}; AutoBridge models '
+          'the SLRs of UltraScale+ devices only, so generate the RTL without '
+          '--constraint')
+
+    if timing_report is not None:
+      timing_refinement = refine_from_timing(self.work_dir, timing_report)
+    else:
+      timing_refinement = load_timing_refinement(self.work_dir)
+
+    previous_floorplan = None
+    if warm_start is not None:
+      previous_floorplan = json.load(warm_start)
+
+    available_area = None
+    if balance_fifo_memory:
+      available_area = make_autobridge_area(
+          get_hls_report_metrics(self._get_hls_report_xml(
+              self.top_task.name))['available'])
+
     # generate partitioning constraints if partitioning directive is given
     config, config_with_floorplan = generate_floorplan(
       part_num,
@@ -289,6 +1216,10 @@ class Program:
       self.get_task,
       self._get_fifo_width,
       self.get_cpp,
+      timing_refinement,
+      previous_floorplan,
+      max_fifo_slice_width,
+      available_area,
       **kwargs,
     )
 
@@ -298,6 +1229,198 @@ class Program:
 
     return self
 
+  def partition_devices(
+      self,
+      part_num: str,
+      connectivity: TextIO,
+      num_devices: int,
+      device_pre_assignments: Optional[TextIO] = None,
+      link_latency: int = 0,
+      max_usage: Optional[float] = None,
+  ) -> 'Program':
+    """Partition the task instances among `num_devices` devices.
+
+    The task graph of floorplanning is cut so that the FIFOs crossing devices
+    carry as few bits as possible and each device fits; see
+    `partition_devices`. The instances of each device and the crossing FIFOs,
+    whose depths cover the round trip of `link_latency` cycles, are written to
+    `device-partition.json` in the work directory.
+    """
+    _logger.info('Partitioning the task graph among %d devices', num_devices)
+    config = get_floorplan_config(
+        part_num,
+        connectivity,
+        self.top_task,
+        self._get_fifo_width,
+        None,
+    )
+    available_area = make_autobridge_area(
+        get_hls_report_metrics(self._get_hls_report_xml(
+            self.top_task.name))['available'])
+    partition = partition_devices(
+        config,
+        num_devices,
+        json.load(device_pre_assignments) if device_pre_assignments else None,
+        available_area,
+        DEFAULT_FIFO_MAX_USAGE if max_usage is None else max_usage,
+        link_latency,
+    )
+    for idx, device in enumerate(partition['devices']):
+      _logger.info('device %d: %s', idx, ', '.join(device['instances']))
+    with open(os.path.join(self.work_dir, 'device-partition.json'), 'w') as fp:
+      json.dump(partition, fp, indent=2)
+    return self
+
+  def _write_reconfigurable_partitions(
+      self,
+      instances: Iterable[str],
+      floorplan_region: Dict[str, str],
+  ) -> None:
+    """Record the boundary of each reconfigurable partition.
+
+    Every module loaded into a partition must have the same ports, which are
+    connected to static FIFOs and AXI pipelines; compare the record of each
+    variant against that of the static design.
+    """
+    by_name = {instance.name: instance for instance in self.top_task.instances}
+    partitions = []
+    for name in instances:
+      instance = by_name[name]
+      partitions.append({
+          'instance': name,
+          'task': instance.task.name,
+          'region': floorplan_region.get(name),
+          'ports': [{
+              'name': port.name,
+              'cat': port.cat.name.lower(),
+              'width': port.width,
+          } for port in instance.task.ports.values()],
+      })
+    with open(os.path.join(self.work_dir, 'reconfigurable-partitions.json'),
+              'w') as fp:
+      json.dump(partitions, fp, indent=2)
+
+  def explore_implementation(
+      self,
+      space: TextIO,
+      checkpoint: str,
+      constraint: Optional[str] = None,
+      jobs: Optional[int] = None,
+      mem_per_job: float = 32.,
+  ) -> 'Program':
+    """Implement variants of the design and choose the one with the best WNS.
+
+    Every combination of the constraint files and the placer and router
+    directives is placed and routed from `checkpoint` concurrently, e.g., the
+    ``before_add_floorplan_constraints.dcp`` written by the constraint file
+    in a previous ``v++`` run. Floorplan variants are constraint files
+    generated with different floorplanning options, e.g.,
+    ``--floorplan-strategy`` or ``--max-usage``. All results are saved in
+    ``implementation.json`` in the work directory, and the routed checkpoint
+    of the best variant can be passed to ``v++ --reuse_impl``.
+
+    Args:
+      space: JSON object with optional lists ``constraint``,
+          ``place_directive``, and ``route_directive``, e.g.,
+          ``{"route_directive": ["Explore", "AggressiveExplore"]}``.
+      checkpoint: Vivado checkpoint to implement.
+      constraint: Default constraint file, if ``constraint`` is not given.
+      jobs: Maximum number of concurrent Vivado jobs. Defaults to the number
+          of CPUs, further limited by the available memory.
+      mem_per_job: Memory in GiB reserved for each Vivado job, used to limit
+          the number of concurrent jobs if `jobs` is not set.
+    """
+    space = json.load(space)
+    constraints = space.get('constraint', [constraint] if constraint else [])
+    if not constraints:
+      raise InputError('no constraint file to explore implementation with')
+    place_directives = space.get('place_directive',
+                                 ['EarlyBlockPlacement', 'ExtraNetDelay_high'])
+    route_directives = space.get('route_directive',
+                                 ['Explore', 'AggressiveExplore'])
+    variants = list(
+        itertools.product(constraints, place_directives, route_directives))
+    if jobs is None:
+      jobs = util.get_max_jobs(mem_per_job)
+    _logger.info('implementing %d variants with up to %d concurrent jobs',
+                 len(variants), jobs)
+
+    checkpoint = os.path.abspath(checkpoint)
+    def worker(variant: Tuple[str, str, str],
+               idx: int) -> Optional[Dict[str, Any]]:
+      constraint, place_directive, route_directive = variant
+      constraint = os.path.abspath(constraint)
+      with open(constraint, 'rb') as constraint_fp:
+        variant_hash = hashlib.sha256(b'\0'.join((
+            checkpoint.encode(),
+            str(os.path.getmtime(checkpoint)).encode(),
+            constraint_fp.read(),
+            place_directive.encode(),
+            route_directive.encode(),
+        ))).hexdigest()
+      variant_dir = os.path.join(self.work_dir, 'implementation', variant_hash)
+      os.makedirs(variant_dir, exist_ok=True)
+      result_txt = os.path.join(variant_dir, 'result.txt')
+
+      # Reuse the result if the variant was implemented before.
+      if not os.path.isfile(result_txt):
+        with open(os.path.join(variant_dir, 'impl.tcl'), 'w') as tcl_fp:
+          tcl_fp.write(f"""\
+open_checkpoint {{{checkpoint}}}
+source {{{constraint}}}
+opt_design -directive Explore
+place_design -directive {place_directive}
+phys_opt_design -directive AggressiveExplore
+route_design -directive {route_directive}
+write_checkpoint -force route.dcp
+set path [get_timing_paths -setup -max_paths 1]
+set fp [open result.txt w]
+puts $fp "[get_property SLACK $path] [get_property REQUIREMENT $path]"
+close $fp
+""")
+        os.nice(idx % 19)
+        proc = subprocess.run(
+            ['vivado', '-mode', 'batch', '-source', 'impl.tcl', '-nojournal'],
+            cwd=variant_dir,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT,
+        )
+        if proc.returncode != 0 or not os.path.isfile(result_txt):
+          _logger.warning('implementation failed for %s with %s and %s',
+                          constraint, place_directive, route_directive)
+          _logger.debug('%s', proc.stdout.decode('utf-8'))
+          return None
+      with open(result_txt) as result_fp:
+        wns, requirement = map(float, result_fp.read().split())
+      return {
+          'constraint': constraint,
+          'place_directive': place_directive,
+          'route_directive': route_directive,
+          'wns': wns,
+          'fmax': 1000 / (requirement - min(wns, 0.)),
+          'checkpoint': os.path.join(variant_dir, 'route.dcp'),
+      }
+
+    with futures.ThreadPoolExecutor(max_workers=jobs) as executor:
+      results = [
+          x for x in executor.map(worker, variants, itertools.count(0))
+          if x is not None
+      ]
+    if not results:
+      raise InputError('all implementation variants failed')
+
+    best = max(results, key=lambda x: x['wns'])
+    _logger.info(
+        'best implementation uses %s with %s and %s: WNS %.3f ns, '
+        'Fmax %.1f MHz', best['constraint'], best['place_directive'],
+        best['route_directive'], best['wns'], best['fmax'])
+    _logger.info('run v++ --link --reuse_impl %s to generate the xclbin',
+                 best['checkpoint'])
+    with open(os.path.join(self.work_dir, 'implementation.json'),
+              'w') as result_fp:
+      json.dump({'best': best, 'results': results}, result_fp, indent=2)
+    return self
+
   def generate_top_rtl(
       self,
       constraint: TextIO,
@@ -306,6 +1429,10 @@ class Program:
       part_num: str,
       reuse_hbm_path_pipelining: bool,
       manual_vivado_flow: bool,
+      almost_full_fifo: bool = False,
+      async_mmap_bus_width: int = 0,
+      perf_counters: bool = False,
+      reconfigurable_instances: Iterable[str] = (),
   ) -> 'Program':
     """Instrument HDL files generated from HLS.
 
@@ -314,15 +1441,29 @@ class Program:
         register_level: Non-zero value overrides self.register_level.
         part_num: optinally provide the part_num to enable board-specific optimization
         additional_fifo_pipelining: replace every FIFO by a relay_station of LEVEL 2
+        almost_full_fifo: replace every FIFO by a relay_station of at least
+            LEVEL 1, whose full_n is registered
+        async_mmap_bus_width: same as in generate_task_rtl
+        perf_counters: count the stalls of the top-level FIFOs, the
+            iterations and stalls of the loops counted by tapacc
+            -loop-counters in the top-level instances, and the beats and
+            outstanding requests of the AXI interfaces, readable through
+            the control interface; see perf_counters.json in the work dir
         (in-test) manual_vivado_flow: run two-pass of phys_opt_design after placement
+        reconfigurable_instances: top-level instances that become DFX
+            reconfigurable partitions in the constraints, each taking its
+            floorplan region; their boundaries are recorded in
+            reconfigurable-partitions.json in the work dir
 
     Returns:
         Program: Return self.
     """
     # extract the floorplan result
     if constraint:
-      fifo_pipeline_level, axi_pipeline_level = get_floorplan_result(
-        self.work_dir, constraint, reuse_hbm_path_pipelining, manual_vivado_flow
+      (fifo_pipeline_level, axi_pipeline_level, floorplan_region,
+       fifo_slice_count, fifo_impl) = get_floorplan_result(
+        self.work_dir, constraint, reuse_hbm_path_pipelining,
+        manual_vivado_flow, reconfigurable_instances,
       )
 
       if not fifo_pipeline_level:
@@ -330,17 +1471,37 @@ class Program:
 
       self.top_task.module.fifo_partition_count = fifo_pipeline_level
       self.top_task.module.axi_pipeline_level = axi_pipeline_level
+      self.top_task.module.floorplan_region = floorplan_region
+      self.top_task.module.fifo_slice_count = fifo_slice_count
+      self.top_task.module.fifo_impl = fifo_impl
+
+      if reconfigurable_instances:
+        self._write_reconfigurable_partitions(reconfigurable_instances,
+                                              floorplan_region)
 
     self.top_task.module.register_level = 3
     if register_level:
       assert register_level > 0
       self.top_task.module.register_level = register_level
+    extra_register_level = load_timing_refinement(
+        self.work_dir)['extra_register_level']
+    if extra_register_level:
+      _logger.info('adding %d register levels that failed timing before',
+                   extra_register_level)
+      self.top_task.module.register_level += extra_register_level
     _logger.info('top task register level set to %d',
                 self.top_task.module.register_level)
 
+    if async_mmap_bus_width:
+      self._async_mmap_bus_width = async_mmap_bus_width
+      self._widen_async_mmap_ports()
+
+    self._perf_fifos = self._get_perf_fifos() if perf_counters else None
+
     # instrument the top-level RTL
     _logger.info('instrumenting top-level RTL')
-    self._instrument_task(self.top_task, part_num, additional_fifo_pipelining)
+    self._instrument_task(self.top_task, part_num, additional_fifo_pipelining,
+                          almost_full_fifo)
 
     _logger.info('generating report')
     task_report = self.top_task.report
@@ -352,8 +1513,7 @@ class Program:
     # self.files won't be populated until all tasks are instrumented
     _logger.info('writing generated auxiliary RTL files')
     for name, content in self.files.items():
-      with open(os.path.join(self.rtl_dir, name), 'w') as fp:
-        fp.write(content)
+      util.write_if_changed(os.path.join(self.rtl_dir, name), content)
 
     return self
 
@@ -365,6 +1525,193 @@ class Program:
              output_file=output_file)
     return self
 
+  def generate_verilator_sim(
+      self,
+      output_file: str,
+      threads: int = 1,
+      jobs: Optional[int] = None,
+  ) -> 'Program':
+    """Compile the generated RTL with Verilator into an RTL simulator.
+
+    The simulator drives the top-level RTL via its control interface and
+    backs each mmap with a memory model, so that `tapa::invoke` runs the
+    simulator instead of a bitstream if given `output_file`, which must end
+    with ``.verilator``. Host streams are not supported.
+
+    Args:
+      output_file: Path of the simulator executable.
+      threads: Number of threads of the simulation.
+      jobs: Number of concurrent compilation jobs. Defaults to the number of
+          CPUs.
+    """
+    if not output_file.endswith('.verilator'):
+      raise InputError(f'{output_file} must end with .verilator')
+    _logger.info('generating RTL simulator with Verilator')
+
+    with open(os.path.join(self.rtl_dir,
+                           f'{self.top}_control_s_axi.v')) as s_axi_fp:
+      registers = get_control_registers(s_axi_fp.read())
+    with open(self.get_rtl(self.top)) as top_fp:
+      top_rtl = top_fp.read()
+
+    sim_dir = os.path.join(self.work_dir, 'verilator')
+    os.makedirs(sim_dir, exist_ok=True)
+    with open(os.path.join(os.path.dirname(util.__file__), 'assets',
+                           'verilator', 'tapa_verilator.h')) as asset_fp:
+      util.write_if_changed(os.path.join(sim_dir, 'tapa_verilator.h'),
+                            asset_fp.read())
+
+    lines = [
+        f'#include "V{self.top}.h"',
+        '#include "tapa_verilator.h"',
+        '',
+        'int main(int argc, char** argv) {',
+        f'  tapa::verilator::kernel<V{self.top}> kernel(argc, argv);',
+        '  auto& top = kernel.top();',
+    ]
+    if re.search(rf'\b{rtl.HANDSHAKE_CLK_2}\b', top_rtl):
+      # the second clock domain is simulated at the same frequency
+      lines.append(f'  kernel.set_clock_hook([](V{self.top}& top, bool clk) {{')
+      lines.append(f'    top.{rtl.HANDSHAKE_CLK_2} = clk;')
+      lines.append(f'    top.{rtl.HANDSHAKE_RST_N_2} = '
+                   f'top.{rtl.HANDSHAKE_RST_N};')
+      lines.append('  });')
+    for idx, port in enumerate(self.toplevel_ports):
+      words = ', '.join(
+          f'{{0x{offset:x}, {lsb}}}' for offset, lsb in registers[port.name])
+      if port.cat in {Instance.Arg.Cat.MMAP, Instance.Arg.Cat.ASYNC_MMAP}:
+        width_bytes = max(port.width // 8, 1)
+        lines.append(f'  TAPA_M_AXI(top, {port.name}) {port.name}(')
+        lines.append(f'      TAPA_M_AXI_PORTS(top, {port.name}), '
+                     f'{width_bytes});')
+        lines.append(f'  kernel.add_mmap({idx}, &{port.name}, {{{words}}});')
+      elif port.cat == Instance.Arg.Cat.SCALAR:
+        lines.append(f'  kernel.add_scalar({idx}, {{{words}}});')
+      else:
+        raise InputError(f'host stream {port.name} is not supported in RTL '
+                         'simulation')
+    lines.append('  return kernel.run();')
+    lines.append('}')
+    main_cpp = os.path.join(sim_dir, 'main.cpp')
+    util.write_if_changed(main_cpp, '\n'.join(lines) + '\n')
+
+    # HLS RTL may load memory initialization files from the working
+    # directory, so the simulator is built and run with the RTL files.
+    rtl_files = sorted(
+        os.path.join(self.rtl_dir, x)
+        for x in os.listdir(self.rtl_dir)
+        if x.endswith(('.v', '.sv')))
+    if any(x.endswith('.tcl') for x in os.listdir(self.rtl_dir)):
+      _logger.warning('Xilinx IP cores are not simulated by Verilator')
+    cmd = [
+        'verilator',
+        '--cc',
+        '--exe',
+        '--build',
+        '-j',
+        str(jobs or os.cpu_count() or 1),
+        '--threads',
+        str(threads),
+        '--top-module',
+        self.top,
+        '--Mdir',
+        sim_dir,
+        '-o',
+        os.path.abspath(output_file),
+        '-O3',
+        '--x-assign',
+        'fast',
+        '--x-initial',
+        'fast',
+        '-Wno-fatal',
+        '-Wno-lint',
+        '-Wno-style',
+        '-CFLAGS',
+        '-std=c++17 -O2',
+        *rtl_files,
+        main_cpp,
+    ]
+    _logger.debug('running %s', ' '.join(cmd))
+    proc = subprocess.run(cmd,
+                          cwd=self.rtl_dir,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT)
+    if proc.returncode != 0:
+      sys.stderr.write(proc.stdout.decode('utf-8'))
+      raise InputError('failed to build the RTL simulator')
+    _logger.info('run the host program with %s as the bitstream', output_file)
+    return self
+
+  def _infer_fifo_depths(self) -> None:
+    """Infer the depths of FIFOs declared without one.
+
+    Tokens sent along the shorter of two reconvergent paths wait in the FIFO
+    until the consumer has received inputs from the longer path. So each FIFO
+    is made deep enough to hold the tokens produced during the difference in
+    latency, plus those transferred in one pipeline iteration. Depths never
+    drop below the default.
+    """
+    if self._are_fifo_depths_inferred:
+      return
+    self._are_fifo_depths_inferred = True
+
+    _logger.info('inferring FIFO depths')
+    for task in self._tasks.values():
+      # instance -> instances producing its inputs
+      producers: Dict[Tuple[str, int], Set[Tuple[str, int]]] = {}
+      for fifo in task.fifos.values():
+        if 'produced_by' in fifo and 'consumed_by' in fifo:
+          producers.setdefault(tuple(fifo['consumed_by']), set()).add(
+              tuple(fifo['produced_by']))
+      if not any(x.get('auto_depth') for x in task.fifos.values()):
+        continue
+      try:
+        instances = toposort.toposort_flatten(producers)
+      except toposort.CircularDependencyError:
+        _logger.warning(
+            'not inferring FIFO depths in task %s because it has cycles',
+            task.name,
+        )
+        continue
+
+      # cycle at which each instance starts to receive all of its inputs
+      arrival: Dict[Tuple[str, int], int] = {}
+      for instance in instances:
+        arrival[instance] = max(
+            (arrival[x] + self.get_latency(x[0])
+             for x in producers.get(instance, ())),
+            default=0,
+        )
+
+      for fifo_name, fifo in task.fifos.items():
+        if (not fifo.get('auto_depth') or 'produced_by' not in fifo or
+            'consumed_by' not in fifo):
+          continue
+        producer = tuple(fifo['produced_by'])
+        slack = (arrival[tuple(fifo['consumed_by'])] - arrival[producer] -
+                 self.get_latency(producer[0]))
+
+        # tokens per cycle and per iteration as estimated by tapacc
+        rate, burst = fractions.Fraction(1), 1
+        for port in (fifo.get('producer_rate'), fifo.get('consumer_rate')):
+          if port and port['tokens_per_iteration']:
+            burst = max(burst, port['tokens_per_iteration'])
+        producer_rate = fifo.get('producer_rate')
+        if (producer_rate and producer_rate['tokens_per_iteration'] and
+            producer_rate['ii']):
+          rate = fractions.Fraction(producer_rate['tokens_per_iteration'],
+                                    producer_rate['ii'])
+
+        depth = max(fifo['depth'], math.ceil(max(slack, 0) * rate) + burst)
+        if depth != fifo['depth']:
+          _logger.info(
+              'depth of fifo %s in task %s inferred as %d',
+              fifo_name,
+              task.name,
+              depth,
+          )
+          fifo['depth'] = depth
+
   def _populate_task(self, task: Task) -> None:
     task.instances = tuple(
         Instance(self.get_task(name), verilog=rtl, instance_id=idx, **obj)
@@ -373,7 +1720,13 @@ class Program:
 
   def _connect_fifos(self, task: Task) -> None:
     _logger.debug("  connecting %s's children tasks", task.name)
+    # {(kind, stream): FIFOs} of broadcast, merge, and distribute streams
+    groups: Dict[Tuple[str, str], List[str]] = collections.OrderedDict()
     for fifo_name in task.fifos:
+      for kind in ('broadcast', 'merge', 'distribute'):
+        if kind in task.fifos[fifo_name]:
+          groups.setdefault((kind, task.fifos[fifo_name][kind]),
+                            []).append(fifo_name)
       for direction in task.get_fifo_directions(fifo_name):
         task_name, _, fifo_port = task.get_connection_to(fifo_name, direction)
 
@@ -388,7 +1741,128 @@ class Program:
       if task.is_fifo_external(fifo_name):
         task.connect_fifo_externally(fifo_name, task.name == self.top)
 
-  def _instantiate_fifos(self, task: Task, additional_fifo_pipelining: bool) -> None:
+    for (kind, stream), fifo_names in groups.items():
+      if kind == 'broadcast':
+        self._connect_broadcast(task, stream, fifo_names)
+      else:
+        self._connect_arbiter(task, kind, stream, fifo_names)
+
+  def _connect_broadcast(
+      self,
+      task: Task,
+      broadcast: str,
+      fifo_names: List[str],
+  ) -> None:
+    """Connect the producer of a broadcast stream to its FIFOs, which are
+    written in lock step: a token is written to all FIFOs at once, when none
+    of them is full."""
+    _logger.debug('  broadcasting %s to %s', broadcast, ', '.join(fifo_names))
+    task_name, _, fifo_port = task.get_connection_to(fifo_names[0],
+                                                     'produced_by')
+    producer = self.get_task(task_name).module
+    din, full_n, write = (rtl.wire_name(broadcast, suffix)
+                          for suffix in rtl.OSTREAM_SUFFIXES)
+    task.module.add_signals(
+        ast.Wire(name=rtl.wire_name(broadcast, suffix),
+                 width=producer.get_port_of(fifo_port, suffix).width)
+        for suffix in rtl.OSTREAM_SUFFIXES)
+    logics = [
+        ast.Assign(
+            left=ast.Identifier(full_n),
+            right=ast.make_operation(
+                operator=ast.Land,
+                nodes=(ast.Identifier(rtl.wire_name(x, rtl.OSTREAM_SUFFIXES[1]))
+                       for x in fifo_names),
+            ),
+        ),
+    ]
+    for fifo_name in fifo_names:
+      for suffix, wire in ((rtl.OSTREAM_SUFFIXES[0], din),
+                           (rtl.OSTREAM_SUFFIXES[2], write)):
+        logics.append(
+            ast.Assign(
+                left=ast.Identifier(rtl.wire_name(fifo_name, suffix)),
+                right=ast.Identifier(wire),
+            ))
+    task.module.add_logics(logics)
+
+  def _connect_arbiter(
+      self,
+      task: Task,
+      kind: str,
+      stream: str,
+      fifo_names: List[str],
+  ) -> None:
+    """Connect the consumer of a merge stream, or the producer of a distribute
+    stream, to the FIFOs of the stream via a `stream_merge` or
+    `stream_distribute` module, which takes turns among the FIFOs."""
+    _logger.debug('  %s %s via %s', 'merging' if kind == 'merge' else
+                  'distributing', stream, ', '.join(fifo_names))
+    direction = 'consumed_by' if kind == 'merge' else 'produced_by'
+    suffixes = task.get_fifo_suffixes(direction)
+    task_name, _, fifo_port = task.get_connection_to(fifo_names[0], direction)
+    child = self.get_task(task_name).module
+    task.module.add_signals(
+        ast.Wire(name=rtl.wire_name(stream, suffix),
+                 width=child.get_port_of(fifo_port, suffix).width)
+        for suffix in suffixes)
+
+    def concat(suffix: str) -> ast.Identifier:
+      """Concatenate a signal of all FIFOs, the first FIFO as the LSB."""
+      return ast.Identifier('{' + ', '.join(
+          rtl.wire_name(x, suffix) for x in reversed(fifo_names)) + '}')
+
+    def stream_arg(suffix: str) -> ast.Identifier:
+      return ast.Identifier(rtl.wire_name(stream, suffix))
+
+    is_clk_2 = task_name in self._clk_2_tasks
+    ports = [
+        ast.make_port_arg(port='clk', arg=rtl.CLK_2 if is_clk_2 else rtl.CLK),
+        ast.make_port_arg(port='reset',
+                          arg=ast.Unot(rtl.RST_N_2) if is_clk_2 else rtl.RST),
+    ]
+    if kind == 'merge':
+      ports += [
+          ast.make_port_arg(port='if_dout_in', arg=concat('_dout')),
+          ast.make_port_arg(port='if_empty_n_in', arg=concat('_empty_n')),
+          ast.make_port_arg(port='if_read_in', arg=concat('_read')),
+      ]
+    else:
+      ports += [
+          ast.make_port_arg(port='if_full_n_out', arg=concat('_full_n')),
+          ast.make_port_arg(port='if_write_out', arg=concat('_write')),
+      ]
+      # the data of the tokens goes to all FIFOs
+      task.module.add_logics(
+          ast.Assign(left=ast.Identifier(rtl.wire_name(x, suffixes[0])),
+                     right=stream_arg(suffixes[0])) for x in fifo_names)
+    ports += [
+        ast.make_port_arg(port='if' + suffix, arg=stream_arg(suffix))
+        for suffix in suffixes
+    ]
+    task.module.add_instance(
+        module_name=f'stream_{kind}',
+        instance_name=f'{rtl.sanitize_array_name(stream)}__{kind}',
+        ports=ports,
+        params=(
+            ast.ParamArg(
+                paramname='DATA_WIDTH',
+                argname=ast.Constant(self._get_fifo_width(task,
+                                                          fifo_names[0])),
+            ),
+            ast.ParamArg(
+                paramname='FANIN' if kind == 'merge' else 'FANOUT',
+                argname=ast.Constant(len(fifo_names)),
+            ),
+        ),
+    )
+
+  def _instantiate_fifos(
+      self,
+      task: Task,
+      additional_fifo_pipelining: bool,
+      almost_full_fifo: bool = False,
+  ) -> None:
     _logger.debug('  instantiating FIFOs in %s', task.name)
 
     # skip instantiating if the fifo is not declared in this task
@@ -404,12 +1878,24 @@ class Program:
     for fifo_name, fifo in fifos.items():
       _logger.debug('    instantiating %s.%s', task.name, fifo_name)
 
+      # the EoT bit is not stored if neither end may read or write EoT
+      eot = any((fifo.get(x) or {}).get('eot', True)
+                for x in ('producer_rate', 'consumer_rate'))
+      if not eot:
+        _logger.debug('    dropping the EoT bit of %s.%s', task.name,
+                      fifo_name)
+
       # add FIFO instances
       task.module.add_fifo_instance(
           name=fifo_name,
           width=self._get_fifo_width(task, fifo_name),
           depth=fifo['depth'],
           additional_fifo_pipelining=additional_fifo_pipelining,
+          write_clk_2=fifo['produced_by'][0] in self._clk_2_tasks,
+          read_clk_2=fifo['consumed_by'][0] in self._clk_2_tasks,
+          impl=fifo.get('impl', 'auto'),
+          almost_full=almost_full_fifo,
+          eot=eot,
       )
 
       # print debugging info
@@ -453,34 +1939,58 @@ class Program:
       task: Task,
       width_table: Dict[str, int],
       part_num: str,
-  ) -> List[ast.Identifier]:
+      chain: bool = False,
+  ) -> Tuple[List[rtl.Pipeline], List[rtl.Pipeline]]:
     is_done_signals: List[rtl.Pipeline] = []
-    arg_table: Dict[str, rtl.Pipeline] = {}
+    is_busy_signals: List[rtl.Pipeline] = []
+    arg_table: Dict[str, ast.Identifier] = {}
     async_mmap_args: Dict[Instance.Arg, List[str]] = collections.OrderedDict()
+    # {buffer: {cat: (instance, arg)}} of the endpoints of each tapa::buffer
+    buffer_args: Dict[str, Dict[Instance.Arg.Cat, Tuple[Instance,
+                                                        Instance.Arg]]] = {}
 
     task.add_m_axi(width_table, self.files)
 
     for instance in task.instances:
       child_port_set = set(instance.task.module.ports)
+      is_clk_2 = instance.task.name in self._clk_2_tasks
 
       # add signal delcarations
       for arg in instance.args:
         if arg.cat not in {
             Instance.Arg.Cat.ISTREAM,
             Instance.Arg.Cat.OSTREAM,
+            Instance.Arg.Cat.IBUFFER,
+            Instance.Arg.Cat.OBUFFER,
         }:
           width = 64  # 64-bit address
           if arg.cat == Instance.Arg.Cat.SCALAR:
             width = width_table.get(arg.name, 0)
             if width == 0:
               width = int(arg.name.split("'d")[0])
-          q = rtl.Pipeline(
-              name=instance.get_instance_arg(arg.name),
-              level=self.register_level,
-              width=width,
-          )
-          arg_table[arg.name] = q
-          task.module.add_pipeline(q, init=ast.Identifier(arg.name))
+          if "'d" in arg.name:
+            # constants need no registers
+            arg_table[arg.name] = ast.Identifier(arg.name)
+          else:
+            arg_table[arg.name] = task.module.add_broadcast(
+                name=f'{arg.name}__tree',
+                init=ast.Identifier(arg.name),
+                sink=instance.get_instance_arg(arg.name),
+                instance_name=instance.name,
+                width=width,
+            )
+
+        # AXI interfaces of the kernel must be on ap_clk, and streams crossing
+        # clock domains are only supported for FIFOs instantiated here
+        if is_clk_2 and (
+            arg.cat in {Instance.Arg.Cat.MMAP, Instance.Arg.Cat.ASYNC_MMAP} or
+            arg.cat in {Instance.Arg.Cat.IBUFFER, Instance.Arg.Cat.OBUFFER} or
+            arg.cat in {Instance.Arg.Cat.ISTREAM, Instance.Arg.Cat.OSTREAM} and
+            task.is_fifo_external(arg.name)):
+          raise ValueError(
+              f'task {instance.task.name} cannot run on {rtl.HANDSHAKE_CLK_2} '
+              f'because its port {arg.port} is connected to {arg.name} of '
+              f'{task.name}')
 
         # arg.name is the upper-level name
         # arg.port is the lower-level name
@@ -503,26 +2013,29 @@ class Program:
                 rtl.generate_async_mmap_signals(
                     tag=tag,
                     arg=arg.mmap_name,
-                    data_width=width_table[arg.name],
+                    data_width=self._get_mmap_elem_width(
+                        task, arg.name, width_table),
                 ))
           else:
             task.module.add_ports(
                 rtl.generate_async_mmap_ioports(
                     tag=tag,
                     arg=arg.name,
-                    data_width=width_table[arg.name],
+                    data_width=self._get_mmap_elem_width(
+                        task, arg.name, width_table),
                 ))
 
       # add reset registers
-      rst_q = rtl.Pipeline(instance.rst_n, level=self.register_level)
-      task.module.add_pipeline(rst_q, init=rtl.RST_N)
-
-      # add start registers
-      start_q = rtl.Pipeline(
-          f'{instance.start.name}_global',
-          level=self.register_level,
+      rst_n = task.module.add_rst_n(instance.name)
+
+      # add start registers; with ap_ctrl_chain, children start once the
+      # invocation is accepted
+      start_global = task.module.add_broadcast(
+          name=f'{rtl.HANDSHAKE_START}_tree',
+          init=rtl.READY if chain else self.start_q[0],
+          sink=f'{instance.start.name}_global',
+          instance_name=instance.name,
       )
-      task.module.add_pipeline(start_q, self.start_q[0])
 
       if instance.is_autorun:
         # autorun modules start when the global start signal is asserted
@@ -531,13 +2044,13 @@ class Program:
                 sens_list=rtl.CLK_SENS_LIST,
                 statement=ast.make_block(
                     ast.make_if_with_block(
-                        cond=ast.Unot(rst_q[-1]),
+                        cond=ast.Unot(rst_n),
                         true=ast.NonblockingSubstitution(
                             left=instance.start,
                             right=rtl.FALSE,
                         ),
                         false=ast.make_if_with_block(
-                            cond=start_q[-1],
+                            cond=start_global,
                             true=ast.NonblockingSubstitution(
                                 left=instance.start,
                                 right=rtl.TRUE,
@@ -552,19 +2065,71 @@ class Program:
             f'{instance.is_done.name}',
             level=self.register_level,
         )
-        done_q = rtl.Pipeline(
-            f'{instance.done.name}_global',
-            level=self.register_level,
-        )
         task.module.add_pipeline(is_done_q, instance.is_state(STATE10))
-        task.module.add_pipeline(done_q, self.done_q[0])
+
+        if chain:
+          # remember the accepted invocation until the child can start it, and
+          # leave STATE10 right away so that is_done_q pulses once per
+          # invocation
+          pending = ast.Identifier(f'{instance.name}__pending')
+          is_busy_q = rtl.Pipeline(
+              f'{instance.name}__is_busy',
+              level=self.register_level,
+          )
+          task.module.add_signals([ast.Reg(pending.name, width=None)])
+          task.module.add_pipeline(
+              is_busy_q,
+              ast.Lor(pending, instance.is_state(STATE01)),
+          )
+          task.module.add_logics([
+              ast.Always(
+                  sens_list=rtl.CLK_SENS_LIST,
+                  statement=ast.make_block(
+                      ast.make_if_with_block(
+                          cond=ast.Unot(rst_n),
+                          true=ast.NonblockingSubstitution(
+                              left=pending,
+                              right=rtl.FALSE,
+                          ),
+                          false=ast.make_if_with_block(
+                              cond=start_global,
+                              true=ast.NonblockingSubstitution(
+                                  left=pending,
+                                  right=rtl.TRUE,
+                              ),
+                              false=ast.make_if_with_block(
+                                  cond=instance.is_state(STATE00),
+                                  true=ast.NonblockingSubstitution(
+                                      left=pending,
+                                      right=rtl.FALSE,
+                                  ),
+                              ),
+                          ),
+                      )),
+              ),
+          ])
+          start_cond: ast.Node = pending
+          state10_action = instance.set_state(STATE00)
+          is_busy_signals.append(is_busy_q)
+        else:
+          done_global = task.module.add_broadcast(
+              name=f'{rtl.HANDSHAKE_DONE}_tree',
+              init=self.done_q[0],
+              sink=f'{instance.done.name}_global',
+              instance_name=instance.name,
+          )
+          start_cond = start_global
+          state10_action = ast.make_if_with_block(
+              cond=done_global,
+              true=instance.set_state(STATE00),
+          )
 
         if_branch = (instance.set_state(STATE00))
         else_branch = ((
             ast.make_if_with_block(
                 cond=instance.is_state(STATE00),
                 true=ast.make_if_with_block(
-                    cond=start_q[-1],
+                    cond=start_cond,
                     true=instance.set_state(STATE01),
                 ),
             ),
@@ -587,10 +2152,7 @@ class Program:
             ),
             ast.make_if_with_block(
                 cond=instance.is_state(STATE10),
-                true=ast.make_if_with_block(
-                    cond=done_q[-1],
-                    true=instance.set_state(STATE00),
-                ),
+                true=state10_action,
             ),
         ))
         task.module.add_logics([
@@ -598,7 +2160,7 @@ class Program:
                 sens_list=rtl.CLK_SENS_LIST,
                 statement=ast.make_block(
                     ast.make_if_with_block(
-                        cond=ast.Unot(rst_q[-1]),
+                        cond=ast.Unot(rst_n),
                         true=if_branch,
                         false=else_branch,
                     )),
@@ -614,12 +2176,21 @@ class Program:
       # insert handshake signals
       task.module.add_signals(instance.handshake_signals)
 
-      # add task module instances
-      portargs = list(rtl.generate_handshake_ports(instance, rst_q))
+      # add task module instances; scalar arguments of instances on ap_clk_2
+      # are not synchronized because they are stable while the instance runs
+      if is_clk_2:
+        task.module.add_ap_ctrl_cdc_instance(instance.name, rst_n,
+                                             instance.is_autorun)
+      portargs = list(rtl.generate_handshake_ports(instance, rst_n, is_clk_2))
+      if rtl.HANDSHAKE_CLK_2 in child_port_set:
+        portargs.append(
+            ast.make_port_arg(port=rtl.HANDSHAKE_CLK_2, arg=rtl.CLK_2))
+        portargs.append(
+            ast.make_port_arg(port=rtl.HANDSHAKE_RST_N_2, arg=rtl.RST_N_2))
       for arg in instance.args:
         if arg.cat == Instance.Arg.Cat.SCALAR:
           portargs.append(
-              ast.PortArg(portname=arg.port, argname=arg_table[arg.name][-1]))
+              ast.PortArg(portname=arg.port, argname=arg_table[arg.name]))
         elif arg.cat == Instance.Arg.Cat.ISTREAM:
           portargs.extend(
               instance.task.module.generate_istream_ports(
@@ -638,7 +2209,7 @@ class Program:
                   module=instance.task.module,
                   port=arg.port,
                   arg=arg.mmap_name,
-                  arg_reg=arg_table[arg.name][-1].name,
+                  arg_reg=arg_table[arg.name].name,
               ))
         elif arg.cat == Instance.Arg.Cat.ASYNC_MMAP:
           for tag in async_mmap_args[arg]:
@@ -649,6 +2220,19 @@ class Program:
                     arg=arg.mmap_name,
                     instance=instance,
                 ))
+        elif arg.cat in {Instance.Arg.Cat.IBUFFER, Instance.Arg.Cat.OBUFFER}:
+          buffer_args.setdefault(arg.name, {})[arg.cat] = instance, arg
+          portargs.extend(self._generate_buffer_ports(instance, arg))
+
+      # events of the counted loops; see _add_perf_loop_probes
+      if task.name == self.top and self._perf_fifos is not None:
+        for _, loop in filter(lambda x: x[0] == instance.name,
+                              self._perf_loops):
+          for suffix in ('_iter_ap_vld', '_active', '_active_ap_vld'):
+            wire = f'{instance.name}_{loop}{suffix}'
+            task.module.add_signals([ast.Wire(name=wire, width=None)])
+            portargs.append(
+                ast.make_port_arg(port=f'{loop}{suffix}', arg=wire))
 
       task.module.add_instance(
           module_name=util.get_module_name(instance.task.name),
@@ -662,21 +2246,216 @@ class Program:
 
     if task.is_upper:
       for arg in async_mmap_args:
+        cache_lines, cache_ways = arg.cache or (0, 1)
+        max_burst_len, max_wait_time = None, 3
+        if arg.burst is not None:
+          max_burst_len, max_wait_time = arg.burst[0] - 1, arg.burst[1]
         task.module.add_async_mmap_instance(
             name=arg.mmap_name,
-            offset_name=arg_table[arg.name][-1],
+            offset_name=arg_table[arg.name],
             tags=async_mmap_args[arg],
-            data_width=width_table[arg.name],
+            data_width=self._get_mmap_elem_width(task, arg.name, width_table),
             addr_width=addr_width,
+            max_wait_time=max_wait_time,
+            max_burst_len=max_burst_len,
+            id_width=task.get_slave_id_width(arg) or 1,
+            max_outstanding=self._async_mmap_max_outstanding,
+            cache_lines=cache_lines,
+            cache_ways=cache_ways,
+            atomic=arg.atomic,
+            write_combine_window=self._async_mmap_write_combine_window,
+            bus_width=width_table[arg.name],
         )
 
-    return is_done_signals
+    for name, ends in buffer_args.items():
+      self._instantiate_buffer(task, name, ends)
+
+    return is_done_signals, is_busy_signals
+
+  _BUFFER_SIDES = {
+      Instance.Arg.Cat.OBUFFER: 'producer',
+      Instance.Arg.Cat.IBUFFER: 'consumer',
+  }
+
+  def _generate_buffer_ports(
+      self,
+      instance: Instance,
+      arg: Instance.Arg,
+  ) -> Iterator[ast.PortArg]:
+    """Connect the request and response FIFOs of a tapa::ibuffer or
+    tapa::obuffer to the wires of its side of the `ping_pong_buffer`."""
+    module = instance.task.module
+    side = self._BUFFER_SIDES[arg.cat]
+    for tag, suffixes in (('request', rtl.OSTREAM_SUFFIXES),
+                          ('response', rtl.ISTREAM_SUFFIXES)):
+      for suffix in suffixes:
+        wire = rtl.wire_name(f'{arg.name}__{side}_{tag}', suffix)
+        port = module.find_port(f'{arg.port}_{tag}', suffix)
+        if port is None:
+          raise ValueError(f'{instance.name} has no port {arg.port}_{tag}')
+        # responses carry no EoT
+        arg_name = f"{{1'b0, {wire}}}" if suffix == '_dout' else wire
+        yield ast.make_port_arg(port=port, arg=arg_name)
+        if tag == 'response':
+          # the peek port shares the response FIFO, and reads nothing
+          port = module.find_port(f'{arg.port}_{tag}_peek', suffix)
+          if port is not None:
+            if rtl.STREAM_PORT_DIRECTION[suffix] == 'output':
+              arg_name = ''
+            yield ast.make_port_arg(port=port, arg=arg_name)
+
+  def _instantiate_buffer(
+      self,
+      task: Task,
+      name: str,
+      ends: Dict[Instance.Arg.Cat, Tuple[Instance, Instance.Arg]],
+  ) -> None:
+    """Instantiate the `ping_pong_buffer` of a tapa::buffer, next to its
+    consumer in the floorplan."""
+    if set(ends) != set(self._BUFFER_SIDES):
+      raise ValueError(f'buffer {name} of {task.name} must be connected to '
+                       'one ibuffer and one obuffer')
+    consumer, consumer_arg = ends[Instance.Arg.Cat.IBUFFER]
+    producer, producer_arg = ends[Instance.Arg.Cat.OBUFFER]
+    request_width = self._get_port_width(consumer.task.module,
+                                         f'{consumer_arg.port}_request', '_din')
+    data_width = self._get_port_width(consumer.task.module,
+                                      f'{consumer_arg.port}_response',
+                                      '_dout') - 1
+    if request_width != self._get_port_width(
+        producer.task.module, f'{producer_arg.port}_request', '_din'):
+      raise ValueError(f'endpoints of buffer {name} differ in width')
+
+    ports = [
+        ast.make_port_arg(port='clk', arg=rtl.CLK),
+        ast.make_port_arg(
+            port='reset',
+            arg=ast.Unot(
+                task.module.add_rst_n(f'{name}__buffer',
+                                      instance_name=consumer.name)),
+        ),
+    ]
+    for side in self._BUFFER_SIDES.values():
+      for tag, suffixes, width in (
+          ('request', rtl.OSTREAM_SUFFIXES, request_width),
+          ('response', rtl.ISTREAM_SUFFIXES, data_width),
+      ):
+        for suffix in suffixes:
+          wire = rtl.wire_name(f'{name}__{side}_{tag}', suffix)
+          task.module.add_signals([
+              ast.Wire(
+                  name=wire,
+                  width=ast.make_width(width) if suffix in {'_din', '_dout'}
+                  else None,
+              )
+          ])
+          ports.append(ast.make_port_arg(port=f'{side}_{tag}{suffix}',
+                                         arg=wire))
+
+    geometry = task.buffers[name]
+    task.module.add_instance(
+        module_name='ping_pong_buffer',
+        instance_name=f'{name}__buffer',
+        ports=ports,
+        params=(
+            ast.ParamArg(paramname='DataWidth',
+                         argname=ast.Constant(data_width)),
+            ast.ParamArg(paramname='RequestWidth',
+                         argname=ast.Constant(request_width)),
+            ast.ParamArg(paramname='Depth',
+                         argname=ast.Constant(geometry['size'])),
+            ast.ParamArg(paramname='Sections',
+                         argname=ast.Constant(geometry['sections'])),
+        ),
+    )
+
+  @staticmethod
+  def _get_port_width(module: rtl.Module, prefix: str, suffix: str) -> int:
+    port = module.ports[module.find_port(prefix, suffix)]
+    return int(port.width.msb.value) - int(port.width.lsb.value) + 1
+
+  def _get_mmap_elem_width(
+      self,
+      task: Task,
+      name: str,
+      width_table: Dict[str, int],
+  ) -> int:
+    return self._mmap_elem_widths.get((task.name, name), width_table[name])
+
+  def _widen_async_mmap_ports(self) -> None:
+    """Widen mmap ports accessed only as async_mmap to the bus width.
+
+    A port of an upper-level task is widened if every lower-level task it is
+    connected to, directly or through upper-level tasks, accesses it as an
+    uncached async_mmap. Ports connected to each other are widened together,
+    because their m_axi interfaces must be of the same width.
+    """
+    bus_width = self._async_mmap_bus_width
+    if not bus_width:
+      return
+    if not 8 <= bus_width <= 1024 or bus_width & (bus_width - 1):
+      raise ValueError(f'invalid async_mmap bus width: {bus_width}; it must be '
+                       'a power of 2 between 8 and 1024')
+
+    mmap_cats = {Instance.Arg.Cat.MMAP, Instance.Arg.Cat.ASYNC_MMAP}
+    upper_tasks = [task for task in self._tasks.values() if task.is_upper]
+    widened: Set[Tuple[str, str]] = set()
+    for task in upper_tasks:
+      used_names = {arg.name for x in task.instances for arg in x.args}
+      for port in task.ports.values():
+        # elements are lanes of the bus, so they must be power-of-2 bytes
+        is_lane = port.width >= 8 and not port.width & (port.width - 1)
+        if (port.cat in mmap_cats and port.name in used_names and
+            (is_lane and port.width < bus_width or
+             (task.name, port.name) in self._mmap_elem_widths)):
+          widened.add((task.name, port.name))
+
+    # narrow the ports until each of them is connected to async_mmaps and
+    # widened ports only
+    changed = True
+    while changed:
+      changed = False
+      for task in upper_tasks:
+        for instance in task.instances:
+          for arg in instance.args:
+            if (task.name, arg.name) not in widened:
+              continue
+            if instance.task.is_upper:
+              if (instance.task.name,
+                  rtl.sanitize_array_name(arg.port)) in widened:
+                continue
+            elif arg.cat == Instance.Arg.Cat.ASYNC_MMAP and not arg.cache:
+              continue
+            widened.discard((task.name, arg.name))
+            changed = True
+        for instance in task.instances:
+          if not instance.task.is_upper:
+            continue
+          for arg in instance.args:
+            child_port = (instance.task.name, rtl.sanitize_array_name(arg.port))
+            if child_port in widened and (task.name, arg.name) not in widened:
+              widened.discard(child_port)
+              changed = True
+
+    for task_name, port_name in sorted(widened):
+      port = self.get_task(task_name).ports[port_name]
+      if (task_name, port_name) not in self._mmap_elem_widths:
+        _logger.debug('widening %s.%s from %d to %d bits', task_name,
+                      port_name, port.width, bus_width)
+        self._mmap_elem_widths[task_name, port_name] = port.width
+      port.width = bus_width
 
   def _instantiate_global_fsm(
       self,
       task: Task,
       is_done_signals: List[rtl.Pipeline],
+      is_busy_signals: List[rtl.Pipeline],
+      chain: bool = False,
   ) -> None:
+    if chain:
+      self._instantiate_ap_ctrl_chain(task, is_done_signals, is_busy_signals)
+      return
+
     # global state machine
 
     def is_state(state: ast.IntConst) -> ast.Eq:
@@ -765,24 +2544,83 @@ class Program:
     task.module.add_pipeline(self.start_q, init=rtl.START)
     task.module.add_pipeline(self.done_q, init=is_state(STATE10))
 
+  def _instantiate_ap_ctrl_chain(
+      self,
+      task: Task,
+      is_done_signals: List[rtl.Pipeline],
+      is_busy_signals: List[rtl.Pipeline],
+  ) -> None:
+    """Control the top-level task with ap_ctrl_chain.
+
+    Instead of waiting for all children to finish, the next invocation is
+    accepted as soon as every child has started the last one, and invocations
+    are reported done in order.
+    """
+
+    def concat(signals: List[rtl.Pipeline]) -> ast.Identifier:
+      return ast.Identifier(
+          '{' + ', '.join(x[-1].name for x in reversed(signals)) + '}')
+
+    # ap_ready must not be asserted again before the stale ap_start and the
+    # busy signals of children have gone through the pipelines
+    latency = 3 * self.register_level + 4
+    task.module.add_instance(
+        module_name='ap_ctrl_chain',
+        instance_name='ap_ctrl_chain_U',
+        params=(
+            ast.ParamArg(paramname='ChildCount',
+                         argname=ast.Constant(len(is_done_signals))),
+            ast.ParamArg(paramname='Latency', argname=ast.Constant(latency)),
+        ),
+        ports=(
+            ast.make_port_arg(port='clk', arg=rtl.CLK),
+            ast.make_port_arg(port='rst', arg=rtl.RST),
+            ast.make_port_arg(port='ap_start', arg=self.start_q[-1]),
+            ast.make_port_arg(port='ap_ready', arg=rtl.READY),
+            ast.make_port_arg(port='ap_done', arg=rtl.DONE),
+            ast.make_port_arg(port='ap_idle', arg=rtl.IDLE),
+            ast.make_port_arg(port='ap_continue', arg=rtl.CONTINUE),
+            ast.make_port_arg(port='child_busy', arg=concat(is_busy_signals)),
+            ast.make_port_arg(port='child_done', arg=concat(is_done_signals)),
+        ),
+    )
+    task.module.add_pipeline(self.start_q, init=rtl.START)
+
   def _instrument_task(
       self,
       task: Task,
       part_num: str,
       additional_fifo_pipelining: bool = False,
+      almost_full_fifo: bool = False,
   ) -> None:
     assert task.is_upper
     task.module.cleanup()
-    self._instantiate_fifos(task, additional_fifo_pipelining)
+    if self._clk_2_tasks and rtl.HANDSHAKE_CLK_2 not in task.module.ports:
+      task.module.add_ports((
+          ast.Input(name=rtl.HANDSHAKE_CLK_2, width=None),
+          ast.Input(name=rtl.HANDSHAKE_RST_N_2, width=None),
+      ))
+    self._instantiate_fifos(task, additional_fifo_pipelining, almost_full_fifo)
     self._connect_fifos(task)
     width_table = {port.name: port.width for port in task.ports.values()}
-    is_done_signals = self._instantiate_children_tasks(task, width_table, part_num)
-    self._instantiate_global_fsm(task, is_done_signals)
+    # HLS adds ap_continue to the top-level task only with ap_ctrl_chain
+    chain = (task.name == self.top and
+             rtl.HANDSHAKE_CONTINUE in task.module.ports)
+    if chain and all(x.is_autorun for x in task.instances):
+      _logger.warning('ap_ctrl_chain ignored: no child of %s ever finishes',
+                      task.name)
+      chain = False
+    is_done_signals, is_busy_signals = self._instantiate_children_tasks(
+        task, width_table, part_num, chain)
+    self._instantiate_global_fsm(task, is_done_signals, is_busy_signals, chain)
+    task.module.add_broadcast_trees()
+
+    if task.name == self.top and self._perf_fifos is not None:
+      self._add_perf_probes(task)
 
     # an upper task is not necessarily a top task
     if task.name != self.top:
-      with open(self.get_rtl(task.name), 'w') as rtl_code:
-        rtl_code.write(task.module.code)
+      util.write_if_changed(self.get_rtl(task.name), task.module.code)
     else:
       self._pipeline_top_task(task, part_num)
 
@@ -793,12 +2631,129 @@ class Program:
     # generate the original top module. Append a suffix to it
     top_suffix = '_inner'
     task.module.name += top_suffix
-    with open(self.get_rtl(task.name + top_suffix), 'w') as rtl_code:
-      rtl_code.write(task.module.code)
+    util.write_if_changed(self.get_rtl(task.name + top_suffix),
+                          task.module.code)
 
     # generate the wrapper that becomes the final top module
-    with open(self.get_rtl(task.name), 'w') as rtl_code:
-      rtl_code.write(get_axi_pipeline_wrapper(task.name, top_suffix, task, part_num))
+    util.write_if_changed(
+        self.get_rtl(task.name),
+        get_axi_pipeline_wrapper(task.name, top_suffix, task, part_num,
+                                 self._perf_fifos,
+                                 [f'{x}.{y}' for x, y in self._perf_loops]))
+
+  def _get_perf_fifos(self) -> List[str]:
+    """Select the FIFOs and loops of the top-level task to count and write the
+    map of the performance counter registers to perf_counters.json."""
+    task = self.top_task
+    axi_names = [
+        port.name
+        for port in task.ports.values()
+        if port.cat in {Instance.Arg.Cat.MMAP, Instance.Arg.Cat.ASYNC_MMAP}
+    ]
+    # FIFOs crossing clock domains are not counted on ap_clk
+    fifos = [
+        name for name, fifo in task.fifos.items() if 'depth' in fifo and
+        fifo['produced_by'][0] not in self._clk_2_tasks and
+        fifo['consumed_by'][0] not in self._clk_2_tasks
+    ]
+    # loops of instances on ap_clk_2 are not counted either
+    self._perf_loops = [(instance.name, loop['name'])
+                        for instance in task.instances
+                        if instance.task.name not in self._clk_2_tasks
+                        for loop in instance.task.loops]
+    loops = [f'{x}.{y}' for x, y in self._perf_loops]
+    while (len(get_perf_counter_names(fifos, loops, axi_names)) >
+           PERF_MAX_COUNTERS):
+      if fifos:
+        _logger.warning('too many performance counters; not counting FIFO %s',
+                        fifos.pop())
+      else:
+        self._perf_loops.pop()
+        _logger.warning('too many performance counters; not counting loop %s',
+                        loops.pop())
+
+    with open(os.path.join(self.work_dir, 'perf_counters.json'), 'w') as fp:
+      json.dump(
+          {
+              name: PERF_BASE_ADDR + idx * 8
+              for idx, name in enumerate(get_perf_counter_names(
+                  fifos, loops, axi_names))
+          },
+          fp,
+          indent=2,
+      )
+    return fifos
+
+  def _add_perf_probes(self, task: Task) -> None:
+    """Expose the events of the counted FIFOs and loops and whether the kernel
+    is running, which are counted in the top-level wrapper."""
+    running = ast.Identifier(f'{PERF_PREFIX}running')
+    task.module.add_ports([ast.Output(name=running.name, width=None)])
+    task.module.add_logics([ast.Assign(left=running, right=ast.Unot(rtl.IDLE))])
+    self._add_perf_loop_probes(task)
+    if not self._perf_fifos:
+      return
+
+    events = []
+    for fifo in self._perf_fifos:
+      full_n = rtl.wire_name(fifo, rtl.OSTREAM_SUFFIXES[1])
+      write = rtl.wire_name(fifo, rtl.OSTREAM_SUFFIXES[2])
+      empty_n = rtl.wire_name(fifo, rtl.ISTREAM_SUFFIXES[1])
+      # in the order of PERF_FIFO_EVENTS, LSB first
+      events[:0] = [f'{write} & {full_n}', f'~{empty_n}', f'~{full_n}']
+    fifo_events = ast.Identifier(f'{PERF_PREFIX}fifo')
+    task.module.add_ports([
+        ast.Output(name=fifo_events.name,
+                   width=ast.make_width(len(events))),
+    ])
+    task.module.add_logics([
+        ast.Assign(left=fifo_events,
+                   right=ast.Identifier('{' + ', '.join(events) + '}')),
+    ])
+
+  def _add_perf_loop_probes(self, task: Task) -> None:
+    """Expose the events of the counted loops, whose ports are connected by
+    _instantiate_children_tasks. A loop stalls in each cycle in which it is
+    active, i.e., between its start and its end, but issues no iteration."""
+    if not self._perf_loops:
+      return
+
+    events = []
+    for instance, loop in self._perf_loops:
+      iter_vld = f'{instance}_{loop}_iter_ap_vld'
+      active = f'{instance}_{loop}_active'
+      active_q = ast.Identifier(f'{active}_q')
+      task.module.add_signals([ast.Reg(active_q.name, width=None)])
+      task.module.add_logics([
+          ast.Always(
+              sens_list=rtl.CLK_SENS_LIST,
+              statement=ast.make_block(
+                  ast.make_if_with_block(
+                      cond=ast.Unot(rtl.RST_N),
+                      true=ast.NonblockingSubstitution(
+                          left=active_q,
+                          right=rtl.FALSE,
+                      ),
+                      false=ast.make_if_with_block(
+                          cond=ast.Identifier(f'{active}_ap_vld'),
+                          true=ast.NonblockingSubstitution(
+                              left=active_q,
+                              right=ast.Identifier(active),
+                          ),
+                      ),
+                  )),
+          ),
+      ])
+      # in the order of PERF_LOOP_EVENTS, LSB first
+      events[:0] = [iter_vld, f'{active_q.name} & ~{iter_vld}']
+    loop_events = ast.Identifier(f'{PERF_PREFIX}loop')
+    task.module.add_ports([
+        ast.Output(name=loop_events.name, width=ast.make_width(len(events))),
+    ])
+    task.module.add_logics([
+        ast.Assign(left=loop_events,
+                   right=ast.Identifier('{' + ', '.join(events) + '}')),
+    ])
 
   def _get_fifo_width(self, task: Task, fifo: str) -> int:
     producer_task, _, fifo_port = task.get_connection_to(fifo, 'produced_by')
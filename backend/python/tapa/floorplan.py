@@ -1,23 +1,43 @@
+import copy
+import hashlib
 import itertools
 import json
 import logging
 import os
+import re
 import sys
 from collections import defaultdict
 from concurrent import futures
-from typing import Optional, Dict, Callable, List, Tuple, TextIO
+from typing import Optional, Dict, Callable, Iterable, List, Tuple, TextIO
 
 from haoda.report.xilinx import rtl as report
 from tapa import util
 from tapa.task import Task
 
-from .task_graph import get_edges, get_vertices
-from .hardware import get_ctrl_instance_region, get_port_region
+from .instance import Instance
+from .task_graph import get_edges, get_vertices, get_port_name_to_width
+from tapa.verilog import xilinx as rtl
+from .hardware import (FIFO_IMPLS, get_auto_fifo_impl, get_ctrl_instance_region,
+                       get_fifo_area, get_memory_channels, get_port_region)
 
 from autobridge.main import annotate_floorplan
 
 _logger = logging.getLogger().getChild(__name__)
 
+TIMING_REFINEMENT_JSON = 'timing-refinement.json'
+
+# FIFO memories are balanced below this fraction of each resource unless
+# `--max-usage` is given, which is as conservative as AutoBridge by default.
+DEFAULT_FIFO_MAX_USAGE = 0.7
+
+# resources among which the memory of FIFOs is balanced
+FIFO_RESOURCES = ('LUT', 'FF', 'BRAM', 'URAM')
+
+# the floorplan is solved at most this many more times after FIFOs move
+# between memories
+FIFO_IMPL_ROUNDS = 3
+
+
 class InputError(Exception):
   pass
 
@@ -33,11 +53,28 @@ def generate_floorplan(
     task_getter: Callable[[str], Task],
     fifo_width_getter: Callable[[Task, str], int],
     cpp_getter: Callable[[str], str],
+    timing_refinement: Optional[Dict] = None,
+    previous_floorplan: Optional[Dict] = None,
+    max_fifo_slice_width: int = 0,
+    available_area: Optional[Dict[str, int]] = None,
     **kwargs,
 ) -> Tuple[Dict, Dict]:
   """
   get the target region of each vertex
   get the pipeline level of each edge
+
+  If `previous_floorplan` is given, the vertices it already covers are pinned
+  to their previous regions; see `get_warm_start_pre_assignments`.
+
+  FIFOs wider than `max_fifo_slice_width`, if set, are floorplanned as slices;
+  see `get_fifo_edges`.
+
+  If `available_area`, the resources of the device, is given, the memory of
+  each FIFO without an explicit `impl` is chosen jointly with the floorplan:
+  the area of each FIFO is added to its producer vertex, FIFOs are moved
+  between memories until the device and then each region fits in the maximum
+  usage, and the floorplan is solved again with the new areas. The choice is
+  recorded as the `impl` of the FIFO edges; see `extract_fifo_impl`.
   """
   # run logic synthesis to get an accurate area estimation
   if enable_synth_util:
@@ -56,20 +93,268 @@ def generate_floorplan(
     top_task,
     fifo_width_getter,
     user_floorplan_pre_assignments,
+    timing_refinement,
+    max_fifo_slice_width,
     **kwargs,
   )
 
+  if available_area is None:
+    return solve_floorplan(config, previous_floorplan)
+
+  max_usage = kwargs.get('user_max_usage_ratio', DEFAULT_FIFO_MAX_USAGE)
+  fifos = get_fifo_memories(top_task, fifo_width_getter)
+  base_area = {
+    name: dict(properties['area'])
+    for name, properties in config['vertices'].items()
+  }
+  add_fifo_memory_area(config, base_area, fifos)
+
+  # balance the whole device first, which may let the floorplan succeed
+  usage = defaultdict(int)
+  for properties in config['vertices'].values():
+    for resource, amount in properties['area'].items():
+      usage[resource] += amount
+  budget = {k: v * max_usage for k, v in available_area.items()}
+  if rebalance_fifo_memories(fifos, list(fifos), usage, budget):
+    add_fifo_memory_area(config, base_area, fifos)
+
+  solved_config, config_with_floorplan = solve_floorplan(
+    config, previous_floorplan)
+  for _ in range(FIFO_IMPL_ROUNDS):
+    if (config_with_floorplan.get('floorplan_status') == 'FAILED' or
+        not rebalance_fifo_memories_by_region(
+          config_with_floorplan, fifos, available_area, max_usage)):
+      break
+    _logger.info('solving the floorplan again with the FIFO memories moved')
+    add_fifo_memory_area(config, base_area, fifos)
+    solved_config, config_with_floorplan = solve_floorplan(
+      config, previous_floorplan)
+
+  for c in (solved_config, config_with_floorplan):
+    for properties in c.get('edges', {}).values():
+      if properties['category'] == 'FIFO_EDGE':
+        name = properties.get('slice_of', properties['instance'])
+        properties['impl'] = fifos[name]['impl']
+
+  return solved_config, config_with_floorplan
+
+
+def solve_floorplan(
+    config: Dict,
+    previous_floorplan: Optional[Dict] = None,
+) -> Tuple[Dict, Dict]:
+  """ run the floorplanner on `config`, warm-started if possible
+
+  Returns the config solved, which has the pinned vertices of the warm start
+  if it succeeded, and the config with the floorplan.
+  """
+  if previous_floorplan is not None:
+    warm_start_pre_assignments = get_warm_start_pre_assignments(
+      config,
+      previous_floorplan,
+    )
+    if warm_start_pre_assignments:
+      warm_start_config = copy.deepcopy(config)
+      for region, vertices in warm_start_pre_assignments.items():
+        warm_start_config['floorplan_pre_assignments'].setdefault(
+          region, []).extend(vertices)
+      config_with_floorplan = annotate_floorplan(warm_start_config)
+      if config_with_floorplan.get('floorplan_status') != 'FAILED':
+        return warm_start_config, config_with_floorplan
+      _logger.warning('warm-start floorplanning failed; solving from scratch')
+
   config_with_floorplan = annotate_floorplan(config)
 
   return config, config_with_floorplan
 
 
+def get_warm_start_pre_assignments(
+    config: Dict,
+    previous_floorplan: Dict,
+) -> Dict[str, List[str]]:
+  """ pin the vertices unaffected by design changes to their previous regions
+
+  A vertex is perturbed if it is new, if its area or category changed, or if
+  any edge from or to it was added, removed, or changed. Only the perturbed
+  vertices are left to the solver, so that the floorplan stays stable across
+  small changes and the solver has fewer vertices to place.
+  """
+  if previous_floorplan.get('floorplan_status') == 'FAILED':
+    return {}
+
+  def get_edge_key(properties: Dict) -> Tuple:
+    return tuple(properties.get(key)
+                 for key in ('produced_by', 'consumed_by', 'width', 'depth'))
+
+  edges = config['edges']
+  previous_edges = previous_floorplan['edges']
+  perturbed = set()
+  for name in edges.keys() | previous_edges.keys():
+    if (name not in edges or name not in previous_edges or
+        get_edge_key(edges[name]) != get_edge_key(previous_edges[name])):
+      for properties in (edges.get(name), previous_edges.get(name)):
+        if properties is not None:
+          perturbed.add(properties['produced_by'])
+          perturbed.add(properties['consumed_by'])
+
+  pre_assigned = {
+    vertex for vertices in config['floorplan_pre_assignments'].values()
+    for vertex in vertices
+  }
+  pre_assignments = defaultdict(list)
+  for name, properties in config['vertices'].items():
+    previous = previous_floorplan['vertices'].get(name)
+    if (name in pre_assigned or name in perturbed or previous is None or
+        'floorplan_region' not in previous or
+        previous.get('area') != properties.get('area') or
+        previous.get('category') != properties.get('category')):
+      continue
+    pre_assignments[previous['floorplan_region']].append(name)
+
+  _logger.info('warm start: pinned %d of %d vertices',
+               sum(map(len, pre_assignments.values())),
+               len(config['vertices']))
+  return pre_assignments
+
+
+def get_fifo_memories(
+    top_task: Task,
+    fifo_width_getter: Callable[[Task, str], int],
+) -> Dict[str, Dict]:
+  """ get the width, depth, and memory of each FIFO of the top task
+
+  FIFOs are keyed by their sanitized names and belong to their producer
+  vertex, whose region they are in. FIFOs whose stream type gives an `impl`
+  are fixed; the others start in the memory fifo.v would choose.
+  """
+  fifos = {}
+  for fifo_name, fifo in top_task.fifos.items():
+    width = fifo_width_getter(top_task, fifo_name)
+    depth = fifo['depth']
+    fifos[rtl.sanitize_array_name(fifo_name)] = {
+      'vertex': 'TASK_VERTEX_' + util.get_instance_name(fifo['produced_by']),
+      'width': width,
+      'depth': depth,
+      'impl': fifo.get('impl') or get_auto_fifo_impl(width, depth),
+      'fixed': 'impl' in fifo,
+    }
+  return fifos
+
+
+def add_fifo_memory_area(
+    config: Dict,
+    base_area: Dict[str, Dict[str, int]],
+    fifos: Dict[str, Dict],
+) -> None:
+  """ set the area of each vertex to its `base_area` plus that of its FIFOs """
+  for name, area in base_area.items():
+    config['vertices'][name]['area'] = dict(area)
+  for fifo in fifos.values():
+    vertex = config['vertices'].get(fifo['vertex'])
+    if vertex is None:
+      continue
+    area = get_fifo_area(fifo['width'], fifo['depth'], fifo['impl'])
+    for resource, amount in area.items():
+      vertex['area'][resource] = vertex['area'].get(resource, 0) + amount
+
+
+def rebalance_fifo_memories(
+    fifos: Dict[str, Dict],
+    names: Iterable[str],
+    usage: Dict[str, int],
+    budget: Dict[str, float],
+) -> bool:
+  """ move FIFOs between memories until no resource exceeds its budget
+
+  `usage` is the area that includes the FIFOs in `names` and is updated in
+  place. Each step moves the FIFO that lowers the highest ratio of usage to
+  budget the most, and then the sum of the ratios, until no resource is over
+  budget or no move helps, e.g., BRAM FIFOs go to LUTRAM while LUTs are to
+  spare. Returns whether any FIFO moved.
+  """
+  def get_pressure(area: Dict[str, int]) -> Tuple[float, float]:
+    ratios = [
+      area.get(k, 0) / budget[k] if budget.get(k) else float('inf')
+      for k in FIFO_RESOURCES if budget.get(k) or area.get(k)
+    ]
+    return max(ratios, default=0.), sum(ratios)
+
+  is_changed = False
+  pressure = get_pressure(usage)
+  while pressure[0] > 1:
+    best = None
+    for name in names:
+      fifo = fifos[name]
+      if fifo['fixed'] or fifo['depth'] <= 1:
+        continue
+      old_area = get_fifo_area(fifo['width'], fifo['depth'], fifo['impl'])
+      for impl in FIFO_IMPLS:
+        new_area = get_fifo_area(fifo['width'], fifo['depth'], impl)
+        area = {
+          k: usage.get(k, 0) - old_area[k] + new_area[k] for k in old_area
+        }
+        new_pressure = get_pressure(area)
+        if best is None or new_pressure < best[0]:
+          best = (new_pressure, name, impl, area)
+    if best is None or best[0] >= pressure:
+      break
+    pressure, name, impl, area = best
+    _logger.debug('moving FIFO %s from %s to %s', name, fifos[name]['impl'],
+                  impl)
+    fifos[name]['impl'] = impl
+    usage.update(area)
+    is_changed = True
+  return is_changed
+
+
+def rebalance_fifo_memories_by_region(
+    config_with_floorplan: Dict,
+    fifos: Dict[str, Dict],
+    available_area: Dict[str, int],
+    max_usage: float,
+) -> bool:
+  """ rebalance the FIFO memories of each region of a floorplan
+
+  Each region is budgeted an equal share of `available_area` times
+  `max_usage`. The vertex areas of the floorplan must include the FIFOs; see
+  `add_fifo_memory_area`. Returns whether any FIFO moved.
+  """
+  region_of = {
+    name: properties['floorplan_region']
+    for name, properties in config_with_floorplan['vertices'].items()
+    if properties['category'] != 'PORT_VERTEX'
+  }
+  usage = defaultdict(lambda: defaultdict(int))
+  for name, region in region_of.items():
+    area = config_with_floorplan['vertices'][name]['area']
+    for resource, amount in area.items():
+      usage[region][resource] += amount
+
+  region_count = len(
+    config_with_floorplan.get('floorplan_region_pblock_tcl') or usage)
+  budget = {
+    k: v * max_usage / region_count for k, v in available_area.items()
+  }
+  names_by_region = defaultdict(list)
+  for name, fifo in fifos.items():
+    if fifo['vertex'] in region_of:
+      names_by_region[region_of[fifo['vertex']]].append(name)
+
+  is_changed = False
+  for region, names in names_by_region.items():
+    if rebalance_fifo_memories(fifos, names, usage[region], budget):
+      is_changed = True
+  return is_changed
+
+
 def get_floorplan_result(
     work_dir: str,
     constraint: TextIO,
     reuse_hbm_path_pipelining: bool,
     manual_vivado_flow: bool,
-) -> Tuple[Dict[str, str], Dict[str, int]]:
+    reconfigurable_instances: Iterable[str] = (),
+) -> Tuple[Dict[str, str], Dict[str, int], Dict[str, str], Dict[str, int],
+           Dict[str, str]]:
   """ extract floorplan results from the checkpointed config file """
   try:
     config_with_floorplan = json.loads(open(f'{work_dir}/post-floorplan-config.json', 'r').read())
@@ -77,38 +362,253 @@ def get_floorplan_result(
     raise FileNotFoundError(f'no valid floorplanning results found in work directory {work_dir}')
 
   # generate the constraint file
-  vivado_tcl = get_vivado_tcl(config_with_floorplan, work_dir, reuse_hbm_path_pipelining, manual_vivado_flow)
+  vivado_tcl = get_vivado_tcl(config_with_floorplan, work_dir,
+                              reuse_hbm_path_pipelining, manual_vivado_flow,
+                              reconfigurable_instances)
   constraint.write('\n'.join(vivado_tcl))
 
-  fifo_pipeline_level, axi_pipeline_level = extract_pipeline_level(config_with_floorplan)
+  fifo_pipeline_level, axi_pipeline_level = extract_pipeline_level(
+    config_with_floorplan,
+    load_timing_refinement(work_dir),
+  )
 
-  return fifo_pipeline_level, axi_pipeline_level
+  return (
+    fifo_pipeline_level,
+    axi_pipeline_level,
+    extract_floorplan_region(config_with_floorplan),
+    extract_fifo_slice_count(config_with_floorplan),
+    extract_fifo_impl(config_with_floorplan),
+  )
 
 
 def extract_pipeline_level(
   config_with_floorplan,
+  timing_refinement: Optional[Dict] = None,
 ) -> Tuple[Dict[str, str], Dict[str, int]]:
-  """ extract the pipeline level of fifos and axi edges """
+  """ extract the pipeline level of fifos and axi edges
+
+  Edges that failed timing in previous implementation runs get the additional
+  levels recorded in `timing_refinement`.
+  """
   if config_with_floorplan.get('floorplan_status') == 'FAILED':
     return {}, {}
+  timing_refinement = timing_refinement or get_empty_timing_refinement()
 
   fifo_pipeline_level = {}
   for edge, properties in config_with_floorplan['edges'].items():
     if properties['category'] == 'FIFO_EDGE':
-      fifo_pipeline_level[properties['instance']] = len(properties['path'])
+      fifo_name = properties['instance']
+      fifo_pipeline_level[fifo_name] = len(properties['path']) + \
+          timing_refinement['fifo_extra_pipeline_level'].get(fifo_name, 0)
 
   axi_pipeline_level = {}
   for edge, properties in config_with_floorplan['edges'].items():
     if properties['category'] == 'AXI_EDGE':
       # if the AXI module is at the same region as the external port, then no pipelining
       level = len(properties['path']) - 1
+      level += timing_refinement['axi_extra_pipeline_level'].get(
+        properties['port_name'], 0)
 
       axi_pipeline_level[properties['port_name']] = level
 
   return fifo_pipeline_level, axi_pipeline_level
 
 
-def get_vivado_tcl(config_with_floorplan, work_dir, reuse_hbm_path_pipelining, manual_vivado_flow):
+def extract_fifo_slice_count(config_with_floorplan) -> Dict[str, int]:
+  """ extract the number of slices of each FIFO floorplanned as slices
+
+  The slices of a FIFO are named by `fifo_slice_name` and keyed by their own
+  instance names in the pipeline levels and regions.
+  """
+  if config_with_floorplan.get('floorplan_status') == 'FAILED':
+    return {}
+
+  fifo_slice_count = defaultdict(int)
+  for edge, properties in config_with_floorplan['edges'].items():
+    if properties['category'] == 'FIFO_EDGE' and 'slice_of' in properties:
+      fifo_slice_count[properties['slice_of']] += 1
+
+  return dict(fifo_slice_count)
+
+
+def extract_fifo_impl(config_with_floorplan) -> Dict[str, str]:
+  """ extract the memory of each FIFO chosen with the floorplan
+
+  The memory is chosen even if the floorplan failed; see `generate_floorplan`.
+  """
+  fifo_impl = {}
+  for edge, properties in config_with_floorplan.get('edges', {}).items():
+    if properties['category'] == 'FIFO_EDGE' and 'impl' in properties:
+      name = properties.get('slice_of', properties['instance'])
+      fifo_impl[name] = properties['impl']
+
+  return fifo_impl
+
+
+def extract_floorplan_region(config_with_floorplan) -> Dict[str, str]:
+  """ extract the region of each instance
+
+  Task, control, and async_mmap instances are in the region of their vertex;
+  FIFOs are in the region of their producer side.
+  """
+  if config_with_floorplan.get('floorplan_status') == 'FAILED':
+    return {}
+
+  floorplan_region = {}
+  for vertex, properties in config_with_floorplan['vertices'].items():
+    if properties['category'] == 'PORT_VERTEX':
+      continue
+    floorplan_region[properties['instance']] = properties['floorplan_region']
+
+  for edge, properties in config_with_floorplan['edges'].items():
+    if properties['category'] == 'FIFO_EDGE':
+      floorplan_region[properties['instance']] = properties['path'][0]
+
+  return floorplan_region
+
+
+def get_empty_timing_refinement() -> Dict:
+  return {
+    'fifo_extra_pipeline_level': {},
+    'axi_extra_pipeline_level': {},
+    'extra_register_level': 0,
+  }
+
+
+def load_timing_refinement(work_dir: str) -> Dict:
+  """ load the refinements accumulated by `refine_from_timing` """
+  refinement = get_empty_timing_refinement()
+  try:
+    with open(os.path.join(work_dir, TIMING_REFINEMENT_JSON)) as fp:
+      refinement.update(json.load(fp))
+  except FileNotFoundError:
+    pass
+  return refinement
+
+
+def parse_timing_report(report: TextIO) -> List[Tuple[float, str, str]]:
+  """ parse the violating paths of a Vivado `report_timing` text report
+
+  Returns:
+    (slack, source pin, destination pin) of each violating path.
+  """
+  paths = []
+  slack = None
+  source = None
+  for line in report:
+    match = re.match(r'\s*Slack\s*\((VIOLATED|MET)\)\s*:\s*(-?[\d.]+)ns', line)
+    if match:
+      slack = float(match[2]) if match[1] == 'VIOLATED' else None
+      source = None
+      continue
+    match = re.match(r'\s*(Source|Destination):\s+(\S+)', line)
+    if match is None or slack is None:
+      continue
+    if match[1] == 'Source':
+      source = match[2]
+    elif source is not None:
+      paths.append((slack, source, match[2]))
+      slack = None
+  return paths
+
+
+def refine_from_timing(work_dir: str, timing_report: TextIO) -> Dict:
+  """ map critical paths back to the floorplanned edges and tighten them
+
+  The floorplan checkpointed in `post-floorplan-config.json` is used to map
+  each violating path to the FIFO or AXI edge it belongs to. Each failing edge
+  gets one more pipeline level and twice the weight in the next floorplanning,
+  and paths among the top-level scalar registers increase the register level.
+  Refinements accumulate in `timing-refinement.json` across iterations.
+  """
+  try:
+    config_with_floorplan = json.loads(open(f'{work_dir}/post-floorplan-config.json', 'r').read())
+  except:
+    raise FileNotFoundError(f'no valid floorplanning results found in work directory {work_dir}')
+
+  fifo_names = set()
+  fifo_between = {}
+  axi_ports = set()
+  for properties in config_with_floorplan['edges'].values():
+    if properties['category'] == 'FIFO_EDGE':
+      fifo_names.add(properties['instance'])
+      endpoints = (
+        properties['produced_by'].replace('TASK_VERTEX_', '', 1),
+        properties['consumed_by'].replace('TASK_VERTEX_', '', 1),
+      )
+      fifo_between[endpoints] = fifo_between[endpoints[::-1]] = properties['instance']
+    elif properties['category'] == 'AXI_EDGE':
+      axi_ports.add(properties['port_name'])
+  task_instances = {
+    properties['instance']
+    for properties in config_with_floorplan['vertices'].values()
+    if properties['category'] == 'TASK_VERTEX'
+  }
+
+  def locate(pin: str) -> Tuple[str, str]:
+    for cell in pin.replace('\\', '').split('/'):
+      if cell in fifo_names:
+        return 'fifo', cell
+      if cell in axi_ports:
+        return 'axi', cell
+      if cell in task_instances:
+        return 'task', cell
+      if re.search(r'__q\d+', cell):
+        return 'register', cell
+    return '', ''
+
+  failing_fifos = set()
+  failing_axi_ports = set()
+  failing_tasks = set()
+  is_register_failing = False
+  paths = parse_timing_report(timing_report)
+  for slack, source, destination in paths:
+    located = (locate(source), locate(destination))
+    endpoints = dict(located)
+    tasks = tuple(name for kind, name in located if kind == 'task')
+    if 'fifo' in endpoints:
+      failing_fifos.add(endpoints['fifo'])
+    elif 'axi' in endpoints:
+      failing_axi_ports.add(endpoints['axi'])
+    elif 'register' in endpoints:
+      is_register_failing = True
+    elif len(tasks) == 2 and tasks in fifo_between:
+      failing_fifos.add(fifo_between[tasks])
+    elif len(tasks) == 2 and tasks[0] == tasks[1]:
+      failing_tasks.add(tasks[0])
+    else:
+      _logger.debug('cannot map critical path %s -> %s (%sns)', source, destination, slack)
+  _logger.info('found %d violating paths in the timing report', len(paths))
+
+  refinement = load_timing_refinement(work_dir)
+  for fifo_name in sorted(failing_fifos):
+    level = refinement['fifo_extra_pipeline_level'].get(fifo_name, 0) + 1
+    refinement['fifo_extra_pipeline_level'][fifo_name] = level
+    _logger.info('FIFO %s failed timing; using %d extra pipeline levels', fifo_name, level)
+  for port_name in sorted(failing_axi_ports):
+    level = refinement['axi_extra_pipeline_level'].get(port_name, 0) + 1
+    refinement['axi_extra_pipeline_level'][port_name] = level
+    _logger.info('AXI port %s failed timing; using %d extra pipeline levels', port_name, level)
+  if is_register_failing:
+    refinement['extra_register_level'] += 1
+    _logger.info('top-level scalar signals failed timing; using %d extra register levels',
+                 refinement['extra_register_level'])
+  if failing_tasks:
+    _logger.warning('critical paths within task instances %s cannot be fixed by floorplanning',
+                    ', '.join(sorted(failing_tasks)))
+
+  open(os.path.join(work_dir, TIMING_REFINEMENT_JSON), 'w').write(json.dumps(refinement, indent=2))
+  return refinement
+
+
+def get_vivado_tcl(config_with_floorplan, work_dir, reuse_hbm_path_pipelining,
+                   manual_vivado_flow, reconfigurable_instances=()):
+  """ generate the constraints of the floorplan
+
+  Each of `reconfigurable_instances` becomes a DFX reconfigurable partition
+  whose pblock is the region of the instance, which it must have to itself;
+  see `get_reconfigurable_region`.
+  """
   if config_with_floorplan.get('floorplan_status') == 'FAILED':
     return ['# Floorplan failed']
 
@@ -140,11 +640,30 @@ def get_vivado_tcl(config_with_floorplan, work_dir, reuse_hbm_path_pipelining, m
       else:
         region_to_inst[path[0]].append(f'{fifo_name}/.*.unit')
 
+  # reconfigurable partitions; pipeline registers of FIFOs crossing their
+  # regions are left to the static region unconstrained
+  reconfigurable_tcl = []
+  for inst in reconfigurable_instances:
+    region = get_reconfigurable_region(config_with_floorplan, inst)
+    moved = [i for i in region_to_inst[region] if i != inst]
+    if moved:
+      _logger.warning(
+          'pipeline registers in reconfigurable region %s are not '
+          'constrained: %s', region, ', '.join(moved))
+    region_to_inst[region] = [inst]
+    cell = f'pfm_top_i/dynamic_region/.*/inst/.*/{inst}'
+    reconfigurable_tcl += [
+        f'set_property HD.RECONFIGURABLE true [get_cells -regex {{{cell}}}]',
+        f'set_property SNAPPING_MODE ON [get_pblocks {region}]',
+        f'set_property RESET_AFTER_RECONFIG true [get_pblocks {region}]',
+    ]
+
   # print out the constraints
   for region, inst_list in region_to_inst.items():
     vivado_tcl.append(f'add_cells_to_pblock [get_pblocks {region}] [get_cells -regex {{')
     vivado_tcl += [f'  pfm_top_i/dynamic_region/.*/inst/.*/{inst}' for inst in inst_list]
     vivado_tcl.append(f'}} ]')
+  vivado_tcl += reconfigurable_tcl
 
   # redundant clean up code for extra safety
   vivado_tcl.append('foreach pblock [get_pblocks -regexp CR_X\\\\d+Y\\\\d+_To_CR_X\\\\d+Y\\\\d+] {')
@@ -182,6 +701,34 @@ def get_vivado_tcl(config_with_floorplan, work_dir, reuse_hbm_path_pipelining, m
   return vivado_tcl
 
 
+def get_reconfigurable_region(config_with_floorplan, inst: str) -> str:
+  """ get the region of task instance `inst` to be reconfigured at runtime
+
+  A reconfigurable partition cannot share its pblock with static logic, so no
+  other vertex may be in the region; pin the others elsewhere via
+  `--floorplan-pre-assignments` if needed.
+  """
+  region = None
+  for properties in config_with_floorplan['vertices'].values():
+    if properties.get('instance') == inst:
+      region = properties['floorplan_region']
+  if region is None:
+    raise InputError(f'{inst} is not a task instance of the floorplan')
+  others = [
+      properties['instance']
+      for properties in config_with_floorplan['vertices'].values()
+      if properties['category'] != 'PORT_VERTEX' and
+      properties['instance'] != inst and
+      properties['floorplan_region'] == region
+  ]
+  if others:
+    raise InputError(
+        f'reconfigurable instance {inst} shares region {region} with '
+        f'{", ".join(sorted(others))}; pin them to other regions via '
+        '--floorplan-pre-assignments')
+  return region
+
+
 def checkpoint_floorplan(config_with_floorplan, work_dir):
   """ Save a copy of the region -> instances into a json file
   """
@@ -201,12 +748,138 @@ def checkpoint_floorplan(config_with_floorplan, work_dir):
   )
 
 
+def generate_connectivity(
+    part_num: str,
+    physical_connectivity: Optional[TextIO],
+    top_task: Task,
+    compute_units: int = 1,
+    host_arg_names: Iterable[str] = (),
+    stream_connects: Iterable[str] = (),
+) -> str:
+  """ bind the mmap ports missing from `physical_connectivity` to channels
+
+  The traffic of each port is estimated as its width times the number of task
+  instances accessing it. Ports are bound in decreasing traffic, each to the
+  channel with the least traffic so far, so that no channel is oversubscribed
+  while others idle. Among equally busy channels, those in a region already
+  bound to the same instances are preferred so that the floorplanner can keep
+  each instance next to all its ports.
+
+  If `compute_units` > 1, the top task is replicated as compute units named
+  `<top>_1`, `<top>_2`, etc., whose ports are bound in turn with the traffic
+  accumulated over all of them. User bindings apply to every compute unit.
+
+  Ports in `host_arg_names` that are not bound by the user are bound to host
+  memory, which the kernel accesses over PCIe without copying.
+
+  Each of `stream_connects` is `<arg>:<kernel>.<port>[:<depth>]`, which
+  connects stream port `<arg>` of the top task to AXI stream port `<port>` of
+  another kernel, in the direction of `<arg>`.
+
+  Returns the complete connectivity specification for `v++`.
+  """
+  user_arg_name_to_external_port = util.parse_connectivity(
+    physical_connectivity)
+  for arg_name in host_arg_names:
+    user_arg_name_to_external_port.setdefault(arg_name, 'HOST[0]')
+  port_name_to_width = get_port_name_to_width(top_task)
+
+  arg_name_to_traffic = defaultdict(int)
+  arg_name_to_instances = defaultdict(set)
+  for arg_list in top_task.args.values():
+    for arg in arg_list:
+      if arg.cat in {Instance.Arg.Cat.ASYNC_MMAP, Instance.Arg.Cat.MMAP}:
+        arg_name_to_traffic[arg.name] += port_name_to_width[arg.name]
+        arg_name_to_instances[arg.name].add(arg.instance.name)
+
+  channel_to_traffic = {
+    channel: 0 for channel in get_memory_channels(part_num)
+  }
+  instance_to_regions = defaultdict(set)
+
+  def bind(arg_name: str, channel: Tuple[str, int]) -> None:
+    channel_to_traffic[channel] += arg_name_to_traffic[arg_name]
+    for instance in arg_name_to_instances[arg_name]:
+      instance_to_regions[instance].add(get_port_region(part_num, *channel))
+
+  def get_cost(arg_name: str, channel: Tuple[str, int]) -> Tuple[int, int]:
+    region = get_port_region(part_num, *channel)
+    far_instance_count = sum(
+      1 for instance in arg_name_to_instances[arg_name]
+      if instance_to_regions[instance] and
+      region not in instance_to_regions[instance]
+    )
+    return channel_to_traffic[channel], far_instance_count
+
+  unbound_arg_names = sorted(
+    (name for name in arg_name_to_traffic
+     if name not in user_arg_name_to_external_port),
+    key=lambda name: -arg_name_to_traffic[name],
+  )
+
+  cu_names = [top_task.name]
+  lines = ['[connectivity]']
+  if compute_units > 1:
+    cu_names = [f'{top_task.name}_{i + 1}' for i in range(compute_units)]
+    lines.append(f'nk={top_task.name}:{compute_units}:{".".join(cu_names)}')
+  for cu_name in cu_names:
+    # instances of different compute units are placed independently
+    instance_to_regions.clear()
+    arg_name_to_external_port = dict(user_arg_name_to_external_port)
+
+    # user bindings are kept as-is and count towards the channel traffic
+    for arg_name, port in arg_name_to_external_port.items():
+      channel = util.parse_port(port)
+      if channel in channel_to_traffic:
+        bind(arg_name, channel)
+
+    for arg_name in unbound_arg_names:
+      channel = min(channel_to_traffic,
+                    key=lambda channel: get_cost(arg_name, channel))
+      bind(arg_name, channel)
+      arg_name_to_external_port[arg_name] = util.format_port(*channel)
+      _logger.info('binding %s.%s to %s', cu_name, arg_name,
+                   arg_name_to_external_port[arg_name])
+
+    for arg_name, port in arg_name_to_external_port.items():
+      lines.append(f'sp={cu_name}.{arg_name}:{port}')
+
+  for stream_connect in stream_connects:
+    arg_name, _, remote = stream_connect.partition(':')
+    port = top_task.ports.get(arg_name)
+    if port is None or port.cat not in {
+        Instance.Arg.Cat.ISTREAM, Instance.Arg.Cat.OSTREAM
+    }:
+      raise ValueError(f'{top_task.name} has no stream port {arg_name}')
+    remote, _, depth = remote.partition(':')
+    if '.' not in remote:
+      raise ValueError(f'invalid stream connection {stream_connect}')
+    local = f'{cu_names[0]}.{arg_name}'
+    if port.cat == Instance.Arg.Cat.OSTREAM:
+      line = f'stream_connect={local}:{remote}'
+    else:
+      line = f'stream_connect={remote}:{local}'
+    if depth:
+      line += f':{depth}'
+    _logger.info('connecting %s', line[len('stream_connect='):])
+    lines.append(line)
+
+  for channel, traffic in channel_to_traffic.items():
+    if traffic > 0:
+      _logger.debug('%s[%d] is bound to %d bits/cycle of ports', *channel,
+                    traffic)
+
+  return '\n'.join(lines) + '\n'
+
+
 def get_floorplan_config(
     part_num: str,
     physical_connectivity: TextIO,
     top_task: Task,
     fifo_width_getter: Callable[[Task, str], int],
     user_floorplan_pre_assignments: Optional[TextIO],
+    timing_refinement: Optional[Dict] = None,
+    max_fifo_slice_width: int = 0,
     **kwargs,
 ) -> Dict:
   """ Generate a json encoding the task graph for the floorplanner
@@ -216,7 +889,26 @@ def get_floorplan_config(
                                 top_task,
                               )
 
-  edges = get_edges(top_task, fifo_width_getter)
+  # The floorplanner has no notion of throughput; minimizing the SLR crossings
+  # of FIFOs weighted by their traffic keeps busy FIFOs within a slot.
+  weight_by_rate = kwargs.get('floorplan_opt_priority') == 'THROUGHPUT_PRIORITIZED'
+  if weight_by_rate:
+    kwargs['floorplan_opt_priority'] = 'SLR_CROSSING_PRIORITIZED'
+
+  edges = get_edges(top_task, fifo_width_getter, weight_by_rate,
+                    max_fifo_slice_width)
+
+  # Edges that failed timing are weighed more so that they are less likely to
+  # be cut again.
+  if timing_refinement:
+    for properties in edges.values():
+      if properties['category'] == 'FIFO_EDGE':
+        level = timing_refinement['fifo_extra_pipeline_level'].get(properties['instance'], 0)
+      elif properties['category'] == 'AXI_EDGE':
+        level = timing_refinement['axi_extra_pipeline_level'].get(properties['port_name'], 0)
+      else:
+        continue
+      properties['width'] *= 2 ** level
   vertices = get_vertices(top_task, arg_name_to_external_port)
   floorplan_pre_assignments = get_floorplan_pre_assignments(
                                 part_num,
@@ -287,17 +979,47 @@ def get_post_synth_area(
     post_syn_rpt_getter: Callable[[str], str],
     task_getter: Callable[[str], Task],
     cpp_getter: Callable[[str], str],
+    mem_per_job: float = 4.,
 ):
+  """Run out-of-context synthesis of the children of `top_task` for area.
+
+  Reports are reused if the C++ source and the generated RTL of the module are
+  unchanged, and concurrent synthesis jobs are bounded by the available memory,
+  reserving `mem_per_job` GiB for each job.
+  """
+  def get_synth_hash(module_name: str) -> str:
+    # The report depends on the C++ source and the RTL generated from it,
+    # whose file names start with the module name.
+    synth_hash = hashlib.sha256(part_num.encode())
+    with open(cpp_getter(module_name), 'rb') as cpp_file:
+      synth_hash.update(cpp_file.read())
+    for file_name in sorted(os.listdir(rtl_dir)):
+      if file_name.startswith(module_name):
+        synth_hash.update(b'\0' + file_name.encode() + b'\0')
+        with open(os.path.join(rtl_dir, file_name), 'rb') as rtl_file:
+          synth_hash.update(rtl_file.read())
+    return synth_hash.hexdigest()
+
   def worker(module_name: str, idx: int) -> report.HierarchicalUtilization:
     _logger.debug('synthesizing %s', module_name)
     rpt_path = post_syn_rpt_getter(module_name)
+    hash_path = rpt_path + '.hash'
+    synth_hash = get_synth_hash(module_name)
 
-    rpt_path_mtime = 0.
-    if os.path.isfile(rpt_path):
-      rpt_path_mtime = os.path.getmtime(rpt_path)
-
-    # generate report if and only if C++ source is newer than report.
-    if os.path.getmtime(cpp_getter(module_name)) > rpt_path_mtime:
+    # generate report if and only if the sources have changed since the report
+    # was generated.
+    try:
+      with open(hash_path) as hash_file:
+        is_cached = hash_file.read() == synth_hash and os.path.isfile(rpt_path)
+    except FileNotFoundError:
+      is_cached = False
+    if is_cached:
+      _logger.debug('reusing synthesis report of %s', module_name)
+    else:
+      if os.path.exists(hash_path):
+        os.remove(hash_path)
+      if os.path.exists(rpt_path):
+        os.remove(rpt_path)
       os.nice(idx % 19)
       with report.ReportDirUtil(
           rtl_dir,
@@ -308,19 +1030,22 @@ def get_post_synth_area(
       ) as proc:
         stdout, stderr = proc.communicate()
 
-      # err if output report does not exist or is not newer than previous
-      if (not os.path.isfile(rpt_path) or
-          os.path.getmtime(rpt_path) <= rpt_path_mtime):
+      # err if output report does not exist
+      if not os.path.isfile(rpt_path):
         sys.stdout.write(stdout.decode('utf-8'))
         sys.stderr.write(stderr.decode('utf-8'))
         raise InputError(f'failed to generate report for {module_name}')
+      with open(hash_path, 'w') as hash_file:
+        hash_file.write(synth_hash)
 
     with open(rpt_path) as rpt_file:
       return report.parse_hierarchical_utilization_report(rpt_file)
 
+  jobs = util.get_max_jobs(mem_per_job)
   _logger.info('generating post-synthesis resource utilization reports')
   _logger.info('this step runs logic synthesis of each task for accurate area info, it may take a while')
-  with futures.ThreadPoolExecutor(max_workers=os.cpu_count()) as executor:
+  _logger.info('running up to %d synthesis jobs concurrently', jobs)
+  with futures.ThreadPoolExecutor(max_workers=jobs) as executor:
     for utilization in executor.map(
         worker,
         {x.task.name for x in top_task.instances},
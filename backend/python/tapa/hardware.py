@@ -1,3 +1,5 @@
+from typing import Dict, List, Optional, Tuple
+
 AREA_OF_ASYNC_MMAP = {
     32: {
         'BRAM': 0,
@@ -70,17 +72,81 @@ def get_hbm_controller_area():
 def get_async_mmap_area(data_channel_width: int):
   return AREA_OF_ASYNC_MMAP[_next_power_of_2(data_channel_width)]
 
+# memories of `fifo`, in the order of its IMPL parameter
+FIFO_IMPLS = ('srl', 'lutram', 'bram', 'uram')
+
+# (depth, width) aspect ratios of a BRAM18 in simple dual-port mode
+BRAM18_SHAPES = ((512, 36), (1024, 18), (2048, 9), (4096, 4), (8192, 2),
+                 (16384, 1))
+
+def get_auto_fifo_impl(width: int, depth: int) -> str:
+  """ memory of a FIFO whose IMPL is "auto", as chosen in fifo.v """
+  if width >= 36 and depth >= 4096:
+    return 'uram'
+  if depth >= 128 and width * depth >= 9216:
+    return 'bram'
+  return 'srl'
+
+def get_fifo_area(width: int, depth: int, impl: str) -> Dict[str, int]:
+  """ estimated area of a FIFO of `width` bits and `depth` tokens
+
+  The memory is SRL32s, RAM64M8s (7 bits of 64 tokens in 8 LUTs), BRAM18s of
+  the cheapest aspect ratio, or URAMs (72 bits of 4096 tokens); the pointers
+  and the output register are added on top. FIFOs of depth 1 are registers
+  regardless of `impl`.
+  """
+  area = dict(ZERO_AREA)
+  if depth <= 1:
+    area['LUT'] = 2
+    area['FF'] = width + 1
+    return area
+  addr_width = (depth - 1).bit_length()
+  area['LUT'] = 4 * addr_width
+  area['FF'] = 2 * addr_width + width
+  if impl == 'srl':
+    area['LUT'] += width * -(-depth // 32)
+  elif impl == 'lutram':
+    area['LUT'] += 8 * -(-width // 7) * -(-depth // 64)
+  elif impl == 'bram':
+    area['BRAM'] = min(-(-width // w) * -(-depth // d)
+                       for d, w in BRAM18_SHAPES)
+  elif impl == 'uram':
+    area['URAM'] = -(-width // 72) * -(-depth // 4096)
+  else:
+    raise ValueError(f'unknown FIFO impl {impl}')
+  return area
+
 def _next_power_of_2(x):
   return 1 if x == 0 else 2**(x - 1).bit_length()
 
+def is_versal(part_num: str) -> bool:
+  """ whether the part is a Versal device, whose memory is behind the NoC """
+  return part_num.startswith(('xcvc', 'xcve', 'xcvm', 'xcvp', 'xcv80'))
+
 def get_ctrl_instance_region(part_num: str) -> str:
   if part_num.startswith('xcu250-') or part_num.startswith('xcu280-'):
     return 'COARSE_X1Y0'
   raise NotImplementedError(f'unknown {part_num}')
 
-def get_port_region(part_num: str, port_cat: str, port_id: int) -> str:
+def get_memory_channels(part_num: str) -> List[Tuple[str, int]]:
   """
-  return the physical location of a given port
+  return the off-chip memory channels that mmap ports can be bound to
+  HBM is preferred over DDR if the part has both
+  """
+  if part_num.startswith('xcu280-'):
+    return [('HBM', i) for i in range(32)]
+  if part_num.startswith('xcu250-'):
+    return [('DDR', i) for i in range(4)]
+  if part_num.startswith('xcvc1902-'):
+    # the DDR4 of the VCK5000 is one bank behind the NoC
+    return [('MC_NOC', 0)]
+  raise NotImplementedError(f'unknown {part_num}')
+
+def get_port_region(part_num: str, port_cat: str,
+                    port_id: int) -> Optional[str]:
+  """
+  return the physical location of a given port, or None if the port is
+  reachable from every region
   refer to the Vitis platforminfo command
   """
   if part_num.startswith('xcu280-'):
@@ -97,4 +163,13 @@ def get_port_region(part_num: str, port_cat: str, port_id: int) -> str:
     if port_cat == 'PLRAM' and 0 <= port_id < 4:
       return f'COARSE_X1Y{port_id}'
 
+  # NoC-attached memory is reached from the NoC master unit nearest to the
+  # port, wherever it is, so the port is not tied to any region
+  if is_versal(part_num) and port_cat == 'MC_NOC':
+    return None
+
+  # host memory is reached via the slave bridge next to the PCIe controller
+  if port_cat == 'HOST' and port_id == 0:
+    return get_ctrl_instance_region(part_num)
+
   raise NotImplementedError(f'unknown port_cat {port_cat}, port_id {port_id} for {part_num}')
@@ -1,5 +1,5 @@
 import enum
-from typing import Iterator, Tuple, Union
+from typing import Dict, Iterator, Optional, Tuple, Union
 
 from tapa import util
 from tapa.verilog import ast
@@ -36,16 +36,22 @@ class Instance:
       STREAM = 1 << 3
       MMAP = 1 << 4
       ASYNC = 1 << 5
+      BUFFER = 1 << 6
       ASYNC_MMAP = MMAP | ASYNC
       ISTREAM = STREAM | INPUT
       OSTREAM = STREAM | OUTPUT
+      IBUFFER = BUFFER | INPUT
+      OBUFFER = BUFFER | OUTPUT
 
     def __init__(self,
                  name: str,
                  instance: 'Instance',
                  cat: Union[str, Cat],
                  port: str,
-                 is_upper=False):
+                 is_upper=False,
+                 cache: Optional[Dict[str, int]] = None,
+                 burst: Optional[Dict[str, int]] = None,
+                 atomic: bool = False):
       self.name = name
       self.instance = instance
       if isinstance(cat, str):
@@ -54,7 +60,9 @@ class Instance:
             'ostream': Instance.Arg.Cat.OSTREAM,
             'scalar': Instance.Arg.Cat.SCALAR,
             'mmap': Instance.Arg.Cat.MMAP,
-            'async_mmap': Instance.Arg.Cat.ASYNC_MMAP
+            'async_mmap': Instance.Arg.Cat.ASYNC_MMAP,
+            'ibuffer': Instance.Arg.Cat.IBUFFER,
+            'obuffer': Instance.Arg.Cat.OBUFFER,
         }[cat]
         # only lower-level async_mmap is acknowledged
         if is_upper and self.cat == Instance.Arg.Cat.ASYNC_MMAP:
@@ -64,6 +72,18 @@ class Instance:
       self.port = port
       self.width = None
       self.shared = False  # only set for (async) mmaps
+      # (lines, ways) of tapa::cached_async_mmap, only set for async_mmaps
+      self.cache: Optional[Tuple[int, int]] = None
+      if cache is not None:
+        self.cache = cache['lines'], cache['ways']
+      # (burst length, wait cycles) of tapa::burst_async_mmap, only set for
+      # async_mmaps
+      self.burst: Optional[Tuple[int, int]] = None
+      if burst is not None:
+        self.burst = burst['len'], burst['wait']
+      # whether writes are updates of tapa::atomic_async_mmap, only set for
+      # async_mmaps
+      self.atomic = atomic
 
     def __lt__(self, other):
       if isinstance(other, Instance.Arg):
@@ -89,6 +109,9 @@ class Instance:
                 cat=arg['cat'],
                 port=port,
                 is_upper=task.is_upper,
+                cache=arg.get('cache'),
+                burst=arg.get('burst'),
+                atomic=arg.get('atomic', False),
             ) for port, arg in kwargs.pop('args').items()))
 
   @property
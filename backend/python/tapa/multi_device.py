@@ -0,0 +1,235 @@
+"""Partitioning of the task graph among several devices.
+
+The task graph is the one floorplanned by AutoBridge, i.e., the config of
+`get_floorplan_config`, and task instances are assigned to devices so that the
+FIFOs crossing devices, which are implemented over inter-device links, carry as
+few bits as possible while each device fits in the maximum usage.
+"""
+
+import collections
+import logging
+from typing import Dict, List, Optional
+
+_logger = logging.getLogger().getChild(__name__)
+
+# Categories of vertices that are placed with the task instances; the others,
+# i.e., the control and memory ports, exist on every device.
+PARTITIONED_VERTICES = ('TASK_VERTEX', 'ASYNC_MMAP_VERTEX')
+
+# Vertices are moved between devices in at most this many passes.
+REFINEMENT_ROUNDS = 8
+
+
+class InputError(Exception):
+  pass
+
+
+def partition_devices(
+    config: Dict,
+    num_devices: int,
+    pre_assignments: Optional[Dict[str, List[str]]],
+    available_area: Dict[str, int],
+    max_usage: float,
+    link_latency: int,
+) -> Dict:
+  """Assigns the task instances of `config` to `num_devices` devices.
+
+  `pre_assignments` maps device indices to instance (or vertex) names pinned
+  to them. Vertices connected by AXI of an async_mmap stay together. The rest
+  are first assigned in the order of a breadth-first traversal of the FIFOs,
+  filling each device up to an even share of the total area, which cuts
+  pipelines into consecutive stages, and then moved one at a time to the
+  device that removes the most crossing bits while fitting in `max_usage` of
+  `available_area`.
+
+  FIFOs crossing devices use credit-based flow control over links whose round
+  trip takes `link_latency` kernel cycles, so their depth is raised to at
+  least that to sustain one token per cycle.
+
+  Returns the partition, with the instances and area of each device and the
+  FIFOs crossing devices.
+  """
+  if num_devices < 1:
+    raise InputError('the number of devices must be positive')
+
+  vertices = {
+      name: properties
+      for name, properties in config['vertices'].items()
+      if properties['category'] in PARTITIONED_VERTICES
+  }
+  groups = _get_groups(vertices, config.get('grouping_constraints', []))
+  group_of = {v: g for g, members in enumerate(groups) for v in members}
+  area = [_sum_area(vertices[v]['area'] for v in members) for members in groups]
+
+  # bits between groups, in both directions
+  weights = collections.defaultdict(lambda: collections.defaultdict(int))
+  has_producer = set()
+  for properties in config['edges'].values():
+    if properties['category'] != 'FIFO_EDGE':
+      continue
+    src = group_of.get(properties['produced_by'])
+    dst = group_of.get(properties['consumed_by'])
+    if src is None or dst is None or src == dst:
+      continue
+    weights[src][dst] += properties['width']
+    weights[dst][src] += properties['width']
+    has_producer.add(dst)
+
+  budget = {k: v * max_usage for k, v in available_area.items()}
+  assignment = [None] * len(groups)
+  usage = [collections.defaultdict(float) for _ in range(num_devices)]
+
+  def assign(group: int, device: int) -> None:
+    if assignment[group] is not None:
+      for resource, amount in area[group].items():
+        usage[assignment[group]][resource] -= amount
+    assignment[group] = device
+    for resource, amount in area[group].items():
+      usage[device][resource] += amount
+
+  def fits(group: int, device: int) -> bool:
+    return all(
+        usage[device][resource] + amount <= budget.get(resource, float('inf'))
+        for resource, amount in area[group].items())
+
+  # pinned vertices
+  pinned = set()
+  for device, names in (pre_assignments or {}).items():
+    device = int(device)
+    if not 0 <= device < num_devices:
+      raise InputError(f'device {device} is not among the {num_devices} '
+                       'devices')
+    for name in names:
+      vertex = name if name in vertices else f'TASK_VERTEX_{name}'
+      if vertex not in vertices:
+        raise InputError(f'{name} is not a task instance')
+      group = group_of[vertex]
+      if group in pinned and assignment[group] != device:
+        raise InputError(f'{name} is pre-assigned to more than one device')
+      assign(group, device)
+      pinned.add(group)
+
+  # initial assignment by breadth-first traversal from the groups fed by no
+  # FIFO, so that devices hold consecutive stages in order
+  share = {
+      resource: amount / num_devices
+      for resource, amount in _sum_area(area).items()
+  }
+  device = 0
+  visited = set(pinned)
+  roots = sorted(range(len(groups)), key=lambda g: g in has_producer)
+  for root in roots:
+    queue = collections.deque([root] if root not in visited else [])
+    visited.add(root)
+    while queue:
+      group = queue.popleft()
+      while device + 1 < num_devices and any(
+          usage[device][resource] + amount > share.get(resource, 0) and
+          usage[device][resource] > 0
+          for resource, amount in area[group].items()):
+        device += 1
+      assign(group, device)
+      for neighbor in sorted(weights[group]):
+        if neighbor not in visited:
+          visited.add(neighbor)
+          queue.append(neighbor)
+
+  # refinement by moving single groups
+  for _ in range(REFINEMENT_ROUNDS):
+    is_moved = False
+    for group in range(len(groups)):
+      if group in pinned:
+        continue
+      gains = [0] * num_devices
+      for neighbor, width in weights[group].items():
+        gains[assignment[neighbor]] += width
+      current = assignment[group]
+      best = max(
+          (d for d in range(num_devices) if d != current and fits(group, d)),
+          key=lambda d: gains[d],
+          default=None,
+      )
+      if best is not None and gains[best] > gains[current]:
+        assign(group, best)
+        is_moved = True
+    if not is_moved:
+      break
+
+  for device in range(num_devices):
+    for resource, amount in usage[device].items():
+      if amount > budget.get(resource, float('inf')):
+        raise InputError(
+            f'device {device} uses {amount:.0f} {resource}, more than '
+            f'{max_usage:.0%} of {available_area[resource]}; use more devices')
+
+  device_of = {v: assignment[group_of[v]] for v in vertices}
+  return {
+      'num_devices': num_devices,
+      'link_latency': link_latency,
+      'devices': [{
+          'instances': sorted(
+              vertices[v]['instance']
+              for v, d in device_of.items()
+              if d == device),
+          'area': {k: round(v) for k, v in usage[device].items()},
+      } for device in range(num_devices)],
+      'links': _get_links(config, device_of, link_latency),
+  }
+
+
+def _get_groups(vertices: Dict[str, Dict],
+                grouping_constraints: List[List[str]]) -> List[List[str]]:
+  """Returns the vertices that must be on the same device."""
+  parent = {v: v for v in vertices}
+
+  def find(v: str) -> str:
+    while parent[v] != v:
+      parent[v] = parent[parent[v]]
+      v = parent[v]
+    return v
+
+  for constraint in grouping_constraints:
+    members = [v for v in constraint if v in parent]
+    for v in members[1:]:
+      parent[find(v)] = find(members[0])
+
+  groups = collections.defaultdict(list)
+  for v in sorted(vertices):
+    groups[find(v)].append(v)
+  return list(groups.values())
+
+
+def _sum_area(areas) -> Dict[str, float]:
+  total = collections.defaultdict(float)
+  for area in areas:
+    for resource, amount in area.items():
+      total[resource] += amount
+  return dict(total)
+
+
+def _get_links(config: Dict, device_of: Dict[str, int],
+               link_latency: int) -> List[Dict]:
+  """Returns the FIFOs crossing devices, with slices merged."""
+  links = {}
+  for properties in config['edges'].values():
+    if properties['category'] != 'FIFO_EDGE':
+      continue
+    src = device_of.get(properties['produced_by'])
+    dst = device_of.get(properties['consumed_by'])
+    if src is None or dst is None or src == dst:
+      continue
+    name = properties.get('slice_of', properties['instance'])
+    link = links.setdefault(name, {
+        'fifo': name,
+        'from': src,
+        'to': dst,
+        'width': 0,
+        'depth': properties['depth'],
+        'link_depth': max(properties['depth'], link_latency),
+    })
+    link['width'] += properties['width']
+  for link in links.values():
+    _logger.info('FIFO %s crosses from device %d to device %d: %d bits, '
+                 'depth %d', link['fifo'], link['from'], link['to'],
+                 link['width'], link['link_depth'])
+  return sorted(links.values(), key=lambda link: link['fifo'])
@@ -1,6 +1,8 @@
 import logging
 from typing import List
 
+from tapa import util
+
 from .task import Task
 
 DISABLED_MMAP_NAME_LIST = {
@@ -28,3 +30,54 @@ def check_mmap_arg_name(task_list: List[Task]) -> None:
         if port_name in DISABLED_MMAP_NAME_LIST:
           _logger.error('Task arguments cannot be among the reserved keywords: %s', DISABLED_MMAP_NAME_LIST)
           raise AssertionError
+
+
+def check_stream_rates(task_list: List[Task]) -> None:
+  """
+  Warn about FIFOs whose producer and consumer are estimated to transfer
+  tokens at different rates or counts, or whose depth cannot hold the tokens
+  transferred in one pipeline iteration. The estimates come from tapacc and are
+  available before running HLS.
+  """
+  for task in task_list:
+    for fifo_name, fifo in task.fifos.items():
+      producer = fifo.get('producer_rate')
+      consumer = fifo.get('consumer_rate')
+      if 'depth' not in fifo or producer is None or consumer is None:
+        continue
+
+      producer_rate = util.get_stream_rate(producer)
+      consumer_rate = util.get_stream_rate(consumer)
+      if (producer_rate is not None and consumer_rate is not None and
+          producer_rate != consumer_rate):
+        _logger.warning(
+            "fifo '%s' in task '%s' is produced at %s and consumed at %s "
+            'tokens per cycle; the slower side bounds the throughput',
+            fifo_name,
+            task.name,
+            producer_rate,
+            consumer_rate,
+        )
+
+      if (producer['tokens'] is not None and consumer['tokens'] is not None and
+          producer['tokens'] != consumer['tokens']):
+        _logger.warning(
+            "fifo '%s' in task '%s' is produced %d and consumed %d tokens "
+            'per invocation, which may deadlock',
+            fifo_name,
+            task.name,
+            producer['tokens'],
+            consumer['tokens'],
+        )
+
+      burst = max(port['tokens_per_iteration'] or 0
+                  for port in (producer, consumer))
+      if fifo['depth'] < burst:
+        _logger.warning(
+            "fifo '%s' in task '%s' has depth %d, less than the %d tokens "
+            'transferred per pipeline iteration',
+            fifo_name,
+            task.name,
+            fifo['depth'],
+            burst,
+        )
@@ -1,5 +1,6 @@
 #!/usr/bin/python3
 import argparse
+import hashlib
 import io
 import json
 import logging
@@ -59,6 +60,15 @@ def create_parser() -> argparse.ArgumentParser:
       dest='tapacc',
       help='Use a specific ``tapacc`` binary instead of searching in ``PATH``.',
   )
+  parser.add_argument(
+      '--precompile-header',
+      action='store_true',
+      dest='precompile_header',
+      help='Precompile ``tapa.h`` in the working directory and use it in '
+           '``tapacc``, so that the headers are parsed once instead of once '
+           'per source file. The header is precompiled again only if '
+           '``tapacc``, the flags, or the headers change.',
+  )
   parser.add_argument(
       '--work-dir',
       type=str,
@@ -66,6 +76,57 @@ def create_parser() -> argparse.ArgumentParser:
       dest='work_dir',
       help='Use a specific working directory instead of a temporary one.',
   )
+  parser.add_argument(
+      '--hls-cache-dir',
+      type=str,
+      metavar='dir',
+      dest='hls_cache_dir',
+      default=os.environ.get('TAPA_HLS_CACHE_DIR'),
+      help='Share HLS results in a directory, e.g., on a network file system, '
+           'across work directories and users. Tasks whose code, flags, '
+           'clock period, part number, and HLS version are unchanged reuse '
+           'the cached results. Defaults to ``$TAPA_HLS_CACHE_DIR``.',
+  )
+  parser.add_argument(
+      '--hls-jobs',
+      type=int,
+      metavar='N',
+      dest='hls_jobs',
+      help='Run at most N HLS jobs concurrently. Defaults to the number of '
+           'CPUs, limited by the available memory and ``--hls-mem-per-job``.',
+  )
+  parser.add_argument(
+      '--hls-mem-per-job',
+      type=float,
+      metavar='GiB',
+      dest='hls_mem_per_job',
+      default=8.,
+      help='Memory reserved for each HLS job if ``--hls-jobs`` is not set.',
+  )
+  parser.add_argument(
+      '--hls-batch-size',
+      type=int,
+      metavar='N',
+      dest='hls_batch_size',
+      default=1,
+      help='Synthesize up to N small tasks in one HLS session to amortize '
+           'the startup of the tool. Tasks whose HLS took more than a minute '
+           'last time are synthesized alone. Defaults to 1, i.e., no '
+           'batching.',
+  )
+  parser.add_argument(
+      '--autotune',
+      type=argparse.FileType('r'),
+      metavar='file',
+      dest='autotune',
+      help='Before running HLS, synthesize every combination of the '
+           'parameters in this JSON file and use the fastest variant of each '
+           'task that fits in ``--max-usage`` of the device. The file maps '
+           'task names to objects that map macro names, or ``clock_period`` '
+           'for the HLS target clock period, to lists of values, e.g., '
+           '``{"PE": {"UNROLL": [2, 4, 8]}}``. The choices are saved in '
+           '``autotune.json`` in the work directory and reused by later runs.',
+  )
   parser.add_argument(
       '--top',
       type=str,
@@ -79,6 +140,19 @@ def create_parser() -> argparse.ArgumentParser:
       dest='clock_period',
       help='Target clock period in nanoseconds.',
   )
+  parser.add_argument(
+      '--task-clock-period',
+      type=_parse_task_clock_period,
+      action='append',
+      default=[],
+      metavar='TASK_NAME=PERIOD',
+      dest='task_clock_periods',
+      help='Run a lower-level task on a secondary clock (``ap_clk_2``) with '
+           'the given period in nanoseconds. Streams between the two clock '
+           'domains use asynchronous FIFOs. Tasks on the secondary clock '
+           'cannot access memory. Can be specified multiple times, but with '
+           'at most one period other than ``--clock-period``.',
+  )
   parser.add_argument(
       '--part-num',
       type=str,
@@ -113,6 +187,25 @@ def create_parser() -> argparse.ArgumentParser:
       metavar='file',
       help='Output FRT interface file (deprecated).',
   )
+  parser.add_argument(
+      '--verilator',
+      type=str,
+      dest='verilator',
+      metavar='file',
+      help='Output RTL simulator of the generated RTL built with Verilator. '
+           'The file name must end with ``.verilator``. Passing it to '
+           '``tapa::invoke`` as the bitstream runs RTL simulation, in which '
+           'mmaps are backed by host memory and host streams are not '
+           'supported.',
+  )
+  parser.add_argument(
+      '--verilator-threads',
+      type=int,
+      dest='verilator_threads',
+      metavar='INT',
+      default=1,
+      help='Number of threads of the Verilator RTL simulation.',
+  )
   parser.add_argument(
       type=str,
       dest='input_file',
@@ -174,6 +267,55 @@ def create_parser() -> argparse.ArgumentParser:
       help=('Input ``connectivity.ini`` specification for mmaps. '
             'This is the same file passed to ``v++``.'),
   )
+  group.add_argument(
+      '--auto-connectivity',
+      type=argparse.FileType('w'),
+      dest='auto_connectivity',
+      metavar='file',
+      help=('Output ``connectivity.ini`` for ``v++`` that binds the mmaps '
+            'missing from ``--connectivity`` to the HBM or DDR channels of '
+            'the platform, balancing their estimated traffic. The result is '
+            'also used for floorplanning.'),
+  )
+  group.add_argument(
+      '--compute-units',
+      type=int,
+      dest='compute_units',
+      metavar='INT',
+      default=1,
+      help=('Number of compute units of the top-level task that ``v++`` '
+            'instantiates, as specified in the output of '
+            '``--auto-connectivity``. The mmaps of each compute unit are '
+            'bound in turn, and ``tapa::dispatcher`` runs concurrent '
+            'invocations on different compute units. Floorplanning applies '
+            'to a single compute unit, so this cannot be used with '
+            '``--constraint``.'),
+  )
+  group.add_argument(
+      '--host-mmap',
+      action='append',
+      default=[],
+      dest='host_mmaps',
+      metavar='ARG',
+      help=('Bind mmap argument ARG of the top-level task to host memory in '
+            'the output of ``--auto-connectivity`` unless ``--connectivity`` '
+            'binds it. The kernel accesses it over PCIe via the slave bridge '
+            'of the platform, and the host passes it as ``tapa::host_mmap``, '
+            'which is not copied. May be specified multiple times.'),
+  )
+  group.add_argument(
+      '--stream-connect',
+      action='append',
+      default=[],
+      dest='stream_connects',
+      metavar='ARG:KERNEL.PORT[:DEPTH]',
+      help=('Connect stream argument ARG of the top-level task to AXI stream '
+            'port PORT of compute unit KERNEL of another kernel in the output '
+            'of ``--auto-connectivity``, optionally via a FIFO of DEPTH. The '
+            'host passes ``tapa::kernel_stream`` for ARG and invokes both '
+            'kernels via ``tapa::kernel_graph``. May be specified multiple '
+            'times.'),
+  )
   group.add_argument(
       '--constraint',
       type=argparse.FileType('w'),
@@ -197,6 +339,26 @@ def create_parser() -> argparse.ArgumentParser:
       help=('Use a specific floorplan usage threshold instead of using the '
             'conservative default in AutoBridge.'),
   )
+  group.add_argument(
+      '--max-fifo-slice-width',
+      type=int,
+      dest='max_fifo_slice_width',
+      metavar='BITS',
+      default=0,
+      help=('Split FIFOs wider than BITS into slices of at most BITS bits, '
+            'which are floorplanned and pipelined as separate FIFOs and move '
+            'in lock step, so that a wide FIFO may cross an SLR on several '
+            'columns of Laguna sites. Disabled by default.'),
+  )
+  group.add_argument(
+      '--balance-fifo-memory',
+      dest='balance_fifo_memory',
+      action='store_true',
+      help=('Choose SRL, LUTRAM, BRAM, or URAM for each FIFO whose stream type '
+            'does not choose one jointly with the floorplan, moving FIFOs '
+            'between memories until each region fits in ``--max-usage``. '
+            'The floorplan is solved again after FIFOs move.'),
+  )
   group.add_argument(
       '--enable-synth-util',
       dest='enable_synth_util',
@@ -229,6 +391,116 @@ def create_parser() -> argparse.ArgumentParser:
            'The key is the region name, the value is a list of modules.'
            'Replace the outdated --directive option.'
   )
+  group.add_argument(
+      '--num-devices',
+      type=int,
+      dest='num_devices',
+      metavar='INT',
+      default=1,
+      help='Partition the task instances among this many devices, e.g., for '
+           'designs that do not fit in one device. FIFOs crossing devices '
+           'are cut with as few bits as possible while each device fits in '
+           '``--max-usage``. The partition is written to '
+           '``device-partition.json`` in the work directory, with the depth '
+           'of each crossing FIFO raised to cover the round trip of its link.',
+  )
+  group.add_argument(
+      '--device-pre-assignments',
+      type=argparse.FileType('r'),
+      dest='device_pre_assignments',
+      metavar='file',
+      help='JSON file of type Dict[str, List[str]] mapping device indices to '
+           'the task instances pinned to them for ``--num-devices``.',
+  )
+  group.add_argument(
+      '--device-link-latency',
+      type=int,
+      dest='device_link_latency',
+      metavar='CYCLES',
+      default=256,
+      help='Round-trip latency of the links between devices in kernel '
+           'cycles for ``--num-devices``; FIFOs crossing devices are at least '
+           'this deep to sustain one token per cycle under credit-based flow '
+           'control.',
+  )
+  group.add_argument(
+      '--reconfigurable-instance',
+      type=str,
+      action='append',
+      dest='reconfigurable_instances',
+      metavar='INSTANCE',
+      default=[],
+      help='Make top-level task instance INSTANCE, e.g., ``Compute_0``, a '
+           'DFX reconfigurable partition in the ``--constraint`` output. '
+           'Its floorplan region becomes the pblock of the partition, so no '
+           'other instance may be placed there. Its ports, which connect to '
+           'static FIFOs and AXI pipelines, are recorded in '
+           '``reconfigurable-partitions.json`` in the work directory; each '
+           'module loaded into the partition must have the same ports. '
+           'May be specified multiple times.',
+  )
+  group.add_argument(
+      '--refine-from-timing',
+      type=argparse.FileType('r'),
+      dest='refine_from_timing',
+      metavar='file',
+      help='Vivado ``report_timing`` text report of the previous '
+           'implementation. Its violating paths are mapped back to the FIFO '
+           'and AXI edges of the previous floorplan in the work directory, '
+           'which are weighed more and pipelined deeper in this run. '
+           'Refinements accumulate across runs in ``timing-refinement.json``.',
+  )
+  group.add_argument(
+      '--floorplan-warm-start',
+      type=argparse.FileType('r'),
+      dest='floorplan_warm_start',
+      metavar='file',
+      help='``post-floorplan-config.json`` of a previous floorplan. Vertices '
+           'whose area and edges are unchanged are pinned to their previous '
+           'regions and only the rest are placed again, which is faster and '
+           'keeps the floorplan stable. Falls back to solving from scratch '
+           'if the pinned vertices make floorplanning infeasible.',
+  )
+  group.add_argument(
+      '--explore-implementation',
+      type=argparse.FileType('r'),
+      dest='explore_implementation',
+      metavar='file',
+      help='Place and route ``--implementation-checkpoint`` with every '
+           'combination of the constraint files and directives in this JSON '
+           'file concurrently, and report the variant with the best WNS. The '
+           'file has optional lists ``constraint`` (defaults to the '
+           '``--constraint`` written in the same run), ``place_directive``, '
+           'and ``route_directive``. '
+           'Results are saved in ``implementation.json`` in the work '
+           'directory.',
+  )
+  group.add_argument(
+      '--implementation-checkpoint',
+      type=str,
+      dest='implementation_checkpoint',
+      metavar='file',
+      help='Vivado checkpoint for ``--explore-implementation``, e.g., '
+           '``before_add_floorplan_constraints.dcp`` of a ``v++`` run.',
+  )
+  group.add_argument(
+      '--implementation-jobs',
+      type=int,
+      dest='implementation_jobs',
+      metavar='INT',
+      help='Maximum number of concurrent Vivado jobs of '
+           '``--explore-implementation``; defaults to the number of CPUs, '
+           'further limited by the available memory.',
+  )
+  group.add_argument(
+      '--implementation-mem-per-job',
+      type=float,
+      dest='implementation_mem_per_job',
+      metavar='GiB',
+      default=32.,
+      help='Memory reserved for each Vivado job if '
+           '``--implementation-jobs`` is not set.',
+  )
 
   strategies = parser.add_argument_group(
       title='Strategy',
@@ -241,6 +513,158 @@ def create_parser() -> argparse.ArgumentParser:
       action='store_true',
       help='Pipelining a FIFO whose source and destination are in the same region'
   )
+  strategies.add_argument(
+      '--almost-full-fifo',
+      dest='almost_full_fifo',
+      action='store_true',
+      help='Implement every FIFO with a registered full_n that is deasserted '
+           'as many tokens early as the FIFO pipeline holds, so that stream '
+           'handshakes never form combinational paths. This costs a few '
+           'extra FIFO slots.'
+  )
+  strategies.add_argument(
+      '--enable-perf-counters',
+      dest='perf_counters',
+      action='store_true',
+      help='Count the full, empty, and active cycles of each top-level FIFO '
+           'and the beats and outstanding requests of each AXI interface '
+           'while the kernel runs. The 64-bit counters are read from the '
+           'control interface, e.g., with xrt::kernel::read_register, at the '
+           'offsets listed in perf_counters.json in the work directory.'
+  )
+  strategies.add_argument(
+      '--ap-ctrl-chain',
+      dest='ap_ctrl_chain',
+      action='store_true',
+      help='Control the top-level task with ap_ctrl_chain instead of '
+           'ap_ctrl_hs. The next invocation is accepted as soon as every '
+           'task has started the current one, so that back-to-back '
+           'invocations, e.g., tapa::device::invoke_async on different slots, '
+           'overlap on the device; each invocation is done in order once '
+           'every task has finished it.'
+  )
+  strategies.add_argument(
+      '--enable-loop-counters',
+      dest='loop_counters',
+      action='store_true',
+      help='Count the iterations of each pipelined loop in lower-level tasks, '
+           'and the cycles in which the loop runs but issues no iteration. '
+           'The counters are read as those of --enable-perf-counters, which '
+           'must also be set for them to be instantiated.'
+  )
+  strategies.add_argument(
+      '--nonblocking-reads',
+      dest='nonblocking_reads',
+      action='store_true',
+      help='Rewrite each pipelined loop that reads several streams with '
+           'blocking reads at the beginning of its body, so that each stream '
+           'is read via try_read into a skid register as soon as it has data, '
+           'and the loop body runs once all registers are filled. Without '
+           'this, tapacc only warns about such loops.'
+  )
+  strategies.add_argument(
+      '--replicate',
+      dest='replicate',
+      metavar='TASK:N',
+      action='append',
+      default=[],
+      help='Replicate each instance of a lower-level task N times, with '
+           'round-robin scatter and gather tasks. The task must have exactly '
+           'one istream and one ostream, and produce one output token per '
+           'input token until EoT. May be specified multiple times.'
+  )
+  strategies.add_argument(
+      '--flatten',
+      dest='flatten',
+      action='store_true',
+      help='Inline upper-level tasks into their parents, so that each level of '
+           'a deep hierarchy does not cost a module with its own FSM and '
+           'handshake. Upper-level tasks whose children run in multiple '
+           'steps are kept.'
+  )
+  strategies.add_argument(
+      '--fuse-tasks',
+      dest='fuse_tasks',
+      action='store_true',
+      help='Fuse chains of lower-level tasks connected by FIFOs into one '
+           'dataflow task each, which saves a module, its handshake, and the '
+           'FIFOs in between for each task.'
+  )
+  strategies.add_argument(
+      '--specialize',
+      dest='specialize',
+      action='store_true',
+      help='Generate a distinct module for each lower-level task instance '
+           'with constant scalar arguments, e.g., tapa::seq, so that the '
+           'constants are propagated into the instance instead of being '
+           'passed as ports.'
+  )
+  strategies.add_argument(
+      '--specialize-scalar',
+      dest='specialize_scalar',
+      metavar='ARG=VALUE',
+      action='append',
+      default=[],
+      help='Bind a scalar argument of the top-level task to a constant, so '
+           'that HLS optimizes each lower-level task for it, e.g., removes '
+           'branches on flags that are never set. The argument is removed '
+           'from the kernel interface and the control registers; pass it as '
+           'tapa::specialized on the host so that it is not set. Implies '
+           '--specialize. May be specified multiple times.'
+  )
+  strategies.add_argument(
+      '--auto-fifo-depth',
+      dest='auto_fifo_depth',
+      action='store_true',
+      help='Infer the depth of each FIFO declared without one, so that it is '
+           'deep enough for reconvergent paths with different latencies. '
+           'Latencies are estimated by HLS.'
+  )
+  strategies.add_argument(
+      '--async-mmap-id-width',
+      dest='async_mmap_id_width',
+      type=int,
+      metavar='N',
+      default=1,
+      help='Issue the read bursts of each async_mmap on 2**N AXI IDs, so that '
+           'the memory system may serve them out of order. Default: 1.'
+  )
+  strategies.add_argument(
+      '--async-mmap-max-outstanding',
+      dest='async_mmap_max_outstanding',
+      type=int,
+      metavar='N',
+      default=64,
+      help='Maximum number of read bursts in flight for each async_mmap, '
+           'rounded up to a power of 2. Responses are reordered in a buffer '
+           'of as many elements, which bounds the elements in flight as well. '
+           'Increase it to saturate high-latency memory such as HBM with short '
+           'bursts. Default: 64.'
+  )
+  strategies.add_argument(
+      '--async-mmap-write-combine-window',
+      dest='async_mmap_write_combine_window',
+      type=int,
+      metavar='N',
+      default=0,
+      help='Combine the writes of each async_mmap to the same burst-sized '
+           'line that arrive less than N cycles apart into one burst, with '
+           'byte strobes masking the elements not written. This helps '
+           'scattered small writes that would otherwise be issued as '
+           'single-beat bursts. Default: 0 (disabled).'
+  )
+  strategies.add_argument(
+      '--async-mmap-bus-width',
+      dest='async_mmap_bus_width',
+      type=int,
+      metavar='BITS',
+      default=0,
+      help='Widen the AXI data path of each mmap accessed only as async_mmap '
+           'to BITS bits, which must be a power of 2. Narrower elements are '
+           'lanes of a bus word; reads of the same bus word share one bus '
+           'read, and consecutive writes to the same bus word are packed into '
+           'one bus write with byte strobes. Default: 0 (element width).'
+  )
   strategies.add_argument(
       '--reuse-hbm-path-pipelining',
       dest='reuse_hbm_path_pipelining',
@@ -277,9 +701,16 @@ def create_parser() -> argparse.ArgumentParser:
       dest='floorplan_opt_priority',
       type=str,
       default='AREA_PRIORITIZED',
-      choices=['AREA_PRIORITIZED', 'SLR_CROSSING_PRIORITIZED'],
+      choices=[
+          'AREA_PRIORITIZED',
+          'SLR_CROSSING_PRIORITIZED',
+          'THROUGHPUT_PRIORITIZED',
+      ],
       help='AREA_PRIORITIZED: give priority to the area usage ratio of each slot. '
            'SLR_CROSSING_PRIORITIZED: give priority to the number of SLR crossing wires. '
+           'THROUGHPUT_PRIORITIZED: like SLR_CROSSING_PRIORITIZED, but weight '
+           'each FIFO by its traffic estimated by tapacc, so that busy FIFOs '
+           'are kept within an SLR. '
   )
   return parser
 
@@ -290,8 +721,11 @@ def parse_steps(args, parser) -> Tuple[bool, str]:
   manual_step_args = ('run_tapacc', 'run_hls', 'generate_task_rtl',
               'run_floorplanning', 'generate_top_rtl', 'pack_xo')
 
-  if any(getattr(args, arg) for arg in manual_step_args):
+  # exploring implementation alone reuses the work directory of previous runs
+  if (any(getattr(args, arg) for arg in manual_step_args) or
+      args.explore_implementation is not None):
     all_steps = False
+    last_step = None
     for idx, arg in enumerate(manual_step_args):
       if getattr(args, arg):
         last_step = arg
@@ -359,6 +793,26 @@ def main(argv: Optional[List[str]] = None):
         '..',
         'src',
     )
+    for replicate in args.replicate:
+      tapacc_cmd.append(f'-replicate={replicate}')
+    if args.flatten:
+      tapacc_cmd.append('-flatten')
+    if args.fuse_tasks:
+      tapacc_cmd.append('-fuse-tasks')
+    if args.specialize:
+      tapacc_cmd.append('-specialize')
+    for specialize_scalar in args.specialize_scalar:
+      tapacc_cmd.append(f'-specialize-scalar={specialize_scalar}')
+    if args.loop_counters:
+      tapacc_cmd.append('-loop-counters')
+    if args.nonblocking_reads:
+      tapacc_cmd.append('-nonblocking-reads')
+    if args.ap_ctrl_chain:
+      tapacc_cmd.append('-ap-ctrl-chain')
+    if args.work_dir is not None:
+      # keep the code of each task out of program.json
+      code_dir = os.path.abspath(os.path.join(args.work_dir, 'code'))
+      tapacc_cmd.append(f'-code-dir={code_dir}')
     tapacc_cmd += '-top', args.top, '--', '-I', tapa_include_dir
 
     # find clang include location
@@ -387,6 +841,17 @@ def main(argv: Optional[List[str]] = None):
 
     tapacc_cmd += cflag_list
 
+    if args.precompile_header:
+      if args.work_dir is None:
+        parser.error('--precompile-header requires --work-dir')
+      tapacc_cmd += _precompile_header(
+          tapacc,
+          tapacc_version,
+          tapa_include_dir,
+          tapacc_cmd[tapacc_cmd.index('--') + 1:],
+          args.work_dir,
+      )
+
     proc = subprocess.run(tapacc_cmd,
                           stdout=subprocess.PIPE,
                           universal_newlines=True,
@@ -458,15 +923,83 @@ def main(argv: Optional[List[str]] = None):
       output_fp.write(program.frt_interface)
 
   if all_steps or args.run_hls is not None:
-    program.run_hls(**_get_device_info(parser, args))
+    if args.autotune is not None:
+      program.autotune_hls(
+          args.autotune,
+          **_get_device_info(parser, args),
+          max_usage=args.max_usage,
+          jobs=args.hls_jobs,
+          mem_per_job=args.hls_mem_per_job,
+      )
+    program.run_hls(
+        **_get_device_info(parser, args),
+        cache_dir=args.hls_cache_dir,
+        jobs=args.hls_jobs,
+        mem_per_job=args.hls_mem_per_job,
+        task_clock_periods=dict(args.task_clock_periods),
+        parse_rtl=all_steps or args.generate_task_rtl is not None,
+        hls_batch_size=args.hls_batch_size,
+    )
 
   if all_steps or args.generate_task_rtl is not None:
     program.generate_task_rtl(
       args.additional_fifo_pipelining,
       _get_device_info(parser, args)['part_num'],
+      args.auto_fifo_depth,
+      args.async_mmap_id_width,
+      args.async_mmap_max_outstanding,
+      args.async_mmap_write_combine_window,
+      args.almost_full_fifo,
+      args.async_mmap_bus_width,
     )
 
   if all_steps or args.run_floorplanning is not None:
+    if args.compute_units < 1:
+      parser.error('--compute-units must be positive')
+    if args.compute_units > 1:
+      if args.auto_connectivity is None:
+        parser.error('--compute-units requires --auto-connectivity')
+      if args.constraint is not None:
+        parser.error('--compute-units cannot be used with --constraint')
+    if args.host_mmaps and args.auto_connectivity is None:
+      parser.error('--host-mmap requires --auto-connectivity')
+    if args.stream_connects:
+      if args.auto_connectivity is None:
+        parser.error('--stream-connect requires --auto-connectivity')
+      if args.compute_units > 1:
+        parser.error('--stream-connect cannot be used with --compute-units')
+
+    connectivity = args.connectivity
+    if args.auto_connectivity is not None:
+      connectivity_ini = program.generate_connectivity(
+          _get_device_info(parser, args)['part_num'],
+          args.connectivity,
+          args.compute_units,
+          args.host_mmaps,
+          args.stream_connects,
+      )
+      args.auto_connectivity.write(connectivity_ini)
+      args.auto_connectivity.flush()
+      connectivity = io.StringIO(connectivity_ini)
+
+    if args.num_devices < 1:
+      parser.error('--num-devices must be positive')
+    if args.num_devices > 1:
+      if connectivity is None:
+        parser.error('--num-devices requires --connectivity or '
+                     '--auto-connectivity')
+      if args.constraint is not None:
+        parser.error('--num-devices cannot be used with --constraint')
+      program.partition_devices(
+          _get_device_info(parser, args)['part_num'],
+          connectivity,
+          args.num_devices,
+          args.device_pre_assignments,
+          args.device_link_latency,
+          args.max_usage,
+      )
+      connectivity.seek(0)
+
     if args.constraint is not None:
       kwargs = {}
       if args.max_usage is not None:
@@ -480,13 +1013,19 @@ def main(argv: Optional[List[str]] = None):
 
       program.run_floorplanning(
         _get_device_info(parser, args)['part_num'],
-        args.connectivity,
+        connectivity,
         args.enable_synth_util,
         args.floorplan_pre_assignments,
+        args.refine_from_timing,
+        args.floorplan_warm_start,
+        args.max_fifo_slice_width,
+        args.balance_fifo_memory,
         **kwargs,
       )
 
   if all_steps or args.generate_top_rtl is not None:
+    if args.reconfigurable_instances and args.constraint is None:
+      parser.error('--reconfigurable-instance requires --constraint')
     program.generate_top_rtl(
         args.constraint,
         args.register_level or 0,
@@ -494,12 +1033,89 @@ def main(argv: Optional[List[str]] = None):
         _get_device_info(parser, args)['part_num'],
         args.reuse_hbm_path_pipelining,
         args.manual_vivado_flow,
+        args.almost_full_fifo,
+        args.async_mmap_bus_width,
+        args.perf_counters,
+        args.reconfigurable_instances,
     )
 
   if all_steps or args.pack_xo is not None:
     with open(args.output_file, 'wb') as packed_obj:
       program.pack_rtl(packed_obj)
 
+  if args.verilator is not None:
+    program.generate_verilator_sim(args.verilator, args.verilator_threads)
+
+  if args.explore_implementation is not None:
+    if args.implementation_checkpoint is None:
+      parser.error('--explore-implementation requires '
+                   '--implementation-checkpoint')
+    if args.constraint is not None:
+      args.constraint.close()
+    program.explore_implementation(
+        args.explore_implementation,
+        args.implementation_checkpoint,
+        args.constraint.name if args.constraint is not None else None,
+        args.implementation_jobs,
+        args.implementation_mem_per_job,
+    )
+
+
+def _precompile_header(
+    tapacc: str,
+    tapacc_version: str,
+    tapa_include_dir: str,
+    flags: List[str],
+    work_dir: str,
+) -> List[str]:
+  """Precompiles ``tapa.h`` with `flags` and returns the flags that use it.
+
+  Returns no flags if the header cannot be precompiled, in which case it is
+  parsed as usual.
+  """
+  header = os.path.join(tapa_include_dir, 'tapa.h')
+  pch = os.path.join(work_dir, 'tapa.h.pch')
+  digest = hashlib.sha256()
+  for item in (tapacc, tapacc_version, *flags):
+    digest.update(item.encode() + b'\0')
+  headers = [header]
+  for root, _, files in os.walk(os.path.join(tapa_include_dir, 'tapa')):
+    headers += (os.path.join(root, x) for x in files if x.endswith('.h'))
+  for path in sorted(headers):
+    with open(path, 'rb') as header_fp:
+      digest.update(header_fp.read())
+  hexdigest = digest.hexdigest()
+
+  try:
+    with open(pch + '.hash') as hash_fp:
+      is_up_to_date = hash_fp.read() == hexdigest and os.path.isfile(pch)
+  except FileNotFoundError:
+    is_up_to_date = False
+  if not is_up_to_date:
+    _logger.info('precompiling %s', header)
+    os.makedirs(work_dir, exist_ok=True)
+    if subprocess.run([tapacc, f'-emit-pch={pch}', header, '--', *flags],
+                      check=False).returncode != 0:
+      _logger.warning('cannot precompile %s; parsing it as usual', header)
+      return []
+    with open(pch + '.hash', 'w') as hash_fp:
+      hash_fp.write(hexdigest)
+
+  # Headers in the precompiled header are not part of the hash of each task,
+  # so their digest is.
+  return ['-include-pch', pch, f'-DTAPA_PCH_DIGEST={hexdigest[:16]}']
+
+
+def _parse_task_clock_period(arg: str) -> Tuple[str, str]:
+  name, sep, period = arg.partition('=')
+  if not sep or not name:
+    raise argparse.ArgumentTypeError(f'expected TASK_NAME=PERIOD: {arg}')
+  try:
+    float(period)
+  except ValueError:
+    raise argparse.ArgumentTypeError(f'invalid clock period: {period}')
+  return name, period
+
 
 def _get_device_info(
     parser: argparse.ArgumentParser,
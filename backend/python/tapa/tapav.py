@@ -1,38 +1,233 @@
 #!/usr/bin/python3
 import argparse
 import collections
+import html
+import io
+import json
+import os.path
+import re
+import subprocess
 import sys
-from typing import Dict, Set
+import xml.etree.ElementTree as ET
+from typing import Any, Dict, List, Optional, Set, TextIO, Tuple
 
 import tapa.core
+from tapa import floorplan, util
+from tapa.verilog import xilinx as rtl
 
+# Matches the stream statistics logged with `TAPA_STREAM_STATS` set.
+STREAM_STATS_RE = re.compile(
+    r"'(?P<name>[^']*)' \(depth (?P<depth>\d+)\): pushes=(?P<pushes>\d+) "
+    r'pops=(?P<pops>\d+) full_stalls=(?P<full_stalls>\d+) '
+    r'empty_stalls=(?P<empty_stalls>\d+) occupancy=(?P<occupancy>[\d.e+-]+)')
 
-def main():
-  parser = argparse.ArgumentParser(
-      prog='tapav', description='TAPA Visualizer')
-  parser.add_argument(dest='program',
-                      help='input ‘program.json’, default to stdin',
-                      nargs='?',
-                      type=argparse.FileType('r'),
-                      default=sys.stdin)
-  parser.add_argument('-o',
-                      '--output',
-                      dest='output',
-                      help='output graphviz file, default to stdout',
-                      type=argparse.FileType('w'),
-                      default=sys.stdout)
-  args = parser.parse_args()
 
+def parse_stream_stats(log: TextIO) -> Dict[str, Dict[str, float]]:
+  """Parses the stream statistics in a software simulation log.
+
+  Returns:
+    Dict mapping stream names to their statistics. Streams logged more than
+    once, e.g., in multiple invocations, are accumulated.
+  """
+  stats: Dict[str, Dict[str, float]] = {}
+  for line in log:
+    match = STREAM_STATS_RE.search(line)
+    if match is None:
+      continue
+    entry = stats.setdefault(match['name'], collections.Counter())
+    for key in 'pushes', 'pops', 'full_stalls', 'empty_stalls':
+      entry[key] += int(match[key])
+    entry['depth'] = int(match['depth'])
+    entry['occupancy'] = max(entry['occupancy'], float(match['occupancy']))
+  return stats
+
+
+def analyze_performance(
+    program: tapa.core.Program,
+    stream_stats: Optional[Dict[str, Dict[str, float]]] = None,
+) -> Tuple[List[Dict[str, Any]], Dict[str, Dict[str, Any]]]:
+  """Ranks the task instances of `program` by how likely they bottleneck it.
+
+  Each instance is scored by up to three components normalized to [0, 1]:
+  its HLS worst-case latency, its HLS II (or the II inferred by tapacc), and
+  the stalls blamed on it in software simulation, i.e., the empty stalls of
+  the FIFOs it produces and the full stalls of the FIFOs it consumes. The
+  score is the mean of the available components.
+
+  Each instance also gets its HLS area utilization, i.e., the largest ratio
+  of any resource to that available, and its stall fraction in simulation,
+  i.e., its stalls over its stalls and the tokens it produces or consumes.
+
+  Returns:
+    The instances sorted by descending score, and a dict mapping FIFO names
+    to their depth, width seen by the floorplanner, floorplan pipeline level,
+    regions, traffic, simulation statistics, and findings.
+  """
+  stream_stats = stream_stats or {}
+  work_dir = program.work_dir
+
+  fifo_pipeline_level: Dict[str, int] = {}
+  floorplan_region: Dict[str, str] = {}
+  fifo_width: Dict[str, int] = collections.Counter()
+  config_path = os.path.join(work_dir, 'post-floorplan-config.json')
+  if os.path.exists(config_path):
+    with open(config_path) as fp:
+      config_with_floorplan = json.load(fp)
+    fifo_pipeline_level, _ = floorplan.extract_pipeline_level(
+        config_with_floorplan, floorplan.load_timing_refinement(work_dir))
+    floorplan_region = floorplan.extract_floorplan_region(config_with_floorplan)
+    # slices of a FIFO are separate edges; see `get_fifo_edges`
+    for properties in config_with_floorplan['edges'].values():
+      if properties['category'] == 'FIFO_EDGE':
+        name = properties.get('slice_of', properties['instance'])
+        fifo_width[name] += properties['width']
+        level = fifo_pipeline_level.pop(properties['instance'], None)
+        if level is not None:
+          fifo_pipeline_level[name] = max(level,
+                                          fifo_pipeline_level.get(name, 0))
+
+  instances: Dict[Tuple[str, int], Dict[str, Any]] = {}
+  fifos: Dict[str, Dict[str, Any]] = collections.OrderedDict()
+
+  def get_instance(name: str, instance_id: int) -> Dict[str, Any]:
+    key = (name, int(instance_id))
+    instance = instances.get(key)
+    if instance is None:
+      task = program.get_task(name)
+      report = os.path.join(work_dir, 'report', f'{name}_csynth.xml')
+      metrics = {}
+      if os.path.exists(report):
+        metrics = tapa.core.get_hls_report_metrics(ET.parse(report))
+      utilization = None
+      if metrics:
+        utilization = max(
+            (metrics['area'].get(k, 0) / v
+             for k, v in metrics['available'].items()
+             if v),
+            default=None,
+        )
+      instance_name = util.get_instance_name(key)
+      instances[key] = instance = {
+          'name': instance_name,
+          'task': name,
+          'id': key[1],
+          'latency': metrics.get('latency'),
+          'ii': metrics.get('ii') or task.ii,
+          'region': floorplan_region.get(instance_name),
+          'utilization': utilization,
+          'stalls': 0,
+          'tokens': 0,
+          'findings': [],
+      }
+    return instance
+
+  for task in program.tasks:
+    if not task.is_upper:
+      continue
+    for fifo_name, fifo_attr in task.fifos.items():
+      if 'produced_by' not in fifo_attr or 'consumed_by' not in fifo_attr:
+        continue
+      producer = get_instance(*fifo_attr['produced_by'])
+      consumer = get_instance(*fifo_attr['consumed_by'])
+      sanitized_name = rtl.sanitize_array_name(fifo_name)
+      depth = fifo_attr['depth']
+      level = fifo_pipeline_level.get(sanitized_name)
+      stats = stream_stats.get(fifo_name, stream_stats.get(sanitized_name))
+      findings = []
+      if level is not None and depth < 2 * level:
+        findings.append(f'depth {depth} < 2 * pipeline level {level}')
+      if stats is not None:
+        producer['stalls'] += stats['empty_stalls']
+        consumer['stalls'] += stats['full_stalls']
+        producer['tokens'] += stats['pushes']
+        consumer['tokens'] += stats['pops']
+        if stats['full_stalls'] and stats['occupancy'] >= 0.9 * depth:
+          findings.append(f'often full ({stats["full_stalls"]} full stalls)')
+      width = fifo_width.get(sanitized_name)
+      traffic = None
+      if stats is not None:
+        traffic = stats['pushes'] * (width or 1)
+      elif width is not None:
+        traffic = width
+      fifos[fifo_name] = {
+          'depth': depth,
+          'width': width,
+          'pipeline_level': level,
+          'producer': producer['name'],
+          'consumer': consumer['name'],
+          'regions': (producer['region'], consumer['region']),
+          'traffic': traffic,
+          'stats': dict(stats) if stats is not None else None,
+          'findings': findings,
+      }
+
+  ranking = list(instances.values())
+  for key in 'latency', 'ii', 'stalls':
+    max_value = max((x[key] or 0 for x in ranking), default=0)
+    for instance in ranking:
+      if max_value and instance[key] is not None:
+        instance.setdefault('components', {})[key] = instance[key] / max_value
+  for instance in ranking:
+    instance['stall_fraction'] = (
+        instance['stalls'] / (instance['stalls'] + instance['tokens'])
+        if instance['stalls'] else 0.)
+    components = instance.setdefault('components', {})
+    instance['score'] = (sum(components.values()) /
+                         len(components) if components else 0.)
+    if instance['ii'] is not None and instance['ii'] > 1:
+      instance['findings'].append(f'II = {instance["ii"]}')
+    if instance['latency'] is None:
+      instance['findings'].append('latency unknown')
+  ranking.sort(key=lambda x: x['score'], reverse=True)
+  return ranking, fifos
+
+
+def write_report(output: TextIO, ranking: List[Dict[str, Any]],
+                 fifos: Dict[str, Dict[str, Any]]) -> None:
+  output.write('Predicted bottlenecks (most likely first):\n')
+  output.write(f'{"rank":>4}  {"score":>5}  {"latency":>10}  {"II":>4}  '
+               f'{"stalls":>10}  {"region":<20}  instance\n')
+  for rank, instance in enumerate(ranking, 1):
+    latency = instance['latency'] if instance['latency'] is not None else '-'
+    ii = instance['ii'] if instance['ii'] is not None else '-'
+    findings = '; '.join(instance['findings'])
+    output.write(f'{rank:>4}  {instance["score"]:>5.3f}  {latency:>10}  '
+                 f'{ii:>4}  {instance["stalls"]:>10}  '
+                 f'{instance["region"] or "-":<20}  {instance["name"]}'
+                 f'{"  (" + findings + ")" if findings else ""}\n')
+  flagged = {k: v for k, v in fifos.items() if v['findings']}
+  if flagged:
+    output.write('\nFIFOs that may limit throughput:\n')
+    for name, fifo in flagged.items():
+      output.write(f'  {name} ({fifo["producer"]} -> {fifo["consumer"]}): '
+                   f'{"; ".join(fifo["findings"])}\n')
+
+
+def write_graph(
+    output: TextIO,
+    program: tapa.core.Program,
+    ranking: List[Dict[str, Any]],
+    fifos: Dict[str, Dict[str, Any]],
+    color_by: str = 'score',
+) -> None:
+  """Writes the task graph of `program` in Graphviz.
+
+  If the performance analysis is available, instances are colored from white
+  to red by `color_by`, which is one of 'score', 'stalls' for the stall
+  fraction, and 'utilization' for the HLS area utilization. FIFOs are as
+  thick as their traffic relative to the busiest FIFO, and dashed if their
+  producer and consumer are in different floorplan regions. The details are
+  in the tooltips, which are shown by SVG viewers.
+  """
   task_fmt = '"{name}#{id}"'
   font = 'Arial'
-  program = tapa.core.Program(args.program)
-  output = args.output
   output.write(f'digraph "{program.top}" {{\n')
   output.write(f'  label = "{program.top}";\n')
   output.write(f'  graph [fontname = "{font}"];\n')
   output.write(f'  node [fontname = "{font}"];\n')
   output.write(f'  edge [fontname = "{font}"];\n')
   output.write('  rankdir = LR;\n')
+  max_traffic = max((x['traffic'] or 0 for x in fifos.values()), default=0)
   levels: Dict[str, Set[int]] = collections.defaultdict(set)
   for task in program.tasks:
     if task.is_upper:
@@ -43,14 +238,141 @@ def main():
         dst = task_fmt.format(name=dst_task_name, id=dst_task_id)
         label = fifo_name
         label += '#%s' % fifo_attr['depth']
+        attrs = ''
+        fifo = fifos.get(fifo_name)
+        if fifo is not None:
+          if fifo['pipeline_level'] is not None:
+            label += '@%s' % fifo['pipeline_level']
+          if fifo['findings']:
+            attrs += ', color = red, fontcolor = red'
+          if None not in fifo['regions'] and len(set(fifo['regions'])) > 1:
+            attrs += ', style = dashed'
+          if max_traffic and fifo['traffic']:
+            attrs += f', penwidth = {1 + 4 * fifo["traffic"] / max_traffic:.2f}'
+          tooltip = [f'depth {fifo["depth"]}']
+          if fifo['width'] is not None:
+            tooltip.append(f'width {fifo["width"]}')
+          if fifo['pipeline_level'] is not None:
+            tooltip.append(f'pipeline level {fifo["pipeline_level"]}')
+          if None not in fifo['regions']:
+            tooltip.append(' -> '.join(fifo['regions']))
+          if fifo['stats'] is not None:
+            tooltip.append(', '.join(
+                f'{key} {fifo["stats"][key]:g}'
+                for key in ('pushes', 'full_stalls', 'empty_stalls')))
+          tooltip += fifo['findings']
+          attrs += f', tooltip = "{fifo_name}: {"; ".join(tooltip)}"'
         levels[src_task_name].add(src_task_id)
         levels[dst_task_name].add(dst_task_id)
-        output.write(f'  {src} -> {dst} [ label = "{label}" ];\n')
+        output.write(f'  {src} -> {dst} [ label = "{label}"{attrs} ];\n')
+  # color the instances from white to red
+  max_value = {
+      'score': 1.,
+      'stalls': 1.,
+      'utilization': max((x['utilization'] or 0 for x in ranking), default=0),
+  }[color_by]
+  key = {'stalls': 'stall_fraction'}.get(color_by, color_by)
+  for instance in ranking:
+    node = task_fmt.format(name=instance['task'], id=instance['id'])
+    value = instance[key] or 0
+    saturation = value / max_value if max_value else 0
+    tooltip = [f'score {instance["score"]:.3f}']
+    for name, fmt in (('latency', 'latency {}'), ('ii', 'II {}'),
+                      ('utilization', 'utilization {:.1%}'),
+                      ('stall_fraction', 'stalls {:.1%}'),
+                      ('region', 'region {}')):
+      if instance[name] is not None:
+        tooltip.append(fmt.format(instance[name]))
+    output.write(f'  {node} [ style = filled, '
+                 f'fillcolor = "0.000 {saturation:.3f} 1.000", '
+                 f'tooltip = "{"; ".join(tooltip)}" ];\n')
   for name, ids in levels.items():
     instances = ', '.join(task_fmt.format(name=name, id=x) for x in ids)
     output.write(f'  {{ rank = same; {instances} }}\n')
   output.write('}\n')
 
 
+def main():
+  parser = argparse.ArgumentParser(
+      prog='tapav', description='TAPA Visualizer')
+  parser.add_argument(dest='program',
+                      help='input ‘program.json’, default to stdin',
+                      nargs='?',
+                      type=argparse.FileType('r'),
+                      default=sys.stdin)
+  parser.add_argument('-o',
+                      '--output',
+                      dest='output',
+                      help='output file, default to stdout',
+                      type=argparse.FileType('w'),
+                      default=sys.stdout)
+  parser.add_argument('--work-dir',
+                      dest='work_dir',
+                      metavar='DIR',
+                      help='``tapac`` working directory to read the HLS '
+                      'reports and floorplan from; enables the performance '
+                      'analysis')
+  parser.add_argument('--stream-stats',
+                      dest='stream_stats',
+                      metavar='LOG',
+                      type=argparse.FileType('r'),
+                      help='software simulation log with stream statistics, '
+                      'i.e., run with ``TAPA_STREAM_STATS=1``; enables the '
+                      'performance analysis')
+  parser.add_argument('--report',
+                      dest='report',
+                      metavar='FILE',
+                      type=argparse.FileType('w'),
+                      help='output ranked bottleneck report, default to '
+                      'stderr if the performance analysis is enabled')
+  parser.add_argument('--format',
+                      dest='format',
+                      choices=['dot', 'svg', 'html'],
+                      default='dot',
+                      help='output Graphviz source, or an SVG or HTML page '
+                      'rendered by ``dot`` with tooltips, default to dot')
+  parser.add_argument('--color-by',
+                      dest='color_by',
+                      choices=['score', 'stalls', 'utilization'],
+                      default='score',
+                      help='color the instances by their bottleneck scores, '
+                      'their stall fractions in simulation, or their HLS '
+                      'area utilization, default to score')
+  args = parser.parse_args()
+
+  program = tapa.core.Program(args.program, work_dir=args.work_dir)
+
+  ranking: List[Dict[str, Any]] = []
+  fifos: Dict[str, Dict[str, Any]] = {}
+  if args.work_dir is not None or args.stream_stats is not None:
+    stream_stats = None
+    if args.stream_stats is not None:
+      stream_stats = parse_stream_stats(args.stream_stats)
+    ranking, fifos = analyze_performance(program, stream_stats)
+    write_report(args.report or sys.stderr, ranking, fifos)
+
+  graph = io.StringIO()
+  write_graph(graph, program, ranking, fifos, args.color_by)
+  output = args.output
+  if args.format == 'dot':
+    output.write(graph.getvalue())
+    return
+  svg = subprocess.run(
+      ['dot', '-Tsvg'],
+      input=graph.getvalue(),
+      stdout=subprocess.PIPE,
+      check=True,
+      universal_newlines=True,
+  ).stdout
+  if args.format == 'html':
+    # drop the XML prolog so that the SVG can be inlined
+    svg = svg[svg.index('<svg'):]
+    output.write('<!DOCTYPE html>\n<html>\n<head>\n<meta charset="utf-8">\n'
+                 f'<title>{html.escape(program.top)}</title>\n</head>\n'
+                 f'<body>\n{svg}</body>\n</html>\n')
+  else:
+    output.write(svg)
+
+
 if __name__ == '__main__':
   main()
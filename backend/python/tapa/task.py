@@ -2,7 +2,7 @@ import collections
 import decimal
 import enum
 import logging
-from typing import Dict, List, NamedTuple, Optional, Tuple, Union
+from typing import Any, Dict, List, NamedTuple, Optional, Tuple, Union
 
 from tapa.verilog import xilinx as rtl
 from tapa.verilog import ast
@@ -23,15 +23,28 @@ class Task:
   Attributes:
     level: Task.Level, upper or lower.
     name: str, name of the task, function name as defined in the source code.
-    code: str, HLS C++ code of this task.
+    code_file: Optional str, file holding the HLS C++ code of this task if
+        tapacc wrote it to a file instead of inlining it.
+    hash: str, digest of everything HLS sees of this task, or empty if unknown.
     tasks: A dict mapping child task names to json instance description objects.
     fifos: A dict mapping child fifo names to json FIFO description objects.
+    buffers: A dict mapping child tapa::buffer names to json objects of their
+        geometry, i.e., size and sections.
     ports: A dict mapping port names to Port objects for the current task.
+    streams: A dict mapping stream port names to json objects of estimated
+        traffic, i.e., tokens_per_iteration, ii, and tokens, and whether EoT
+        may be used via the port, i.e., eot.
+    ii: Optional int, estimated initiation interval of this task.
+    loops: A list of json objects of the counted pipelined loops, i.e., name
+        and line, whose events are output as ports named after them.
     module: rtl.Module, should be attached after RTL code is generated.
+    async_mmap_id_width: int, width of the AXI ID of async_mmap instances.
 
   Properties:
     is_upper: bool, True if this task is an upper-level task.
     is_lower: bool, True if this task is an lower-level task.
+    code: str, HLS C++ code of this task, read from code_file on each access
+        if set, so that the code of large designs is not held in memory.
 
   Properties unique to upper tasks:
     instances: A tuple of Instance objects, children instances of this task.
@@ -55,9 +68,22 @@ class Task:
       raise TypeError('unexpected `level`: ' + level)
     self.level = level
     self.name: str = kwargs.pop('name')
-    self.code: str = kwargs.pop('code')
+    self._code: Optional[str] = kwargs.pop('code', None)
+    self.code_file: Optional[str] = kwargs.pop('code_file', None)
+    if self._code is None and self.code_file is None:
+      raise TypeError(f'task {self.name} has neither code nor code_file')
+    self.hash: str = kwargs.pop('hash', '')
+    # Verilog file that implements the task instead of HLS, if any.
+    self.rtl: Optional[str] = kwargs.pop('rtl', None)
+    # Whether the task runs on `ap_clk_2` at twice the kernel clock frequency.
+    self.double_pump: bool = kwargs.pop('double_pump', False)
+    self.streams: Dict[str, Dict[str, Any]] = kwargs.pop(
+        'streams', {})
+    self.ii: Optional[int] = kwargs.pop('ii', None)
+    self.loops: List[Dict[str, Any]] = kwargs.pop('loops', [])
     self.tasks = collections.OrderedDict()
     self.fifos = collections.OrderedDict()
+    self.buffers: Dict[str, Dict[str, int]] = collections.OrderedDict()
     if self.is_upper:
       self.tasks = collections.OrderedDict(
           sorted((item for item in kwargs.pop('tasks', {}).items()),
@@ -65,8 +91,11 @@ class Task:
       self.fifos = collections.OrderedDict(
           sorted((item for item in kwargs.pop('fifos').items()),
                  key=lambda x: x[0]))
+      self.buffers = collections.OrderedDict(
+          sorted(kwargs.pop('buffers', {}).items()))
       self.ports = {i.name: i for i in map(Port, kwargs.pop('ports', ()))}
     self.module = rtl.Module('')
+    self.async_mmap_id_width = 1
     self._instances: Optional[Tuple[Instance, ...]] = None
     self._args: Optional[Dict[str, List[Instance.Arg]]] = None
     self._mmaps: Optional[Dict[str, MMapConnection]] = None
@@ -82,6 +111,13 @@ class Task:
   def is_lower(self) -> bool:
     return self.level == Task.Level.LOWER
 
+  @property
+  def code(self) -> str:
+    if self._code is not None:
+      return self._code
+    with open(self.code_file) as fp:
+      return fp.read()
+
   @property
   def instances(self) -> Tuple[Instance, ...]:
     if self._instances is not None:
@@ -104,8 +140,7 @@ class Task:
     for arg_name, args in mmaps.items():
       # width of the ID port is the sum of the widest slave port plus bits
       # required to multiplex the slaves
-      id_width = max(
-          arg.instance.task.get_id_width(arg.port) or 0 for arg in args)
+      id_width = max(self.get_slave_id_width(arg) or 0 for arg in args)
       id_width += (len(args) - 1).bit_length()
       self._mmaps[arg_name] = MMapConnection(id_width, args=tuple(args))
       if len(args) > 1:
@@ -217,6 +252,16 @@ class Task:
       return self.mmaps[port].id_width or None
     return None
 
+  def get_slave_id_width(self, arg: Instance.Arg) -> Optional[int]:
+    """Returns the ID width of the AXI master that drives `arg` of a child.
+
+    async_mmap arguments of lower-level children are driven by async_mmap
+    instances of this task rather than by the children themselves.
+    """
+    if arg.cat == Instance.Arg.Cat.ASYNC_MMAP and arg.instance.task.is_lower:
+      return self.async_mmap_id_width
+    return arg.instance.task.get_id_width(arg.port)
+
   _DIR2CAT = {'produced_by': 'ostream', 'consumed_by': 'istream'}
 
   def get_connection_to(
@@ -224,14 +269,22 @@ class Task:
       fifo_name: str,
       direction: str,
   ) -> Tuple[str, int, str]:
-    """Get port information to which a given FIFO is connected."""
+    """Get port information to which a given FIFO is connected.
+
+    The producer of a FIFO of a broadcast or distribute stream, and the
+    consumer of a FIFO of a merge stream, are connected to the stream rather
+    than to the FIFO.
+    """
     if direction not in self._DIR2CAT:
       raise ValueError(f'invalid direction: {direction}')
     if direction not in self.fifos[fifo_name]:
       raise ValueError(f'{fifo_name} is not {direction} any task')
     task_name, task_idx = self.fifos[fifo_name][direction]
+    names = {fifo_name}
+    names.update(self.fifos[fifo_name].get(x, fifo_name)
+                 for x in ('broadcast', 'merge', 'distribute'))
     for port, arg in self.tasks[task_name][task_idx]['args'].items():
-      if arg['cat'] == self._DIR2CAT[direction] and arg['arg'] == fifo_name:
+      if arg['cat'] == self._DIR2CAT[direction] and arg['arg'] in names:
         return task_name, task_idx, port
     raise ValueError(f'task {self.name} has inconsistent metadata')
 
@@ -361,8 +414,7 @@ class Task:
       assert len(args) <= 16, f'too many ports connected to {arg_name}'
       assert m_axi_id_width is not None
 
-      s_axi_id_width = max(
-          arg.instance.task.get_id_width(arg.port) or 0 for arg in args)
+      s_axi_id_width = max(self.get_slave_id_width(arg) or 0 for arg in args)
 
       portargs = [
           ast.make_port_arg(port='INTERCONNECT_ACLK', arg=rtl.HANDSHAKE_CLK),
@@ -404,7 +456,7 @@ class Task:
                          width=rtl.get_m_axi_port_width(
                              port=axi_port,
                              data_width=width_table[arg_name],
-                             id_width=arg.instance.task.get_id_width(arg.port),
+                             id_width=self.get_slave_id_width(arg),
                          )))
             portargs.append(
                 ast.make_port_arg(
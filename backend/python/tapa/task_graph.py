@@ -39,21 +39,54 @@ def get_scalar_passing_edges(top_task):
 def get_fifo_edges(
     top_task: Task,
     fifo_width_getter: Callable[[Task, str], int],
+    weight_by_rate: bool = False,
+    max_slice_width: int = 0,
 ):
   """
   get the edges corresponding to stream FIFOs in the tapa code
+
+  If weight_by_rate is set, the width of each FIFO is scaled by the tokens
+  per cycle estimated by tapacc, so that the floorplanner avoids cutting busy
+  FIFOs rather than merely wide ones. FIFOs with unknown rates keep their full
+  width.
+
+  If max_slice_width is set, FIFOs wider than it are split into slices of at
+  most that width, each of which is an edge of its own. The floorplanner may
+  route and pipeline the slices independently, so that a wide FIFO is not
+  forced through the Laguna sites of a single SLR crossing.
   """
   fifo_edges = {}
   # Generate edges for FIFOs instantiated in the top task.
   for fifo_name, fifo in top_task.fifos.items():
-    fifo_edges[rtl.sanitize_array_name(fifo_name)] = {
-        'produced_by': 'TASK_VERTEX_' + util.get_instance_name(fifo['produced_by']),
-        'consumed_by': 'TASK_VERTEX_' + util.get_instance_name(fifo['consumed_by']),
-        'width': fifo_width_getter(top_task, fifo_name),
-        'depth': top_task.fifos[fifo_name]['depth'],
-        'instance': rtl.sanitize_array_name(fifo_name),
-        'category': 'FIFO_EDGE',
-    }
+    width = fifo_width_getter(top_task, fifo_name)
+    slice_count = 1
+    if 0 < max_slice_width < width:
+      slice_count = -(-width // max_slice_width)
+    widths = rtl.fifo_slice_widths(width, slice_count)
+    if weight_by_rate:
+      # The slower side bounds the traffic through the FIFO.
+      rates = [
+          util.get_stream_rate(fifo.get(key))
+          for key in ('producer_rate', 'consumer_rate')
+      ]
+      rates = [rate for rate in rates if rate is not None]
+      if rates:
+        widths = tuple(
+            max(1, round(width * min(min(rates), 1))) for width in widths)
+    name = rtl.sanitize_array_name(fifo_name)
+    for idx, width in enumerate(widths):
+      edge = {
+          'produced_by': 'TASK_VERTEX_' + util.get_instance_name(fifo['produced_by']),
+          'consumed_by': 'TASK_VERTEX_' + util.get_instance_name(fifo['consumed_by']),
+          'width': width,
+          'depth': top_task.fifos[fifo_name]['depth'],
+          'instance': name,
+          'category': 'FIFO_EDGE',
+      }
+      if slice_count > 1:
+        edge['instance'] = rtl.fifo_slice_name(name, idx)
+        edge['slice_of'] = name
+      fifo_edges[edge['instance']] = edge
 
   return type_marked(fifo_edges, 'FIFO_EDGE')
 
@@ -113,10 +146,16 @@ def get_async_mmap_edges(
   return type_marked(async_mmap_edges, 'ASYNC_MMAP_EDGE')
 
 
-def get_edges(top_task: Task, fifo_width_getter: Callable[[Task, str], int]):
+def get_edges(
+    top_task: Task,
+    fifo_width_getter: Callable[[Task, str], int],
+    weight_by_rate: bool = False,
+    max_fifo_slice_width: int = 0,
+):
   all_edges = {}
   all_edges.update(get_scalar_passing_edges(top_task))
-  all_edges.update(get_fifo_edges(top_task, fifo_width_getter))
+  all_edges.update(get_fifo_edges(top_task, fifo_width_getter, weight_by_rate,
+                                  max_fifo_slice_width))
   all_edges.update(get_axi_edges(top_task))
   all_edges.update(get_async_mmap_edges(top_task))
 
@@ -197,6 +236,9 @@ def get_port_vertices(
       area = get_zero_area()
     elif port_cat == 'PLRAM':
       area = get_zero_area()
+    # the slave bridge is in the shell
+    elif port_cat == 'HOST':
+      area = get_zero_area()
     else:
       raise NotImplementedError(f'unrecognized port type {port_cat}')
 
@@ -1,9 +1,11 @@
 import configparser
+import fractions
 import logging
 import os.path
+import re
 import shutil
 import subprocess
-from typing import Dict, Iterator, TextIO, Tuple
+from typing import Dict, Iterator, Optional, TextIO, Tuple
 
 from .task import Task
 from .instance import Instance
@@ -30,6 +32,67 @@ def clang_format(code: str, *args: str) -> str:
   return code
 
 
+def get_available_memory() -> Optional[int]:
+  """Returns the available physical memory in bytes, or None if unknown."""
+  try:
+    with open('/proc/meminfo') as meminfo_fp:
+      for line in meminfo_fp:
+        if line.startswith('MemAvailable:'):
+          return int(line.split()[1]) * 1024
+  except OSError:
+    pass
+  return None
+
+
+def get_max_jobs(mem_per_job: float) -> int:
+  """Returns the number of jobs that fit in the CPUs and available memory.
+
+  Args:
+    mem_per_job: Memory in GiB reserved for each job.
+  """
+  jobs = os.cpu_count() or 1
+  available_memory = get_available_memory()
+  if available_memory is not None:
+    jobs = max(1, min(jobs, int(available_memory / mem_per_job / 2**30)))
+  return jobs
+
+
+def write_if_changed(filename: str, content: str) -> bool:
+  """Write `content` to `filename` unless it already has the same content.
+
+  Keeping unchanged files untouched preserves their timestamps, so tools
+  downstream can skip them.
+
+  Returns:
+    Whether the file is written.
+  """
+  try:
+    with open(filename) as fp:
+      if fp.read() == content:
+        return False
+  except FileNotFoundError:
+    pass
+  with open(filename, 'w') as fp:
+    fp.write(content)
+  return True
+
+
+def get_stream_rate(
+    port: Optional[Dict[str, Optional[int]]]) -> Optional[fractions.Fraction]:
+  """Returns the tokens per cycle of a stream port estimated by tapacc.
+
+  Args:
+    port: The `producer_rate` or `consumer_rate` of a FIFO, if any.
+
+  Returns:
+    The rate, or None if unknown.
+  """
+  if (port is None or port['tokens_per_iteration'] is None or
+      port['ii'] is None):
+    return None
+  return fractions.Fraction(port['tokens_per_iteration'], port['ii'])
+
+
 def get_instance_name(item: Tuple[str, int]) -> str:
   return '_'.join(map(str, item))
 
@@ -93,6 +156,10 @@ def parse_connectivity_and_check_completeness(
   return arg_name_to_external_port
 
 def parse_port(port: str) -> Tuple[str, int]:
+  # banks of NoC-attached memory on Versal are named like MC_NOC0
+  match = re.fullmatch(r'(MC_NOC)(\d+)', port)
+  if match is not None:
+    return match[1], int(match[2])
   bra = port.find('[')
   ket = port.find(']')
   colon = port.find(':')
@@ -102,6 +169,12 @@ def parse_port(port: str) -> Tuple[str, int]:
   port_id = int(port[bra + 1:ket])
   return port_cat, port_id
 
+def format_port(port_cat: str, port_id: int) -> str:
+  """ inverse of `parse_port` """
+  if port_cat == 'MC_NOC':
+    return f'{port_cat}{port_id}'
+  return f'{port_cat}[{port_id}]'
+
 def get_max_addr_width(part_num: str) -> int:
   """ get the max addr width based on the memory capacity """
   if part_num.startswith('xcu280'):
@@ -1,13 +1,17 @@
+import collections
 import re
-from typing import Iterator, Optional, Tuple, Union
+from typing import Dict, Iterator, List, Optional, Tuple, Union
 
 from tapa.verilog import ast
 
 __all__ = [
     'Pipeline',
+    'BroadcastTree',
     'match_array_name',
     'sanitize_array_name',
     'wire_name',
+    'fifo_slice_name',
+    'fifo_slice_widths',
     'async_mmap_instance_name',
 ]
 
@@ -34,6 +38,75 @@ class Pipeline:
       yield ast.Reg(name=x.name, width=self._width)
 
 
+class BroadcastTree:
+  """Registers that distribute one signal to many sinks.
+
+  Every sink is driven through exactly `level` registers, so that all sinks see
+  the signal in the same cycle, as if each had its own `Pipeline`. Sinks are
+  first grouped by region, so that the source drives one register per region,
+  and then split so that each register drives about `fanout` others.
+  """
+
+  def __init__(
+      self,
+      name: str,
+      level: int,
+      width: Optional[int] = None,
+      fanout: int = 16,
+  ):
+    self.name = name
+    self.level = level
+    self.fanout = fanout
+    self._width: Optional[ast.Width] = width and ast.make_width(width)
+    self._sinks: Dict[Optional[str], List[str]] = collections.OrderedDict()
+    self._regs: List[Tuple[ast.Identifier, ast.Node]] = []
+    self._drivers: List[Tuple[ast.Identifier, ast.Node]] = []
+
+  def add_sink(self, sink: str, region: Optional[str] = None) -> None:
+    sinks = self._sinks.setdefault(region, [])
+    if sink not in sinks:
+      sinks.append(sink)
+
+  def build(self, init: ast.Node) -> None:
+    """Populate `registers` and `drivers` with `init` as the source."""
+    self._regs.clear()
+    self._drivers.clear()
+    for idx, sinks in enumerate(self._sinks.values()):
+      self._build(init, sinks, self.level, f'{idx}')
+
+  def _build(self, src: ast.Node, sinks: List[str], level: int,
+             label: str) -> None:
+    if level == 0:
+      self._drivers.extend((ast.Identifier(x), src) for x in sinks)
+      return
+    reg = ast.Identifier(f'{self.name}__q{self.level - level + 1}_{label}')
+    self._regs.append((reg, src))
+    # each of the `level - 1` levels below divides the sinks by `fanout`
+    count = -(-len(sinks) // self.fanout**(level - 1))
+    size = -(-len(sinks) // count)
+    for idx, begin in enumerate(range(0, len(sinks), size)):
+      self._build(reg, sinks[begin:begin + size], level - 1, f'{label}_{idx}')
+
+  @property
+  def signals(self) -> Iterator[Union[ast.Reg, ast.Wire, ast.Pragma]]:
+    for sinks in self._sinks.values():
+      for sink in sinks:
+        yield ast.Wire(name=sink, width=self._width)
+    for reg, _ in self._regs:
+      yield ast.Pragma(ast.PragmaEntry('keep = "true"'))
+      yield ast.Reg(name=reg.name, width=self._width)
+
+  @property
+  def registers(self) -> List[Tuple[ast.Identifier, ast.Node]]:
+    """Each register and its input."""
+    return self._regs
+
+  @property
+  def drivers(self) -> List[Tuple[ast.Identifier, ast.Node]]:
+    """Each sink and the register driving it."""
+    return self._drivers
+
+
 def match_array_name(name: str) -> Optional[Tuple[str, int]]:
   match = re.fullmatch(r'(\w+)\[(\d+)\]', name)
   if match is not None:
@@ -64,5 +137,18 @@ def wire_name(fifo: str, suffix: str) -> str:
   return f'{fifo}__{suffix}'
 
 
+def fifo_slice_name(fifo: str, idx: int) -> str:
+  """Return the instance name of slice `idx` of a FIFO split by width."""
+  return f'{sanitize_array_name(fifo)}__slice{idx}'
+
+
+def fifo_slice_widths(width: int, count: int) -> Tuple[int, ...]:
+  """Return the widths of `count` near-equal slices of `width` bits.
+
+  Slices are ordered from the LSB, and wider slices come first.
+  """
+  return tuple(width // count + (idx < width % count) for idx in range(count))
+
+
 def async_mmap_instance_name(variable_name: str) -> str:
   return f'{variable_name}__m_axi'
@@ -34,10 +34,21 @@ def is_data_port(port: str) -> bool:
 
 def generate_handshake_ports(
     instance: tapa.instance.Instance,
-    rst_q: Pipeline,
+    rst_n: ast.Node,
+    is_clk_2: bool = False,
 ) -> Iterator[ast.PortArg]:
+  if is_clk_2:
+    # handshake signals are relayed by `Module.add_ap_ctrl_cdc_instance`
+    yield ast.make_port_arg(port=HANDSHAKE_CLK, arg=CLK_2)
+    yield ast.make_port_arg(port=HANDSHAKE_RST_N, arg=RST_N_2)
+    for port in (HANDSHAKE_START, *HANDSHAKE_OUTPUT_PORTS):
+      yield ast.make_port_arg(
+          port=port,
+          arg=wire_name(instance.name, f'{port}_cdc'),
+      )
+    return
   yield ast.make_port_arg(port=HANDSHAKE_CLK, arg=CLK)
-  yield ast.make_port_arg(port=HANDSHAKE_RST_N, arg=rst_q[-1])
+  yield ast.make_port_arg(port=HANDSHAKE_RST_N, arg=rst_n)
   yield ast.make_port_arg(port=HANDSHAKE_START, arg=instance.start)
   for port in HANDSHAKE_OUTPUT_PORTS:
     yield ast.make_port_arg(
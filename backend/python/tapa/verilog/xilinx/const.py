@@ -15,22 +15,28 @@ __all__ = [
     'HANDSHAKE_CLK',
     'HANDSHAKE_RST',
     'HANDSHAKE_RST_N',
+    'HANDSHAKE_CLK_2',
+    'HANDSHAKE_RST_N_2',
     'HANDSHAKE_START',
     'HANDSHAKE_DONE',
     'HANDSHAKE_IDLE',
     'HANDSHAKE_READY',
+    'HANDSHAKE_CONTINUE',
     'HANDSHAKE_INPUT_PORTS',
     'HANDSHAKE_OUTPUT_PORTS',
     'START',
     'DONE',
     'IDLE',
     'READY',
+    'CONTINUE',
     'TRUE',
     'FALSE',
     'SENS_TYPE',
     'CLK',
     'RST',
     'RST_N',
+    'CLK_2',
+    'RST_N_2',
     'CLK_SENS_LIST',
     'ALL_SENS_LIST',
     'STATE',
@@ -103,10 +109,13 @@ FIFO_WRITE_PORTS = (
 HANDSHAKE_CLK = 'ap_clk'
 HANDSHAKE_RST = 'ap_rst_n_inv'
 HANDSHAKE_RST_N = 'ap_rst_n'
+HANDSHAKE_CLK_2 = 'ap_clk_2'
+HANDSHAKE_RST_N_2 = 'ap_rst_n_2'
 HANDSHAKE_START = 'ap_start'
 HANDSHAKE_DONE = 'ap_done'
 HANDSHAKE_IDLE = 'ap_idle'
 HANDSHAKE_READY = 'ap_ready'
+HANDSHAKE_CONTINUE = 'ap_continue'  # ap_ctrl_chain only
 
 HANDSHAKE_INPUT_PORTS = (
     HANDSHAKE_CLK,
@@ -125,12 +134,15 @@ START = ast.Identifier(HANDSHAKE_START)
 DONE = ast.Identifier(HANDSHAKE_DONE)
 IDLE = ast.Identifier(HANDSHAKE_IDLE)
 READY = ast.Identifier(HANDSHAKE_READY)
+CONTINUE = ast.Identifier(HANDSHAKE_CONTINUE)
 TRUE = ast.IntConst("1'b1")
 FALSE = ast.IntConst("1'b0")
 SENS_TYPE = 'posedge'
 CLK = ast.Identifier(HANDSHAKE_CLK)
 RST = ast.Identifier(HANDSHAKE_RST)
 RST_N = ast.Identifier(HANDSHAKE_RST_N)
+CLK_2 = ast.Identifier(HANDSHAKE_CLK_2)
+RST_N_2 = ast.Identifier(HANDSHAKE_RST_N_2)
 CLK_SENS_LIST = ast.SensList((ast.Sens(CLK, type=SENS_TYPE),))
 ALL_SENS_LIST = ast.SensList((ast.Sens(None, type='all'),))
 STATE = ast.Identifier('tapa_state')
@@ -3,7 +3,8 @@ import itertools
 import logging
 import os.path
 import tempfile
-from typing import Callable, Dict, Iterable, Iterator, Optional, Tuple, Union
+from typing import (Callable, Dict, Iterable, Iterator, List, Optional, Tuple,
+                    Union)
 
 from pyverilog.ast_code_generator import codegen
 from pyverilog.vparser import parser
@@ -38,6 +39,8 @@ class Module:
     _last_param_idx: Last index of ast.Parameter in module_def.items.
     _last_instance_idx: Last index of ast.InstanceList in module_def.items.
     _last_logic_idx: Last index of ast.Assign or ast.Always in module_def.items.
+    _broadcast_trees: A mapping from names of broadcast trees to the trees
+        and their sources, pending `add_broadcast_trees`.
   """
 
   def __init__(self, files: Iterable[str], is_trimming_enabled: bool = False):
@@ -150,9 +153,39 @@ class Module:
     """
     return getattr(self, 'fifo_partition_count', {}).get(fifo_name, 1)
 
+  def fifo_slice_count_of(self, fifo_name: str) -> int:
+    """Get the number of width slices of each FIFO.
+
+    The minimum slice count is 1, which means the FIFO is not sliced. Each
+    slice is a FIFO of its own named by `fifo_slice_name`, with its own
+    partition count.
+
+    Args:
+        fifo_name (str): Name of the FIFO.
+
+    Returns:
+        int: N, where this FIFO is sliced into N narrower FIFOs.
+    """
+    return getattr(self, 'fifo_slice_count', {}).get(fifo_name, 1)
+
+  def fifo_impl_of(self, fifo_name: str) -> str:
+    """Get the memory of each FIFO chosen with the floorplan.
+
+    Args:
+        fifo_name (str): Name of the FIFO.
+
+    Returns:
+        str: One of 'srl', 'lutram', 'bram' and 'uram', or 'auto' if the
+            floorplan did not choose.
+    """
+    return getattr(self, 'fifo_impl', {}).get(fifo_name, 'auto')
+
   def get_axi_pipeline_level(self, port_name: str) -> int:
     return getattr(self, 'axi_pipeline_level', {}).get(port_name, 0)
 
+  def get_floorplan_region(self, instance_name: str) -> Optional[str]:
+    return getattr(self, 'floorplan_region', {}).get(instance_name)
+
 
   @property
   def ports(self) -> Dict[str, IOPort]:
@@ -310,6 +343,80 @@ class Module:
         ast.Assign(left=q[0], right=init),
     ))
 
+  def add_broadcast(
+      self,
+      name: str,
+      init: ast.Node,
+      sink: str,
+      instance_name: str,
+      width: Optional[int] = None,
+  ) -> ast.Identifier:
+    """Add wire sink driven by init delayed by register_level cycles.
+
+    Unlike a `Pipeline` per sink, sinks of the same name share the registers of
+    a `BroadcastTree`, grouped by the floorplan region of their instances. The
+    registers are added by `add_broadcast_trees` once all sinks are known.
+
+    Args:
+        name (str): Name of the broadcast tree.
+        init (ast.Node): Source of the tree, the same for all its sinks.
+        sink (str): Name of the wire to declare.
+        instance_name (str): Name of the instance reading the sink.
+        width (Optional[int]): Width of the signal.
+
+    Returns:
+        ast.Identifier: The sink.
+    """
+    # not set in the constructor; modules may be unpickled from older caches
+    trees = self.__dict__.setdefault('_broadcast_trees',
+                                     collections.OrderedDict())
+    if name not in trees:
+      trees[name] = (
+          BroadcastTree(name, level=self.register_level, width=width),
+          init,
+      )
+    tree, _ = trees[name]
+    tree.add_sink(sink, self.get_floorplan_region(instance_name))
+    return ast.Identifier(sink)
+
+  def add_rst_n(self, name: str, instance_name: str = '') -> ast.Identifier:
+    """Add wire `{name}__ap_rst_n` for the active-low reset of an instance.
+
+    Args:
+        name (str): Prefix of the wire.
+        instance_name (str): Name of the instance, `name` if empty.
+
+    Returns:
+        ast.Identifier: The reset delayed by register_level cycles.
+    """
+    return self.add_broadcast(
+        name=f'{HANDSHAKE_RST_N}_tree',
+        init=RST_N,
+        sink=f'{name}__{HANDSHAKE_RST_N}',
+        instance_name=instance_name or name,
+    )
+
+  def add_broadcast_trees(self) -> None:
+    """Add signals and logics for the sinks added by `add_broadcast`."""
+    trees = getattr(self, '_broadcast_trees', {})
+    for tree, init in trees.values():
+      tree.build(init)
+      self.add_signals(tree.signals)
+      logics: List[Logic] = [
+          ast.Assign(left=sink, right=driver) for sink, driver in tree.drivers
+      ]
+      if tree.registers:
+        logics.insert(
+            0,
+            ast.Always(
+                sens_list=CLK_SENS_LIST,
+                statement=ast.make_block(
+                    ast.NonblockingSubstitution(left=reg, right=src)
+                    for reg, src in tree.registers),
+            ))
+      self.add_logics(logics)
+    trees.clear()
+
   def del_signals(self, prefix: str = '', suffix: str = '') -> None:
 
     def func(item: ast.Node) -> bool:
@@ -407,42 +514,207 @@ class Module:
       width: int,
       depth: int,
       additional_fifo_pipelining: bool,
+      write_clk_2: bool = False,
+      read_clk_2: bool = False,
+      impl: str = 'auto',
+      almost_full: bool = False,
+      eot: bool = True,
   ) -> 'Module':
-    name = sanitize_array_name(name)
-    rst_q = Pipeline(f'{name}__rst', level=self.register_level)
-    self.add_pipeline(rst_q, init=ast.Unot(RST_N))
+    """Add a FIFO instance.
 
-    def ports() -> Iterator[ast.PortArg]:
-      yield ast.make_port_arg(port='clk', arg=CLK)
-      yield ast.make_port_arg(port='reset', arg=rst_q[-1])
-      yield from (
-          ast.make_port_arg(port=port_name, arg=wire_name(name, arg_suffix))
-          for port_name, arg_suffix in zip(FIFO_READ_PORTS, ISTREAM_SUFFIXES))
+    Args:
+      name: Name of the FIFO.
+      width: Data width of the FIFO.
+      depth: Declared depth of the FIFO.
+      additional_fifo_pipelining: Replace the FIFO by a relay station of at
+          least LEVEL 2.
+      write_clk_2: Whether the producer runs on `ap_clk_2` instead of `ap_clk`.
+      read_clk_2: Whether the consumer runs on `ap_clk_2` instead of `ap_clk`.
+      impl: Memory of the FIFO, one of 'srl', 'lutram', 'bram' and 'uram', or
+          'auto' to use the memory chosen with the floorplan (see
+          `fifo_impl_of`), if any, or to choose by width and depth. Ignored for
+          FIFOs that cross clock domains.
+      almost_full: Use a relay station even if the FIFO is not pipelined. Its
+          `full_n` is registered and deasserted early by as many tokens as the
+          pipeline holds, so that the handshake never forms a combinational
+          path.
+      eot: Whether the EoT bit, i.e., the MSB of `width`, is stored. If not,
+          the FIFO is one bit narrower and its readers see the bit as 0.
+
+    If the floorplan slices the FIFO (see `fifo_slice_count_of`), the stored
+    bits are split into slices that are FIFOs of their own. A token is written
+    to all slices only if none is full, and read from all slices only if none
+    is empty, so the slices stay in lock step regardless of their latencies.
+    """
+    name = sanitize_array_name(name)
+    if impl == 'auto':
+      impl = self.fifo_impl_of(name)
+
+    # The data ports of the FIFO exclude the EoT bit if it is not stored.
+    data_args = {
+        '_dout': wire_name(name, '_dout'),
+        '_din': wire_name(name, '_din'),
+    }
+    if not eot:
+      width -= 1
+      for suffix in data_args:
+        data_args[suffix] = ast.Partselect(
+            ast.Identifier(data_args[suffix]),
+            ast.IntConst(str(width - 1)),
+            ast.IntConst('0'),
+        )
+      self.add_logics([
+          ast.Assign(
+              left=ast.Pointer(ast.Identifier(wire_name(name, '_dout')),
+                               ast.IntConst(str(width))),
+              right=FALSE,
+          )
+      ])
+
+    def reset_of(clk_2: bool) -> ast.Node:
+      if clk_2:
+        return ast.Unot(RST_N_2)
+      return ast.Unot(self.add_rst_n(name))
+
+    def ports(*clk_ports: ast.PortArg) -> Iterator[ast.PortArg]:
+      yield from clk_ports
+      yield from (ast.make_port_arg(
+          port=port_name,
+          arg=data_args.get(arg_suffix, wire_name(name, arg_suffix)),
+      ) for port_name, arg_suffix in zip(FIFO_READ_PORTS, ISTREAM_SUFFIXES))
       yield ast.make_port_arg(port=FIFO_READ_PORTS[-1], arg=TRUE)
-      yield from (
-          ast.make_port_arg(port=port_name, arg=wire_name(name, arg_suffix))
-          for port_name, arg_suffix in zip(FIFO_WRITE_PORTS, OSTREAM_SUFFIXES))
+      yield from (ast.make_port_arg(
+          port=port_name,
+          arg=data_args.get(arg_suffix, wire_name(name, arg_suffix)),
+      ) for port_name, arg_suffix in zip(FIFO_WRITE_PORTS, OSTREAM_SUFFIXES))
       yield ast.make_port_arg(port=FIFO_WRITE_PORTS[-1], arg=TRUE)
 
+    if write_clk_2 != read_clk_2:
+      # gray-coded pointers require a power-of-2 depth; synchronizing them
+      # takes up to 3 cycles each way, which is hidden by additional depth
+      addr_width = max(2, (depth + 6 - 1).bit_length())
+      return self.add_instance(
+          module_name='async_fifo',
+          instance_name=name,
+          ports=ports(
+              ast.make_port_arg(port='wr_clk',
+                                arg=CLK_2 if write_clk_2 else CLK),
+              ast.make_port_arg(port='wr_reset', arg=reset_of(write_clk_2)),
+              ast.make_port_arg(port='rd_clk',
+                                arg=CLK_2 if read_clk_2 else CLK),
+              ast.make_port_arg(port='rd_reset', arg=reset_of(read_clk_2)),
+          ),
+          params=(
+              ast.ParamArg(paramname='DATA_WIDTH', argname=ast.Constant(width)),
+              ast.ParamArg(paramname='ADDR_WIDTH',
+                           argname=ast.Constant(addr_width)),
+              ast.ParamArg(paramname='DEPTH',
+                           argname=ast.Constant(1 << addr_width)),
+          ),
+      )
+
+    slice_count = self.fifo_slice_count_of(name)
+    if slice_count > 1:
+      din, full_n, write = (wire_name(name, x) for x in OSTREAM_SUFFIXES)
+      dout, empty_n, read = (wire_name(name, x) for x in ISTREAM_SUFFIXES)
+      slice_names = [fifo_slice_name(name, idx) for idx in range(slice_count)]
+      logics = [
+          ast.Assign(
+              left=ast.Identifier(full_n),
+              right=ast.make_operation(
+                  operator=ast.Land,
+                  nodes=(ast.Identifier(wire_name(x, '_full_n'))
+                         for x in slice_names),
+              ),
+          ),
+          ast.Assign(
+              left=ast.Identifier(empty_n),
+              right=ast.make_operation(
+                  operator=ast.Land,
+                  nodes=(ast.Identifier(wire_name(x, '_empty_n'))
+                         for x in slice_names),
+              ),
+          ),
+      ]
+      # the slices share one handshake, whose round trip is as long as that of
+      # the most pipelined slice; every slice needs the depth to cover it
+      def extra_depth(fifo_name: str) -> int:
+        partition_count = self.partition_count_of(fifo_name)
+        return partition_count * 2 if partition_count > 1 else 0
+
+      max_extra_depth = max(map(extra_depth, slice_names))
+      lsb = 0
+      for slice_name, slice_width in zip(
+          slice_names, fifo_slice_widths(width, slice_count)):
+        bits = (ast.IntConst(str(lsb + slice_width - 1)),
+                ast.IntConst(str(lsb)))
+        self.add_signals(
+            ast.Wire(name=wire_name(slice_name, suffix),
+                     width=ast.make_width(slice_width if suffix in
+                                          {'_din', '_dout'} else 0))
+            for suffix in (*ISTREAM_SUFFIXES, *OSTREAM_SUFFIXES))
+        logics.extend((
+            ast.Assign(
+                left=ast.Identifier(wire_name(slice_name, '_din')),
+                right=ast.Partselect(ast.Identifier(din), *bits),
+            ),
+            ast.Assign(
+                left=ast.Partselect(ast.Identifier(dout), *bits),
+                right=ast.Identifier(wire_name(slice_name, '_dout')),
+            ),
+            ast.Assign(
+                left=ast.Identifier(wire_name(slice_name, '_write')),
+                right=ast.Land(ast.Identifier(write), ast.Identifier(full_n)),
+            ),
+            ast.Assign(
+                left=ast.Identifier(wire_name(slice_name, '_read')),
+                right=ast.Land(ast.Identifier(read), ast.Identifier(empty_n)),
+            ),
+        ))
+        self.add_fifo_instance(
+            name=slice_name,
+            width=slice_width,
+            depth=depth + max_extra_depth - extra_depth(slice_name),
+            additional_fifo_pipelining=additional_fifo_pipelining,
+            write_clk_2=write_clk_2,
+            read_clk_2=read_clk_2,
+            impl=impl,
+            almost_full=almost_full,
+        )
+        lsb += slice_width
+      return self.add_logics(logics)
+
     partition_count = self.partition_count_of(name)
 
+    # each level of relay station adds two cycles to the round-trip latency of
+    # the full/write handshake; grow the depth so that the extra in-flight
+    # tokens do not throttle the producer on pipelined crossings
+    if partition_count > 1:
+      depth += partition_count * 2
+
     # optionally allow additional pipelining if there is enough space
     if additional_fifo_pipelining:
       partition_count = max(2, partition_count)
 
     module_name = 'fifo'
-    level = []
-    if partition_count > 1:
+    extra_params = []
+    if partition_count > 1 or almost_full:
       module_name = 'relay_station'
-      level.append(
+      extra_params.append(
           ast.ParamArg(
               paramname='LEVEL',
               argname=ast.Constant(partition_count),
           ))
+    if impl != 'auto':
+      extra_params.append(
+          ast.ParamArg(paramname='IMPL', argname=ast.StringConst(impl)))
     return self.add_instance(
         module_name=module_name,
         instance_name=name,
-        ports=ports(),
+        ports=ports(
+            ast.make_port_arg(port='clk', arg=CLK_2 if write_clk_2 else CLK),
+            ast.make_port_arg(port='reset', arg=reset_of(write_clk_2)),
+        ),
         params=(
             ast.ParamArg(paramname='DATA_WIDTH', argname=ast.Constant(width)),
             ast.ParamArg(
@@ -450,10 +722,55 @@ class Module:
                 argname=ast.Constant(max(1, (depth - 1).bit_length())),
             ),
             ast.ParamArg(paramname='DEPTH', argname=ast.Constant(depth)),
-            *level,
+            *extra_params,
         ),
     )
 
+  def add_ap_ctrl_cdc_instance(
+      self,
+      name: str,
+      rst_n: ast.Node,
+      is_autorun: bool,
+  ) -> 'Module':
+    """Relay the handshake of instance `name` running on `ap_clk_2`.
+
+    The instance is connected to the `*_cdc` signals declared here (see
+    `generate_handshake_ports`), and the parent keeps using the usual
+    handshake signals in the `ap_clk` domain.
+
+    Args:
+      name: Name of the instance.
+      rst_n: Active-low reset in the `ap_clk` domain.
+      is_autorun: Whether the instance is autorun, in which case only its start
+          signal is used by the parent.
+    """
+    cdc_ports = (HANDSHAKE_START, *HANDSHAKE_OUTPUT_PORTS)
+    self.add_signals(
+        ast.Wire(name=wire_name(name, f'{port}_cdc'), width=None)
+        for port in cdc_ports)
+
+    def ports() -> Iterator[ast.PortArg]:
+      yield ast.make_port_arg(port='s_clk', arg=CLK)
+      yield ast.make_port_arg(port='s_rst_n', arg=rst_n)
+      yield ast.make_port_arg(port=f's_{HANDSHAKE_START}',
+                              arg=wire_name(name, HANDSHAKE_START))
+      for port in HANDSHAKE_OUTPUT_PORTS:
+        yield ast.make_port_arg(
+            port=f's_{port}',
+            arg='' if is_autorun else wire_name(name, port),
+        )
+      yield ast.make_port_arg(port='m_clk', arg=CLK_2)
+      yield ast.make_port_arg(port='m_rst_n', arg=RST_N_2)
+      for port in cdc_ports:
+        yield ast.make_port_arg(port=f'm_{port}',
+                                arg=wire_name(name, f'{port}_cdc'))
+
+    return self.add_instance(
+        module_name='ap_ctrl_cdc',
+        instance_name=f'{name}__ap_ctrl_cdc',
+        ports=ports(),
+    )
+
   def add_async_mmap_instance(
       self,
       name: str,
@@ -464,18 +781,49 @@ class Module:
       max_wait_time: int = 3,
       max_burst_len: Optional[int] = None,
       offset_name: str = '',
+      id_width: int = 1,
+      max_outstanding: int = 64,
+      cache_lines: int = 0,
+      cache_ways: int = 1,
+      atomic: bool = False,
+      write_combine_window: int = 0,
+      bus_width: Optional[int] = None,
   ) -> 'Module':
-    rst_q = Pipeline(f'{name}__rst', level=self.register_level)
-    self.add_pipeline(rst_q, init=ast.Unot(RST_N))
+    """Add an async_mmap instance, or a cached_async_mmap instance that holds
+    `cache_lines` elements in `cache_ways`-way sets if `cache_lines` is set,
+    or an atomic_async_mmap instance whose writes add to memory if `atomic` is
+    set.
+
+    If `write_combine_window` is set, writes to the same burst-sized line that
+    arrive less than `write_combine_window` cycles apart are combined, unless
+    `atomic` is set.
+
+    If `bus_width` is wider than `data_width`, the AXI data path is `bus_width`
+    bits wide and each element is a lane of it.
+
+    Bursts hold up to `max_burst_len` + 1 beats and are issued once no
+    consecutive request arrives for `max_wait_time` cycles.
+    """
+    upsized = (bool(bus_width) and bus_width > data_width and
+               not cache_lines and not atomic)
+    axi_width = bus_width if upsized else data_width
+    rst_n = self.add_rst_n(name, async_mmap_instance_name(name))
 
     paramargs = [
-        ast.ParamArg(paramname='DataWidth', argname=ast.Constant(data_width)),
+        ast.ParamArg(paramname='DataWidth', argname=ast.Constant(axi_width)),
         ast.ParamArg(paramname='DataWidthBytesLog',
-                     argname=ast.Constant((data_width // 8 - 1).bit_length())),
+                     argname=ast.Constant((axi_width // 8 - 1).bit_length())),
     ]
+    if upsized:
+      paramargs.extend((
+          ast.ParamArg(paramname='ElemWidth', argname=ast.Constant(data_width)),
+          ast.ParamArg(paramname='ElemWidthBytesLog',
+                       argname=ast.Constant(
+                           (data_width // 8 - 1).bit_length())),
+      ))
     portargs = [
         ast.make_port_arg(port='clk', arg=CLK),
-        ast.make_port_arg(port='rst', arg=rst_q[-1]),
+        ast.make_port_arg(port='rst', arg=ast.Unot(rst_n)),
     ]
     paramargs.append(
         ast.ParamArg(paramname='AddrWidth', argname=ast.Constant(addr_width)))
@@ -485,21 +833,83 @@ class Module:
                         ast.ParamArg(paramname='BufferSizeLog',
                                      argname=ast.Constant(
                                          (buffer_size - 1).bit_length()))))
-    max_wait_time = max(1, max_wait_time)
+    wait_time_width = max(1, max_wait_time.bit_length())
     paramargs.append(
         ast.ParamArg(paramname='WaitTimeWidth',
-                     argname=ast.Constant(max_wait_time.bit_length())))
+                     argname=ast.Constant(wait_time_width)))
     portargs.append(
         ast.make_port_arg(port='max_wait_time',
-                          arg="{}'d{}".format(max_wait_time.bit_length(),
-                                              max_wait_time)))
+                          arg=f"{wait_time_width}'d{max_wait_time}"))
     if max_burst_len is None:
-      max_burst_len = max(0, 4096 // data_width - 1)
+      max_burst_len = max(0, 4096 // axi_width - 1)
+    else:
+      # requested bursts of widened beats may exceed 4 KiB
+      max_burst_len = min(max_burst_len, 4096 * 8 // axi_width - 1, 255)
     paramargs.append(
         ast.ParamArg(paramname='BurstLenWidth', argname=ast.Constant(8)))
     portargs.append(
         ast.make_port_arg(port='max_burst_len', arg=f"8'd{max_burst_len}"))
 
+    # read bursts are tagged round-robin on the IDs, so there must be at least
+    # one tag per ID; the reorder buffer must hold at least a whole burst
+    max_outstanding = 1 << (max(max_outstanding, 1 << id_width) -
+                            1).bit_length()
+    rob_depth = 1 << (max(max_outstanding, max_burst_len + 1) -
+                      1).bit_length()
+    for param, value in (
+        ('IdWidth', id_width),
+        ('MaxOutstandingReads', max_outstanding),
+        ('MaxOutstandingReadsLog', (max_outstanding - 1).bit_length()),
+        ('ReorderBufferDepth', rob_depth),
+        ('ReorderBufferDepthLog', (rob_depth - 1).bit_length()),
+    ):
+      paramargs.append(
+          ast.ParamArg(paramname=param, argname=ast.Constant(value)))
+
+    # a combined line should fit in a burst; lines that do not are still
+    # correct, only split into multiple bursts; combined updates would be
+    # acknowledged as one
+    if write_combine_window and not atomic:
+      for param, value in (
+          ('WriteCombineLineLenLog',
+           max(1, (max_burst_len + 1).bit_length() - 1)),
+          ('WriteCombineWindow', write_combine_window),
+      ):
+        paramargs.append(
+            ast.ParamArg(paramname=param, argname=ast.Constant(value)))
+
+    module_name = 'async_mmap'
+    if upsized:
+      module_name = 'upsized_async_mmap'
+    if cache_lines:
+      module_name = 'cached_async_mmap'
+      cache_sets = cache_lines // cache_ways
+      # the cached requests in flight have to cover the uncached ones
+      request_buffer_size = rob_depth * 2
+      for param, value in (
+          ('CacheWays', cache_ways),
+          ('CacheSets', cache_sets),
+          ('CacheSetsLog', (cache_sets - 1).bit_length()),
+          ('RequestBufferSize', request_buffer_size),
+          ('RequestBufferSizeLog', (request_buffer_size - 1).bit_length()),
+      ):
+        paramargs.append(
+            ast.ParamArg(paramname=param, argname=ast.Constant(value)))
+      # the cache is invalidated whenever this task starts
+      start_q = Pipeline(f'{name}__start', level=self.register_level)
+      self.add_pipeline(start_q, init=START)
+      portargs.append(ast.make_port_arg(port='start', arg=start_q[-1]))
+    elif atomic:
+      module_name = 'atomic_async_mmap'
+      # the requests in flight have to cover the memory reads in flight
+      request_buffer_size = rob_depth * 2
+      for param, value in (
+          ('RequestBufferSize', request_buffer_size),
+          ('RequestBufferSizeLog', (request_buffer_size - 1).bit_length()),
+      ):
+        paramargs.append(
+            ast.ParamArg(paramname=param, argname=ast.Constant(value)))
+
     for channel, ports in M_AXI_PORTS.items():
       for port, direction in ports:
         portargs.append(
@@ -512,9 +922,14 @@ class Module:
         if tag in tags:
           arg = async_mmap_arg_name(arg=name, tag=tag, suffix=suffix)
           if tag.endswith('_addr') and suffix.endswith('_din'):
+            # the top 8 bits carry the length of explicit bursts as is
             elem_size_bytes_m1 = data_width // 8 - 1
-            arg = "{name} + {{{arg}[{}:0], {}'d0}}".format(
-                addr_width - elem_size_bytes_m1.bit_length() - 1,
+            arg = ("{{{arg}[{}:{}], "
+                   "{name}[{}:0] + {{{arg}[{}:0], {}'d0}}}}").format(
+                addr_width - 1,
+                addr_width - 8,
+                addr_width - 9,
+                addr_width - 9 - elem_size_bytes_m1.bit_length(),
                 elem_size_bytes_m1.bit_length(),
                 arg=arg,
                 name=offset_name or name)
@@ -527,7 +942,7 @@ class Module:
             arg = ''
         portargs.append(ast.make_port_arg(port=tag + suffix, arg=arg))
 
-    return self.add_instance(module_name='async_mmap',
+    return self.add_instance(module_name=module_name,
                              instance_name=async_mmap_instance_name(name),
                              ports=portargs,
                              params=paramargs)
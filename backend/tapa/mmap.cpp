@@ -11,7 +11,8 @@ using std::string;
 using clang::ParmVarDecl;
 
 string GetMmapElemType(const ParmVarDecl* param) {
-  if (IsTapaType(param, "(async_)?mmaps?")) {
+  if (IsTapaType(param,
+                 "(async_|cached_async_|burst_async_|atomic_async_)?mmaps?")) {
     if (auto arg = GetTemplateArg(param->getType(), 0)) {
       return GetTemplateArgName(*arg);
     }
@@ -1,18 +1,49 @@
 #include "stream.h"
 
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "clang/AST/AST.h"
+#include "clang/AST/TypeLoc.h"
 
+using std::deque;
+using std::map;
+using std::set;
+using std::string;
 using std::vector;
 
+using clang::ASTContext;
+using clang::AttributedStmt;
+using clang::BinaryOperator;
 using clang::ClassTemplateSpecializationDecl;
+using clang::CompoundAssignOperator;
 using clang::CXXMemberCallExpr;
+using clang::DeclRefExpr;
+using clang::DeclStmt;
+using clang::DoStmt;
+using clang::ElaboratedTypeLoc;
+using clang::Expr;
+using clang::ForStmt;
+using clang::FunctionDecl;
+using clang::ParmVarDecl;
 using clang::QualType;
 using clang::Stmt;
+using clang::TapaPipelineAttr;
+using clang::TemplateArgument;
+using clang::TemplateSpecializationTypeLoc;
 using clang::Type;
+using clang::TypeLoc;
+using clang::UnaryOperator;
+using clang::ValueDecl;
+using clang::VarDecl;
+using clang::WhileStmt;
 
 using llvm::dyn_cast;
+using llvm::dyn_cast_or_null;
 
 // Given a Stmt, find all tapa::istream and tapa::ostream operations via DFS and
 // update stream_ops.
@@ -49,6 +80,38 @@ vector<const CXXMemberCallExpr*> GetTapaStreamOps(const Stmt* stmt) {
   return stream_ops;
 }
 
+bool IsStreamDepthExplicit(const VarDecl* var_decl, unsigned depth_arg_index) {
+  const auto type_source_info = var_decl->getTypeSourceInfo();
+  if (type_source_info == nullptr) {
+    return true;
+  }
+  TypeLoc type_loc = type_source_info->getTypeLoc().getUnqualifiedLoc();
+  if (const auto elaborated = type_loc.getAs<ElaboratedTypeLoc>()) {
+    type_loc = elaborated.getNamedTypeLoc();
+  }
+  // Types named otherwise, e.g., via a type alias, are taken as explicit.
+  if (const auto spec = type_loc.getAs<TemplateSpecializationTypeLoc>()) {
+    return spec.getNumArgs() > depth_arg_index;
+  }
+  return true;
+}
+
+string GetStreamImpl(const ClassTemplateSpecializationDecl* decl,
+                     unsigned impl_arg_index) {
+  const auto args = decl->getTemplateArgs().asArray();
+  if (args.size() > impl_arg_index &&
+      args[impl_arg_index].getKind() == TemplateArgument::Type) {
+    if (const auto record =
+            args[impl_arg_index].getAsType()->getAsRecordDecl()) {
+      const string name = record->getNameAsString();
+      if (name != "automatic") {
+        return name;
+      }
+    }
+  }
+  return "";
+}
+
 const ClassTemplateSpecializationDecl* GetTapaStreamDecl(const Type* type) {
   if (type != nullptr) {
     if (const auto record = type->getAsRecordDecl()) {
@@ -72,7 +135,8 @@ const ClassTemplateSpecializationDecl* GetTapaStreamsDecl(const Type* type) {
   if (type != nullptr) {
     if (const auto record = type->getAsRecordDecl()) {
       if (const auto decl = dyn_cast<ClassTemplateSpecializationDecl>(record)) {
-        if (IsTapaType(decl, "(i|o)?streams")) {
+        if (IsTapaType(decl,
+                       "((i|o)?streams|(broadcast|merge|distribute)_stream)")) {
           return decl;
         }
       }
@@ -86,3 +150,347 @@ const ClassTemplateSpecializationDecl* GetTapaStreamsDecl(
   return GetTapaStreamsDecl(
       qual_type.getUnqualifiedType().getCanonicalType().getTypePtr());
 }
+
+namespace {
+
+// Arithmetic on counts where -1 means unknown.
+int64_t AddCount(int64_t lhs, int64_t rhs) {
+  return lhs < 0 || rhs < 0 ? -1 : lhs + rhs;
+}
+int64_t MulCount(int64_t lhs, int64_t rhs) {
+  return lhs < 0 || rhs < 0 ? -1 : lhs * rhs;
+}
+
+bool EvalAsInt(const Expr* expr, const ASTContext& context, int64_t& value) {
+  Expr::EvalResult result;
+  if (expr == nullptr || !expr->EvaluateAsInt(result, context)) {
+    return false;
+  }
+  value = result.Val.getInt().getExtValue();
+  return true;
+}
+
+// Returns the variable referred to by `expr`, or nullptr if it is not a plain
+// variable reference.
+const ValueDecl* GetRefDecl(const Expr* expr) {
+  if (const auto ref = dyn_cast<DeclRefExpr>(expr->IgnoreParenImpCasts())) {
+    return ref->getDecl();
+  }
+  return nullptr;
+}
+
+// Returns the trip count of a canonical `for` loop, or -1 if unknown.
+int64_t GetTripCount(const Stmt* stmt, const ASTContext& context) {
+  const auto loop = dyn_cast<ForStmt>(stmt);
+  if (loop == nullptr) {
+    return -1;
+  }
+
+  // for (int i = begin; ...; ...) or for (i = begin; ...; ...)
+  const ValueDecl* var = nullptr;
+  int64_t begin = 0;
+  if (const auto decl_stmt = dyn_cast_or_null<DeclStmt>(loop->getInit())) {
+    if (decl_stmt->isSingleDecl()) {
+      if (const auto var_decl = dyn_cast<VarDecl>(decl_stmt->getSingleDecl())) {
+        if (EvalAsInt(var_decl->getInit(), context, begin)) {
+          var = var_decl;
+        }
+      }
+    }
+  } else if (const auto assign =
+                 dyn_cast_or_null<BinaryOperator>(loop->getInit())) {
+    if (assign->getOpcode() == clang::BO_Assign &&
+        EvalAsInt(assign->getRHS(), context, begin)) {
+      var = GetRefDecl(assign->getLHS());
+    }
+  }
+  if (var == nullptr || loop->getCond() == nullptr ||
+      loop->getInc() == nullptr) {
+    return -1;
+  }
+
+  // i < end, i <= end, or i != end
+  int64_t end = 0;
+  const auto cond =
+      dyn_cast<BinaryOperator>(loop->getCond()->IgnoreParenImpCasts());
+  if (cond == nullptr || GetRefDecl(cond->getLHS()) != var ||
+      !EvalAsInt(cond->getRHS(), context, end)) {
+    return -1;
+  }
+  switch (cond->getOpcode()) {
+    case clang::BO_LT:
+    case clang::BO_NE:
+      break;
+    case clang::BO_LE:
+      ++end;
+      break;
+    default:
+      return -1;
+  }
+
+  // ++i, i++, or i += step
+  int64_t step = 0;
+  const auto inc = loop->getInc()->IgnoreParenImpCasts();
+  if (const auto unary = dyn_cast<UnaryOperator>(inc)) {
+    if (unary->isIncrementOp() && GetRefDecl(unary->getSubExpr()) == var) {
+      step = 1;
+    }
+  } else if (const auto compound = dyn_cast<CompoundAssignOperator>(inc)) {
+    if (compound->getOpcode() == clang::BO_AddAssign &&
+        GetRefDecl(compound->getLHS()) == var) {
+      EvalAsInt(compound->getRHS(), context, step);
+    }
+  }
+  if (step <= 0) {
+    return -1;
+  }
+
+  if (end <= begin) {
+    return 0;
+  }
+  if (cond->getOpcode() == clang::BO_NE && (end - begin) % step != 0) {
+    return -1;
+  }
+  return (end - begin + step - 1) / step;
+}
+
+// Returns the number of tokens transferred by a stream operation, which is 0
+// for operations that only test the stream, or -1 if unknown. Non-blocking
+// operations are assumed to succeed.
+int64_t GetTokenCount(const CXXMemberCallExpr* op, const ASTContext& context) {
+  const auto method = op->getMethodDecl();
+  const string name = method->getNameAsString();
+  if (name == "read" || name == "write") {
+    // read(T* dst, size_t n) and write(const T* src, size_t n)
+    if (method->getNumParams() == 2 &&
+        method->getParamDecl(0)->getType()->isPointerType()) {
+      int64_t n = -1;
+      EvalAsInt(op->getArg(1), context, n);
+      return n;
+    }
+    return 1;
+  }
+  if (name == "try_read" || name == "try_write" || name == "open" ||
+      name == "try_open" || name == "close" || name == "try_close") {
+    return 1;
+  }
+  if (name == "try_read_burst" || name == "try_write_burst" ||
+      name == "read_transaction" || name == "write_transaction") {
+    return -1;
+  }
+  return 0;
+}
+
+// Body of a loop (or function) pipelined by `[[tapa::pipeline]]`, with the
+// number of tokens transferred via each port per iteration.
+struct PipelinedRegion {
+  int64_t ii;
+  map<string, int64_t> tokens;
+};
+
+class StreamRateVisitor {
+ public:
+  StreamRateVisitor(const ASTContext& context, map<string, StreamRate>& rates)
+      : context_{context}, rates_{rates} {}
+
+  void VisitFunction(const FunctionDecl* func) {
+    State state;
+    if (const auto attr = func->getAttr<TapaPipelineAttr>()) {
+      state.region = AddRegion(attr);
+    }
+    Visit(func->getBody(), state);
+
+    // Each port is rated by the pipelined region accessing it most often.
+    for (const auto& region : regions_) {
+      for (const auto& port : region.tokens) {
+        auto& rate = rates_[port.first];
+        if (rate.ii == 0 || (rate.tokens_per_iteration >= 0 &&
+                             (port.second < 0 ||
+                              port.second > rate.tokens_per_iteration))) {
+          rate.tokens_per_iteration = port.second;
+          rate.ii = region.ii;
+        }
+      }
+    }
+  }
+
+ private:
+  struct State {
+    // Product of the trip counts of the enclosing loops.
+    int64_t total_multiplier = 1;
+    // Same as above, but only of the loops nested in the pipelined region,
+    // which are unrolled.
+    int64_t region_multiplier = 1;
+    PipelinedRegion* region = nullptr;
+  };
+
+  PipelinedRegion* AddRegion(const TapaPipelineAttr* attr) {
+    // II defaults to 1 if not specified.
+    regions_.push_back({std::max<int64_t>(attr->getII(), 1), {}});
+    return &regions_.back();
+  }
+
+  static bool IsLoop(const Stmt* stmt) {
+    return llvm::isa<ForStmt>(stmt) || llvm::isa<WhileStmt>(stmt) ||
+           llvm::isa<DoStmt>(stmt);
+  }
+
+  void VisitChildren(const Stmt* stmt, const State& state) {
+    for (auto child : stmt->children()) {
+      Visit(child, state);
+    }
+  }
+
+  void Visit(const Stmt* stmt, State state) {
+    if (stmt == nullptr) {
+      return;
+    }
+
+    if (const auto attributed = dyn_cast<AttributedStmt>(stmt)) {
+      for (const auto attr : attributed->getAttrs()) {
+        if (const auto pipeline = dyn_cast<TapaPipelineAttr>(attr)) {
+          const auto sub_stmt = attributed->getSubStmt();
+          state.region = AddRegion(pipeline);
+          state.region_multiplier = 1;
+          if (IsLoop(sub_stmt)) {
+            // Iterations of the pipelined loop are what the region counts.
+            state.total_multiplier = MulCount(state.total_multiplier,
+                                              GetTripCount(sub_stmt, context_));
+            VisitChildren(sub_stmt, state);
+          } else {
+            Visit(sub_stmt, state);
+          }
+          return;
+        }
+      }
+    } else if (IsLoop(stmt)) {
+      const int64_t trip_count = GetTripCount(stmt, context_);
+      state.total_multiplier = MulCount(state.total_multiplier, trip_count);
+      state.region_multiplier = MulCount(state.region_multiplier, trip_count);
+    } else if (const auto op = dyn_cast<CXXMemberCallExpr>(stmt)) {
+      if (IsStreamInterface(op->getRecordDecl())) {
+        if (const auto port = GetRefDecl(op->getImplicitObjectArgument())) {
+          const auto count = GetTokenCount(op, context_);
+          const auto it = rates_.find(port->getNameAsString());
+          if (count != 0 && it != rates_.end()) {
+            // Operations in branches are counted as if always executed.
+            it->second.tokens = AddCount(
+                it->second.tokens, MulCount(state.total_multiplier, count));
+            if (state.region != nullptr) {
+              auto& tokens = state.region->tokens[it->first];
+              tokens = AddCount(tokens,
+                                MulCount(state.region_multiplier, count));
+            }
+          }
+        }
+      }
+    }
+
+    VisitChildren(stmt, state);
+  }
+
+  const ASTContext& context_;
+  map<string, StreamRate>& rates_;
+  deque<PipelinedRegion> regions_;  // stable addresses
+};
+
+// Returns whether `stmt` may call a member function on `port` for which
+// `is_target` returns true. Any use of `port` other than calling a member
+// function on it may make such a call, e.g., passing it to a helper.
+template <typename Pred>
+bool MayCall(const Stmt* stmt, const ValueDecl* port, const Pred& is_target) {
+  if (stmt == nullptr) {
+    return false;
+  }
+  if (const auto op = dyn_cast<CXXMemberCallExpr>(stmt)) {
+    if (GetRefDecl(op->getImplicitObjectArgument()) == port) {
+      if (is_target(op)) {
+        return true;
+      }
+      for (const auto arg : op->arguments()) {
+        if (MayCall(arg, port, is_target)) {
+          return true;
+        }
+      }
+      return false;
+    }
+  }
+  if (const auto ref = dyn_cast<DeclRefExpr>(stmt)) {
+    return ref->getDecl() == port;
+  }
+  for (const auto child : stmt->children()) {
+    if (MayCall(child, port, is_target)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns whether `stmt` may peek `port`.
+bool MayPeek(const Stmt* stmt, const ValueDecl* port) {
+  static const set<string> kPeekingMethods{
+      "peek", "try_peek", "eot", "try_eot", "try_open",
+  };
+  return MayCall(stmt, port, [](const CXXMemberCallExpr* op) {
+    return kPeekingMethods.count(op->getMethodDecl()->getNameAsString()) > 0;
+  });
+}
+
+// Returns whether `stmt` may read or write EoT tokens via `port`.
+bool MayUseEot(const Stmt* stmt, const ValueDecl* port) {
+  static const set<string> kEotMethods{
+      "eot",
+      "try_eot",
+      "open",
+      "try_open",
+      "close",
+      "try_close",
+      "read_transaction",
+      "write_transaction",
+  };
+  return MayCall(stmt, port, [](const CXXMemberCallExpr* op) {
+    const auto name = op->getMethodDecl()->getNameAsString();
+    // peek(is_success, is_eot)
+    return kEotMethods.count(name) > 0 ||
+           (name == "peek" && op->getNumArgs() == 2);
+  });
+}
+
+}  // namespace
+
+map<string, StreamRate> GetStreamRates(const FunctionDecl* func,
+                                       const ASTContext& context) {
+  map<string, StreamRate> rates;
+  for (const auto param : func->parameters()) {
+    if (IsStreamInterface(param)) {
+      rates[param->getNameAsString()];
+    }
+  }
+  if (func->hasBody()) {
+    StreamRateVisitor(context, rates).VisitFunction(func);
+  }
+  return rates;
+}
+
+bool IsStreamPeeked(const FunctionDecl* func, const ParmVarDecl* param) {
+  return !func->hasBody() || MayPeek(func->getBody(), param);
+}
+
+bool IsStreamEotUsed(const FunctionDecl* func, const ParmVarDecl* param) {
+  return !func->hasBody() || MayUseEot(func->getBody(), param);
+}
+
+vector<const CXXMemberCallExpr*> GetBlockingReads(const Stmt* body) {
+  vector<const CXXMemberCallExpr*> reads;
+  for (const auto op : GetTapaStreamOps(body)) {
+    if (!IsTapaType(op->getRecordDecl(), "istream") ||
+        op->getMethodDecl()->getNameAsString() != "read") {
+      continue;
+    }
+    if (op->getNumArgs() == 0 ||
+        (op->getNumArgs() == 1 && op->getArg(0)->getType()->isNullPtrType())) {
+      reads.push_back(op);
+    }
+  }
+  return reads;
+}
@@ -1,6 +1,8 @@
 #ifndef TAPA_STREAM_H_
 #define TAPA_STREAM_H_
 
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -28,6 +30,53 @@ const clang::ClassTemplateSpecializationDecl* GetTapaStreamsDecl(
 std::vector<const clang::CXXMemberCallExpr*> GetTapaStreamOps(
     const clang::Stmt* stmt);
 
+// Returns whether the depth of a stream (or streams) variable is written
+// explicitly as template argument #`depth_arg_index`, rather than taken from
+// the default, which tapac may replace with an inferred depth.
+bool IsStreamDepthExplicit(const clang::VarDecl* var_decl,
+                           unsigned depth_arg_index);
+
+// Returns the FIFO implementation of a stream (or streams) given as template
+// argument #`impl_arg_index` of `decl`, e.g., "srl", or an empty string if
+// tapac chooses it.
+std::string GetStreamImpl(const clang::ClassTemplateSpecializationDecl* decl,
+                          unsigned impl_arg_index);
+
+// Statically estimated traffic of a stream port of a lower-level task. Counts
+// are -1 if unknown.
+struct StreamRate {
+  // Number of tokens transferred per iteration of the pipelined loop (or
+  // function) accessing the port most often, or 0 if not pipelined.
+  int64_t tokens_per_iteration = 0;
+  // Initiation interval of that pipelined loop, or 0 if not pipelined.
+  int64_t ii = 0;
+  // Number of tokens transferred per invocation of the task, including EoT.
+  int64_t tokens = 0;
+};
+
+// Estimates the traffic of each stream parameter of `func` from the stream
+// operations, the `[[tapa::pipeline]]` attributes, and the trip counts of
+// canonical `for` loops, i.e., `for (int i = begin; i < end; ++i)`.
+std::map<std::string, StreamRate> GetStreamRates(
+    const clang::FunctionDecl* func, const clang::ASTContext& context);
+
+// Returns whether the lower-level task `func` may peek the istream `param`,
+// which only works if `param` is connected to a FIFO by tapac.
+bool IsStreamPeeked(const clang::FunctionDecl* func,
+                    const clang::ParmVarDecl* param);
+
+// Returns whether the lower-level task `func` may read or write EoT tokens via
+// the stream `param`. If neither end of a FIFO does, tapac drops the EoT bit
+// from the FIFO.
+bool IsStreamEotUsed(const clang::FunctionDecl* func,
+                     const clang::ParmVarDecl* param);
+
+// Returns the blocking reads of istreams, i.e., `read()` and `read(nullptr)`,
+// in the body of a loop, excluding those in nested loops. A pipelined loop
+// stalls at such a read whenever the stream is empty.
+std::vector<const clang::CXXMemberCallExpr*> GetBlockingReads(
+    const clang::Stmt* body);
+
 template <typename T>
 inline bool IsStreamInterface(T obj) {
   return IsTapaType(obj, "(i|o)stream");
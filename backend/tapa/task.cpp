@@ -1,13 +1,17 @@
 #include "task.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <regex>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "clang/AST/AST.h"
 #include "clang/Lex/Lexer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 
 #include "nlohmann/json.hpp"
 
@@ -21,18 +25,24 @@ using std::unordered_map;
 using std::vector;
 
 using clang::CharSourceRange;
+using clang::CompoundStmt;
+using clang::ContinueStmt;
 using clang::CXXBindTemporaryExpr;
+using clang::CXXConstructExpr;
 using clang::CXXMemberCallExpr;
 using clang::CXXMethodDecl;
 using clang::CXXOperatorCallExpr;
 using clang::DeclRefExpr;
 using clang::DeclStmt;
+using clang::DoStmt;
 using clang::Expr;
 using clang::ExprWithCleanups;
+using clang::ForStmt;
 using clang::FunctionDecl;
 using clang::ImplicitCastExpr;
 using clang::Lexer;
 using clang::MaterializeTemporaryExpr;
+using clang::ParmVarDecl;
 using clang::SourceLocation;
 using clang::SourceRange;
 using clang::Stmt;
@@ -40,7 +50,9 @@ using clang::StringLiteral;
 using clang::TapaTargetAttr;
 using clang::TemplateArgument;
 using clang::TemplateSpecializationType;
+using clang::ValueDecl;
 using clang::VarDecl;
+using clang::WhileStmt;
 
 using llvm::dyn_cast;
 using llvm::join;
@@ -58,10 +70,21 @@ static std::map<TapaTargetAttr::TargetType,
          {
              {TapaTargetAttr::VendorType::Xilinx,
               XilinxHLSTarget::GetInstance()},
+             {TapaTargetAttr::VendorType::Intel,
+              IntelHLSTarget::GetInstance()},
+         }},
+        // Host code does not depend on the vendor, which defaults to Xilinx.
+        {TapaTargetAttr::TargetType::CPU,
+         {
+             {TapaTargetAttr::VendorType::Xilinx,
+              CpuOptimizedTarget::GetInstance()},
          }},
     };
 
 extern const string* top_name;
+extern const string* default_target;
+extern bool loop_counters;
+extern bool nonblocking_reads;
 
 // Given a Stmt, find the first tapa::task in its children.
 const ExprWithCleanups* GetTapaTask(const Stmt* stmt) {
@@ -113,7 +136,9 @@ void Visitor::VisitTask(const clang::FunctionDecl* func) {
     target = attr->getTarget();
     vendor = attr->getVendor();
   } else {
-    target = TapaTargetAttr::TargetType::HLS;
+    if (!TapaTargetAttr::ConvertStrToTargetType(*default_target, target)) {
+      target = TapaTargetAttr::TargetType::HLS;
+    }
     vendor = TapaTargetAttr::VendorType::Xilinx;
   }
 
@@ -123,7 +148,7 @@ void Visitor::VisitTask(const clang::FunctionDecl* func) {
 
   if (target_map.find(target) == target_map.end() ||
       target_map[target].find(vendor) == target_map[target].end()) {
-    static const auto diagnostic_id =
+    const auto diagnostic_id =
         this->context_.getDiagnostics().getCustomDiagID(
             clang::DiagnosticsEngine::Error, "unsupported target: %0");
     this->context_.getDiagnostics()
@@ -135,9 +160,70 @@ void Visitor::VisitTask(const clang::FunctionDecl* func) {
     current_target = target_map[target][vendor];
   }
 
+  // An RTL task keeps its C++ body as the model for software simulation, and
+  // tapac instantiates the given Verilog module instead of running HLS.
+  if (auto attr = func->getAttr<clang::TapaRtlAttr>()) {
+    if (func->hasBody() && GetTapaTask(func->getBody()) != nullptr) {
+      auto& diagnostics = this->context_.getDiagnostics();
+      const auto diagnostic_id = diagnostics.getCustomDiagID(
+          clang::DiagnosticsEngine::Error,
+          "tapa::rtl is not supported for upper-level task %0");
+      diagnostics.Report(attr->getLocation(), diagnostic_id)
+          .AddString(func->getNameAsString());
+    }
+    // Relative paths are relative to the source file that declares the task.
+    llvm::SmallString<256> path(attr->getFile());
+    if (llvm::sys::path::is_relative(path)) {
+      path = llvm::sys::path::parent_path(
+          this->context_.getSourceManager().getFilename(attr->getLocation()));
+      llvm::sys::path::append(path, attr->getFile());
+    }
+    llvm::sys::fs::make_absolute(path);
+    llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+    metadata["rtl"] = string(path);
+  }
+
+  // A double-pumped task is synthesized and clocked at twice the frequency of
+  // the kernel clock by tapac.
+  if (auto attr = func->getAttr<clang::TapaDoublePumpAttr>()) {
+    if (func->hasBody() && GetTapaTask(func->getBody()) != nullptr) {
+      auto& diagnostics = this->context_.getDiagnostics();
+      const auto diagnostic_id = diagnostics.getCustomDiagID(
+          clang::DiagnosticsEngine::Error,
+          "tapa::double_pump is not supported for upper-level task %0");
+      diagnostics.Report(attr->getLocation(), diagnostic_id)
+          .AddString(func->getNameAsString());
+    }
+    metadata["double_pump"] = true;
+  }
+
   TraverseDecl(func->getASTContext().getTranslationUnitDecl());
 }
 
+string Visitor::GetFusedTaskCode(
+    const std::unordered_set<const FunctionDecl*>& fused_tasks,
+    StringRef fused_func) {
+  // Fused tasks are checked to be Xilinx HLS tasks.
+  current_task = nullptr;
+  current_target = XilinxHLSTarget::GetInstance();
+  fused_tasks_ = &fused_tasks;
+  auto& source_manager = context_.getSourceManager();
+  auto& rewriter = rewriters_[current_task] =
+      clang::Rewriter(source_manager, context_.getLangOpts());
+  TraverseDecl(context_.getTranslationUnitDecl());
+  rewriter.InsertText(
+      source_manager.getLocForEndOfFile(source_manager.getMainFileID()),
+      fused_func);
+
+  string code;
+  llvm::raw_string_ostream oss{code};
+  rewriter.getEditBuffer(source_manager.getMainFileID()).write(oss);
+  oss.flush();
+  rewriters_.erase(current_task);
+  fused_tasks_ = nullptr;
+  return code;
+}
+
 // Apply tapa s2s transformations on a function.
 bool Visitor::VisitFunctionDecl(FunctionDecl* func) {
   rewriting_func = nullptr;
@@ -163,6 +249,8 @@ bool Visitor::VisitFunctionDecl(FunctionDecl* func) {
           } else {
             ProcessLowerLevelTask(func);
           }
+        } else if (IsFusedTask(func)) {
+          // Keep the body as a dataflow process of the fused task.
         } else {
           current_target->RewriteFuncArguments(func, GetRewriter(),
                                                IsTapaTopLevel(func));
@@ -180,14 +268,50 @@ bool Visitor::VisitFunctionDecl(FunctionDecl* func) {
 }
 
 bool Visitor::VisitAttributedStmt(clang::AttributedStmt* stmt) {
-  if (current_task && rewriting_func == current_task &&
-      rewriters_.count(current_task) > 0) {
-    HandleAttrOnNodeWithBody(stmt, GetLoopBody(stmt->getSubStmt()),
-                             stmt->getAttrs());
+  if ((current_task && rewriting_func == current_task &&
+       rewriters_.count(current_task) > 0) ||
+      IsFusedTask(rewriting_func)) {
+    const auto body = GetLoopBody(stmt->getSubStmt());
+    HandleAttrOnNodeWithBody(stmt, body, stmt->getAttrs());
+    if (rewriting_func == current_task &&
+        GetTapaTask(current_task->getBody()) == nullptr) {
+      for (const auto* attr : stmt->getAttrs()) {
+        if (clang::isa<clang::TapaPipelineAttr>(attr)) {
+          CheckBlockingReads(stmt, body);
+        }
+      }
+    }
+    if (loop_counters && rewriting_func == current_task &&
+        GetTapaTask(current_task->getBody()) == nullptr &&
+        current_target == XilinxHLSTarget::GetInstance()) {
+      for (const auto* attr : stmt->getAttrs()) {
+        if (clang::isa<clang::TapaPipelineAttr>(attr)) {
+          AddLoopCounter(stmt, body);
+        }
+      }
+    }
   }
   return clang::RecursiveASTVisitor<Visitor>::VisitAttributedStmt(stmt);
 }
 
+bool Visitor::VisitVarDecl(clang::VarDecl* decl) {
+  if ((current_task && rewriting_func == current_task &&
+       rewriters_.count(current_task) > 0) ||
+      IsFusedTask(rewriting_func)) {
+    for (const auto* attr : decl->specific_attrs<clang::TapaPartitionAttr>()) {
+      current_target->RewritePartitionedDecl(decl, attr, GetRewriter());
+    }
+    for (const auto* attr : decl->specific_attrs<clang::TapaAxiAttr>()) {
+      current_target->RewriteAxiParam(decl, attr, GetRewriter());
+    }
+    if (!llvm::isa<clang::ParmVarDecl>(decl) &&
+        IsTapaType(decl->getType(), "local_array")) {
+      current_target->RewriteLocalArrayDecl(decl, GetRewriter());
+    }
+  }
+  return clang::RecursiveASTVisitor<Visitor>::VisitVarDecl(decl);
+}
+
 // Apply tapa s2s transformations on a upper-level task.
 void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
                                     const FunctionDecl* func) {
@@ -203,12 +327,22 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
   // Obtain the connection schema from the task.
   // metadata: {tasks, fifos}
   // tasks: {task_name: [{step, {args: port_name: {var_type, var_name}}}]}
-  // fifos: {fifo_name: {depth, produced_by, consumed_by}}
+  // fifos: {fifo_name: {depth, impl, produced_by, consumed_by}}
   auto& metadata = GetMetadata();
   metadata["fifos"] = json::object();
 
   for (const auto param : func->parameters()) {
     const auto param_name = param->getNameAsString();
+    if (IsTapaType(param, "(i|o)?buffer")) {
+      auto& diagnostics = context_.getDiagnostics();
+      const auto diagnostic_id = diagnostics.getCustomDiagID(
+          clang::DiagnosticsEngine::Error,
+          "tapa::buffer must be declared in the upper-level task that "
+          "invokes both of its endpoints: %0");
+      diagnostics.Report(param->getBeginLoc(), diagnostic_id)
+          .AddString(param_name);
+      continue;
+    }
     auto add_mmap_meta = [&](const string& name) {
       metadata["ports"].push_back(
           {{"name", name},
@@ -242,8 +376,10 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
     }
   }
 
-  // Process stream declarations.
+  // Process stream and buffer declarations.
+  // buffers: {buffer_name: {size, sections}}
   unordered_map<string, const VarDecl*> fifo_decls;
+  unordered_map<string, const VarDecl*> buffer_decls;
   for (const auto child : func->getBody()->children()) {
     if (const auto decl_stmt = dyn_cast<DeclStmt>(child)) {
       if (const auto var_decl = dyn_cast<VarDecl>(*decl_stmt->decl_begin())) {
@@ -253,16 +389,48 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
           const uint64_t fifo_depth{*args[1].getAsIntegral().getRawData()};
           const string var_name{var_decl->getNameAsString()};
           metadata["fifos"][var_name]["depth"] = fifo_depth;
+          if (!IsStreamDepthExplicit(var_decl, 1)) {
+            metadata["fifos"][var_name]["auto_depth"] = true;
+          }
+          const string impl = GetStreamImpl(decl, 2);
+          if (!impl.empty()) {
+            metadata["fifos"][var_name]["impl"] = impl;
+          }
           fifo_decls[var_name] = var_decl;
         } else if (auto decl = GetTapaStreamsDecl(var_decl->getType())) {
           const auto args = decl->getTemplateArgs().asArray();
           const string elem_type = GetTemplateArgName(args[0]);
           const uint64_t fifo_depth = *args[2].getAsIntegral().getRawData();
+          const string impl = GetStreamImpl(decl, 3);
           for (int i = 0; i < GetArraySize(decl); ++i) {
             const string var_name = ArrayNameAt(var_decl->getNameAsString(), i);
             metadata["fifos"][var_name]["depth"] = fifo_depth;
+            if (!IsStreamDepthExplicit(var_decl, 2)) {
+              metadata["fifos"][var_name]["auto_depth"] = true;
+            }
+            if (!impl.empty()) {
+              metadata["fifos"][var_name]["impl"] = impl;
+            }
+            // Each consumer of a broadcast or distribute stream, or each
+            // producer of a merge stream, gets a FIFO of its own, and tapac
+            // connects the other end to all FIFOs of the stream.
+            for (const string kind : {"broadcast", "merge", "distribute"}) {
+              if (IsTapaType(decl, kind + "_stream")) {
+                metadata["fifos"][var_name][kind] =
+                    var_decl->getNameAsString();
+              }
+            }
             fifo_decls[var_name] = var_decl;
           }
+        } else if (IsTapaType(var_decl->getType(), "buffer")) {
+          const auto decl = dyn_cast<clang::ClassTemplateSpecializationDecl>(
+              var_decl->getType()->getAsRecordDecl());
+          const auto args = decl->getTemplateArgs().asArray();
+          const string var_name{var_decl->getNameAsString()};
+          metadata["buffers"][var_name] = {
+              {"size", *args[1].getAsIntegral().getRawData()},
+              {"sections", *args[2].getAsIntegral().getRawData()}};
+          buffer_decls[var_name] = var_decl;
         }
       }
     }
@@ -274,6 +442,8 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
   unordered_map<string, int> istreams_access_pos;
   unordered_map<string, int> ostreams_access_pos;
   unordered_map<string, int> mmaps_access_pos;
+  // number of tasks that access each buffer as "ibuffer" or "obuffer"
+  unordered_map<string, unordered_map<string, int>> buffer_ends;
   unordered_map<const Expr*, int> seq_access_pos;
 
   for (auto invoke : invokes) {
@@ -295,7 +465,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
         has_name = true;
       }
     } else {
-      static const auto diagnostic_id =
+      const auto diagnostic_id =
           this->context_.getDiagnostics().getCustomDiagID(
               clang::DiagnosticsEngine::Error, "unexpected invocation: %0");
       this->context_.getDiagnostics()
@@ -306,7 +476,8 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
     string task_name;
     auto get_name = [&](const string& name, uint64_t i,
                         const DeclRefExpr* decl_ref) -> string {
-      if (IsTapaType(decl_ref, "(mmaps|(i|o)?streams)")) {
+      if (IsTapaType(decl_ref, "(mmaps|(i|o)?streams)") ||
+          IsTapaType(decl_ref, "(broadcast|merge|distribute)_stream")) {
         const auto ts_type =
             decl_ref->getType()->getAs<TemplateSpecializationType>();
         assert(ts_type != nullptr);
@@ -314,7 +485,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
         const auto length = this->EvalAsInt(ts_type->getArg(1).getAsExpr());
         if (i >= length) {
           auto& diagnostics = context_.getDiagnostics();
-          static const auto diagnostic_id =
+          const auto diagnostic_id =
               diagnostics.getCustomDiagID(clang::DiagnosticsEngine::Remark,
                                           "invocation #%0 accesses '%1[%2]'");
           auto diagnostics_builder =
@@ -402,7 +573,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
               // use global arg_name by default
               if (arg.empty()) arg = arg_name;
               if (metadata["fifos"][arg].contains("consumed_by")) {
-                static const auto diagnostic_id =
+                const auto diagnostic_id =
                     this->context_.getDiagnostics().getCustomDiagID(
                         clang::DiagnosticsEngine::Error,
                         "tapa::stream '%0' consumed more than once");
@@ -419,7 +590,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
               // use global arg_name by default
               if (arg.empty()) arg = arg_name;
               if (metadata["fifos"][arg].contains("produced_by")) {
-                static const auto diagnostic_id =
+                const auto diagnostic_id =
                     this->context_.getDiagnostics().getCustomDiagID(
                         clang::DiagnosticsEngine::Error,
                         "tapa::stream '%0' produced more than once");
@@ -438,11 +609,34 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
               register_arg(
                   get_name(arg_name, mmaps_access_pos[arg_name]++, decl_ref));
 
-            } else if (IsTapaType(param, "async_mmap")) {
+            } else if (IsTapaType(param,
+                                  "(cached_|burst_|atomic_)?async_mmap")) {
               param_cat = "async_mmap";
               // vector invocation can map mmaps to async_mmap
               register_arg(
                   get_name(arg_name, mmaps_access_pos[arg_name]++, decl_ref));
+              if (IsTapaType(param, "cached_async_mmap")) {
+                const auto cache = GetCacheGeometry(param);
+                (*metadata["tasks"][task_name].rbegin())["args"][param_name]
+                    ["cache"] = {{"lines", cache.first},
+                                 {"ways", cache.second}};
+              } else if (IsTapaType(param, "burst_async_mmap")) {
+                const auto burst = GetBurstPolicy(param);
+                (*metadata["tasks"][task_name].rbegin())["args"][param_name]
+                    ["burst"] = {{"len", burst.first},
+                                 {"wait", burst.second}};
+              } else if (IsTapaType(param, "atomic_async_mmap")) {
+                (*metadata["tasks"][task_name].rbegin())["args"][param_name]
+                    ["atomic"] = true;
+              }
+            } else if (IsTapaType(param, "istream") &&
+                       IsTapaType(decl_ref, "merge_stream")) {
+              param_cat = "istream";
+              // the consumer reads all FIFOs of a merge stream
+              for (int i = 0; i < GetArraySize(decl_ref->getType()); ++i) {
+                register_consumer(ArrayNameAt(arg_name, i));
+              }
+              register_arg();
             } else if (IsTapaType(param, "istream")) {
               param_cat = "istream";
               // vector invocation can map istreams to istream
@@ -450,6 +644,15 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
                   get_name(arg_name, istreams_access_pos[arg_name]++, decl_ref);
               register_consumer(arg);
               register_arg(arg);
+            } else if (IsTapaType(param, "ostream") &&
+                       IsTapaType(decl_ref, "(broadcast|distribute)_stream")) {
+              param_cat = "ostream";
+              // the producer writes all FIFOs of a broadcast or distribute
+              // stream
+              for (int i = 0; i < GetArraySize(decl_ref->getType()); ++i) {
+                register_producer(ArrayNameAt(arg_name, i));
+              }
+              register_arg();
             } else if (IsTapaType(param, "ostream")) {
               param_cat = "ostream";
               // vector invocation can map ostreams to ostream
@@ -473,6 +676,22 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
                 register_producer(arg);
                 register_arg(arg, ArrayNameAt(param_name, i));
               }
+            } else if (IsTapaType(param, "(i|o)buffer")) {
+              param_cat = IsTapaType(param, "ibuffer") ? "ibuffer" : "obuffer";
+              if (buffer_decls.count(arg_name) == 0) {
+                const auto diagnostic_id =
+                    this->context_.getDiagnostics().getCustomDiagID(
+                        clang::DiagnosticsEngine::Error,
+                        "tapa::%0 must be connected to a tapa::buffer "
+                        "declared in the same task");
+                auto diagnostics_builder =
+                    this->context_.getDiagnostics().Report(arg->getBeginLoc(),
+                                                           diagnostic_id);
+                diagnostics_builder.AddString(param_cat);
+                diagnostics_builder.AddSourceRange(GetCharSourceRange(arg));
+              }
+              ++buffer_ends[arg_name][param_cat];
+              register_arg();
             } else if (arg_is_seq) {
               param_cat = "scalar";
               register_arg("64'd" + std::to_string(seq_access_pos[arg]++));
@@ -489,7 +708,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
             continue;
           }
         }
-        static const auto diagnostic_id =
+        const auto diagnostic_id =
             this->context_.getDiagnostics().getCustomDiagID(
                 clang::DiagnosticsEngine::Error, "unexpected argument: %0");
         auto diagnostics_builder = this->context_.getDiagnostics().Report(
@@ -508,7 +727,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
     const auto fifo_decl = fifo_decls.find(fifo_name);
     auto& diagnostics = context_.getDiagnostics();
     if (!is_consumed && !is_produced) {
-      static const auto diagnostic_id = diagnostics.getCustomDiagID(
+      const auto diagnostic_id = diagnostics.getCustomDiagID(
           clang::DiagnosticsEngine::Warning, "unused stream: %0");
       auto diagnostics_builder =
           diagnostics.Report(fifo_decl->second->getBeginLoc(), diagnostic_id);
@@ -519,10 +738,10 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
     } else {
       ++fifo;
       if (fifo_decl != fifo_decls.end() && is_consumed != is_produced) {
-        static const auto consumed_diagnostic_id =
+        const auto consumed_diagnostic_id =
             diagnostics.getCustomDiagID(clang::DiagnosticsEngine::Error,
                                         "consumed but not produced stream: %0");
-        static const auto produced_diagnostic_id =
+        const auto produced_diagnostic_id =
             diagnostics.getCustomDiagID(clang::DiagnosticsEngine::Error,
                                         "produced but not consumed stream: %0");
         auto diagnostics_builder = diagnostics.Report(
@@ -534,11 +753,288 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
       }
     }
   }
+
+  // A buffer is connected to exactly one producer and one consumer.
+  for (const auto& buffer : buffer_decls) {
+    auto& ends = buffer_ends[buffer.first];
+    if (ends["ibuffer"] == 1 && ends["obuffer"] == 1) continue;
+    auto& diagnostics = context_.getDiagnostics();
+    const auto diagnostic_id = diagnostics.getCustomDiagID(
+        clang::DiagnosticsEngine::Error,
+        "buffer must be accessed by one tapa::ibuffer and one "
+        "tapa::obuffer: %0");
+    auto diagnostics_builder =
+        diagnostics.Report(buffer.second->getBeginLoc(), diagnostic_id);
+    diagnostics_builder.AddString(buffer.first);
+    diagnostics_builder.AddSourceRange(
+        GetCharSourceRange(buffer.second->getSourceRange()));
+  }
+}
+
+// For a pipelined loop `tapa_loop_<n>`, where `n` is its position in the
+// metadata, writes `tapa_loop_<n>_iter` once per iteration and
+// `tapa_loop_<n>_active` when the loop starts and finishes. Both ports are
+// `ap_vld`, so that tapac can count the iterations and the cycles in which the
+// running loop issues no iteration.
+//
+// metadata: {loops: [{name, line}]}
+void Visitor::AddLoopCounter(const clang::AttributedStmt* stmt,
+                             const clang::Stmt* body) {
+  auto& rewriter = GetRewriter();
+  auto& diagnostics = context_.getDiagnostics();
+  const auto loop = stmt->getSubStmt();
+  if (body == nullptr || !clang::isa<clang::CompoundStmt>(body) ||
+      loop->getBeginLoc().isMacroID() || loop->getEndLoc().isMacroID()) {
+    const auto diagnostic_id = diagnostics.getCustomDiagID(
+        clang::DiagnosticsEngine::Warning,
+        "loop is not counted; only loops with braces written outside macros "
+        "are counted");
+    diagnostics.Report(loop->getBeginLoc(), diagnostic_id);
+    return;
+  }
+
+  auto& source_manager = context_.getSourceManager();
+  auto& loops = GetMetadata()["loops"];
+  const string name = "tapa_loop_" + to_string(loops.size());
+  loops.push_back(
+      {{"name", name},
+       {"line", source_manager.getPresumedLineNumber(loop->getBeginLoc())}});
+
+  const auto func = current_task;
+  rewriter.InsertText(
+      func->getFunctionTypeLoc().getRParenLoc(),
+      string(func->getNumParams() > 0 || loops.size() > 1 ? ", " : "") +
+          "volatile bool& " + name + "_iter, volatile bool& " + name +
+          "_active");
+  rewriter.InsertTextAfterToken(
+      func->getBody()->getBeginLoc(),
+      "\n#pragma HLS interface ap_vld port = " + name +
+          "_iter\n#pragma HLS interface ap_vld port = " + name + "_active\n");
+  rewriter.InsertTextBefore(loop->getBeginLoc(),
+                            "{ " + name + "_active = true;\n");
+  rewriter.InsertTextAfterToken(loop->getEndLoc(),
+                                "\n; " + name + "_active = false; }");
+  rewriter.InsertTextAfterToken(
+      llvm::cast<clang::CompoundStmt>(body)->getLBracLoc(),
+      "\n" + name + "_iter = true;\n");
+}
+
+// Returns the number of references to `decl` in `stmt`.
+static int CountRefs(const Stmt* stmt, const ValueDecl* decl) {
+  if (stmt == nullptr) {
+    return 0;
+  }
+  int count = 0;
+  if (const auto ref = dyn_cast<DeclRefExpr>(stmt)) {
+    count += ref->getDecl() == decl;
+  }
+  for (const auto child : stmt->children()) {
+    count += CountRefs(child, decl);
+  }
+  return count;
+}
+
+// Returns whether `stmt` may continue the loop it is in.
+static bool MayContinue(const Stmt* stmt) {
+  if (stmt == nullptr || clang::isa<ForStmt>(stmt) ||
+      clang::isa<WhileStmt>(stmt) || clang::isa<DoStmt>(stmt)) {
+    return false;
+  }
+  if (clang::isa<ContinueStmt>(stmt)) {
+    return true;
+  }
+  for (const auto child : stmt->children()) {
+    if (MayContinue(child)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+string Visitor::GetBlockingReadsRewriteError(
+    const Stmt* loop, const CompoundStmt* body,
+    const vector<const CXXMemberCallExpr*>& reads) {
+  const Expr* cond = nullptr;
+  if (const auto for_stmt = dyn_cast<ForStmt>(loop)) {
+    cond = for_stmt->getCond();
+  } else if (const auto while_stmt = dyn_cast<WhileStmt>(loop)) {
+    cond = while_stmt->getCond();
+  } else {
+    return "only for and while loops are rewritten";
+  }
+  if (loop->getBeginLoc().isMacroID() || loop->getEndLoc().isMacroID()) {
+    return "loop is written in a macro";
+  }
+  if (!GetTapaStreamOps(cond).empty()) {
+    return "loop condition accesses streams";
+  }
+
+  // Hoisting other reads could reorder them with the other stream accesses,
+  // e.g., a read of the response to a request written earlier.
+  std::set<const Expr*> leading_reads;
+  for (const auto child : body->body()) {
+    const auto decl_stmt = dyn_cast<DeclStmt>(child);
+    if (decl_stmt == nullptr || !decl_stmt->isSingleDecl()) {
+      break;
+    }
+    const auto var = dyn_cast<VarDecl>(decl_stmt->getSingleDecl());
+    if (var == nullptr || var->getInit() == nullptr) {
+      break;
+    }
+    const Expr* init = var->getInit()->IgnoreImplicit();
+    if (const auto construct = dyn_cast<CXXConstructExpr>(init)) {
+      if (construct->getNumArgs() == 1) {
+        init = construct->getArg(0)->IgnoreImplicit();
+      }
+    }
+    if (std::find(reads.begin(), reads.end(), init) == reads.end()) {
+      break;
+    }
+    leading_reads.insert(init);
+  }
+  if (leading_reads.size() != reads.size()) {
+    return "only reads initializing the leading declarations of the loop body "
+           "are rewritten";
+  }
+
+  std::set<const ValueDecl*> ports;
+  for (const auto read : reads) {
+    const auto ref = dyn_cast<DeclRefExpr>(
+        read->getImplicitObjectArgument()->IgnoreParenImpCasts());
+    if (ref == nullptr || !clang::isa<ParmVarDecl>(ref->getDecl())) {
+      return "only reads of stream parameters are rewritten";
+    }
+    if (!ports.insert(ref->getDecl()).second ||
+        CountRefs(body, ref->getDecl()) > 1) {
+      return "'" + ref->getDecl()->getNameAsString() +
+             "' is accessed more than once in the loop body";
+    }
+  }
+
+  // The increment is moved into the loop body, which `continue` would skip.
+  if (clang::isa<ForStmt>(loop) && MayContinue(body)) {
+    return "loop body uses continue";
+  }
+  return "";
+}
+
+void Visitor::CheckBlockingReads(const clang::AttributedStmt* stmt,
+                                 const clang::Stmt* body) {
+  const auto reads = GetBlockingReads(body);
+  auto get_port = [this](const CXXMemberCallExpr* read) {
+    return Lexer::getSourceText(
+               CharSourceRange::getTokenRange(
+                   read->getImplicitObjectArgument()->getSourceRange()),
+               context_.getSourceManager(), context_.getLangOpts())
+        .str();
+  };
+  std::set<string> ports;
+  for (const auto read : reads) {
+    ports.insert(get_port(read));
+  }
+  if (ports.size() < 2) {
+    return;
+  }
+
+  auto& diagnostics = context_.getDiagnostics();
+  const auto loop = stmt->getSubStmt();
+  const string port_list = join(ports, ", ");
+  if (!nonblocking_reads) {
+    const auto diagnostic_id = diagnostics.getCustomDiagID(
+        clang::DiagnosticsEngine::Warning,
+        "pipelined loop stalls whenever any of the streams it blocks on is "
+        "empty: %0; use try_read or -nonblocking-reads");
+    diagnostics.Report(loop->getBeginLoc(), diagnostic_id) << port_list;
+    return;
+  }
+
+  const auto compound = dyn_cast<CompoundStmt>(body);
+  const string error =
+      compound == nullptr ? "loop body has no braces"
+                          : GetBlockingReadsRewriteError(loop, compound, reads);
+  if (!error.empty()) {
+    const auto diagnostic_id = diagnostics.getCustomDiagID(
+        clang::DiagnosticsEngine::Warning,
+        "blocking reads of %0 are not made non-blocking: %1");
+    diagnostics.Report(loop->getBeginLoc(), diagnostic_id)
+        << port_list << error;
+    return;
+  }
+
+  // Each stream is read into its skid register as soon as it has data, and
+  // the original loop body runs once all registers are filled.
+  auto& rewriter = GetRewriter();
+  string decls = "{\n";
+  string prologue = "\n";
+  string all_valid;
+  string reset;
+  for (const auto read : reads) {
+    const auto param = llvm::cast<ParmVarDecl>(
+        llvm::cast<DeclRefExpr>(
+            read->getImplicitObjectArgument()->IgnoreParenImpCasts())
+            ->getDecl());
+    const string port = param->getNameAsString();
+    const string reg = "tapa_skid_" + port;
+    const string valid = reg + "_valid";
+    decls += GetStreamElemType(param) + " " + reg + ";\nbool " + valid +
+             " = false;\n";
+    prologue += "if (!" + valid + ") " + valid + " = " + port + ".try_read(" +
+                reg + ");\n";
+    all_valid += (all_valid.empty() ? "" : " && ") + valid;
+    reset += valid + " = false;\n";
+    rewriter.ReplaceText(read->getSourceRange(), reg);
+  }
+  prologue += "if (!(" + all_valid + ")) continue;\n" + reset;
+  rewriter.InsertTextBefore(loop->getBeginLoc(), decls);
+  rewriter.InsertTextAfterToken(loop->getEndLoc(), "\n}");
+  rewriter.InsertTextAfterToken(compound->getLBracLoc(), prologue);
+  if (const auto for_stmt = dyn_cast<ForStmt>(loop)) {
+    if (const auto inc = for_stmt->getInc()) {
+      // The loop advances only when the body runs.
+      rewriter.InsertTextBefore(
+          compound->getRBracLoc(),
+          rewriter.getRewrittenText(inc->getSourceRange()) + ";\n");
+      rewriter.RemoveText(inc->getSourceRange());
+    }
+  }
+
+  const auto diagnostic_id =
+      diagnostics.getCustomDiagID(clang::DiagnosticsEngine::Remark,
+                                  "blocking reads of %0 are made non-blocking");
+  diagnostics.Report(loop->getBeginLoc(), diagnostic_id) << port_list;
 }
 
 // Apply tapa s2s transformations on a lower-level task.
 void Visitor::ProcessLowerLevelTask(const FunctionDecl* func) {
   current_target->RewriteLowerLevelFunc(func, GetRewriter());
+
+  // Estimate the stream traffic so that FIFO rates can be checked before HLS.
+  // streams: {port_name: {tokens_per_iteration, ii, tokens, eot}}, where counts
+  // are null if unknown
+  auto& metadata = GetMetadata();
+  auto to_json = [](int64_t count) -> json {
+    return count < 0 ? json() : json(count);
+  };
+  int64_t task_ii = 0;
+  for (const auto& port : GetStreamRates(func, context_)) {
+    const auto& rate = port.second;
+    auto& port_meta = metadata["streams"][port.first];
+    port_meta["tokens_per_iteration"] =
+        rate.ii > 0 ? to_json(rate.tokens_per_iteration) : json();
+    port_meta["ii"] = rate.ii > 0 ? json(rate.ii) : json();
+    port_meta["tokens"] = to_json(rate.tokens);
+    task_ii = std::max(task_ii, rate.ii);
+  }
+  // The slowest pipelined loop accessing streams bounds the task.
+  metadata["ii"] = task_ii > 0 ? json(task_ii) : json();
+
+  // FIFOs whose ends never use EoT need not store the EoT bit.
+  for (const auto param : func->parameters()) {
+    if (IsStreamInterface(param)) {
+      metadata["streams"][param->getNameAsString()]["eot"] =
+          IsStreamEotUsed(func, param);
+    }
+  }
 }
 
 string Visitor::GetFrtInterface(const FunctionDecl* func) {
@@ -674,7 +1170,7 @@ int64_t Visitor::EvalAsInt(const Expr* expr) {
   if (expr->EvaluateAsInt(result, this->context_)) {
     return result.Val.getInt().getExtValue();
   }
-  static const auto diagnostic_id =
+  const auto diagnostic_id =
       this->context_.getDiagnostics().getCustomDiagID(
           clang::DiagnosticsEngine::Error,
           "fail to evaluate as integer at compile time");
@@ -700,6 +1196,15 @@ void Visitor::HandleAttrOnNodeWithBody(
   for (const auto* attr : attrs) {
     if (clang::isa<clang::TapaPipelineAttr>(attr)) {
       HANDLE_ATTR(RewritePipelinedDecl, RewritePipelinedStmt);
+    } else if (std::is_base_of<clang::Stmt, T>()) {
+      // Loop hints only apply to statements.
+      const auto stmt = (const clang::Stmt*)(node);
+      if (clang::isa<clang::TapaTripcountAttr>(attr)) {
+        current_target->RewriteTripcountStmt(stmt, attr, GetRewriter(), body);
+      } else if (clang::isa<clang::TapaIndependentAttr>(attr)) {
+        current_target->RewriteIndependentStmt(stmt, attr, GetRewriter(),
+                                               body);
+      }
     }
   }
 }
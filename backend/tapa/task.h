@@ -39,9 +39,18 @@ class Visitor : public clang::RecursiveASTVisitor<Visitor> {
 
   bool VisitAttributedStmt(clang::AttributedStmt* stmt);
   bool VisitFunctionDecl(clang::FunctionDecl* func);
+  bool VisitVarDecl(clang::VarDecl* decl);
 
   void VisitTask(const clang::FunctionDecl* func);
 
+  // Returns the code of a task fusing the lower-level tasks `fused_tasks`,
+  // whose bodies are kept as dataflow processes of `fused_func`, which is
+  // appended to the main file. Other tasks are reduced to declarations.
+  // `fused_tasks` is empty for tasks generated from scratch.
+  std::string GetFusedTaskCode(
+      const std::unordered_set<const clang::FunctionDecl*>& fused_tasks,
+      llvm::StringRef fused_func);
+
  private:
   static thread_local const clang::FunctionDecl* rewriting_func;
   static thread_local const clang::FunctionDecl* current_task;
@@ -51,8 +60,13 @@ class Visitor : public clang::RecursiveASTVisitor<Visitor> {
   std::vector<const clang::FunctionDecl*>& funcs_;
   std::unordered_map<const clang::FunctionDecl*, clang::Rewriter>& rewriters_;
   std::unordered_map<const clang::FunctionDecl*, nlohmann::json>& metadata_;
+  // Tasks being fused by `GetFusedTaskCode`, or nullptr.
+  const std::unordered_set<const clang::FunctionDecl*>* fused_tasks_{nullptr};
 
   clang::Rewriter& GetRewriter() { return rewriters_[current_task]; }
+  bool IsFusedTask(const clang::FunctionDecl* func) const {
+    return fused_tasks_ != nullptr && fused_tasks_->count(func) > 0;
+  }
   nlohmann::json& GetMetadata() {
     if (metadata_[current_task].is_null())
       metadata_[current_task] = nlohmann::json::object();
@@ -63,6 +77,21 @@ class Visitor : public clang::RecursiveASTVisitor<Visitor> {
                              const clang::FunctionDecl* func);
 
   void ProcessLowerLevelTask(const clang::FunctionDecl* func);
+  // Adds output ports to the current task that signal each iteration of a
+  // pipelined loop and whether the loop is running, if `-loop-counters` is
+  // set; see `loops` in the metadata.
+  void AddLoopCounter(const clang::AttributedStmt* stmt,
+                      const clang::Stmt* body);
+  // Warns about a pipelined loop that blocks on reads of several streams, and
+  // if `-nonblocking-reads` is set, rewrites the reads with `try_read` into
+  // skid registers so that each stream is drained as soon as it has data.
+  void CheckBlockingReads(const clang::AttributedStmt* stmt,
+                          const clang::Stmt* body);
+  // Returns why the blocking reads in `body` of `loop` cannot be rewritten by
+  // `CheckBlockingReads`, or an empty string if they can.
+  std::string GetBlockingReadsRewriteError(
+      const clang::Stmt* loop, const clang::CompoundStmt* body,
+      const std::vector<const clang::CXXMemberCallExpr*>& reads);
   std::string GetFrtInterface(const clang::FunctionDecl* func);
 
   clang::CharSourceRange GetCharSourceRange(const clang::Stmt* stmt);
@@ -4,6 +4,7 @@
 #include <sstream>
 #include <string>
 #include <type_traits>
+#include <utility>
 
 #include "clang/AST/AST.h"
 
@@ -58,6 +59,28 @@ inline uint64_t GetArraySize(const clang::ParmVarDecl* param) {
   return GetArraySize(param->getType());
 }
 
+// Returns the number of lines and ways of a tapa::cached_async_mmap.
+inline std::pair<uint64_t, uint64_t> GetCacheGeometry(
+    const clang::ParmVarDecl* param) {
+  auto type = param->getType();
+  if (auto ref = type->getAs<clang::LValueReferenceType>()) {
+    type = ref->getPointeeType();
+  }
+  // Default template arguments are only available from the specialization.
+  const auto& args = clang::dyn_cast<clang::ClassTemplateSpecializationDecl>(
+                         type->getAsRecordDecl())
+                         ->getTemplateArgs();
+  return {args[1].getAsIntegral().getZExtValue(),
+          args[2].getAsIntegral().getZExtValue()};
+}
+
+// Returns the burst length and wait cycles of a tapa::burst_async_mmap.
+inline std::pair<uint64_t, uint64_t> GetBurstPolicy(
+    const clang::ParmVarDecl* param) {
+  // Same template argument layout as tapa::cached_async_mmap.
+  return GetCacheGeometry(param);
+}
+
 const clang::TemplateArgument* GetTemplateArg(clang::QualType type, int idx);
 
 inline std::string GetTemplateArgName(const clang::TemplateArgument& arg) {
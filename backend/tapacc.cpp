@@ -1,18 +1,30 @@
+#include <algorithm>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <queue>
 #include <regex>
+#include <set>
 #include <string>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #include "clang/AST/AST.h"
-#include "clang/AST/ASTConsumer.h"
-#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/FrontendActions.h"
 #include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
 
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/WithColor.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "nlohmann/json.hpp"
@@ -20,9 +32,13 @@
 #include "tapa/task.h"
 
 using std::make_shared;
+using std::map;
+using std::pair;
+using std::queue;
 using std::regex;
 using std::regex_match;
 using std::regex_replace;
+using std::set;
 using std::shared_ptr;
 using std::stoi;
 using std::string;
@@ -30,19 +46,22 @@ using std::tie;
 using std::tuple;
 using std::unique_ptr;
 using std::unordered_map;
+using std::unordered_set;
 using std::vector;
 
-using clang::ASTConsumer;
 using clang::ASTContext;
-using clang::ASTFrontendAction;
-using clang::CompilerInstance;
+using clang::ASTUnit;
+using clang::FileEntry;
 using clang::FunctionDecl;
 using clang::Rewriter;
+using clang::SourceManager;
 using clang::StringRef;
 using clang::tooling::ClangTool;
 using clang::tooling::CommonOptionsParser;
-using clang::tooling::newFrontendActionFactory;
 
+using llvm::MD5;
+using llvm::ThreadPool;
+using llvm::WithColor;
 using llvm::raw_string_ostream;
 using llvm::cl::NumOccurrencesFlag;
 using llvm::cl::OptionCategory;
@@ -54,69 +73,109 @@ namespace tapa {
 namespace internal {
 
 const string* top_name;
+const string* default_target;
+bool loop_counters;
+bool nonblocking_reads;
+bool ap_ctrl_chain;
+const map<string, uint64_t>* specialized_scalars;
 
-class Consumer : public ASTConsumer {
+// Adds `data` to `hash`, prefixed by its length so that consecutive updates
+// cannot be confused with each other.
+void UpdateHash(MD5& hash, StringRef data) {
+  hash.update(std::to_string(data.size()));
+  hash.update(StringRef("\0", 1));
+  hash.update(data);
+}
+
+// Returns the hex digest of the names and contents of all user headers
+// included in the translation unit, i.e., excluding the main file and system
+// headers.
+string GetHeadersHash(const SourceManager& source_manager) {
+  vector<const FileEntry*> headers;
+  for (auto it = source_manager.fileinfo_begin();
+       it != source_manager.fileinfo_end(); ++it) {
+    headers.push_back(it->first);
+  }
+  std::sort(headers.begin(), headers.end(),
+            [](const FileEntry* lhs, const FileEntry* rhs) {
+              return lhs->getName() < rhs->getName();
+            });
+  MD5 hash;
+  for (auto header : headers) {
+    const auto file_id = source_manager.translateFile(header);
+    if (file_id.isInvalid() || file_id == source_manager.getMainFileID() ||
+        source_manager.isInSystemHeader(
+            source_manager.getLocForStartOfFile(file_id))) {
+      continue;
+    }
+    UpdateHash(hash, header->getName());
+    UpdateHash(hash, source_manager.getBufferData(file_id));
+  }
+  MD5::MD5Result result;
+  hash.final(result);
+  return result.digest().str();
+}
+
+// Returns the hex digest of everything HLS sees of a task, i.e., its rewritten
+// code, the user headers, and the compiler flags. Tasks whose hashes are
+// unchanged need not be synthesized again.
+string GetTaskHash(StringRef code, StringRef headers_hash, StringRef cflags) {
+  MD5 hash;
+  UpdateHash(hash, code);
+  UpdateHash(hash, headers_hash);
+  UpdateHash(hash, cflags);
+  MD5::MD5Result result;
+  hash.final(result);
+  return result.digest().str();
+}
+
+// Tasks of one translation unit. Tasks may invoke tasks defined in other
+// translation units, so they are extracted in two steps: `CollectFuncs` lists
+// the candidates defined here, and `ExtractTasks` rewrites those found to be
+// reachable from the top-level task across all translation units.
+class TranslationUnit {
  public:
-  explicit Consumer(ASTContext& context, vector<const FunctionDecl*>& funcs)
-      : visitor_{context, funcs, rewriters_, metadata_}, funcs_{funcs} {}
-  void HandleTranslationUnit(ASTContext& context) override {
+  TranslationUnit(unique_ptr<ASTUnit> ast, string cflags)
+      : ast_{std::move(ast)},
+        cflags_{std::move(cflags)},
+        visitor_{ast_->getASTContext(), funcs_, rewriters_, metadata_} {}
+
+  // Returns the global functions defined in the main file, which are the
+  // candidate tasks, each with the names of the tasks it invokes.
+  vector<pair<string, vector<string>>> CollectFuncs() {
     // First pass traversal extracts all global functions as potential tasks.
     // this->funcs_ stores all potential tasks.
-    visitor_.TraverseDecl(context.getTranslationUnitDecl());
-
-    // Look for the top-level task. Starting from there, find all tasks using
-    // DFS.
-    // Note that task functions cannot share the same name.
-    auto& diagnostics_engine = context.getDiagnostics();
-    if (top_name == nullptr) {
-      static const auto diagnostic_id = diagnostics_engine.getCustomDiagID(
-          clang::DiagnosticsEngine::Fatal, "top not set");
-      diagnostics_engine.Report(diagnostic_id);
-    }
-    unordered_map<string, vector<const FunctionDecl*>> func_table;
+    visitor_.TraverseDecl(ast_->getASTContext().getTranslationUnitDecl());
+
+    vector<pair<string, vector<string>>> funcs;
     for (auto func : funcs_) {
       auto func_name = func->getNameAsString();
       // If a key exists, its corresponding value won't be empty.
-      func_table[func_name].push_back(func);
-    }
-    static const auto task_redefined = diagnostics_engine.getCustomDiagID(
-        clang::DiagnosticsEngine::Error, "task '%0' re-defined");
-    static const auto task_defined_here = diagnostics_engine.getCustomDiagID(
-        clang::DiagnosticsEngine::Note, "task '%0' defined here");
-    auto report_task_redefinition =
-        [&](const vector<const FunctionDecl*>& decls) {
-          if (decls.size() > 1) {
-            {
-              auto diagnostics_builder =
-                  diagnostics_engine.Report(task_redefined);
-              diagnostics_builder.AddString(decls[0]->getNameAsString());
-            }
-            /*
-            for (auto decl : decls) {
-              auto diagnostics_builder = diagnostics_engine.Report(
-                  decl->getBeginLoc(), task_defined_here);
-              diagnostics_builder.AddSourceRange(
-                  CharSourceRange::getCharRange(decl->getSourceRange()));
-              diagnostics_builder.AddString(decl->getNameAsString());
-            }
-            */
-          }
-        };
-    if (func_table.count(*top_name)) {
-      auto tasks = FindAllTasks(func_table[*top_name][0]);
-      funcs_.clear();
-      for (auto task : tasks) {
-        auto task_name = task->getNameAsString();
-        report_task_redefinition(func_table[task_name]);
-        funcs_.push_back(func_table[task_name][0]);
-        rewriters_[task] =
-            Rewriter(context.getSourceManager(), context.getLangOpts());
+      func_table_[func_name].push_back(func);
+      vector<string> children;
+      for (auto child : FindChildrenTasks(func)) {
+        children.push_back(child->getNameAsString());
       }
-    } else {
-      static const auto top_not_found = diagnostics_engine.getCustomDiagID(
-          clang::DiagnosticsEngine::Fatal, "top-level task '%0' not found");
-      auto diagnostics_builder = diagnostics_engine.Report(top_not_found);
-      diagnostics_builder.AddString(*top_name);
+      funcs.emplace_back(func_name, std::move(children));
+    }
+    return funcs;
+  }
+
+  // Rewrites the functions named in `task_names`, which must be defined here,
+  // and returns their code and metadata as the "tasks" section.
+  json ExtractTasks(const vector<string>& task_names) {
+    auto& context = ast_->getASTContext();
+    auto& diagnostics_client = *context.getDiagnostics().getClient();
+    // Parsing has ended the source file for the diagnostics client.
+    diagnostics_client.BeginSourceFile(ast_->getLangOpts(),
+                                       &ast_->getPreprocessor());
+
+    funcs_.clear();
+    for (const auto& task_name : task_names) {
+      auto task = func_table_[task_name][0];
+      funcs_.push_back(task);
+      rewriters_[task] =
+          Rewriter(context.getSourceManager(), context.getLangOpts());
     }
 
     // funcs_ has been reset to only contain the tasks.
@@ -125,7 +184,8 @@ class Consumer : public ASTConsumer {
       visitor_.VisitTask(task);
     }
     unordered_map<const FunctionDecl*, string> code_table;
-    json code;
+    const string headers_hash = GetHeadersHash(context.getSourceManager());
+    json tasks = json::object();
     for (auto task : funcs_) {
       auto task_name = task->getNameAsString();
       raw_string_ostream oss{code_table[task]};
@@ -133,46 +193,1316 @@ class Consumer : public ASTConsumer {
           .getEditBuffer(rewriters_[task].getSourceMgr().getMainFileID())
           .write(oss);
       oss.flush();
-      code["tasks"][task_name]["code"] = code_table[task];
+      tasks[task_name]["code"] = code_table[task];
+      tasks[task_name]["hash"] =
+          GetTaskHash(code_table[task], headers_hash, cflags_);
       bool is_upper = GetTapaTask(task->getBody()) != nullptr;
-      code["tasks"][task_name]["level"] = is_upper ? "upper" : "lower";
-      code["tasks"][task_name].update(metadata_[task]);
+      tasks[task_name]["level"] = is_upper ? "upper" : "lower";
+      tasks[task_name].update(metadata_[task]);
+    }
+
+    diagnostics_client.EndSourceFile();
+    return tasks;
+  }
+
+  // Returns whether the lower-level task `task_name` may peek its istream
+  // `port`.
+  bool IsStreamPeeked(const string& task_name, const string& port) {
+    const auto func = func_table_[task_name][0];
+    for (const auto param : func->parameters()) {
+      if (param->getNameAsString() == port) {
+        return ::IsStreamPeeked(func, param);
+      }
     }
-    code["top"] = *top_name;
-    std::cout << code;
+    return true;
+  }
+
+  // Returns the code and metadata of a lower-level task `name` that runs
+  // `instances` as dataflow processes. Each instance is given as its task name
+  // and the argument of each parameter, which is either a FIFO local to the
+  // fused task, listed in `fifos` with its depth, or a parameter of the fused
+  // task.
+  json FuseTasks(const string& name,
+                 const vector<pair<string, map<string, string>>>& instances,
+                 const map<string, uint64_t>& fifos) {
+    auto& context = ast_->getASTContext();
+    auto target = XilinxHLSTarget::GetInstance();
+    unordered_set<const FunctionDecl*> fused_tasks;
+    unordered_set<string> declared_fifos;
+    vector<string> params;
+    vector<string> lines;
+    vector<string> fifo_lines;
+    vector<string> call_lines;
+    for (const auto& instance : instances) {
+      const auto func = func_table_[instance.first][0];
+      fused_tasks.insert(func);
+      vector<string> args;
+      for (const auto param : func->parameters()) {
+        const auto& arg = instance.second.at(param->getNameAsString());
+        const auto fifo = fifos.find(arg);
+        if (fifo != fifos.end()) {
+          if (declared_fifos.insert(arg).second) {
+            fifo_lines.push_back("tapa::internal::fused_stream<" +
+                                 GetStreamElemType(param) + "> " + arg + ";");
+            fifo_lines.push_back("#pragma HLS stream variable = " +
+                                 GetFifoVar(arg) + " depth = " +
+                                 std::to_string(fifo->second));
+          }
+          args.push_back(IsTapaType(param, "ostream") ? arg + ".producer()"
+                                                      : arg);
+          continue;
+        }
+
+        params.push_back(
+            param->getType().getAsString(context.getPrintingPolicy()) + " " +
+            arg);
+        args.push_back(arg);
+
+        // Generate the interface of the fused task parameter as if it were
+        // the parameter of the lower-level task.
+        const regex param_name{"\\b" + param->getNameAsString() + "\\b"};
+        auto add_line = [&](StringRef line) {
+          lines.push_back(regex_replace(line.str(), param_name, arg));
+        };
+        auto add_pragma = [&](std::initializer_list<StringRef> pragma_args) {
+          add_line("#pragma " + llvm::join(pragma_args, " "));
+        };
+        if (IsStreamInterface(param)) {
+          target->AddCodeForLowerLevelStream(param, add_line, add_pragma);
+        } else {
+          target->AddCodeForLowerLevelScalar(param, add_line, add_pragma);
+        }
+      }
+      call_lines.push_back(func->getNameAsString() + "(" +
+                           llvm::join(args, ", ") + ");");
+    }
+
+    lines.push_back("");
+    lines.push_back("#pragma HLS dataflow");
+    lines.insert(lines.end(), fifo_lines.begin(), fifo_lines.end());
+    lines.insert(lines.end(), call_lines.begin(), call_lines.end());
+    const string fused_func = "\nvoid " + name + "(" +
+                              llvm::join(params, ", ") + ") {\n" +
+                              llvm::join(lines, "\n") + "\n}\n";
+
+    json task;
+    task["code"] = visitor_.GetFusedTaskCode(fused_tasks, fused_func);
+    task["hash"] =
+        GetTaskHash(task["code"].get<string>(),
+                    GetHeadersHash(context.getSourceManager()), cflags_);
+    task["level"] = "lower";
+    task["target"] = "hls";
+    task["vendor"] = "xilinx";
+    return task;
+  }
+
+  // Returns the code and hash of a lower-level task `name` that runs the
+  // lower-level task `task_name` with each parameter in `constants` bound to
+  // its value, or null if a bound parameter is not of an integral type. The
+  // task is inlined into the new task so that HLS can propagate the constants
+  // into its body.
+  json SpecializeTask(const string& task_name, const string& name,
+                      const map<string, uint64_t>& constants) {
+    auto& context = ast_->getASTContext();
+    auto target = XilinxHLSTarget::GetInstance();
+    const auto func = func_table_[task_name][0];
+    vector<string> params;
+    vector<string> args;
+    vector<string> lines{""};
+    auto add_line = [&](StringRef line) { lines.push_back(line); };
+    auto add_pragma = [&](std::initializer_list<StringRef> pragma_args) {
+      add_line("#pragma " + llvm::join(pragma_args, " "));
+    };
+    for (const auto param : func->parameters()) {
+      const auto param_name = param->getNameAsString();
+      const auto param_type =
+          param->getType().getAsString(context.getPrintingPolicy());
+      const auto constant = constants.find(param_name);
+      if (constant != constants.end()) {
+        if (!param->getType()->isIntegralOrEnumerationType()) {
+          return nullptr;
+        }
+        args.push_back("static_cast<" +
+                       param->getType()
+                           .getNonReferenceType()
+                           .getUnqualifiedType()
+                           .getAsString(context.getPrintingPolicy()) +
+                       ">(" + std::to_string(constant->second) + "ULL)");
+        continue;
+      }
+
+      params.push_back(param_type + " " + param_name);
+      args.push_back(param_name);
+      if (IsTapaType(param, "(i|o)streams?")) {
+        target->AddCodeForLowerLevelStream(param, add_line, add_pragma);
+      } else if (IsTapaType(param, "(cached_|burst_|atomic_)?async_mmaps?")) {
+        target->AddCodeForLowerLevelAsyncMmap(param, add_line, add_pragma);
+      } else if (IsTapaType(param, "mmaps?")) {
+        target->AddCodeForLowerLevelMmap(param, add_line, add_pragma);
+      } else {
+        target->AddCodeForLowerLevelScalar(param, add_line, add_pragma);
+      }
+    }
+    lines.push_back("");
+    lines.push_back("#pragma HLS inline recursive");
+    lines.push_back(task_name + "(" + llvm::join(args, ", ") + ");");
+    const string code = "\nvoid " + name + "(" + llvm::join(params, ", ") +
+                        ") {\n" + llvm::join(lines, "\n") + "\n}\n";
+    json task;
+    task["code"] = visitor_.GetFusedTaskCode({func}, code);
+    task["hash"] =
+        GetTaskHash(task["code"].get<string>(),
+                    GetHeadersHash(context.getSourceManager()), cflags_);
+    return task;
+  }
+
+  // Returns the code and metadata of the tasks `<task_name>__scatter` and
+  // `<task_name>__gather` for `factor` replicas of the lower-level task
+  // `task_name`. The scatter task sends the tokens of the only istream of the
+  // task to the replicas round-robin, and the gather task collects the tokens
+  // of the only ostream of the replicas in the same order. So the order of
+  // tokens is kept if each replica produces one token per token consumed.
+  pair<json, json> GenerateScatterGather(const string& task_name, int factor) {
+    auto& context = ast_->getASTContext();
+    auto target = XilinxHLSTarget::GetInstance();
+    const auto func = func_table_[task_name][0];
+    const clang::ParmVarDecl* in_param = nullptr;
+    const clang::ParmVarDecl* out_param = nullptr;
+    for (const auto param : func->parameters()) {
+      if (IsTapaType(param, "istream")) {
+        in_param = param;
+      } else if (IsTapaType(param, "ostream")) {
+        out_param = param;
+      }
+    }
+
+    // Generate the interface of a port as if it were `param` of the task.
+    vector<string> lines;
+    auto add_port = [&](const clang::ParmVarDecl* param, const string& name) {
+      const regex param_name{"\\b" + param->getNameAsString() + "\\b"};
+      auto add_line = [&](StringRef line) {
+        lines.push_back(regex_replace(line.str(), param_name, name));
+      };
+      auto add_pragma = [&](std::initializer_list<StringRef> pragma_args) {
+        add_line("#pragma " + llvm::join(pragma_args, " "));
+      };
+      target->AddCodeForLowerLevelStream(param, add_line, add_pragma);
+      return (IsTapaType(param, "istream") ? "tapa::istream<"
+                                           : "tapa::ostream<") +
+             GetStreamElemType(param) + ">& " + name;
+    };
+    auto get_task = [&](const string& name, const vector<string>& params) {
+      const string code = "\nvoid " + name + "(" + llvm::join(params, ", ") +
+                          ") {\n" + llvm::join(lines, "\n") + "\n}\n";
+      lines.clear();
+      json task;
+      task["code"] = visitor_.GetFusedTaskCode({}, code);
+      task["hash"] =
+          GetTaskHash(task["code"].get<string>(),
+                      GetHeadersHash(context.getSourceManager()), cflags_);
+      task["level"] = "lower";
+      task["target"] = "hls";
+      task["vendor"] = "xilinx";
+      task["ii"] = 1;
+      return task;
+    };
+
+    vector<string> params{add_port(in_param, "in")};
+    for (int i = 0; i < factor; ++i) {
+      params.push_back(add_port(out_param, "out_" + std::to_string(i)));
+    }
+    const auto in_type = GetStreamElemType(in_param);
+    lines.push_back("");
+    lines.push_back("int dst = 0;");
+    lines.push_back("scatter:");
+    lines.push_back("for (bool is_eot = false; !is_eot;) {");
+    lines.push_back("#pragma HLS pipeline II = 1");
+    lines.push_back("if (in.try_eot(is_eot) && !is_eot) {");
+    lines.push_back("const " + in_type + " val = in.read(nullptr);");
+    lines.push_back("switch (dst) {");
+    for (int i = 0; i < factor; ++i) {
+      const auto idx = std::to_string(i);
+      lines.push_back("case " + idx + ": out_" + idx + ".write(val); break;");
+    }
+    lines.push_back("}");
+    lines.push_back("dst = dst == " + std::to_string(factor - 1) +
+                    " ? 0 : dst + 1;");
+    lines.push_back("}");
+    lines.push_back("}");
+    lines.push_back("in.open();");
+    for (int i = 0; i < factor; ++i) {
+      lines.push_back("out_" + std::to_string(i) + ".close();");
+    }
+    auto scatter = get_task(task_name + "__scatter", params);
+
+    params.clear();
+    for (int i = 0; i < factor; ++i) {
+      params.push_back(add_port(in_param, "in_" + std::to_string(i)));
+    }
+    params.push_back(add_port(out_param, "out"));
+    const auto out_type = GetStreamElemType(out_param);
+    lines.push_back("");
+    lines.push_back("int src = 0;");
+    lines.push_back("gather:");
+    lines.push_back("for (bool is_eot = false; !is_eot;) {");
+    lines.push_back("#pragma HLS pipeline II = 1");
+    lines.push_back("bool is_valid = false;");
+    lines.push_back(out_type + " val;");
+    lines.push_back("switch (src) {");
+    for (int i = 0; i < factor; ++i) {
+      const auto in = "in_" + std::to_string(i);
+      lines.push_back("case " + std::to_string(i) + ": is_valid = " + in +
+                      ".try_eot(is_eot) && !is_eot; if (is_valid) val = " +
+                      in + ".read(nullptr); break;");
+    }
+    lines.push_back("}");
+    lines.push_back("if (is_valid) {");
+    lines.push_back("out.write(val);");
+    lines.push_back("src = src == " + std::to_string(factor - 1) +
+                    " ? 0 : src + 1;");
+    lines.push_back("}");
+    lines.push_back("}");
+    for (int i = 0; i < factor; ++i) {
+      lines.push_back("in_" + std::to_string(i) + ".open();");
+    }
+    lines.push_back("out.close();");
+    auto gather = get_task(task_name + "__gather", params);
+
+    return {scatter, gather};
+  }
+
+  bool HasError() const {
+    return ast_->getDiagnostics().hasErrorOccurred();
   }
 
  private:
-  Visitor visitor_;
-  vector<const FunctionDecl*>& funcs_;
+  unique_ptr<ASTUnit> ast_;
+  const string cflags_;
+  vector<const FunctionDecl*> funcs_;
+  unordered_map<string, vector<const FunctionDecl*>> func_table_;
   unordered_map<const FunctionDecl*, Rewriter> rewriters_;
   unordered_map<const FunctionDecl*, json> metadata_;
+  Visitor visitor_;
 };
 
-class Action : public ASTFrontendAction {
- public:
-  unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance& compiler,
-                                            StringRef file) override {
-    return llvm::make_unique<Consumer>(compiler.getASTContext(), funcs_);
+// Returns the names of the tasks reachable from the top-level task, each with
+// the index of the translation unit that defines it, given the candidates
+// collected from each translation unit. Reports an error and returns false if
+// a task is not defined exactly once.
+bool MergeTasks(const vector<vector<pair<string, vector<string>>>>& funcs,
+                vector<pair<string, size_t>>& tasks) {
+  // Indices of the translation units defining each function, once per
+  // definition.
+  unordered_map<string, vector<size_t>> definitions;
+  unordered_map<string, const vector<string>*> children;
+  for (size_t i = 0; i < funcs.size(); ++i) {
+    for (const auto& func : funcs[i]) {
+      definitions[func.first].push_back(i);
+      children.emplace(func.first, &func.second);
+    }
   }
 
- private:
-  vector<const FunctionDecl*> funcs_;
-};
+  if (definitions.count(*top_name) == 0) {
+    WithColor::error() << "top-level task '" << *top_name << "' not found\n";
+    return false;
+  }
+
+  // Starting from the top-level task, find all tasks using BFS.
+  // Note that task functions cannot share the same name.
+  bool is_ok = true;
+  unordered_set<string> task_set{*top_name};
+  queue<string> task_queue;
+  task_queue.push(*top_name);
+  for (; !task_queue.empty(); task_queue.pop()) {
+    const auto& task_name = task_queue.front();
+    const auto& decls = definitions[task_name];
+    if (decls.empty()) {
+      WithColor::error() << "task '" << task_name << "' not defined\n";
+      is_ok = false;
+      continue;
+    }
+    if (decls.size() > 1) {
+      WithColor::error() << "task '" << task_name << "' re-defined\n";
+      is_ok = false;
+    }
+    tasks.emplace_back(task_name, decls[0]);
+    for (const auto& child : *children[task_name]) {
+      if (task_set.insert(child).second) {
+        task_queue.push(child);
+      }
+    }
+  }
+  return is_ok;
+}
+
+// Inlines the instances of upper-level tasks into the upper-level task
+// `upper_name`, after flattening them recursively, so that their children are
+// instantiated by `upper_name` directly. FIFOs declared in an inlined task are
+// renamed after its instance, and its parameters are replaced with the
+// arguments of its instance. A task is inlined only if all its children are
+// joined or detached in one step, and if each argument of its children is a
+// constant, a FIFO it declares, or one of its parameters bound to a variable.
+void FlattenTask(json& tasks, const string& upper_name,
+                 unordered_set<string>& flattened) {
+  if (!flattened.insert(upper_name).second) {
+    return;
+  }
+  static const regex kConstant{R"(64'd\d+)"};
+  static const regex kElement{R"((.+)\[(\d+)\])"};
+  auto is_upper = [&](const string& name) {
+    const auto task = tasks.find(name);
+    return task != tasks.end() && task->value("level", "") == "upper" &&
+           task->contains("tasks");
+  };
+
+  auto& upper = tasks[upper_name];
+  vector<string> children;
+  for (const auto& task : upper["tasks"].items()) {
+    if (is_upper(task.key())) {
+      FlattenTask(tasks, task.key(), flattened);
+      children.push_back(task.key());
+    }
+  }
+
+  auto& fifos = upper["fifos"];
+  auto& instances = upper["tasks"];
+  for (const auto& child_name : children) {
+    const auto& child = tasks[child_name];
+    const auto& child_fifos = child["fifos"];
+
+    // Returns the argument of the instance `args` of the child that `arg` of a
+    // grandchild refers to, or an empty string if it cannot be inlined.
+    auto resolve = [&](const json& args, const string& instance_name,
+                       const string& arg) -> string {
+      std::smatch match;
+      if (regex_match(arg, kConstant)) {
+        return arg;
+      }
+      if (child_fifos.contains(arg) && child_fifos[arg].contains("depth")) {
+        return instance_name + "__" + arg;
+      }
+      if (args.contains(arg)) {
+        const string parent_arg = args[arg]["arg"];
+        return parent_arg;
+      }
+      if (regex_match(arg, match, kElement) && args.contains(match[1].str())) {
+        const string parent_arg = args[match[1].str()]["arg"];
+        if (parent_arg.find('[') == string::npos &&
+            !regex_match(parent_arg, kConstant)) {
+          return parent_arg + "[" + match[2].str() + "]";
+        }
+      }
+      return "";
+    };
+
+    bool is_inlinable = true;
+    for (size_t idx = 0; idx < instances[child_name].size(); ++idx) {
+      const auto& instance = instances[child_name][idx];
+      const string instance_name = child_name + "_" + std::to_string(idx);
+      for (const auto& grandchildren : child["tasks"]) {
+        for (const auto& grandchild : grandchildren) {
+          const int step = grandchild["step"];
+          if (step != 0 && step != -1) {
+            is_inlinable = false;
+          }
+          for (const auto& arg : grandchild["args"]) {
+            if (resolve(instance["args"], instance_name, arg["arg"]).empty()) {
+              is_inlinable = false;
+            }
+          }
+        }
+      }
+    }
+    if (!is_inlinable) {
+      continue;
+    }
+
+    for (size_t idx = 0; idx < instances[child_name].size(); ++idx) {
+      const auto& instance = instances[child_name][idx];
+      const string instance_name = child_name + "_" + std::to_string(idx);
+      const int step = instance["step"];
+      for (const auto& fifo : child_fifos.items()) {
+        if (fifo.value().contains("depth")) {
+          auto& new_fifo = fifos[instance_name + "__" + fifo.key()];
+          new_fifo = fifo.value();
+          new_fifo.erase("produced_by");
+          new_fifo.erase("consumed_by");
+        }
+      }
+      for (const auto& grandchildren : child["tasks"].items()) {
+        for (auto grandchild : grandchildren.value()) {
+          const string& task_name = grandchildren.key();
+          const size_t new_idx = instances[task_name].size();
+          if (grandchild["step"] == 0) {
+            grandchild["step"] = step;
+          }
+          for (auto& arg : grandchild["args"]) {
+            const string new_arg =
+                resolve(instance["args"], instance_name, arg["arg"]);
+            arg["arg"] = new_arg;
+            const auto cat = arg["cat"];
+            if ((cat == "istream" || cat == "ostream") &&
+                fifos.contains(new_arg)) {
+              fifos[new_arg][cat == "istream" ? "consumed_by" : "produced_by"] =
+                  {task_name, new_idx};
+            }
+          }
+          instances[task_name].push_back(std::move(grandchild));
+        }
+      }
+    }
+
+    // FIFOs still connected to the inlined instances are not accessed.
+    instances.erase(child_name);
+    for (auto& fifo : fifos) {
+      for (const auto direction : {"produced_by", "consumed_by"}) {
+        if (fifo.contains(direction) && fifo[direction][0] == child_name) {
+          fifo.erase(direction);
+        }
+      }
+    }
+  }
+}
+
+// Flattens the hierarchy under the top-level task, so that each upper-level
+// task that can be inlined costs no module, FSM, or handshake of its own.
+// Tasks that are no longer instantiated are removed.
+void FlattenTasks(json& tasks) {
+  unordered_set<string> flattened;
+  FlattenTask(tasks, *top_name, flattened);
+
+  // Inlined tasks may still list their children, so only those reachable from
+  // the top-level task are kept.
+  unordered_set<string> instantiated_tasks{*top_name};
+  queue<string> task_queue;
+  task_queue.push(*top_name);
+  for (; !task_queue.empty(); task_queue.pop()) {
+    const auto& task = tasks[task_queue.front()];
+    if (task.value("level", "") != "upper" || !task.contains("tasks")) {
+      continue;
+    }
+    for (const auto& child : task["tasks"].items()) {
+      if (instantiated_tasks.insert(child.key()).second) {
+        task_queue.push(child.key());
+      }
+    }
+  }
+  for (auto task = tasks.begin(); task != tasks.end();) {
+    if (instantiated_tasks.count(task.key())) {
+      ++task;
+    } else {
+      task = tasks.erase(task);
+    }
+  }
+}
+
+// Replaces each instance of the lower-level tasks in `factors` with as many
+// replicas as its factor, plus a scatter and a gather instance, so that
+// floorplanning sees each replica as a separate vertex. Each such task must
+// be a Xilinx HLS task with exactly one istream and one ostream, besides
+// scalars; each replica must process tokens until EoT and produce one token
+// per token consumed. Reports an error and returns false otherwise.
+bool ReplicateTasks(json& tasks, const map<string, int>& factors,
+                    const unordered_map<string, TranslationUnit*>& units) {
+  bool is_ok = true;
+  for (const auto& factor : factors) {
+    const auto& task_name = factor.first;
+    auto error = [&]() -> llvm::raw_ostream& {
+      is_ok = false;
+      return WithColor::error() << "cannot replicate task '" << task_name
+                                << "': ";
+    };
+    if (factor.second < 2) {
+      error() << "replication factor must be at least 2\n";
+      continue;
+    }
+    if (!tasks.contains(task_name)) {
+      error() << "task not instantiated\n";
+      continue;
+    }
+    const auto& task = tasks[task_name];
+    if (task.value("level", "") != "lower" ||
+        task.value("target", "") != "hls" ||
+        task.value("vendor", "") != "xilinx" || task.contains("rtl") ||
+        units.count(task_name) == 0) {
+      error() << "not a lower-level Xilinx HLS task\n";
+      continue;
+    }
+
+    const auto scatter_name = task_name + "__scatter";
+    const auto gather_name = task_name + "__gather";
+    bool is_generated = false;
+    for (auto& upper : tasks) {
+      if (!upper.contains("tasks") || !upper["tasks"].contains(task_name)) {
+        continue;
+      }
+      auto& fifos = upper["fifos"];
+      auto& instances = upper["tasks"];
+      const size_t instance_count = instances[task_name].size();
+      for (size_t idx = 0; idx < instance_count; ++idx) {
+        string in_port;
+        string out_port;
+        bool is_supported = true;
+        for (const auto& arg : instances[task_name][idx]["args"].items()) {
+          const auto& cat = arg.value()["cat"];
+          if (arg.key().find('[') != string::npos) {
+            is_supported = false;
+          } else if (cat == "istream") {
+            is_supported = is_supported && in_port.empty() &&
+                           fifos.contains(arg.value()["arg"]);
+            in_port = arg.key();
+          } else if (cat == "ostream") {
+            is_supported = is_supported && out_port.empty() &&
+                           fifos.contains(arg.value()["arg"]);
+            out_port = arg.key();
+          } else if (cat != "scalar") {
+            is_supported = false;
+          }
+        }
+        if (!is_supported || in_port.empty() || out_port.empty()) {
+          error() << "it must have exactly one istream and one ostream, "
+                     "besides scalars\n";
+          break;
+        }
+
+        if (!is_generated) {
+          auto generated = units.at(task_name)->GenerateScatterGather(
+              task_name, factor.second);
+          tasks[scatter_name] = std::move(generated.first);
+          tasks[gather_name] = std::move(generated.second);
+          is_generated = true;
+        }
+
+        // The first replica reuses the instance, and the others copy it.
+        const string instance_name = task_name + "_" + std::to_string(idx);
+        const json instance = instances[task_name][idx];
+        const string in_fifo = instance["args"][in_port]["arg"];
+        const string out_fifo = instance["args"][out_port]["arg"];
+        json scatter = {{"step", instance["step"]}, {"args", json::object()}};
+        json gather = {{"step", instance["step"]}, {"args", json::object()}};
+        scatter["args"]["in"] = {{"cat", "istream"}, {"arg", in_fifo}};
+        gather["args"]["out"] = {{"cat", "ostream"}, {"arg", out_fifo}};
+        fifos[in_fifo]["consumed_by"] = {scatter_name,
+                                         instances[scatter_name].size()};
+        fifos[out_fifo]["produced_by"] = {gather_name,
+                                          instances[gather_name].size()};
+        for (int i = 0; i < factor.second; ++i) {
+          const auto idx_str = std::to_string(i);
+          const auto replica_in = instance_name + "__in_" + idx_str;
+          const auto replica_out = instance_name + "__out_" + idx_str;
+          const size_t replica_idx =
+              i == 0 ? idx : instances[task_name].size();
+          if (i > 0) {
+            instances[task_name].push_back(instance);
+          }
+          auto& replica = instances[task_name][replica_idx];
+          replica["args"][in_port]["arg"] = replica_in;
+          replica["args"][out_port]["arg"] = replica_out;
+          scatter["args"]["out_" + idx_str] = {{"cat", "ostream"},
+                                               {"arg", replica_in}};
+          gather["args"]["in_" + idx_str] = {{"cat", "istream"},
+                                             {"arg", replica_out}};
+          fifos[replica_in] = {
+              {"depth", 2},
+              {"auto_depth", true},
+              {"produced_by", {scatter_name, instances[scatter_name].size()}},
+              {"consumed_by", {task_name, replica_idx}},
+          };
+          fifos[replica_out] = {
+              {"depth", 2},
+              {"auto_depth", true},
+              {"produced_by", {task_name, replica_idx}},
+              {"consumed_by", {gather_name, instances[gather_name].size()}},
+          };
+        }
+        instances[scatter_name].push_back(std::move(scatter));
+        instances[gather_name].push_back(std::move(gather));
+      }
+    }
+  }
+  return is_ok;
+}
+
+// Fuses each chain of lower-level task instances, in which each instance
+// produces FIFOs consumed only by the next and consumes FIFOs produced only by
+// the previous, into one instance of a new lower-level task that runs them as
+// dataflow processes. This saves a module, its handshake, and the FIFOs in
+// between for each instance. Instances are fused only if they are Xilinx HLS
+// tasks defined in the same translation unit, invoked in the same step, with
+// no mmap or array arguments, and if no consumer peeks a fused FIFO. Tasks
+// that are no longer instantiated are removed.
+void FuseTasks(json& tasks,
+               const unordered_map<string, TranslationUnit*>& units) {
+  using Instance = pair<string, size_t>;
+  auto get_instance = [](const json& ref) -> Instance {
+    return {ref[0].get<string>(), ref[1].get<size_t>()};
+  };
+  auto get_instance_name = [](const Instance& instance) {
+    return instance.first + "_" + std::to_string(instance.second);
+  };
+  // FIFO names may be array elements, i.e., `name[idx]`.
+  auto get_var_name = [](const string& fifo_name) {
+    return regex_replace(fifo_name, regex(R"(\[(\d+)\])"), "_$1");
+  };
+
+  vector<string> upper_tasks;
+  for (const auto& task : tasks.items()) {
+    if (task.value()["level"] == "upper" && task.value().contains("tasks")) {
+      upper_tasks.push_back(task.key());
+    }
+  }
+
+  for (const auto& upper_name : upper_tasks) {
+    auto& fifos = tasks[upper_name]["fifos"];
+    auto& instances = tasks[upper_name]["tasks"];
+    auto get_args = [&](const Instance& instance) -> json& {
+      return instances[instance.first][instance.second]["args"];
+    };
+
+    // Instances connected by FIFOs declared in the upper-level task.
+    map<Instance, set<Instance>> consumers;
+    map<Instance, set<Instance>> producers;
+    for (const auto& fifo : fifos) {
+      if (fifo.contains("depth") && fifo.contains("produced_by") &&
+          fifo.contains("consumed_by")) {
+        const auto producer = get_instance(fifo["produced_by"]);
+        const auto consumer = get_instance(fifo["consumed_by"]);
+        consumers[producer].insert(consumer);
+        producers[consumer].insert(producer);
+      }
+    }
+
+    auto is_fusible = [&](const Instance& instance) {
+      const auto& task = tasks[instance.first];
+      if (task.value("level", "") != "lower" ||
+          task.value("target", "") != "hls" ||
+          task.value("vendor", "") != "xilinx" || task.contains("rtl") ||
+          task.value("double_pump", false) ||
+          units.count(instance.first) == 0) {
+        return false;
+      }
+      for (const auto& arg : get_args(instance).items()) {
+        const auto& cat = arg.value()["cat"];
+        if (arg.key().find('[') != string::npos ||
+            (cat != "istream" && cat != "ostream" && cat != "scalar")) {
+          return false;
+        }
+        // A broadcast, merge, or distribute stream is accessed as a whole
+        // rather than as a FIFO.
+        if ((cat == "istream" || cat == "ostream") &&
+            !fifos.contains(arg.value()["arg"])) {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    map<Instance, Instance> next_instances;
+    set<Instance> fused_consumers;
+    for (const auto& item : consumers) {
+      const auto& producer = item.first;
+      if (item.second.size() != 1) {
+        continue;
+      }
+      const auto& consumer = *item.second.begin();
+      if (producer == consumer || producers[consumer].size() != 1 ||
+          !is_fusible(producer) || !is_fusible(consumer) ||
+          units.at(producer.first) != units.at(consumer.first) ||
+          instances[producer.first][producer.second]["step"] !=
+              instances[consumer.first][consumer.second]["step"]) {
+        continue;
+      }
+      bool is_peeked = false;
+      for (const auto& arg : get_args(consumer).items()) {
+        const string fifo_name = arg.value()["arg"];
+        if (arg.value()["cat"] == "istream" && fifos.contains(fifo_name) &&
+            fifos[fifo_name].contains("depth") &&
+            units.at(consumer.first)
+                ->IsStreamPeeked(consumer.first, arg.key())) {
+          is_peeked = true;
+        }
+      }
+      if (!is_peeked) {
+        next_instances[producer] = consumer;
+        fused_consumers.insert(consumer);
+      }
+    }
+
+    set<Instance> fused_instances;
+    for (const auto& item : next_instances) {
+      if (fused_consumers.count(item.first)) {
+        continue;  // not the head of a chain
+      }
+      vector<Instance> chain{item.first};
+      for (auto next = next_instances.find(item.first);
+           next != next_instances.end();
+           next = next_instances.find(next->second)) {
+        chain.push_back(next->second);
+      }
+      const set<Instance> members(chain.begin(), chain.end());
+
+      string fused_name = upper_name;
+      for (const auto& instance : chain) {
+        fused_name += "__" + get_instance_name(instance);
+      }
+
+      // FIFOs between the members become local to the fused task.
+      map<string, uint64_t> local_fifos;
+      for (auto fifo = fifos.begin(); fifo != fifos.end();) {
+        if (fifo->contains("depth") && fifo->contains("produced_by") &&
+            fifo->contains("consumed_by") &&
+            members.count(get_instance((*fifo)["produced_by"])) &&
+            members.count(get_instance((*fifo)["consumed_by"]))) {
+          local_fifos[get_var_name(fifo.key())] = (*fifo)["depth"];
+          fifo = fifos.erase(fifo);
+        } else {
+          ++fifo;
+        }
+      }
+
+      // Other arguments are passed through parameters of the fused task.
+      json fused_instance = {
+          {"step", instances[chain[0].first][chain[0].second]["step"]},
+          {"args", json::object()},
+      };
+      json streams = json::object();
+      json ii;
+      vector<pair<string, map<string, string>>> fused_args;
+      for (const auto& instance : chain) {
+        const auto& task = tasks[instance.first];
+        fused_args.emplace_back(instance.first, map<string, string>());
+        for (const auto& arg : get_args(instance).items()) {
+          const string arg_name = arg.value()["arg"];
+          const auto var_name = get_var_name(arg_name);
+          if (arg.value()["cat"] != "scalar" && local_fifos.count(var_name)) {
+            fused_args.back().second[arg.key()] = var_name;
+            continue;
+          }
+          const auto port = get_instance_name(instance) + "_" + arg.key();
+          fused_args.back().second[arg.key()] = port;
+          fused_instance["args"][port] = arg.value();
+          if (task.contains("streams") && task["streams"].contains(arg.key())) {
+            streams[port] = task["streams"][arg.key()];
+          }
+          if (arg.value()["cat"] != "scalar" && fifos.contains(arg_name)) {
+            for (const auto direction : {"produced_by", "consumed_by"}) {
+              auto& fifo = fifos[arg_name];
+              if (fifo.contains(direction) &&
+                  get_instance(fifo[direction]) == instance) {
+                fifo[direction] = {fused_name, 0};
+              }
+            }
+          }
+        }
+        if (task.contains("ii") && task["ii"].is_number() &&
+            (ii.is_null() || task["ii"] > ii)) {
+          ii = task["ii"];
+        }
+      }
+
+      tasks[fused_name] = units.at(chain[0].first)
+                              ->FuseTasks(fused_name, fused_args, local_fifos);
+      tasks[fused_name]["streams"] = streams;
+      tasks[fused_name]["ii"] = ii;
+      instances[fused_name] = json::array({fused_instance});
+      fused_instances.insert(members.begin(), members.end());
+    }
+
+    // Remove the fused instances, which shifts the indices of the remaining
+    // ones.
+    map<Instance, size_t> new_indices;
+    for (auto task = instances.begin(); task != instances.end();) {
+      json remaining = json::array();
+      for (size_t i = 0; i < task->size(); ++i) {
+        if (fused_instances.count({task.key(), i}) == 0) {
+          new_indices[{task.key(), i}] = remaining.size();
+          remaining.push_back((*task)[i]);
+        }
+      }
+      if (remaining.empty()) {
+        task = instances.erase(task);
+      } else {
+        *task = std::move(remaining);
+        ++task;
+      }
+    }
+    for (auto& fifo : fifos) {
+      for (const auto direction : {"produced_by", "consumed_by"}) {
+        if (fifo.contains(direction)) {
+          const auto index = new_indices.find(get_instance(fifo[direction]));
+          if (index != new_indices.end()) {
+            fifo[direction][1] = index->second;
+          }
+        }
+      }
+    }
+  }
+
+  unordered_set<string> instantiated_tasks{*top_name};
+  for (const auto& upper_name : upper_tasks) {
+    for (const auto& task : tasks[upper_name]["tasks"].items()) {
+      instantiated_tasks.insert(task.key());
+    }
+  }
+  for (auto task = tasks.begin(); task != tasks.end();) {
+    if (instantiated_tasks.count(task.key())) {
+      ++task;
+    } else {
+      task = tasks.erase(task);
+    }
+  }
+}
+
+// Replaces each instance of a lower-level Xilinx HLS task that has constant
+// scalar arguments, e.g., `tapa::seq` or integer literals, with an instance of
+// a task specialized for these constants, so that each instance can be
+// optimized for its own constants. Instances with the same constants share the
+// same specialized task. Tasks that are no longer instantiated are removed.
+void SpecializeTasks(json& tasks,
+                     const unordered_map<string, TranslationUnit*>& units) {
+  using Instance = pair<string, size_t>;
+  static const regex kConstant{R"(64'd(\d+))"};
+  map<string, json> specialized_tasks;
+  unordered_set<string> instantiated_tasks{*top_name};
+  for (auto& upper : tasks) {
+    if (upper.value("level", "") != "upper" || !upper.contains("tasks")) {
+      continue;
+    }
+    json new_instances = json::object();
+    map<Instance, Instance> new_indices;
+    for (auto& instances : upper["tasks"].items()) {
+      const auto& task_name = instances.key();
+      const auto task = tasks.find(task_name);
+      const bool is_specializable = task != tasks.end() &&
+                                    task->value("level", "") == "lower" &&
+                                    task->value("target", "") == "hls" &&
+                                    task->value("vendor", "") == "xilinx" &&
+                                    !task->contains("rtl") &&
+                                    units.count(task_name) > 0;
+      for (size_t idx = 0; idx < instances.value().size(); ++idx) {
+        auto& instance = instances.value()[idx];
+        map<string, uint64_t> constants;
+        std::smatch match;
+        for (const auto& arg : instance.value("args", json::object()).items()) {
+          const string arg_name = arg.value()["arg"];
+          if (is_specializable && arg.value()["cat"] == "scalar" &&
+              std::regex_match(arg_name, match, kConstant)) {
+            constants[arg.key()] = std::stoull(match[1].str());
+          }
+        }
+
+        string name = task_name;
+        for (const auto& constant : constants) {
+          name += "__" + constant.first + "_" + std::to_string(constant.second);
+        }
+        if (!constants.empty() && !specialized_tasks.count(name)) {
+          auto specialized =
+              units.at(task_name)->SpecializeTask(task_name, name, constants);
+          if (specialized.is_null()) {
+            name = task_name;
+          } else {
+            specialized_tasks[name] = *task;
+            specialized_tasks[name].update(specialized);
+          }
+        }
+        if (name != task_name) {
+          for (const auto& constant : constants) {
+            instance["args"].erase(constant.first);
+          }
+        }
+
+        instantiated_tasks.insert(name);
+        new_indices[{task_name, idx}] = {name, new_instances[name].size()};
+        new_instances[name].push_back(std::move(instance));
+      }
+    }
+    upper["tasks"] = std::move(new_instances);
+    if (!upper.contains("fifos")) {
+      continue;
+    }
+
+    for (auto& fifo : upper["fifos"]) {
+      for (const auto direction : {"produced_by", "consumed_by"}) {
+        if (fifo.contains(direction)) {
+          const Instance instance{fifo[direction][0].get<string>(),
+                                  fifo[direction][1].get<size_t>()};
+          const auto index = new_indices.find(instance);
+          if (index != new_indices.end()) {
+            fifo[direction] = {index->second.first, index->second.second};
+          }
+        }
+      }
+    }
+  }
+
+  for (auto& task : specialized_tasks) {
+    tasks[task.first] = std::move(task.second);
+  }
+  for (auto task = tasks.begin(); task != tasks.end();) {
+    if (instantiated_tasks.count(task.key())) {
+      ++task;
+    } else {
+      task = tasks.erase(task);
+    }
+  }
+}
+
+// Removes each scalar port of the top-level task in `scalars` from its
+// interface and passes the given value to its instances instead, as a constant
+// that SpecializeTasks propagates into lower-level tasks. Returns false if a
+// name is not a scalar port of the top-level task.
+bool SpecializeScalars(json& tasks, const map<string, uint64_t>& scalars) {
+  auto& top = tasks[*top_name];
+  if (!scalars.empty() && top.value("level", "") != "upper") {
+    WithColor::error() << "-specialize-scalar requires the top-level task '"
+                       << *top_name << "' to be an upper-level task\n";
+    return false;
+  }
+  for (const auto& scalar : scalars) {
+    auto& ports = top["ports"];
+    const auto port =
+        std::find_if(ports.begin(), ports.end(), [&](const json& port) {
+          return port["name"] == scalar.first && port["cat"] == "scalar";
+        });
+    if (port == ports.end()) {
+      WithColor::error() << "invalid -specialize-scalar: '" << scalar.first
+                         << "' is not a scalar argument of '" << *top_name
+                         << "'\n";
+      return false;
+    }
+    ports.erase(port);
+
+    const string constant = "64'd" + std::to_string(scalar.second);
+    for (auto& instances : top["tasks"]) {
+      for (auto& instance : instances) {
+        if (!instance.contains("args")) {
+          continue;
+        }
+        for (auto& arg : instance["args"]) {
+          if (arg["arg"] == scalar.first) {
+            arg["arg"] = constant;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Copies the estimated traffic of the ports that produce and consume each FIFO
+// into its metadata, so that the rates of a FIFO can be compared in one place.
+// Whether each port may use EoT is copied along with the traffic. The producer
+// of a broadcast or distribute stream, or the consumer of a merge stream,
+// accesses each of its FIFOs.
+void AnnotateFifoRates(json& tasks) {
+  static const pair<const char*, const char*> kDirections[] = {
+      {"produced_by", "producer_rate"},
+      {"consumed_by", "consumer_rate"},
+  };
+  for (auto& task : tasks) {
+    if (!task.contains("fifos")) {
+      continue;
+    }
+    for (auto& fifo : task["fifos"].items()) {
+      auto& fifo_meta = fifo.value();
+      for (const auto& direction : kDirections) {
+        if (!fifo_meta.contains(direction.first)) {
+          continue;
+        }
+        const string child_name = fifo_meta[direction.first][0];
+        const size_t instance_idx = fifo_meta[direction.first][1];
+        const auto child = tasks.find(child_name);
+        if (child == tasks.end() || !child->contains("streams")) {
+          continue;
+        }
+        auto& streams = (*child)["streams"];
+        // A port may access the stream that the FIFO belongs to instead.
+        string group = fifo.key();
+        for (const char* kind : {"broadcast", "merge", "distribute"}) {
+          group = fifo_meta.value(kind, group);
+        }
+        for (const auto& arg :
+             task["tasks"][child_name][instance_idx]["args"].items()) {
+          if ((arg.value()["arg"] == fifo.key() ||
+               arg.value()["arg"] == group) &&
+              streams.contains(arg.key())) {
+            fifo_meta[direction.second] = streams[arg.key()];
+          }
+        }
+      }
+    }
+  }
+}
+
+// Writes the code of each task in `tasks` to `<dir>/<task>.cpp` and replaces
+// it with the "code_file" path, so that the code of large designs is neither
+// held in memory nor parsed as part of the JSON. Tasks without code, i.e.,
+// written before, are kept as-is. Returns whether all files are written.
+bool WriteTaskCode(json& tasks, const string& dir) {
+  if (auto ec = llvm::sys::fs::create_directories(dir)) {
+    WithColor::error() << "cannot create '" << dir << "': " << ec.message()
+                       << "\n";
+    return false;
+  }
+  for (auto& task : tasks.items()) {
+    auto& task_meta = task.value();
+    if (!task_meta.contains("code")) {
+      continue;
+    }
+    llvm::SmallString<256> path{dir};
+    llvm::sys::path::append(path, task.key() + ".cpp");
+    std::error_code ec;
+    llvm::raw_fd_ostream os{path, ec};
+    if (ec) {
+      WithColor::error() << "cannot write '" << path << "': " << ec.message()
+                         << "\n";
+      return false;
+    }
+    os << task_meta["code"].get_ref<const string&>();
+    task_meta.erase("code");
+    task_meta["code_file"] = path.str().str();
+  }
+  return true;
+}
 
 }  // namespace internal
 }  // namespace tapa
 
 static OptionCategory tapa_option_category("TAPA Compiler Companion");
 static llvm::cl::opt<string> tapa_opt_top_name(
-    "top", NumOccurrencesFlag::Required, ValueExpected::ValueRequired,
+    "top", NumOccurrencesFlag::Optional, ValueExpected::ValueRequired,
     llvm::cl::desc("Top-level task name"), llvm::cl::cat(tapa_option_category));
+static llvm::cl::list<string> tapa_opt_replicate(
+    "replicate", llvm::cl::ZeroOrMore, llvm::cl::value_desc("task:N"),
+    llvm::cl::desc("Replicate each instance of a lower-level task N times, "
+                   "with round-robin scatter and gather tasks"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<bool> tapa_opt_flatten(
+    "flatten",
+    llvm::cl::desc("Inline upper-level tasks into their parents, so that "
+                   "intermediate levels cost no module or handshake"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<bool> tapa_opt_fuse_tasks(
+    "fuse-tasks",
+    llvm::cl::desc("Fuse chains of lower-level tasks connected by FIFOs into "
+                   "one dataflow task each"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<bool> tapa_opt_specialize(
+    "specialize",
+    llvm::cl::desc("Specialize lower-level tasks for the constant arguments, "
+                   "e.g., tapa::seq, of each instance"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::list<string> tapa_opt_specialize_scalar(
+    "specialize-scalar", llvm::cl::ZeroOrMore, llvm::cl::value_desc("arg=N"),
+    llvm::cl::desc("Bind a scalar argument of the top-level task to N, which "
+                   "is then no longer a port of the kernel; implies "
+                   "-specialize"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<bool> tapa_opt_loop_counters(
+    "loop-counters",
+    llvm::cl::desc("Export the iterations and stall cycles of each pipelined "
+                   "loop in lower-level tasks as extra output ports"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<bool> tapa_opt_nonblocking_reads(
+    "nonblocking-reads",
+    llvm::cl::desc("Rewrite blocking reads of several streams in each "
+                   "pipelined loop into try_read with skid registers"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<bool> tapa_opt_ap_ctrl_chain(
+    "ap-ctrl-chain",
+    llvm::cl::desc("Control the top-level task with ap_ctrl_chain, so that "
+                   "back-to-back invocations overlap"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<string> tapa_opt_target(
+    "target", llvm::cl::init("hls"), llvm::cl::value_desc("hls|cpu"),
+    llvm::cl::desc("Target of tasks without [[tapa::target]]; cpu rewrites "
+                   "tasks for execution on the host"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<string> tapa_opt_code_dir(
+    "code-dir", llvm::cl::value_desc("dir"),
+    llvm::cl::desc("Write the code of each task to <dir>/<task>.cpp as soon "
+                   "as it is rewritten, and output its \"code_file\" instead"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<string> tapa_opt_emit_pch(
+    "emit-pch", llvm::cl::value_desc("file"),
+    llvm::cl::desc("Precompile the given header into <file> instead of "
+                   "extracting tasks; pass it back via -include-pch"),
+    llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<unsigned> tapa_opt_jobs(
+    "j", llvm::cl::init(0),
+    llvm::cl::desc("Number of translation units processed in parallel "
+                   "(default: number of cores)"),
+    llvm::cl::cat(tapa_option_category));
 
 int main(int argc, const char** argv) {
+  using tapa::internal::TranslationUnit;
+
   CommonOptionsParser parser{argc, argv, tapa_option_category};
-  ClangTool tool{parser.getCompilations(), parser.getSourcePathList()};
+  if (!tapa_opt_emit_pch.empty()) {
+    // Headers are parsed once here instead of once per translation unit.
+    using clang::tooling::ArgumentInsertPosition;
+    using clang::tooling::getInsertArgumentAdjuster;
+    ClangTool tool{parser.getCompilations(), parser.getSourcePathList()};
+    tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
+        {"-x", "c++-header"}, ArgumentInsertPosition::BEGIN));
+    tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
+        {"-o", tapa_opt_emit_pch.getValue()}, ArgumentInsertPosition::END));
+    return tool.run(
+        clang::tooling::newFrontendActionFactory<clang::GeneratePCHAction>()
+            .get());
+  }
+  if (tapa_opt_top_name.empty()) {
+    WithColor::error() << "missing -top\n";
+    return 1;
+  }
   string top_name{tapa_opt_top_name.getValue()};
   tapa::internal::top_name = &top_name;
-  int ret = tool.run(newFrontendActionFactory<tapa::internal::Action>().get());
+  string default_target{tapa_opt_target.getValue()};
+  if (default_target != "hls" && default_target != "cpu") {
+    WithColor::error() << "invalid -target: '" << default_target
+                       << "', expecting hls or cpu\n";
+    return 1;
+  }
+  tapa::internal::default_target = &default_target;
+  tapa::internal::loop_counters = tapa_opt_loop_counters;
+  tapa::internal::nonblocking_reads = tapa_opt_nonblocking_reads;
+  tapa::internal::ap_ctrl_chain = tapa_opt_ap_ctrl_chain;
+  map<string, uint64_t> specialized_scalars;
+  for (const auto& arg : tapa_opt_specialize_scalar) {
+    const auto pos = arg.find('=');
+    uint64_t value = 0;
+    int64_t signed_value = 0;
+    if (pos != string::npos &&
+        !StringRef(arg).substr(pos + 1).getAsInteger(0, signed_value)) {
+      value = signed_value;
+    } else if (pos == string::npos ||
+               StringRef(arg).substr(pos + 1).getAsInteger(0, value)) {
+      WithColor::error() << "invalid -specialize-scalar: '" << arg
+                         << "', expecting arg=N\n";
+      return 1;
+    }
+    specialized_scalars[arg.substr(0, pos)] = value;
+  }
+  tapa::internal::specialized_scalars = &specialized_scalars;
+
+  const string code_dir{tapa_opt_code_dir.getValue()};
+
+  const auto& files = parser.getSourcePathList();
+  unsigned jobs = tapa_opt_jobs.getValue();
+  if (jobs == 0) {
+    jobs = llvm::heavyweight_hardware_concurrency();
+  }
+  ThreadPool pool{std::max(1u, std::min<unsigned>(jobs, files.size()))};
+
+  // Parse each translation unit and collect its candidate tasks.
+  vector<unique_ptr<TranslationUnit>> units(files.size());
+  vector<vector<pair<string, vector<string>>>> funcs(files.size());
+  vector<int> rets(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    pool.async([&, i] {
+      ClangTool tool{parser.getCompilations(), {files[i]}};
+      vector<unique_ptr<ASTUnit>> asts;
+      rets[i] = tool.buildASTs(asts);
+      if (asts.empty()) {
+        rets[i] = 1;
+        return;
+      }
+      string cflags;
+      for (const auto& command :
+           parser.getCompilations().getCompileCommands(files[i])) {
+        for (const auto& arg : command.CommandLine) {
+          cflags += arg;
+          cflags += '\0';
+        }
+      }
+      units[i] = llvm::make_unique<TranslationUnit>(std::move(asts[0]),
+                                                    std::move(cflags));
+      funcs[i] = units[i]->CollectFuncs();
+    });
+  }
+  pool.wait();
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (rets[i] != 0 || units[i]->HasError()) {
+      return 1;
+    }
+  }
+
+  // Merge the candidates to find the tasks and the translation units defining
+  // them.
+  vector<pair<string, size_t>> tasks;
+  if (!tapa::internal::MergeTasks(funcs, tasks)) {
+    return 1;
+  }
+  vector<vector<string>> task_names(files.size());
+  for (const auto& task : tasks) {
+    task_names[task.second].push_back(task.first);
+  }
+
+  // Extract the tasks of each translation unit and merge them.
+  vector<json> partial_codes(files.size(), json::object());
+  vector<int> code_written(files.size(), true);
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (task_names[i].empty()) {
+      continue;
+    }
+    pool.async([&, i] {
+      partial_codes[i] = units[i]->ExtractTasks(task_names[i]);
+      if (!code_dir.empty()) {
+        code_written[i] =
+            tapa::internal::WriteTaskCode(partial_codes[i], code_dir);
+      }
+    });
+  }
+  pool.wait();
+  json code;
+  code["tasks"] = json::object();
+  int ret = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    code["tasks"].update(partial_codes[i]);
+    if (units[i]->HasError() || !code_written[i]) {
+      ret = 1;
+    }
+  }
+  unordered_map<string, TranslationUnit*> task_units;
+  for (const auto& task : tasks) {
+    task_units[task.first] = units[task.second].get();
+  }
+  map<string, int> factors;
+  for (const auto& arg : tapa_opt_replicate) {
+    const auto pos = arg.rfind(':');
+    int factor = 0;
+    if (pos == string::npos ||
+        StringRef(arg).substr(pos + 1).getAsInteger(10, factor)) {
+      WithColor::error() << "invalid -replicate: '" << arg
+                       << "', expecting task:N\n";
+      return 1;
+    }
+    factors[arg.substr(0, pos)] = factor;
+  }
+  if (ret == 0 && !tapa::internal::SpecializeScalars(code["tasks"],
+                                                     specialized_scalars)) {
+    ret = 1;
+  }
+  if (tapa_opt_flatten && ret == 0) {
+    tapa::internal::FlattenTasks(code["tasks"]);
+  }
+  if (ret == 0 &&
+      !tapa::internal::ReplicateTasks(code["tasks"], factors, task_units)) {
+    ret = 1;
+  }
+  if (tapa_opt_fuse_tasks && ret == 0) {
+    tapa::internal::FuseTasks(code["tasks"], task_units);
+  }
+  if ((tapa_opt_specialize || !specialized_scalars.empty()) && ret == 0) {
+    tapa::internal::SpecializeTasks(code["tasks"], task_units);
+  }
+  tapa::internal::AnnotateFifoRates(code["tasks"]);
+  // Fused and specialized tasks are created after the tasks are extracted.
+  if (!code_dir.empty() &&
+      !tapa::internal::WriteTaskCode(code["tasks"], code_dir)) {
+    ret = 1;
+  }
+  code["top"] = top_name;
+  std::cout << code;
   return ret;
 }
@@ -1,2 +1,4 @@
 #include "base_target.h"
+#include "cpu_optimized_target.h"
+#include "intel_hls_target.h"
 #include "xilinx_hls_target.h"
@@ -1,5 +1,7 @@
 #include "base_target.h"
 
+#include <cctype>
+
 #include "../tapa/type.h"
 
 namespace tapa {
@@ -29,6 +31,8 @@ void BaseTarget::AddCodeForLowerLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF) {
   AddCodeForAsyncMmap(ADD_FOR_PARAMS_ARGS);
 }
 
+void BaseTarget::AddCodeForLowerLevelBuffer(ADD_FOR_PARAMS_ARGS_DEF) {}
+
 void BaseTarget::AddCodeForMmap(ADD_FOR_PARAMS_ARGS_DEF) {}
 void BaseTarget::AddCodeForTopLevelMmap(ADD_FOR_PARAMS_ARGS_DEF) {
   AddCodeForMmap(ADD_FOR_PARAMS_ARGS);
@@ -110,10 +114,12 @@ std::vector<std::string> BaseTarget::GenerateCodeForLowerLevelFunc(
   for (const auto param : func->parameters()) {
     if (IsTapaType(param, "(i|o)streams?")) {
       AddCodeForLowerLevelStream(param, add_line, add_pragma);
-    } else if (IsTapaType(param, "async_mmaps?")) {
+    } else if (IsTapaType(param, "(cached_|burst_|atomic_)?async_mmaps?")) {
       AddCodeForLowerLevelAsyncMmap(param, add_line, add_pragma);
     } else if (IsTapaType(param, "mmaps?")) {
       AddCodeForLowerLevelMmap(param, add_line, add_pragma);
+    } else if (IsTapaType(param, "(i|o)buffer")) {
+      AddCodeForLowerLevelBuffer(param, add_line, add_pragma);
     } else {
       AddCodeForLowerLevelScalar(param, add_line, add_pragma);
     }
@@ -139,11 +145,55 @@ void BaseTarget::RewriteLowerLevelFunc(REWRITE_FUNC_ARGS_DEF) {
                                 llvm::join(lines, "\n"));
 }
 
+clang::SourceRange BaseTarget::ExtendAttrRemovalRange(
+    clang::Rewriter &rewriter, clang::SourceRange range) {
+  auto begin = range.getBegin();
+  auto end = range.getEnd();
+
+#define BEGIN(OFF) (begin.getLocWithOffset(OFF))
+#define END(OFF) (end.getLocWithOffset(OFF))
+#define STR_AT(BEGIN, END) \
+  (rewriter.getRewrittenText(clang::SourceRange((BEGIN), (END))))
+#define IS_IGNORE(STR) ((STR) == "" || std::isspace((STR)[0]))
+
+  // Find the true end of the token
+  for (; std::isalpha(STR_AT(END(1), END(1))[0]); end = END(1))
+    ;
+
+  // Remove all whitespaces around the attribute
+  for (; IS_IGNORE(STR_AT(BEGIN(-1), BEGIN(-1))); begin = BEGIN(-1))
+    ;
+  for (; IS_IGNORE(STR_AT(END(1), END(1))); end = END(1))
+    ;
+
+  // Remove comma if around the attribute
+  if (STR_AT(BEGIN(-1), BEGIN(-1)) == ",") {
+    begin = BEGIN(-1);
+  } else if (STR_AT(END(1), END(1)) == ",") {
+    end = END(1);
+  } else if (STR_AT(BEGIN(-2), BEGIN(-1)) == "[[" &&
+             STR_AT(END(1), END(2)) == "]]") {
+    // Check if the attribute is completely removed
+    begin = BEGIN(-2);
+    end = END(2);
+  }
+
+  return clang::SourceRange(begin, end);
+}
+
 void BaseTarget::RewriteFuncArguments(REWRITE_FUNC_ARGS_DEF, bool top) {}
 void BaseTarget::RewritePipelinedDecl(REWRITE_DECL_ARGS_DEF,
                                       const clang::Stmt *body) {}
 void BaseTarget::RewritePipelinedStmt(REWRITE_STMT_ARGS_DEF,
                                       const clang::Stmt *body) {}
+void BaseTarget::RewriteTripcountStmt(REWRITE_STMT_ARGS_DEF,
+                                      const clang::Stmt *body) {}
+void BaseTarget::RewriteIndependentStmt(REWRITE_STMT_ARGS_DEF,
+                                        const clang::Stmt *body) {}
+void BaseTarget::RewritePartitionedDecl(REWRITE_DECL_ARGS_DEF) {}
+void BaseTarget::RewriteAxiParam(REWRITE_DECL_ARGS_DEF) {}
+void BaseTarget::RewriteLocalArrayDecl(const clang::VarDecl *decl,
+                                       clang::Rewriter &rewriter) {}
 
 }  // namespace internal
 }  // namespace tapa
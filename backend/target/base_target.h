@@ -52,6 +52,7 @@ class Target {
   virtual void AddCodeForTopLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF) = 0;
   virtual void AddCodeForMiddleLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF) = 0;
   virtual void AddCodeForLowerLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF) = 0;
+  virtual void AddCodeForLowerLevelBuffer(ADD_FOR_PARAMS_ARGS_DEF) = 0;
   virtual void AddCodeForScalar(ADD_FOR_PARAMS_ARGS_DEF) = 0;
   virtual void AddCodeForTopLevelScalar(ADD_FOR_PARAMS_ARGS_DEF) = 0;
   virtual void AddCodeForMiddleLevelScalar(ADD_FOR_PARAMS_ARGS_DEF) = 0;
@@ -64,6 +65,14 @@ class Target {
                                     const clang::Stmt *body) = 0;
   virtual void RewritePipelinedStmt(REWRITE_STMT_ARGS_DEF,
                                     const clang::Stmt *body) = 0;
+  virtual void RewriteTripcountStmt(REWRITE_STMT_ARGS_DEF,
+                                    const clang::Stmt *body) = 0;
+  virtual void RewriteIndependentStmt(REWRITE_STMT_ARGS_DEF,
+                                      const clang::Stmt *body) = 0;
+  virtual void RewritePartitionedDecl(REWRITE_DECL_ARGS_DEF) = 0;
+  virtual void RewriteAxiParam(REWRITE_DECL_ARGS_DEF) = 0;
+  virtual void RewriteLocalArrayDecl(const clang::VarDecl *decl,
+                                     clang::Rewriter &rewriter) = 0;
 
   static tapa::internal::Target *GetInstance() = delete;
   Target(Target const &) = delete;
@@ -92,6 +101,8 @@ class BaseTarget : public Target {
   virtual void AddCodeForMiddleLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF);
   virtual void AddCodeForLowerLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF);
 
+  virtual void AddCodeForLowerLevelBuffer(ADD_FOR_PARAMS_ARGS_DEF);
+
   virtual void AddCodeForScalar(ADD_FOR_PARAMS_ARGS_DEF);
   virtual void AddCodeForTopLevelScalar(ADD_FOR_PARAMS_ARGS_DEF);
   virtual void AddCodeForMiddleLevelScalar(ADD_FOR_PARAMS_ARGS_DEF);
@@ -114,6 +125,14 @@ class BaseTarget : public Target {
                                     const clang::Stmt *body);
   virtual void RewritePipelinedStmt(REWRITE_STMT_ARGS_DEF,
                                     const clang::Stmt *body);
+  virtual void RewriteTripcountStmt(REWRITE_STMT_ARGS_DEF,
+                                    const clang::Stmt *body);
+  virtual void RewriteIndependentStmt(REWRITE_STMT_ARGS_DEF,
+                                      const clang::Stmt *body);
+  virtual void RewritePartitionedDecl(REWRITE_DECL_ARGS_DEF);
+  virtual void RewriteAxiParam(REWRITE_DECL_ARGS_DEF);
+  virtual void RewriteLocalArrayDecl(const clang::VarDecl *decl,
+                                     clang::Rewriter &rewriter);
 
   static tapa::internal::Target *GetInstance() = delete;
   BaseTarget(BaseTarget const &) = delete;
@@ -121,6 +140,11 @@ class BaseTarget : public Target {
 
  protected:
   BaseTarget() {}
+
+  // Extends the range of an attribute to remove, so that no whitespace,
+  // comma, or empty `[[]]` is left.
+  static clang::SourceRange ExtendAttrRemovalRange(clang::Rewriter &rewriter,
+                                                   clang::SourceRange range);
 };
 
 }  // namespace internal
@@ -0,0 +1,54 @@
+#include "cpu_optimized_target.h"
+
+namespace tapa {
+namespace internal {
+
+void CpuOptimizedTarget::RewriteTopLevelFunc(REWRITE_FUNC_ARGS_DEF) {}
+void CpuOptimizedTarget::RewriteMiddleLevelFunc(REWRITE_FUNC_ARGS_DEF) {}
+void CpuOptimizedTarget::RewriteLowerLevelFunc(REWRITE_FUNC_ARGS_DEF) {}
+
+void CpuOptimizedTarget::RewritePipelinedDecl(REWRITE_DECL_ARGS_DEF,
+                                              const clang::Stmt *body) {
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+void CpuOptimizedTarget::RewritePipelinedStmt(REWRITE_STMT_ARGS_DEF,
+                                              const clang::Stmt *body) {
+  // Ask the host compiler to vectorize the loop like the hardware overlaps its
+  // iterations. Unlike `ivdep`, this does not override dependence analysis, so
+  // loop-carried dependences are still honored.
+  if (auto attributed = llvm::dyn_cast<clang::AttributedStmt>(stmt)) {
+    auto loop = attributed->getSubStmt();
+    if (llvm::isa<clang::ForStmt>(loop) || llvm::isa<clang::WhileStmt>(loop) ||
+        llvm::isa<clang::DoStmt>(loop)) {
+      rewriter.InsertTextBefore(loop->getBeginLoc(),
+                                "\n#ifdef __clang__\n"
+                                "#pragma clang loop vectorize(enable)\n"
+                                "#endif  // __clang__\n");
+    }
+  }
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+// The host compiler has its own dependence analysis and memory hierarchy, so
+// the remaining scheduling hints are dropped.
+void CpuOptimizedTarget::RewriteTripcountStmt(REWRITE_STMT_ARGS_DEF,
+                                              const clang::Stmt *body) {
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+void CpuOptimizedTarget::RewriteIndependentStmt(REWRITE_STMT_ARGS_DEF,
+                                                const clang::Stmt *body) {
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+void CpuOptimizedTarget::RewritePartitionedDecl(REWRITE_DECL_ARGS_DEF) {
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+void CpuOptimizedTarget::RewriteAxiParam(REWRITE_DECL_ARGS_DEF) {
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+}  // namespace internal
+}  // namespace tapa
@@ -0,0 +1,45 @@
+#ifndef TAPA_CPU_OPTIMIZED_TARGET_H_
+#define TAPA_CPU_OPTIMIZED_TARGET_H_
+
+#include "base_target.h"
+
+namespace tapa {
+namespace internal {
+
+// Rewrites tasks for execution on the host CPU. Task bodies are kept as is, so
+// that upper-level tasks instantiate their children using the tapa runtime and
+// lower-level tasks access the runtime's lock-free queues directly. No HLS
+// interface is generated, and pipelined loops are annotated for host
+// vectorization instead.
+class CpuOptimizedTarget : public BaseTarget {
+ public:
+  virtual void RewriteTopLevelFunc(REWRITE_FUNC_ARGS_DEF);
+  virtual void RewriteMiddleLevelFunc(REWRITE_FUNC_ARGS_DEF);
+  virtual void RewriteLowerLevelFunc(REWRITE_FUNC_ARGS_DEF);
+  virtual void RewritePipelinedDecl(REWRITE_DECL_ARGS_DEF,
+                                    const clang::Stmt *body);
+  virtual void RewritePipelinedStmt(REWRITE_STMT_ARGS_DEF,
+                                    const clang::Stmt *body);
+  virtual void RewriteTripcountStmt(REWRITE_STMT_ARGS_DEF,
+                                    const clang::Stmt *body);
+  virtual void RewriteIndependentStmt(REWRITE_STMT_ARGS_DEF,
+                                      const clang::Stmt *body);
+  virtual void RewritePartitionedDecl(REWRITE_DECL_ARGS_DEF);
+  virtual void RewriteAxiParam(REWRITE_DECL_ARGS_DEF);
+
+  static tapa::internal::Target *GetInstance() {
+    static CpuOptimizedTarget instance;
+    return &instance;
+  }
+
+  CpuOptimizedTarget(CpuOptimizedTarget const &) = delete;
+  void operator=(CpuOptimizedTarget const &) = delete;
+
+ protected:
+  CpuOptimizedTarget() {}
+};
+
+}  // namespace internal
+}  // namespace tapa
+
+#endif  // TAPA_CPU_OPTIMIZED_TARGET_H_
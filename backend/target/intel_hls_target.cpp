@@ -0,0 +1,227 @@
+#include "intel_hls_target.h"
+
+#include "../tapa/mmap.h"
+#include "../tapa/stream.h"
+#include "../tapa/type.h"
+
+#include <string>
+
+namespace tapa {
+namespace internal {
+
+// Unused component arguments are optimized away, so touch each of them.
+static void AddDummyMmapOrScalarRW(ADD_FOR_PARAMS_ARGS_DEF) {
+  auto param_name = param->getNameAsString();
+  if (IsTapaType(param, "(async_)?mmaps")) {
+    for (int i = 0; i < GetArraySize(param); ++i) {
+      add_line("{ auto val = reinterpret_cast<volatile uint8_t&>(" +
+               GetArrayElem(param_name, i) + "); }");
+    }
+  } else {
+    const bool is_const = param->getType().isConstQualified();
+    add_line(std::string("{ auto val = reinterpret_cast<volatile ") +
+             (is_const ? "const " : "") + "uint8_t&>(" + param_name + "); }");
+  }
+}
+
+void IntelHLSTarget::AddCodeForTopLevelStream(ADD_FOR_PARAMS_ARGS_DEF) {
+  add_line("#error streams not supported for Intel top-level tasks");
+}
+
+void IntelHLSTarget::AddCodeForTopLevelMmap(ADD_FOR_PARAMS_ARGS_DEF) {
+  AddDummyMmapOrScalarRW(ADD_FOR_PARAMS_ARGS);
+}
+
+void IntelHLSTarget::AddCodeForTopLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF) {
+  AddCodeForTopLevelMmap(ADD_FOR_PARAMS_ARGS);
+}
+
+void IntelHLSTarget::AddCodeForTopLevelScalar(ADD_FOR_PARAMS_ARGS_DEF) {
+  AddDummyMmapOrScalarRW(ADD_FOR_PARAMS_ARGS);
+}
+
+void IntelHLSTarget::AddCodeForMiddleLevelMmap(ADD_FOR_PARAMS_ARGS_DEF) {
+  AddCodeForMiddleLevelScalar(ADD_FOR_PARAMS_ARGS);
+}
+
+void IntelHLSTarget::AddCodeForMiddleLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF) {
+  AddCodeForMiddleLevelScalar(ADD_FOR_PARAMS_ARGS);
+}
+
+void IntelHLSTarget::AddCodeForMiddleLevelScalar(ADD_FOR_PARAMS_ARGS_DEF) {
+  AddDummyMmapOrScalarRW(ADD_FOR_PARAMS_ARGS);
+}
+
+void IntelHLSTarget::AddCodeForLowerLevelMmap(ADD_FOR_PARAMS_ARGS_DEF) {
+  if (IsTapaType(param, "mmaps")) {
+    add_line("#error mmaps not supported for lower level tasks");
+  }
+}
+
+void IntelHLSTarget::AddCodeForLowerLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF) {
+  add_line("#error async_mmap not supported for Intel tasks");
+}
+
+void IntelHLSTarget::AddCodeForLowerLevelBuffer(ADD_FOR_PARAMS_ARGS_DEF) {
+  add_line("#error buffer not supported for Intel tasks");
+}
+
+void IntelHLSTarget::RewriteTopLevelFunc(REWRITE_FUNC_ARGS_DEF) {
+  // Like the Xilinx target, the top-level task is an empty shell that only
+  // defines the control interface.
+  auto lines = GenerateCodeForTopLevelFunc(func);
+  rewriter.ReplaceText(func->getBody()->getSourceRange(),
+                       "{\n" + llvm::join(lines, "\n") + "}\n");
+  rewriter.InsertText(func->getBeginLoc(),
+                      "#include \"HLS/hls.h\"\n\n"
+                      "hls_avalon_slave_component\ncomponent ");
+}
+
+void IntelHLSTarget::RewriteMiddleLevelFunc(REWRITE_FUNC_ARGS_DEF) {
+  auto lines = GenerateCodeForMiddleLevelFunc(func);
+  rewriter.ReplaceText(func->getBody()->getSourceRange(),
+                       "{\n" + llvm::join(lines, "\n") + "}\n");
+  rewriter.InsertText(func->getBeginLoc(), "component ");
+}
+
+void IntelHLSTarget::RewriteLowerLevelFunc(REWRITE_FUNC_ARGS_DEF) {
+  // Each mmap is a memory-mapped host interface in its own address space, so
+  // that the load-store units accessing different mmaps are independent.
+  int address_space = 1;
+  for (const auto param : func->parameters()) {
+    if (!IsTapaType(param, "mmap")) {
+      continue;
+    }
+    const auto elem_type =
+        GetTemplateArg(param->getType(), 0)->getAsType().getUnqualifiedType();
+    const auto width = param->getASTContext().getTypeInfo(elem_type).Width;
+    std::string options;
+    if (const auto axi = param->getAttr<clang::TapaAxiAttr>()) {
+      // Outstanding requests are left to the compiler.
+      if (const auto burst = axi->getMaxBurst()) {
+        options += ", ihc::maxburst<" + std::to_string(burst) + ">";
+      }
+      if (const auto latency = axi->getLatency()) {
+        options += ", ihc::latency<" + std::to_string(latency) + ">";
+      }
+    }
+    rewriter.ReplaceText(
+        param->getTypeSourceInfo()->getTypeLoc().getSourceRange(),
+        "ihc::mm_host<" + GetMmapElemType(param) + ", ihc::aspace<" +
+            std::to_string(address_space++) +
+            ">, ihc::awidth<64>, ihc::dwidth<" + std::to_string(width) + ">" +
+            options + ">&");
+  }
+  BaseTarget::RewriteLowerLevelFunc(REWRITE_FUNC_ARGS);
+  rewriter.InsertText(func->getBeginLoc(), "component ");
+}
+
+void IntelHLSTarget::RewriteFuncArguments(const clang::FunctionDecl *func,
+                                          clang::Rewriter &rewriter,
+                                          bool top) {
+  // Replace mmaps arguments with 64-bit base addresses, which are registers of
+  // the Avalon slave interface of the top-level task.
+  const std::string prefix = top ? "hls_avalon_slave_register_argument " : "";
+  for (const auto param : func->parameters()) {
+    const std::string param_name = param->getNameAsString();
+    if (IsTapaType(param, "(async_)?mmap")) {
+      rewriter.ReplaceText(
+          param->getTypeSourceInfo()->getTypeLoc().getSourceRange(),
+          prefix + "uint64_t");
+    } else if (IsTapaType(param, "(async_)?mmaps")) {
+      std::string rewritten_text;
+      for (int i = 0; i < GetArraySize(param); ++i) {
+        if (!rewritten_text.empty()) rewritten_text += ", ";
+        rewritten_text += prefix + "uint64_t " + GetArrayElem(param_name, i);
+      }
+      rewriter.ReplaceText(param->getSourceRange(), rewritten_text);
+    } else if (top && !IsTapaType(param, "(i|o)streams?")) {
+      rewriter.InsertText(param->getBeginLoc(), prefix);
+    }
+  }
+}
+
+void IntelHLSTarget::RewritePipelinedDecl(REWRITE_DECL_ARGS_DEF,
+                                          const clang::Stmt *body) {
+  auto pipeline = llvm::dyn_cast<clang::TapaPipelineAttr>(attr);
+  auto func = llvm::dyn_cast<clang::FunctionDecl>(decl);
+  if (pipeline && func && pipeline->getII()) {
+    rewriter.InsertText(
+        func->getTypeSpecStartLoc(),
+        "hls_component_ii(" + std::to_string(pipeline->getII()) + ") ");
+  }
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+void IntelHLSTarget::RewritePipelinedStmt(REWRITE_STMT_ARGS_DEF,
+                                          const clang::Stmt *body) {
+  // Loops are pipelined by default, so only the II needs to be specified.
+  auto pipeline = llvm::dyn_cast<clang::TapaPipelineAttr>(attr);
+  auto attributed = llvm::dyn_cast<clang::AttributedStmt>(stmt);
+  if (pipeline && attributed && pipeline->getII()) {
+    rewriter.InsertTextBefore(attributed->getSubStmt()->getBeginLoc(),
+                              "[[intel::initiation_interval(" +
+                                  std::to_string(pipeline->getII()) + ")]] ");
+  }
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+void IntelHLSTarget::RewriteTripcountStmt(REWRITE_STMT_ARGS_DEF,
+                                          const clang::Stmt *body) {
+  // The Intel HLS Compiler reports latency symbolically, so trip counts are
+  // not needed.
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+void IntelHLSTarget::RewriteIndependentStmt(REWRITE_STMT_ARGS_DEF,
+                                            const clang::Stmt *body) {
+  auto independent = llvm::dyn_cast<clang::TapaIndependentAttr>(attr);
+  auto attributed = llvm::dyn_cast<clang::AttributedStmt>(stmt);
+  if (independent && attributed) {
+    std::string pragmas;
+    for (const auto var : independent->vars()) {
+      auto ref = llvm::cast<clang::DeclRefExpr>(var->IgnoreParenImpCasts());
+      pragmas +=
+          "\n#pragma ivdep array(" + ref->getDecl()->getNameAsString() + ")";
+    }
+    rewriter.InsertTextBefore(attributed->getSubStmt()->getBeginLoc(),
+                              pragmas + "\n");
+  }
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+void IntelHLSTarget::RewritePartitionedDecl(REWRITE_DECL_ARGS_DEF) {
+  // Complete partitions are implemented in registers, and cyclic partitions of
+  // one-dimensional arrays are implemented as interleaved memory banks. Other
+  // partitions are left to the compiler.
+  auto partition = llvm::dyn_cast<clang::TapaPartitionAttr>(attr);
+  auto var = llvm::dyn_cast<clang::VarDecl>(decl);
+  if (partition && var && !llvm::isa<clang::ParmVarDecl>(var)) {
+    auto &context = var->getASTContext();
+    auto array = context.getAsConstantArrayType(var->getType());
+    std::string attrs;
+    if (partition->getType() == clang::TapaPartitionAttr::Complete) {
+      attrs = "hls_register ";
+    } else if (partition->getType() == clang::TapaPartitionAttr::Cyclic &&
+               partition->getDim() == 1 && array &&
+               !array->getElementType()->isArrayType()) {
+      attrs = "hls_numbanks(" + std::to_string(partition->getFactor()) +
+              ") hls_bankwidth(" +
+              std::to_string(context.getTypeSizeInChars(array->getElementType())
+                                 .getQuantity()) +
+              ") ";
+    }
+    if (!attrs.empty()) {
+      rewriter.InsertText(var->getTypeSpecStartLoc(), attrs);
+    }
+  }
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+// The options are added to the mm_host type of the parameter.
+void IntelHLSTarget::RewriteAxiParam(REWRITE_DECL_ARGS_DEF) {
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+}  // namespace internal
+}  // namespace tapa
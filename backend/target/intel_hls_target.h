@@ -0,0 +1,54 @@
+#ifndef TAPA_INTEL_HLS_TARGET_H_
+#define TAPA_INTEL_HLS_TARGET_H_
+
+#include "base_target.h"
+
+namespace tapa {
+namespace internal {
+
+// Generates code for the Intel HLS Compiler (i++). Each task becomes a
+// `component`; mmaps of lower-level tasks become `ihc::mm_host` interfaces, and
+// pipelined loops use `[[intel::initiation_interval]]`.
+class IntelHLSTarget : public BaseTarget {
+ public:
+  virtual void AddCodeForTopLevelStream(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForTopLevelMmap(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForTopLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForTopLevelScalar(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForMiddleLevelMmap(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForMiddleLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForMiddleLevelScalar(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForLowerLevelMmap(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForLowerLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForLowerLevelBuffer(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void RewriteTopLevelFunc(REWRITE_FUNC_ARGS_DEF);
+  virtual void RewriteMiddleLevelFunc(REWRITE_FUNC_ARGS_DEF);
+  virtual void RewriteLowerLevelFunc(REWRITE_FUNC_ARGS_DEF);
+  virtual void RewriteFuncArguments(REWRITE_FUNC_ARGS_DEF, bool top);
+  virtual void RewritePipelinedDecl(REWRITE_DECL_ARGS_DEF,
+                                    const clang::Stmt *body);
+  virtual void RewritePipelinedStmt(REWRITE_STMT_ARGS_DEF,
+                                    const clang::Stmt *body);
+  virtual void RewriteTripcountStmt(REWRITE_STMT_ARGS_DEF,
+                                    const clang::Stmt *body);
+  virtual void RewriteIndependentStmt(REWRITE_STMT_ARGS_DEF,
+                                      const clang::Stmt *body);
+  virtual void RewritePartitionedDecl(REWRITE_DECL_ARGS_DEF);
+  virtual void RewriteAxiParam(REWRITE_DECL_ARGS_DEF);
+
+  static tapa::internal::Target *GetInstance() {
+    static IntelHLSTarget instance;
+    return &instance;
+  }
+
+  IntelHLSTarget(IntelHLSTarget const &) = delete;
+  void operator=(IntelHLSTarget const &) = delete;
+
+ protected:
+  IntelHLSTarget() {}
+};
+
+}  // namespace internal
+}  // namespace tapa
+
+#endif  // TAPA_INTEL_HLS_TARGET_H_
@@ -4,7 +4,7 @@
 #include "../tapa/stream.h"
 #include "../tapa/type.h"
 
-#include <cctype>
+#include <map>
 #include <string>
 
 using llvm::StringRef;
@@ -12,6 +12,16 @@ using llvm::StringRef;
 namespace tapa {
 namespace internal {
 
+extern bool ap_ctrl_chain;
+extern const std::map<std::string, uint64_t>* specialized_scalars;
+
+// Returns whether `param` of the top-level task is bound to a constant by
+// -specialize-scalar, so that it is not a port of the kernel.
+static bool IsSpecializedScalar(const clang::ParmVarDecl *param) {
+  return specialized_scalars != nullptr &&
+         specialized_scalars->count(param->getNameAsString()) > 0;
+}
+
 static void AddDummyStreamRW(ADD_FOR_PARAMS_ARGS_DEF, bool qdma) {
   auto param_name = param->getNameAsString();
   auto add_dummy_read = [&add_line](std::string name) {
@@ -72,6 +82,9 @@ static void AddDummyMmapOrScalarRW(ADD_FOR_PARAMS_ARGS_DEF) {
 
 void XilinxHLSTarget::AddCodeForTopLevelFunc(ADD_FOR_FUNC_ARGS_DEF) {
   add_pragma({"HLS interface s_axilite port = return bundle = control"});
+  if (ap_ctrl_chain) {
+    add_pragma({"HLS interface ap_ctrl_chain port = return bundle = control"});
+  }
   add_line("");
 }
 
@@ -99,11 +112,17 @@ void XilinxHLSTarget::AddCodeForTopLevelMmap(ADD_FOR_PARAMS_ARGS_DEF) {
 }
 
 void XilinxHLSTarget::AddCodeForTopLevelScalar(ADD_FOR_PARAMS_ARGS_DEF) {
+  if (IsSpecializedScalar(param)) {
+    return;
+  }
   add_pragma({"HLS interface s_axilite port =", param->getNameAsString(),
               "bundle = control"});
   AddDummyMmapOrScalarRW(ADD_FOR_PARAMS_ARGS);
 }
 
+// The body of a middle-level task is discarded by tapac, but its streams are
+// still read or written once besides being queried, so that HLS generates the
+// same FIFO ports as it does for tasks that access them.
 void XilinxHLSTarget::AddCodeForMiddleLevelStream(ADD_FOR_PARAMS_ARGS_DEF) {
   AddCodeForLowerLevelStream(ADD_FOR_PARAMS_ARGS);
   AddDummyStreamRW(ADD_FOR_PARAMS_ARGS, false);
@@ -187,15 +206,50 @@ void XilinxHLSTarget::AddCodeForLowerLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF) {
   add_line("void(" + name + ".write_resp._peek.empty());");
 }
 
+// A buffer endpoint is a request FIFO and a response FIFO, which tapac
+// connects to the ping_pong_buffer module shared by both endpoints.
+void XilinxHLSTarget::AddCodeForLowerLevelBuffer(ADD_FOR_PARAMS_ARGS_DEF) {
+  const auto name = param->getNameAsString();
+  add_pragma({"HLS disaggregate variable =", name});
+  for (auto tag : {".request", ".response"}) {
+    const auto fifo_var = GetFifoVar(name + tag);
+    add_pragma({"HLS interface ap_fifo port =", fifo_var});
+    add_pragma({"HLS aggregate variable =", fifo_var, " bit"});
+  }
+  add_pragma({"HLS disaggregate variable =", name, ".response"});
+  const auto peek_var = GetPeekVar(name + ".response");
+  add_pragma({"HLS interface ap_fifo port =", peek_var});
+  add_pragma({"HLS aggregate variable =", peek_var, "bit"});
+  add_line("void(" + name + ".request._.full());");
+  add_line("void(" + name + ".response._.empty());");
+  add_line("void(" + name + ".response._peek.empty());");
+}
+
 void XilinxHLSTarget::AddCodeForLowerLevelMmap(ADD_FOR_PARAMS_ARGS_DEF) {
   if (IsTapaType(param, "mmaps")) {
     add_line("#error mmaps not supported for lower level tasks");
     return;
   }
 
+  // Options of the m_axi adapter generated by HLS for this mmap.
+  std::string options;
+  if (const auto axi = param->getAttr<clang::TapaAxiAttr>()) {
+    if (const auto burst = axi->getMaxBurst()) {
+      options += " max_read_burst_length = " + std::to_string(burst) +
+                 " max_write_burst_length = " + std::to_string(burst);
+    }
+    if (const auto outstanding = axi->getOutstanding()) {
+      options += " num_read_outstanding = " + std::to_string(outstanding) +
+                 " num_write_outstanding = " + std::to_string(outstanding);
+    }
+    if (const auto latency = axi->getLatency()) {
+      options += " latency = " + std::to_string(latency);
+    }
+  }
+
   const auto name = param->getNameAsString();
-  add_pragma(
-      {"HLS interface m_axi port =", name, "offset = direct bundle =", name});
+  add_pragma({"HLS interface m_axi port =", name,
+              "offset = direct bundle =", name + options});
 }
 
 void XilinxHLSTarget::RewriteTopLevelFunc(REWRITE_FUNC_ARGS_DEF) {
@@ -252,42 +306,35 @@ void XilinxHLSTarget::RewriteFuncArguments(const clang::FunctionDecl *func,
       }
     }
   }
-}
 
-static clang::SourceRange ExtendAttrRemovalRange(clang::Rewriter &rewriter,
-                                                 clang::SourceRange range) {
-  auto begin = range.getBegin();
-  auto end = range.getEnd();
-
-#define BEGIN(OFF) (begin.getLocWithOffset(OFF))
-#define END(OFF) (end.getLocWithOffset(OFF))
-#define STR_AT(BEGIN, END) \
-  (rewriter.getRewrittenText(clang::SourceRange((BEGIN), (END))))
-#define IS_IGNORE(STR) ((STR) == "" || std::isspace((STR)[0]))
-
-  // Find the true end of the token
-  for (; std::isalpha(STR_AT(END(1), END(1))[0]); end = END(1))
-    ;
-
-  // Remove all whitespaces around the attribute
-  for (; IS_IGNORE(STR_AT(BEGIN(-1), BEGIN(-1))); begin = BEGIN(-1))
-    ;
-  for (; IS_IGNORE(STR_AT(END(1), END(1))); end = END(1))
-    ;
-
-  // Remove comma if around the attribute
-  if (STR_AT(BEGIN(-1), BEGIN(-1)) == ",") {
-    begin = BEGIN(-1);
-  } else if (STR_AT(END(1), END(1)) == ",") {
-    end = END(1);
-  } else if (STR_AT(BEGIN(-2), BEGIN(-1)) == "[[" &&
-             STR_AT(END(1), END(2)) == "]]") {
-    // Check if the attribute is completely removed
-    begin = BEGIN(-2);
-    end = END(2);
+  // Remove specialized scalars from the interface, each with the comma that
+  // separates it from the next parameter, or from the previous one if all
+  // parameters after it are removed as well.
+  if (!top) {
+    return;
+  }
+  const auto &source_manager = rewriter.getSourceMgr();
+  const auto &lang_opts = rewriter.getLangOpts();
+  const auto params = func->parameters();
+  auto end_of = [&](const clang::ParmVarDecl *param) {
+    return clang::Lexer::getLocForEndOfToken(param->getEndLoc(), 0,
+                                             source_manager, lang_opts);
+  };
+  size_t tail = params.size();
+  while (tail > 0 && IsSpecializedScalar(params[tail - 1])) {
+    --tail;
+  }
+  for (size_t i = 0; i < tail; ++i) {
+    if (IsSpecializedScalar(params[i])) {
+      rewriter.RemoveText(clang::CharSourceRange::getCharRange(
+          params[i]->getBeginLoc(), params[i + 1]->getBeginLoc()));
+    }
+  }
+  if (tail < params.size()) {
+    rewriter.RemoveText(clang::CharSourceRange::getCharRange(
+        tail > 0 ? end_of(params[tail - 1]) : params[tail]->getBeginLoc(),
+        end_of(params.back())));
   }
-
-  return clang::SourceRange(begin, end);
 }
 
 static void AddPragmaToBody(clang::Rewriter &rewriter, const clang::Stmt *body,
@@ -326,5 +373,115 @@ void XilinxHLSTarget::RewritePipelinedStmt(REWRITE_STMT_ARGS_DEF,
   rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
 }
 
+void XilinxHLSTarget::RewriteTripcountStmt(REWRITE_STMT_ARGS_DEF,
+                                           const clang::Stmt *body) {
+  if (auto tripcount = llvm::dyn_cast<clang::TapaTripcountAttr>(attr)) {
+    std::string pragma = "HLS loop_tripcount min = " +
+                         std::to_string(tripcount->getMin()) +
+                         " max = " + std::to_string(tripcount->getMax());
+    if (tripcount->getAvg()) {
+      pragma += " avg = " + std::to_string(tripcount->getAvg());
+    }
+    if (body) AddPragmaToBody(rewriter, body, pragma);
+  }
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+void XilinxHLSTarget::RewriteIndependentStmt(REWRITE_STMT_ARGS_DEF,
+                                             const clang::Stmt *body) {
+  if (auto independent = llvm::dyn_cast<clang::TapaIndependentAttr>(attr)) {
+    for (const auto var : independent->vars()) {
+      auto ref = llvm::cast<clang::DeclRefExpr>(var->IgnoreParenImpCasts());
+      if (body) {
+        AddPragmaToBody(rewriter, body,
+                        "HLS dependence variable = " +
+                            ref->getDecl()->getNameAsString() + " inter false");
+      }
+    }
+  }
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+// Inserts `pragma` after the declaration of local variable `var`, which must
+// declare nothing else; `what` describes the variable in the error otherwise.
+static void AddPragmaAfterDecl(clang::Rewriter &rewriter,
+                               const clang::VarDecl *var,
+                               const std::string &pragma,
+                               const std::string &what) {
+  auto loc = clang::Lexer::findLocationAfterToken(
+      var->getEndLoc(), clang::tok::semi, rewriter.getSourceMgr(),
+      rewriter.getLangOpts(), /*SkipTrailingWhitespaceAndNewLine=*/false);
+  if (loc.isValid()) {
+    rewriter.InsertText(loc, "\n#pragma " + pragma + "\n");
+  } else {
+    rewriter.InsertTextAfterToken(
+        var->getEndLoc(),
+        "\n#error " + what + " must be declared separately\n");
+  }
+}
+
+void XilinxHLSTarget::RewritePartitionedDecl(REWRITE_DECL_ARGS_DEF) {
+  auto partition = llvm::dyn_cast<clang::TapaPartitionAttr>(attr);
+  auto var = llvm::dyn_cast<clang::VarDecl>(decl);
+  if (partition && var) {
+    std::string pragma =
+        "HLS array_partition variable = " + var->getNameAsString() + " " +
+        clang::TapaPartitionAttr::ConvertPartitionTypeToStr(
+            partition->getType());
+    if (partition->getFactor()) {
+      pragma += " factor = " + std::to_string(partition->getFactor());
+    }
+    pragma += " dim = " + std::to_string(partition->getDim());
+
+    if (llvm::isa<clang::ParmVarDecl>(var)) {
+      // Partition of an argument goes to the beginning of the function body.
+      auto func = llvm::dyn_cast<clang::FunctionDecl>(var->getDeclContext());
+      if (func && func->hasBody()) {
+        AddPragmaToBody(rewriter, func->getBody(), pragma);
+      }
+    } else {
+      AddPragmaAfterDecl(rewriter, var, pragma, "partitioned array");
+    }
+  }
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+// The options are added to the m_axi pragma of the parameter.
+void XilinxHLSTarget::RewriteAxiParam(REWRITE_DECL_ARGS_DEF) {
+  rewriter.RemoveText(ExtendAttrRemovalRange(rewriter, attr->getRange()));
+}
+
+// A tapa::local_array is declared as a C array, bound to the memory given by
+// its Impl template argument unless HLS is to choose.
+void XilinxHLSTarget::RewriteLocalArrayDecl(const clang::VarDecl *decl,
+                                            clang::Rewriter &rewriter) {
+  const auto array = llvm::dyn_cast<clang::ClassTemplateSpecializationDecl>(
+      decl->getType()->getAsRecordDecl());
+  if (array == nullptr) {
+    return;
+  }
+  const auto &context = decl->getASTContext();
+  const auto args = array->getTemplateArgs().asArray();
+  clang::QualType elem_type = args[0].getAsType();
+  std::string dims =
+      "[" + std::to_string(args[1].getAsIntegral().getZExtValue()) + "]";
+  while (const auto elem_array = context.getAsConstantArrayType(elem_type)) {
+    dims += "[" + std::to_string(elem_array->getSize().getZExtValue()) + "]";
+    elem_type = elem_array->getElementType();
+  }
+  const std::string name = decl->getNameAsString();
+  rewriter.ReplaceText(
+      clang::SourceRange(decl->getTypeSpecStartLoc(), decl->getLocation()),
+      elem_type.getAsString(context.getPrintingPolicy()) + " " + name + dims);
+
+  const std::string impl = GetStreamImpl(array, 2);
+  if (!impl.empty()) {
+    AddPragmaAfterDecl(
+        rewriter, decl,
+        "HLS bind_storage variable = " + name + " type = ram_2p impl = " + impl,
+        "local array");
+  }
+}
+
 }  // namespace internal
 }  // namespace tapa
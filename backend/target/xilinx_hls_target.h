@@ -18,6 +18,7 @@ class XilinxHLSTarget : public BaseTarget {
   virtual void AddCodeForTopLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF);
   virtual void AddCodeForMiddleLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF);
   virtual void AddCodeForLowerLevelAsyncMmap(ADD_FOR_PARAMS_ARGS_DEF);
+  virtual void AddCodeForLowerLevelBuffer(ADD_FOR_PARAMS_ARGS_DEF);
   virtual void AddCodeForTopLevelScalar(ADD_FOR_PARAMS_ARGS_DEF);
   virtual void AddCodeForMiddleLevelScalar(ADD_FOR_PARAMS_ARGS_DEF);
   virtual void RewriteTopLevelFunc(REWRITE_FUNC_ARGS_DEF);
@@ -27,6 +28,14 @@ class XilinxHLSTarget : public BaseTarget {
                                     const clang::Stmt *body);
   virtual void RewritePipelinedStmt(REWRITE_STMT_ARGS_DEF,
                                     const clang::Stmt *body);
+  virtual void RewriteTripcountStmt(REWRITE_STMT_ARGS_DEF,
+                                    const clang::Stmt *body);
+  virtual void RewriteIndependentStmt(REWRITE_STMT_ARGS_DEF,
+                                      const clang::Stmt *body);
+  virtual void RewritePartitionedDecl(REWRITE_DECL_ARGS_DEF);
+  virtual void RewriteAxiParam(REWRITE_DECL_ARGS_DEF);
+  virtual void RewriteLocalArrayDecl(const clang::VarDecl *decl,
+                                     clang::Rewriter &rewriter);
 
   static tapa::internal::Target *GetInstance() {
     static XilinxHLSTarget instance;
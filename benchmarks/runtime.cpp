@@ -0,0 +1,206 @@
+// Microbenchmarks of the primitives of the software simulation runtime.
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <array>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <tapa.h>
+
+namespace {
+
+constexpr int64_t kTokens = 1 << 16;  // Tokens transferred per iteration.
+constexpr int64_t kTasks = 256;       // Tasks invoked per iteration.
+
+// A token of `Bytes` bytes.
+template <size_t Bytes>
+struct token {
+  std::array<uint8_t, Bytes> data;
+};
+
+// Sets the number of workers used by the next top-level task.
+void set_worker_count(int64_t count) {
+  setenv("TAPA_CONCURRENCY", std::to_string(count).c_str(), /*overwrite=*/1);
+}
+
+void add_worker_counts(benchmark::internal::Benchmark* b) {
+  const int64_t max_count = std::thread::hardware_concurrency();
+  for (int64_t count = 1; count < max_count; count *= 2) b->Arg(count);
+  b->Arg(max_count);
+}
+
+// Writes and reads a token on the calling thread, so the stream is never full
+// or empty and the cost of the stream itself is measured.
+template <typename T>
+void BM_StreamWriteRead(benchmark::State& state) {
+  tapa::stream<T, 2> stream("stream");
+  T value{};
+  for (auto _ : state) {
+    stream.write(value);
+    value = stream.read();
+    benchmark::DoNotOptimize(value);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * sizeof(T));
+}
+BENCHMARK_TEMPLATE(BM_StreamWriteRead, token<4>);
+BENCHMARK_TEMPLATE(BM_StreamWriteRead, token<64>);
+BENCHMARK_TEMPLATE(BM_StreamWriteRead, token<512>);
+
+// Transfers tokens between a producer thread and a consumer thread through a
+// queue of depth `state.range(0)`, bypassing the scheduler.
+template <template <typename> class Queue, typename T>
+void BM_QueueThroughput(benchmark::State& state) {
+  using elem_t = tapa::internal::elem_t<T>;
+  Queue<elem_t> queue(state.range(0));
+  const elem_t value{};
+  for (auto _ : state) {
+    std::thread producer([&queue, &value] {
+      for (int64_t i = 0; i < kTokens;) {
+        if (!queue.full() && queue.try_push(value)) {
+          ++i;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+    for (int64_t i = 0; i < kTokens;) {
+      if (!queue.empty() && queue.try_pop([](elem_t&) {})) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    producer.join();
+  }
+  state.SetItemsProcessed(state.iterations() * kTokens);
+  state.SetBytesProcessed(state.iterations() * kTokens * sizeof(T));
+}
+BENCHMARK_TEMPLATE(BM_QueueThroughput, tapa::internal::lock_free_queue,
+                   token<8>)
+    ->Arg(2)
+    ->Arg(64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_QueueThroughput, tapa::internal::locked_queue, token<8>)
+    ->Arg(2)
+    ->Arg(64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_QueueThroughput, tapa::internal::lock_free_queue,
+                   token<512>)
+    ->Arg(64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_QueueThroughput, tapa::internal::locked_queue,
+                   token<512>)
+    ->Arg(64)
+    ->UseRealTime();
+
+void Ping(tapa::ostream<int64_t>& out, tapa::istream<int64_t>& in, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    out.write(i);
+    in.read();
+  }
+}
+
+void Pong(tapa::istream<int64_t>& in, tapa::ostream<int64_t>& out, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) out.write(in.read());
+}
+
+// Bounces a token between two tasks, so each transfer is a context switch, or
+// a cross-thread handoff if the tasks run on different workers.
+void BM_ContextSwitch(benchmark::State& state) {
+  set_worker_count(state.range(0));
+  for (auto _ : state) {
+    tapa::stream<int64_t, 1> ping("ping");
+    tapa::stream<int64_t, 1> pong("pong");
+    tapa::task()
+        .invoke(Ping, ping, pong, kTokens)
+        .invoke(Pong, ping, pong, kTokens);
+  }
+  state.SetItemsProcessed(state.iterations() * kTokens * 2);
+}
+BENCHMARK(BM_ContextSwitch)->Apply(add_worker_counts)->UseRealTime();
+
+template <typename T>
+void Source(tapa::ostream<T>& out, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) out.write(T{});
+}
+
+template <typename T>
+void Relay(tapa::istream<T>& in, tapa::ostream<T>& out, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) out.write(in.read());
+}
+
+template <typename T>
+void Sink(tapa::istream<T>& in, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) in.read();
+}
+
+// Streams tokens through a pipeline of 8 tasks.
+template <typename T>
+void BM_Pipeline(benchmark::State& state) {
+  set_worker_count(state.range(0));
+  for (auto _ : state) {
+    tapa::streams<T, 7, 16> s("s");
+    tapa::task()
+        .invoke(Source<T>, s, kTokens)
+        .template invoke<tapa::join, 6>(Relay<T>, s, s, kTokens)
+        .invoke(Sink<T>, s, kTokens);
+  }
+  state.SetItemsProcessed(state.iterations() * kTokens);
+  state.SetBytesProcessed(state.iterations() * kTokens * sizeof(T));
+}
+BENCHMARK_TEMPLATE(BM_Pipeline, token<4>)
+    ->Apply(add_worker_counts)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Pipeline, token<512>)
+    ->Apply(add_worker_counts)
+    ->UseRealTime();
+
+template <typename T>
+void Load(tapa::async_mmap<T>& mem, tapa::ostream<T>& out, int64_t n) {
+  tapa::mem_to_stream(mem, out, n);
+}
+
+// Reads memory through the service task of an async_mmap.
+template <typename T>
+void BM_AsyncMmapRead(benchmark::State& state) {
+  set_worker_count(state.range(0));
+  std::vector<T> buf(kTokens);
+  tapa::mmap<T> mem(buf.data(), buf.size());
+  for (auto _ : state) {
+    tapa::stream<T, 32> s("s");
+    tapa::task()
+        .invoke(Load<T>, mem, s, kTokens)
+        .invoke(Sink<T>, s, kTokens);
+  }
+  state.SetItemsProcessed(state.iterations() * kTokens);
+  state.SetBytesProcessed(state.iterations() * kTokens * sizeof(T));
+}
+BENCHMARK_TEMPLATE(BM_AsyncMmapRead, token<4>)
+    ->Apply(add_worker_counts)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_AsyncMmapRead, token<64>)
+    ->Apply(add_worker_counts)
+    ->UseRealTime();
+
+void Nop(int64_t) {}
+
+// Invokes tasks that return at once, which measures the cost of spawning and
+// finishing a task.
+void BM_TaskInvoke(benchmark::State& state) {
+  set_worker_count(state.range(0));
+  for (auto _ : state) {
+    tapa::task parent;
+    for (int64_t i = 0; i < kTasks; ++i) parent.invoke(Nop, i);
+  }
+  state.SetItemsProcessed(state.iterations() * kTasks);
+}
+BENCHMARK(BM_TaskInvoke)->Apply(add_worker_counts)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,258 @@
+#!/usr/bin/python3
+"""Benchmarks software simulation of the apps end to end.
+
+Each app is run at several input sizes and ``TAPA_CONCURRENCY`` settings, and
+its wall time, kernel time, and stream throughput are written as JSON. The
+number of tokens of a run is counted once per input size with
+``TAPA_STREAM_STATS=1``, which does not depend on the concurrency; the timed
+runs do not collect stream statistics.
+
+The designs under ``regression/`` have no host programs and are not covered.
+"""
+
+import argparse
+import datetime
+import json
+import logging
+import os
+import os.path
+import re
+import subprocess
+import sys
+import time
+from typing import Any, Dict, List, NamedTuple, Optional, Tuple
+
+logging.basicConfig(
+    level=logging.INFO,
+    format=
+    '%(levelname).1s%(asctime)s.%(msecs)03d %(name)s:%(lineno)d] %(message)s',
+    datefmt='%m%d %H:%M:%S',
+)
+
+_logger = logging.getLogger().getChild(__name__)
+
+
+class Design(NamedTuple):
+  name: str
+  # path of the host binary relative to the build directory
+  binary: str
+  # input size name -> command-line arguments of the host binary; arguments
+  # may refer to the directory of the binary as `{dir}`
+  sizes: Dict[str, Tuple[str, ...]]
+
+
+DESIGNS = (
+    Design('vadd', 'apps/vadd/vadd', {
+        'small': ('4096',),
+        'medium': ('65536',),
+        'large': ('1048576',),
+    }),
+    Design('nested-vadd', 'apps/nested-vadd/nested-vadd', {
+        'small': ('4096',),
+        'medium': ('65536',),
+        'large': ('1048576',),
+    }),
+    Design('shared-vadd', 'apps/shared-vadd/shared-vadd', {
+        'small': ('4096',),
+        'medium': ('65536',),
+        'large': ('1048576',),
+    }),
+    Design('bandwidth', 'apps/bandwidth/bandwidth', {
+        'small': ('4096',),
+        'medium': ('65536',),
+        'large': ('1048576',),
+    }),
+    Design('jacobi', 'apps/jacobi/jacobi', {
+        'small': ('100',),
+        'medium': ('1000',),
+        'large': ('10000',),
+    }),
+    Design('graph', 'apps/graph/graph', {
+        'small': ('{dir}/facebook.txt', '1024'),
+        'medium': ('{dir}/facebook.txt', '512'),
+    }),
+    Design('cannon', 'apps/cannon/cannon', {
+        'small': ('64',),
+        'medium': ('128',),
+        'large': ('256',),
+    }),
+    # network has a fixed input size
+    Design('network', 'apps/network/network', {'default': ()}),
+)
+
+_KERNEL_TIME = re.compile(r'elapsed time: ([0-9.eE+-]+) s')
+_PUSHES = re.compile(r"^.*'.*' \(depth \d+\): pushes=(\d+) ", re.MULTILINE)
+
+
+class Run(NamedTuple):
+  passed: bool
+  wall_seconds: float
+  kernel_seconds: Optional[float]
+  output: str
+
+
+def run(cmd: List[str], env: Dict[str, str]) -> Run:
+  start = time.monotonic()
+  proc = subprocess.run(
+      cmd,
+      env=env,
+      stdout=subprocess.PIPE,
+      stderr=subprocess.STDOUT,
+      universal_newlines=True,
+      check=False,
+  )
+  wall_seconds = time.monotonic() - start
+  match = _KERNEL_TIME.search(proc.stdout)
+  return Run(
+      passed=proc.returncode == 0,
+      wall_seconds=wall_seconds,
+      kernel_seconds=float(match[1]) if match else None,
+      output=proc.stdout,
+  )
+
+
+def count_tokens(cmd: List[str], env: Dict[str, str]) -> Optional[int]:
+  """Returns the number of tokens written to all streams, or None."""
+  env = dict(env, TAPA_STREAM_STATS='1', GLOG_logtostderr='1')
+  result = run(cmd, env)
+  if not result.passed:
+    return None
+  return sum(int(x) for x in _PUSHES.findall(result.output))
+
+
+def benchmark(
+    design: Design,
+    build_dir: str,
+    sizes: Optional[List[str]],
+    concurrency_list: List[int],
+    repetitions: int,
+) -> List[Dict[str, Any]]:
+  binary = os.path.join(build_dir, design.binary)
+  if not os.path.isfile(binary):
+    _logger.warning('skipping %s: %s not found', design.name, binary)
+    return []
+
+  results = []
+  for size, args in design.sizes.items():
+    if sizes and size not in sizes:
+      continue
+    cmd = [binary, *(x.format(dir=os.path.dirname(binary)) for x in args)]
+    tokens = count_tokens(cmd, dict(os.environ))
+    for concurrency in concurrency_list:
+      env = dict(os.environ, TAPA_CONCURRENCY=str(concurrency))
+      env.pop('TAPA_STREAM_STATS', None)
+      runs = [run(cmd, env) for _ in range(repetitions)]
+      passed = all(x.passed for x in runs)
+      if not passed:
+        _logger.error('%s (%s) failed:\n%s', design.name, size,
+                      next(x for x in runs if not x.passed).output)
+
+      # the fastest run is the least disturbed by the rest of the system
+      best = min(runs, key=lambda x: x.wall_seconds)
+      seconds = best.kernel_seconds or best.wall_seconds
+      result = {
+          'design': design.name,
+          'size': size,
+          'args': cmd[1:],
+          'concurrency': concurrency,
+          'repetitions': repetitions,
+          'passed': passed,
+          'wall_seconds': best.wall_seconds,
+          'kernel_seconds': best.kernel_seconds,
+          'tokens': tokens,
+          'tokens_per_second': tokens / seconds if tokens is not None else None,
+      }
+      _logger.info(
+          '%s (%s, concurrency %d): wall %.3f s, kernel %s s, %s tokens/s',
+          design.name,
+          size,
+          concurrency,
+          best.wall_seconds,
+          best.kernel_seconds,
+          result['tokens_per_second'],
+      )
+      results.append(result)
+  return results
+
+
+def create_parser() -> argparse.ArgumentParser:
+  parser = argparse.ArgumentParser(
+      description='Benchmarks software simulation of the apps.')
+  parser.add_argument(
+      '--build-dir',
+      type=str,
+      required=True,
+      help='CMake build directory in which the apps are built.',
+  )
+  parser.add_argument(
+      '--design',
+      type=str,
+      action='append',
+      choices=[x.name for x in DESIGNS],
+      help='Design to run; may be repeated. All designs run by default.',
+  )
+  parser.add_argument(
+      '--size',
+      type=str,
+      action='append',
+      help='Input size to run, e.g., `small`; may be repeated. '
+      'All sizes run by default.',
+  )
+  parser.add_argument(
+      '--concurrency',
+      type=int,
+      action='append',
+      help='Value of `TAPA_CONCURRENCY` to run with; may be repeated. '
+      'Defaults to 1, 2, 4, ... up to the number of CPUs.',
+  )
+  parser.add_argument(
+      '--repetitions',
+      type=int,
+      default=3,
+      help='Number of timed runs per configuration; the fastest is reported.',
+  )
+  parser.add_argument(
+      '--output',
+      type=str,
+      help='Write the results to this JSON file instead of stdout.',
+  )
+  return parser
+
+
+def main(argv: Optional[List[str]] = None) -> int:
+  args = create_parser().parse_args(argv)
+
+  concurrency_list = args.concurrency
+  if not concurrency_list:
+    concurrency_list = [1]
+    while concurrency_list[-1] * 2 <= (os.cpu_count() or 1):
+      concurrency_list.append(concurrency_list[-1] * 2)
+
+  results = []
+  for design in DESIGNS:
+    if args.design and design.name not in args.design:
+      continue
+    results.extend(
+        benchmark(design, args.build_dir, args.size, concurrency_list,
+                  args.repetitions))
+
+  report = {
+      'context': {
+          'date': datetime.datetime.now().isoformat(),
+          'host_name': os.uname().nodename,
+          'num_cpus': os.cpu_count(),
+      },
+      'benchmarks': results,
+  }
+  if args.output:
+    with open(args.output, 'w') as output:
+      json.dump(report, output, indent=2)
+  else:
+    json.dump(report, sys.stdout, indent=2)
+    sys.stdout.write('\n')
+
+  return 0 if all(x['passed'] for x in results) else 1
+
+
+if __name__ == '__main__':
+  sys.exit(main())
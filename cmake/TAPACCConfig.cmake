@@ -31,9 +31,13 @@ function(add_tapa_target target_name)
   # * CONNECTIVITY: Optional, specifies DRAM connections using Xilinx's ini.
   # * CONSTRAINT: Optional if DIRECTIVE is not set, generate partitioning
   #   constraints.
+  #
+  # Options:
+  #
+  # * PRECOMPILE_HEADER: Precompile tapa.h for tapacc in the working directory.
   cmake_parse_arguments(
     TAPA
-    ""
+    "PRECOMPILE_HEADER"
     "OUTPUT;INPUT;TOP;PLATFORM;TAPAC;TAPACC;CFLAGS;FRT_INTERFACE;CLOCK_PERIOD;PART_NUM;DIRECTIVE;CONNECTIVITY;CONSTRAINT"
     ""
     ${ARGN})
@@ -107,6 +111,9 @@ function(add_tapa_target target_name)
   if(TAPA_CONSTRAINT)
     list(APPEND tapac_cmd --constraint ${TAPA_CONSTRAINT})
   endif()
+  if(TAPA_PRECOMPILE_HEADER)
+    list(APPEND tapac_cmd --precompile-header)
+  endif()
   list(APPEND tapac_cmd ${TAPA_UNPARSED_ARGUMENTS})
 
   add_custom_command(
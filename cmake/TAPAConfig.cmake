@@ -18,3 +18,13 @@ if(IS_DIRECTORY ${XLNX_INCLUDE_PATH})
   )
   message(STATUS "Using XILINX_HLS include path: ${XLNX_INCLUDE_PATH}")
 endif()
+
+function(tapa_precompile_headers target)
+  # Precompile tapa.h for the sources of a target that links tapa::tapa, so
+  # that it is parsed once instead of once per source file.
+  if(CMAKE_VERSION VERSION_LESS 3.16)
+    message(WARNING "precompiled headers require CMake 3.16 or newer")
+    return()
+  endif()
+  target_precompile_headers(${target} PRIVATE <tapa.h>)
+endfunction()
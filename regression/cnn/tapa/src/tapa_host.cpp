@@ -0,0 +1,166 @@
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+
+#include <ap_int.h>
+#include <tapa.h>
+
+using std::cout;
+using std::min;
+using std::vector;
+
+typedef ap_uint<512> A_t16;
+typedef ap_uint<512> B_t16;
+typedef ap_uint<512> C_t16;
+
+template <typename T>
+using aligned_vector = std::vector<T, tapa::aligned_allocator<T>>;
+
+// C[I][J] = A[I][K] * B[J][K]^T, where A holds the weights and B holds the
+// activations of an image.
+const int I = 208;
+const int J = 1024;
+const int K = 256;
+
+extern "C" {
+void kernel3(tapa::mmap<A_t16> A, tapa::mmap<B_t16> B, tapa::mmap<C_t16> C,
+             int batch);
+}
+
+void host_serialize_A(float *A_to, const float *A_from) {
+    unsigned int cnt = 0;
+
+    // io_L3
+    for (int c3 = 0; c3 <= 12; c3 += 1) {
+      // io_L2
+      for (int c4 = 0; c4 <= 15; c4 += 1)
+        for (int c5 = 0; c5 <= 255; c5 += 1)
+          A_to[cnt++] = A_from[(16 * c3 + c4) * 256 + c5];
+    }
+}
+
+void host_serialize_B(float *B_to, const float *B_from) {
+    unsigned int cnt = 0;
+
+    // io_L3
+    for (int c3 = 0; c3 <= 15; c3 += 1) {
+      // io_L2
+      for (int c4 = 0; c4 <= 63; c4 += 1)
+        for (int c5 = 0; c5 <= 255; c5 += 1)
+          B_to[cnt++] = B_from[(64 * c3 + c4) * 256 + c5];
+    }
+}
+
+void host_deserialize_C(float *C_to, const float *C_from) {
+    unsigned int cnt = 0;
+
+    // io_L3
+    for (int c3 = 0; c3 <= 15; c3 += 1) {
+      // io_L2
+      for (int c4 = 0; c4 <= 12; c4 += 1) {
+        // io_L1
+        // pe
+        for (int c5 = 0; c5 <= 15; c5 += 1)
+          for (int c6 = 0; c6 <= 63; c6 += 1)
+            C_to[(16 * c4 + c5) * 1024 + (64 * c3 + c6)] = C_from[cnt++];
+      }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 3) {
+        cout << "Usage: " << argv[0] << " [number of images] [batch size]\n";
+        return EXIT_FAILURE;
+    }
+    const int num_images = argc > 1 ? atoi(argv[1]) : 4;
+    const int batch = argc > 2 ? atoi(argv[2]) : 2;
+    if (num_images <= 0 || batch <= 0) {
+        cout << "number of images and batch size must be positive\n";
+        return EXIT_FAILURE;
+    }
+    const int num_batches = (num_images + batch - 1) / batch;
+
+    cout << "images = " << num_images << ", batch size = " << batch << "\n";
+
+    vector<float> A(I * K);
+    for (int i = 0; i < I; i++)
+      for (int k = 0; k < K; k++)
+        A[i * K + k] = (i + k) % 7 - 3;
+
+    vector<vector<float> > B(num_images, vector<float>(J * K));
+    for (int n = 0; n < num_images; n++)
+      for (int j = 0; j < J; j++)
+        for (int k = 0; k < K; k++)
+          B[n][j * K + k] = (3 * j + k + n) % 5 - 2;
+
+    // The weights are serialized once and shared by all batches, while the
+    // images of a batch are serialized back to back.
+    aligned_vector<float> dev_A(I * K);
+    host_serialize_A(dev_A.data(), A.data());
+
+    vector<aligned_vector<float> > dev_B(num_batches);
+    vector<aligned_vector<float> > dev_C(num_batches);
+    for (int b = 0; b < num_batches; b++) {
+        const int size = min(batch, num_images - b * batch);
+        dev_B[b].resize(size * J * K);
+        dev_C[b].resize(size * I * J);
+        for (int n = 0; n < size; n++) {
+            host_serialize_B(&dev_B[b][n * J * K], B[b * batch + n].data());
+        }
+    }
+
+    std::string bitstream;
+    if (const auto bitstream_ptr = getenv("TAPAB")) {
+        bitstream = bitstream_ptr;
+    }
+
+    // The bitstream is loaded once. With 2 slots, the transfer of a batch
+    // overlaps the computation of the previous one.
+    tapa::device device(bitstream, /*slots=*/2);
+
+    cout << "launch kernel\n";
+    auto start = std::chrono::steady_clock::now();
+    vector<tapa::invocation> invocations;
+    for (int b = 0; b < num_batches; b++) {
+        const int size = min(batch, num_images - b * batch);
+        invocations.push_back(device.invoke_async(
+            kernel3,
+            tapa::read_only_mmap<float>(dev_A).reinterpret<A_t16>(),
+            tapa::read_only_mmap<float>(dev_B[b]).reinterpret<B_t16>(),
+            tapa::write_only_mmap<float>(dev_C[b]).reinterpret<C_t16>(),
+            size));
+    }
+    double kernel_time = 0;
+    for (auto &invocation : invocations) {
+        kernel_time += invocation.wait().compute_ns;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double total_time =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    printf("Kernel time per image is %f ms\n", kernel_time * 1e-6 / num_images);
+    printf("Total time per image is %f ms\n", total_time * 1e-6 / num_images);
+
+    int err = 0;
+    vector<float> C(I * J);
+    for (int n = 0; n < num_images; n++) {
+        host_deserialize_C(C.data(), &dev_C[n / batch][n % batch * I * J]);
+        for (int i = 0; i < I; i++)
+          for (int j = 0; j < J; j++) {
+            float golden = 0;
+            for (int k = 0; k < K; k++)
+              golden += A[i * K + k] * B[n][j * K + k];
+            if (fabs(golden - C[i * J + j]) > 0.001)
+              err++;
+          }
+    }
+
+    if (err)
+      printf("Failed with %d errors!\n", err);
+    else
+      printf("Passed!\n");
+
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -79,139 +79,56 @@ void A_IO_L2_in_inter_trans_boundary( int idx, A_t8 local_A[16][32], tapa::istre
     }
 }
 
-void A_IO_L2_in( int idx, tapa::istream<A_t8>& fifo_A_in, tapa::ostream<A_t8>& fifo_A_out, tapa::ostream<A_t8>& fifo_A_local_out ) {
+void A_IO_L2_in( int idx, int batch, tapa::istream<A_t8>& fifo_A_in, tapa::ostream<A_t8>& fifo_A_out, tapa::ostream<A_t8>& fifo_A_local_out ) {
 #pragma HLS INLINE OFF
     int p0 = idx;
-    A_t8 local_A_ping[16][32];
-#pragma HLS ARRAY_MAP variable=local_A_ping instance=local_A horizontal
-#pragma HLS RESOURCE variable=local_A_ping core=RAM_2P_BRAM
-    A_t8 local_A_pong[16][32];
-#pragma HLS ARRAY_MAP variable=local_A_pong instance=local_A horizontal
-#pragma HLS RESOURCE variable=local_A_pong core=RAM_2P_BRAM
-    bool arb = 0;
-    bool inter_trans_en = 1;
-    bool intra_trans_en = 0;
-    {
-        {
-            if( arb == 0 ) {
-                A_IO_L2_in_inter_trans(
-                    idx,
-                    local_A_pong,
-                    fifo_A_in,
-                    fifo_A_out,
-                    inter_trans_en
-                );
-                A_IO_L2_in_intra_trans(
-                    idx,
-                    local_A_ping,
-                    fifo_A_local_out,
-                    intra_trans_en
-                );
-            }
-            else {
-                A_IO_L2_in_inter_trans(
-                    idx,
-                    local_A_ping,
-                    fifo_A_in,
-                    fifo_A_out,
-                    inter_trans_en
-                );
-                A_IO_L2_in_intra_trans(
-                    idx,
-                    local_A_pong,
-                    fifo_A_local_out,
-                    intra_trans_en
-                );
-            }
-            intra_trans_en = 1;
-            arb = !arb;
-        }
-        if( arb == 0 ) {
-            A_IO_L2_in_intra_trans(
-                idx,
-                local_A_ping,
-                fifo_A_local_out,
-                intra_trans_en
-            );
-        }
-        else {
-            A_IO_L2_in_intra_trans(
-                idx,
-                local_A_pong,
-                fifo_A_local_out,
-                intra_trans_en
-            );
-        }
+    A_t8 local_A[16][32];
+#pragma HLS RESOURCE variable=local_A core=RAM_2P_BRAM
+    // A holds the weights, which are loaded once and stay resident while the
+    // images of the batch stream through B.
+    A_IO_L2_in_inter_trans(
+        idx,
+        local_A,
+        fifo_A_in,
+        fifo_A_out,
+        1
+    );
+    for( int b = 0; b < batch; b++ ) {
+        A_IO_L2_in_intra_trans(
+            idx,
+            local_A,
+            fifo_A_local_out,
+            1
+        );
     }
 }
 
-void A_IO_L2_in_boundary( int idx, tapa::istream<A_t8>& fifo_A_in, tapa::ostream<A_t8>& fifo_A_local_out ) {
+void A_IO_L2_in_boundary( int idx, int batch, tapa::istream<A_t8>& fifo_A_in, tapa::ostream<A_t8>& fifo_A_local_out ) {
 #pragma HLS INLINE OFF
     int p0 = idx;
-    A_t8 local_A_ping[16][32];
-#pragma HLS ARRAY_MAP variable=local_A_ping instance=local_A horizontal
-#pragma HLS RESOURCE variable=local_A_ping core=RAM_2P_BRAM
-    A_t8 local_A_pong[16][32];
-#pragma HLS ARRAY_MAP variable=local_A_pong instance=local_A horizontal
-#pragma HLS RESOURCE variable=local_A_pong core=RAM_2P_BRAM
-    bool arb = 0;
-    bool inter_trans_en = 1;
-    bool intra_trans_en = 0;
-    {
-        {
-            if( arb == 0 ) {
-                A_IO_L2_in_inter_trans_boundary(
-                    idx,
-                    local_A_pong,
-                    fifo_A_in,
-                    inter_trans_en
-                );
-                A_IO_L2_in_intra_trans(
-                    idx,
-                    local_A_ping,
-                    fifo_A_local_out,
-                    intra_trans_en
-                );
-            }
-            else {
-                A_IO_L2_in_inter_trans_boundary(
-                    idx,
-                    local_A_ping,
-                    fifo_A_in,
-                    inter_trans_en
-                );
-                A_IO_L2_in_intra_trans(
-                    idx,
-                    local_A_pong,
-                    fifo_A_local_out,
-                    intra_trans_en
-                );
-            }
-            intra_trans_en = 1;
-            arb = !arb;
-        }
-        if( arb == 0 ) {
-            A_IO_L2_in_intra_trans(
-                idx,
-                local_A_ping,
-                fifo_A_local_out,
-                intra_trans_en
-            );
-        }
-        else {
-            A_IO_L2_in_intra_trans(
-                idx,
-                local_A_pong,
-                fifo_A_local_out,
-                intra_trans_en
-            );
-        }
+    A_t8 local_A[16][32];
+#pragma HLS RESOURCE variable=local_A core=RAM_2P_BRAM
+    // A holds the weights, which are loaded once and stay resident while the
+    // images of the batch stream through B.
+    A_IO_L2_in_inter_trans_boundary(
+        idx,
+        local_A,
+        fifo_A_in,
+        1
+    );
+    for( int b = 0; b < batch; b++ ) {
+        A_IO_L2_in_intra_trans(
+            idx,
+            local_A,
+            fifo_A_local_out,
+            1
+        );
     }
 }
 
-void B_IO_L3_in( tapa::mmap<B_t16> B, tapa::ostream<B_t8>& fifo_B_local_out ) {
+void B_IO_L3_in( tapa::mmap<B_t16> B, int batch, tapa::ostream<B_t8>& fifo_B_local_out ) {
 #pragma HLS INLINE OFF
-    for( ap_uint<15> i = 0; i < 16384; i++ ) {
+    for( int i = 0; i < batch * 16384; i++ ) {
 #pragma HLS PIPELINE II=1
         B_t16 mem_data;
         B_t8 fifo_data;
@@ -280,7 +197,7 @@ void B_IO_L2_in_inter_trans_boundary( int idx, B_t8 local_B[64][32], tapa::istre
     }
 }
 
-void B_IO_L2_in( int idx, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& fifo_B_out, tapa::ostream<B_t8>& fifo_B_local_out ) {
+void B_IO_L2_in( int idx, int batch, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& fifo_B_out, tapa::ostream<B_t8>& fifo_B_local_out ) {
 #pragma HLS INLINE OFF
     int p0 = idx;
     B_t8 local_B_ping[64][32];
@@ -293,7 +210,9 @@ void B_IO_L2_in( int idx, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& f
     bool inter_trans_en = 1;
     bool intra_trans_en = 0;
     {
-        {
+        // The next image is loaded into one buffer while the PEs read the
+        // current one from the other.
+        for( int b = 0; b < batch; b++ ) {
             if( arb == 0 ) {
                 B_IO_L2_in_inter_trans(
                     idx,
@@ -346,7 +265,7 @@ void B_IO_L2_in( int idx, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& f
     }
 }
 
-void B_IO_L2_in_boundary( int idx, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& fifo_B_local_out ) {
+void B_IO_L2_in_boundary( int idx, int batch, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& fifo_B_local_out ) {
 #pragma HLS INLINE OFF
     int p0 = idx;
     B_t8 local_B_ping[64][32];
@@ -359,7 +278,9 @@ void B_IO_L2_in_boundary( int idx, tapa::istream<B_t8>& fifo_B_in, tapa::ostream
     bool inter_trans_en = 1;
     bool intra_trans_en = 0;
     {
-        {
+        // The next image is loaded into one buffer while the PEs read the
+        // current one from the other.
+        for( int b = 0; b < batch; b++ ) {
             if( arb == 0 ) {
                 B_IO_L2_in_inter_trans_boundary(
                     idx,
@@ -410,14 +331,14 @@ void B_IO_L2_in_boundary( int idx, tapa::istream<B_t8>& fifo_B_in, tapa::ostream
     }
 }
 
-void PE( int idx, int idy, tapa::istream<A_t8>& fifo_A_in, tapa::ostream<A_t8>& fifo_A_out, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& fifo_B_out, tapa::ostream<float>& fifo_C_drain_out ) {
+void PE( int idx, int idy, int batch, tapa::istream<A_t8>& fifo_A_in, tapa::ostream<A_t8>& fifo_A_out, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& fifo_B_out, tapa::ostream<float>& fifo_C_drain_out ) {
 #pragma HLS INLINE OFF
     int p0 = idx, p1 = idy;
     float local_A[1][8];
     float local_B[1][8];
     float local_C[16][64];
 #pragma HLS RESOURCE variable=local_C core=RAM_2P_BRAM
-    {
+    for( int b = 0; b < batch; b++ ) {
         for( ap_uint<7> c6 = 0; c6 <= 63; c6 += 1 ) {
             for( ap_uint<5> c7 = 0; c7 <= 15; c7 += 1 ) {
 #pragma HLS PIPELINE II=1
@@ -520,10 +441,11 @@ void PE( int idx, int idy, tapa::istream<A_t8>& fifo_A_in, tapa::ostream<A_t8>&
     }
 }
 
-void PE_wrapper( int idx, int idy, tapa::istream<A_t8>& fifo_A_in, tapa::ostream<A_t8>& fifo_A_out, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& fifo_B_out, tapa::ostream<float>& fifo_C_drain_out )
+void PE_wrapper( int idx, int idy, int batch, tapa::istream<A_t8>& fifo_A_in, tapa::ostream<A_t8>& fifo_A_out, tapa::istream<B_t8>& fifo_B_in, tapa::ostream<B_t8>& fifo_B_out, tapa::ostream<float>& fifo_C_drain_out )
 {
     PE( idx,
         idy,
+        batch,
         fifo_A_in,
         fifo_A_out,
         fifo_B_in,
@@ -531,9 +453,9 @@ void PE_wrapper( int idx, int idy, tapa::istream<A_t8>& fifo_A_in, tapa::ostream
         fifo_C_drain_out );
 }
 
-void A_PE_dummy( int idx, int idy, tapa::istream<A_t8>& fifo_A_in ) {
+void A_PE_dummy( int idx, int idy, int batch, tapa::istream<A_t8>& fifo_A_in ) {
     int p0 = idx, p1 = idy;
-    {
+    for( int b = 0; b < batch; b++ ) {
         {
         }
         for( ap_uint<6> c5 = 0; c5 <= 31; c5 += 1 ) {
@@ -548,9 +470,9 @@ void A_PE_dummy( int idx, int idy, tapa::istream<A_t8>& fifo_A_in ) {
     }
 }
 
-void B_PE_dummy( int idx, int idy, tapa::istream<B_t8>& fifo_B_in ) {
+void B_PE_dummy( int idx, int idy, int batch, tapa::istream<B_t8>& fifo_B_in ) {
     int p0 = idx, p1 = idy;
-    {
+    for( int b = 0; b < batch; b++ ) {
         {
         }
         for( ap_uint<6> c5 = 0; c5 <= 31; c5 += 1 ) {
@@ -634,87 +556,95 @@ void C_drain_IO_L1_out_inter_trans_boundary( int idx, int idy, C_t2 local_C[16][
     }
 }
 
-void C_drain_IO_L1_out( int idx, int idy, tapa::istream<C_t2>& fifo_C_drain_in, tapa::ostream<C_t2>& fifo_C_drain_out, tapa::istream<float>& fifo_C_drain_local_in ) {
+void C_drain_IO_L1_out( int idx, int idy, int batch, tapa::istream<C_t2>& fifo_C_drain_in, tapa::ostream<C_t2>& fifo_C_drain_out, tapa::istream<float>& fifo_C_drain_local_in ) {
 #pragma HLS INLINE OFF
     int p0 = idx, p1 = idy;
     C_t2 local_C[16][32];
 #pragma HLS RESOURCE variable=local_C core=RAM_2P_BRAM
-    C_drain_IO_L1_out_intra_trans(
-        idx,
-        idy,
-        local_C,
-        fifo_C_drain_local_in
-    );
-    C_drain_IO_L1_out_inter_trans(
-        idx,
-        idy,
-        local_C,
-        fifo_C_drain_in,
-        fifo_C_drain_out
-    );
+    for( int b = 0; b < batch; b++ ) {
+        C_drain_IO_L1_out_intra_trans(
+            idx,
+            idy,
+            local_C,
+            fifo_C_drain_local_in
+        );
+        C_drain_IO_L1_out_inter_trans(
+            idx,
+            idy,
+            local_C,
+            fifo_C_drain_in,
+            fifo_C_drain_out
+        );
+    }
 }
 
-void C_drain_IO_L1_out_boundary( int idx, int idy, tapa::ostream<C_t2>& fifo_C_drain_out, tapa::istream<float>& fifo_C_drain_local_in ) {
+void C_drain_IO_L1_out_boundary( int idx, int idy, int batch, tapa::ostream<C_t2>& fifo_C_drain_out, tapa::istream<float>& fifo_C_drain_local_in ) {
 #pragma HLS INLINE OFF
     int p0 = idx, p1 = idy;
     C_t2 local_C[16][32];
 #pragma HLS RESOURCE variable=local_C core=RAM_2P_BRAM
-    C_drain_IO_L1_out_intra_trans(
-        idx,
-        idy,
-        local_C,
-        fifo_C_drain_local_in
-    );
-    C_drain_IO_L1_out_inter_trans_boundary(
-        idx,
-        idy,
-        local_C,
-        fifo_C_drain_out
-    );
+    for( int b = 0; b < batch; b++ ) {
+        C_drain_IO_L1_out_intra_trans(
+            idx,
+            idy,
+            local_C,
+            fifo_C_drain_local_in
+        );
+        C_drain_IO_L1_out_inter_trans_boundary(
+            idx,
+            idy,
+            local_C,
+            fifo_C_drain_out
+        );
+    }
 }
 
-void C_drain_IO_L2_out( int idx, tapa::istream<C_t2>& fifo_C_drain_in, tapa::ostream<C_t2>& fifo_C_drain_out, tapa::istream<C_t2>& fifo_C_drain_local_in ) {
+void C_drain_IO_L2_out( int idx, int batch, tapa::istream<C_t2>& fifo_C_drain_in, tapa::ostream<C_t2>& fifo_C_drain_out, tapa::istream<C_t2>& fifo_C_drain_local_in ) {
 #pragma HLS INLINE OFF
     int p0 = idx;
-    for( ap_uint<5> c3 = p0; c3 <= 15; c3 += 1 ) {
-        for( ap_uint<5> c4 = 0; c4 <= 12; c4 += 1 ) {
-            for( ap_uint<5> c5 = 0; c5 <= 15; c5 += 1 ) {
-                for( ap_uint<6> c6 = 0; c6 <= 31; c6 += 1 ) {
+    for( int b = 0; b < batch; b++ ) {
+        for( ap_uint<5> c3 = p0; c3 <= 15; c3 += 1 ) {
+            for( ap_uint<5> c4 = 0; c4 <= 12; c4 += 1 ) {
+                for( ap_uint<5> c5 = 0; c5 <= 15; c5 += 1 ) {
+                    for( ap_uint<6> c6 = 0; c6 <= 31; c6 += 1 ) {
 #pragma HLS PIPELINE II=1
-                    C_t2 fifo_data;
-                    if( c3 == p0 ) {
-                        fifo_data = fifo_C_drain_local_in.read();
-                    }
-                    else {
-                        fifo_data = fifo_C_drain_in.read();
+                        C_t2 fifo_data;
+                        if( c3 == p0 ) {
+                            fifo_data = fifo_C_drain_local_in.read();
+                        }
+                        else {
+                            fifo_data = fifo_C_drain_in.read();
+                        }
+                        fifo_C_drain_out.write( fifo_data );
                     }
-                    fifo_C_drain_out.write( fifo_data );
                 }
             }
         }
     }
 }
 
-void C_drain_IO_L2_out_boundary( int idx, tapa::ostream<C_t2>& fifo_C_drain_out, tapa::istream<C_t2>& fifo_C_drain_local_in ) {
+void C_drain_IO_L2_out_boundary( int idx, int batch, tapa::ostream<C_t2>& fifo_C_drain_out, tapa::istream<C_t2>& fifo_C_drain_local_in ) {
 #pragma HLS INLINE OFF
     int p0 = idx;
-    for( ap_uint<5> c3 = p0; c3 <= 15; c3 += 1 ) {
-        for( ap_uint<5> c4 = 0; c4 <= 12; c4 += 1 ) {
-            for( ap_uint<5> c5 = 0; c5 <= 15; c5 += 1 ) {
-                for( ap_uint<6> c6 = 0; c6 <= 31; c6 += 1 ) {
+    for( int b = 0; b < batch; b++ ) {
+        for( ap_uint<5> c3 = p0; c3 <= 15; c3 += 1 ) {
+            for( ap_uint<5> c4 = 0; c4 <= 12; c4 += 1 ) {
+                for( ap_uint<5> c5 = 0; c5 <= 15; c5 += 1 ) {
+                    for( ap_uint<6> c6 = 0; c6 <= 31; c6 += 1 ) {
 #pragma HLS PIPELINE II=1
-                    C_t2 fifo_data;
-                    fifo_data = fifo_C_drain_local_in.read();
-                    fifo_C_drain_out.write( fifo_data );
+                        C_t2 fifo_data;
+                        fifo_data = fifo_C_drain_local_in.read();
+                        fifo_C_drain_out.write( fifo_data );
+                    }
                 }
             }
         }
     }
 }
 
-void C_drain_IO_L3_out( tapa::mmap<C_t16> C, tapa::istream<C_t2>& fifo_C_drain_local_in ) {
+void C_drain_IO_L3_out( tapa::mmap<C_t16> C, int batch, tapa::istream<C_t2>& fifo_C_drain_local_in ) {
 #pragma HLS INLINE OFF
-    for( ap_uint<15> i = 0; i < 13312; i++ ) {
+    for( int i = 0; i < batch * 13312; i++ ) {
 #pragma HLS PIPELINE II=1
         C_t16 mem_data;
         C_t2 fifo_data;
@@ -733,7 +663,8 @@ extern "C" {
     void kernel3(
         tapa::mmap<A_t16 > A,
         tapa::mmap<B_t16 > B,
-        tapa::mmap<C_t16 > C
+        tapa::mmap<C_t16 > C,
+        int batch
     ) {
         tapa::stream<A_t8, 2> fifo_A_A_IO_L2_in_0;
         tapa::stream<A_t8, 2> fifo_A_A_IO_L2_in_1;
@@ -1666,153 +1597,184 @@ extern "C" {
                  fifo_A_A_IO_L2_in_0 )
         .invoke( A_IO_L2_in,
                  0,
+                 batch,
                  fifo_A_A_IO_L2_in_0,
                  fifo_A_A_IO_L2_in_1,
                  fifo_A_PE_0_0 )
         .invoke( A_IO_L2_in,
                  1,
+                 batch,
                  fifo_A_A_IO_L2_in_1,
                  fifo_A_A_IO_L2_in_2,
                  fifo_A_PE_1_0 )
         .invoke( A_IO_L2_in,
                  2,
+                 batch,
                  fifo_A_A_IO_L2_in_2,
                  fifo_A_A_IO_L2_in_3,
                  fifo_A_PE_2_0 )
         .invoke( A_IO_L2_in,
                  3,
+                 batch,
                  fifo_A_A_IO_L2_in_3,
                  fifo_A_A_IO_L2_in_4,
                  fifo_A_PE_3_0 )
         .invoke( A_IO_L2_in,
                  4,
+                 batch,
                  fifo_A_A_IO_L2_in_4,
                  fifo_A_A_IO_L2_in_5,
                  fifo_A_PE_4_0 )
         .invoke( A_IO_L2_in,
                  5,
+                 batch,
                  fifo_A_A_IO_L2_in_5,
                  fifo_A_A_IO_L2_in_6,
                  fifo_A_PE_5_0 )
         .invoke( A_IO_L2_in,
                  6,
+                 batch,
                  fifo_A_A_IO_L2_in_6,
                  fifo_A_A_IO_L2_in_7,
                  fifo_A_PE_6_0 )
         .invoke( A_IO_L2_in,
                  7,
+                 batch,
                  fifo_A_A_IO_L2_in_7,
                  fifo_A_A_IO_L2_in_8,
                  fifo_A_PE_7_0 )
         .invoke( A_IO_L2_in,
                  8,
+                 batch,
                  fifo_A_A_IO_L2_in_8,
                  fifo_A_A_IO_L2_in_9,
                  fifo_A_PE_8_0 )
         .invoke( A_IO_L2_in,
                  9,
+                 batch,
                  fifo_A_A_IO_L2_in_9,
                  fifo_A_A_IO_L2_in_10,
                  fifo_A_PE_9_0 )
         .invoke( A_IO_L2_in,
                  10,
+                 batch,
                  fifo_A_A_IO_L2_in_10,
                  fifo_A_A_IO_L2_in_11,
                  fifo_A_PE_10_0 )
         .invoke( A_IO_L2_in,
                  11,
+                 batch,
                  fifo_A_A_IO_L2_in_11,
                  fifo_A_A_IO_L2_in_12,
                  fifo_A_PE_11_0 )
         .invoke( A_IO_L2_in_boundary,
                  12,
+                 batch,
                  fifo_A_A_IO_L2_in_12,
                  fifo_A_PE_12_0 )
         .invoke( B_IO_L3_in,
                  B,
+                 batch,
                  fifo_B_B_IO_L2_in_0 )
         .invoke( B_IO_L2_in,
                  0,
+                 batch,
                  fifo_B_B_IO_L2_in_0,
                  fifo_B_B_IO_L2_in_1,
                  fifo_B_PE_0_0 )
         .invoke( B_IO_L2_in,
                  1,
+                 batch,
                  fifo_B_B_IO_L2_in_1,
                  fifo_B_B_IO_L2_in_2,
                  fifo_B_PE_0_1 )
         .invoke( B_IO_L2_in,
                  2,
+                 batch,
                  fifo_B_B_IO_L2_in_2,
                  fifo_B_B_IO_L2_in_3,
                  fifo_B_PE_0_2 )
         .invoke( B_IO_L2_in,
                  3,
+                 batch,
                  fifo_B_B_IO_L2_in_3,
                  fifo_B_B_IO_L2_in_4,
                  fifo_B_PE_0_3 )
         .invoke( B_IO_L2_in,
                  4,
+                 batch,
                  fifo_B_B_IO_L2_in_4,
                  fifo_B_B_IO_L2_in_5,
                  fifo_B_PE_0_4 )
         .invoke( B_IO_L2_in,
                  5,
+                 batch,
                  fifo_B_B_IO_L2_in_5,
                  fifo_B_B_IO_L2_in_6,
                  fifo_B_PE_0_5 )
         .invoke( B_IO_L2_in,
                  6,
+                 batch,
                  fifo_B_B_IO_L2_in_6,
                  fifo_B_B_IO_L2_in_7,
                  fifo_B_PE_0_6 )
         .invoke( B_IO_L2_in,
                  7,
+                 batch,
                  fifo_B_B_IO_L2_in_7,
                  fifo_B_B_IO_L2_in_8,
                  fifo_B_PE_0_7 )
         .invoke( B_IO_L2_in,
                  8,
+                 batch,
                  fifo_B_B_IO_L2_in_8,
                  fifo_B_B_IO_L2_in_9,
                  fifo_B_PE_0_8 )
         .invoke( B_IO_L2_in,
                  9,
+                 batch,
                  fifo_B_B_IO_L2_in_9,
                  fifo_B_B_IO_L2_in_10,
                  fifo_B_PE_0_9 )
         .invoke( B_IO_L2_in,
                  10,
+                 batch,
                  fifo_B_B_IO_L2_in_10,
                  fifo_B_B_IO_L2_in_11,
                  fifo_B_PE_0_10 )
         .invoke( B_IO_L2_in,
                  11,
+                 batch,
                  fifo_B_B_IO_L2_in_11,
                  fifo_B_B_IO_L2_in_12,
                  fifo_B_PE_0_11 )
         .invoke( B_IO_L2_in,
                  12,
+                 batch,
                  fifo_B_B_IO_L2_in_12,
                  fifo_B_B_IO_L2_in_13,
                  fifo_B_PE_0_12 )
         .invoke( B_IO_L2_in,
                  13,
+                 batch,
                  fifo_B_B_IO_L2_in_13,
                  fifo_B_B_IO_L2_in_14,
                  fifo_B_PE_0_13 )
         .invoke( B_IO_L2_in,
                  14,
+                 batch,
                  fifo_B_B_IO_L2_in_14,
                  fifo_B_B_IO_L2_in_15,
                  fifo_B_PE_0_14 )
         .invoke( B_IO_L2_in_boundary,
                  15,
+                 batch,
                  fifo_B_B_IO_L2_in_15,
                  fifo_B_PE_0_15 )
         .invoke( PE_wrapper,
                  0,
                  0,
+                 batch,
                  fifo_A_PE_0_0,
                  fifo_A_PE_0_1,
                  fifo_B_PE_0_0,
@@ -1821,6 +1783,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  1,
+                 batch,
                  fifo_A_PE_0_1,
                  fifo_A_PE_0_2,
                  fifo_B_PE_0_1,
@@ -1829,6 +1792,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  2,
+                 batch,
                  fifo_A_PE_0_2,
                  fifo_A_PE_0_3,
                  fifo_B_PE_0_2,
@@ -1837,6 +1801,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  3,
+                 batch,
                  fifo_A_PE_0_3,
                  fifo_A_PE_0_4,
                  fifo_B_PE_0_3,
@@ -1845,6 +1810,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  4,
+                 batch,
                  fifo_A_PE_0_4,
                  fifo_A_PE_0_5,
                  fifo_B_PE_0_4,
@@ -1853,6 +1819,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  5,
+                 batch,
                  fifo_A_PE_0_5,
                  fifo_A_PE_0_6,
                  fifo_B_PE_0_5,
@@ -1861,6 +1828,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  6,
+                 batch,
                  fifo_A_PE_0_6,
                  fifo_A_PE_0_7,
                  fifo_B_PE_0_6,
@@ -1869,6 +1837,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  7,
+                 batch,
                  fifo_A_PE_0_7,
                  fifo_A_PE_0_8,
                  fifo_B_PE_0_7,
@@ -1877,6 +1846,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  8,
+                 batch,
                  fifo_A_PE_0_8,
                  fifo_A_PE_0_9,
                  fifo_B_PE_0_8,
@@ -1885,6 +1855,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  9,
+                 batch,
                  fifo_A_PE_0_9,
                  fifo_A_PE_0_10,
                  fifo_B_PE_0_9,
@@ -1893,6 +1864,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  10,
+                 batch,
                  fifo_A_PE_0_10,
                  fifo_A_PE_0_11,
                  fifo_B_PE_0_10,
@@ -1901,6 +1873,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  11,
+                 batch,
                  fifo_A_PE_0_11,
                  fifo_A_PE_0_12,
                  fifo_B_PE_0_11,
@@ -1909,6 +1882,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  12,
+                 batch,
                  fifo_A_PE_0_12,
                  fifo_A_PE_0_13,
                  fifo_B_PE_0_12,
@@ -1917,6 +1891,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  13,
+                 batch,
                  fifo_A_PE_0_13,
                  fifo_A_PE_0_14,
                  fifo_B_PE_0_13,
@@ -1925,6 +1900,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  14,
+                 batch,
                  fifo_A_PE_0_14,
                  fifo_A_PE_0_15,
                  fifo_B_PE_0_14,
@@ -1933,6 +1909,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  0,
                  15,
+                 batch,
                  fifo_A_PE_0_15,
                  fifo_A_PE_0_16,
                  fifo_B_PE_0_15,
@@ -1941,6 +1918,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  0,
+                 batch,
                  fifo_A_PE_1_0,
                  fifo_A_PE_1_1,
                  fifo_B_PE_1_0,
@@ -1949,6 +1927,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  1,
+                 batch,
                  fifo_A_PE_1_1,
                  fifo_A_PE_1_2,
                  fifo_B_PE_1_1,
@@ -1957,6 +1936,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  2,
+                 batch,
                  fifo_A_PE_1_2,
                  fifo_A_PE_1_3,
                  fifo_B_PE_1_2,
@@ -1965,6 +1945,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  3,
+                 batch,
                  fifo_A_PE_1_3,
                  fifo_A_PE_1_4,
                  fifo_B_PE_1_3,
@@ -1973,6 +1954,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  4,
+                 batch,
                  fifo_A_PE_1_4,
                  fifo_A_PE_1_5,
                  fifo_B_PE_1_4,
@@ -1981,6 +1963,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  5,
+                 batch,
                  fifo_A_PE_1_5,
                  fifo_A_PE_1_6,
                  fifo_B_PE_1_5,
@@ -1989,6 +1972,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  6,
+                 batch,
                  fifo_A_PE_1_6,
                  fifo_A_PE_1_7,
                  fifo_B_PE_1_6,
@@ -1997,6 +1981,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  7,
+                 batch,
                  fifo_A_PE_1_7,
                  fifo_A_PE_1_8,
                  fifo_B_PE_1_7,
@@ -2005,6 +1990,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  8,
+                 batch,
                  fifo_A_PE_1_8,
                  fifo_A_PE_1_9,
                  fifo_B_PE_1_8,
@@ -2013,6 +1999,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  9,
+                 batch,
                  fifo_A_PE_1_9,
                  fifo_A_PE_1_10,
                  fifo_B_PE_1_9,
@@ -2021,6 +2008,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  10,
+                 batch,
                  fifo_A_PE_1_10,
                  fifo_A_PE_1_11,
                  fifo_B_PE_1_10,
@@ -2029,6 +2017,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  11,
+                 batch,
                  fifo_A_PE_1_11,
                  fifo_A_PE_1_12,
                  fifo_B_PE_1_11,
@@ -2037,6 +2026,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  12,
+                 batch,
                  fifo_A_PE_1_12,
                  fifo_A_PE_1_13,
                  fifo_B_PE_1_12,
@@ -2045,6 +2035,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  13,
+                 batch,
                  fifo_A_PE_1_13,
                  fifo_A_PE_1_14,
                  fifo_B_PE_1_13,
@@ -2053,6 +2044,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  14,
+                 batch,
                  fifo_A_PE_1_14,
                  fifo_A_PE_1_15,
                  fifo_B_PE_1_14,
@@ -2061,6 +2053,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  1,
                  15,
+                 batch,
                  fifo_A_PE_1_15,
                  fifo_A_PE_1_16,
                  fifo_B_PE_1_15,
@@ -2069,6 +2062,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  0,
+                 batch,
                  fifo_A_PE_2_0,
                  fifo_A_PE_2_1,
                  fifo_B_PE_2_0,
@@ -2077,6 +2071,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  1,
+                 batch,
                  fifo_A_PE_2_1,
                  fifo_A_PE_2_2,
                  fifo_B_PE_2_1,
@@ -2085,6 +2080,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  2,
+                 batch,
                  fifo_A_PE_2_2,
                  fifo_A_PE_2_3,
                  fifo_B_PE_2_2,
@@ -2093,6 +2089,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  3,
+                 batch,
                  fifo_A_PE_2_3,
                  fifo_A_PE_2_4,
                  fifo_B_PE_2_3,
@@ -2101,6 +2098,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  4,
+                 batch,
                  fifo_A_PE_2_4,
                  fifo_A_PE_2_5,
                  fifo_B_PE_2_4,
@@ -2109,6 +2107,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  5,
+                 batch,
                  fifo_A_PE_2_5,
                  fifo_A_PE_2_6,
                  fifo_B_PE_2_5,
@@ -2117,6 +2116,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  6,
+                 batch,
                  fifo_A_PE_2_6,
                  fifo_A_PE_2_7,
                  fifo_B_PE_2_6,
@@ -2125,6 +2125,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  7,
+                 batch,
                  fifo_A_PE_2_7,
                  fifo_A_PE_2_8,
                  fifo_B_PE_2_7,
@@ -2133,6 +2134,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  8,
+                 batch,
                  fifo_A_PE_2_8,
                  fifo_A_PE_2_9,
                  fifo_B_PE_2_8,
@@ -2141,6 +2143,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  9,
+                 batch,
                  fifo_A_PE_2_9,
                  fifo_A_PE_2_10,
                  fifo_B_PE_2_9,
@@ -2149,6 +2152,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  10,
+                 batch,
                  fifo_A_PE_2_10,
                  fifo_A_PE_2_11,
                  fifo_B_PE_2_10,
@@ -2157,6 +2161,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  11,
+                 batch,
                  fifo_A_PE_2_11,
                  fifo_A_PE_2_12,
                  fifo_B_PE_2_11,
@@ -2165,6 +2170,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  12,
+                 batch,
                  fifo_A_PE_2_12,
                  fifo_A_PE_2_13,
                  fifo_B_PE_2_12,
@@ -2173,6 +2179,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  13,
+                 batch,
                  fifo_A_PE_2_13,
                  fifo_A_PE_2_14,
                  fifo_B_PE_2_13,
@@ -2181,6 +2188,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  14,
+                 batch,
                  fifo_A_PE_2_14,
                  fifo_A_PE_2_15,
                  fifo_B_PE_2_14,
@@ -2189,6 +2197,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  2,
                  15,
+                 batch,
                  fifo_A_PE_2_15,
                  fifo_A_PE_2_16,
                  fifo_B_PE_2_15,
@@ -2197,6 +2206,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  0,
+                 batch,
                  fifo_A_PE_3_0,
                  fifo_A_PE_3_1,
                  fifo_B_PE_3_0,
@@ -2205,6 +2215,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  1,
+                 batch,
                  fifo_A_PE_3_1,
                  fifo_A_PE_3_2,
                  fifo_B_PE_3_1,
@@ -2213,6 +2224,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  2,
+                 batch,
                  fifo_A_PE_3_2,
                  fifo_A_PE_3_3,
                  fifo_B_PE_3_2,
@@ -2221,6 +2233,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  3,
+                 batch,
                  fifo_A_PE_3_3,
                  fifo_A_PE_3_4,
                  fifo_B_PE_3_3,
@@ -2229,6 +2242,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  4,
+                 batch,
                  fifo_A_PE_3_4,
                  fifo_A_PE_3_5,
                  fifo_B_PE_3_4,
@@ -2237,6 +2251,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  5,
+                 batch,
                  fifo_A_PE_3_5,
                  fifo_A_PE_3_6,
                  fifo_B_PE_3_5,
@@ -2245,6 +2260,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  6,
+                 batch,
                  fifo_A_PE_3_6,
                  fifo_A_PE_3_7,
                  fifo_B_PE_3_6,
@@ -2253,6 +2269,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  7,
+                 batch,
                  fifo_A_PE_3_7,
                  fifo_A_PE_3_8,
                  fifo_B_PE_3_7,
@@ -2261,6 +2278,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  8,
+                 batch,
                  fifo_A_PE_3_8,
                  fifo_A_PE_3_9,
                  fifo_B_PE_3_8,
@@ -2269,6 +2287,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  9,
+                 batch,
                  fifo_A_PE_3_9,
                  fifo_A_PE_3_10,
                  fifo_B_PE_3_9,
@@ -2277,6 +2296,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  10,
+                 batch,
                  fifo_A_PE_3_10,
                  fifo_A_PE_3_11,
                  fifo_B_PE_3_10,
@@ -2285,6 +2305,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  11,
+                 batch,
                  fifo_A_PE_3_11,
                  fifo_A_PE_3_12,
                  fifo_B_PE_3_11,
@@ -2293,6 +2314,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  12,
+                 batch,
                  fifo_A_PE_3_12,
                  fifo_A_PE_3_13,
                  fifo_B_PE_3_12,
@@ -2301,6 +2323,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  13,
+                 batch,
                  fifo_A_PE_3_13,
                  fifo_A_PE_3_14,
                  fifo_B_PE_3_13,
@@ -2309,6 +2332,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  14,
+                 batch,
                  fifo_A_PE_3_14,
                  fifo_A_PE_3_15,
                  fifo_B_PE_3_14,
@@ -2317,6 +2341,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  3,
                  15,
+                 batch,
                  fifo_A_PE_3_15,
                  fifo_A_PE_3_16,
                  fifo_B_PE_3_15,
@@ -2325,6 +2350,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  0,
+                 batch,
                  fifo_A_PE_4_0,
                  fifo_A_PE_4_1,
                  fifo_B_PE_4_0,
@@ -2333,6 +2359,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  1,
+                 batch,
                  fifo_A_PE_4_1,
                  fifo_A_PE_4_2,
                  fifo_B_PE_4_1,
@@ -2341,6 +2368,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  2,
+                 batch,
                  fifo_A_PE_4_2,
                  fifo_A_PE_4_3,
                  fifo_B_PE_4_2,
@@ -2349,6 +2377,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  3,
+                 batch,
                  fifo_A_PE_4_3,
                  fifo_A_PE_4_4,
                  fifo_B_PE_4_3,
@@ -2357,6 +2386,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  4,
+                 batch,
                  fifo_A_PE_4_4,
                  fifo_A_PE_4_5,
                  fifo_B_PE_4_4,
@@ -2365,6 +2395,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  5,
+                 batch,
                  fifo_A_PE_4_5,
                  fifo_A_PE_4_6,
                  fifo_B_PE_4_5,
@@ -2373,6 +2404,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  6,
+                 batch,
                  fifo_A_PE_4_6,
                  fifo_A_PE_4_7,
                  fifo_B_PE_4_6,
@@ -2381,6 +2413,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  7,
+                 batch,
                  fifo_A_PE_4_7,
                  fifo_A_PE_4_8,
                  fifo_B_PE_4_7,
@@ -2389,6 +2422,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  8,
+                 batch,
                  fifo_A_PE_4_8,
                  fifo_A_PE_4_9,
                  fifo_B_PE_4_8,
@@ -2397,6 +2431,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  9,
+                 batch,
                  fifo_A_PE_4_9,
                  fifo_A_PE_4_10,
                  fifo_B_PE_4_9,
@@ -2405,6 +2440,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  10,
+                 batch,
                  fifo_A_PE_4_10,
                  fifo_A_PE_4_11,
                  fifo_B_PE_4_10,
@@ -2413,6 +2449,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  11,
+                 batch,
                  fifo_A_PE_4_11,
                  fifo_A_PE_4_12,
                  fifo_B_PE_4_11,
@@ -2421,6 +2458,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  12,
+                 batch,
                  fifo_A_PE_4_12,
                  fifo_A_PE_4_13,
                  fifo_B_PE_4_12,
@@ -2429,6 +2467,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  13,
+                 batch,
                  fifo_A_PE_4_13,
                  fifo_A_PE_4_14,
                  fifo_B_PE_4_13,
@@ -2437,6 +2476,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  14,
+                 batch,
                  fifo_A_PE_4_14,
                  fifo_A_PE_4_15,
                  fifo_B_PE_4_14,
@@ -2445,6 +2485,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  4,
                  15,
+                 batch,
                  fifo_A_PE_4_15,
                  fifo_A_PE_4_16,
                  fifo_B_PE_4_15,
@@ -2453,6 +2494,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  0,
+                 batch,
                  fifo_A_PE_5_0,
                  fifo_A_PE_5_1,
                  fifo_B_PE_5_0,
@@ -2461,6 +2503,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  1,
+                 batch,
                  fifo_A_PE_5_1,
                  fifo_A_PE_5_2,
                  fifo_B_PE_5_1,
@@ -2469,6 +2512,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  2,
+                 batch,
                  fifo_A_PE_5_2,
                  fifo_A_PE_5_3,
                  fifo_B_PE_5_2,
@@ -2477,6 +2521,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  3,
+                 batch,
                  fifo_A_PE_5_3,
                  fifo_A_PE_5_4,
                  fifo_B_PE_5_3,
@@ -2485,6 +2530,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  4,
+                 batch,
                  fifo_A_PE_5_4,
                  fifo_A_PE_5_5,
                  fifo_B_PE_5_4,
@@ -2493,6 +2539,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  5,
+                 batch,
                  fifo_A_PE_5_5,
                  fifo_A_PE_5_6,
                  fifo_B_PE_5_5,
@@ -2501,6 +2548,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  6,
+                 batch,
                  fifo_A_PE_5_6,
                  fifo_A_PE_5_7,
                  fifo_B_PE_5_6,
@@ -2509,6 +2557,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  7,
+                 batch,
                  fifo_A_PE_5_7,
                  fifo_A_PE_5_8,
                  fifo_B_PE_5_7,
@@ -2517,6 +2566,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  8,
+                 batch,
                  fifo_A_PE_5_8,
                  fifo_A_PE_5_9,
                  fifo_B_PE_5_8,
@@ -2525,6 +2575,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  9,
+                 batch,
                  fifo_A_PE_5_9,
                  fifo_A_PE_5_10,
                  fifo_B_PE_5_9,
@@ -2533,6 +2584,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  10,
+                 batch,
                  fifo_A_PE_5_10,
                  fifo_A_PE_5_11,
                  fifo_B_PE_5_10,
@@ -2541,6 +2593,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  11,
+                 batch,
                  fifo_A_PE_5_11,
                  fifo_A_PE_5_12,
                  fifo_B_PE_5_11,
@@ -2549,6 +2602,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  12,
+                 batch,
                  fifo_A_PE_5_12,
                  fifo_A_PE_5_13,
                  fifo_B_PE_5_12,
@@ -2557,6 +2611,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  13,
+                 batch,
                  fifo_A_PE_5_13,
                  fifo_A_PE_5_14,
                  fifo_B_PE_5_13,
@@ -2565,6 +2620,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  14,
+                 batch,
                  fifo_A_PE_5_14,
                  fifo_A_PE_5_15,
                  fifo_B_PE_5_14,
@@ -2573,6 +2629,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  5,
                  15,
+                 batch,
                  fifo_A_PE_5_15,
                  fifo_A_PE_5_16,
                  fifo_B_PE_5_15,
@@ -2581,6 +2638,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  0,
+                 batch,
                  fifo_A_PE_6_0,
                  fifo_A_PE_6_1,
                  fifo_B_PE_6_0,
@@ -2589,6 +2647,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  1,
+                 batch,
                  fifo_A_PE_6_1,
                  fifo_A_PE_6_2,
                  fifo_B_PE_6_1,
@@ -2597,6 +2656,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  2,
+                 batch,
                  fifo_A_PE_6_2,
                  fifo_A_PE_6_3,
                  fifo_B_PE_6_2,
@@ -2605,6 +2665,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  3,
+                 batch,
                  fifo_A_PE_6_3,
                  fifo_A_PE_6_4,
                  fifo_B_PE_6_3,
@@ -2613,6 +2674,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  4,
+                 batch,
                  fifo_A_PE_6_4,
                  fifo_A_PE_6_5,
                  fifo_B_PE_6_4,
@@ -2621,6 +2683,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  5,
+                 batch,
                  fifo_A_PE_6_5,
                  fifo_A_PE_6_6,
                  fifo_B_PE_6_5,
@@ -2629,6 +2692,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  6,
+                 batch,
                  fifo_A_PE_6_6,
                  fifo_A_PE_6_7,
                  fifo_B_PE_6_6,
@@ -2637,6 +2701,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  7,
+                 batch,
                  fifo_A_PE_6_7,
                  fifo_A_PE_6_8,
                  fifo_B_PE_6_7,
@@ -2645,6 +2710,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  8,
+                 batch,
                  fifo_A_PE_6_8,
                  fifo_A_PE_6_9,
                  fifo_B_PE_6_8,
@@ -2653,6 +2719,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  9,
+                 batch,
                  fifo_A_PE_6_9,
                  fifo_A_PE_6_10,
                  fifo_B_PE_6_9,
@@ -2661,6 +2728,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  10,
+                 batch,
                  fifo_A_PE_6_10,
                  fifo_A_PE_6_11,
                  fifo_B_PE_6_10,
@@ -2669,6 +2737,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  11,
+                 batch,
                  fifo_A_PE_6_11,
                  fifo_A_PE_6_12,
                  fifo_B_PE_6_11,
@@ -2677,6 +2746,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  12,
+                 batch,
                  fifo_A_PE_6_12,
                  fifo_A_PE_6_13,
                  fifo_B_PE_6_12,
@@ -2685,6 +2755,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  13,
+                 batch,
                  fifo_A_PE_6_13,
                  fifo_A_PE_6_14,
                  fifo_B_PE_6_13,
@@ -2693,6 +2764,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  14,
+                 batch,
                  fifo_A_PE_6_14,
                  fifo_A_PE_6_15,
                  fifo_B_PE_6_14,
@@ -2701,6 +2773,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  6,
                  15,
+                 batch,
                  fifo_A_PE_6_15,
                  fifo_A_PE_6_16,
                  fifo_B_PE_6_15,
@@ -2709,6 +2782,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  0,
+                 batch,
                  fifo_A_PE_7_0,
                  fifo_A_PE_7_1,
                  fifo_B_PE_7_0,
@@ -2717,6 +2791,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  1,
+                 batch,
                  fifo_A_PE_7_1,
                  fifo_A_PE_7_2,
                  fifo_B_PE_7_1,
@@ -2725,6 +2800,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  2,
+                 batch,
                  fifo_A_PE_7_2,
                  fifo_A_PE_7_3,
                  fifo_B_PE_7_2,
@@ -2733,6 +2809,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  3,
+                 batch,
                  fifo_A_PE_7_3,
                  fifo_A_PE_7_4,
                  fifo_B_PE_7_3,
@@ -2741,6 +2818,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  4,
+                 batch,
                  fifo_A_PE_7_4,
                  fifo_A_PE_7_5,
                  fifo_B_PE_7_4,
@@ -2749,6 +2827,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  5,
+                 batch,
                  fifo_A_PE_7_5,
                  fifo_A_PE_7_6,
                  fifo_B_PE_7_5,
@@ -2757,6 +2836,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  6,
+                 batch,
                  fifo_A_PE_7_6,
                  fifo_A_PE_7_7,
                  fifo_B_PE_7_6,
@@ -2765,6 +2845,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  7,
+                 batch,
                  fifo_A_PE_7_7,
                  fifo_A_PE_7_8,
                  fifo_B_PE_7_7,
@@ -2773,6 +2854,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  8,
+                 batch,
                  fifo_A_PE_7_8,
                  fifo_A_PE_7_9,
                  fifo_B_PE_7_8,
@@ -2781,6 +2863,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  9,
+                 batch,
                  fifo_A_PE_7_9,
                  fifo_A_PE_7_10,
                  fifo_B_PE_7_9,
@@ -2789,6 +2872,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  10,
+                 batch,
                  fifo_A_PE_7_10,
                  fifo_A_PE_7_11,
                  fifo_B_PE_7_10,
@@ -2797,6 +2881,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  11,
+                 batch,
                  fifo_A_PE_7_11,
                  fifo_A_PE_7_12,
                  fifo_B_PE_7_11,
@@ -2805,6 +2890,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  12,
+                 batch,
                  fifo_A_PE_7_12,
                  fifo_A_PE_7_13,
                  fifo_B_PE_7_12,
@@ -2813,6 +2899,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  13,
+                 batch,
                  fifo_A_PE_7_13,
                  fifo_A_PE_7_14,
                  fifo_B_PE_7_13,
@@ -2821,6 +2908,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  14,
+                 batch,
                  fifo_A_PE_7_14,
                  fifo_A_PE_7_15,
                  fifo_B_PE_7_14,
@@ -2829,6 +2917,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  7,
                  15,
+                 batch,
                  fifo_A_PE_7_15,
                  fifo_A_PE_7_16,
                  fifo_B_PE_7_15,
@@ -2837,6 +2926,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  0,
+                 batch,
                  fifo_A_PE_8_0,
                  fifo_A_PE_8_1,
                  fifo_B_PE_8_0,
@@ -2845,6 +2935,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  1,
+                 batch,
                  fifo_A_PE_8_1,
                  fifo_A_PE_8_2,
                  fifo_B_PE_8_1,
@@ -2853,6 +2944,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  2,
+                 batch,
                  fifo_A_PE_8_2,
                  fifo_A_PE_8_3,
                  fifo_B_PE_8_2,
@@ -2861,6 +2953,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  3,
+                 batch,
                  fifo_A_PE_8_3,
                  fifo_A_PE_8_4,
                  fifo_B_PE_8_3,
@@ -2869,6 +2962,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  4,
+                 batch,
                  fifo_A_PE_8_4,
                  fifo_A_PE_8_5,
                  fifo_B_PE_8_4,
@@ -2877,6 +2971,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  5,
+                 batch,
                  fifo_A_PE_8_5,
                  fifo_A_PE_8_6,
                  fifo_B_PE_8_5,
@@ -2885,6 +2980,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  6,
+                 batch,
                  fifo_A_PE_8_6,
                  fifo_A_PE_8_7,
                  fifo_B_PE_8_6,
@@ -2893,6 +2989,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  7,
+                 batch,
                  fifo_A_PE_8_7,
                  fifo_A_PE_8_8,
                  fifo_B_PE_8_7,
@@ -2901,6 +2998,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  8,
+                 batch,
                  fifo_A_PE_8_8,
                  fifo_A_PE_8_9,
                  fifo_B_PE_8_8,
@@ -2909,6 +3007,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  9,
+                 batch,
                  fifo_A_PE_8_9,
                  fifo_A_PE_8_10,
                  fifo_B_PE_8_9,
@@ -2917,6 +3016,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  10,
+                 batch,
                  fifo_A_PE_8_10,
                  fifo_A_PE_8_11,
                  fifo_B_PE_8_10,
@@ -2925,6 +3025,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  11,
+                 batch,
                  fifo_A_PE_8_11,
                  fifo_A_PE_8_12,
                  fifo_B_PE_8_11,
@@ -2933,6 +3034,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  12,
+                 batch,
                  fifo_A_PE_8_12,
                  fifo_A_PE_8_13,
                  fifo_B_PE_8_12,
@@ -2941,6 +3043,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  13,
+                 batch,
                  fifo_A_PE_8_13,
                  fifo_A_PE_8_14,
                  fifo_B_PE_8_13,
@@ -2949,6 +3052,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  14,
+                 batch,
                  fifo_A_PE_8_14,
                  fifo_A_PE_8_15,
                  fifo_B_PE_8_14,
@@ -2957,6 +3061,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  8,
                  15,
+                 batch,
                  fifo_A_PE_8_15,
                  fifo_A_PE_8_16,
                  fifo_B_PE_8_15,
@@ -2965,6 +3070,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  0,
+                 batch,
                  fifo_A_PE_9_0,
                  fifo_A_PE_9_1,
                  fifo_B_PE_9_0,
@@ -2973,6 +3079,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  1,
+                 batch,
                  fifo_A_PE_9_1,
                  fifo_A_PE_9_2,
                  fifo_B_PE_9_1,
@@ -2981,6 +3088,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  2,
+                 batch,
                  fifo_A_PE_9_2,
                  fifo_A_PE_9_3,
                  fifo_B_PE_9_2,
@@ -2989,6 +3097,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  3,
+                 batch,
                  fifo_A_PE_9_3,
                  fifo_A_PE_9_4,
                  fifo_B_PE_9_3,
@@ -2997,6 +3106,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  4,
+                 batch,
                  fifo_A_PE_9_4,
                  fifo_A_PE_9_5,
                  fifo_B_PE_9_4,
@@ -3005,6 +3115,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  5,
+                 batch,
                  fifo_A_PE_9_5,
                  fifo_A_PE_9_6,
                  fifo_B_PE_9_5,
@@ -3013,6 +3124,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  6,
+                 batch,
                  fifo_A_PE_9_6,
                  fifo_A_PE_9_7,
                  fifo_B_PE_9_6,
@@ -3021,6 +3133,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  7,
+                 batch,
                  fifo_A_PE_9_7,
                  fifo_A_PE_9_8,
                  fifo_B_PE_9_7,
@@ -3029,6 +3142,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  8,
+                 batch,
                  fifo_A_PE_9_8,
                  fifo_A_PE_9_9,
                  fifo_B_PE_9_8,
@@ -3037,6 +3151,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  9,
+                 batch,
                  fifo_A_PE_9_9,
                  fifo_A_PE_9_10,
                  fifo_B_PE_9_9,
@@ -3045,6 +3160,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  10,
+                 batch,
                  fifo_A_PE_9_10,
                  fifo_A_PE_9_11,
                  fifo_B_PE_9_10,
@@ -3053,6 +3169,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  11,
+                 batch,
                  fifo_A_PE_9_11,
                  fifo_A_PE_9_12,
                  fifo_B_PE_9_11,
@@ -3061,6 +3178,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  12,
+                 batch,
                  fifo_A_PE_9_12,
                  fifo_A_PE_9_13,
                  fifo_B_PE_9_12,
@@ -3069,6 +3187,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  13,
+                 batch,
                  fifo_A_PE_9_13,
                  fifo_A_PE_9_14,
                  fifo_B_PE_9_13,
@@ -3077,6 +3196,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  14,
+                 batch,
                  fifo_A_PE_9_14,
                  fifo_A_PE_9_15,
                  fifo_B_PE_9_14,
@@ -3085,6 +3205,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  9,
                  15,
+                 batch,
                  fifo_A_PE_9_15,
                  fifo_A_PE_9_16,
                  fifo_B_PE_9_15,
@@ -3093,6 +3214,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  0,
+                 batch,
                  fifo_A_PE_10_0,
                  fifo_A_PE_10_1,
                  fifo_B_PE_10_0,
@@ -3101,6 +3223,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  1,
+                 batch,
                  fifo_A_PE_10_1,
                  fifo_A_PE_10_2,
                  fifo_B_PE_10_1,
@@ -3109,6 +3232,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  2,
+                 batch,
                  fifo_A_PE_10_2,
                  fifo_A_PE_10_3,
                  fifo_B_PE_10_2,
@@ -3117,6 +3241,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  3,
+                 batch,
                  fifo_A_PE_10_3,
                  fifo_A_PE_10_4,
                  fifo_B_PE_10_3,
@@ -3125,6 +3250,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  4,
+                 batch,
                  fifo_A_PE_10_4,
                  fifo_A_PE_10_5,
                  fifo_B_PE_10_4,
@@ -3133,6 +3259,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  5,
+                 batch,
                  fifo_A_PE_10_5,
                  fifo_A_PE_10_6,
                  fifo_B_PE_10_5,
@@ -3141,6 +3268,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  6,
+                 batch,
                  fifo_A_PE_10_6,
                  fifo_A_PE_10_7,
                  fifo_B_PE_10_6,
@@ -3149,6 +3277,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  7,
+                 batch,
                  fifo_A_PE_10_7,
                  fifo_A_PE_10_8,
                  fifo_B_PE_10_7,
@@ -3157,6 +3286,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  8,
+                 batch,
                  fifo_A_PE_10_8,
                  fifo_A_PE_10_9,
                  fifo_B_PE_10_8,
@@ -3165,6 +3295,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  9,
+                 batch,
                  fifo_A_PE_10_9,
                  fifo_A_PE_10_10,
                  fifo_B_PE_10_9,
@@ -3173,6 +3304,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  10,
+                 batch,
                  fifo_A_PE_10_10,
                  fifo_A_PE_10_11,
                  fifo_B_PE_10_10,
@@ -3181,6 +3313,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  11,
+                 batch,
                  fifo_A_PE_10_11,
                  fifo_A_PE_10_12,
                  fifo_B_PE_10_11,
@@ -3189,6 +3322,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  12,
+                 batch,
                  fifo_A_PE_10_12,
                  fifo_A_PE_10_13,
                  fifo_B_PE_10_12,
@@ -3197,6 +3331,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  13,
+                 batch,
                  fifo_A_PE_10_13,
                  fifo_A_PE_10_14,
                  fifo_B_PE_10_13,
@@ -3205,6 +3340,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  14,
+                 batch,
                  fifo_A_PE_10_14,
                  fifo_A_PE_10_15,
                  fifo_B_PE_10_14,
@@ -3213,6 +3349,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  10,
                  15,
+                 batch,
                  fifo_A_PE_10_15,
                  fifo_A_PE_10_16,
                  fifo_B_PE_10_15,
@@ -3221,6 +3358,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  0,
+                 batch,
                  fifo_A_PE_11_0,
                  fifo_A_PE_11_1,
                  fifo_B_PE_11_0,
@@ -3229,6 +3367,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  1,
+                 batch,
                  fifo_A_PE_11_1,
                  fifo_A_PE_11_2,
                  fifo_B_PE_11_1,
@@ -3237,6 +3376,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  2,
+                 batch,
                  fifo_A_PE_11_2,
                  fifo_A_PE_11_3,
                  fifo_B_PE_11_2,
@@ -3245,6 +3385,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  3,
+                 batch,
                  fifo_A_PE_11_3,
                  fifo_A_PE_11_4,
                  fifo_B_PE_11_3,
@@ -3253,6 +3394,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  4,
+                 batch,
                  fifo_A_PE_11_4,
                  fifo_A_PE_11_5,
                  fifo_B_PE_11_4,
@@ -3261,6 +3403,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  5,
+                 batch,
                  fifo_A_PE_11_5,
                  fifo_A_PE_11_6,
                  fifo_B_PE_11_5,
@@ -3269,6 +3412,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  6,
+                 batch,
                  fifo_A_PE_11_6,
                  fifo_A_PE_11_7,
                  fifo_B_PE_11_6,
@@ -3277,6 +3421,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  7,
+                 batch,
                  fifo_A_PE_11_7,
                  fifo_A_PE_11_8,
                  fifo_B_PE_11_7,
@@ -3285,6 +3430,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  8,
+                 batch,
                  fifo_A_PE_11_8,
                  fifo_A_PE_11_9,
                  fifo_B_PE_11_8,
@@ -3293,6 +3439,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  9,
+                 batch,
                  fifo_A_PE_11_9,
                  fifo_A_PE_11_10,
                  fifo_B_PE_11_9,
@@ -3301,6 +3448,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  10,
+                 batch,
                  fifo_A_PE_11_10,
                  fifo_A_PE_11_11,
                  fifo_B_PE_11_10,
@@ -3309,6 +3457,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  11,
+                 batch,
                  fifo_A_PE_11_11,
                  fifo_A_PE_11_12,
                  fifo_B_PE_11_11,
@@ -3317,6 +3466,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  12,
+                 batch,
                  fifo_A_PE_11_12,
                  fifo_A_PE_11_13,
                  fifo_B_PE_11_12,
@@ -3325,6 +3475,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  13,
+                 batch,
                  fifo_A_PE_11_13,
                  fifo_A_PE_11_14,
                  fifo_B_PE_11_13,
@@ -3333,6 +3484,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  14,
+                 batch,
                  fifo_A_PE_11_14,
                  fifo_A_PE_11_15,
                  fifo_B_PE_11_14,
@@ -3341,6 +3493,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  11,
                  15,
+                 batch,
                  fifo_A_PE_11_15,
                  fifo_A_PE_11_16,
                  fifo_B_PE_11_15,
@@ -3349,6 +3502,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  0,
+                 batch,
                  fifo_A_PE_12_0,
                  fifo_A_PE_12_1,
                  fifo_B_PE_12_0,
@@ -3357,6 +3511,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  1,
+                 batch,
                  fifo_A_PE_12_1,
                  fifo_A_PE_12_2,
                  fifo_B_PE_12_1,
@@ -3365,6 +3520,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  2,
+                 batch,
                  fifo_A_PE_12_2,
                  fifo_A_PE_12_3,
                  fifo_B_PE_12_2,
@@ -3373,6 +3529,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  3,
+                 batch,
                  fifo_A_PE_12_3,
                  fifo_A_PE_12_4,
                  fifo_B_PE_12_3,
@@ -3381,6 +3538,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  4,
+                 batch,
                  fifo_A_PE_12_4,
                  fifo_A_PE_12_5,
                  fifo_B_PE_12_4,
@@ -3389,6 +3547,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  5,
+                 batch,
                  fifo_A_PE_12_5,
                  fifo_A_PE_12_6,
                  fifo_B_PE_12_5,
@@ -3397,6 +3556,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  6,
+                 batch,
                  fifo_A_PE_12_6,
                  fifo_A_PE_12_7,
                  fifo_B_PE_12_6,
@@ -3405,6 +3565,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  7,
+                 batch,
                  fifo_A_PE_12_7,
                  fifo_A_PE_12_8,
                  fifo_B_PE_12_7,
@@ -3413,6 +3574,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  8,
+                 batch,
                  fifo_A_PE_12_8,
                  fifo_A_PE_12_9,
                  fifo_B_PE_12_8,
@@ -3421,6 +3583,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  9,
+                 batch,
                  fifo_A_PE_12_9,
                  fifo_A_PE_12_10,
                  fifo_B_PE_12_9,
@@ -3429,6 +3592,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  10,
+                 batch,
                  fifo_A_PE_12_10,
                  fifo_A_PE_12_11,
                  fifo_B_PE_12_10,
@@ -3437,6 +3601,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  11,
+                 batch,
                  fifo_A_PE_12_11,
                  fifo_A_PE_12_12,
                  fifo_B_PE_12_11,
@@ -3445,6 +3610,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  12,
+                 batch,
                  fifo_A_PE_12_12,
                  fifo_A_PE_12_13,
                  fifo_B_PE_12_12,
@@ -3453,6 +3619,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  13,
+                 batch,
                  fifo_A_PE_12_13,
                  fifo_A_PE_12_14,
                  fifo_B_PE_12_13,
@@ -3461,6 +3628,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  14,
+                 batch,
                  fifo_A_PE_12_14,
                  fifo_A_PE_12_15,
                  fifo_B_PE_12_14,
@@ -3469,6 +3637,7 @@ extern "C" {
         .invoke( PE_wrapper,
                  12,
                  15,
+                 batch,
                  fifo_A_PE_12_15,
                  fifo_A_PE_12_16,
                  fifo_B_PE_12_15,
@@ -3477,1432 +3646,1686 @@ extern "C" {
         .invoke( A_PE_dummy,
                  0,
                  15,
+                 batch,
                  fifo_A_PE_0_16 )
         .invoke( A_PE_dummy,
                  1,
                  15,
+                 batch,
                  fifo_A_PE_1_16 )
         .invoke( A_PE_dummy,
                  2,
                  15,
+                 batch,
                  fifo_A_PE_2_16 )
         .invoke( A_PE_dummy,
                  3,
                  15,
+                 batch,
                  fifo_A_PE_3_16 )
         .invoke( A_PE_dummy,
                  4,
                  15,
+                 batch,
                  fifo_A_PE_4_16 )
         .invoke( A_PE_dummy,
                  5,
                  15,
+                 batch,
                  fifo_A_PE_5_16 )
         .invoke( A_PE_dummy,
                  6,
                  15,
+                 batch,
                  fifo_A_PE_6_16 )
         .invoke( A_PE_dummy,
                  7,
                  15,
+                 batch,
                  fifo_A_PE_7_16 )
         .invoke( A_PE_dummy,
                  8,
                  15,
+                 batch,
                  fifo_A_PE_8_16 )
         .invoke( A_PE_dummy,
                  9,
                  15,
+                 batch,
                  fifo_A_PE_9_16 )
         .invoke( A_PE_dummy,
                  10,
                  15,
+                 batch,
                  fifo_A_PE_10_16 )
         .invoke( A_PE_dummy,
                  11,
                  15,
+                 batch,
                  fifo_A_PE_11_16 )
         .invoke( A_PE_dummy,
                  12,
                  15,
+                 batch,
                  fifo_A_PE_12_16 )
         .invoke( B_PE_dummy,
                  12,
                  0,
+                 batch,
                  fifo_B_PE_13_0 )
         .invoke( B_PE_dummy,
                  12,
                  1,
+                 batch,
                  fifo_B_PE_13_1 )
         .invoke( B_PE_dummy,
                  12,
                  2,
+                 batch,
                  fifo_B_PE_13_2 )
         .invoke( B_PE_dummy,
                  12,
                  3,
+                 batch,
                  fifo_B_PE_13_3 )
         .invoke( B_PE_dummy,
                  12,
                  4,
+                 batch,
                  fifo_B_PE_13_4 )
         .invoke( B_PE_dummy,
                  12,
                  5,
+                 batch,
                  fifo_B_PE_13_5 )
         .invoke( B_PE_dummy,
                  12,
                  6,
+                 batch,
                  fifo_B_PE_13_6 )
         .invoke( B_PE_dummy,
                  12,
                  7,
+                 batch,
                  fifo_B_PE_13_7 )
         .invoke( B_PE_dummy,
                  12,
                  8,
+                 batch,
                  fifo_B_PE_13_8 )
         .invoke( B_PE_dummy,
                  12,
                  9,
+                 batch,
                  fifo_B_PE_13_9 )
         .invoke( B_PE_dummy,
                  12,
                  10,
+                 batch,
                  fifo_B_PE_13_10 )
         .invoke( B_PE_dummy,
                  12,
                  11,
+                 batch,
                  fifo_B_PE_13_11 )
         .invoke( B_PE_dummy,
                  12,
                  12,
+                 batch,
                  fifo_B_PE_13_12 )
         .invoke( B_PE_dummy,
                  12,
                  13,
+                 batch,
                  fifo_B_PE_13_13 )
         .invoke( B_PE_dummy,
                  12,
                  14,
+                 batch,
                  fifo_B_PE_13_14 )
         .invoke( B_PE_dummy,
                  12,
                  15,
+                 batch,
                  fifo_B_PE_13_15 )
         .invoke( C_drain_IO_L1_out_boundary,
                  0,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_12,
                  fifo_C_drain_PE_12_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_12,
                  fifo_C_drain_C_drain_IO_L1_out_0_11,
                  fifo_C_drain_PE_11_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_11,
                  fifo_C_drain_C_drain_IO_L1_out_0_10,
                  fifo_C_drain_PE_10_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_10,
                  fifo_C_drain_C_drain_IO_L1_out_0_9,
                  fifo_C_drain_PE_9_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_9,
                  fifo_C_drain_C_drain_IO_L1_out_0_8,
                  fifo_C_drain_PE_8_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_8,
                  fifo_C_drain_C_drain_IO_L1_out_0_7,
                  fifo_C_drain_PE_7_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_7,
                  fifo_C_drain_C_drain_IO_L1_out_0_6,
                  fifo_C_drain_PE_6_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_6,
                  fifo_C_drain_C_drain_IO_L1_out_0_5,
                  fifo_C_drain_PE_5_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_5,
                  fifo_C_drain_C_drain_IO_L1_out_0_4,
                  fifo_C_drain_PE_4_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_4,
                  fifo_C_drain_C_drain_IO_L1_out_0_3,
                  fifo_C_drain_PE_3_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_3,
                  fifo_C_drain_C_drain_IO_L1_out_0_2,
                  fifo_C_drain_PE_2_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_2,
                  fifo_C_drain_C_drain_IO_L1_out_0_1,
                  fifo_C_drain_PE_1_0 )
         .invoke( C_drain_IO_L1_out,
                  0,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_0_1,
                  fifo_C_drain_C_drain_IO_L1_out_0_0,
                  fifo_C_drain_PE_0_0 )
         .invoke( C_drain_IO_L1_out_boundary,
                  1,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_12,
                  fifo_C_drain_PE_12_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_12,
                  fifo_C_drain_C_drain_IO_L1_out_1_11,
                  fifo_C_drain_PE_11_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_11,
                  fifo_C_drain_C_drain_IO_L1_out_1_10,
                  fifo_C_drain_PE_10_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_10,
                  fifo_C_drain_C_drain_IO_L1_out_1_9,
                  fifo_C_drain_PE_9_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_9,
                  fifo_C_drain_C_drain_IO_L1_out_1_8,
                  fifo_C_drain_PE_8_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_8,
                  fifo_C_drain_C_drain_IO_L1_out_1_7,
                  fifo_C_drain_PE_7_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_7,
                  fifo_C_drain_C_drain_IO_L1_out_1_6,
                  fifo_C_drain_PE_6_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_6,
                  fifo_C_drain_C_drain_IO_L1_out_1_5,
                  fifo_C_drain_PE_5_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_5,
                  fifo_C_drain_C_drain_IO_L1_out_1_4,
                  fifo_C_drain_PE_4_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_4,
                  fifo_C_drain_C_drain_IO_L1_out_1_3,
                  fifo_C_drain_PE_3_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_3,
                  fifo_C_drain_C_drain_IO_L1_out_1_2,
                  fifo_C_drain_PE_2_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_2,
                  fifo_C_drain_C_drain_IO_L1_out_1_1,
                  fifo_C_drain_PE_1_1 )
         .invoke( C_drain_IO_L1_out,
                  1,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_1_1,
                  fifo_C_drain_C_drain_IO_L1_out_1_0,
                  fifo_C_drain_PE_0_1 )
         .invoke( C_drain_IO_L1_out_boundary,
                  2,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_12,
                  fifo_C_drain_PE_12_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_12,
                  fifo_C_drain_C_drain_IO_L1_out_2_11,
                  fifo_C_drain_PE_11_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_11,
                  fifo_C_drain_C_drain_IO_L1_out_2_10,
                  fifo_C_drain_PE_10_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_10,
                  fifo_C_drain_C_drain_IO_L1_out_2_9,
                  fifo_C_drain_PE_9_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_9,
                  fifo_C_drain_C_drain_IO_L1_out_2_8,
                  fifo_C_drain_PE_8_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_8,
                  fifo_C_drain_C_drain_IO_L1_out_2_7,
                  fifo_C_drain_PE_7_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_7,
                  fifo_C_drain_C_drain_IO_L1_out_2_6,
                  fifo_C_drain_PE_6_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_6,
                  fifo_C_drain_C_drain_IO_L1_out_2_5,
                  fifo_C_drain_PE_5_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_5,
                  fifo_C_drain_C_drain_IO_L1_out_2_4,
                  fifo_C_drain_PE_4_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_4,
                  fifo_C_drain_C_drain_IO_L1_out_2_3,
                  fifo_C_drain_PE_3_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_3,
                  fifo_C_drain_C_drain_IO_L1_out_2_2,
                  fifo_C_drain_PE_2_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_2,
                  fifo_C_drain_C_drain_IO_L1_out_2_1,
                  fifo_C_drain_PE_1_2 )
         .invoke( C_drain_IO_L1_out,
                  2,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_2_1,
                  fifo_C_drain_C_drain_IO_L1_out_2_0,
                  fifo_C_drain_PE_0_2 )
         .invoke( C_drain_IO_L1_out_boundary,
                  3,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_12,
                  fifo_C_drain_PE_12_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_12,
                  fifo_C_drain_C_drain_IO_L1_out_3_11,
                  fifo_C_drain_PE_11_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_11,
                  fifo_C_drain_C_drain_IO_L1_out_3_10,
                  fifo_C_drain_PE_10_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_10,
                  fifo_C_drain_C_drain_IO_L1_out_3_9,
                  fifo_C_drain_PE_9_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_9,
                  fifo_C_drain_C_drain_IO_L1_out_3_8,
                  fifo_C_drain_PE_8_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_8,
                  fifo_C_drain_C_drain_IO_L1_out_3_7,
                  fifo_C_drain_PE_7_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_7,
                  fifo_C_drain_C_drain_IO_L1_out_3_6,
                  fifo_C_drain_PE_6_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_6,
                  fifo_C_drain_C_drain_IO_L1_out_3_5,
                  fifo_C_drain_PE_5_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_5,
                  fifo_C_drain_C_drain_IO_L1_out_3_4,
                  fifo_C_drain_PE_4_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_4,
                  fifo_C_drain_C_drain_IO_L1_out_3_3,
                  fifo_C_drain_PE_3_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_3,
                  fifo_C_drain_C_drain_IO_L1_out_3_2,
                  fifo_C_drain_PE_2_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_2,
                  fifo_C_drain_C_drain_IO_L1_out_3_1,
                  fifo_C_drain_PE_1_3 )
         .invoke( C_drain_IO_L1_out,
                  3,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_3_1,
                  fifo_C_drain_C_drain_IO_L1_out_3_0,
                  fifo_C_drain_PE_0_3 )
         .invoke( C_drain_IO_L1_out_boundary,
                  4,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_12,
                  fifo_C_drain_PE_12_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_12,
                  fifo_C_drain_C_drain_IO_L1_out_4_11,
                  fifo_C_drain_PE_11_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_11,
                  fifo_C_drain_C_drain_IO_L1_out_4_10,
                  fifo_C_drain_PE_10_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_10,
                  fifo_C_drain_C_drain_IO_L1_out_4_9,
                  fifo_C_drain_PE_9_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_9,
                  fifo_C_drain_C_drain_IO_L1_out_4_8,
                  fifo_C_drain_PE_8_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_8,
                  fifo_C_drain_C_drain_IO_L1_out_4_7,
                  fifo_C_drain_PE_7_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_7,
                  fifo_C_drain_C_drain_IO_L1_out_4_6,
                  fifo_C_drain_PE_6_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_6,
                  fifo_C_drain_C_drain_IO_L1_out_4_5,
                  fifo_C_drain_PE_5_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_5,
                  fifo_C_drain_C_drain_IO_L1_out_4_4,
                  fifo_C_drain_PE_4_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_4,
                  fifo_C_drain_C_drain_IO_L1_out_4_3,
                  fifo_C_drain_PE_3_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_3,
                  fifo_C_drain_C_drain_IO_L1_out_4_2,
                  fifo_C_drain_PE_2_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_2,
                  fifo_C_drain_C_drain_IO_L1_out_4_1,
                  fifo_C_drain_PE_1_4 )
         .invoke( C_drain_IO_L1_out,
                  4,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_4_1,
                  fifo_C_drain_C_drain_IO_L1_out_4_0,
                  fifo_C_drain_PE_0_4 )
         .invoke( C_drain_IO_L1_out_boundary,
                  5,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_12,
                  fifo_C_drain_PE_12_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_12,
                  fifo_C_drain_C_drain_IO_L1_out_5_11,
                  fifo_C_drain_PE_11_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_11,
                  fifo_C_drain_C_drain_IO_L1_out_5_10,
                  fifo_C_drain_PE_10_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_10,
                  fifo_C_drain_C_drain_IO_L1_out_5_9,
                  fifo_C_drain_PE_9_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_9,
                  fifo_C_drain_C_drain_IO_L1_out_5_8,
                  fifo_C_drain_PE_8_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_8,
                  fifo_C_drain_C_drain_IO_L1_out_5_7,
                  fifo_C_drain_PE_7_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_7,
                  fifo_C_drain_C_drain_IO_L1_out_5_6,
                  fifo_C_drain_PE_6_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_6,
                  fifo_C_drain_C_drain_IO_L1_out_5_5,
                  fifo_C_drain_PE_5_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_5,
                  fifo_C_drain_C_drain_IO_L1_out_5_4,
                  fifo_C_drain_PE_4_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_4,
                  fifo_C_drain_C_drain_IO_L1_out_5_3,
                  fifo_C_drain_PE_3_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_3,
                  fifo_C_drain_C_drain_IO_L1_out_5_2,
                  fifo_C_drain_PE_2_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_2,
                  fifo_C_drain_C_drain_IO_L1_out_5_1,
                  fifo_C_drain_PE_1_5 )
         .invoke( C_drain_IO_L1_out,
                  5,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_5_1,
                  fifo_C_drain_C_drain_IO_L1_out_5_0,
                  fifo_C_drain_PE_0_5 )
         .invoke( C_drain_IO_L1_out_boundary,
                  6,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_12,
                  fifo_C_drain_PE_12_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_12,
                  fifo_C_drain_C_drain_IO_L1_out_6_11,
                  fifo_C_drain_PE_11_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_11,
                  fifo_C_drain_C_drain_IO_L1_out_6_10,
                  fifo_C_drain_PE_10_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_10,
                  fifo_C_drain_C_drain_IO_L1_out_6_9,
                  fifo_C_drain_PE_9_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_9,
                  fifo_C_drain_C_drain_IO_L1_out_6_8,
                  fifo_C_drain_PE_8_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_8,
                  fifo_C_drain_C_drain_IO_L1_out_6_7,
                  fifo_C_drain_PE_7_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_7,
                  fifo_C_drain_C_drain_IO_L1_out_6_6,
                  fifo_C_drain_PE_6_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_6,
                  fifo_C_drain_C_drain_IO_L1_out_6_5,
                  fifo_C_drain_PE_5_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_5,
                  fifo_C_drain_C_drain_IO_L1_out_6_4,
                  fifo_C_drain_PE_4_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_4,
                  fifo_C_drain_C_drain_IO_L1_out_6_3,
                  fifo_C_drain_PE_3_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_3,
                  fifo_C_drain_C_drain_IO_L1_out_6_2,
                  fifo_C_drain_PE_2_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_2,
                  fifo_C_drain_C_drain_IO_L1_out_6_1,
                  fifo_C_drain_PE_1_6 )
         .invoke( C_drain_IO_L1_out,
                  6,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_6_1,
                  fifo_C_drain_C_drain_IO_L1_out_6_0,
                  fifo_C_drain_PE_0_6 )
         .invoke( C_drain_IO_L1_out_boundary,
                  7,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_12,
                  fifo_C_drain_PE_12_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_12,
                  fifo_C_drain_C_drain_IO_L1_out_7_11,
                  fifo_C_drain_PE_11_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_11,
                  fifo_C_drain_C_drain_IO_L1_out_7_10,
                  fifo_C_drain_PE_10_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_10,
                  fifo_C_drain_C_drain_IO_L1_out_7_9,
                  fifo_C_drain_PE_9_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_9,
                  fifo_C_drain_C_drain_IO_L1_out_7_8,
                  fifo_C_drain_PE_8_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_8,
                  fifo_C_drain_C_drain_IO_L1_out_7_7,
                  fifo_C_drain_PE_7_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_7,
                  fifo_C_drain_C_drain_IO_L1_out_7_6,
                  fifo_C_drain_PE_6_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_6,
                  fifo_C_drain_C_drain_IO_L1_out_7_5,
                  fifo_C_drain_PE_5_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_5,
                  fifo_C_drain_C_drain_IO_L1_out_7_4,
                  fifo_C_drain_PE_4_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_4,
                  fifo_C_drain_C_drain_IO_L1_out_7_3,
                  fifo_C_drain_PE_3_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_3,
                  fifo_C_drain_C_drain_IO_L1_out_7_2,
                  fifo_C_drain_PE_2_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_2,
                  fifo_C_drain_C_drain_IO_L1_out_7_1,
                  fifo_C_drain_PE_1_7 )
         .invoke( C_drain_IO_L1_out,
                  7,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_7_1,
                  fifo_C_drain_C_drain_IO_L1_out_7_0,
                  fifo_C_drain_PE_0_7 )
         .invoke( C_drain_IO_L1_out_boundary,
                  8,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_12,
                  fifo_C_drain_PE_12_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_12,
                  fifo_C_drain_C_drain_IO_L1_out_8_11,
                  fifo_C_drain_PE_11_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_11,
                  fifo_C_drain_C_drain_IO_L1_out_8_10,
                  fifo_C_drain_PE_10_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_10,
                  fifo_C_drain_C_drain_IO_L1_out_8_9,
                  fifo_C_drain_PE_9_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_9,
                  fifo_C_drain_C_drain_IO_L1_out_8_8,
                  fifo_C_drain_PE_8_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_8,
                  fifo_C_drain_C_drain_IO_L1_out_8_7,
                  fifo_C_drain_PE_7_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_7,
                  fifo_C_drain_C_drain_IO_L1_out_8_6,
                  fifo_C_drain_PE_6_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_6,
                  fifo_C_drain_C_drain_IO_L1_out_8_5,
                  fifo_C_drain_PE_5_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_5,
                  fifo_C_drain_C_drain_IO_L1_out_8_4,
                  fifo_C_drain_PE_4_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_4,
                  fifo_C_drain_C_drain_IO_L1_out_8_3,
                  fifo_C_drain_PE_3_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_3,
                  fifo_C_drain_C_drain_IO_L1_out_8_2,
                  fifo_C_drain_PE_2_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_2,
                  fifo_C_drain_C_drain_IO_L1_out_8_1,
                  fifo_C_drain_PE_1_8 )
         .invoke( C_drain_IO_L1_out,
                  8,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_8_1,
                  fifo_C_drain_C_drain_IO_L1_out_8_0,
                  fifo_C_drain_PE_0_8 )
         .invoke( C_drain_IO_L1_out_boundary,
                  9,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_12,
                  fifo_C_drain_PE_12_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_12,
                  fifo_C_drain_C_drain_IO_L1_out_9_11,
                  fifo_C_drain_PE_11_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_11,
                  fifo_C_drain_C_drain_IO_L1_out_9_10,
                  fifo_C_drain_PE_10_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_10,
                  fifo_C_drain_C_drain_IO_L1_out_9_9,
                  fifo_C_drain_PE_9_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_9,
                  fifo_C_drain_C_drain_IO_L1_out_9_8,
                  fifo_C_drain_PE_8_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_8,
                  fifo_C_drain_C_drain_IO_L1_out_9_7,
                  fifo_C_drain_PE_7_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_7,
                  fifo_C_drain_C_drain_IO_L1_out_9_6,
                  fifo_C_drain_PE_6_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_6,
                  fifo_C_drain_C_drain_IO_L1_out_9_5,
                  fifo_C_drain_PE_5_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_5,
                  fifo_C_drain_C_drain_IO_L1_out_9_4,
                  fifo_C_drain_PE_4_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_4,
                  fifo_C_drain_C_drain_IO_L1_out_9_3,
                  fifo_C_drain_PE_3_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_3,
                  fifo_C_drain_C_drain_IO_L1_out_9_2,
                  fifo_C_drain_PE_2_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_2,
                  fifo_C_drain_C_drain_IO_L1_out_9_1,
                  fifo_C_drain_PE_1_9 )
         .invoke( C_drain_IO_L1_out,
                  9,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_9_1,
                  fifo_C_drain_C_drain_IO_L1_out_9_0,
                  fifo_C_drain_PE_0_9 )
         .invoke( C_drain_IO_L1_out_boundary,
                  10,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_12,
                  fifo_C_drain_PE_12_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_12,
                  fifo_C_drain_C_drain_IO_L1_out_10_11,
                  fifo_C_drain_PE_11_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_11,
                  fifo_C_drain_C_drain_IO_L1_out_10_10,
                  fifo_C_drain_PE_10_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_10,
                  fifo_C_drain_C_drain_IO_L1_out_10_9,
                  fifo_C_drain_PE_9_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_9,
                  fifo_C_drain_C_drain_IO_L1_out_10_8,
                  fifo_C_drain_PE_8_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_8,
                  fifo_C_drain_C_drain_IO_L1_out_10_7,
                  fifo_C_drain_PE_7_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_7,
                  fifo_C_drain_C_drain_IO_L1_out_10_6,
                  fifo_C_drain_PE_6_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_6,
                  fifo_C_drain_C_drain_IO_L1_out_10_5,
                  fifo_C_drain_PE_5_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_5,
                  fifo_C_drain_C_drain_IO_L1_out_10_4,
                  fifo_C_drain_PE_4_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_4,
                  fifo_C_drain_C_drain_IO_L1_out_10_3,
                  fifo_C_drain_PE_3_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_3,
                  fifo_C_drain_C_drain_IO_L1_out_10_2,
                  fifo_C_drain_PE_2_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_2,
                  fifo_C_drain_C_drain_IO_L1_out_10_1,
                  fifo_C_drain_PE_1_10 )
         .invoke( C_drain_IO_L1_out,
                  10,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_10_1,
                  fifo_C_drain_C_drain_IO_L1_out_10_0,
                  fifo_C_drain_PE_0_10 )
         .invoke( C_drain_IO_L1_out_boundary,
                  11,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_12,
                  fifo_C_drain_PE_12_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_12,
                  fifo_C_drain_C_drain_IO_L1_out_11_11,
                  fifo_C_drain_PE_11_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_11,
                  fifo_C_drain_C_drain_IO_L1_out_11_10,
                  fifo_C_drain_PE_10_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_10,
                  fifo_C_drain_C_drain_IO_L1_out_11_9,
                  fifo_C_drain_PE_9_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_9,
                  fifo_C_drain_C_drain_IO_L1_out_11_8,
                  fifo_C_drain_PE_8_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_8,
                  fifo_C_drain_C_drain_IO_L1_out_11_7,
                  fifo_C_drain_PE_7_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_7,
                  fifo_C_drain_C_drain_IO_L1_out_11_6,
                  fifo_C_drain_PE_6_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_6,
                  fifo_C_drain_C_drain_IO_L1_out_11_5,
                  fifo_C_drain_PE_5_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_5,
                  fifo_C_drain_C_drain_IO_L1_out_11_4,
                  fifo_C_drain_PE_4_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_4,
                  fifo_C_drain_C_drain_IO_L1_out_11_3,
                  fifo_C_drain_PE_3_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_3,
                  fifo_C_drain_C_drain_IO_L1_out_11_2,
                  fifo_C_drain_PE_2_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_2,
                  fifo_C_drain_C_drain_IO_L1_out_11_1,
                  fifo_C_drain_PE_1_11 )
         .invoke( C_drain_IO_L1_out,
                  11,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_11_1,
                  fifo_C_drain_C_drain_IO_L1_out_11_0,
                  fifo_C_drain_PE_0_11 )
         .invoke( C_drain_IO_L1_out_boundary,
                  12,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_12,
                  fifo_C_drain_PE_12_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_12,
                  fifo_C_drain_C_drain_IO_L1_out_12_11,
                  fifo_C_drain_PE_11_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_11,
                  fifo_C_drain_C_drain_IO_L1_out_12_10,
                  fifo_C_drain_PE_10_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_10,
                  fifo_C_drain_C_drain_IO_L1_out_12_9,
                  fifo_C_drain_PE_9_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_9,
                  fifo_C_drain_C_drain_IO_L1_out_12_8,
                  fifo_C_drain_PE_8_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_8,
                  fifo_C_drain_C_drain_IO_L1_out_12_7,
                  fifo_C_drain_PE_7_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_7,
                  fifo_C_drain_C_drain_IO_L1_out_12_6,
                  fifo_C_drain_PE_6_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_6,
                  fifo_C_drain_C_drain_IO_L1_out_12_5,
                  fifo_C_drain_PE_5_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_5,
                  fifo_C_drain_C_drain_IO_L1_out_12_4,
                  fifo_C_drain_PE_4_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_4,
                  fifo_C_drain_C_drain_IO_L1_out_12_3,
                  fifo_C_drain_PE_3_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_3,
                  fifo_C_drain_C_drain_IO_L1_out_12_2,
                  fifo_C_drain_PE_2_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_2,
                  fifo_C_drain_C_drain_IO_L1_out_12_1,
                  fifo_C_drain_PE_1_12 )
         .invoke( C_drain_IO_L1_out,
                  12,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_12_1,
                  fifo_C_drain_C_drain_IO_L1_out_12_0,
                  fifo_C_drain_PE_0_12 )
         .invoke( C_drain_IO_L1_out_boundary,
                  13,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_12,
                  fifo_C_drain_PE_12_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_12,
                  fifo_C_drain_C_drain_IO_L1_out_13_11,
                  fifo_C_drain_PE_11_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_11,
                  fifo_C_drain_C_drain_IO_L1_out_13_10,
                  fifo_C_drain_PE_10_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_10,
                  fifo_C_drain_C_drain_IO_L1_out_13_9,
                  fifo_C_drain_PE_9_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_9,
                  fifo_C_drain_C_drain_IO_L1_out_13_8,
                  fifo_C_drain_PE_8_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_8,
                  fifo_C_drain_C_drain_IO_L1_out_13_7,
                  fifo_C_drain_PE_7_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_7,
                  fifo_C_drain_C_drain_IO_L1_out_13_6,
                  fifo_C_drain_PE_6_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_6,
                  fifo_C_drain_C_drain_IO_L1_out_13_5,
                  fifo_C_drain_PE_5_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_5,
                  fifo_C_drain_C_drain_IO_L1_out_13_4,
                  fifo_C_drain_PE_4_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_4,
                  fifo_C_drain_C_drain_IO_L1_out_13_3,
                  fifo_C_drain_PE_3_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_3,
                  fifo_C_drain_C_drain_IO_L1_out_13_2,
                  fifo_C_drain_PE_2_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_2,
                  fifo_C_drain_C_drain_IO_L1_out_13_1,
                  fifo_C_drain_PE_1_13 )
         .invoke( C_drain_IO_L1_out,
                  13,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_13_1,
                  fifo_C_drain_C_drain_IO_L1_out_13_0,
                  fifo_C_drain_PE_0_13 )
         .invoke( C_drain_IO_L1_out_boundary,
                  14,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_12,
                  fifo_C_drain_PE_12_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_12,
                  fifo_C_drain_C_drain_IO_L1_out_14_11,
                  fifo_C_drain_PE_11_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_11,
                  fifo_C_drain_C_drain_IO_L1_out_14_10,
                  fifo_C_drain_PE_10_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_10,
                  fifo_C_drain_C_drain_IO_L1_out_14_9,
                  fifo_C_drain_PE_9_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_9,
                  fifo_C_drain_C_drain_IO_L1_out_14_8,
                  fifo_C_drain_PE_8_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_8,
                  fifo_C_drain_C_drain_IO_L1_out_14_7,
                  fifo_C_drain_PE_7_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_7,
                  fifo_C_drain_C_drain_IO_L1_out_14_6,
                  fifo_C_drain_PE_6_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_6,
                  fifo_C_drain_C_drain_IO_L1_out_14_5,
                  fifo_C_drain_PE_5_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_5,
                  fifo_C_drain_C_drain_IO_L1_out_14_4,
                  fifo_C_drain_PE_4_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_4,
                  fifo_C_drain_C_drain_IO_L1_out_14_3,
                  fifo_C_drain_PE_3_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_3,
                  fifo_C_drain_C_drain_IO_L1_out_14_2,
                  fifo_C_drain_PE_2_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_2,
                  fifo_C_drain_C_drain_IO_L1_out_14_1,
                  fifo_C_drain_PE_1_14 )
         .invoke( C_drain_IO_L1_out,
                  14,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_14_1,
                  fifo_C_drain_C_drain_IO_L1_out_14_0,
                  fifo_C_drain_PE_0_14 )
         .invoke( C_drain_IO_L1_out_boundary,
                  15,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_12,
                  fifo_C_drain_PE_12_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_12,
                  fifo_C_drain_C_drain_IO_L1_out_15_11,
                  fifo_C_drain_PE_11_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_11,
                  fifo_C_drain_C_drain_IO_L1_out_15_10,
                  fifo_C_drain_PE_10_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_10,
                  fifo_C_drain_C_drain_IO_L1_out_15_9,
                  fifo_C_drain_PE_9_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_9,
                  fifo_C_drain_C_drain_IO_L1_out_15_8,
                  fifo_C_drain_PE_8_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_8,
                  fifo_C_drain_C_drain_IO_L1_out_15_7,
                  fifo_C_drain_PE_7_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_7,
                  fifo_C_drain_C_drain_IO_L1_out_15_6,
                  fifo_C_drain_PE_6_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_6,
                  fifo_C_drain_C_drain_IO_L1_out_15_5,
                  fifo_C_drain_PE_5_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_5,
                  fifo_C_drain_C_drain_IO_L1_out_15_4,
                  fifo_C_drain_PE_4_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_4,
                  fifo_C_drain_C_drain_IO_L1_out_15_3,
                  fifo_C_drain_PE_3_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_3,
                  fifo_C_drain_C_drain_IO_L1_out_15_2,
                  fifo_C_drain_PE_2_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_2,
                  fifo_C_drain_C_drain_IO_L1_out_15_1,
                  fifo_C_drain_PE_1_15 )
         .invoke( C_drain_IO_L1_out,
                  15,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L1_out_15_1,
                  fifo_C_drain_C_drain_IO_L1_out_15_0,
                  fifo_C_drain_PE_0_15 )
         .invoke( C_drain_IO_L2_out_boundary,
                  15,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_15,
                  fifo_C_drain_C_drain_IO_L1_out_15_0 )
         .invoke( C_drain_IO_L2_out,
                  14,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_15,
                  fifo_C_drain_C_drain_IO_L2_out_14,
                  fifo_C_drain_C_drain_IO_L1_out_14_0 )
         .invoke( C_drain_IO_L2_out,
                  13,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_14,
                  fifo_C_drain_C_drain_IO_L2_out_13,
                  fifo_C_drain_C_drain_IO_L1_out_13_0 )
         .invoke( C_drain_IO_L2_out,
                  12,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_13,
                  fifo_C_drain_C_drain_IO_L2_out_12,
                  fifo_C_drain_C_drain_IO_L1_out_12_0 )
         .invoke( C_drain_IO_L2_out,
                  11,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_12,
                  fifo_C_drain_C_drain_IO_L2_out_11,
                  fifo_C_drain_C_drain_IO_L1_out_11_0 )
         .invoke( C_drain_IO_L2_out,
                  10,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_11,
                  fifo_C_drain_C_drain_IO_L2_out_10,
                  fifo_C_drain_C_drain_IO_L1_out_10_0 )
         .invoke( C_drain_IO_L2_out,
                  9,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_10,
                  fifo_C_drain_C_drain_IO_L2_out_9,
                  fifo_C_drain_C_drain_IO_L1_out_9_0 )
         .invoke( C_drain_IO_L2_out,
                  8,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_9,
                  fifo_C_drain_C_drain_IO_L2_out_8,
                  fifo_C_drain_C_drain_IO_L1_out_8_0 )
         .invoke( C_drain_IO_L2_out,
                  7,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_8,
                  fifo_C_drain_C_drain_IO_L2_out_7,
                  fifo_C_drain_C_drain_IO_L1_out_7_0 )
         .invoke( C_drain_IO_L2_out,
                  6,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_7,
                  fifo_C_drain_C_drain_IO_L2_out_6,
                  fifo_C_drain_C_drain_IO_L1_out_6_0 )
         .invoke( C_drain_IO_L2_out,
                  5,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_6,
                  fifo_C_drain_C_drain_IO_L2_out_5,
                  fifo_C_drain_C_drain_IO_L1_out_5_0 )
         .invoke( C_drain_IO_L2_out,
                  4,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_5,
                  fifo_C_drain_C_drain_IO_L2_out_4,
                  fifo_C_drain_C_drain_IO_L1_out_4_0 )
         .invoke( C_drain_IO_L2_out,
                  3,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_4,
                  fifo_C_drain_C_drain_IO_L2_out_3,
                  fifo_C_drain_C_drain_IO_L1_out_3_0 )
         .invoke( C_drain_IO_L2_out,
                  2,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_3,
                  fifo_C_drain_C_drain_IO_L2_out_2,
                  fifo_C_drain_C_drain_IO_L1_out_2_0 )
         .invoke( C_drain_IO_L2_out,
                  1,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_2,
                  fifo_C_drain_C_drain_IO_L2_out_1,
                  fifo_C_drain_C_drain_IO_L1_out_1_0 )
         .invoke( C_drain_IO_L2_out,
                  0,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_1,
                  fifo_C_drain_C_drain_IO_L2_out_0,
                  fifo_C_drain_C_drain_IO_L1_out_0_0 )
         .invoke( C_drain_IO_L3_out,
                  C,
+                 batch,
                  fifo_C_drain_C_drain_IO_L2_out_0 )
         ;
     }
@@ -23,6 +23,40 @@ using std::max;
 template <typename T>
 using aligned_vector = std::vector<T, tapa::aligned_allocator<T>>;
 
+// Lays out dense B (K x N, column major) in NUM_CH_B channels. Each float_v16
+// holds 8 rows of 2 columns, and each channel holds 2 of every 8 columns.
+void prepare_B_fpga(const int K,
+                    const int N,
+                    const vector<float> & mat_B_cpu,
+                    vector<aligned_vector<float> > & mat_B_fpga_vec) {
+    int mat_B_fpga_column_size = ((K + 8 - 1) / 8) * 8 * 2;
+    int mat_B_fpga_chunk_size = ((mat_B_fpga_column_size * (N / 8) + 1023)/1024) * 1024;
+
+    mat_B_fpga_vec.resize(NUM_CH_B);
+    for (int cc = 0; cc < NUM_CH_B; ++cc) {
+        mat_B_fpga_vec[cc].resize(mat_B_fpga_chunk_size, 0.0);
+    }
+    parallel_for(N, [&](int nn) {
+        for (int kk = 0; kk < K; ++kk) {
+            int pos = (kk / 8) * 16 + (nn % 2) * 8 + kk % 8
+                            + mat_B_fpga_column_size * (nn / 8);
+            mat_B_fpga_vec[(nn/2) % 4][pos] = mat_B_cpu[kk + K * nn];
+        }
+    });
+}
+
+// Position of C[mm][nn] in channel mm % NUM_CH_C. Each float_v16 holds 8
+// columns of 2 rows, one from each PEG of the sparse channel.
+int get_C_fpga_pos(const int M, const int mm, const int nn) {
+    int mat_C_fpga_column_size = ((M + NUM_CH_C * 2 - 1) / (NUM_CH_C * 2)) * 16;
+    return mat_C_fpga_column_size * (nn / 8) + (mm / NUM_CH_C) * 8 + nn % 8;
+}
+
+int get_C_fpga_chunk_size(const int M, const int N) {
+    int mat_C_fpga_column_size = ((M + NUM_CH_C * 2 - 1) / (NUM_CH_C * 2)) * 16;
+    return ((mat_C_fpga_column_size * (N / 8) + 1023)/1024) * 1024;
+}
+
 int main(int argc, char **argv) {
     printf("start host\n");
 
@@ -39,15 +73,24 @@ int main(int argc, char **argv) {
     }
     else if (argc != 3) {
         cout << "Usage: " << argv[0] << " [matrix A file] [N] [rp_time] [alpha] [beta]" << std::endl;
+        cout << "Set NUM_RHS to multiply A by several dense matrices B in turn" << std::endl;
         return EXIT_FAILURE;
     }
 
     char * filename_A = argv[1];
     int N = tapa::round_up<8>(atoi(argv[2]));
 
+    // right-hand-side matrices streamed through the same kernel instance
+    int num_rhs = 1;
+    if (const auto num_rhs_ptr = getenv("NUM_RHS")) {
+        num_rhs = max(1, atoi(num_rhs_ptr));
+    }
+
     cout << "N = " << N <<  "\n";
     cout << "alpha = "  << ALPHA << "\n";
     cout << "beta = "  << BETA << "\n";
+    cout << "PEs = " << NUM_PE << ", sparse channels = " << NUM_CH_SPARSE << "\n";
+    cout << "B matrices = " << num_rhs << "\n";
 
     int M, K, nnz;
     vector<int> CSCColPtr;
@@ -67,7 +110,7 @@ int main(int argc, char **argv) {
                            K,
                            nnz,
                            CSC);
-    
+
     CSC_2_CSR(M,
               K,
               nnz,
@@ -77,7 +120,7 @@ int main(int argc, char **argv) {
               CSRRowPtr,
               CSRColIndex,
               CSRVal);
-    
+
     cout <<  "done\n";
 
     cout << "Matrix size: \n";
@@ -86,27 +129,31 @@ int main(int argc, char **argv) {
     cout << "C: dense matrix, "  << M << " x " << N << "\n";
 
     // initiate matrix B and matrix C
-    vector<float> mat_B_cpu, mat_C_cpu;
-    mat_B_cpu.resize(K*N, 0.0);
-    mat_C_cpu.resize(M*N, 0.0);
+    vector<vector<float> > mat_B_cpu(num_rhs);
+    vector<float> mat_C_cpu_in;
+    mat_C_cpu_in.resize(M*N, 0.0);
 
 
     cout << "Generating dense matirx B ...";
-    for (int nn = 0; nn < N; ++nn) {
-        for (int kk = 0; kk < K; ++kk) {
-            mat_B_cpu[kk + K * nn] = 1.0;//(1.0 + kk) + 0.1 * (1.0 + nn); //100.0 * (kk + 1)  + 1.0 * (nn + 1);// / K / N;
+    for (int b = 0; b < num_rhs; ++b) {
+        mat_B_cpu[b].resize(K*N, 0.0);
+        for (int nn = 0; nn < N; ++nn) {
+            for (int kk = 0; kk < K; ++kk) {
+                mat_B_cpu[b][kk + K * nn] = 1.0 + b;//(1.0 + kk) + 0.1 * (1.0 + nn); //100.0 * (kk + 1)  + 1.0 * (nn + 1);// / K / N;
+            }
         }
     }
 
     cout << "Generating dense matirx C ...";
     for (int nn = 0; nn < N; ++nn) {
         for (int mm = 0; mm < M; ++mm) {
-            mat_C_cpu[mm + M * nn] = 1.0 * (mm + 1) * (nn + 1) / M / N;
+            mat_C_cpu_in[mm + M * nn] = 1.0 * (mm + 1) * (nn + 1) / M / N;
         }
     }
     cout <<  "done\n";
 
     cout << "Preparing sparse A for FPGA ...";
+    auto start_prep = std::chrono::steady_clock::now();
 
     vector<vector<edge> > edge_list_pes;
     vector<int> edge_list_ptr;
@@ -114,7 +161,7 @@ int main(int argc, char **argv) {
     generate_edge_list_for_all_PEs(CSCColPtr, //const vector<int> & CSCColPtr,
                                    CSCRowIndex, //const vector<int> & CSCRowIndex,
                                    CSCVal, //const vector<float> & CSCVal,
-                                   NUM_CH_SPARSE*8, //const int NUM_PE,
+                                   NUM_PE, //const int NUM_PE,
                                    M, //const int NUM_ROW,
                                    K, //const int NUM_COLUMN,
                                    WINDOW_SIZE, //const int WINDOW_SIZE,
@@ -132,84 +179,64 @@ int main(int argc, char **argv) {
     }
 
     vector<aligned_vector<unsigned long> > sparse_A_fpga_vec(NUM_CH_SPARSE);
-    int sparse_A_fpga_column_size = 8 * edge_list_ptr[edge_list_ptr.size()-1] * 4 / 4;
-    int sparse_A_fpga_chunk_size = ((sparse_A_fpga_column_size + 511)/512) * 512;
 
     edge_list_64bit(edge_list_pes,
                     edge_list_ptr,
                     sparse_A_fpga_vec,
                     NUM_CH_SPARSE);
 
-    cout <<  "done\n";
+    auto end_prep = std::chrono::steady_clock::now();
+    double time_prep = std::chrono::duration_cast<std::chrono::nanoseconds>(end_prep - start_prep).count();
+    cout << "done (" << time_prep*1e-6 << " msec)\n";
 
     cout << "Preparing dense B for FPGA ...";
 
-    vector<aligned_vector<float> > mat_B_fpga_vec(NUM_CH_B);
-    //int mat_B_fpga_column_size = ((K * N + 16 * NUM_CH_B - 1) / (16 * NUM_CH_B)) * 16 * NUM_CH_B;
-    // 07-21 int mat_B_fpga_column_size = ((K + 16 - 1) / 16) * 16;
-    int mat_B_fpga_column_size;
-    if (NUM_CH_B == 8) {
-        mat_B_fpga_column_size = ((K + 16 - 1) / 16) * 16;
-    }else if (NUM_CH_B == 4) {
-        mat_B_fpga_column_size = ((K + 8 - 1) / 8) * 8 * 2;
-    }
-    int mat_B_fpga_chunk_size = ((mat_B_fpga_column_size * (N / 8) + 1023)/1024) * 1024;
-
-    for (int cc = 0; cc < NUM_CH_B; ++cc) {
-        mat_B_fpga_vec[cc].resize(mat_B_fpga_chunk_size, 0.0);
-    }
-    for (int nn = 0; nn < N; ++nn) {
-        for (int kk = 0; kk < K; ++kk) {
-            if (NUM_CH_B == 4) {
-                int pos = (kk / 8) * 16 + (nn % 2) * 8 + kk % 8
-                                + mat_B_fpga_column_size * (nn / 8);
-                mat_B_fpga_vec[(nn/2) % 4][pos] = mat_B_cpu[kk + K * nn];
-            } else if (NUM_CH_B == 8) {
-                int pos = kk + mat_B_fpga_column_size * (nn / 8);
-                mat_B_fpga_vec[nn % 8][pos] = mat_B_cpu[kk + K * nn];
-            }
-        }
+    vector<vector<aligned_vector<float> > > mat_B_fpga_vec(num_rhs);
+    for (int b = 0; b < num_rhs; ++b) {
+        prepare_B_fpga(K, N, mat_B_cpu[b], mat_B_fpga_vec[b]);
     }
 
     cout << "Preparing dense C for FPGA ...";
-    vector<aligned_vector<float> > mat_C_fpga_in(8);
-    int mat_C_fpga_column_size = ((M + 16 - 1) / 16) * 16;
-    int mat_C_fpga_chunk_size = ((mat_C_fpga_column_size * (N / 8) + 1023)/1024) * 1024;
+    vector<aligned_vector<float> > mat_C_fpga_in(NUM_CH_C);
+    int mat_C_fpga_chunk_size = get_C_fpga_chunk_size(M, N);
 
-    for (int nn = 0; nn < 8; ++nn) {
-        mat_C_fpga_in[nn].resize(mat_C_fpga_chunk_size, 0.0);
+    for (int cc = 0; cc < NUM_CH_C; ++cc) {
+        mat_C_fpga_in[cc].resize(mat_C_fpga_chunk_size, 0.0);
     }
 
-    for (int nn = 0; nn < N; ++nn) {
+    parallel_for(N, [&](int nn) {
         for (int mm = 0; mm < M; ++mm) {
-            //int pos = mat_C_fpga_column_size * (nn / 8) + mm;
-            //mat_C_fpga_in[nn % 8][pos] = mat_C_cpu[mm + M * nn];
-            int pos = mat_C_fpga_column_size * (nn / 8) + (mm / 8) * 8 + nn % 8;
-            mat_C_fpga_in[mm % 8][pos] = mat_C_cpu[mm + M * nn];
+            int pos = get_C_fpga_pos(M, mm, nn);
+            mat_C_fpga_in[mm % NUM_CH_C][pos] = mat_C_cpu_in[mm + M * nn];
         }
-    }
+    });
 
-    vector<aligned_vector<float> > mat_C_fpga_vec(NUM_CH_C);
-    //int mat_C_fpga_column_size = ((M * N + 16 * NUM_CH_C - 1) / (16 * NUM_CH_C)) * 16 * NUM_CH_C;
+    vector<vector<aligned_vector<float> > > mat_C_fpga_vec(num_rhs);
 
-    for (int cc = 0; cc < NUM_CH_C; ++cc) {
-        mat_C_fpga_vec[cc].resize(mat_C_fpga_chunk_size, 0.0);
+    for (int b = 0; b < num_rhs; ++b) {
+        mat_C_fpga_vec[b].resize(NUM_CH_C);
+        for (int cc = 0; cc < NUM_CH_C; ++cc) {
+            mat_C_fpga_vec[b][cc].resize(mat_C_fpga_chunk_size, 0.0);
+        }
     }
 
     cout <<  "done\n";
 
     cout << "Run spmm on cpu...";
+    vector<vector<float> > mat_C_cpu(num_rhs, mat_C_cpu_in);
     auto start_cpu = std::chrono::steady_clock::now();
-    cpu_spmm_CSR(M, N, K, nnz, ALPHA,
-                 CSRRowPtr,
-                 CSRColIndex,
-                 CSRVal,
-                 mat_B_cpu,
-                 BETA,
-                 mat_C_cpu);
+    for (int b = 0; b < num_rhs; ++b) {
+        cpu_spmm_CSR(M, N, K, nnz, ALPHA,
+                     CSRRowPtr,
+                     CSRColIndex,
+                     CSRVal,
+                     mat_B_cpu[b],
+                     BETA,
+                     mat_C_cpu[b]);
+    }
     auto end_cpu = std::chrono::steady_clock::now();
     double time_cpu = std::chrono::duration_cast<std::chrono::nanoseconds>(end_cpu - start_cpu).count();
-    time_cpu *= 1e-9;
+    time_cpu *= 1e-9 / num_rhs;
     cout << "done (" << time_cpu*1000 << " msec)\n";
     cout << "CPU GFLOPS: " << 2.0f*(nnz+M)*N/1000000000/time_cpu << "\n";
 
@@ -227,24 +254,36 @@ int main(int argc, char **argv) {
     if (const auto bitstream_ptr = getenv("TAPAB")) {
         bitstream = bitstream_ptr;
     }
-    
+
+    // The bitstream is loaded once, and A stays on the device across B
+    // matrices. With 2 slots, the transfer of a B matrix overlaps the
+    // computation of the previous one.
+    tapa::device device(bitstream, /*slots=*/2);
+
     cout << "launch kernel\n";
-    double time_taken
-    = tapa::invoke(Sextans, bitstream,
-                   tapa::read_only_mmap<int>(edge_list_ptr_fpga),
-                   tapa::read_only_mmaps<unsigned long, NUM_CH_SPARSE>(sparse_A_fpga_vec).reinterpret<ap_uint<512>>(),
-                   tapa::read_only_mmaps<float, NUM_CH_B>(mat_B_fpga_vec).reinterpret<float_v16>(),
-                   tapa::read_only_mmaps<float, NUM_CH_C>(mat_C_fpga_in).reinterpret<float_v16>(),
-                   tapa::write_only_mmaps<float, NUM_CH_C>(mat_C_fpga_vec).reinterpret<float_v16>(),
-                   MAX_SIZE_edge_LIST_PTR,
-                   MAX_LEN_edge_PTR,
-                   M,
-                   K,
-                   para_N,
-                   alpha_int,
-                   beta_int
-                   );
-    time_taken *= (1e-9/rp_time);
+    vector<tapa::invocation> invocations;
+    for (int b = 0; b < num_rhs; ++b) {
+        invocations.push_back(device.invoke_async(
+            Sextans,
+            tapa::read_only_mmap<int>(edge_list_ptr_fpga),
+            tapa::read_only_mmaps<unsigned long, NUM_CH_SPARSE>(sparse_A_fpga_vec).reinterpret<ap_uint<512>>(),
+            tapa::read_only_mmaps<float, NUM_CH_B>(mat_B_fpga_vec[b]).reinterpret<float_v16>(),
+            tapa::read_only_mmaps<float, NUM_CH_C>(mat_C_fpga_in).reinterpret<float_v16>(),
+            tapa::write_only_mmaps<float, NUM_CH_C>(mat_C_fpga_vec[b]).reinterpret<float_v16>(),
+            MAX_SIZE_edge_LIST_PTR,
+            MAX_LEN_edge_PTR,
+            M,
+            K,
+            para_N,
+            alpha_int,
+            beta_int
+            ));
+    }
+    double time_taken = 0;
+    for (auto & invocation : invocations) {
+        time_taken += invocation.wait().compute_ns;
+    }
+    time_taken *= (1e-9/rp_time/num_rhs);
     printf("Kernel time is %f ms\n", time_taken*1000);
 
     float gflops =
@@ -254,34 +293,36 @@ int main(int argc, char **argv) {
     ;
     printf("GFLOPS:%f \n", gflops);
 
-    int mismatch_cnt = 0;
-
-    for (int nn = 0; nn < N; ++nn) {
-        for (int mm = 0; mm < M; ++mm) {
-            float v_cpu = mat_C_cpu[mm + nn * M];
-            //int pos = mat_C_fpga_column_size * (nn / 8) + mm;
-            //float v_fpga = mat_C_fpga_vec[nn % 8][pos];
-            int pos = mat_C_fpga_column_size * (nn / 8) + (mm / 8) * 8 + nn % 8;
-            float v_fpga = mat_C_fpga_vec[mm % 8][pos];
-
-            float dff = fabs(v_cpu - v_fpga);
-            float x = min(fabs(v_cpu), fabs(v_fpga)) + 1e-4;
-            if (dff/x > 1e-4) {
-                mismatch_cnt++;
+    bool pass = true;
+    for (int b = 0; b < num_rhs; ++b) {
+        int mismatch_cnt = 0;
+
+        for (int nn = 0; nn < N; ++nn) {
+            for (int mm = 0; mm < M; ++mm) {
+                float v_cpu = mat_C_cpu[b][mm + nn * M];
+                int pos = get_C_fpga_pos(M, mm, nn);
+                float v_fpga = mat_C_fpga_vec[b][mm % NUM_CH_C][pos];
+
+                float dff = fabs(v_cpu - v_fpga);
+                float x = min(fabs(v_cpu), fabs(v_fpga)) + 1e-4;
+                if (dff/x > 1e-4) {
+                    mismatch_cnt++;
+                }
+                //cout << "n = " << nn << ", m = " << mm << ", cpu = " << v_cpu << ", fpga = " << v_fpga << endl;
             }
-            //cout << "n = " << nn << ", m = " << mm << ", cpu = " << v_cpu << ", fpga = " << v_fpga << endl;
         }
-    }
 
-    float diffpercent = 100.0 * mismatch_cnt / M / N;
-    bool pass = diffpercent < 2.0;
+        float diffpercent = 100.0 * mismatch_cnt / M / N;
+        pass &= diffpercent < 2.0;
+
+        printf("B[%d]: num_mismatch = %d, percent = %.2f%%\n", b, mismatch_cnt, diffpercent);
+    }
 
     if(pass){
         cout << "Success!\n";
     } else{
         cout << "Failed.\n";
     }
-    printf("num_mismatch = %d, percent = %.2f%%\n", mismatch_cnt, diffpercent);
 
     return EXIT_SUCCESS;
 }
@@ -11,6 +11,11 @@
 constexpr int FIFO_DEPTH = 2;
 constexpr int PEG_PER_A = 512 / 256;
 
+// Rows of C in the same float_v16 of all C channels together. PE p holds rows
+// p, p + NUM_PE, ..., and each float_v16 of a C channel holds 8 columns of one
+// row from each PEG of its sparse channel.
+constexpr int NUM_ROW_PER_V16 = NUM_CH_C * PEG_PER_A;
+
 struct MultBVec {
     ap_uint<18> row;
     float_v8 abvec;
@@ -135,7 +140,8 @@ void read_C(tapa::async_mmap<float_v16> C,
     const int N16 = P_N >> 16;
     const int rp_time = (N16 == 0)? 1 : N16;
     const int N = P_N & 0xFFFF;
-    const int num_ite_C = ((M + 15) >> 4) * ((N + 7) >> 3);
+    const int num_ite_C =
+        ((M + NUM_ROW_PER_V16 - 1) / NUM_ROW_PER_V16) * ((N + 7) >> 3);
     
 l_rp:
     for(int rp = 0; rp < rp_time; rp++) {
@@ -163,7 +169,8 @@ void write_C(tapa::istream<int> & wrC_inst,
     const int N16 = P_N >> 16;
     const int rp_time = (N16 == 0)? 1 : N16;
     const int N = P_N & 0xFFFF;
-    const int num_ite_C = ((M + 15) >> 4) * ((N + 7) >> 3);
+    const int num_ite_C =
+        ((M + NUM_ROW_PER_V16 - 1) / NUM_ROW_PER_V16) * ((N + 7) >> 3);
     
 l_rp:
     for(int rp = 0; rp < rp_time; rp++) {
@@ -465,9 +472,9 @@ void PEG_Cmtx(tapa::istream<int> & PE_inst_in,
     const int N = P_N & 0xFFFF;
     const int rp_time_N = rp_time * ((N + 7) >> 3);
     
-    const int num_v_init = (M + 63) >> 6;
+    const int num_v_init = (M + NUM_PE - 1) / NUM_PE;
     //const int num_v_out = (M + 31) >> 5;
-    const int num_v_out = (M + 15) >> 4;
+    const int num_v_out = (M + NUM_ROW_PER_V16 - 1) / NUM_ROW_PER_V16;
     
     //define local C buffer and pragma to URAM
     //ap_uint<64> local_C[2][8 / 2][URAM_DEPTH];
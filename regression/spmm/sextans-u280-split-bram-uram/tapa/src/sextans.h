@@ -4,9 +4,20 @@
 #include <ap_int.h>
 #include <tapa.h>
 
+// Each sparse channel feeds 8 PEs, i.e., 2 PEGs of 4 PEs each, and the results
+// of its PEs are written to a C channel of its own. B is read as 8 columns of 8
+// rows per cycle, which takes 4 channels.
+//
+// The channels are mapped to HBM in link_config.ini, which must be updated
+// together with NUM_CH_SPARSE.
 constexpr int NUM_CH_SPARSE = 8;
+constexpr int NUM_PE = NUM_CH_SPARSE * 8;
 constexpr int NUM_CH_B = 4;
-constexpr int NUM_CH_C = 8;
+constexpr int NUM_CH_C = NUM_CH_SPARSE;
+
+constexpr int NUM_HBM_CH = 32;  // U280
+static_assert(1 + NUM_CH_SPARSE + NUM_CH_B + NUM_CH_C * 2 <= NUM_HBM_CH,
+              "too many channels for the HBM");
 
 const int WINDOW_SIZE = 4096;
 const int DEP_DIST_LOAD_STORE = 10;
@@ -1,5 +1,8 @@
+#include <atomic>
+#include <cstring>
 #include <vector>
 #include <iostream>
+#include <thread>
 #include "mmio.h"
 
 using std::cout;
@@ -34,6 +37,25 @@ struct edge{
     }
 };
 
+// Runs f(i) for each i in [0, n) on all hardware threads. Iterations are taken
+// in turn, so they may be unbalanced.
+template <typename Func>
+void parallel_for(const int n, Func f) {
+    const int num_threads = max(1, min<int>(n, std::thread::hardware_concurrency()));
+    std::atomic<int> next(0);
+    vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&] {
+            for (int i = next++; i < n; i = next++) {
+                f(i);
+            }
+        });
+    }
+    for (auto & t : threads) {
+        t.join();
+    }
+}
+
 int cmp_by_row_column(const void *aa,
                       const void *bb) {
     rcv * a = (rcv *) aa;
@@ -342,6 +364,8 @@ void generate_edge_list_for_one_PE(
 }
 
 
+// Windows are bucketed and each PE of each window is scheduled in parallel.
+// The windows are then aligned across PEs and concatenated.
 void generate_edge_list_for_all_PEs(
     const vector<int> & CSCColPtr,
     const vector<int> & CSCRowIndex,
@@ -355,54 +379,63 @@ void generate_edge_list_for_all_PEs(
     const int DEP_DIST_LOAD_STORE = 10) {
     /* -------------------------- */
     
+    const int num_window = (NUM_COLUMN + WINDOE_SIZE - 1) / WINDOE_SIZE;
     edge_list_pes.resize(NUM_PE);
-    edge_list_ptr.resize((NUM_COLUMN + WINDOE_SIZE - 1) / WINDOE_SIZE + 1, 0);
+    edge_list_ptr.resize(num_window + 1, 0);
     
-    vector<vector<edge> > tmp_edge_list_pes(NUM_PE);
-    for (int i = 0; i < (NUM_COLUMN + WINDOE_SIZE - 1) / WINDOE_SIZE; ++i) {
-        for (int p = 0; p < NUM_PE; ++p) {
-            tmp_edge_list_pes[p].resize(0);
-        }
-        
-        //fill tmp_edge_lsit_pes
+    //fill tmp_edge_list_pes of each window
+    vector<vector<vector<edge> > > tmp_edge_list_pes(num_window);
+    parallel_for(num_window, [&](int i) {
+        tmp_edge_list_pes[i].resize(NUM_PE);
         for (int col =  WINDOE_SIZE * i; col < min(WINDOE_SIZE * (i + 1), NUM_COLUMN); ++col) {
             for (int j = CSCColPtr[col]; j < CSCColPtr[col+1]; ++j) {
                 int p = CSCRowIndex[j] % NUM_PE;
-                int pos = tmp_edge_list_pes[p].size();
-                tmp_edge_list_pes[p].resize(pos + 1);
-                tmp_edge_list_pes[p][pos] = edge(col, CSCRowIndex[j], CSCVal[j]);
+                tmp_edge_list_pes[i][p].push_back(edge(col, CSCRowIndex[j], CSCVal[j]));
             }
         }
-        
-        //form the scheduled edge list for each PE
-        for (int p = 0; p < NUM_PE; ++p) {
-            int i_start = edge_list_pes[p].size();
-            int base_col_index = i * WINDOE_SIZE;
-            generate_edge_list_for_one_PE(tmp_edge_list_pes[p],
-                                          edge_list_pes[p],
-                                          base_col_index,
-                                          i_start,
-                                          NUM_ROW,
-                                          NUM_PE,
-                                          DEP_DIST_LOAD_STORE);
-        }
-        
-        //insert bubules to align edge list
+    });
+    
+    //form the scheduled edge list for each PE of each window
+    vector<vector<vector<edge> > > scheduled_edge_list_pes(num_window, vector<vector<edge> >(NUM_PE));
+    parallel_for(num_window * NUM_PE, [&](int ip) {
+        const int i = ip / NUM_PE;
+        const int p = ip % NUM_PE;
+        generate_edge_list_for_one_PE(tmp_edge_list_pes[i][p],
+                                      scheduled_edge_list_pes[i][p],
+                                      i * WINDOE_SIZE,
+                                      0,
+                                      (NUM_ROW + NUM_PE - 1) / NUM_PE, // rows of a PE
+                                      NUM_PE,
+                                      DEP_DIST_LOAD_STORE);
+        vector<edge>().swap(tmp_edge_list_pes[i][p]);
+    });
+    
+    //pointer, where bubbles are inserted to align edge list
+    for (int i = 0; i < num_window; ++i) {
         int max_len = 0;
         for (int p = 0; p < NUM_PE; ++p) {
-            max_len = max((int) edge_list_pes[p].size(), max_len);
-        }
-        for (int p = 0; p < NUM_PE; ++p) {
-            edge_list_pes[p].resize(max_len, edge(-1,-1,0.0));
+            max_len = max((int) scheduled_edge_list_pes[i][p].size(), max_len);
         }
-        
-        //pointer
-        edge_list_ptr[i+1] = max_len;
+        edge_list_ptr[i+1] = edge_list_ptr[i] + max_len;
     }
     
+    parallel_for(NUM_PE, [&](int p) {
+        edge_list_pes[p].resize(edge_list_ptr[num_window], edge(-1,-1,0.0));
+        for (int i = 0; i < num_window; ++i) {
+            std::copy(scheduled_edge_list_pes[i][p].begin(),
+                      scheduled_edge_list_pes[i][p].end(),
+                      edge_list_pes[p].begin() + edge_list_ptr[i]);
+        }
+    });
 }
 
 
+// Channel cc holds PEs cc, cc + NUM_CH_SPARSE, ..., cc + 7 * NUM_CH_SPARSE, and
+// the j-th of them is row j of the channel. Each 512-bit word of a channel is
+// split into 2 PEGs of 4 PEs, where PEG j % 2 takes the j-th PE as PE
+// {0, 2, 1, 3}[j / 2], which is the order that PEG_Cmtx writes C out.
+//
+// The edges are packed in parallel, in blocks of rows.
 void edge_list_64bit(
     const vector<vector<edge> > & edge_list_pes,
     const vector<int> & edge_list_ptr,
@@ -416,60 +449,40 @@ void edge_list_64bit(
         sparse_A_fpga_vec[cc].resize(sparse_A_fpga_chunk_size, 0);
     }
     
+    const int NUM_PE = NUM_CH_SPARSE * 8;
+    const int lane_in_peg[4] = {0, 2, 1, 3};
+    vector<int> pe_ch(NUM_PE), pe_j(NUM_PE);
+    for (int pe = 0; pe < NUM_PE; ++pe) {
+        const int j = pe / NUM_CH_SPARSE;
+        pe_ch[pe] = pe % NUM_CH_SPARSE;
+        pe_j[pe] = (j % 2) * 4 + lane_in_peg[j / 2];
+    }
+    
     // col(12 bits) + row (20 bits) + value (32 bits)
     // ->
     // col(14 bits) + row (18 bits) + value (32 bits)
-    for (int i = 0; i < edge_list_ptr[edge_list_ptr.size()-1]; ++i) {
-        for (int cc = 0; cc < NUM_CH_SPARSE; ++cc) {
-            for (int j = 0; j < 8; ++j) {
-                edge e = edge_list_pes[j + cc * 8][i];
-                unsigned long x = 0;
-                if (e.row == -1) {
-                    x = 0x3FFFF; //0xFFFFF; //x = 0x3FFFFF;
-                    x = x << 32;
-                } else {
-                    unsigned long x_col = e.col;
-                    x_col = (x_col & 0x3FFF) << (32 + 18); // x_col = (x_col & 0xFFF) << (32 + 20); //x_col = (x_col & 0x3FF) << (32 + 22);
-                    unsigned long x_row = e.row;
-                    x_row = (x_row & 0x3FFFF) << 32; //x_row = (x_row & 0xFFFFF) << 32; //x_row = (x_row & 0x3FFFFF) << 32;
-                    
-                    float x_float = e.attr;
-                    //float x_float = 1.0;
-                    unsigned int x_float_in_int = *((unsigned int*)(&x_float));
-                    unsigned long x_float_val_64 = ((unsigned long) x_float_in_int);
-                    x_float_val_64 = x_float_val_64 & 0xFFFFFFFF;
-                    
-                    x = x_col | x_row | x_float_val_64;
-                }
-                /* change 07-07-2021 START*/
-                /* change 07-07-2021 ORIGINAL START*/
-                //sparse_A_fpga_vec[cc][j + i * 8] = x;
-                /* change 07-07-2021 ORIGINAL END*/
-                /* change 07-07-2021 Change as follows*/
-                if (NUM_CH_SPARSE * 8 <= 16) {
-                    sparse_A_fpga_vec[cc][j + i * 8] = x;
-                } else if (NUM_CH_SPARSE == 8) {
-                    /*
-                    const int pe_idx = j + cc * 8;
-                    const int pix_m16 = pe_idx % 16;
-                    const int ch_idx = pix_m16 / 2;
-                    const int j_new = pe_idx % 2 + (pe_idx / 16) * 2;
-                    */
-                    const int pe_idx = j + cc * 8;
-                    const int ch_idx = j;
-                    const int idx_in8 = pe_idx / 8;
-                    //const int j_new = (idx_in8 % 4) * 2 + idx_in8 / 4; // (0,4), (1,5), (2,6), (3,7)
-                    const int j_new = ((idx_in8 & 0x1) > 0) * 4 + ((idx_in8 & 0x2) > 0) * 2 + ((idx_in8 & 0x4) > 0) * 1; // (0,4), (2,6), (1,5), (3,7)
-                    
-                    sparse_A_fpga_vec[ch_idx][j_new + i * 8] = x;
-                } else if (NUM_CH_SPARSE == 4) {
-                    int pe_idx = j + cc * 8;
-                    sparse_A_fpga_vec[(pe_idx / 4) % 4][pe_idx % 4 + (pe_idx / 16) * 4 + i * 8] = x;
-                }
-                /* change 07-07-2021 END*/
+    const int len = edge_list_ptr[edge_list_ptr.size()-1];
+    const int block_size = 4096;
+    parallel_for((len + block_size - 1) / block_size, [&](int b) {
+        for (int i = b * block_size; i < min((b + 1) * block_size, len); ++i) {
+            for (int pe = 0; pe < NUM_PE; ++pe) {
+                const edge & e = edge_list_pes[pe][i];
+                unsigned int x_float_in_int;
+                memcpy(&x_float_in_int, &e.attr, sizeof(x_float_in_int));
+                
+                unsigned long x_col = e.col;
+                x_col = (x_col & 0x3FFF) << (32 + 18);
+                unsigned long x_row = e.row;
+                x_row = (x_row & 0x3FFFF) << 32;
+                unsigned long x = x_col | x_row | x_float_in_int;
+                
+                // bubble
+                x = (e.row == -1)? (0x3FFFFUL << 32) : x;
+                
+                sparse_A_fpga_vec[pe_ch[pe]][pe_j[pe] + i * 8] = x;
             }
         }
-    }
+    });
 }
 
 void CSC_2_CSR(int M,
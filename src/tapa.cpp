@@ -1,40 +1,159 @@
 #include "tapa.h"
 
+#include <cerrno>
+#include <cinttypes>
+#include <climits>
+#include <cmath>
 #include <csignal>
+#include <cstdio>
 #include <cstring>
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
-#include <functional>
+#include <fstream>
+#include <iomanip>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include <fcntl.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#if TAPA_ENABLE_STACKTRACE
+#include <boost/stacktrace.hpp>
+#endif  // TAPA_ENABLE_STACKTRACE
+
+namespace tapa {
+namespace internal {
+
+// Logs stream stats when the top-level task finishes if they are enabled.
+void log_stats();
+
+// Returns whether any task may still access queues.
+bool is_running();
+
+// Deletes released queues unless any task may still access them.
+void free_released_queues();
+
+// Resets the simulated cycle counter when the top-level task starts.
+void reset_simulated_cycles();
+
+// Logs the simulated cycle counter when the top-level task finishes if any
+// memory model is used or cycle-approximate simulation is enabled.
+void log_simulated_cycles();
+
+// Logs and writes the mmap profile when the top-level task finishes if it is
+// enabled.
+void log_mmap_profile();
+
+// Raises the simulated cycle counter to `cycle` if it is lower.
+void advance_simulated_cycles(uint64_t cycle);
+
+// Virtual clock of a task in cycle-approximate simulation. Each channel
+// accessed by a task is a port that does one operation per cycle, i.e., the
+// task is modeled as a pipeline with II=1. Each operation waits until its
+// channel is ready, and never happens before an earlier read of the task, on
+// which it may depend. Writes do not delay later operations, so that requests
+// can run ahead of responses, e.g., in `tapa::mem_to_stream`.
+struct cycle_clock {
+  uint64_t now = 0;        // Cycle of the latest operation.
+  uint64_t last_read = 0;  // Cycle of the latest read.
+  uint64_t ready = 0;      // Earliest cycle at which tokens written are read.
+  std::vector<std::pair<const void*, uint64_t>> ports;  // Next free cycles.
+
+  // Returns the earliest cycle at which `port` can be accessed.
+  uint64_t issue(const void* port) const {
+    for (auto& entry : this->ports) {
+      if (entry.first == port) return std::max(this->last_read, entry.second);
+    }
+    return this->last_read;
+  }
+
+  // Accesses `port` at `cycle`, which is no earlier than `issue(port)`.
+  void advance(const void* port, uint64_t cycle, bool is_read) {
+    this->now = std::max(this->now, cycle);
+    if (is_read) this->last_read = cycle;
+    for (auto& entry : this->ports) {
+      if (entry.first == port) {
+        entry.second = cycle + 1;
+        return;
+      }
+    }
+    this->ports.emplace_back(port, cycle + 1);
+  }
+};
+
+// Returns the virtual clock of the current task.
+cycle_clock& get_clock();
+
+// Returns the instance name of a task, or the name of its function if it is
+// not named.
+std::string get_task_name(const std::string& name, const void* func);
+
+// Flushes the files of captured tokens when the top-level task finishes.
+void flush_captures();
+
+// Defers a task invoked by the top-level task if software simulation is
+// distributed among processes, in which case `f` is moved.
+bool defer_task(bool detach, bool thread, thunk& f,
+                const std::vector<channel_t>& channels, const task_id& id);
+
+// Schedules the deferred tasks that run in this process, and the relays of the
+// streams between processes, when the top-level task joins its children.
+void schedule_deferred_tasks();
+
+// Waits until the relays of the streams between processes have sent all tokens
+// written by the tasks of this process, which must have finished, and stops
+// the relays.
+void drain_relays();
+
+// Waits a while for tasks to make progress after the top-level task has
+// joined its children, resuming coroutines on this thread if no worker does.
+void wait_for_progress();
+
+}  // namespace internal
+}  // namespace tapa
 
 #if TAPA_ENABLE_COROUTINE
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/context/stack_context.hpp>
 #include <boost/coroutine2/coroutine.hpp>
-#include <boost/coroutine2/fixedsize_stack.hpp>
 #include <boost/stacktrace.hpp>
 
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/resource.h>
 #include <time.h>
+#include <unistd.h>
 
 using std::condition_variable;
-using std::function;
 using std::mutex;
 using std::runtime_error;
 using std::string;
 using std::unordered_map;
+using std::unordered_set;
+using std::vector;
 
 using unique_lock = std::unique_lock<mutex>;
 
@@ -43,7 +162,6 @@ using push_type = boost::coroutines2::coroutine<void>::push_type;
 
 using boost::algorithm::ends_with;
 using boost::algorithm::starts_with;
-using boost::coroutines2::fixedsize_stack;
 
 namespace tapa {
 
@@ -51,40 +169,7 @@ namespace internal {
 
 namespace {
 
-thread_local pull_type* current_handle;
-thread_local bool debug = false;
-mutex debug_mtx;  // Print stacktrace one-by-one.
-
-}  // namespace
-
-void yield(const string& msg) {
-  if (debug) {
-    unique_lock l(debug_mtx);
-    LOG(INFO) << msg;
-#if TAPA_ENABLE_STACKTRACE
-    for (auto& frame : boost::stacktrace::stacktrace()) {
-      const auto line = frame.source_line();
-      const auto file = frame.source_file();
-      auto name = frame.name();
-      if (line == 0 || file == __FILE__ ||
-          // Ignore STL functions.
-          starts_with(name, "void std::") || starts_with(name, "std::") ||
-          // Ignore TAPA channel functions.
-          ends_with(file, "/tapa/mmap.h") ||
-          ends_with(file, "/tapa/stream.h")) {
-        continue;
-      }
-      name = name.substr(0, name.find('('));
-      const auto space_pos = name.find(' ');
-      if (space_pos != string::npos) name = name.substr(space_pos + 1);
-      LOG(INFO) << "  in " << name << "(...) from " << file << ":" << line;
-    }
-#endif  // TAPA_ENABLE_STACKTRACE
-  }
-  (*current_handle)();
-}
-
-namespace {
+constexpr size_t kDefaultStackSize = 8 * 1024 * 1024;  // 8 MiB
 
 uint64_t get_time_ns() {
   timespec tp;
@@ -92,308 +177,3864 @@ uint64_t get_time_ns() {
   return static_cast<uint64_t>(tp.tv_sec) * 1000000000 + tp.tv_nsec;
 }
 
-rlim_t get_stack_size() {
+// Returns the size of each coroutine stack, which can be set via environment
+// variable `TAPA_COROUTINE_STACK_SIZE` (e.g., `512K`, `8M`) and defaults to
+// the stack size limit of the process.
+size_t get_stack_size() {
+  if (auto env = getenv("TAPA_COROUTINE_STACK_SIZE")) {
+    // A positive number of bytes, optionally suffixed with K, M, or G; signs
+    // and other suffixes are rejected rather than silently misread.
+    char* suffix = env;
+    errno = 0;
+    const size_t size =
+        *env >= '0' && *env <= '9' ? strtoull(env, &suffix, 0) : 0;
+    int shift = 0;
+    switch (*suffix) {
+      case 'G':
+      case 'g':
+        shift += 10;
+        // fall through
+      case 'M':
+      case 'm':
+        shift += 10;
+        // fall through
+      case 'K':
+      case 'k':
+        shift += 10;
+        ++suffix;
+    }
+    CHECK(size != 0 && errno == 0 && *suffix == '\0' &&
+          size <= (SIZE_MAX >> shift))
+        << "invalid TAPA_COROUTINE_STACK_SIZE '" << env
+        << "'; expecting a positive size like 8388608, 8192K, or 8M";
+    return size << shift;
+  }
   rlimit rl;
   if (getrlimit(RLIMIT_STACK, &rl) != 0) {
     throw runtime_error(std::strerror(errno));
   }
+  if (rl.rlim_cur == RLIM_INFINITY) return kDefaultStackSize;
   return rl.rlim_cur;
 }
 
-class worker {
-  // dict mapping detach to list of coroutine
-  // list is used because the stable pointer can be used as key in handle_table
-  unordered_map<bool, std::list<push_type>> coroutines;
+// Returns the maximum number of memory mappings a process may have.
+size_t get_max_map_count() {
+  size_t count = 65530;  // Default of Linux.
+  if (auto file = fopen("/proc/sys/vm/max_map_count", "r")) {
+    if (fscanf(file, "%zu", &count) != 1) count = 65530;
+    fclose(file);
+  }
+  return count;
+}
 
-  // dict mapping coroutine to handle
-  unordered_map<push_type*, pull_type*> handle_table;
+// Recycles coroutine stacks so that spawning coroutines does not map and unmap
+// memory every time. Stacks are mapped in slabs so that the number of memory
+// mappings, which is limited by `vm.max_map_count`, does not grow with the
+// number of coroutines. A guard page at the end of a stack needs two mappings
+// on its own, so only stacks within a budget of a quarter of the limit are
+// guarded and the number of coroutines is limited only by memory.
+class stack_pool {
+  static constexpr size_t kStacksPerSlab = 64;
 
-  std::queue<std::tuple<bool, function<void()>>> tasks;
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t size;  // Including the guard page.
   mutex mtx;
-  condition_variable task_cv;
-  condition_variable wait_cv;
-  bool done = false;
-  std::atomic_int signal{0};
-  std::thread thread;
+  vector<void*> stacks;
+  size_t guard_budget = get_max_map_count() / 4 / 2;  // Number of stacks.
 
  public:
-  worker() {
-    auto stack_size = get_stack_size();
-    this->thread = std::thread([this, stack_size]() {
-      for (;;) {
-        // accept new tasks
-        {
-          unique_lock lock(this->mtx);
-          this->task_cv.wait(lock, [this] {
-            return this->done || !this->coroutines.empty() ||
-                   !this->tasks.empty();
-          });
-
-          // stop worker if it is done
-          if (this->done && this->tasks.empty()) break;
-
-          // create coroutines
-          while (!this->tasks.empty()) {
-            bool detach;
-            function<void()> f;
-            std::tie(detach, f) = this->tasks.front();
-            this->tasks.pop();
-
-            auto& l = this->coroutines[detach];  // list of coroutines
-            auto coroutine = new push_type*;
-            auto call_back = [this, &l, f, coroutine](pull_type& handle) {
-              this->handle_table[*coroutine] = current_handle = &handle;
-              delete coroutine;
-              f();
-            };
-            l.emplace_back(fixedsize_stack(stack_size), call_back);
-            *coroutine = &l.back();
-          }
-        }
-
-        // iterate over all tasks and their coroutines
-        bool active = false;
-        bool debugging = this->signal;
-        if (debugging) debug = true;
-        for (auto& pair : this->coroutines) {
-          bool detach = pair.first;
-          auto& coroutines = pair.second;
-          for (auto it = coroutines.begin(); it != coroutines.end();) {
-            if (auto& coroutine = *it) {
-              current_handle = this->handle_table[&coroutine];
-              coroutine();
-            }
-
-            if (*it) {
-              if (!detach) active = true;
-              ++it;
-            } else {
-              unique_lock lock(this->mtx);
-              it = coroutines.erase(it);
-            }
-          }
-        }
-        if (debugging) {
-          debug = false;
-          this->signal = 0;
-        }
-        // response to wait requests
-        if (!active) this->wait_cv.notify_all();
-      }
-    });
-  }
+  explicit stack_pool(size_t size)
+      : size((size + page_size - 1) / page_size * page_size + page_size) {}
+  stack_pool(const stack_pool&) = delete;
+  stack_pool& operator=(const stack_pool&) = delete;
 
-  void add_task(bool detach, const function<void()>& f) {
+  boost::context::stack_context allocate() {
+    void* addr = nullptr;
     {
       unique_lock lock(this->mtx);
-      this->tasks.emplace(detach, f);
+      if (this->stacks.empty()) this->add_slab();
+      addr = this->stacks.back();
+      this->stacks.pop_back();
     }
-    this->task_cv.notify_one();
+    boost::context::stack_context sctx;
+    sctx.size = this->size;
+    sctx.sp = static_cast<char*>(addr) + this->size;  // Stack grows downward.
+    return sctx;
   }
 
-  void wait() {
+  void deallocate(boost::context::stack_context& sctx) {
+    void* addr = static_cast<char*>(sctx.sp) - sctx.size;
     unique_lock lock(this->mtx);
-    this->wait_cv.wait(lock, [this] {
-      return this->tasks.empty() && this->coroutines[false].empty();
-    });
+    this->stacks.push_back(addr);
   }
 
-  void send(int signal) { this->signal = signal; }
-
-  ~worker() {
-    {
-      unique_lock lock(this->mtx);
-      this->done = true;
+ private:
+  // Maps a slab of stacks and adds them to `stacks`. `mtx` must be locked.
+  void add_slab() {
+    auto slab = static_cast<char*>(
+        ::mmap(nullptr, this->size * kStacksPerSlab, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+               /*fd=*/-1, /*offset=*/0));
+    if (slab == MAP_FAILED) throw std::bad_alloc();
+    if (this->guard_budget >= kStacksPerSlab) {
+      for (size_t i = 0; i < kStacksPerSlab; ++i) {
+        if (::mprotect(slab + this->size * i, this->page_size, PROT_NONE) !=
+            0) {
+          throw runtime_error(std::strerror(errno));
+        }
+      }
+      this->guard_budget -= kStacksPerSlab;
+    } else if (this->guard_budget != 0) {
+      LOG(WARNING) << "too many coroutines; new coroutine stacks are not "
+                      "guarded against overflow";
+      this->guard_budget = 0;
+    }
+    for (size_t i = kStacksPerSlab; i > 0; --i) {
+      this->stacks.push_back(slab + this->size * (i - 1));
     }
-    this->task_cv.notify_all();
-    this->thread.join();
   }
 };
 
-void signal_handler(int signal);
+// Stacks are kept for the lifetime of the process so that they are reused
+// across invocations of the top-level task. The pool is never destroyed since
+// `exit` may be called while coroutines are running.
+stack_pool& get_stack_pool() {
+  static auto pool = new stack_pool(get_stack_size());
+  return *pool;
+}
 
-class thread_pool {
-  mutex worker_mtx;
-  std::list<worker> workers;
-  decltype(workers)::iterator it;
+// Implements the `StackAllocator` concept of Boost.Context using `stack_pool`.
+class pooled_stack {
+  stack_pool* pool;
 
  public:
-  thread_pool(size_t worker_count = 0) {
-    signal(SIGINT, signal_handler);
-    if (worker_count == 0) {
-      if (auto concurrency = getenv("TAPA_CONCURRENCY")) {
-        worker_count = atoi(concurrency);
-      } else {
-        worker_count = std::thread::hardware_concurrency();
+  explicit pooled_stack(stack_pool& pool) : pool(&pool) {}
+  boost::context::stack_context allocate() { return pool->allocate(); }
+  void deallocate(boost::context::stack_context& sctx) noexcept {
+    pool->deallocate(sctx);
+  }
+};
+
+// A CPU that a worker may run on.
+struct cpu_t {
+  int id = -1;    // Not pinned if negative.
+  int node = -1;  // NUMA node; unknown if negative.
+};
+
+int get_numa_node(int cpu) {
+  const string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  int node = -1;
+  if (auto dir = opendir(path.c_str())) {
+    while (auto entry = readdir(dir)) {
+      if (starts_with(entry->d_name, "node")) {
+        node = atoi(entry->d_name + 4);
+        break;
       }
     }
-    this->add_worker(worker_count);
-    it = workers.begin();
+    closedir(dir);
   }
+  return node;
+}
 
-  void add_worker(size_t count = 1) {
-    unique_lock lock(this->worker_mtx);
-    for (size_t i = 0; i < count; ++i) {
-      this->workers.emplace_back();
+// Returns CPUs that workers should be pinned to, ordered by NUMA node so that
+// consecutive workers share a node. Workers are pinned only if environment
+// variable `TAPA_PIN_WORKERS` is set to a non-zero value.
+vector<cpu_t> get_worker_cpus() {
+  vector<cpu_t> cpus;
+  auto env = getenv("TAPA_PIN_WORKERS");
+  if (env == nullptr || atoi(env) == 0) return cpus;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    throw runtime_error(std::strerror(errno));
+  }
+  for (int i = 0; i < CPU_SETSIZE; ++i) {
+    if (CPU_ISSET(i, &cpu_set)) {
+      cpu_t cpu;
+      cpu.id = i;
+      cpu.node = get_numa_node(i);
+      cpus.push_back(cpu);
     }
   }
+  std::stable_sort(
+      cpus.begin(), cpus.end(),
+      [](const cpu_t& lhs, const cpu_t& rhs) { return lhs.node < rhs.node; });
+  return cpus;
+}
 
-  void add_task(bool detach, const function<void()>& f) {
-    unique_lock lock(this->worker_mtx);
-    it->add_task(detach, f);
-    ++it;
-    if (it == this->workers.end()) it = this->workers.begin();
-  }
+// How coroutines are assigned to workers, which can be set via environment
+// variable `TAPA_SCHEDULE_POLICY`.
+enum class schedule_policy {
+  // Coroutines are assigned round-robin and idle workers steal runnable
+  // coroutines from their peers.
+  kWorkStealing,
+  // Coroutines sharing channels are assigned to the same worker when tasks are
+  // invoked, and are never migrated afterwards.
+  kPartitioned,
+  // Coroutines are resumed one at a time in round-robin order by the thread
+  // waiting for the top-level task, so that the interleaving of tasks is
+  // reproducible. `TAPA_CONCURRENCY` is ignored, dedicated threads run as
+  // coroutines as well, and the task deque and channels skip locks and fences
+  // since no other thread accesses them.
+  kDeterministic,
+};
 
-  void wait() {
-    for (auto& w : this->workers) w.wait();
+schedule_policy get_schedule_policy() {
+  auto env = getenv("TAPA_SCHEDULE_POLICY");
+  if (env == nullptr || strcmp(env, "work-stealing") == 0) {
+    return schedule_policy::kWorkStealing;
   }
-
-  void send(int signal) {
-    for (auto& worker : this->workers) worker.send(signal);
+  if (strcmp(env, "partitioned") == 0) return schedule_policy::kPartitioned;
+  if (strcmp(env, "deterministic") == 0) {
+    return schedule_policy::kDeterministic;
   }
+  throw runtime_error(string("invalid TAPA_SCHEDULE_POLICY: ") + env);
+}
 
-  ~thread_pool() {
-    unique_lock lock(this->worker_mtx);
-    this->workers.clear();
-  }
+// Returns the path that a timeline of coroutines is written to when the
+// top-level task finishes, which can be set via environment variable
+// `TAPA_TRACE`, or nullptr if coroutines are not traced. The timeline is in
+// the Chrome trace format, which chrome://tracing and Perfetto open.
+const char* get_trace_path() {
+  static const char* path = getenv("TAPA_TRACE");
+  return path;
+}
+
+// Returns the period in milliseconds at which the states of coroutines are
+// sampled, which can be set via environment variable `TAPA_SAMPLE_MS`, or 0 if
+// coroutines are not sampled. Unlike SIGINT, sampling does not interrupt
+// coroutines.
+int get_sample_period_ms() {
+  static const int period_ms = [] {
+    const char* env = getenv("TAPA_SAMPLE_MS");
+    return env != nullptr ? std::max(atoi(env), 0) : 0;
+  }();
+  return period_ms;
+}
+
+// Returns the path that samples are written to, which can be set via
+// environment variable `TAPA_SAMPLE_OUTPUT`. Samples are aggregated into
+// folded stacks, i.e., a `task;state count` line per task and state, which
+// flamegraph.pl and speedscope open.
+const char* get_sample_path() {
+  static const char* path = [] {
+    const char* env = getenv("TAPA_SAMPLE_OUTPUT");
+    return env != nullptr ? env : "tapa-samples.folded";
+  }();
+  return path;
+}
+
+// A slice of time during which a coroutine runs on a worker.
+struct trace_event {
+  uint64_t coroutine_id;
+  bool detach;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+  uint64_t op_count;  // Channel operations done in the slice.
+  string channel;     // Channel that the coroutine yields on, if any.
 };
 
-thread_pool* pool = nullptr;
-const task* top_task = nullptr;
-mutex mtx;
+// Keeps the latest events recorded by a worker, dropping the oldest ones once
+// full.
+class trace_buffer {
+  static constexpr size_t kCapacity = 1 << 20;
 
-// How the signal handler works:
-//
-// 1. The main thread receives the signal;
-// 2. Each worker sets `this->signal`;
-// 3. Each worker prints debug info in next iteration of coroutines;
-// 4. Each worker clears `this->signal`.
-constexpr int64_t kSignalThreshold = 500 * 1000 * 1000;  // 500 ms
-int64_t last_signal_timestamp = 0;
-void signal_handler(int signal) {
-  if (signal == SIGINT) {
-    const int64_t signal_timestamp = get_time_ns();
-    if (last_signal_timestamp != 0 &&
-        signal_timestamp - last_signal_timestamp < kSignalThreshold) {
-      LOG(INFO) << "caught SIGINT twice in " << kSignalThreshold / 1000000
-                << " ms; exit";
-      exit(EXIT_FAILURE);
+  vector<trace_event> events;
+  size_t next = 0;  // Where the oldest event is once full.
+
+ public:
+  uint64_t dropped = 0;
+
+  void add(trace_event&& event) {
+    if (this->events.size() < kCapacity) {
+      this->events.push_back(std::move(event));
+      return;
     }
-    LOG(INFO) << "caught SIGINT";
-    last_signal_timestamp = signal_timestamp;
-    pool->send(signal);
-  } else {
-    last_signal_timestamp = get_time_ns();
+    this->events[this->next] = std::move(event);
+    this->next = (this->next + 1) % kCapacity;
+    ++this->dropped;
   }
-}
 
-}  // namespace
+  // Calls `f` on each event from the oldest to the latest.
+  template <typename Func>
+  void for_each(Func&& f) const {
+    for (size_t i = this->next; i < this->events.size(); ++i) f(events[i]);
+    for (size_t i = 0; i < this->next; ++i) f(events[i]);
+  }
+};
 
-void schedule(bool detach, const function<void()>& f) {
-  pool->add_task(detach, f);
+// Returns whether the stats of tasks are logged when the top-level task
+// finishes, which is enabled by setting environment variable
+// `TAPA_TASK_STATS` to 1.
+bool is_task_stats_enabled() {
+  static const bool enabled = [] {
+    const char* env = getenv("TAPA_TASK_STATS");
+    return env != nullptr && strcmp(env, "1") == 0;
+  }();
+  return enabled;
 }
 
-}  // namespace internal
-
-task::task() {
-  unique_lock lock(internal::mtx);
-  if (internal::pool == nullptr) {
-    internal::pool = new internal::thread_pool;
-    internal::top_task = this;
-  }
+uint64_t get_thread_cpu_time_ns() {
+  timespec tp;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tp);
+  return static_cast<uint64_t>(tp.tv_sec) * 1000000000 + tp.tv_nsec;
 }
 
-task::~task() {
-  if (this == internal::top_task) {
-    internal::pool->wait();
-    unique_lock lock(internal::mtx);
-    delete internal::pool;
-    internal::pool = nullptr;
-  }
+// Counters of the instances of a task.
+struct task_stats {
+  uint64_t instances = 0;
+  uint64_t resumes = 0;        // Times that the task is resumed.
+  uint64_t empty_resumes = 0;  // Resumes without any channel operation.
+  uint64_t cpu_ns = 0;         // CPU time spent running the task.
+};
+
+// Stats of finished task instances, keyed by their name and function.
+struct {
+  mutex mtx;
+  std::map<std::pair<string, const void*>, task_stats> entries;
+} task_stats_registry;
+
+void record_task_stats(const task_id& id, const task_stats& stats) {
+  unique_lock lock(task_stats_registry.mtx);
+  auto& entry = task_stats_registry.entries[{id.name, id.func}];
+  entry.instances += stats.instances;
+  entry.resumes += stats.resumes;
+  entry.empty_resumes += stats.empty_resumes;
+  entry.cpu_ns += stats.cpu_ns;
 }
 
-}  // namespace tapa
+class worker;
 
-#else  // TAPA_ENABLE_COROUTINE
+// Something that waits on channels, i.e., a coroutine or a dedicated thread.
+struct waiter {
+  // Called by `wait_list::notify_all` once the waiter is notified.
+  virtual void wake() = 0;
 
-namespace tapa {
-namespace internal {
+ protected:
+  ~waiter() = default;
+};
 
-void yield(const std::string& msg) { std::this_thread::yield(); }
+// Simulation of a top-level task, i.e., the tasks that the top-level task
+// instantiates directly or indirectly. Simulations started by different
+// threads share the thread pool but are joined separately; see `task::task`.
+struct simulation {
+  explicit simulation(const task* top) : top(top) {}
 
-namespace {
+  const task* const top;
 
-std::deque<std::thread>* threads = nullptr;
-const task* top_task = nullptr;
-int active_task_count = 0;
-std::mutex mtx;
+  // Number of non-detached coroutines and threads, guarded by
+  // `thread_pool::coroutine_mtx`.
+  size_t active_count = 0;
+};
 
-}  // namespace
+// A coroutine that can be resumed by any worker.
+//
+// How a coroutine waits on channels:
+//
+// 1. The coroutine yields on a channel that is not ready (e.g., an empty
+//    `istream`) and the channel is recorded in `polled`;
+// 2. If the coroutine yields on a channel that is already in `polled` without
+//    making progress, all channels it polls are in `polled`; the coroutine is
+//    added to the `wait_list` of each of them and polls them once more;
+// 3. If the coroutine still cannot make progress, it is parked and will not be
+//    resumed until any channel in `waiting` notifies it. A channel notifies
+//    its waiters when its state changes, or when the waiting coroutine itself
+//    finds it ready, which cancels parking.
+struct coroutine final : waiter {
+  enum : int { kRunning, kParked, kNotified };
 
-void schedule(bool detach, const std::function<void()>& f) {
-  if (detach) {
-    std::thread(f).detach();
-  } else {
-    std::unique_lock<std::mutex> lock(internal::mtx);
-    threads->emplace_back(f);
+  coroutine(bool detach, const task_id& task, thunk&& f, stack_pool& stacks)
+      : detach(detach),
+        task(task),
+        push(pooled_stack(stacks),
+             [this, f = std::move(f)](pull_type& handle) mutable {
+               this->pull = &handle;
+               f();
+             }) {}
+
+  const bool detach;
+  const task_id task;
+  uint64_t id = 0;            // Identifies the coroutine in the trace.
+  pull_type* pull = nullptr;  // Used by `yield` to suspend the coroutine.
+  push_type push;             // Used by workers to resume the coroutine.
+
+  std::shared_ptr<simulation> sim;  // Simulation that the coroutine is in.
+  worker* owner = nullptr;  // Worker that resumed the coroutine most recently.
+  coroutine* next = nullptr;  // Next coroutine in the inbox of a worker.
+  task_stats stats;         // Updated only if stats of tasks are enabled.
+  cycle_clock clock;        // Used only in cycle-approximate simulation.
+
+  // Members below are accessed only by the worker that resumes the coroutine,
+  // except that `state` is also updated by `wait_list::notify_all`.
+  std::atomic_int state{kRunning};
+  wait_list* blocked_on = nullptr;  // Channel that the coroutine yielded on.
+  uint64_t yield_op_count = 0;      // Value of `op_count` at the last yield.
+  uint64_t skipped_yields = 0;      // Yields skipped since it was resumed.
+  string blocked_on_name;           // Described for the trace only.
+
+  // Queue that the coroutine yielded on and why, and how many times resuming
+  // it has been deferred since; see `defer`.
+  const base_queue* blocked_queue = nullptr;
+  channel_state blocked_state = channel_state::kEmpty;
+  uint64_t deferrals = 0;
+
+  // Name of the channel that the coroutine yielded on, and whether it is full
+  // rather than empty; read by the sampler only.
+  std::atomic<const string*> sampled_channel{nullptr};
+  std::atomic_bool sampled_full{false};
+  vector<wait_list*> polled;        // Channels yielded on without progress.
+  vector<wait_list*> waiting;       // Channels that the coroutine waits on.
+
+  // Returns true if the coroutine is parked after it yields without progress.
+  bool park() {
+    auto channel = this->blocked_on;
+    if (channel == nullptr) return false;
+    if (std::find(polled.begin(), polled.end(), channel) == polled.end()) {
+      this->polled.push_back(channel);
+      return false;
+    }
+
+    bool is_waiting = true;
+    for (auto polled_channel : this->polled) {
+      if (std::find(waiting.begin(), waiting.end(), polled_channel) ==
+          waiting.end()) {
+        polled_channel->add(static_cast<waiter*>(this));
+        this->waiting.push_back(polled_channel);
+        is_waiting = false;
+      }
+    }
+    this->polled.assign(1, channel);
+    if (!is_waiting) return false;
+
+    int expected = kRunning;
+    return this->state.compare_exchange_strong(expected, kParked);
   }
-}
 
-}  // namespace internal
+  // Removes the coroutine from all channels it waits on.
+  void stop_waiting() {
+    for (auto channel : this->waiting) {
+      channel->remove(static_cast<waiter*>(this));
+    }
+    this->waiting.clear();
+    this->polled.clear();
+  }
 
-task::task() {
-  std::unique_lock<std::mutex> lock(internal::mtx);
-  ++internal::active_task_count;
-  if (internal::top_task == nullptr) {
-    internal::top_task = this;
+  // Returns true if resuming the coroutine should be deferred since the queue
+  // that it yielded on is still not ready, e.g., a producer of a full stream
+  // whose consumer has not run yet. A coroutine may poll other channels as
+  // well, so it is deferred up to `kMaxDeferrals` times in a row.
+  bool defer() {
+    constexpr uint64_t kMaxDeferrals = 4;
+    if (this->blocked_queue == nullptr || this->deferrals >= kMaxDeferrals ||
+        this->blocked_queue->is_ready(this->blocked_state)) {
+      return false;
+    }
+    ++this->deferrals;
+    return true;
+  }
+
+  void wake() override;
+};
+
+// A task that runs on its own thread instead of a coroutine, so that heavy
+// computation does not stall coroutines on the same worker. A blocked
+// dedicated thread waits like a coroutine, except that it sleeps on `cv`
+// instead of being parked.
+struct dedicated_thread : waiter {
+  mutex mtx;
+  condition_variable cv;
+  bool notified = false;  // Guarded by `mtx`.
+
+  uint64_t last_op_count = 0;
+  vector<wait_list*> waiting;  // Channels that the thread waits on.
+
+  // Called when `channel` is not ready.
+  void wait(wait_list* channel);
+
+  // Removes the thread from all channels it waits on.
+  void stop_waiting() {
+    for (auto channel : this->waiting) {
+      channel->remove(static_cast<waiter*>(this));
+    }
+    this->waiting.clear();
   }
-  if (internal::threads == nullptr) {
-    internal::threads = new std::deque<std::thread>;
+
+  void wake() override {
+    {
+      unique_lock lock(this->mtx);
+      this->notified = true;
+    }
+    this->cv.notify_one();
   }
+};
+
+thread_local coroutine* current_coroutine = nullptr;
+thread_local dedicated_thread* current_thread = nullptr;
+thread_local worker* current_worker = nullptr;
+thread_local bool debug = false;
+
+// Simulation of the top-level task invoked by this thread, or of the task run
+// by this dedicated thread.
+thread_local std::shared_ptr<simulation> current_simulation;
+
+// Returns the simulation that the caller is in, or null if it is about to
+// invoke a top-level task.
+const std::shared_ptr<simulation>& get_simulation() {
+  return current_coroutine != nullptr ? current_coroutine->sim
+                                      : current_simulation;
 }
+mutex debug_mtx;  // Print stacktrace one-by-one.
 
-task::~task() {
-  if (this == internal::top_task) {
-    for (;;) {
-      std::thread t;
-      {
-        std::unique_lock<std::mutex> lock(internal::mtx, std::defer_lock);
-        if (internal::active_task_count == 1 && lock.try_lock()) {
-          if (internal::threads->empty()) {
-            break;
-          }
-          t = std::move(internal::threads->front());
-          internal::threads->pop_front();
-        }
-      }
-      if (t.joinable()) {
-        t.join();
+class thread_pool;
+
+// Each worker owns a deque of runnable coroutines. The owner resumes
+// coroutines from the front and puts them back at the end, so coroutines on
+// the same worker are resumed round-robin; idle workers steal from the end of
+// their peers' deques. Other threads submit coroutines to a lock-free inbox
+// instead, which is moved to the end of the deque when the deque is accessed.
+class worker {
+  thread_pool* const pool;
+
+  std::deque<coroutine*> runnable;
+  mutex mtx;
+
+  // Coroutines submitted by other threads, the latest first, linked by
+  // `coroutine::next`.
+  std::atomic<coroutine*> inbox{nullptr};
+
+  // Number of coroutines in `runnable`, readable without locking `mtx`.
+  std::atomic<size_t> size{0};
+
+  std::atomic_int signal{0};
+  std::thread thread;
+
+  // Value of `op_count` on the worker thread, readable by other threads.
+  std::atomic<uint64_t> progress{0};
+
+  // Written by the worker thread only if coroutines are traced.
+  trace_buffer trace;
+
+  // Coroutine being resumed, set only if coroutines are sampled.
+  std::atomic<const coroutine*> running{nullptr};
+
+  // Number of coroutines to resume in debug mode.
+  size_t debug_count = 0;
+
+ public:
+  const cpu_t cpu;
+
+  // Number of unfinished coroutines assigned to this worker; maintained by
+  // `thread_pool` only if coroutines are partitioned.
+  size_t load = 0;
+
+  // If true, this worker is the only one and is run by the thread waiting for
+  // the top-level task, so `runnable` is accessed without locking.
+  const bool sequential;
+
+  worker(thread_pool* pool, const cpu_t& cpu, bool sequential)
+      : pool(pool), cpu(cpu), sequential(sequential) {}
+
+  // Runs `run` on a new thread.
+  void start();
+
+  // Resumes runnable coroutines until the pool is destroyed.
+  void run();
+
+  // Resumes `c` once and pushes it back unless it finishes or is parked.
+  void resume(coroutine* c);
+
+  void push(coroutine* c) {
+    if (this->sequential) {
+      this->runnable.push_back(c);
+      this->size.store(this->runnable.size(), std::memory_order_relaxed);
+      return;
+    }
+    if (current_worker != this) {
+      c->next = this->inbox.load(std::memory_order_relaxed);
+      while (!this->inbox.compare_exchange_weak(c->next, c,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
       }
-      std::this_thread::yield();
+      this->notify_if_busy(this->size + 1);
+      return;
+    }
+    size_t new_size;
+    {
+      unique_lock lock(this->mtx);
+      this->drain_inbox();
+      this->runnable.push_back(c);
+      new_size = this->runnable.size();
+      this->size = new_size;
     }
-    internal::top_task = nullptr;
+    this->notify_if_busy(new_size);
   }
-  std::unique_lock<std::mutex> lock(internal::mtx);
-  --internal::active_task_count;
-}
 
-}  // namespace tapa
+  // Pops a coroutine from the front of `runnable`, which is used by the owner.
+  coroutine* pop() {
+    if (this->sequential) return this->pop_front();
+    if (this->size == 0 && !this->has_inbox()) return nullptr;
+    unique_lock lock(this->mtx);
+    this->drain_inbox();
+    return this->pop_front();
+  }
 
-#endif  // TAPA_ENABLE_COROUTINE
+  // Pops a coroutine from the back of `runnable`, which is used by thieves.
+  coroutine* steal() {
+    if (this->size == 0 && !this->has_inbox()) return nullptr;
+    unique_lock lock(this->mtx);
+    this->drain_inbox();
+    if (this->runnable.empty()) return nullptr;
+    auto c = this->runnable.back();
+    this->runnable.pop_back();
+    this->size = this->runnable.size();
+    return c;
+  }
 
-namespace tapa {
-namespace internal {
+  bool has_runnable() const { return this->size != 0 || this->has_inbox(); }
 
-void* allocate(size_t length) {
-  void* addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
-                      MAP_SHARED | MAP_ANONYMOUS, /*fd=*/-1, /*offset=*/0);
-  if (addr == MAP_FAILED) throw std::bad_alloc();
-  return addr;
-}
-void deallocate(void* addr, size_t length) {
-  if (::munmap(addr, length) != 0) throw std::bad_alloc();
-}
+  uint64_t get_progress() const {
+    return this->progress.load(std::memory_order_relaxed);
+  }
+
+  const coroutine* get_running() const {
+    return this->running.load(std::memory_order_relaxed);
+  }
+
+  void send(int signal) { this->signal = signal; }
+
+  // Joins the thread of this worker if it has started.
+  void join() {
+    if (this->thread.joinable()) this->thread.join();
+  }
+
+  // Must be called after `join`.
+  const trace_buffer& get_trace() const { return this->trace; }
+
+ private:
+  bool has_inbox() const {
+    return this->inbox.load(std::memory_order_relaxed) != nullptr;
+  }
+
+  // Pops the first coroutine in `runnable` that should not be deferred, or the
+  // last one if all of them should; the deferred ones are moved to the end.
+  // Must be called with `mtx` locked unless the worker is sequential.
+  coroutine* pop_front() {
+    if (this->runnable.empty()) return nullptr;
+    for (size_t n = this->runnable.size(); n > 1; --n) {
+      auto c = this->runnable.front();
+      if (!c->defer()) break;
+      this->runnable.pop_front();
+      this->runnable.push_back(c);
+    }
+    auto c = this->runnable.front();
+    this->runnable.pop_front();
+    this->size.store(this->runnable.size(), std::memory_order_relaxed);
+    return c;
+  }
+
+  // Moves the coroutines in `inbox` to the end of `runnable` in the order they
+  // were submitted. Must be called with `mtx` locked.
+  void drain_inbox() {
+    auto c = this->inbox.exchange(nullptr, std::memory_order_acquire);
+    if (c == nullptr) return;
+    const auto end = this->runnable.size();
+    for (; c != nullptr; c = c->next) this->runnable.push_back(c);
+    std::reverse(this->runnable.begin() + end, this->runnable.end());
+    this->size = this->runnable.size();
+  }
+
+  // Wakes up an idle worker if `runnable` has more coroutines than the owner
+  // can resume at once.
+  void notify_if_busy(size_t size);
+};
+
+void signal_handler(int signal);
+
+class thread_pool {
+  std::list<worker> workers;
+  vector<worker*> worker_ptrs;  // Indexed by `next_worker` without locking.
+  std::atomic<size_t> next_worker{0};
+
+  stack_pool& stacks = get_stack_pool();
+
+  const schedule_policy policy = get_schedule_policy();
+
+  // If true, coroutines are never migrated among workers.
+  const bool partitioned = this->policy == schedule_policy::kPartitioned;
+
+  // If true, coroutines are resumed by the thread that calls `wait` only.
+  const bool deterministic = this->policy == schedule_policy::kDeterministic;
+
+  // Channels that only one endpoint has been placed, mapped to the worker of
+  // that endpoint. Guarded by `placement_mtx`, as is `worker::load`.
+  mutex placement_mtx;
+  unordered_map<const void*, worker*> placement;
+  size_t total_load = 0;
+
+  // Idle workers wait on `idle_cv` until some coroutines become runnable.
+  mutex idle_mtx;
+  condition_variable idle_cv;
+  std::atomic<size_t> idle_count{0};
+  std::atomic_bool done{false};
+
+  // Number of workers whose threads have started, which are the first ones in
+  // `worker_ptrs`. Unless coroutines are partitioned, the pool starts with one
+  // worker and starts another whenever coroutines become runnable while no
+  // worker is idle, so that the pool grows with the runnable coroutines up to
+  // `TAPA_CONCURRENCY` workers and idle workers sleep instead of spinning.
+  // Guarded by `start_mtx` for writing.
+  std::atomic<size_t> started_count{0};
+  mutex start_mtx;
+
+  // Tracks all coroutines that are not finished yet.
+  mutex coroutine_mtx;
+  unordered_set<coroutine*> coroutines;
+  condition_variable wait_cv;
+
+  // Dedicated threads, and the number of them that are not blocked.
+  mutex thread_mtx;
+  std::list<std::thread> threads;
+  std::atomic<size_t> busy_thread_count{0};
+
+  // Set by the signal handler so that parked coroutines are resumed to print
+  // debug info.
+  std::atomic_bool signaled{false};
+
+  // Numbers coroutines in the trace, which starts at `start_ns`.
+  std::atomic<uint64_t> coroutine_count{0};
+  const uint64_t start_ns = get_time_ns();
+
+  // Number of times that each task is found in each state by the sampler.
+  std::map<std::tuple<string, const void*, string>, uint64_t> samples;
+  mutex sample_mtx;
+  condition_variable sample_cv;
+  std::thread sampler;
+
+ public:
+  thread_pool(size_t worker_count = 0) {
+    signal(SIGINT, signal_handler);
+    if (this->deterministic) {
+      is_sequential = true;
+      this->add_worker();
+      this->started_count = 1;  // Runs on the thread that calls `wait`.
+      if (get_sample_period_ms() > 0) {
+        this->sampler = std::thread([this] { this->run_sampler(); });
+      }
+      return;
+    }
+    if (worker_count == 0) {
+      if (auto concurrency = getenv("TAPA_CONCURRENCY")) {
+        worker_count = atoi(concurrency);
+      } else {
+        worker_count = std::thread::hardware_concurrency();
+      }
+    }
+    this->add_worker(std::max<size_t>(worker_count, 1));
+    // Workers are all created before any starts so that thieves can iterate
+    // over `workers` without locking.
+    this->start_workers(this->partitioned ? this->workers.size() : 1);
+    if (get_sample_period_ms() > 0) {
+      this->sampler = std::thread([this] { this->run_sampler(); });
+    }
+  }
+
+  void add_task(bool detach, thunk&& f, const vector<channel_t>& channels,
+                const task_id& id) {
+    auto c = new coroutine(detach, id, std::move(f), this->stacks);
+    c->id = ++this->coroutine_count;
+    c->sim = get_simulation();
+    TAPA_PROBE(task_spawn, c->id, id.name, int(detach));
+    {
+      unique_lock lock(this->coroutine_mtx);
+      this->coroutines.insert(c);
+      if (!detach) ++c->sim->active_count;
+    }
+    if (this->partitioned) {
+      c->owner = this->place(channels);
+    } else {
+      const size_t idx =
+          this->next_worker.fetch_add(1, std::memory_order_relaxed);
+      c->owner = this->worker_ptrs[idx % this->started_count];
+    }
+    c->owner->push(c);
+    this->notify();
+  }
+
+  // Runs a non-detached task on a dedicated thread, or as a coroutine if
+  // coroutines are deterministic.
+  void add_thread(thunk&& f, const task_id& id) {
+    if (this->deterministic) {
+      this->add_task(/*detach=*/false, std::move(f), {}, id);
+      return;
+    }
+    auto sim = get_simulation();
+    {
+      unique_lock lock(this->coroutine_mtx);
+      ++sim->active_count;
+    }
+    ++this->busy_thread_count;
+    unique_lock lock(this->thread_mtx);
+    this->threads.emplace_back([this, id, sim, f = std::move(f)]() mutable {
+      dedicated_thread self;
+      current_thread = &self;
+      current_simulation = sim;
+      TAPA_PROBE(task_spawn, 0, id.name, 0);
+      f();
+      TAPA_PROBE(task_finish, 0, id.name);
+      if (is_task_stats_enabled()) {
+        task_stats stats;
+        stats.instances = stats.resumes = 1;
+        stats.cpu_ns = get_thread_cpu_time_ns();
+        record_task_stats(id, stats);
+      }
+      self.stop_waiting();
+      current_thread = nullptr;
+      current_simulation = nullptr;
+      --this->busy_thread_count;
+      unique_lock lock(this->coroutine_mtx);
+      if (--sim->active_count == 0) this->wait_cv.notify_all();
+    });
+  }
+
+  // Marks a dedicated thread as blocked or not.
+  void block_thread() { --this->busy_thread_count; }
+  void unblock_thread() { ++this->busy_thread_count; }
+
+  // Makes a parked coroutine runnable again. If it is woken up by another
+  // coroutine, e.g., its peer writes to a stream that it reads, it is moved to
+  // the worker of the peer so that coroutines sharing streams are co-located,
+  // unless they are on different NUMA nodes or coroutines are partitioned.
+  void wake(coroutine* c) {
+    if (c->state.exchange(coroutine::kNotified) == coroutine::kParked) {
+      auto w = current_worker;
+      if (w == nullptr || w->cpu.node != c->owner->cpu.node ||
+          this->partitioned) {
+        w = c->owner;
+      }
+      c->owner = w;
+      w->push(c);
+      this->notify();
+    }
+  }
+
+  // Steals a runnable coroutine from workers other than `thief`, preferring
+  // workers on the same NUMA node. Returns nullptr if coroutines are
+  // partitioned.
+  coroutine* steal(const worker* thief) {
+    if (this->partitioned) return nullptr;
+    for (bool same_node : {true, false}) {
+      for (auto& w : this->workers) {
+        if (&w == thief || (w.cpu.node == thief->cpu.node) != same_node) {
+          continue;
+        }
+        if (auto c = w.steal()) return c;
+      }
+    }
+    return nullptr;
+  }
+
+  // Blocks until some coroutines become runnable by `w`. Returns false if the
+  // pool is being destroyed.
+  bool idle(const worker* w) {
+    unique_lock lock(this->idle_mtx);
+    ++this->idle_count;
+    this->idle_cv.wait(lock, [this, w] {
+      if (this->done) return true;
+      if (this->partitioned) return w->has_runnable();
+      for (auto& peer : this->workers) {
+        if (peer.has_runnable()) return true;
+      }
+      return false;
+    });
+    --this->idle_count;
+    return !this->done;
+  }
+
+  // Wakes up an idle worker, or starts one if none is idle. If coroutines are
+  // partitioned, only the owner can resume them, so all idle workers are woken
+  // up.
+  void notify() {
+    if (this->idle_count != 0) {
+      { unique_lock lock(this->idle_mtx); }
+      if (this->partitioned) {
+        this->idle_cv.notify_all();
+      } else {
+        this->idle_cv.notify_one();
+      }
+    } else if (this->started_count < this->workers.size()) {
+      this->start_workers(this->started_count + 1);
+    }
+  }
+
+  bool is_done() const { return this->done; }
+  bool is_deterministic() const { return this->deterministic; }
+
+  // Returns the total number of channel operations done by workers.
+  uint64_t get_progress() const {
+    uint64_t progress = 0;
+    for (auto& w : this->workers) progress += w.get_progress();
+    return progress;
+  }
+
+  // Returns true if all coroutines are parked, all workers are idle, and all
+  // dedicated threads are blocked.
+  bool is_stalled() const {
+    if (this->idle_count != this->started_count) return false;
+    if (this->busy_thread_count != 0) return false;
+    for (auto& w : this->workers) {
+      if (w.has_runnable()) return false;
+    }
+    return true;
+  }
+  bool is_partitioned() const { return this->partitioned; }
+
+  void finish(coroutine* c) {
+    TAPA_PROBE(task_finish, c->id, c->task.name);
+    c->stop_waiting();
+    if (is_task_stats_enabled()) record_task_stats(c->task, c->stats);
+    if (this->partitioned) {
+      unique_lock lock(this->placement_mtx);
+      --c->owner->load;
+      --this->total_load;
+    }
+    {
+      unique_lock lock(this->coroutine_mtx);
+      this->coroutines.erase(c);
+      if (!c->detach && --c->sim->active_count == 0) {
+        this->wait_cv.notify_all();
+      }
+    }
+    delete c;
+  }
+
+  // Blocks until all non-detached coroutines and threads of `sim` finish. If
+  // no coroutine of any simulation makes progress for `kDeadlockRounds`
+  // rounds, the coroutines are dumped as if SIGINT were caught, and the
+  // process exits after another `kDeadlockRounds` rounds.
+  void wait(const simulation& sim) {
+    if (this->deterministic) {
+      this->run_sequentially(sim);
+      return;
+    }
+    constexpr int kDeadlockRounds = 10;
+    int stalled_rounds = 0;
+    bool is_deadlocked = false;
+    uint64_t last_progress = this->get_progress();
+    unique_lock lock(this->coroutine_mtx);
+    while (!this->wait_cv.wait_for(lock, std::chrono::milliseconds(100),
+                                   [&sim] { return sim.active_count == 0; })) {
+      if (this->signaled.exchange(false)) {
+        for (auto c : this->coroutines) this->wake(c);
+        stalled_rounds = 0;
+        continue;
+      }
+
+      const uint64_t progress = this->get_progress();
+      if (progress == last_progress && this->is_stalled()) {
+        ++stalled_rounds;
+      } else {
+        stalled_rounds = 0;
+      }
+      last_progress = progress;
+
+      if (stalled_rounds >= kDeadlockRounds) {
+        if (is_deadlocked) {
+          LOG(ERROR) << "deadlock detected; exit";
+          exit(EXIT_FAILURE);
+        }
+        LOG(ERROR) << "deadlock detected: " << sim.active_count
+                   << " task(s) cannot make progress; blocked tasks:";
+        is_deadlocked = true;
+        this->send(SIGINT);
+      }
+    }
+  }
+
+  // Resumes a runnable coroutine on this thread if coroutines are
+  // deterministic; returns false otherwise.
+  bool resume_once() {
+    if (!this->deterministic) return false;
+    auto& w = this->workers.front();
+    current_worker = &w;
+    if (auto c = w.pop()) w.resume(c);
+    current_worker = nullptr;
+    return true;
+  }
+
+  void send(int signal) {
+    for (auto& worker : this->workers) worker.send(signal);
+    this->signaled = true;
+  }
+
+  ~thread_pool() {
+    {
+      // No worker starts after this.
+      unique_lock start_lock(this->start_mtx);
+      unique_lock lock(this->idle_mtx);
+      this->done = true;
+    }
+    this->idle_cv.notify_all();
+    {
+      unique_lock lock(this->sample_mtx);
+      this->sample_cv.notify_all();
+    }
+    if (this->sampler.joinable()) {
+      this->sampler.join();
+      this->write_samples(get_sample_path());
+    }
+    if (!this->deterministic) {
+      for (auto& w : this->workers) w.join();
+    }
+    for (auto& t : this->threads) t.join();
+    if (auto path = get_trace_path()) this->write_trace(path);
+
+    // Destroy detached coroutines that are still running. Channels may be
+    // destroyed with any coroutine, so stop waiting before destroying them.
+    for (auto c : this->coroutines) {
+      c->stop_waiting();
+      if (is_task_stats_enabled()) record_task_stats(c->task, c->stats);
+    }
+    for (auto c : this->coroutines) delete c;
+    is_sequential = false;
+  }
+
+ private:
+  // Resumes coroutines on this thread until all non-detached ones of `sim`
+  // finish. If none is runnable before then, the coroutines are dumped as if
+  // SIGINT were caught, and the process exits if none is runnable again.
+  void run_sequentially(const simulation& sim) {
+    auto& w = this->workers.front();
+    current_worker = &w;
+    bool is_deadlocked = false;
+    while (sim.active_count != 0) {
+      if (this->signaled.load(std::memory_order_relaxed) &&
+          this->signaled.exchange(false)) {
+        for (auto c : this->coroutines) this->wake(c);
+      }
+      if (auto c = w.pop()) {
+        w.resume(c);
+        continue;
+      }
+      if (is_deadlocked) {
+        LOG(ERROR) << "deadlock detected; exit";
+        exit(EXIT_FAILURE);
+      }
+      LOG(ERROR) << "deadlock detected: " << sim.active_count
+                 << " task(s) cannot make progress; blocked tasks:";
+      is_deadlocked = true;
+      this->send(SIGINT);
+    }
+    current_worker = nullptr;
+  }
+
+  // Places a coroutine that accesses `channels` with linear deterministic
+  // greedy (LDG) streaming graph partitioning. Each worker is scored by the
+  // channels shared with coroutines already placed on it, weighted by the
+  // inverse of channel depth since shallow channels switch more often, and
+  // penalized by its load so that workers stay balanced.
+  worker* place(const vector<channel_t>& channels) {
+    unique_lock lock(this->placement_mtx);
+    unordered_map<worker*, double> affinity;
+    for (auto& channel : channels) {
+      auto found = this->placement.find(channel.id);
+      if (found != this->placement.end()) {
+        affinity[found->second] += 1. / std::max<uint64_t>(channel.depth, 1);
+      }
+    }
+
+    const double capacity =
+        static_cast<double>(this->total_load) / this->workers.size() + 1;
+    worker* best = nullptr;
+    double best_score = 0;
+    for (auto& w : this->workers) {
+      const double score = affinity[&w] * (1 - w.load / capacity);
+      if (best == nullptr || score > best_score ||
+          (score == best_score && w.load < best->load)) {
+        best = &w;
+        best_score = score;
+      }
+    }
+
+    // Each channel has two endpoints; forget it once both are placed.
+    for (auto& channel : channels) {
+      auto found = this->placement.find(channel.id);
+      if (found == this->placement.end()) {
+        this->placement.emplace(channel.id, best);
+      } else {
+        this->placement.erase(found);
+      }
+    }
+    ++best->load;
+    ++this->total_load;
+    return best;
+  }
+
+  // Writes the slices recorded by workers to `path`. Each coroutine is a
+  // thread in the trace, with its running slices and the suspensions between
+  // them, which are named after the channel that it yields on.
+  void write_trace(const char* path) const {
+    std::ofstream file(path);
+    if (!file) {
+      LOG(WARNING) << "cannot write trace to " << path;
+      return;
+    }
+
+    // Coroutines may migrate among workers, so suspensions are found after
+    // the slices of all workers are sorted.
+    vector<std::pair<const trace_event*, int>> events;  // With worker index.
+    uint64_t dropped = 0;
+    int worker_idx = 0;
+    for (auto& w : this->workers) {
+      dropped += w.get_trace().dropped;
+      w.get_trace().for_each([&](const trace_event& event) {
+        events.emplace_back(&event, worker_idx);
+      });
+      ++worker_idx;
+    }
+    std::sort(events.begin(), events.end(),
+              [](const auto& lhs, const auto& rhs) {
+                return lhs.first->begin_ns < rhs.first->begin_ns;
+              });
+
+    auto escape = [](const string& str) {
+      string escaped;
+      for (char c : str) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+      }
+      return escaped;
+    };
+    auto to_us = [this](uint64_t ns) { return (ns - this->start_ns) / 1e3; };
+    file << std::fixed << std::setprecision(3) << R"({"traceEvents":[)";
+    const char* sep = "\n";
+    unordered_map<uint64_t, const trace_event*> last_events;
+    for (auto& entry : events) {
+      const trace_event& event = *entry.first;
+      const uint64_t tid = event.coroutine_id;
+      auto& last = last_events[tid];
+      if (last == nullptr) {
+        file << sep << R"({"name":"thread_name","ph":"M","pid":0,"tid":)"
+             << tid << R"(,"args":{"name":")"
+             << (event.detach ? "service #" : "task #") << tid << R"("}})";
+        sep = ",\n";
+      } else {
+        file << sep << R"({"name":")"
+             << (last->channel.empty() ? "yield"
+                                       : "wait " + escape(last->channel))
+             << R"(","cat":"suspend","ph":"X","pid":0,"tid":)" << tid
+             << R"(,"ts":)" << to_us(last->end_ns)
+             << R"(,"dur":)" << (event.begin_ns - last->end_ns) / 1e3 << "}";
+      }
+      file << sep << R"({"name":"run","cat":"run","ph":"X","pid":0,"tid":)"
+           << tid << R"(,"ts":)" << to_us(event.begin_ns)
+           << R"(,"dur":)" << (event.end_ns - event.begin_ns) / 1e3
+           << R"(,"args":{"worker":)" << entry.second
+           << R"(,"ops":)" << event.op_count << "}}";
+      last = &event;
+    }
+    file << "\n]}\n";
+
+    if (dropped != 0) {
+      LOG(WARNING) << dropped << " oldest trace event(s) are dropped";
+    }
+    LOG(INFO) << "trace of " << last_events.size()
+              << " coroutine(s) written to " << path;
+  }
+
+  // Samples the state of each coroutine every `TAPA_SAMPLE_MS` milliseconds
+  // until the pool is destroyed, and writes the samples every 10 seconds so
+  // that long simulations can be inspected while they run. Dedicated threads
+  // are not sampled.
+  void run_sampler() {
+    constexpr auto kWritePeriod = std::chrono::seconds(10);
+    const auto period = std::chrono::milliseconds(get_sample_period_ms());
+    auto last_write = std::chrono::steady_clock::now();
+    unique_lock lock(this->sample_mtx);
+    while (!this->sample_cv.wait_for(lock, period,
+                                     [this] { return this->is_done(); })) {
+      this->sample();
+      const auto now = std::chrono::steady_clock::now();
+      if (now - last_write >= kWritePeriod) {
+        this->write_samples(get_sample_path());
+        last_write = now;
+      }
+    }
+  }
+
+  // Records whether each coroutine is running, waiting on a channel, or
+  // runnable otherwise, e.g., not started or yielded without a channel.
+  void sample() {
+    unordered_set<const coroutine*> running;
+    for (auto& w : this->workers) running.insert(w.get_running());
+    unique_lock lock(this->coroutine_mtx);
+    for (auto c : this->coroutines) {
+      string state = "runnable";
+      if (running.count(c)) {
+        state = "run";
+      } else if (auto channel = c->sampled_channel.load()) {
+        state = "wait " + *channel + (c->sampled_full ? " (full)" : " (empty)");
+      }
+      ++this->samples[{c->task.name, c->task.func, std::move(state)}];
+    }
+  }
+
+  // Writes the samples to `path` as folded stacks.
+  void write_samples(const char* path) {
+    std::ofstream file(path);
+    if (!file) {
+      LOG(WARNING) << "cannot write samples to " << path;
+      return;
+    }
+    std::map<std::pair<string, const void*>, string> names;
+    for (auto& entry : this->samples) {
+      const auto& task = std::get<0>(entry.first);
+      const auto func = std::get<1>(entry.first);
+      auto& name = names[{task, func}];
+      if (name.empty()) name = get_task_name(task, func);
+      string state = std::get<2>(entry.first);
+      std::replace(state.begin(), state.end(), ';', ':');
+      file << name << ";" << state << " " << entry.second << "\n";
+    }
+  }
+
+  // Starts workers until `count` of them have started.
+  void start_workers(size_t count) {
+    unique_lock lock(this->start_mtx);
+    for (size_t i = this->started_count; i < count && !this->done; ++i) {
+      this->worker_ptrs[i]->start();
+      ++this->started_count;
+    }
+  }
+
+  void add_worker(size_t count = 1) {
+    const auto cpus = get_worker_cpus();
+    for (size_t i = 0; i < count; ++i) {
+      this->workers.emplace_back(
+          this, cpus.empty() ? cpu_t() : cpus[workers.size() % cpus.size()],
+          this->deterministic);
+      this->worker_ptrs.push_back(&this->workers.back());
+    }
+  }
+};
+
+void worker::start() {
+  this->thread = std::thread([this]() {
+    current_worker = this;
+    this->run();
+  });
+  if (this->cpu.id >= 0) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(this->cpu.id, &cpu_set);
+    if (int err = pthread_setaffinity_np(this->thread.native_handle(),
+                                         sizeof(cpu_set), &cpu_set)) {
+      LOG(WARNING) << "cannot pin worker to CPU " << this->cpu.id << ": "
+                   << std::strerror(err);
+    }
+  }
+}
+
+void worker::run() {
+  while (!this->pool->is_done()) {
+    auto c = this->pop();
+    if (c == nullptr) c = this->pool->steal(this);
+    if (c == nullptr) {
+      if (!this->pool->idle(this)) break;
+      continue;
+    }
+    this->resume(c);
+  }
+}
+
+void worker::resume(coroutine* c) {
+  if (this->signal) {
+    debug = true;
+    this->debug_count = this->size + 1;
+    this->signal = 0;
+  }
+
+  c->owner = this;
+  if (c->state.exchange(coroutine::kRunning) == coroutine::kNotified) {
+    c->stop_waiting();
+  }
+  const auto last_op_count = op_count;
+  const uint64_t begin_ns = get_trace_path() ? get_time_ns() : 0;
+  const uint64_t begin_cpu_ns =
+      is_task_stats_enabled() ? get_thread_cpu_time_ns() : 0;
+  c->blocked_on = nullptr;
+  c->blocked_on_name.clear();
+  c->blocked_queue = nullptr;
+  c->deferrals = 0;
+  c->yield_op_count = op_count;
+  c->skipped_yields = 0;
+  if (get_sample_period_ms() > 0) {
+    c->sampled_channel.store(nullptr, std::memory_order_relaxed);
+    this->running.store(c, std::memory_order_relaxed);
+  }
+  current_coroutine = c;
+  TAPA_PROBE(coroutine_resume, c->id, c->task.name);
+  c->push();
+  current_coroutine = nullptr;
+  if (get_sample_period_ms() > 0) {
+    this->running.store(nullptr, std::memory_order_relaxed);
+  }
+  if (is_task_stats_enabled()) {
+    c->stats.instances = 1;
+    ++c->stats.resumes;
+    if (op_count == last_op_count && c->push) ++c->stats.empty_resumes;
+    c->stats.cpu_ns += get_thread_cpu_time_ns() - begin_cpu_ns;
+  }
+  if (get_trace_path()) {
+    this->trace.add({c->id, c->detach, begin_ns, get_time_ns(),
+                     op_count - last_op_count,
+                     std::move(c->blocked_on_name)});
+  }
+
+  if (debug && --this->debug_count == 0) debug = false;
+
+  if (!c->push) {
+    this->pool->finish(c);
+  } else if (op_count != last_op_count) {
+    // The coroutine made progress.
+    this->progress.store(op_count, std::memory_order_relaxed);
+    c->stop_waiting();
+    this->push(c);
+  } else if (!c->park()) {
+    this->push(c);
+  }
+}
+
+void worker::notify_if_busy(size_t size) {
+  if (size > 1 && !this->pool->is_partitioned()) this->pool->notify();
+}
+
+thread_pool* pool = nullptr;
+std::atomic_bool is_pool_alive{false};
+
+void coroutine::wake() { pool->wake(this); }
+
+void dedicated_thread::wait(wait_list* channel) {
+  if (op_count != this->last_op_count) {
+    // The thread made progress since it waited last time.
+    this->last_op_count = op_count;
+    this->stop_waiting();
+  }
+  if (std::find(this->waiting.begin(), this->waiting.end(), channel) ==
+      this->waiting.end()) {
+    // Poll once more after being added so that no notification is lost.
+    channel->add(static_cast<waiter*>(this));
+    this->waiting.push_back(channel);
+    return;
+  }
+  {
+    unique_lock lock(this->mtx);
+    pool->block_thread();
+    this->cv.wait(lock, [this] { return this->notified; });
+    pool->unblock_thread();
+    this->notified = false;
+  }
+  this->stop_waiting();
+}
+
+size_t simulation_count = 0;  // Guarded by `mtx`.
+condition_variable simulation_cv;
+mutex mtx;
+
+// How the signal handler works:
+//
+// 1. The main thread receives the signal;
+// 2. Each worker sets `this->signal` and parked coroutines are resumed;
+// 3. Each worker prints debug info in next iteration of coroutines;
+// 4. Each worker clears `this->signal`.
+constexpr int64_t kSignalThreshold = 500 * 1000 * 1000;  // 500 ms
+int64_t last_signal_timestamp = 0;
+void signal_handler(int signal) {
+  if (signal == SIGINT) {
+    const int64_t signal_timestamp = get_time_ns();
+    if (last_signal_timestamp != 0 &&
+        signal_timestamp - last_signal_timestamp < kSignalThreshold) {
+      LOG(INFO) << "caught SIGINT twice in " << kSignalThreshold / 1000000
+                << " ms; exit";
+      exit(EXIT_FAILURE);
+    }
+    LOG(INFO) << "caught SIGINT";
+    last_signal_timestamp = signal_timestamp;
+    pool->send(signal);
+  } else {
+    last_signal_timestamp = get_time_ns();
+  }
+}
+
+}  // namespace
+
+void wait_list::notify_all() {
+  std::unique_lock<std::mutex> lock(this->mtx);
+  for (auto w : this->waiters) static_cast<waiter*>(w)->wake();
+  this->waiters.clear();
+  this->has_waiters = false;
+}
+
+namespace {
+
+void print_debug_info(const string& msg) {
+  unique_lock l(debug_mtx);
+  LOG(INFO) << msg;
+#if TAPA_ENABLE_STACKTRACE
+  for (auto& frame : boost::stacktrace::stacktrace()) {
+    const auto line = frame.source_line();
+    const auto file = frame.source_file();
+    auto name = frame.name();
+    if (line == 0 || file == __FILE__ ||
+        // Ignore STL functions.
+        starts_with(name, "void std::") || starts_with(name, "std::") ||
+        // Ignore TAPA channel functions.
+        ends_with(file, "/tapa/mmap.h") ||
+        ends_with(file, "/tapa/stream.h")) {
+      continue;
+    }
+    name = name.substr(0, name.find('('));
+    const auto space_pos = name.find(' ');
+    if (space_pos != string::npos) name = name.substr(space_pos + 1);
+    LOG(INFO) << "  in " << name << "(...) from " << file << ":" << line;
+  }
+#endif  // TAPA_ENABLE_STACKTRACE
+}
+
+}  // namespace
+
+void yield(const string& msg) {
+  if (current_coroutine == nullptr) {  // a dedicated thread or the host
+    std::this_thread::yield();
+    return;
+  }
+  if (debug) print_debug_info(msg);
+  TAPA_PROBE(coroutine_suspend, current_coroutine->id, msg.c_str());
+  (*current_coroutine->pull)();
+}
+
+void yield(wait_list* channel, const string& name, channel_state state,
+           const base_queue* queue) {
+  if (current_thread != nullptr) {
+    current_thread->wait(channel);
+    return;
+  }
+
+  // A coroutine keeps running as long as it makes progress between two yields,
+  // e.g., a task polling several channels per iteration, which saves a round
+  // trip through the runnable deque per channel that is not ready. A blocked
+  // coroutine polls once more before it yields, and one that keeps making
+  // progress yields after a while anyway so that its peers on the same worker
+  // are not starved.
+  constexpr uint64_t kMaxSkippedYields = 256;
+  auto c = current_coroutine;
+  if (op_count != c->yield_op_count && c->skipped_yields < kMaxSkippedYields &&
+      !debug) {
+    c->yield_op_count = op_count;
+    ++c->skipped_yields;
+    return;
+  }
+  c->yield_op_count = op_count;
+  current_coroutine->blocked_on = channel;
+  current_coroutine->blocked_queue = queue;
+  current_coroutine->blocked_state = state;
+  if (get_trace_path()) {
+    current_coroutine->blocked_on_name =
+        name + (state == channel_state::kEmpty ? " (empty)" : " (full)");
+  }
+  if (get_sample_period_ms() > 0) {
+    current_coroutine->sampled_full.store(state == channel_state::kFull,
+                                          std::memory_order_relaxed);
+    current_coroutine->sampled_channel.store(&name, std::memory_order_relaxed);
+  }
+  if (debug) {
+    print_debug_info("channel '" + name + "' is " +
+                     (state == channel_state::kEmpty ? "empty" : "full"));
+  }
+  TAPA_PROBE(coroutine_suspend, c->id, name.c_str());
+  (*current_coroutine->pull)();
+}
+
+cycle_clock& get_clock() {
+  // Dedicated threads and the caller of the top-level task use their own.
+  thread_local cycle_clock thread_clock;
+  return current_coroutine != nullptr ? current_coroutine->clock
+                                      : thread_clock;
+}
+
+void schedule(bool detach, thunk&& f, const vector<channel_t>& channels,
+              const task_id& id) {
+  if (defer_task(detach, /*thread=*/false, f, channels, id)) return;
+  pool->add_task(detach, std::move(f), channels, id);
+}
+
+void schedule_thread(thunk&& f, const vector<channel_t>& channels,
+                     const task_id& id) {
+  if (defer_task(/*detach=*/false, /*thread=*/true, f, channels, id)) return;
+  pool->add_thread(std::move(f), id);
+}
+
+void schedule_service(thunk&& f, const vector<channel_t>& channels) {
+  pool->add_task(/*detach=*/true, std::move(f), channels, {"(service)"});
+}
+
+// Logs the stats of tasks, the most expensive first, if they are enabled.
+void log_task_stats() {
+  if (!is_task_stats_enabled()) return;
+  vector<std::pair<string, task_stats>> entries;
+  uint64_t total_cpu_ns = 0;
+  {
+    unique_lock lock(task_stats_registry.mtx);
+    for (auto& entry : task_stats_registry.entries) {
+      entries.emplace_back(
+          get_task_name(entry.first.first, entry.first.second), entry.second);
+      total_cpu_ns += entry.second.cpu_ns;
+    }
+    task_stats_registry.entries.clear();
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const auto& lhs, const auto& rhs) {
+                     return lhs.second.cpu_ns > rhs.second.cpu_ns;
+                   });
+  LOG(INFO) << "stats of " << entries.size() << " task(s):";
+  for (const auto& entry : entries) {
+    const auto& stats = entry.second;
+    char cpu[64];
+    snprintf(cpu, sizeof(cpu), "%.3f ms (%.1f%%)", stats.cpu_ns / 1e6,
+             total_cpu_ns > 0 ? stats.cpu_ns * 100. / total_cpu_ns : 0.);
+    LOG(INFO) << "  '" << entry.first << "' (" << stats.instances
+              << " instance(s)): cpu=" << cpu << " resumes=" << stats.resumes
+              << " empty_resumes=" << stats.empty_resumes;
+  }
+}
+
+bool is_running() { return is_pool_alive; }
+
+void wait_for_progress() {
+  if (!pool->resume_once()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+}  // namespace internal
+
+// A task constructed outside of any simulation is a top-level task, which
+// starts a simulation and joins it once destroyed. Threads may simulate
+// top-level tasks concurrently; the thread pool is shared by all simulations,
+// and lives as long as any of them, so detached coroutines, released queues,
+// and stats are cleaned up and logged once the last one is joined.
+// Deterministic simulations run one at a time since each runs on the thread
+// that joins it.
+task::task() {
+  if (internal::get_simulation() != nullptr) return;
+  unique_lock lock(internal::mtx);
+  internal::simulation_cv.wait(lock, [] {
+    return internal::pool == nullptr || !internal::pool->is_deterministic();
+  });
+  if (internal::pool == nullptr) {
+    internal::pool = new internal::thread_pool;
+    internal::is_pool_alive = true;
+    internal::reset_simulated_cycles();
+  }
+  ++internal::simulation_count;
+  internal::current_simulation = std::make_shared<internal::simulation>(this);
+}
+
+task::~task() {
+  const auto sim = internal::current_simulation;
+  if (sim == nullptr || sim->top != this) return;
+  internal::schedule_deferred_tasks();
+  internal::pool->wait(*sim);
+  internal::drain_relays();
+  internal::current_simulation = nullptr;
+  unique_lock lock(internal::mtx);
+  if (--internal::simulation_count != 0) return;
+  // Deleting the pool unwinds detached coroutines, which may release queues.
+  delete internal::pool;
+  internal::pool = nullptr;
+  internal::is_pool_alive = false;
+  lock.unlock();
+  internal::simulation_cv.notify_all();
+  internal::free_released_queues();
+  internal::log_stats();
+  internal::log_task_stats();
+  internal::log_simulated_cycles();
+  internal::log_mmap_profile();
+}
+
+}  // namespace tapa
+
+#else  // TAPA_ENABLE_COROUTINE
+
+namespace tapa {
+namespace internal {
+
+namespace {
+
+// A task thread blocked on channels. It spins for a while first, since its
+// peers are likely running on other cores, and then sleeps until any channel
+// that it polls changes, so that designs with many more tasks than cores do
+// not keep all cores busy yielding to each other.
+struct thread_waiter {
+  // Number of times that a blocked thread yields before it sleeps.
+  static constexpr uint64_t kSpinCount = 64;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool notified = false;  // Guarded by `mtx`.
+
+  uint64_t last_op_count = 0;
+  uint64_t spin_count = 0;          // Yields since the last progress.
+  std::vector<wait_list*> waiting;  // Channels that the thread waits on.
+
+  // Called when `channel` is not ready.
+  void wait(wait_list* channel) {
+    if (op_count != this->last_op_count) {
+      // The thread made progress since it waited last time.
+      this->last_op_count = op_count;
+      this->spin_count = 0;
+      this->stop_waiting();
+    }
+    if (this->spin_count < kSpinCount) {
+      ++this->spin_count;
+      std::this_thread::yield();
+      return;
+    }
+    if (std::find(this->waiting.begin(), this->waiting.end(), channel) ==
+        this->waiting.end()) {
+      // Poll once more after being added so that no notification is lost.
+      channel->add(this);
+      this->waiting.push_back(channel);
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> lock(this->mtx);
+      this->cv.wait(lock, [this] { return this->notified; });
+      this->notified = false;
+    }
+    this->stop_waiting();
+  }
+
+  // Removes the thread from all channels it waits on.
+  void stop_waiting() {
+    for (auto channel : this->waiting) channel->remove(this);
+    this->waiting.clear();
+  }
+
+  void wake() {
+    {
+      std::unique_lock<std::mutex> lock(this->mtx);
+      this->notified = true;
+    }
+    this->cv.notify_one();
+  }
+
+  ~thread_waiter() { this->stop_waiting(); }
+};
+
+thread_local thread_waiter current_waiter;
+
+}  // namespace
+
+void wait_list::notify_all() {
+  std::unique_lock<std::mutex> lock(this->mtx);
+  for (auto w : this->waiters) static_cast<thread_waiter*>(w)->wake();
+  this->waiters.clear();
+  this->has_waiters = false;
+}
+
+void yield(const std::string& msg) { std::this_thread::yield(); }
+void yield(wait_list* channel, const std::string& /*name*/,
+           channel_state /*state*/, const base_queue* /*queue*/) {
+  current_waiter.wait(channel);
+}
+
+cycle_clock& get_clock() {
+  // Each task runs on its own thread.
+  thread_local cycle_clock clock;
+  return clock;
+}
+
+namespace {
+
+// Simulation of a top-level task; see `task::task`. Members are guarded by
+// `mtx`.
+struct simulation {
+  explicit simulation(const task* top) : top(top) {}
+
+  const task* const top;
+  std::deque<std::thread> threads;
+  size_t running_thread_count = 0;  // Number of non-detached running threads.
+};
+
+// Simulation of the top-level task invoked by this thread, or of the task run
+// by this thread.
+thread_local std::shared_ptr<simulation> current_simulation;
+
+size_t simulation_count = 0;
+size_t detached_thread_count = 0;  // Number of detached running threads.
+std::condition_variable running_thread_cv;
+std::mutex mtx;
+
+}  // namespace
+
+void schedule(bool detach, thunk&& f, const std::vector<channel_t>& channels,
+              const task_id& id) {
+  if (defer_task(detach, /*thread=*/false, f, channels, id)) return;
+  if (detach) {
+    {
+      std::unique_lock<std::mutex> lock(internal::mtx);
+      ++detached_thread_count;
+    }
+    std::thread([id, f = std::move(f)]() mutable {
+      TAPA_PROBE(task_spawn, 0, id.name, 1);
+      f();
+      TAPA_PROBE(task_finish, 0, id.name);
+      {
+        std::unique_lock<std::mutex> lock(internal::mtx);
+        --detached_thread_count;
+      }
+      free_released_queues();
+    }).detach();
+  } else {
+    auto sim = current_simulation;
+    std::unique_lock<std::mutex> lock(internal::mtx);
+    ++sim->running_thread_count;
+    sim->threads.emplace_back([id, sim, f = std::move(f)]() mutable {
+      current_simulation = sim;
+      TAPA_PROBE(task_spawn, 0, id.name, 0);
+      f();
+      TAPA_PROBE(task_finish, 0, id.name);
+      current_simulation = nullptr;
+      std::unique_lock<std::mutex> lock(internal::mtx);
+      if (--sim->running_thread_count == 0) running_thread_cv.notify_all();
+    });
+  }
+}
+
+void schedule_thread(thunk&& f, const std::vector<channel_t>& channels,
+                     const task_id& id) {
+  if (defer_task(/*detach=*/false, /*thread=*/true, f, channels, id)) return;
+  schedule(/*detach=*/false, std::move(f));
+}
+
+void schedule_service(thunk&& f,
+                      const std::vector<channel_t>& /*channels*/) {
+  // Not counted as a detached thread since it never accesses released queues.
+  std::thread(std::move(f)).detach();
+}
+
+bool is_running() {
+  std::unique_lock<std::mutex> lock(internal::mtx);
+  return simulation_count > 0 || detached_thread_count > 0;
+}
+
+void wait_for_progress() {
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+}  // namespace internal
+
+// A task constructed outside of any simulation, including one invoked by a
+// detached task, is a top-level task, which starts a simulation and joins it
+// once destroyed. Threads may simulate top-level tasks concurrently; released
+// queues are freed, and stats are logged, once the last one is joined.
+task::task() {
+  if (internal::current_simulation != nullptr) return;
+  std::unique_lock<std::mutex> lock(internal::mtx);
+  if (internal::simulation_count++ == 0) internal::reset_simulated_cycles();
+  internal::current_simulation = std::make_shared<internal::simulation>(this);
+}
+
+task::~task() {
+  const auto sim = internal::current_simulation;
+  if (sim == nullptr || sim->top != this) return;
+  internal::schedule_deferred_tasks();
+  // Threads of children, which may schedule more threads, are counted before
+  // they start, so all of them have finished once the count drops to zero.
+  std::deque<std::thread> finished_threads;
+  {
+    std::unique_lock<std::mutex> lock(internal::mtx);
+    internal::running_thread_cv.wait(
+        lock, [&sim] { return sim->running_thread_count == 0; });
+    lock.unlock();
+    internal::drain_relays();
+    lock.lock();
+    finished_threads.swap(sim->threads);
+  }
+  for (auto& t : finished_threads) t.join();
+  internal::current_simulation = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(internal::mtx);
+    if (--internal::simulation_count != 0) return;
+  }
+  internal::free_released_queues();
+  // Relays of captured streams are detached threads that never finish.
+  internal::flush_captures();
+  internal::log_stats();
+  internal::log_simulated_cycles();
+  internal::log_mmap_profile();
+}
+
+}  // namespace tapa
+
+#endif  // TAPA_ENABLE_COROUTINE
+
+namespace tapa {
+namespace internal {
+
+thread_local uint64_t op_count = 0;
+bool is_sequential = false;
+
+void wait_list::add(void* waiter) {
+  {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    this->waiters.push_back(waiter);
+    this->has_waiters = true;
+  }
+  if (!is_sequential) std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void wait_list::remove(void* waiter) {
+  std::unique_lock<std::mutex> lock(this->mtx);
+  auto it = std::find(this->waiters.begin(), this->waiters.end(), waiter);
+  if (it != this->waiters.end()) this->waiters.erase(it);
+  if (this->waiters.empty()) this->has_waiters = false;
+}
+
+namespace {
+
+// Maximum number of tokens buffered in each elastic stream, keyed by name.
+struct high_water_mark_report {
+  struct entry {
+    uint64_t depth;
+    uint64_t high_water_mark;
+  };
+
+  std::mutex mtx;
+  std::map<std::string, entry> entries;
+
+  static high_water_mark_report& get() {
+    static auto* report = new high_water_mark_report;
+    return *report;
+  }
+
+  static void write() {
+    const char* path = getenv("TAPA_ELASTIC_STREAMS");
+    auto& report = get();
+    std::unique_lock<std::mutex> lock(report.mtx);
+    FILE* fp = fopen(path, "w");
+    if (fp == nullptr) {
+      LOG(ERROR) << "cannot write elastic stream report to '" << path
+                 << "': " << strerror(errno);
+      return;
+    }
+    fprintf(fp, "{\n  \"fifos\": {");
+    const char* sep = "\n";
+    for (auto& kv : report.entries) {
+      fprintf(fp, "%s    \"", sep);
+      for (char c : kv.first) {
+        if (c == '"' || c == '\\') fputc('\\', fp);
+        fputc(c, fp);
+      }
+      fprintf(fp, "\": {\"depth\": %lu, \"high_water_mark\": %lu}",
+              static_cast<unsigned long>(kv.second.depth),
+              static_cast<unsigned long>(kv.second.high_water_mark));
+      sep = ",\n";
+    }
+    fprintf(fp, "\n  }\n}\n");
+    fclose(fp);
+    LOG(INFO) << "elastic stream report written to '" << path << "'";
+  }
+};
+
+}  // namespace
+
+bool is_elastic() {
+  static const bool elastic = [] {
+    const char* path = getenv("TAPA_ELASTIC_STREAMS");
+    if (path == nullptr || *path == '\0') return false;
+    LOG(INFO) << "streams are unbounded in simulation; high water marks will "
+                 "be written to '"
+              << path << "'";
+    atexit(high_water_mark_report::write);
+    return true;
+  }();
+  return elastic;
+}
+
+void report_high_water_mark(const std::string& name, uint64_t depth,
+                            uint64_t high_water_mark) {
+  auto& report = high_water_mark_report::get();
+  std::unique_lock<std::mutex> lock(report.mtx);
+  auto& entry = report.entries.emplace(name, high_water_mark_report::entry{
+                                                 depth, 0}).first->second;
+  entry.high_water_mark = std::max(entry.high_water_mark, high_water_mark);
+}
+
+namespace {
+
+// Stats of destructed queues, keyed by name, and counters of live queues.
+struct {
+  std::mutex mtx;
+  std::map<std::string, stream_stats> entries;
+  std::unordered_set<const stats_counter*> counters;
+} stats_registry;
+
+// Accumulates `src` to `dst`, which are stats of streams with the same name.
+void accumulate(stream_stats& dst, const stream_stats& src) {
+  const double occupancy_integral =
+      dst.occupancy * dst.seconds + src.occupancy * src.seconds;
+  dst.name = src.name;
+  dst.depth = src.depth;
+  dst.pushes += src.pushes;
+  dst.pops += src.pops;
+  dst.full_stalls += src.full_stalls;
+  dst.empty_stalls += src.empty_stalls;
+  dst.seconds += src.seconds;
+  dst.occupancy = dst.seconds > 0. ? occupancy_integral / dst.seconds : 0.;
+}
+
+}  // namespace
+
+bool is_stats_enabled() {
+  static const bool enabled = [] {
+    const char* env = getenv("TAPA_STREAM_STATS");
+    return env != nullptr && strcmp(env, "1") == 0;
+  }();
+  return enabled;
+}
+
+stats_counter::stats_counter(const base_queue* queue)
+    : queue(queue),
+      start(std::chrono::steady_clock::now()),
+      last_change(start) {
+  std::unique_lock<std::mutex> lock(stats_registry.mtx);
+  stats_registry.counters.insert(this);
+}
+
+stats_counter::~stats_counter() {
+  const auto stats = this->get();
+  std::unique_lock<std::mutex> lock(stats_registry.mtx);
+  stats_registry.counters.erase(this);
+  accumulate(stats_registry.entries[stats.name], stats);
+}
+
+void stats_counter::integrate(std::chrono::steady_clock::time_point now) {
+  this->occupancy_integral +=
+      this->occupancy *
+      std::chrono::duration<double>(now - this->last_change).count();
+  this->last_change = now;
+}
+
+void stats_counter::on_push(uint64_t n) {
+  const auto now = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(this->mtx);
+  this->integrate(now);
+  this->occupancy += n;
+  this->counters.pushes += n;
+}
+
+void stats_counter::on_pop(uint64_t n) {
+  const auto now = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(this->mtx);
+  this->integrate(now);
+  this->occupancy -= n;
+  this->counters.pops += n;
+}
+
+void stats_counter::on_stall(channel_state state) {
+  std::unique_lock<std::mutex> lock(this->mtx);
+  if (state == channel_state::kFull) {
+    ++this->counters.full_stalls;
+  } else {
+    ++this->counters.empty_stalls;
+  }
+}
+
+stream_stats stats_counter::get() const {
+  const auto now = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(this->mtx);
+  stream_stats stats = this->counters;
+  stats.name = this->queue->get_name();
+  stats.depth = this->queue->get_depth();
+  stats.seconds = std::chrono::duration<double>(now - this->start).count();
+  const double occupancy_integral =
+      this->occupancy_integral +
+      this->occupancy *
+          std::chrono::duration<double>(now - this->last_change).count();
+  stats.occupancy =
+      stats.seconds > 0. ? occupancy_integral / stats.seconds : 0.;
+  return stats;
+}
+
+void log_stats() {
+  if (!is_stats_enabled()) return;
+  auto entries = stats();
+  LOG(INFO) << "stats of " << entries.size() << " stream(s):";
+  for (const auto& entry : entries) {
+    char occupancy[32];
+    snprintf(occupancy, sizeof(occupancy), "%.2f", entry.occupancy);
+    LOG(INFO) << "  '" << entry.name << "' (depth " << entry.depth
+              << "): pushes=" << entry.pushes << " pops=" << entry.pops
+              << " full_stalls=" << entry.full_stalls
+              << " empty_stalls=" << entry.empty_stalls
+              << " occupancy=" << occupancy;
+  }
+}
+
+bool is_cycle_sim_enabled() {
+  static const bool enabled = [] {
+    const char* env = getenv("TAPA_CYCLE_SIM");
+    return env != nullptr && strcmp(env, "1") == 0;
+  }();
+  return enabled;
+}
+
+uint64_t get_cycle() { return get_clock().last_read; }
+
+void set_ready_cycle(uint64_t cycle) {
+  if (is_cycle_sim_enabled()) get_clock().ready = cycle;
+}
+
+void cycle_counter::on_push(uint64_t n) {
+  auto& clock = get_clock();
+  const uint64_t depth = this->queue->get_depth();
+  std::unique_lock<std::mutex> lock(this->mtx);
+  for (uint64_t i = 0; i < n; ++i, ++this->pushes) {
+    uint64_t cycle = clock.issue(this->queue);
+
+    // The slot is freed by reading the token written `depth` tokens earlier,
+    // which has been read unless the queue is elastic.
+    const uint64_t freed_base = this->pops - this->writable.size();
+    if (this->pushes >= depth && this->pushes - depth >= freed_base &&
+        this->pushes - depth < this->pops) {
+      cycle = std::max(cycle, this->writable[this->pushes - depth - freed_base]);
+    }
+
+    clock.advance(this->queue, cycle, /*is_read=*/false);
+    this->readable.push_back(std::max(cycle, clock.ready) + 1);
+  }
+  advance_simulated_cycles(clock.now);
+}
+
+void cycle_counter::on_pop(uint64_t n) {
+  auto& clock = get_clock();
+  const uint64_t depth = this->queue->get_depth();
+  std::unique_lock<std::mutex> lock(this->mtx);
+  for (uint64_t i = 0; i < n; ++i, ++this->pops) {
+    // Tokens are timestamped right after they are written, without yielding,
+    // so the producer is about to timestamp this token if it has not yet.
+    while (this->readable.empty()) {
+      lock.unlock();
+      std::this_thread::yield();
+      lock.lock();
+    }
+    const uint64_t cycle =
+        std::max(clock.issue(this->queue), this->readable.front());
+    this->readable.pop_front();
+    clock.advance(this->queue, cycle, /*is_read=*/true);
+    this->writable.push_back(cycle + 1);
+    if (this->writable.size() > depth) this->writable.pop_front();
+  }
+  advance_simulated_cycles(clock.now);
+}
+
+namespace {
+
+// Queues released while tasks may still access them.
+struct {
+  std::mutex mtx;
+  std::vector<base_queue*> queues;
+} released_queues;
+
+}  // namespace
+
+void release(base_queue* queue) {
+  {
+    std::unique_lock<std::mutex> lock(released_queues.mtx);
+    if (is_running()) {
+      released_queues.queues.push_back(queue);
+      return;
+    }
+  }
+  delete queue;
+}
+
+void free_released_queues() {
+  std::vector<base_queue*> queues;
+  {
+    std::unique_lock<std::mutex> lock(released_queues.mtx);
+    if (is_running()) return;
+    queues.swap(released_queues.queues);
+  }
+  for (auto queue : queues) delete queue;
+}
+
+namespace {
+
+// Latest completion of any modeled memory request.
+std::atomic<uint64_t> simulated_cycle_count{0};
+
+// Whether any memory model is used.
+std::atomic_bool is_memory_modeled{false};
+
+}  // namespace
+
+memory_timing::memory_timing(const memory_model& model, uint64_t width,
+                             uint64_t cache_lines, uint64_t cache_ways,
+                             uint64_t max_burst_len)
+    : model(model),
+      width(width),
+      max_burst_len(max_burst_len != 0 ? max_burst_len
+                    : model.max_burst_len != 0
+                        ? model.max_burst_len
+                        : std::min<uint64_t>(
+                              256, std::max<uint64_t>(4096 / width, 1))),
+      cache_sets(cache_lines / cache_ways),
+      cache_ways(cache_ways),
+      cache_tags(cache_lines, -1),
+      port(acquire_port(&model)) {
+  is_memory_modeled = true;
+}
+
+std::shared_ptr<memory_timing::port_t> memory_timing::acquire_port(
+    const memory_model* model) {
+  // Ports are dropped once no memory_timing uses them, so each invocation
+  // starts from idle channels.
+  static std::mutex mtx;
+  static std::map<const memory_model*, std::weak_ptr<port_t>> ports;
+  std::unique_lock<std::mutex> lock(mtx);
+  for (auto it = ports.begin(); it != ports.end();) {
+    it = it->second.expired() ? ports.erase(it) : std::next(it);
+  }
+  auto& entry = ports[model];
+  auto port = entry.lock();
+  if (port == nullptr) {
+    port = std::make_shared<port_t>();
+    entry = port;
+  }
+  return port;
+}
+
+uint64_t memory_timing::on_read(int64_t addr, uint64_t n, uint64_t cycle) {
+  // Only runs of consecutive misses are requested from the memory.
+  uint64_t done_cycle = cycle;
+  uint64_t miss_begin = 0;
+  for (uint64_t i = 0; i < n && !this->cache_tags.empty(); ++i) {
+    if (this->lookup(addr + i)) {
+      if (i > miss_begin) {
+        done_cycle = std::max(
+            done_cycle, this->access(&port_t::read, addr + miss_begin,
+                                     i - miss_begin, cycle));
+      }
+      miss_begin = i + 1;
+    }
+  }
+  if (n > miss_begin) {
+    done_cycle = std::max(
+        done_cycle,
+        this->access(&port_t::read, addr + miss_begin, n - miss_begin, cycle));
+  }
+  return done_cycle;
+}
+
+uint64_t memory_timing::on_write(int64_t addr, uint64_t n, uint64_t cycle) {
+  for (uint64_t i = 0; i < n && !this->cache_tags.empty(); ++i) {
+    const uint64_t set = uint64_t(addr + i) % this->cache_sets;
+    std::fill_n(this->cache_tags.begin() + set * this->cache_ways,
+                this->cache_ways, -1);
+  }
+  return this->access(&port_t::write, addr, n, cycle);
+}
+
+bool memory_timing::lookup(int64_t addr) {
+  const auto set = this->cache_tags.begin() +
+                   uint64_t(addr) % this->cache_sets * this->cache_ways;
+  if (std::find(set, set + this->cache_ways, addr) != set + this->cache_ways) {
+    return true;
+  }
+  set[this->cache_victim] = addr;
+  this->cache_victim = (this->cache_victim + 1) % this->cache_ways;
+  return false;
+}
+
+uint64_t memory_timing::access(channel_t port_t::*channel_ptr, int64_t addr,
+                               uint64_t n, uint64_t cycle) {
+  std::unique_lock<std::mutex> lock(this->port->mtx);
+  auto& channel = (*this->port).*channel_ptr;
+  auto& outstanding = channel.outstanding;
+  while (n > 0) {
+    if (addr != channel.next_addr || channel.burst_len == this->max_burst_len) {
+      // Issues a new burst once the request arrives, the address channel is
+      // available, and fewer than the maximum number of bursts are in flight.
+      uint64_t issue_cycle = std::max(channel.issue_cycle, cycle);
+      if (this->model.max_outstanding != 0 &&
+          outstanding.size() >= this->model.max_outstanding) {
+        issue_cycle = std::max(issue_cycle, outstanding.front());
+      }
+      while (!outstanding.empty() && outstanding.front() <= issue_cycle) {
+        outstanding.pop_front();
+      }
+      channel.issue_cycle = issue_cycle + 1;
+      channel.data_cycle =
+          std::max(channel.data_cycle, issue_cycle + this->model.latency);
+      channel.burst_len = 0;
+      outstanding.push_back(channel.data_cycle);
+    }
+
+    // Extends the open burst.
+    const uint64_t count =
+        std::min(n, this->max_burst_len - channel.burst_len);
+    uint64_t cycles = count;
+    if (this->model.bytes_per_cycle != 0) {
+      cycles = std::max(cycles, (count * this->width +
+                                 this->model.bytes_per_cycle - 1) /
+                                    this->model.bytes_per_cycle);
+    }
+    channel.data_cycle += cycles;
+    outstanding.back() = channel.data_cycle;
+    channel.burst_len += count;
+    addr += count;
+    n -= count;
+    channel.next_addr = addr;
+  }
+
+  advance_simulated_cycles(channel.data_cycle);
+  return channel.data_cycle;
+}
+
+void reset_simulated_cycles() { simulated_cycle_count = 0; }
+
+void log_simulated_cycles() {
+  if (is_cycle_sim_enabled()) {
+    LOG(INFO) << "cycle-approximate simulation estimates "
+              << simulated_cycle_count.load() << " cycle(s)";
+  } else if (is_memory_modeled) {
+    LOG(INFO) << "memory models estimate " << simulated_cycle_count.load()
+              << " cycle(s)";
+  }
+}
+
+void advance_simulated_cycles(uint64_t cycle) {
+  uint64_t count = simulated_cycle_count.load(std::memory_order_relaxed);
+  while (count < cycle && !simulated_cycle_count.compare_exchange_weak(
+                              count, cycle, std::memory_order_relaxed)) {
+  }
+}
+
+struct mmap_profiler::memory_t {
+  std::mutex mtx;
+  mmap_access_stats stats;
+  std::vector<bool> is_read;          // Whether each element is read.
+  std::vector<bool> is_written;       // Whether each element is written.
+  std::vector<uint64_t> last_access;  // When each element is accessed, or 0.
+  uint64_t time = 0;                  // Number of elements accessed so far.
+
+  // Records a read or write of element `elem`.
+  void access(uint64_t elem, bool is_write) {
+    if (elem >= this->last_access.size()) {
+      this->is_read.resize(elem + 1);
+      this->is_written.resize(elem + 1);
+      this->last_access.resize(elem + 1);
+    }
+    auto& dir = is_write ? this->stats.write : this->stats.read;
+    auto&& is_accessed = (is_write ? this->is_written : this->is_read)[elem];
+    if (!is_accessed) {
+      is_accessed = true;
+      ++dir.footprint;
+    }
+    auto& last = this->last_access[elem];
+    ++this->time;
+    if (last != 0) ++this->stats.reuse[get_bucket(this->time - last - 1)];
+    last = this->time;
+  }
+
+  // Returns the lower bound of the power-of-2 bucket of `n`.
+  static uint64_t get_bucket(uint64_t n) {
+    return n == 0 ? 0 : uint64_t(1) << (63 - __builtin_clzll(n));
+  }
+  static int64_t get_bucket(int64_t n) {
+    return n < 0 ? -int64_t(get_bucket(uint64_t(-n)))
+                 : int64_t(get_bucket(uint64_t(n)));
+  }
+};
+
+namespace {
+
+// Memories profiled so far, keyed by their start.
+struct mmap_profile_registry {
+  std::mutex mtx;
+  std::map<const void*, std::shared_ptr<mmap_profiler::memory_t>> entries;
+
+  // Never destructed, so that profilers can be destructed at any time.
+  static mmap_profile_registry& get() {
+    static auto* registry = new mmap_profile_registry;
+    return *registry;
+  }
+};
+
+}  // namespace
+
+bool is_mmap_profile_enabled() {
+  static const bool enabled = [] {
+    const char* path = getenv("TAPA_MMAP_PROFILE");
+    return path != nullptr && *path != '\0';
+  }();
+  return enabled;
+}
+
+mmap_profiler::mmap_profiler(const void* ptr, uint64_t size, uint64_t width)
+    : memory([&] {
+        auto& registry = mmap_profile_registry::get();
+        std::unique_lock<std::mutex> lock(registry.mtx);
+        auto& entry = registry.entries[ptr];
+        if (entry == nullptr) entry = std::make_shared<memory_t>();
+        return entry;
+      }()) {
+  std::unique_lock<std::mutex> lock(this->memory->mtx);
+  auto& stats = this->memory->stats;
+  stats.ptr = ptr;
+  stats.size = std::max(stats.size, size);
+  stats.width = width;
+}
+
+void mmap_profiler::on_read(const int64_t* addrs, uint64_t n) {
+  this->on_requests(/*is_write=*/false, addrs, n);
+}
+
+void mmap_profiler::on_write(const int64_t* addrs, uint64_t n) {
+  this->on_requests(/*is_write=*/true, addrs, n);
+}
+
+void mmap_profiler::on_requests(bool is_write, const int64_t* addrs,
+                                uint64_t n) {
+  auto& port = is_write ? this->write : this->read;
+  std::unique_lock<std::mutex> lock(this->memory->mtx);
+  auto& dir = is_write ? this->memory->stats.write : this->memory->stats.read;
+  for (uint64_t i = 0; i < n; ++i) {
+    const int64_t addr = decode_burst_addr(addrs[i]);
+    const uint64_t len = decode_burst_len(addrs[i]);
+    ++dir.requests;
+    dir.elements += len;
+    if (port.last_addr >= 0) {
+      ++dir.strides[memory_t::get_bucket(addr - port.last_addr)];
+    }
+    port.last_addr = addr;
+    // The open run is counted as it grows, so that the stats are up to date
+    // while the port is still in use.
+    if (addr != port.next_addr) {
+      port.run_len = 0;
+    } else {
+      auto run = dir.runs.find(memory_t::get_bucket(port.run_len));
+      if (--run->second == 0) dir.runs.erase(run);
+    }
+    port.run_len += len;
+    ++dir.runs[memory_t::get_bucket(port.run_len)];
+    port.next_addr = addr + len;
+    for (uint64_t j = 0; j < len; ++j) {
+      this->memory->access(addr + j, is_write);
+    }
+  }
+}
+
+void log_mmap_profile() {
+  if (!is_mmap_profile_enabled()) return;
+  const auto entries = access_stats();
+  LOG(INFO) << "access pattern of " << entries.size() << " mmap(s):";
+  for (const auto& entry : entries) {
+    LOG(INFO) << "  " << entry.ptr << " (" << entry.size << " x "
+              << entry.width << " bytes):";
+    for (auto* dir : {&entry.read, &entry.write}) {
+      if (dir->requests == 0) continue;
+      // The most frequent stride tells whether the accesses are sequential.
+      auto stride = dir->strides.begin();
+      uint64_t strides = 0;
+      for (auto it = dir->strides.begin(); it != dir->strides.end(); ++it) {
+        if (it->second > stride->second) stride = it;
+        strides += it->second;
+      }
+      char summary[256];
+      snprintf(summary, sizeof(summary),
+               "    %s: %" PRIu64 " element(s) in %" PRIu64
+               " request(s), footprint=%" PRIu64 " mean_run=%.1f",
+               dir == &entry.read ? "reads" : "writes", dir->elements,
+               dir->requests, dir->footprint,
+               mmap_access_stats::mean_run(*dir));
+      std::string line = summary;
+      if (stride != dir->strides.end()) {
+        char share[64];
+        snprintf(share, sizeof(share), " top_stride=%" PRId64 " (%.1f%%)",
+                 stride->first, stride->second * 100. / strides);
+        line += share;
+      }
+      LOG(INFO) << line;
+    }
+  }
+
+  const char* path = getenv("TAPA_MMAP_PROFILE");
+  std::ofstream os(path);
+  os << R"({"mmaps":[)";
+  for (size_t i = 0; i < entries.size(); ++i) {
+    os << (i == 0 ? "" : ",");
+    entries[i].write_json(os);
+  }
+  os << "]}\n";
+  if (!os) {
+    LOG(ERROR) << "cannot write mmap profile to '" << path << "'";
+    return;
+  }
+  LOG(INFO) << "mmap profile written to '" << path << "'";
+}
+
+namespace {
+
+// Memory freed by local arrays, by size. It is kept for the process lifetime,
+// so its peak is that of the local arrays alive at the same time.
+struct local_array_pool {
+  std::mutex mtx;
+  std::unordered_map<size_t, std::vector<void*>> free;
+
+  static local_array_pool& get() {
+    static auto* pool = new local_array_pool;
+    return *pool;
+  }
+};
+
+}  // namespace
+
+void* allocate_local_array(size_t bytes) {
+  auto& pool = local_array_pool::get();
+  {
+    std::unique_lock<std::mutex> lock(pool.mtx);
+    auto& free = pool.free[bytes];
+    if (!free.empty()) {
+      void* ptr = free.back();
+      free.pop_back();
+      return ptr;
+    }
+  }
+  return ::operator new(bytes, std::align_val_t(kLocalArrayAlignment));
+}
+
+void free_local_array(void* ptr, size_t bytes) {
+  auto& pool = local_array_pool::get();
+  std::unique_lock<std::mutex> lock(pool.mtx);
+  pool.free[bytes].push_back(ptr);
+}
+
+void parallel_for(uint64_t n, uint64_t grain,
+                  const std::function<void(uint64_t, uint64_t)>& f) {
+  static const uint64_t kCoreCount =
+      std::max(std::thread::hardware_concurrency(), 1u);
+  const uint64_t thread_count =
+      std::min(kCoreCount, std::max<uint64_t>(n / std::max<uint64_t>(grain, 1),
+                                              1));
+  const uint64_t chunk = (n + thread_count - 1) / thread_count;
+  std::vector<std::thread> threads;
+  for (uint64_t begin = chunk; begin < n; begin += chunk) {
+    threads.emplace_back(f, begin, std::min(begin + chunk, n));
+  }
+  if (n > 0) f(0, std::min(chunk, n));
+  for (auto& thread : threads) thread.join();
+}
+
+namespace {
+
+constexpr size_t kPageSize = 4 << 10;
+constexpr size_t kHugePageSize = 2 << 20;
+
+// How host buffers are allocated, which can be set via environment variables:
+//
+//   `TAPA_HOST_HUGE_PAGES`: if non-zero, buffers of at least one huge page are
+//     backed by huge pages from `MAP_HUGETLB` if any are reserved, or by
+//     transparent huge pages otherwise;
+//   `TAPA_HOST_NUMA_NODE`: NUMA node to which buffers are bound, or the PCI
+//     address (e.g., `0000:3b:00.0`) of the card whose node is used;
+//   `TAPA_HOST_PREFAULT`: if non-zero, buffers are faulted in when allocated.
+struct allocation_options {
+  bool huge_pages = false;
+  int numa_node = -1;  // Not bound if negative.
+  bool prefault = false;
+};
+
+int parse_numa_node(const char* env) {
+  char* end;
+  const long node = strtol(env, &end, 10);
+  if (*end == '\0' && end != env && node >= 0) return node;
+
+  // Not a number; look up the node of the PCI device.
+  const std::string path =
+      std::string("/sys/bus/pci/devices/") + env + "/numa_node";
+  int pci_node = -1;
+  if (auto file = fopen(path.c_str(), "r")) {
+    if (fscanf(file, "%d", &pci_node) != 1) pci_node = -1;
+    fclose(file);
+  } else {
+    throw std::runtime_error(std::string("invalid TAPA_HOST_NUMA_NODE: ") +
+                             env);
+  }
+  LOG_IF(WARNING, pci_node < 0)
+      << "NUMA node of PCI device " << env << " is unknown";
+  return pci_node;
+}
+
+const allocation_options& get_allocation_options() {
+  static const allocation_options options = [] {
+    allocation_options options;
+    if (auto env = getenv("TAPA_HOST_HUGE_PAGES")) {
+      options.huge_pages = atoi(env) != 0;
+    }
+    if (auto env = getenv("TAPA_HOST_NUMA_NODE")) {
+      options.numa_node = parse_numa_node(env);
+    }
+    if (auto env = getenv("TAPA_HOST_PREFAULT")) {
+      options.prefault = atoi(env) != 0;
+    }
+    return options;
+  }();
+  return options;
+}
+
+bool uses_huge_pages(size_t length) {
+  return get_allocation_options().huge_pages && length >= kHugePageSize;
+}
+
+// Returns the length actually mapped for a buffer of `length` bytes. Huge page
+// mappings must be unmapped in whole huge pages.
+size_t get_mapped_length(size_t length) {
+  if (!uses_huge_pages(length)) return length;
+  return (length + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+}  // namespace
+
+void* allocate(size_t length) {
+  const auto& options = get_allocation_options();
+  const bool huge_pages = uses_huge_pages(length);
+  length = get_mapped_length(length);
+  constexpr int kFlags = MAP_SHARED | MAP_ANONYMOUS;
+  void* addr = MAP_FAILED;
+  if (huge_pages) {
+    addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                  kFlags | MAP_HUGETLB, /*fd=*/-1, /*offset=*/0);
+  }
+  if (addr == MAP_FAILED) {
+    addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, kFlags, /*fd=*/-1,
+                  /*offset=*/0);
+    if (addr == MAP_FAILED) throw std::bad_alloc();
+    if (huge_pages && ::madvise(addr, length, MADV_HUGEPAGE) != 0) {
+      LOG_FIRST_N(WARNING, 1)
+          << "cannot use transparent huge pages: " << std::strerror(errno);
+    }
+  }
+
+  // Pages must be bound before they are faulted in.
+  if (options.numa_node >= 0) {
+    constexpr int kMaxNode = sizeof(unsigned long) * CHAR_BIT;
+    if (options.numa_node < kMaxNode) {
+      const unsigned long node_mask = 1UL << options.numa_node;
+      if (syscall(SYS_mbind, addr, length, MPOL_BIND, &node_mask, kMaxNode,
+                  /*flags=*/0) != 0) {
+        LOG_FIRST_N(WARNING, 1) << "cannot bind host buffers to NUMA node "
+                                << options.numa_node << ": "
+                                << std::strerror(errno);
+      }
+    } else {
+      LOG_FIRST_N(WARNING, 1)
+          << "NUMA node " << options.numa_node << " is not supported";
+    }
+  }
+
+  if (options.prefault) {
+    auto bytes = static_cast<volatile char*>(addr);
+    for (size_t i = 0; i < length; i += kPageSize) bytes[i] = 0;
+  }
+  return addr;
+}
+void deallocate(void* addr, size_t length) {
+  if (::munmap(addr, get_mapped_length(length)) != 0) throw std::bad_alloc();
+}
+
+bool is_shared_memory(const void* ptr, size_t length) {
+  auto begin = reinterpret_cast<uintptr_t>(ptr);
+  const uintptr_t end = begin + length;
+  // Mappings are listed in increasing addresses, with `s` as the 4th
+  // permission if shared, e.g., `7f0000000000-7f0000001000 rw-s ...`.
+  std::ifstream maps("/proc/self/maps");
+  for (std::string line; begin < end && std::getline(maps, line);) {
+    uintptr_t low, high;
+    char perms[5];
+    if (sscanf(line.c_str(), "%" SCNxPTR "-%" SCNxPTR " %4s", &low, &high,
+               perms) != 3 ||
+        high <= begin) {
+      continue;
+    }
+    if (low > begin || perms[3] != 's') return false;
+    begin = high;
+  }
+  return begin >= end;
+}
+
+namespace {
+
+// Host memory pinned via `register_buffer`, mapped to its length.
+std::mutex registered_buffers_mtx;
+std::map<const void*, size_t> registered_buffers;
+
+bool is_page_aligned(const void* ptr) {
+  return reinterpret_cast<uintptr_t>(ptr) % kPageSize == 0;
+}
+
+}  // namespace
+
+bool register_buffer(const void* ptr, size_t length) {
+  if (!is_page_aligned(ptr)) {
+    LOG(WARNING) << "cannot register " << length << " bytes at " << ptr
+                 << " because they are not page-aligned; allocate them via "
+                 << "tapa::aligned_allocator";
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(registered_buffers_mtx);
+  auto it = registered_buffers.find(ptr);
+  if (it != registered_buffers.end()) {
+    if (it->second >= length) return true;
+    ::munlock(ptr, it->second);
+    registered_buffers.erase(it);
+  }
+  if (::mlock(ptr, length) != 0) {
+    LOG(WARNING) << "cannot pin " << length << " bytes at " << ptr << ": "
+                 << std::strerror(errno);
+    return false;
+  }
+  registered_buffers[ptr] = length;
+  return true;
+}
+void unregister_buffer(const void* ptr) {
+  std::lock_guard<std::mutex> lock(registered_buffers_mtx);
+  auto it = registered_buffers.find(ptr);
+  if (it == registered_buffers.end()) return;
+  ::munlock(ptr, it->second);
+  registered_buffers.erase(it);
+}
+
+void log_if_copied(int idx, const void* ptr, uint64_t bytes) {
+  if (bytes == 0 || is_page_aligned(ptr)) return;
+  LOG(WARNING) << "argument #" << idx << " (" << bytes << " bytes at " << ptr
+               << ") is not page-aligned, so the runtime copies it through a "
+               << "bounce buffer on each transfer; allocate it via "
+               << "tapa::aligned_allocator to transfer it in place";
+}
+
+void* map_file(int fd, size_t elem_size, bool writable, bool populate,
+               size_t& length) {
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    throw std::runtime_error(std::string("cannot stat file: ") +
+                             std::strerror(errno));
+  }
+  length = st.st_size;
+  if (length % elem_size != 0) {
+    throw std::runtime_error("file size " + std::to_string(length) +
+                             " is not a multiple of element size " +
+                             std::to_string(elem_size));
+  }
+  if (length == 0) return nullptr;
+
+  const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  const int flags = populate ? MAP_SHARED | MAP_POPULATE : MAP_SHARED;
+  void* addr = ::mmap(nullptr, length, prot, flags, fd, /*offset=*/0);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error(std::string("cannot map file: ") +
+                             std::strerror(errno));
+  }
+  return addr;
+}
+void* map_file(const std::string& path, size_t elem_size, bool writable,
+               bool populate, size_t& length) {
+  const int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + path + ": " +
+                             std::strerror(errno));
+  }
+  // The mapping stays valid after the file is closed.
+  void* addr = nullptr;
+  try {
+    addr = map_file(fd, elem_size, writable, populate, length);
+  } catch (const std::runtime_error& e) {
+    ::close(fd);
+    throw std::runtime_error(path + ": " + e.what());
+  }
+  ::close(fd);
+  return addr;
+}
+void unmap_file(void* addr, size_t length) {
+  PCHECK(::munmap(addr, length) == 0);
+}
+
+namespace {
+
+int64_t elapsed_ns(std::chrono::steady_clock::time_point tic) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - tic)
+      .count();
+}
+
+}  // namespace
+
+rtl_sim::rtl_sim(const std::string& executable) : executable_(executable) {
+  CHECK_EQ(::access(executable.c_str(), X_OK), 0)
+      << executable << " is not an executable RTL simulator";
+  const char* tmp_dir = getenv("TMPDIR");
+  std::string dir = std::string(tmp_dir == nullptr ? "/tmp" : tmp_dir) +
+                    "/tapa-rtl-sim-XXXXXX";
+  const char* created_dir = ::mkdtemp(&dir[0]);
+  PCHECK(created_dir != nullptr) << dir;
+  dir_ = created_dir;
+}
+
+rtl_sim::~rtl_sim() {
+  for (size_t i = 0; i < args_.size(); ++i) {
+    ::unlink(get_buffer_path(i).c_str());
+  }
+  ::unlink((dir_ + "/args.txt").c_str());
+  ::unlink((dir_ + "/cycles.txt").c_str());
+  ::rmdir(dir_.c_str());
+}
+
+bool rtl_sim::is_rtl_sim(const std::string& bitstream) {
+  const std::string suffix = ".verilator";
+  return bitstream.size() > suffix.size() &&
+         bitstream.compare(bitstream.size() - suffix.size(), suffix.size(),
+                           suffix) == 0;
+}
+
+void rtl_sim::set_scalar_arg(int idx, const void* ptr, size_t bytes) {
+  if (size_t(idx) >= args_.size()) args_.resize(idx + 1);
+  args_[idx] = {};
+  args_[idx].value.assign(static_cast<const char*>(ptr), bytes);
+}
+
+void rtl_sim::set_buffer_arg(int idx, void* ptr, uint64_t bytes,
+                             bool to_device, bool from_device) {
+  if (size_t(idx) >= args_.size()) args_.resize(idx + 1);
+  args_[idx] = {};
+  args_[idx].ptr = ptr;
+  args_[idx].bytes = bytes;
+  args_[idx].to_device = to_device;
+  args_[idx].from_device = from_device;
+}
+
+std::string rtl_sim::get_buffer_path(int idx) const {
+  return dir_ + "/arg" + std::to_string(idx) + ".bin";
+}
+
+void rtl_sim::WriteToDevice() {
+  const auto tic = std::chrono::steady_clock::now();
+  std::ofstream args_txt(dir_ + "/args.txt");
+  for (size_t i = 0; i < args_.size(); ++i) {
+    const auto& arg = args_[i];
+    if (arg.ptr == nullptr) {
+      // Scalars are passed as little-endian hex bytes.
+      args_txt << i << " scalar ";
+      for (unsigned char byte : arg.value) {
+        args_txt << std::hex << std::setw(2) << std::setfill('0') << int(byte);
+      }
+      args_txt << std::dec << "\n";
+      continue;
+    }
+
+    // Buffers not copied to the device are left uninitialized.
+    const std::string path = get_buffer_path(i);
+    std::ofstream buffer(path, std::ios::binary | std::ios::trunc);
+    if (arg.to_device) {
+      buffer.write(static_cast<const char*>(arg.ptr), arg.bytes);
+    } else if (arg.bytes > 0) {
+      buffer.seekp(arg.bytes - 1);
+      buffer.put('\0');
+    }
+    CHECK(buffer.good()) << "failed to write " << path;
+    args_txt << i << " buffer " << arg.bytes << " " << path << "\n";
+  }
+  CHECK(args_txt.good()) << "failed to write the arguments to " << dir_;
+  load_ns_ = elapsed_ns(tic);
+}
+
+void rtl_sim::Exec() {
+  LOG(INFO) << "running RTL simulation with " << executable_;
+  const auto tic = std::chrono::steady_clock::now();
+  const pid_t pid = fork();
+  PCHECK(pid != -1);
+  if (pid == 0) {
+    ::execl(executable_.c_str(), executable_.c_str(), dir_.c_str(), nullptr);
+    ::perror(executable_.c_str());
+    _exit(EXIT_FAILURE);
+  }
+  int status = 0;
+  CHECK_EQ(waitpid(pid, &status, 0), pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS)
+      << "RTL simulation failed";
+  compute_ns_ = elapsed_ns(tic);
+
+  uint64_t cycles = 0;
+  if (std::ifstream(dir_ + "/cycles.txt") >> cycles) {
+    LOG(INFO) << "RTL simulation finished in " << cycles << " cycles, "
+              << cycles * 1e3 / std::max<int64_t>(compute_ns_, 1)
+              << " MHz on average";
+  }
+}
+
+void rtl_sim::ReadFromDevice() {
+  const auto tic = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < args_.size(); ++i) {
+    const auto& arg = args_[i];
+    if (arg.ptr == nullptr || !arg.from_device) continue;
+    const std::string path = get_buffer_path(i);
+    std::ifstream buffer(path, std::ios::binary);
+    buffer.read(static_cast<char*>(arg.ptr), arg.bytes);
+    CHECK(buffer.good()) << "failed to read " << path;
+  }
+  store_ns_ = elapsed_ns(tic);
+}
+
+profile get_profile(const instance& instance) {
+  profile profile;
+  profile.times.load_ns = instance.load_time_ns();
+  profile.times.compute_ns = instance.compute_time_ns();
+  profile.times.store_ns = instance.store_time_ns();
+  const auto& buffers = instance.get_buffers();
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    if (buffers[i].type == nullptr) continue;
+    mmap_profile mmap;
+    mmap.index = i;
+    mmap.bytes = buffers[i].bytes;
+    mmap.to_device = buffers[i].to_device;
+    mmap.from_device = buffers[i].from_device;
+    profile.mmaps.push_back(mmap);
+  }
+
+  static const char* path = getenv("TAPA_PROFILE");
+  if (path != nullptr && *path != '\0') {
+    static std::mutex mtx;
+    std::unique_lock<std::mutex> lock(mtx);
+    std::ofstream os(path, std::ios::app);
+    profile.write_json(os);
+    os << "\n";
+    LOG_IF(WARNING, !os) << "cannot write profile to " << path;
+  }
+  return profile;
+}
+
+std::string get_task_name(const std::string& name, const void* func) {
+  if (!name.empty()) return name;
+#if TAPA_ENABLE_STACKTRACE
+  if (func != nullptr) {
+    const auto func_name = boost::stacktrace::frame(func).name();
+    if (!func_name.empty()) return func_name.substr(0, func_name.find('('));
+  }
+#endif  // TAPA_ENABLE_STACKTRACE
+  char addr[32];
+  snprintf(addr, sizeof(addr), "%p", func);
+  return std::string("task@") + addr;
+}
+
+namespace {
+
+// Files of captured tokens that have not been destroyed.
+struct {
+  std::mutex mtx;
+  std::unordered_set<capture_file*> files;
+} capture_registry;
+
+// Opens `path` for writing, truncating it.
+int open_capture_file(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + path + ": " +
+                             std::strerror(errno));
+  }
+  return fd;
+}
+
+void write_capture_file(int fd, const std::string& path, const void* data,
+                        size_t size) {
+  auto ptr = static_cast<const char*>(data);
+  while (size > 0) {
+    const ssize_t written = ::write(fd, ptr, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      LOG(ERROR) << "cannot write " << path << ": " << std::strerror(errno);
+      return;
+    }
+    ptr += written;
+    size -= written;
+  }
+}
+
+}  // namespace
+
+capture_file::capture_file(const std::string& path)
+    : path(path), fd(open_capture_file(path)) {
+  std::unique_lock<std::mutex> lock(capture_registry.mtx);
+  capture_registry.files.insert(this);
+}
+
+capture_file::~capture_file() {
+  {
+    std::unique_lock<std::mutex> lock(capture_registry.mtx);
+    capture_registry.files.erase(this);
+  }
+  this->flush();
+  ::close(this->fd);
+}
+
+void capture_file::write(const void* data, size_t size) {
+  constexpr size_t kBufferSize = 1 << 16;
+  std::unique_lock<std::mutex> lock(this->mtx);
+  auto ptr = static_cast<const char*>(data);
+  this->buffer.insert(this->buffer.end(), ptr, ptr + size);
+  if (this->buffer.size() >= kBufferSize) {
+    write_capture_file(this->fd, this->path, this->buffer.data(),
+                       this->buffer.size());
+    this->buffer.clear();
+  }
+}
+
+void capture_file::flush() {
+  std::unique_lock<std::mutex> lock(this->mtx);
+  write_capture_file(this->fd, this->path, this->buffer.data(),
+                     this->buffer.size());
+  this->buffer.clear();
+}
+
+void flush_captures() {
+  std::unique_lock<std::mutex> lock(capture_registry.mtx);
+  for (auto file : capture_registry.files) file->flush();
+}
+
+std::shared_ptr<capture> capture::create(const task_id& id) {
+  static const char* const task = getenv("TAPA_CAPTURE");
+  if (task == nullptr || *task == '\0') return nullptr;
+  // Only instance names are compared unless function names are known.
+  if (strcmp(id.name, task) != 0 && get_task_name(id.name, id.func) != task) {
+    return nullptr;
+  }
+
+  static const std::string base_dir = [] {
+    const char* env = getenv("TAPA_CAPTURE_DIR");
+    const std::string dir =
+        env != nullptr && *env != '\0' ? env : "tapa-capture";
+    if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+      LOG(FATAL) << "cannot create " << dir << ": " << std::strerror(errno);
+    }
+    return dir;
+  }();
+  static std::atomic<uint64_t> instance_count{0};
+  const std::string dir =
+      base_dir + "/" + task + "." + std::to_string(instance_count++);
+  if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    LOG(FATAL) << "cannot create " << dir << ": " << std::strerror(errno);
+  }
+  LOG(INFO) << "capturing " << get_task_name(id.name, id.func) << " into "
+            << dir;
+  return std::make_shared<capture>(dir);
+}
+
+std::string capture::get_path(int index, const char* suffix) const {
+  return this->dir + "/arg" + std::to_string(index) + suffix;
+}
+
+void capture::write_file(int index, const char* suffix, const void* data,
+                         size_t size) const {
+  const auto path = this->get_path(index, suffix);
+  const int fd = open_capture_file(path);
+  write_capture_file(fd, path, data, size);
+  ::close(fd);
+}
+
+void capture::add_region(int index, const void* data, size_t size,
+                         bool is_written) {
+  this->regions.push_back({index, data, size, is_written});
+}
+
+void capture::snapshot(bool is_finished) const {
+  for (auto& region : this->regions) {
+    if (is_finished && !region.is_written) continue;
+    this->write_file(region.index, is_finished ? ".out" : ".in", region.data,
+                     region.size);
+  }
+}
+
+namespace {
+
+// Header of a checkpoint file, which is followed by the size of each written
+// region and then their content.
+struct checkpoint_header {
+  char magic[8];
+  int64_t time_ns;
+  uint64_t region_count;
+};
+
+constexpr char kCheckpointMagic[8] = {'T', 'A', 'P', 'A', 'C', 'K', 'P', '1'};
+
+// Mixes `size` bytes at `data` into `digest`, eight bytes at a time, so that
+// large mmaps are hashed at memory speed.
+uint64_t mix_digest(uint64_t digest, const void* data, size_t size) {
+  constexpr uint64_t kPrime = 0x100000001b3;
+  auto ptr = static_cast<const unsigned char*>(data);
+  uint64_t word;
+  for (; size >= sizeof(word); ptr += sizeof(word), size -= sizeof(word)) {
+    memcpy(&word, ptr, sizeof(word));
+    digest = (digest ^ word) * kPrime;
+    digest ^= digest >> 29;
+  }
+  word = 0;
+  memcpy(&word, ptr, size);
+  digest = (digest ^ word ^ (uint64_t(size) << 56)) * kPrime;
+  return digest ^ (digest >> 29);
+}
+
+template <typename T>
+uint64_t mix_digest(uint64_t digest, const T& value) {
+  return mix_digest(digest, &value, sizeof(value));
+}
+
+// Returns a digest of the code at `addr`, which is stable across runs of the
+// same binary despite address space layout randomization, and changes once
+// the binary is rebuilt.
+uint64_t get_code_digest(const void* addr) {
+  const uint64_t target = reinterpret_cast<uintptr_t>(addr);
+  uint64_t digest = mix_digest(0xcbf29ce484222325, target);
+  std::ifstream maps("/proc/self/maps");
+  for (std::string line; std::getline(maps, line);) {
+    uint64_t begin, end, offset;
+    char path[PATH_MAX] = "";
+    if (sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64 " %*s %" SCNx64
+                             " %*s %*s %4095s",
+               &begin, &end, &offset, path) < 3 ||
+        target < begin || target >= end) {
+      continue;
+    }
+    digest = mix_digest(0xcbf29ce484222325, target - begin + offset);
+    digest = mix_digest(digest, path, strlen(path));
+    struct stat st;
+    if (*path == '/' && ::stat(path, &st) == 0) {
+      digest = mix_digest(digest, st.st_size);
+      digest = mix_digest(digest, st.st_mtim);
+    }
+    break;
+  }
+  return digest;
+}
+
+}  // namespace
+
+std::unique_ptr<checkpoint> checkpoint::create(const void* func) {
+  static const char* const dir = getenv("TAPA_CHECKPOINT_DIR");
+  if (dir == nullptr || *dir == '\0') return nullptr;
+  if (::mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    LOG(FATAL) << "cannot create " << dir << ": " << std::strerror(errno);
+  }
+  return std::make_unique<checkpoint>(dir, get_code_digest(func));
+}
+
+void checkpoint::add_value(int index, const void* data, size_t size) {
+  this->digest = mix_digest(this->digest, index);
+  this->digest = mix_digest(this->digest, data, size);
+}
+
+void checkpoint::add_opaque(int index) {
+  if (this->is_enabled) {
+    LOG(WARNING) << "argument #" << index << " cannot be checkpointed; "
+                 << "checkpoint disabled for this invocation";
+  }
+  this->is_enabled = false;
+}
+
+void checkpoint::add_region(int index, void* data, size_t size, bool is_read,
+                            bool is_written) {
+  this->digest = mix_digest(this->digest, index);
+  this->digest = mix_digest(this->digest, size);
+  if (is_read) this->digest = mix_digest(this->digest, data, size);
+  if (is_written) this->regions.push_back({data, size});
+}
+
+std::string checkpoint::get_path() const {
+  char name[32];
+  snprintf(name, sizeof(name), "%016" PRIx64 ".ckpt", this->digest);
+  return this->dir + "/" + name;
+}
+
+bool checkpoint::restore(int64_t& time_ns) const {
+  if (!this->is_enabled) return false;
+  const std::string path = this->get_path();
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  // Checks everything before any region is overwritten.
+  checkpoint_header header;
+  std::vector<uint64_t> sizes(this->regions.size());
+  uint64_t expected_size = sizeof(header) + sizes.size() * sizeof(sizes[0]);
+  for (auto& region : this->regions) expected_size += region.size;
+  struct stat st;
+  bool is_valid =
+      ::fstat(fd, &st) == 0 && uint64_t(st.st_size) == expected_size &&
+      ::read(fd, &header, sizeof(header)) == sizeof(header) &&
+      memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) == 0 &&
+      header.region_count == sizes.size();
+  if (is_valid && !sizes.empty()) {
+    const ssize_t sizes_bytes = sizes.size() * sizeof(sizes[0]);
+    is_valid = ::read(fd, sizes.data(), sizes_bytes) == sizes_bytes;
+    for (size_t i = 0; is_valid && i < sizes.size(); ++i) {
+      is_valid = sizes[i] == this->regions[i].size;
+    }
+  }
+  for (auto& region : this->regions) {
+    auto ptr = static_cast<char*>(region.data);
+    for (size_t size = region.size; is_valid && size > 0;) {
+      const ssize_t bytes = ::read(fd, ptr, size);
+      if (bytes < 0 && errno == EINTR) continue;
+      if (bytes <= 0) {
+        LOG(FATAL) << "cannot read " << path << ": " << std::strerror(errno);
+      }
+      ptr += bytes;
+      size -= bytes;
+    }
+  }
+  ::close(fd);
+
+  if (!is_valid) {
+    LOG(WARNING) << "ignoring invalid checkpoint " << path;
+    return false;
+  }
+  time_ns = header.time_ns;
+  LOG(INFO) << "restored software simulation from checkpoint " << path;
+  return true;
+}
+
+void checkpoint::save(int64_t time_ns) const {
+  if (!this->is_enabled) return;
+  const std::string path = this->get_path();
+  const std::string tmp_path = path + ".tmp." + std::to_string(::getpid());
+  const int fd = open_capture_file(tmp_path);
+  checkpoint_header header;
+  memcpy(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+  header.time_ns = time_ns;
+  header.region_count = this->regions.size();
+  write_capture_file(fd, tmp_path, &header, sizeof(header));
+  for (auto& region : this->regions) {
+    const uint64_t size = region.size;
+    write_capture_file(fd, tmp_path, &size, sizeof(size));
+  }
+  for (auto& region : this->regions) {
+    write_capture_file(fd, tmp_path, region.data, region.size);
+  }
+  // Renaming makes the checkpoint visible only once it is complete.
+  if (::close(fd) != 0 || ::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    LOG(ERROR) << "cannot save checkpoint " << path << ": "
+               << std::strerror(errno);
+    ::unlink(tmp_path.c_str());
+    return;
+  }
+  LOG(INFO) << "saved software simulation checkpoint " << path;
+}
+
+namespace {
+
+// Ring buffer in memory shared by the processes of a distributed simulation,
+// which carries the tokens of a stream whose producer and consumer run in
+// different processes. Indices are in tokens and keep incrementing.
+struct process_ring {
+  static constexpr size_t kBytes = 64 * 1024;
+
+  alignas(64) std::atomic<uint64_t> head;  // written by the sender
+  alignas(64) std::atomic<uint64_t> tail;  // written by the receiver
+  alignas(64) unsigned char data[kBytes];
+};
+
+// Rings are mapped before the processes are forked, since each process finds
+// the streams between processes on its own. Pages are backed once used.
+constexpr size_t kMaxProcessRings = 4096;
+
+// A task invoked by the top-level task, which is deferred until all of them are
+// known so that all processes partition them in the same way.
+struct deferred_task {
+  bool detach;
+  bool thread;
+  thunk f;
+  std::vector<channel_t> channels;
+  task_id id;
+};
+
+// A stream accessed by deferred tasks. Streams of a broadcast_stream or a
+// distribute_stream are one, since they are written together.
+struct deferred_stream {
+  base_queue* queue;
+  uint64_t depth;
+  std::vector<size_t> tasks;  // that access the stream, maybe duplicated
+  int64_t producer = -1;      // task that writes the stream, if only one
+  int64_t consumer = -1;      // task that reads the stream, if only one
+  bool is_carried = true;     // whether tokens can be carried by a ring
+};
+
+// Relays of the streams between processes for a top-level task. Senders drain
+// their streams once the tasks of this process finish; receivers stop after
+// that.
+struct relay_state {
+  std::vector<base_queue*> queues;
+  std::atomic<size_t> sender_count{0};
+  std::atomic_bool is_draining{false};
+  std::atomic_bool is_drained{false};
+};
+
+// Software simulation distributed among processes via `TAPA_PROCESSES`.
+struct {
+  int rank = 0;
+  int count = 1;
+  std::thread::id top_thread;  // Invokes the top-level task.
+  process_ring* rings = nullptr;
+  size_t ring_count = 0;  // Rings used, which are never reused.
+  std::vector<deferred_task> tasks;
+  bool has_deferred = false;  // Whether any task has been deferred.
+  std::shared_ptr<relay_state> relays;
+} processes;
+
+// Returns the number of processes among which software simulation is
+// distributed, which can be set via environment variable `TAPA_PROCESSES`.
+int get_process_count() {
+  const char* env = getenv("TAPA_PROCESSES");
+  return env == nullptr ? 1 : std::max(atoi(env), 1);
+}
+
+// Moves the tokens written to `queue` in this process to `ring` until the
+// tasks of this process finish and `queue` is drained. A producer that is an
+// upper-level task finishes before its children do, so it is not waited for.
+void send_tokens(base_queue* queue, process_ring* ring, relay_state& state) {
+  const std::string msg =
+      "ring of channel '" + queue->get_name() + "' is full";
+  const size_t size = queue->get_token_size();
+  const uint64_t capacity = process_ring::kBytes / size;
+  for (;;) {
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+    const uint64_t offset = head % capacity;
+    const uint64_t room =
+        capacity - (head - ring->tail.load(std::memory_order_acquire));
+    const uint64_t n = queue->pop_bytes(ring->data + offset * size,
+                                        std::min(room, capacity - offset));
+    if (n != 0) {
+      ring->head.store(head + n, std::memory_order_release);
+    } else if (state.is_draining && queue->empty()) {
+      --state.sender_count;
+      return;
+    }
+    if (n == 0 && room == 0) {
+      yield(msg);  // The receiver runs in another process; poll the ring.
+    } else {
+      yield(&queue->consumers, queue->get_name(), channel_state::kEmpty);
+    }
+  }
+}
+
+// Moves the tokens in `ring` to `queue` in this process until the tasks of this
+// process finish.
+void receive_tokens(base_queue* queue, process_ring* ring,
+                    const relay_state& state) {
+  const std::string msg =
+      "ring of channel '" + queue->get_name() + "' is empty";
+  const size_t size = queue->get_token_size();
+  const uint64_t capacity = process_ring::kBytes / size;
+  while (!state.is_drained) {
+    const uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    const uint64_t offset = tail % capacity;
+    const uint64_t count = ring->head.load(std::memory_order_acquire) - tail;
+    const uint64_t n = queue->push_bytes(ring->data + offset * size,
+                                         std::min(count, capacity - offset));
+    if (n != 0) ring->tail.store(tail + n, std::memory_order_release);
+    if (n == 0 && count == 0) {
+      yield(msg);  // The sender runs in another process; poll the ring.
+    } else {
+      yield(&queue->producers, queue->get_name(), channel_state::kFull);
+    }
+  }
+}
+
+// Finds the streams accessed by `tasks`, in the order they are first accessed.
+std::vector<deferred_stream> find_streams(
+    const std::vector<deferred_task>& tasks) {
+  std::vector<deferred_stream> streams;
+  std::unordered_map<const base_queue*, size_t> indices;
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    for (auto& channel : tasks[i].channels) {
+      auto queue = static_cast<base_queue*>(const_cast<void*>(channel.id));
+      auto inserted = indices.emplace(queue->get_origin(), streams.size());
+      if (inserted.second) {
+        streams.push_back({queue, channel.depth, /*tasks=*/{}});
+      }
+      auto& stream = streams[inserted.first->second];
+      stream.tasks.push_back(i);
+      if (queue != stream.queue || channel.end == channel_end::kUnknown) {
+        stream.is_carried = false;
+        continue;
+      }
+      auto& end = channel.end == channel_end::kProducer ? stream.producer
+                                                        : stream.consumer;
+      if (end >= 0 && end != static_cast<int64_t>(i)) stream.is_carried = false;
+      end = i;
+    }
+  }
+  for (auto& stream : streams) {
+    const size_t size = stream.queue->get_token_size();
+    if (size == 0 || size > process_ring::kBytes || stream.producer < 0 ||
+        stream.consumer < 0 || stream.producer == stream.consumer) {
+      stream.is_carried = false;
+    }
+  }
+  return streams;
+}
+
+// Assigns each task to a process. Tasks sharing a stream that cannot be carried
+// by a ring are kept together, and the groups of tasks are placed in the order
+// of invocation with linear deterministic greedy (LDG) partitioning, as
+// coroutines are placed on workers. Nothing but the order of invocation is
+// used, so that all processes find the same partition.
+std::vector<int> partition(const std::vector<deferred_task>& tasks,
+                           const std::vector<deferred_stream>& streams,
+                           int count) {
+  std::vector<size_t> parents(tasks.size());
+  for (size_t i = 0; i < tasks.size(); ++i) parents[i] = i;
+  std::function<size_t(size_t)> find = [&](size_t i) {
+    return parents[i] == i ? i : parents[i] = find(parents[i]);
+  };
+  std::vector<std::vector<size_t>> peers(tasks.size());  // via carried streams
+  for (auto& stream : streams) {
+    if (stream.is_carried) {
+      peers[stream.producer].push_back(&stream - streams.data());
+      peers[stream.consumer].push_back(&stream - streams.data());
+      continue;
+    }
+    for (auto task : stream.tasks) {
+      parents[find(task)] = find(stream.tasks.front());
+    }
+  }
+
+  std::vector<std::vector<size_t>> groups;
+  std::vector<int64_t> group_of_root(tasks.size(), -1);
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    auto& group = group_of_root[find(i)];
+    if (group < 0) {
+      group = groups.size();
+      groups.emplace_back();
+    }
+    groups[group].push_back(i);
+  }
+
+  std::vector<int> assignment(tasks.size(), -1);
+  std::vector<size_t> loads(count);
+  size_t total_load = 0;
+  for (auto& group : groups) {
+    std::vector<double> affinity(count);
+    for (auto task : group) {
+      for (auto idx : peers[task]) {
+        auto& stream = streams[idx];
+        const auto peer = stream.producer == static_cast<int64_t>(task)
+                              ? stream.consumer
+                              : stream.producer;
+        if (assignment[peer] >= 0) {
+          affinity[assignment[peer]] +=
+              1. / std::max<uint64_t>(stream.depth, 1);
+        }
+      }
+    }
+    const double capacity = static_cast<double>(total_load) / count + 1;
+    int best = 0;
+    double best_score = 0;
+    for (int p = 0; p < count; ++p) {
+      const double score = affinity[p] * (1 - loads[p] / capacity);
+      if (p == 0 || score > best_score ||
+          (score == best_score && loads[p] < loads[best])) {
+        best = p;
+        best_score = score;
+      }
+    }
+    for (auto task : group) assignment[task] = best;
+    loads[best] += group.size();
+    total_load += group.size();
+  }
+  return assignment;
+}
+
+}  // namespace
+
+bool defer_task(bool detach, bool thread, thunk& f,
+                const std::vector<channel_t>& channels, const task_id& id) {
+  if (processes.count <= 1 ||
+      std::this_thread::get_id() != processes.top_thread) {
+    return false;
+  }
+  processes.tasks.push_back({detach, thread, std::move(f), channels, id});
+  processes.has_deferred = true;
+  return true;
+}
+
+void schedule_deferred_tasks() {
+  if (processes.tasks.empty()) return;
+  std::vector<deferred_task> tasks;
+  tasks.swap(processes.tasks);
+  const auto streams = find_streams(tasks);
+  const auto assignment = partition(tasks, streams, processes.count);
+
+  std::vector<std::pair<const deferred_stream*, process_ring*>> rings;
+  for (auto& stream : streams) {
+    if (!stream.is_carried ||
+        assignment[stream.producer] == assignment[stream.consumer]) {
+      continue;
+    }
+    CHECK_LT(processes.ring_count, kMaxProcessRings)
+        << "too many streams between processes";
+    rings.emplace_back(&stream, processes.rings + processes.ring_count++);
+  }
+
+  // Tasks are scheduled as usual from now on, e.g., by the next top-level task.
+  const auto top_thread = processes.top_thread;
+  processes.top_thread = std::thread::id();
+  size_t task_count = 0;
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    if (assignment[i] != processes.rank) continue;
+    ++task_count;
+    auto& task = tasks[i];
+    if (task.thread) {
+      schedule_thread(std::move(task.f), task.channels, task.id);
+    } else {
+      schedule(task.detach, std::move(task.f), task.channels, task.id);
+    }
+  }
+  auto relays = std::make_shared<relay_state>();
+  for (auto& entry : rings) {
+    auto& stream = *entry.first;
+    auto queue = stream.queue;
+    auto ring = entry.second;
+    const std::vector<channel_t> channels = {{queue, stream.depth}};
+    if (assignment[stream.producer] == processes.rank) {
+      relays->queues.push_back(queue);
+      ++relays->sender_count;
+      schedule(
+          /*detach=*/true,
+          [queue, ring, relays] { send_tokens(queue, ring, *relays); },
+          channels, {"(sender)"});
+    } else if (assignment[stream.consumer] == processes.rank) {
+      relays->queues.push_back(queue);
+      schedule(
+          /*detach=*/true,
+          [queue, ring, relays] { receive_tokens(queue, ring, *relays); },
+          channels, {"(receiver)"});
+    }
+  }
+  if (!relays->queues.empty()) processes.relays = std::move(relays);
+  processes.top_thread = top_thread;
+  LOG(INFO) << "process " << processes.rank << " of " << processes.count
+            << " runs " << task_count << " of " << tasks.size()
+            << " task(s); " << rings.size()
+            << " stream(s) are carried between processes";
+}
+
+void drain_relays() {
+  // Relays are started by the thread that invokes the distributed top-level
+  // task only.
+  if (std::this_thread::get_id() != processes.top_thread) return;
+  auto relays = std::move(processes.relays);
+  if (relays == nullptr) return;
+  relays->is_draining = true;
+  for (auto queue : relays->queues) queue->consumers.notify();
+  while (relays->sender_count != 0) wait_for_progress();
+  relays->is_drained = true;
+  for (auto queue : relays->queues) queue->producers.notify();
+}
+
+void simulate_top_level(const std::function<void()>& f,
+                        const std::function<int()>& find_unshared_arg) {
+  const int count = get_process_count();
+  if (count <= 1) {
+    f();
+    return;
+  }
+  const int unshared_arg = find_unshared_arg();
+  if (unshared_arg >= 0) {
+    LOG(WARNING) << "mmap argument #" << unshared_arg
+                 << " of the top-level task is not allocated via "
+                 << "tapa::aligned_allocator, so updates would not be seen "
+                 << "across processes; ignoring TAPA_PROCESSES=" << count;
+    f();
+    return;
+  }
+
+  const size_t length = sizeof(process_ring) * kMaxProcessRings;
+  void* rings = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE,
+                       /*fd=*/-1, /*offset=*/0);
+  if (rings == MAP_FAILED) throw std::bad_alloc();
+  processes.count = count;
+  processes.rings = static_cast<process_ring*>(rings);
+  processes.top_thread = std::this_thread::get_id();
+
+  std::vector<pid_t> children;
+  for (int rank = 1; rank < count; ++rank) {
+    const pid_t pid = fork();
+    PCHECK(pid != -1) << "cannot fork process " << rank;
+    if (pid == 0) {
+      processes.rank = rank;
+      f();
+      exit(EXIT_SUCCESS);
+    }
+    children.push_back(pid);
+  }
+  f();
+  LOG_IF(WARNING, !processes.has_deferred)
+      << "the top-level task invoked no task, so it ran in each of the "
+      << count << " processes";
+  for (size_t i = 0; i < children.size(); ++i) {
+    int status = 0;
+    PCHECK(waitpid(children[i], &status, 0) == children[i]);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS)
+        << "process " << i + 1 << " of " << count << " failed";
+  }
+
+  ::munmap(rings, length);
+  processes.count = 1;
+  processes.rings = nullptr;
+  processes.ring_count = 0;
+  processes.top_thread = std::thread::id();
+  processes.has_deferred = false;
+}
+
+// Command sent from a `tapa::device_process` to its child process, which is in
+// memory shared by both.
+struct process_command {
+  enum state_t { kIdle, kInvoke, kDone, kExit };
+
+  static constexpr size_t kMaxArgs = 256;
+
+  pthread_mutex_t mtx;
+  pthread_cond_t cv;
+  state_t state = kIdle;
+  uint64_t arg_count = 0;
+  int64_t kernel_time_ns = 0;
+  instance::arg_t args[kMaxArgs];
+};
+
+namespace {
+
+// Serves commands from the parent process until it asks to exit.
+[[noreturn]] void serve(process_command* command,
+                        const std::string& bitstream) {
+  instance instance(bitstream);
+  pthread_mutex_lock(&command->mtx);
+  for (;;) {
+    while (command->state != process_command::kInvoke &&
+           command->state != process_command::kExit) {
+      pthread_cond_wait(&command->cv, &command->mtx);
+    }
+    if (command->state == process_command::kExit) break;
+
+    // The parent process waits, so the lock is not needed to run the kernel.
+    pthread_mutex_unlock(&command->mtx);
+    for (uint64_t i = 0; i < command->arg_count; ++i) {
+      const auto& arg = command->args[i];
+      CHECK(arg.set != nullptr) << "argument #" << i << " is not set";
+      arg.set(instance, i, arg);
+    }
+    instance.write_to_device();
+    instance.exec();
+    instance.read_from_device();
+    instance.finish();
+    const int64_t kernel_time_ns = instance.compute_time_ns();
+    pthread_mutex_lock(&command->mtx);
+
+    command->kernel_time_ns = kernel_time_ns;
+    command->state = process_command::kDone;
+    pthread_cond_broadcast(&command->cv);
+  }
+  pthread_mutex_unlock(&command->mtx);
+  exit(EXIT_SUCCESS);
+}
+
+}  // namespace
+
+}  // namespace internal
+
+device_process::device_process(const std::string& bitstream) {
+  if (bitstream.empty()) return;
+
+  command_ = new (internal::allocate(sizeof(internal::process_command)))
+      internal::process_command;
+  pthread_mutexattr_t mutex_attr;
+  pthread_mutexattr_init(&mutex_attr);
+  pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutex_init(&command_->mtx, &mutex_attr);
+  pthread_mutexattr_destroy(&mutex_attr);
+  pthread_condattr_t cond_attr;
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&command_->cv, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+
+  pid_ = fork();
+  PCHECK(pid_ != -1);
+  if (pid_ == 0) internal::serve(command_, bitstream);  // Child.
+}
+
+device_process::~device_process() {
+  if (command_ == nullptr) return;
+
+  pthread_mutex_lock(&command_->mtx);
+  command_->state = internal::process_command::kExit;
+  pthread_cond_broadcast(&command_->cv);
+  pthread_mutex_unlock(&command_->mtx);
+  int status = 0;
+  CHECK_EQ(waitpid(pid_, &status, 0), pid_);
+  CHECK(WIFEXITED(status));
+  CHECK_EQ(WEXITSTATUS(status), EXIT_SUCCESS);
+
+  pthread_cond_destroy(&command_->cv);
+  pthread_mutex_destroy(&command_->mtx);
+  command_->~process_command();
+  internal::deallocate(command_, sizeof(internal::process_command));
+}
+
+int64_t device_process::run(
+    const std::vector<internal::instance::arg_t>& args) {
+  using internal::process_command;
+  CHECK_LE(args.size(), process_command::kMaxArgs) << "too many arguments";
+
+  pthread_mutex_lock(&command_->mtx);
+  std::copy(args.begin(), args.end(), command_->args);
+  command_->arg_count = args.size();
+  command_->state = process_command::kInvoke;
+  pthread_cond_broadcast(&command_->cv);
+  while (command_->state != process_command::kDone) {
+    // Wakes up every second to find out if the child process has died.
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    ++deadline.tv_sec;
+    if (pthread_cond_timedwait(&command_->cv, &command_->mtx, &deadline) ==
+        ETIMEDOUT) {
+      int status = 0;
+      CHECK_EQ(waitpid(pid_, &status, WNOHANG), 0)
+          << "device process " << pid_ << " exited unexpectedly";
+    }
+  }
+  command_->state = process_command::kIdle;
+  const int64_t kernel_time_ns = command_->kernel_time_ns;
+  pthread_mutex_unlock(&command_->mtx);
+  return kernel_time_ns;
+}
+
+dispatcher::dispatcher(const std::vector<std::string>& bitstreams,
+                       int compute_units) {
+  CHECK_GT(compute_units, 0);
+  CHECK(!bitstreams.empty());
+  if (bitstreams.size() == 1 && bitstreams[0].empty()) return;
+
+  running_.resize(bitstreams.size());
+  for (size_t i = 0; i < bitstreams.size(); ++i) {
+    CHECK(!bitstreams[i].empty()) << "bitstream #" << i << " is empty";
+    for (int j = 0; j < compute_units; ++j) {
+      idle_.push_back(slots_.size());
+      slots_.push_back(
+          {std::make_unique<internal::instance>(bitstreams[i]), i});
+    }
+  }
+}
+
+size_t dispatcher::acquire() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  cv_.wait(lock, [this] { return !idle_.empty(); });
+  auto best = idle_.begin();
+  for (auto it = idle_.begin(); it != idle_.end(); ++it) {
+    if (running_[slots_[*it].bitstream] <
+        running_[slots_[*best].bitstream]) {
+      best = it;
+    }
+  }
+  const size_t idx = *best;
+  idle_.erase(best);
+  ++running_[slots_[idx].bitstream];
+  return idx;
+}
+
+void dispatcher::release(size_t idx) {
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    --running_[slots_[idx].bitstream];
+    idle_.push_back(idx);
+  }
+  cv_.notify_one();
+}
+
+namespace {
+
+double gbps(uint64_t bytes, int64_t ns) {
+  return ns > 0 ? double(bytes) / double(ns) : 0.;
+}
+
+}  // namespace
+
+uint64_t profile::load_bytes() const {
+  uint64_t bytes = 0;
+  for (auto& mmap : this->mmaps) {
+    if (mmap.to_device) bytes += mmap.bytes;
+  }
+  return bytes;
+}
+
+uint64_t profile::store_bytes() const {
+  uint64_t bytes = 0;
+  for (auto& mmap : this->mmaps) {
+    if (mmap.from_device) bytes += mmap.bytes;
+  }
+  return bytes;
+}
+
+double profile::load_gbps() const {
+  return gbps(this->load_bytes(), this->times.load_ns);
+}
+
+double profile::store_gbps() const {
+  return gbps(this->store_bytes(), this->times.store_ns);
+}
+
+double profile::kernel_gbps(const mmap_profile& mmap) const {
+  return gbps(mmap.bytes, this->times.compute_ns);
+}
+
+double profile::kernel_gbps() const {
+  uint64_t bytes = 0;
+  for (auto& mmap : this->mmaps) bytes += mmap.bytes;
+  return gbps(bytes, this->times.compute_ns);
+}
+
+void profile::write_json(std::ostream& os) const {
+  const auto flags = os.flags();
+  os << std::boolalpha << R"({"load_ns":)" << this->times.load_ns
+     << R"(,"compute_ns":)" << this->times.compute_ns << R"(,"store_ns":)"
+     << this->times.store_ns << R"(,"load_bytes":)" << this->load_bytes()
+     << R"(,"store_bytes":)" << this->store_bytes() << R"(,"load_gbps":)"
+     << this->load_gbps() << R"(,"store_gbps":)" << this->store_gbps()
+     << R"(,"kernel_gbps":)" << this->kernel_gbps() << R"(,"mmaps":[)";
+  for (size_t i = 0; i < this->mmaps.size(); ++i) {
+    const auto& mmap = this->mmaps[i];
+    os << (i == 0 ? "" : ",") << R"({"index":)" << mmap.index
+       << R"(,"bytes":)" << mmap.bytes << R"(,"to_device":)" << mmap.to_device
+       << R"(,"from_device":)" << mmap.from_device << R"(,"kernel_gbps":)"
+       << this->kernel_gbps(mmap) << "}";
+  }
+  os << "]}";
+  os.flags(flags);
+}
+
+void latency_histogram::add(int64_t ns) {
+  if (!samples_.empty() && ns < samples_.back()) is_sorted_ = false;
+  samples_.push_back(ns);
+}
+
+int64_t latency_histogram::percentile(double p) const {
+  if (samples_.empty()) return 0;
+  if (!is_sorted_) {
+    std::sort(samples_.begin(), samples_.end());
+    is_sorted_ = true;
+  }
+  const auto rank = static_cast<uint64_t>(std::ceil(p / 100. * count()));
+  return samples_[std::min(std::max(rank, uint64_t{1}), count()) - 1];
+}
+
+double latency_histogram::mean() const {
+  if (samples_.empty()) return 0.;
+  double sum = 0.;
+  for (auto ns : samples_) sum += ns;
+  return sum / count();
+}
+
+void latency_histogram::write_json(std::ostream& os) const {
+  os << R"({"count":)" << count() << R"(,"mean_ns":)" << mean()
+     << R"(,"min_ns":)" << min() << R"(,"p50_ns":)" << percentile(50.)
+     << R"(,"p90_ns":)" << percentile(90.) << R"(,"p99_ns":)"
+     << percentile(99.) << R"(,"p999_ns":)" << percentile(99.9)
+     << R"(,"max_ns":)" << max() << "}";
+}
+
+void bench_result::write_json(std::ostream& os) const {
+  os << R"({"load":)";
+  this->load.write_json(os);
+  os << R"(,"compute":)";
+  this->compute.write_json(os);
+  os << R"(,"store":)";
+  this->store.write_json(os);
+  os << R"(,"total":)";
+  this->total.write_json(os);
+  os << "}";
+}
+
+uint64_t simulated_cycles() { return internal::simulated_cycle_count; }
+
+double mmap_access_stats::mean_run(const direction& dir) {
+  uint64_t runs = 0;
+  for (auto& kv : dir.runs) runs += kv.second;
+  return runs > 0 ? double(dir.elements) / runs : 0.;
+}
+
+void mmap_access_stats::write_json(std::ostream& os) const {
+  const auto write_histogram = [&os](const auto& histogram) {
+    os << "{";
+    for (auto it = histogram.begin(); it != histogram.end(); ++it) {
+      os << (it == histogram.begin() ? "" : ",") << '"' << it->first
+         << R"(":)" << it->second;
+    }
+    os << "}";
+  };
+  const auto write_direction = [&](const direction& dir) {
+    os << R"({"requests":)" << dir.requests << R"(,"elements":)"
+       << dir.elements << R"(,"footprint":)" << dir.footprint
+       << R"(,"mean_run":)" << mean_run(dir) << R"(,"strides":)";
+    write_histogram(dir.strides);
+    os << R"(,"runs":)";
+    write_histogram(dir.runs);
+    os << "}";
+  };
+  char ptr[32];
+  snprintf(ptr, sizeof(ptr), "%p", this->ptr);
+  os << R"({"ptr":")" << ptr << R"(","size":)" << this->size
+     << R"(,"width":)" << this->width << R"(,"read":)";
+  write_direction(this->read);
+  os << R"(,"write":)";
+  write_direction(this->write);
+  os << R"(,"reuse":)";
+  write_histogram(this->reuse);
+  os << "}";
+}
+
+std::vector<mmap_access_stats> access_stats() {
+  auto& registry = internal::mmap_profile_registry::get();
+  std::unique_lock<std::mutex> lock(registry.mtx);
+  std::vector<mmap_access_stats> result;
+  result.reserve(registry.entries.size());
+  for (auto& kv : registry.entries) {
+    std::unique_lock<std::mutex> lock(kv.second->mtx);
+    result.push_back(kv.second->stats);
+  }
+  return result;
+}
+
+std::vector<stream_stats> stats() {
+  auto& registry = internal::stats_registry;
+  std::unique_lock<std::mutex> lock(registry.mtx);
+  auto entries = registry.entries;
+  for (auto counter : registry.counters) {
+    const auto stats = counter->get();
+    internal::accumulate(entries[stats.name], stats);
+  }
+  std::vector<stream_stats> result;
+  result.reserve(entries.size());
+  for (auto& kv : entries) result.push_back(std::move(kv.second));
+  return result;
+}
 
-}  // namespace internal
 }  // namespace tapa
@@ -53,14 +53,20 @@ struct dummy {
 #define VLOG_FIRST_N(level, n) ::tapa::internal::dummy()
 #else  // __SYNTHESIS__
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <iterator>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -71,45 +77,215 @@ struct dummy {
 #include <frt.h>
 #include <glog/logging.h>
 
+#ifdef TAPA_FAST_AP_INT
+#include "tapa/fast_int.h"
+#endif  // TAPA_FAST_AP_INT
+
 #endif  // __SYNTHESIS__
 
+#include "tapa/buffer.h"
+#include "tapa/capture.h"
+#include "tapa/checkpoint.h"
+#include "tapa/command.h"
+#include "tapa/hash_table.h"
+#include "tapa/host_layout.h"
+#include "tapa/interleave.h"
+#include "tapa/local_array.h"
 #include "tapa/mmap.h"
 #include "tapa/stream.h"
 #include "tapa/traits.h"
+#include "tapa/transfer.h"
 #include "tapa/util.h"
 #include "tapa/vec.h"
+#include "tapa/work_queue.h"
 
 namespace tapa {
 
 #ifndef __SYNTHESIS__
 
+/// Time spent in each stage of an invocation on the device.
+struct invocation_times {
+  int64_t load_ns = 0;     ///< Host-to-device transfer time in nanoseconds.
+  int64_t compute_ns = 0;  ///< Kernel time in nanoseconds.
+  int64_t store_ns = 0;    ///< Device-to-host transfer time in nanoseconds.
+};
+
+/// Data transferred for an mmap argument of an invocation on the device.
+struct mmap_profile {
+  int index = 0;             ///< Position of the argument.
+  uint64_t bytes = 0;        ///< Size of the mmap in bytes.
+  bool to_device = false;    ///< Whether it is copied to the device.
+  bool from_device = false;  ///< Whether it is copied back to the host.
+};
+
+/// Profile of an invocation on the device.
+///
+/// Bandwidth is in GB/s, i.e., bytes per nanosecond. The kernel bandwidth of
+/// an mmap assumes that the kernel accesses each of its bytes once, which
+/// holds for streaming kernels, e.g., @c apps/bandwidth.
+struct profile {
+  invocation_times times;
+  std::vector<mmap_profile> mmaps;  ///< In the order of the arguments.
+
+  /// Bytes copied to the device.
+  uint64_t load_bytes() const;
+
+  /// Bytes copied back to the host.
+  uint64_t store_bytes() const;
+
+  /// Host-to-device bandwidth.
+  double load_gbps() const;
+
+  /// Device-to-host bandwidth.
+  double store_gbps() const;
+
+  /// Kernel bandwidth of @c mmap.
+  double kernel_gbps(const mmap_profile& mmap) const;
+
+  /// Kernel bandwidth of all mmaps.
+  double kernel_gbps() const;
+
+  /// Writes the profile as a single-line JSON object.
+  void write_json(std::ostream& os) const;
+};
+
 namespace internal {
 
 void* allocate(size_t length);
 void deallocate(void* addr, size_t length);
 
+// Pins `length` bytes of page-aligned memory at `ptr`. Returns false with a
+// warning if the memory is not page-aligned or cannot be pinned.
+bool register_buffer(const void* ptr, size_t length);
+void unregister_buffer(const void* ptr);
+
+// Maps the file open as `fd`, whose size must be a multiple of `elem_size`, and
+// stores its size in bytes to `length`. Returns nullptr if the file is empty.
+void* map_file(int fd, size_t elem_size, bool writable, bool populate,
+               size_t& length);
+void* map_file(const std::string& path, size_t elem_size, bool writable,
+               bool populate, size_t& length);
+void unmap_file(void* addr, size_t length);
+
+// Returns whether `length` bytes at `ptr` are in shared mappings, e.g., those
+// of `allocate` and `map_file`, so that forked processes see their updates.
+bool is_shared_memory(const void* ptr, size_t length);
+
+// Returns the profile of the invocation that just finished on `instance`, and
+// appends it to the file at `TAPA_PROFILE` if set.
+profile get_profile(const instance& instance);
+
+// Runs `f`, which invokes the top-level task, in software simulation. If
+// environment variable `TAPA_PROCESSES` is set to N > 1, the simulation is
+// distributed among N processes on this host: each process runs `f`, the tasks
+// invoked by the top-level task are partitioned by the streams among them, and
+// each process runs its own partition. Tokens of streams between processes are
+// carried in batches by rings in shared memory, so their types must be
+// trivially copyable; streams that cannot be carried, e.g., broadcast ones,
+// keep their tasks in the same process. The mmap pointers MUST be allocated via
+// `tapa::aligned_allocator`, or the updates of other processes won't be seen;
+// if `find_unshared_arg` returns the index of such an mmap argument rather
+// than -1, the simulation runs in this process only.
+void simulate_top_level(const std::function<void()>& f,
+                        const std::function<int()>& find_unshared_arg);
+
+// Returns whether argument `arg` of the top-level task is accessible from all
+// processes; see `simulate_top_level`.
+template <typename T>
+inline bool is_shared_arg(const T&) {
+  return true;
+}
+
+template <typename T>
+inline bool is_shared_mmap(const mmap<T>& arg) {
+  return arg.size() == 0 ||
+         is_shared_memory(arg.get(), arg.size() * sizeof(T));
+}
+
+template <typename T, uint64_t S>
+inline bool is_shared_mmaps(mmaps<T, S> arg) {
+  for (uint64_t i = 0; i < S; ++i) {
+    if (!is_shared_mmap(arg[i])) return false;
+  }
+  return true;
+}
+
+#define TAPA_DEFINE_IS_SHARED_ARG(tag)                      \
+  template <typename T>                                     \
+  inline bool is_shared_arg(const tag##_mmap<T>& arg) {     \
+    return is_shared_mmap(arg);                             \
+  }                                                         \
+  template <typename T, uint64_t S>                         \
+  inline bool is_shared_arg(const tag##_mmaps<T, S>& arg) { \
+    return is_shared_mmaps<T, S>(arg);                      \
+  }
+TAPA_DEFINE_IS_SHARED_ARG(placeholder)
+TAPA_DEFINE_IS_SHARED_ARG(read_only)
+TAPA_DEFINE_IS_SHARED_ARG(write_only)
+TAPA_DEFINE_IS_SHARED_ARG(read_write)
+TAPA_DEFINE_IS_SHARED_ARG(host)
+#undef TAPA_DEFINE_IS_SHARED_ARG
+
+// Returns the index of the first argument of the top-level task that is not
+// accessible from all processes, or -1 if there is none.
+template <typename... Args>
+inline int find_unshared_arg(const Args&... args) {
+  int index = 0;
+  const bool is_shared = ((is_shared_arg(args) && ++index > 0) && ...);
+  return is_shared ? -1 : index;
+}
+
 template <typename T>
 struct invoker;
 
 template <typename... Params>
 struct invoker<void (&)(Params...)> {
   template <typename... Args>
-  static void invoke(bool detach, void (&f)(Params...), Args&&... args) {
-    // std::bind creates a copy of args
-    internal::schedule(detach, std::bind(f, accessor<Params, Args>::access(
-                                                std::forward<Args>(args))...));
+  static void invoke(int mode, const char* name, void (&f)(Params...),
+                     Args&&... args) {
+    // the tuple holds a copy of args; braced initialization accesses args in
+    // order, so that slices of the same stream array passed as multiple args
+    // are taken in the order of the params
+    std::tuple<typename std::decay<decltype(accessor<Params, Args>::access(
+        std::forward<Args>(args)))>::type...>
+        bound_args{accessor<Params, Args>::access(std::forward<Args>(args))...};
+    const task_id id = {name, reinterpret_cast<const void*>(&f)};
+    auto capture = capture::create(id);
+    if (capture != nullptr) {
+      capture_args(*capture, bound_args,
+                   std::index_sequence_for<Params...>());
+    }
+    std::vector<channel_t> channels;
+    std::apply(
+        [&channels](const auto&... args) {
+          (add_channels(channels, args), ...);
+        },
+        bound_args);
+    thunk task;
+    if (capture == nullptr) {
+      task = [&f, bound_args = std::move(bound_args)]() mutable {
+        std::apply(f, bound_args);
+      };
+    } else {
+      task = [&f, bound_args = std::move(bound_args),
+              capture = std::move(capture)]() mutable {
+        capture->snapshot(/*is_finished=*/false);
+        std::apply(f, bound_args);
+        capture->snapshot(/*is_finished=*/true);
+      };
+    }
+    if (mode >= 0 && (mode & dedicated_thread)) {
+      internal::schedule_thread(std::move(task), channels, id);
+    } else {
+      internal::schedule(/*detach=*/mode < 0, std::move(task), channels, id);
+    }
   }
 
   template <typename... Args>
   static int64_t invoke(bool run_in_new_process, void (&f)(Params...),
                         const std::string& bitstream, Args&&... args) {
     if (bitstream.empty()) {
-      LOG(INFO) << "running software simulation with TAPA library";
-      const auto tic = std::chrono::steady_clock::now();
-      f(std::forward<Args>(args)...);
-      const auto toc = std::chrono::steady_clock::now();
-      return std::chrono::duration_cast<std::chrono::nanoseconds>(toc - tic)
-          .count();
+      return simulate(f, std::forward<Args>(args)...);
     } else {
       if (run_in_new_process) {
         auto kernel_time_ns_raw = allocate(sizeof(int64_t));
@@ -135,20 +311,69 @@ struct invoker<void (&)(Params...)> {
     }
   }
 
- private:
+  // Runs `f` on the device and returns the profile. In software simulation,
+  // only the kernel time is profiled.
   template <typename... Args>
-  static int64_t invoke(void (&f)(Params...), const std::string& bitstream,
-                        Args&&... args) {
-    auto instance = fpga::Instance(bitstream);
+  static profile invoke_with_profile(void (&f)(Params...),
+                                     const std::string& bitstream,
+                                     Args&&... args) {
+    if (bitstream.empty()) {
+      profile profile;
+      profile.times.compute_ns = simulate(f, std::forward<Args>(args)...);
+      return profile;
+    }
+    internal::instance instance(bitstream);
+    start(instance, f, std::forward<Args>(args)...);
+    instance.finish();
+    return get_profile(instance);
+  }
+
+  // Sets the arguments of `f` on `instance`.
+  template <typename... Args>
+  static void set_args(instance& instance, void (&f)(Params...),
+                       Args&&... args) {
     int idx = 0;
     int _[] = {(
         accessor<Params, Args>::access(instance, idx, std::forward<Args>(args)),
         0)...};
-    instance.WriteToDevice();
-    instance.Exec();
-    instance.ReadFromDevice();
-    instance.Finish();
-    return instance.ComputeTimeNanoSeconds();
+  }
+
+  // Starts running `f` on a loaded bitstream without waiting for it to finish.
+  template <typename... Args>
+  static void start(instance& instance, void (&f)(Params...), Args&&... args) {
+    set_args(instance, f, std::forward<Args>(args)...);
+    instance.write_to_device();
+    instance.exec();
+    instance.read_from_device();
+  }
+
+ private:
+  template <typename... Args>
+  static int64_t invoke(void (&f)(Params...), const std::string& bitstream,
+                        Args&&... args) {
+    return invoke_with_profile(f, bitstream, std::forward<Args>(args)...)
+        .times.compute_ns;
+  }
+
+  template <typename... Args>
+  static int64_t simulate(void (&f)(Params...), Args&&... args) {
+    auto checkpoint =
+        internal::checkpoint::create(reinterpret_cast<const void*>(&f));
+    if (checkpoint != nullptr) {
+      checkpoint_args(*checkpoint, args...);
+      int64_t time_ns;
+      if (checkpoint->restore(time_ns)) return time_ns;
+    }
+    LOG(INFO) << "running software simulation with TAPA library";
+    const auto tic = std::chrono::steady_clock::now();
+    simulate_top_level([&] { f(std::forward<Args>(args)...); },
+                       [&] { return find_unshared_arg(args...); });
+    const auto toc = std::chrono::steady_clock::now();
+    const int64_t time_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(toc - tic)
+            .count();
+    if (checkpoint != nullptr) checkpoint->save(time_ns);
+    return time_ns;
   }
 };
 
@@ -211,6 +436,15 @@ struct task {
                         std::forward<Args>(args)...);
   }
 
+  /// Invokes a task and instantiates a named child task instance.
+  ///
+  /// In software simulation, the stats of tasks logged when environment
+  /// variable @c TAPA_TASK_STATS is set to 1 are grouped by @c name.
+  ///
+  /// @param func Task function definition of the instantiated child.
+  /// @param name Name of the child task instance.
+  /// @param args Arguments passed to @c func.
+  /// @return     Reference to the caller @c tapa::task.
   template <typename Func, typename... Args, size_t name_size>
   task& invoke(Func&& func, const char (&name)[name_size], Args&&... args) {
     return invoke<join>(std::forward<Func>(func), name,
@@ -223,8 +457,7 @@ struct task {
     f(std::forward<Args>(args)...);
 #else   // __SYNTHESIS__
     internal::invoker<Func>::template invoke<Args...>(
-        /* detach= */ mode < 0, std::forward<Func>(func),
-        std::forward<Args>(args)...);
+        mode, name, std::forward<Func>(func), std::forward<Args>(args)...);
 #endif  // __SYNTHESIS__
     return *this;
   }
@@ -246,7 +479,7 @@ struct task {
   template <int mode, int n, typename Func, typename... Args, size_t name_size>
   task& invoke(Func&& func, const char (&name)[name_size], Args&&... args) {
     for (int i = 0; i < n; ++i) {
-      invoke<mode>(std::forward<Func>(func), std::forward<Args>(args)...);
+      invoke<mode>(std::forward<Func>(func), name, std::forward<Args>(args)...);
     }
     return *this;
   }
@@ -256,6 +489,18 @@ struct seq {
   int pos = 0;
 };
 
+/// Wraps a scalar argument of the top-level task that the bitstream is
+/// specialized for via <tt>tapac --specialize-scalar</tt>. The argument is
+/// passed as is in software simulation, but is not set on the device, whose
+/// kernel no longer has it. @c value should be what the bitstream is
+/// specialized for; this is not checked.
+template <typename T>
+struct specialized {
+  T value;
+
+  operator T() const { return value; }
+};
+
 #ifndef __SYNTHESIS__
 
 namespace internal {
@@ -263,23 +508,39 @@ namespace internal {
 template <typename Param, typename Arg>
 struct accessor {
   static Param access(Arg&& arg) { return arg; }
-  static void access(fpga::Instance& instance, int& idx, Arg&& arg) {
-    instance.SetArg(idx++, static_cast<Param>(arg));
+  static void access(instance& instance, int& idx, Arg&& arg) {
+    instance.set_arg(idx++, static_cast<Param>(arg));
   }
 };
 
 template <typename T>
 struct accessor<T, seq> {
   static T access(seq&& arg) { return arg.pos++; }
-  static void access(fpga::Instance& instance, int& idx, seq&& arg) {
-    instance.SetArg(idx++, static_cast<T>(arg.pos++));
+  static void access(instance& instance, int& idx, seq&& arg) {
+    instance.set_arg(idx++, static_cast<T>(arg.pos++));
   }
 };
 
+template <typename T, typename U>
+struct accessor<T, specialized<U>> {
+  static T access(specialized<U>&& arg) { return arg; }
+  static void access(instance& instance, int& idx, specialized<U>&& arg) {}
+};
+
+template <typename T, typename U>
+struct accessor<T, specialized<U>&> {
+  static T access(specialized<U>& arg) { return arg; }
+  static void access(instance& instance, int& idx, specialized<U>& arg) {}
+};
+
 }  // namespace internal
 
 // Host-only invoke that takes path to a bistream file as an argument. Returns
-// the kernel time in nanoseconds.
+// the kernel time in nanoseconds. Software simulation may be distributed among
+// processes via environment variable `TAPA_PROCESSES`; see
+// `internal::simulate_top_level`. It may also be checkpointed and restored via
+// environment variable `TAPA_CHECKPOINT_DIR`; see `internal::checkpoint`.
+// Threads may run software simulations concurrently.
 template <typename Func, typename... Args>
 inline int64_t invoke(Func&& f, const std::string& bitstream, Args&&... args) {
   return internal::invoker<Func>::template invoke<Args...>(
@@ -287,6 +548,24 @@ inline int64_t invoke(Func&& f, const std::string& bitstream, Args&&... args) {
       std::forward<Args>(args)...);
 }
 
+/// Host-only invoke that takes path to a bitstream file as an argument.
+///
+/// If environment variable @c TAPA_PROFILE is set to a path, the profile of
+/// each invocation on the device via this, @c tapa::invoke, or
+/// @c tapa::device is appended to that file as a line of JSON.
+///
+/// @param f         Top-level task function.
+/// @param bitstream Path to the bitstream file, or empty for software
+///                  simulation, in which only the kernel time is profiled.
+/// @param args      Arguments passed to @c f.
+/// @return          Profile of the invocation.
+template <typename Func, typename... Args>
+inline profile invoke_with_profile(Func&& f, const std::string& bitstream,
+                                   Args&&... args) {
+  return internal::invoker<Func>::template invoke_with_profile<Args...>(
+      std::forward<Func>(f), bitstream, std::forward<Args>(args)...);
+}
+
 // Workaround for the fact that Xilinx's cosim cannot run for more than once in
 // each process. The mmap pointers MUST be allocated via mmap, or the updates
 // won't be seen by the caller process!
@@ -298,6 +577,526 @@ inline int64_t invoke_in_new_process(Func&& f, const std::string& bitstream,
       std::forward<Args>(args)...);
 }
 
+namespace internal {
+
+// An invocation that may still be running on `instance`.
+struct invocation_state {
+  instance* running = nullptr;  // Instance running it; null once finished.
+  invocation_times times;
+
+  void finish() {
+    if (this->running == nullptr) return;
+    this->running->finish();
+    this->times = get_profile(*this->running).times;
+    this->running = nullptr;
+  }
+};
+
+}  // namespace internal
+
+/// Refers to an invocation started by @c tapa::device::invoke_async.
+class invocation {
+ public:
+  /// Waits for the invocation to finish.
+  ///
+  /// This may be called more than once.
+  ///
+  /// @return Time spent in each stage of the invocation.
+  invocation_times wait() {
+    state_->finish();
+    return state_->times;
+  }
+
+ private:
+  friend class device;
+  friend class kernel_graph;
+  explicit invocation(std::shared_ptr<internal::invocation_state> state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<internal::invocation_state> state_;
+};
+
+/// Keeps a bitstream loaded across invocations.
+///
+/// Consecutive invocations skip programming the device, and each mmap argument
+/// that refers to the same host memory in the same direction as in the last
+/// invocation on the same slot reuses its device buffer. Data are still
+/// transferred in each invocation.
+///
+/// Each slot runs one invocation at a time with its own device buffers.
+/// Invocations on different slots may overlap, e.g., with 3 slots, the
+/// host-to-device transfer of batch @c i+1 may overlap the execution of batch
+/// @c i and the device-to-host transfer of batch @c i-1. If the bitstream is
+/// generated with `tapac --ap-ctrl-chain`, the execution of batch @c i+1 may
+/// also start before that of batch @c i finishes.
+///
+/// If the bitstream is empty, each invocation runs software simulation
+/// synchronously instead.
+class device {
+ public:
+  /// Loads a bitstream.
+  ///
+  /// @param bitstream Path to the bitstream file, or empty for software
+  ///                  simulation.
+  /// @param slots     Maximum number of invocations in flight.
+  explicit device(const std::string& bitstream, int slots = 1) {
+    CHECK_GT(slots, 0);
+    if (!bitstream.empty()) {
+      slots_.resize(slots);
+      for (auto& slot : slots_) {
+        slot.instance.reset(new internal::instance(bitstream));
+      }
+    }
+  }
+
+  device(const device&) = delete;
+  device& operator=(const device&) = delete;
+
+  /// Whether invocations run software simulation.
+  bool is_simulated() const { return slots_.empty(); }
+
+  /// Loads another bitstream on every slot after their invocations finish,
+  /// e.g., a variant of a design built with `tapac --reconfigurable-instance`
+  /// that loads other tasks into its reconfigurable partitions while the
+  /// static design stays the same. The device buffers of the previous
+  /// bitstream are not reused. How long loading takes depends on the platform
+  /// and on whether the bitstream is partial.
+  ///
+  /// In software simulation, this does nothing, since each invocation simulates
+  /// the task passed to it.
+  ///
+  /// @param bitstream Path to the bitstream file.
+  void reconfigure(const std::string& bitstream) {
+    CHECK(!bitstream.empty());
+    for (auto& slot : slots_) {
+      if (slot.last != nullptr) slot.last->finish();
+      slot.last = nullptr;
+      slot.instance.reset();  // Releases the device before loading it again.
+      slot.instance.reset(new internal::instance(bitstream));
+    }
+    next_slot_ = 0;
+  }
+
+  /// Waits for all invocations to finish.
+  ~device() {
+    for (auto& slot : slots_) {
+      if (slot.last != nullptr) slot.last->finish();
+    }
+  }
+
+  /// Invokes a task on the loaded bitstream and waits for it to finish.
+  ///
+  /// @param f    Top-level task function.
+  /// @param args Arguments passed to @c f.
+  /// @return     Kernel time in nanoseconds.
+  template <typename Func, typename... Args>
+  int64_t invoke(Func&& f, Args&&... args) {
+    if (slots_.empty()) {
+      return tapa::invoke(std::forward<Func>(f), "",
+                          std::forward<Args>(args)...);
+    }
+    return invoke_async(std::forward<Func>(f), std::forward<Args>(args)...)
+        .wait()
+        .compute_ns;
+  }
+
+  /// Invokes a task on the loaded bitstream without waiting for it to finish.
+  ///
+  /// Invocations use slots in turn. If the next slot is still running an
+  /// invocation, that invocation is waited for first. Host memory referenced
+  /// by @c args must not be modified until the invocation finishes.
+  ///
+  /// @param f    Top-level task function.
+  /// @param args Arguments passed to @c f.
+  /// @return     The invocation started.
+  template <typename Func, typename... Args>
+  invocation invoke_async(Func&& f, Args&&... args) {
+    auto state = std::make_shared<internal::invocation_state>();
+    if (slots_.empty()) {
+      state->times.compute_ns = tapa::invoke(std::forward<Func>(f), "",
+                                             std::forward<Args>(args)...);
+      return invocation(std::move(state));
+    }
+    auto& slot = slots_[next_slot_];
+    next_slot_ = (next_slot_ + 1) % slots_.size();
+    if (slot.last != nullptr) slot.last->finish();
+    internal::invoker<Func>::template start<Args...>(
+        *slot.instance, std::forward<Func>(f), std::forward<Args>(args)...);
+    state->running = slot.instance.get();
+    slot.last = state;
+    return invocation(std::move(state));
+  }
+
+ private:
+  struct slot_t {
+    std::unique_ptr<internal::instance> instance;
+    std::shared_ptr<internal::invocation_state> last;
+  };
+
+  std::vector<slot_t> slots_;  // Empty for software simulation.
+  size_t next_slot_ = 0;
+};
+
+/// Dispatches invocations from concurrent threads among loaded bitstreams.
+///
+/// Each bitstream, e.g., one per card, is loaded once per compute unit of the
+/// top-level task, which may be replicated via `tapac --compute-units`, so
+/// that as many invocations run on it at a time. Each invocation runs on an
+/// idle instance of the bitstream with the fewest invocations in flight, and
+/// waits if all instances are busy. Like @c tapa::device, instances stay
+/// loaded, and each mmap argument that refers to the same host memory in the
+/// same direction as in the last invocation on the same instance reuses its
+/// device buffer.
+///
+/// If the bitstream is empty, each invocation runs software simulation, and
+/// invocations from different threads are simulated concurrently.
+class dispatcher {
+ public:
+  /// Loads a bitstream.
+  ///
+  /// @param bitstream     Path to the bitstream file, or empty for software
+  ///                      simulation.
+  /// @param compute_units Number of compute units of the top-level task.
+  explicit dispatcher(const std::string& bitstream, int compute_units = 1)
+      : dispatcher(std::vector<std::string>{bitstream}, compute_units) {}
+
+  /// Loads bitstreams, e.g., one for each card.
+  ///
+  /// @param bitstreams    Paths to the bitstream files.
+  /// @param compute_units Number of compute units of the top-level task in
+  ///                      each bitstream.
+  dispatcher(const std::vector<std::string>& bitstreams, int compute_units);
+
+  dispatcher(const dispatcher&) = delete;
+  dispatcher& operator=(const dispatcher&) = delete;
+
+  /// Invokes a task on an idle instance and waits for it to finish. This may
+  /// be called by several threads concurrently.
+  ///
+  /// @param f    Top-level task function.
+  /// @param args Arguments passed to @c f.
+  /// @return     Kernel time in nanoseconds.
+  template <typename Func, typename... Args>
+  int64_t invoke(Func&& f, Args&&... args) {
+    if (slots_.empty()) {
+      return tapa::invoke(std::forward<Func>(f), "",
+                          std::forward<Args>(args)...);
+    }
+    const size_t idx = acquire();
+    auto& instance = *slots_[idx].instance;
+    internal::invoker<Func>::template start<Args...>(
+        instance, std::forward<Func>(f), std::forward<Args>(args)...);
+    instance.finish();
+    const int64_t compute_ns = internal::get_profile(instance).times.compute_ns;
+    release(idx);
+    return compute_ns;
+  }
+
+ private:
+  struct slot_t {
+    std::unique_ptr<internal::instance> instance;
+    size_t bitstream;  // Index of the bitstream loaded by the instance.
+  };
+
+  // Waits for an idle instance and returns its index.
+  size_t acquire();
+
+  // Makes the instance at `idx` idle again.
+  void release(size_t idx);
+
+  std::vector<slot_t> slots_;  // Empty for software simulation.
+
+  // Guarded by `mtx_`.
+  std::vector<size_t> idle_;     // Indices of idle instances.
+  std::vector<size_t> running_;  // Invocations in flight on each bitstream.
+  std::mutex mtx_;
+  std::condition_variable cv_;
+};
+
+/// Time spent in an invocation sharded across devices.
+struct sharded_invocation_times {
+  /// Time spent in each stage of the shard on each device.
+  std::vector<invocation_times> shards;
+
+  /// Wall time from starting the first shard to finishing all shards in
+  /// nanoseconds.
+  int64_t total_ns = 0;
+};
+
+/// Invokes a task on several devices, each of which processes a shard of the
+/// arguments.
+///
+/// Shards on different devices run concurrently. Shards in software simulation
+/// run one after another. Each device keeps its bitstream loaded, so the same
+/// devices may be reused to invoke more shards.
+///
+/// Canonical usage, which splits @c a and @c c evenly across devices:
+/// @code{.cpp}
+///  auto times = tapa::invoke_sharded(
+///      VecAdd, {&dev0, &dev1}, [&](size_t i, size_t n) {
+///        const uint64_t len = size / n;
+///        return std::make_tuple(
+///            tapa::read_only_mmap<const float>(a).slice(i * len, len),
+///            tapa::write_only_mmap<float>(c).slice(i * len, len), len);
+///      });
+/// @endcode
+///
+/// @param f          Top-level task function.
+/// @param devices    Devices with the bitstream loaded.
+/// @param shard_args Partitioning policy: <tt>shard_args(i, n)</tt> returns a
+///                   @c std::tuple of the arguments passed to @c f on
+///                   <tt>devices[i]</tt>, where @c n is the number of devices.
+/// @return           Time spent in each shard and in total.
+template <typename Func, typename ShardArgs>
+sharded_invocation_times invoke_sharded(Func&& f,
+                                        const std::vector<device*>& devices,
+                                        ShardArgs&& shard_args) {
+  std::vector<invocation> invocations;
+  invocations.reserve(devices.size());
+  const auto tic = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < devices.size(); ++i) {
+    invocations.push_back(std::apply(
+        [&](auto&&... args) {
+          return devices[i]->invoke_async(
+              f, std::forward<decltype(args)>(args)...);
+        },
+        shard_args(i, devices.size())));
+  }
+  sharded_invocation_times times;
+  times.shards.reserve(invocations.size());
+  for (auto& invocation : invocations) {
+    times.shards.push_back(invocation.wait());
+  }
+  const auto toc = std::chrono::steady_clock::now();
+  times.total_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(toc - tic).count();
+  return times;
+}
+
+/// Time spent in an invocation split into chunks.
+struct chunked_invocation_times {
+  /// Time spent in each stage of each chunk.
+  std::vector<invocation_times> chunks;
+
+  /// Wall time from starting the first chunk to finishing all chunks in
+  /// nanoseconds.
+  int64_t total_ns = 0;
+};
+
+/// Invokes a task once per chunk of inputs that do not fit in device memory
+/// at once, e.g., a graph or a sparse matrix larger than HBM.
+///
+/// Chunks run in order on the slots of @c dev in turn, so with 2 slots, the
+/// host-to-device transfer of chunk @c i+1 overlaps the execution of chunk
+/// @c i, and device memory holds the buffers of at most 2 chunks. Arguments
+/// that are not sliced, e.g., a vector read by every chunk, refer to the same
+/// host memory in each chunk and reuse the device buffers of each slot. In
+/// software simulation, chunks run one after another.
+///
+/// Canonical usage, which processes @c a and @c c in chunks of @c kChunk
+/// elements, passing the offset of each chunk as a scalar:
+/// @code{.cpp}
+///  tapa::device dev(bitstream, /*slots=*/2);
+///  auto times = tapa::invoke_chunked(
+///      Scale, dev, size, kChunk, [&](uint64_t offset, uint64_t length) {
+///        return std::make_tuple(
+///            tapa::read_only_mmap<const float>(a).slice(offset, length),
+///            tapa::write_only_mmap<float>(c).slice(offset, length), offset,
+///            length);
+///      });
+/// @endcode
+///
+/// @param f          Top-level task function.
+/// @param dev        Device with the bitstream loaded.
+/// @param size       Number of items to process.
+/// @param chunk_size Maximum number of items per chunk.
+/// @param chunk_args Chunking policy: <tt>chunk_args(offset, length)</tt>
+///                   returns a @c std::tuple of the arguments passed to @c f
+///                   for the @c length items starting from @c offset.
+/// @return           Time spent in each chunk and in total.
+template <typename Func, typename ChunkArgs>
+chunked_invocation_times invoke_chunked(Func&& f, device& dev, uint64_t size,
+                                        uint64_t chunk_size,
+                                        ChunkArgs&& chunk_args) {
+  CHECK_GT(chunk_size, 0);
+  std::vector<invocation> invocations;
+  invocations.reserve((size + chunk_size - 1) / chunk_size);
+  const auto tic = std::chrono::steady_clock::now();
+  for (uint64_t offset = 0; offset < size; offset += chunk_size) {
+    const uint64_t length = std::min(chunk_size, size - offset);
+    invocations.push_back(std::apply(
+        [&](auto&&... args) {
+          return dev.invoke_async(f, std::forward<decltype(args)>(args)...);
+        },
+        chunk_args(offset, length)));
+  }
+  chunked_invocation_times times;
+  times.chunks.reserve(invocations.size());
+  for (auto& invocation : invocations) {
+    times.chunks.push_back(invocation.wait());
+  }
+  const auto toc = std::chrono::steady_clock::now();
+  times.total_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(toc - tic).count();
+  return times;
+}
+
+/// Distribution of a latency over repeated invocations.
+class latency_histogram {
+ public:
+  /// Records a latency in nanoseconds.
+  void add(int64_t ns);
+
+  /// Number of latencies recorded.
+  uint64_t count() const { return samples_.size(); }
+
+  /// Latency at percentile @c p in [0, 100], using the nearest-rank method, or
+  /// 0 if none is recorded.
+  int64_t percentile(double p) const;
+
+  int64_t min() const { return percentile(0.); }    ///< Minimum latency.
+  int64_t max() const { return percentile(100.); }  ///< Maximum latency.
+  double mean() const;                               ///< Mean latency.
+
+  /// Writes the count, mean, and common percentiles as a JSON object.
+  void write_json(std::ostream& os) const;
+
+ private:
+  mutable std::vector<int64_t> samples_;
+  mutable bool is_sorted_ = true;
+};
+
+/// Latencies of repeated invocations measured by @c tapa::bench.
+struct bench_result {
+  latency_histogram load;     ///< Host-to-device transfer time.
+  latency_histogram compute;  ///< Kernel time.
+  latency_histogram store;    ///< Device-to-host transfer time.
+  latency_histogram total;    ///< Wall time of each invocation.
+
+  /// Writes the histograms as a single-line JSON object.
+  void write_json(std::ostream& os) const;
+};
+
+/// Options of @c tapa::bench.
+struct bench_options {
+  int warmup = 1;        ///< Invocations run first and not measured.
+  int iterations = 100;  ///< Invocations measured.
+};
+
+/// Invokes a task repeatedly on a device and measures the latency of each
+/// stage, e.g., to validate the tail latency of an online service.
+///
+/// Invocations run one at a time on the same device, so that the bitstream
+/// stays loaded and device buffers are reused. In software simulation, only
+/// the kernel time and the wall time are measured.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  tapa::device device(bitstream);
+///  auto result = tapa::bench(device, {/*warmup=*/10, /*iterations=*/1000},
+///                            VecAdd, tapa::read_only_mmap<const float>(a),
+///                            tapa::write_only_mmap<float>(c), n);
+///  LOG(INFO) << "p99: " << result.total.percentile(99) << " ns";
+/// @endcode
+///
+/// @param device  Device with the bitstream loaded.
+/// @param options Numbers of invocations.
+/// @param f       Top-level task function.
+/// @param args    Arguments passed to @c f in each invocation.
+/// @return        Latencies of the measured invocations.
+template <typename Func, typename... Args>
+bench_result bench(device& device, const bench_options& options, Func&& f,
+                   Args&&... args) {
+  CHECK_GE(options.warmup, 0);
+  CHECK_GT(options.iterations, 0);
+  bench_result result;
+  for (int i = 0; i < options.warmup + options.iterations; ++i) {
+    // Arguments passed as rvalues are copied so that they can be passed again.
+    const auto tic = std::chrono::steady_clock::now();
+    const auto times =
+        device.invoke_async(f, static_cast<Args>(args)...).wait();
+    const auto toc = std::chrono::steady_clock::now();
+    if (i < options.warmup) continue;
+    result.load.add(times.load_ns);
+    result.compute.add(times.compute_ns);
+    result.store.add(times.store_ns);
+    result.total.add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(toc - tic)
+            .count());
+  }
+  return result;
+}
+
+namespace internal {
+
+struct process_command;
+
+}  // namespace internal
+
+/// Runs invocations of a bitstream in a child process that is forked once.
+///
+/// Like @c tapa::invoke_in_new_process, this keeps the bitstream out of the
+/// caller process, but the same child process serves all invocations, so the
+/// bitstream is loaded and the simulator is launched only once for many test
+/// vectors. This requires a tool that can run more than once in each process;
+/// Xilinx's cosim cannot, which still needs @c tapa::invoke_in_new_process.
+///
+/// The mmap pointers MUST be allocated via @c tapa::aligned_allocator before
+/// the @c tapa::device_process is constructed, or updates made by either
+/// process won't be seen by the other! Scalar arguments are copied bitwise.
+///
+/// If the bitstream is empty, each invocation runs software simulation in the
+/// caller process instead.
+class device_process {
+ public:
+  /// Forks a child process that loads a bitstream.
+  ///
+  /// @param bitstream Path to the bitstream file, or empty for software
+  ///                  simulation.
+  explicit device_process(const std::string& bitstream);
+
+  device_process(const device_process&) = delete;
+  device_process& operator=(const device_process&) = delete;
+
+  /// Stops the child process.
+  ~device_process();
+
+  /// Invokes a task in the child process and waits for it to finish.
+  ///
+  /// @param f    Top-level task function.
+  /// @param args Arguments passed to @c f.
+  /// @return     Kernel time in nanoseconds.
+  template <typename Func, typename... Args>
+  int64_t invoke(Func&& f, Args&&... args) {
+    if (command_ == nullptr) {
+      return tapa::invoke(std::forward<Func>(f), "",
+                          std::forward<Args>(args)...);
+    }
+    std::vector<internal::instance::arg_t> recorded;
+    internal::instance recorder(&recorded);
+    internal::invoker<Func>::template set_args<Args...>(
+        recorder, std::forward<Func>(f), std::forward<Args>(args)...);
+    return run(recorded);
+  }
+
+ private:
+  int64_t run(const std::vector<internal::instance::arg_t>& args);
+
+  internal::process_command* command_ = nullptr;  // Shared with the child.
+  pid_t pid_ = 0;
+};
+
+/// Allocates page-aligned host buffers that are shared with child processes,
+/// e.g., those created by @c tapa::invoke_in_new_process.
+///
+/// Environment variables that tune the allocation of large buffers:
+///   - @c TAPA_HOST_HUGE_PAGES: if non-zero, buffers of at least 2 MiB are
+///     backed by huge pages (@c MAP_HUGETLB if any are reserved, transparent
+///     huge pages otherwise);
+///   - @c TAPA_HOST_NUMA_NODE: NUMA node to bind buffers to, or the PCI address
+///     of a card (e.g., @c 0000:3b:00.0) whose NUMA node is used;
+///   - @c TAPA_HOST_PREFAULT: if non-zero, buffers are faulted in when they are
+///     allocated instead of when they are first accessed.
 template <typename T>
 struct aligned_allocator {
   using value_type = T;
@@ -319,6 +1118,678 @@ struct aligned_allocator {
   }
 };
 
+/// Pins host memory reused by many invocations, e.g., a buffer allocated via
+/// @c tapa::aligned_allocator, so that its pages stay resident and are
+/// transferred in place without being faulted in again.
+///
+/// Devices transfer page-aligned memory in place. Other memory, e.g., the data
+/// of a @c std::vector with the default allocator, is copied through a bounce
+/// buffer by the runtime on each transfer, which @c tapa::invoke logs as a
+/// warning; such memory cannot be registered. Pinned memory counts towards
+/// @c RLIMIT_MEMLOCK.
+///
+/// @param ptr  Host memory to pin.
+/// @param size Number of elements to pin.
+/// @return     Whether the memory is page-aligned and pinned.
+template <typename T>
+bool register_buffer(T* ptr, uint64_t size) {
+  return internal::register_buffer(ptr, size * sizeof(T));
+}
+
+/// Pins the elements of @c container; see @c tapa::register_buffer.
+template <typename Container>
+bool register_buffer(Container& container) {
+  return register_buffer(container.data(), container.size());
+}
+
+/// Unpins host memory registered via @c tapa::register_buffer, which must be
+/// called before the memory is freed.
+template <typename T>
+void unregister_buffer(T* ptr) {
+  internal::unregister_buffer(ptr);
+}
+
+/// Maps a file into host memory, from which a @c tapa::mmap can be constructed
+/// without reading the file into a buffer first.
+///
+/// If @c T is const, the file is mapped read-only. Otherwise, updates of the
+/// mapped memory are written back to the file. The mapped memory is shared
+/// with child processes, e.g., those created by @c tapa::invoke_in_new_process.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  tapa::mapped_file<const Edge> edges("edges.bin");
+///  tapa::invoke(Graph, bitstream, tapa::read_only_mmap<const Edge>(edges),
+///               edges.size());
+/// @endcode
+template <typename T>
+class mapped_file {
+ public:
+  /// Maps the file at @c path.
+  ///
+  /// @param path     Path to the file, whose size must be a multiple of
+  ///                 @c sizeof(T).
+  /// @param populate If true, the whole file is read into the page cache when
+  ///                 it is mapped instead of when it is accessed.
+  explicit mapped_file(const std::string& path, bool populate = false) {
+    ptr_ = static_cast<T*>(internal::map_file(
+        path, sizeof(T), !std::is_const<T>::value, populate, bytes_));
+  }
+
+  /// Maps the file open as @c fd, which is not closed.
+  ///
+  /// @param fd       File descriptor of the file, whose size must be a
+  ///                 multiple of @c sizeof(T).
+  /// @param populate If true, the whole file is read into the page cache when
+  ///                 it is mapped instead of when it is accessed.
+  explicit mapped_file(int fd, bool populate = false) {
+    ptr_ = static_cast<T*>(internal::map_file(
+        fd, sizeof(T), !std::is_const<T>::value, populate, bytes_));
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  mapped_file(mapped_file&& other) noexcept
+      : ptr_(other.ptr_), bytes_(other.bytes_) {
+    other.ptr_ = nullptr;
+    other.bytes_ = 0;
+  }
+
+  mapped_file& operator=(mapped_file&& other) noexcept {
+    std::swap(ptr_, other.ptr_);
+    std::swap(bytes_, other.bytes_);
+    return *this;
+  }
+
+  /// Unmaps the file.
+  ~mapped_file() {
+    if (ptr_ != nullptr) {
+      internal::unmap_file(const_cast<void*>(static_cast<const void*>(ptr_)),
+                           bytes_);
+    }
+  }
+
+  /// Retrieves the start of the mapped memory, or @c nullptr if the file is
+  /// empty.
+  T* data() const { return ptr_; }
+
+  /// Retrieves the size of the mapped memory (in unit of element count).
+  uint64_t size() const { return bytes_ / sizeof(T); }
+
+ private:
+  T* ptr_ = nullptr;
+  size_t bytes_ = 0;
+};
+
+/// Stores an array of structs as a struct of arrays, i.e., one buffer per
+/// field, so that a kernel reads or writes only the fields it needs, each via
+/// its own @c tapa::mmap at full burst efficiency, possibly bound to a
+/// different memory channel.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  struct Edge { int src; int dst; float weight; };
+///  std::vector<Edge> edges = ...;
+///  tapa::soa_buffer soa(edges.data(), edges.size(), &Edge::src, &Edge::dst,
+///                       &Edge::weight);
+///  tapa::invoke(Graph, bitstream,
+///               tapa::read_only_mmap<const int>(soa.field<0>()),
+///               tapa::read_only_mmap<const int>(soa.field<1>()),
+///               tapa::read_write_mmap<float>(soa.field<2>()), soa.size());
+///  soa.gather(edges.data());  // writes the updated weights back
+/// @endcode
+///
+/// @tparam Struct Type of the structs.
+/// @tparam Fields Types of the fields stored, in order.
+template <typename Struct, typename... Fields>
+class soa_buffer {
+ public:
+  /// Type of the buffer storing field @c I.
+  template <size_t I>
+  using buffer_type = std::vector<
+      typename std::tuple_element<I, std::tuple<Fields...>>::type,
+      aligned_allocator<
+          typename std::tuple_element<I, std::tuple<Fields...>>::type>>;
+
+  /// Splits @c size structs at @c data into one buffer per field.
+  ///
+  /// @param data    Pointer to the array of structs.
+  /// @param size    Number of structs.
+  /// @param members Pointers to the fields to store, e.g., @c &Edge::src.
+  soa_buffer(const Struct* data, uint64_t size, Fields Struct::*... members)
+      : members_(members...), buffers_(buffer_type_of<Fields>(size)...) {
+    scatter(data);
+  }
+
+  /// Retrieves the number of structs.
+  uint64_t size() const { return std::get<0>(buffers_).size(); }
+
+  /// Retrieves the buffer of field @c I, which is suitable for constructing a
+  /// @c tapa::mmap.
+  template <size_t I>
+  buffer_type<I>& field() {
+    return std::get<I>(buffers_);
+  }
+
+  /// Retrieves the buffer of field @c I.
+  template <size_t I>
+  const buffer_type<I>& field() const {
+    return std::get<I>(buffers_);
+  }
+
+  /// Copies the fields of @c size() structs at @c data into the buffers.
+  void scatter(const Struct* data) {
+    scatter(data, std::index_sequence_for<Fields...>());
+  }
+
+  /// Copies the buffers into the fields of @c size() structs at @c data.
+  /// Fields not stored are left unchanged.
+  void gather(Struct* data) const {
+    gather(data, std::index_sequence_for<Fields...>());
+  }
+
+ private:
+  static_assert(sizeof...(Fields) > 0, "at least one field must be stored");
+
+  template <typename Field>
+  using buffer_type_of = std::vector<Field, aligned_allocator<Field>>;
+
+  template <size_t... I>
+  void scatter(const Struct* data, std::index_sequence<I...>) {
+    // Field by field so that each buffer is written sequentially.
+    (scatter_field<I>(data), ...);
+  }
+
+  template <size_t I>
+  void scatter_field(const Struct* data) {
+    auto& buffer = std::get<I>(buffers_);
+    const auto member = std::get<I>(members_);
+    for (uint64_t i = 0; i < buffer.size(); ++i) buffer[i] = data[i].*member;
+  }
+
+  template <size_t... I>
+  void gather(Struct* data, std::index_sequence<I...>) const {
+    (gather_field<I>(data), ...);
+  }
+
+  template <size_t I>
+  void gather_field(Struct* data) const {
+    const auto& buffer = std::get<I>(buffers_);
+    const auto member = std::get<I>(members_);
+    for (uint64_t i = 0; i < buffer.size(); ++i) data[i].*member = buffer[i];
+  }
+
+  std::tuple<Fields Struct::*...> members_;
+  std::tuple<buffer_type_of<Fields>...> buffers_;
+};
+
+/// Host-side end of a top-level @c tapa::istream or @c tapa::ostream port,
+/// which streams data between the host and a running kernel without staging
+/// them in device memory, e.g., over QDMA on streaming platforms.
+///
+/// On a device, the kernel must be invoked with @c tapa::device::invoke_async,
+/// so that the host can write and read while it runs. In software simulation,
+/// invocations run synchronously, so all tokens to the kernel must be written
+/// before the invocation, at most @c N of them, and tokens from the kernel are
+/// read after it.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  tapa::device dev(bitstream);
+///  tapa::host_stream<Packet> rx("rx"), tx("tx");
+///  auto invocation = dev.invoke_async(Forward, rx, tx);
+///  rx.write(packets.data(), packets.size());
+///  rx.close();
+///  tx.read(results.data(), results.size());
+///  invocation.wait();
+/// @endcode
+///
+/// @tparam T Type of the tokens.
+/// @tparam N Maximum number of tokens buffered in software simulation.
+template <typename T, uint64_t N = 65536>
+class host_stream {
+ public:
+  /// Constructs a host stream connected to the top-level port @c name.
+  explicit host_stream(const std::string& name) : name_(name), sim_() {
+    sim_.set_name(name);
+  }
+
+  host_stream(const host_stream&) = delete;
+  host_stream& operator=(const host_stream&) = delete;
+
+  /// Writes @c n tokens to the kernel, blocking until they are sent.
+  void write(const T* src, uint64_t n) {
+    if (to_device_ != nullptr) {
+      to_device_->Write(src, n, /*eot=*/false);
+      return;
+    }
+    CHECK(from_device_ == nullptr) << name_ << " is an output of the kernel";
+    for (uint64_t i = 0; i < n; ++i) {
+      CHECK(sim_.can_write())
+          << "host stream " << name_ << " is full; write at most " << N
+          << " tokens before invoking in software simulation";
+      sim_.write(src[i]);
+    }
+  }
+
+  /// Writes a token to the kernel.
+  void write(const T& value) { write(&value, 1); }
+
+  /// Writes an end-of-transaction token to the kernel.
+  void close() {
+    if (to_device_ != nullptr) {
+      to_device_->Write(nullptr, 0, /*eot=*/true);
+      return;
+    }
+    CHECK(from_device_ == nullptr) << name_ << " is an output of the kernel";
+    CHECK(sim_.can_write()) << "host stream " << name_ << " is full";
+    sim_.close();
+  }
+
+  /// Reads up to @c n tokens from the kernel, blocking until they arrive on a
+  /// device. Returns the number of tokens read, which is less than @c n only
+  /// if an end-of-transaction token arrives, or, in software simulation, if
+  /// the kernel has written fewer tokens.
+  uint64_t read(T* dst, uint64_t n) {
+    if (from_device_ != nullptr) {
+      from_device_->Read(dst, n, /*eot=*/false);
+      return n;
+    }
+    CHECK(to_device_ == nullptr) << name_ << " is an input of the kernel";
+    uint64_t i = 0;
+    for (bool is_eot = false; i < n; ++i) {
+      if (!sim_.can_read() || !sim_.try_eot(is_eot) || is_eot) break;
+      dst[i] = sim_.read(nullptr);
+    }
+    return i;
+  }
+
+  /// Reads a token from the kernel.
+  T read() {
+    T value;
+    CHECK_EQ(read(&value, 1), 1) << "no token left in " << name_;
+    return value;
+  }
+
+  // Software simulation calls the top-level task with these.
+  operator istream<T>&() { return sim_; }
+  operator ostream<T>&() { return sim_; }
+
+ private:
+  template <typename Param, typename Arg>
+  friend struct internal::accessor;
+
+  // Connects this stream to argument `idx` of `instance`; `to_device` tells
+  // whether the kernel reads from it.
+  void bind(internal::instance& instance, int idx, bool to_device) {
+    to_device_.reset();
+    from_device_.reset();
+    if (to_device) {
+      to_device_.reset(new fpga::WriteStream<T>(name_));
+      instance.set_stream_arg(idx, *to_device_);
+    } else {
+      from_device_.reset(new fpga::ReadStream<T>(name_));
+      instance.set_stream_arg(idx, *from_device_);
+    }
+  }
+
+  // The host is not a task, so it must not yield on a stream that is not
+  // ready, which the `full` and `empty` of streams may do.
+  class sim_stream : public stream<T, N> {
+   public:
+    sim_stream() : sim_stream(internal::make_queue<T, N>("")) {}
+
+    bool can_read() const { return !this->ptr->empty(); }
+    bool can_write() const { return !this->ptr->full(); }
+
+   private:
+    sim_stream(std::shared_ptr<internal::queue<internal::elem_t<T>>> owner)
+        : internal::basic_stream<T>(owner.get()), stream<T, N>(owner) {}
+  };
+
+  const std::string name_;
+  sim_stream sim_;  // Used in software simulation only.
+  // read/write are with respect to the kernel in tapa but host in frt
+  std::unique_ptr<fpga::WriteStream<T>> to_device_;
+  std::unique_ptr<fpga::ReadStream<T>> from_device_;
+};
+
+namespace internal {
+
+#define TAPA_DEFINE_ACCESSER(io, reference, to_device)                    \
+  template <typename T, uint64_t N>                                      \
+  struct accessor<io##stream<T> reference, host_stream<T, N>&> {         \
+    static io##stream<T> reference access(host_stream<T, N>& arg) {      \
+      return arg;                                                        \
+    }                                                                    \
+    static void access(instance& instance, int& idx,                     \
+                       host_stream<T, N>& arg) {                         \
+      arg.bind(instance, idx++, to_device);                              \
+    }                                                                    \
+  };
+
+TAPA_DEFINE_ACCESSER(i, , true)
+TAPA_DEFINE_ACCESSER(i, &, true)
+TAPA_DEFINE_ACCESSER(o, , false)
+TAPA_DEFINE_ACCESSER(o, &, false)
+
+#undef TAPA_DEFINE_ACCESSER
+
+}  // namespace internal
+
+/// Submits commands to a persistent kernel, i.e., a kernel invoked once that
+/// serves requests until the host stops it, so that no request pays for
+/// launching a kernel and state such as loaded weights or hash tables stays on
+/// chip between requests.
+///
+/// Commands are written to a ring buffer in host memory, and the number of
+/// commands submitted, i.e., the doorbell, is written after them. The kernel
+/// polls the doorbell via @c tapa::receive_commands, and reports each command
+/// completed via @c tapa::complete_commands, which must receive exactly one
+/// token per command. Pass the mmaps of this ring as @c tapa::host_mmap
+/// arguments, e.g., with `tapac --host-mmap`, and invoke the kernel with
+/// @c tapa::device::invoke_async or @c tapa::kernel_graph so that the host
+/// keeps running; in software simulation, only @c tapa::kernel_graph runs the
+/// kernel concurrently with the host.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  tapa::command_ring<Request> requests(64);
+///  tapa::kernel_graph graph;
+///  graph.invoke(dev, Serve, requests.doorbell(), requests.ring(),
+///               requests.capacity(), requests.completions(), results);
+///  for (auto& request : batch) requests.submit(request);
+///  requests.wait(requests.submitted());
+///  requests.stop();
+///  graph.wait();
+/// @endcode
+///
+/// @tparam T Type of the commands.
+template <typename T>
+class command_ring {
+ public:
+  /// Constructs a ring of @c capacity commands, which is the most commands
+  /// submitted but not completed.
+  explicit command_ring(uint64_t capacity)
+      : ring_(capacity), doorbell_(1, 0), completions_(1, 0) {
+    CHECK_GT(capacity, 0) << "command ring must not be empty";
+  }
+
+  command_ring(const command_ring&) = delete;
+  command_ring& operator=(const command_ring&) = delete;
+
+  /// Number of entries of the ring.
+  uint64_t capacity() const { return ring_.size(); }
+
+  /// Arguments of @c tapa::receive_commands and @c tapa::complete_commands.
+  host_mmap<const uint64_t> doorbell() { return {doorbell_.data(), 1}; }
+  host_mmap<const T> ring() { return {ring_.data(), ring_.size()}; }
+  host_mmap<uint64_t> completions() { return {completions_.data(), 1}; }
+
+  /// Submits @c command, blocking while the ring is full.
+  ///
+  /// @return Number of commands submitted so far, which is passed to @c wait
+  ///         to wait for this command.
+  uint64_t submit(const T& command) {
+    CHECK(!is_stopped_) << "command ring is stopped";
+    while (submitted_ - completed() >= capacity()) std::this_thread::yield();
+    ring_[submitted_ % capacity()] = command;
+    __atomic_store_n(doorbell_.data(), ++submitted_, __ATOMIC_RELEASE);
+    return submitted_;
+  }
+
+  /// Number of commands submitted.
+  uint64_t submitted() const { return submitted_; }
+
+  /// Number of commands completed by the kernel.
+  uint64_t completed() const {
+    return __atomic_load_n(completions_.data(), __ATOMIC_ACQUIRE);
+  }
+
+  /// Blocks until the first @c count commands are completed.
+  void wait(uint64_t count) const {
+    while (completed() < count) std::this_thread::yield();
+  }
+
+  /// Tells the kernel that no command follows, so that it returns once the
+  /// submitted commands are completed.
+  void stop() {
+    is_stopped_ = true;
+    __atomic_store_n(doorbell_.data(), submitted_ | internal::kCommandRingStop,
+                     __ATOMIC_RELEASE);
+  }
+
+ private:
+  std::vector<T, aligned_allocator<T>> ring_;
+  std::vector<uint64_t, aligned_allocator<uint64_t>> doorbell_;
+  std::vector<uint64_t, aligned_allocator<uint64_t>> completions_;
+  uint64_t submitted_ = 0;
+  bool is_stopped_ = false;
+};
+
+/// Host buffer of @c T that a kernel accesses as @c S banks, e.g., HBM
+/// channels, each holding every @c S-th granule of @c Granule elements, so
+/// that a single logical buffer gets the bandwidth of all banks. Kernels
+/// access it as a @c tapa::mmaps<T, S> via @c tapa::interleave_requests.
+///
+/// The buffer is scattered to the banks when constructed, or when @c scatter
+/// is called after the buffer changes, and gathered back when @c gather is
+/// called or the last copy of the @c tapa::interleaved_mmap is destroyed,
+/// e.g., after @c tapa::invoke returns if it is passed as a temporary. Keep it
+/// alive until a @c tapa::invoke_async finishes. The copies cost host memory
+/// bandwidth, but each bank is a buffer of its own on the device.
+///
+/// @tparam Granule Number of consecutive elements in each bank; must be a
+///                 power of 2.
+template <typename T, uint64_t S, uint64_t Granule>
+class interleaved_mmap : public mmaps<T, S> {
+  using bank_t = std::vector<T, aligned_allocator<T>>;
+
+  struct banks {
+    T* const ptr;
+    const uint64_t size;
+    std::array<bank_t, S> data;
+
+    // Allocates each bank with as many whole granules as the first bank.
+    banks(T* ptr, uint64_t size) : ptr(ptr), size(size) {
+      const uint64_t granules = (size + Granule - 1) / Granule;
+      const uint64_t bank_size = (granules + S - 1) / S * Granule;
+      for (auto& bank : data) bank.resize(std::max<uint64_t>(bank_size, 1));
+      copy(/*is_scatter=*/true);
+    }
+    banks(const banks&) = delete;
+    ~banks() { copy(/*is_scatter=*/false); }
+
+    void copy(bool is_scatter) {
+      std::array<T*, S> ptrs;
+      for (uint64_t i = 0; i < S; ++i) ptrs[i] = data[i].data();
+      internal::copy_banks<Granule>(ptr, size, ptrs, is_scatter);
+    }
+  };
+
+ public:
+  /// Constructs an interleaved buffer of the @c size elements at @c ptr.
+  interleaved_mmap(T* ptr, uint64_t size)
+      : interleaved_mmap(std::make_shared<banks>(ptr, size)) {}
+
+  /// Constructs an interleaved buffer of the elements of @c container.
+  template <typename Container>
+  explicit interleaved_mmap(Container& container)
+      : interleaved_mmap(std::data(container), std::size(container)) {}
+
+  /// Copies the buffer to the banks.
+  void scatter() { banks_->copy(/*is_scatter=*/true); }
+
+  /// Copies the banks back to the buffer.
+  void gather() { banks_->copy(/*is_scatter=*/false); }
+
+ private:
+  explicit interleaved_mmap(std::shared_ptr<banks> b)
+      : mmaps<T, S>(b->data), banks_(std::move(b)) {}
+
+  std::shared_ptr<banks> banks_;
+};
+
+namespace internal {
+
+template <typename T, uint64_t S, uint64_t Granule>
+struct accessor<mmaps<T, S>, interleaved_mmap<T, S, Granule>&> {
+  static void access(instance& instance, int& idx,
+                     interleaved_mmap<T, S, Granule>& arg) {
+    for (uint64_t i = 0; i < S; ++i) {
+      auto buf = fpga::ReadWrite(arg[i].get(), arg[i].size());
+      instance.set_buffer_arg(idx++, buf, arg[i].get(), arg[i].size());
+    }
+  }
+};
+
+template <typename T, uint64_t S, uint64_t Granule>
+struct accessor<mmaps<T, S>, interleaved_mmap<T, S, Granule>> {
+  static void access(instance& instance, int& idx,
+                     interleaved_mmap<T, S, Granule>&& arg) {
+    accessor<mmaps<T, S>, interleaved_mmap<T, S, Granule>&>::access(
+        instance, idx, arg);
+  }
+};
+
+}  // namespace internal
+
+/// Connects a top-level @c tapa::ostream port of one kernel to a top-level
+/// @c tapa::istream port of another, so that tokens flow between kernels
+/// without going through device memory.
+///
+/// On a device, the ports are connected in the bitstream, e.g., via
+/// `tapac --stream-connect` or `stream_connect` in the connectivity of `v++`,
+/// so the host passes nothing to either kernel. In software simulation, both
+/// kernels access the same stream. Invoke the kernels with
+/// @c tapa::kernel_graph so that they run concurrently.
+///
+/// @tparam T Type of the tokens.
+/// @tparam N Capacity of the stream in software simulation.
+template <typename T, uint64_t N = 2>
+class kernel_stream {
+ public:
+  explicit kernel_stream(const std::string& name) { stream_.set_name(name); }
+
+  kernel_stream(const kernel_stream&) = delete;
+  kernel_stream& operator=(const kernel_stream&) = delete;
+
+  // Software simulation calls the top-level tasks with these.
+  operator istream<T>&() { return stream_; }
+  operator ostream<T>&() { return stream_; }
+
+ private:
+  stream<T, N> stream_;
+};
+
+namespace internal {
+
+// Ports connected by a kernel stream are not arguments set by the host.
+#define TAPA_DEFINE_ACCESSER(io, reference)                                \
+  template <typename T, uint64_t N>                                       \
+  struct accessor<io##stream<T> reference, kernel_stream<T, N>&> {        \
+    static io##stream<T> reference access(kernel_stream<T, N>& arg) {     \
+      return arg;                                                         \
+    }                                                                     \
+    static void access(instance& instance, int& idx,                      \
+                       kernel_stream<T, N>& arg) {                        \
+      ++idx;                                                              \
+    }                                                                     \
+  };
+
+TAPA_DEFINE_ACCESSER(i, )
+TAPA_DEFINE_ACCESSER(i, &)
+TAPA_DEFINE_ACCESSER(o, )
+TAPA_DEFINE_ACCESSER(o, &)
+
+#undef TAPA_DEFINE_ACCESSER
+
+}  // namespace internal
+
+/// Runs kernels connected by @c tapa::kernel_stream concurrently, each on its
+/// own device, e.g., a decompressor feeding another kernel.
+///
+/// On devices, each kernel is invoked via @c tapa::device::invoke_async. In
+/// software simulation, the kernels are simulated together as the children of
+/// one top-level task, whose kernel time is reported for each of them.
+/// Arguments are copied when a kernel is invoked, except kernel streams, which
+/// must outlive the graph.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  tapa::device decompressor(decompressor_bitstream);
+///  tapa::device spmm(spmm_bitstream);
+///  tapa::kernel_stream<Packet> packets("packets");
+///  tapa::kernel_graph()
+///      .invoke(decompressor, Decompress,
+///              tapa::read_only_mmap<const uint8_t>(compressed), packets)
+///      .invoke(spmm, SpMM, packets, tapa::write_only_mmap<float>(out))
+///      .wait();
+/// @endcode
+class kernel_graph {
+ public:
+  kernel_graph() = default;
+
+  kernel_graph(const kernel_graph&) = delete;
+  kernel_graph& operator=(const kernel_graph&) = delete;
+
+  /// Waits for all kernels to finish.
+  ~kernel_graph() { wait(); }
+
+  /// Starts a kernel without waiting for it to finish.
+  ///
+  /// @param device Device with the bitstream of the kernel loaded.
+  /// @param f      Top-level task function.
+  /// @param args   Arguments passed to @c f.
+  /// @return       Reference to this graph.
+  template <typename Func, typename... Args>
+  kernel_graph& invoke(device& device, Func&& f, Args&&... args) {
+    if (!device.is_simulated()) {
+      invocations_.push_back(device.invoke_async(
+          std::forward<Func>(f), std::forward<Args>(args)...));
+      return *this;
+    }
+    if (simulation_ == nullptr) {
+      LOG(INFO) << "running software simulation with TAPA library";
+      simulation_start_ = std::chrono::steady_clock::now();
+      simulation_.reset(new task);
+    }
+    simulation_->invoke(std::forward<Func>(f), std::forward<Args>(args)...);
+    simulated_.push_back(std::make_shared<internal::invocation_state>());
+    invocations_.push_back(invocation(simulated_.back()));
+    return *this;
+  }
+
+  /// Waits for all kernels to finish.
+  ///
+  /// @return Time spent in each stage of each kernel, in the order they are
+  ///         invoked.
+  std::vector<invocation_times> wait() {
+    if (simulation_ != nullptr) {
+      simulation_.reset();  // Joins the kernels.
+      const int64_t compute_ns =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - simulation_start_)
+              .count();
+      for (auto& state : simulated_) state->times.compute_ns = compute_ns;
+      simulated_.clear();
+    }
+    std::vector<invocation_times> times;
+    times.reserve(invocations_.size());
+    for (auto& invocation : invocations_) times.push_back(invocation.wait());
+    return times;
+  }
+
+ private:
+  std::vector<invocation> invocations_;
+
+  // Top-level task of the kernels in software simulation, and their states.
+  std::unique_ptr<task> simulation_;
+  std::chrono::steady_clock::time_point simulation_start_;
+  std::vector<std::shared_ptr<internal::invocation_state>> simulated_;
+};
+
 #endif  // __SYNTHESIS__
 
 }  // namespace tapa
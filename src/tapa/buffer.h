@@ -0,0 +1,241 @@
+#ifndef TAPA_BUFFER_H_
+#define TAPA_BUFFER_H_
+
+#include <cstdint>
+
+#ifndef __SYNTHESIS__
+
+#include <vector>
+
+#include <glog/logging.h>
+
+#endif  // __SYNTHESIS__
+
+#include "tapa/stream.h"
+
+namespace tapa {
+
+namespace internal {
+
+// Operations of a buffer request; see `ping_pong_buffer.v`.
+enum buffer_op : uint8_t {
+  kBufferAcquire = 0,
+  kBufferRelease = 1,
+  kBufferLoad = 2,
+  kBufferStore = 3,
+};
+
+// Request of a buffer endpoint, packed with `op` as the LSB.
+template <typename T>
+struct buffer_request {
+  uint8_t op;
+  uint32_t addr;
+  T data;
+};
+
+#ifndef __SYNTHESIS__
+
+// Drops the sections left in a queue, which are expected once the consumer is
+// done, without waiting like `istream::read` does.
+class section_drain : public istream<uint64_t> {
+ public:
+  explicit section_drain(const istream<uint64_t>& queue)
+      : basic_stream<uint64_t>(queue), istream<uint64_t>(queue) {}
+
+  void clear() {
+    while (!this->ptr->empty()) this->ptr->try_pop([](auto&&) {});
+  }
+};
+
+// Sections of a buffer, and the queues of the free and full sections. The
+// producer takes a section from `free` and puts it in `full` once written; the
+// consumer does the opposite.
+template <typename T, uint64_t Size, uint64_t Sections>
+struct buffer_storage {
+  buffer_storage() : data(Size * Sections) {
+    for (uint64_t i = 0; i < Sections; ++i) free.write(i);
+  }
+  ~buffer_storage() { section_drain(free).clear(); }
+
+  std::vector<T> data;
+  stream<uint64_t, Sections> free{"buffer.free"};
+  stream<uint64_t, Sections> full{"buffer.full"};
+};
+
+// Endpoint of a buffer, which accesses one section at a time.
+template <typename T, uint64_t Size>
+class basic_buffer {
+ public:
+  /// Waits for a section and makes it the current section.
+  void acquire() {
+    CHECK(!is_acquired()) << "a section of the buffer is already acquired";
+    section_ = acquire_.read();
+  }
+
+  /// Hands the current section over to the other endpoint.
+  void release() {
+    CHECK(is_acquired()) << "no section of the buffer is acquired";
+    release_.write(section_);
+    section_ = kNone;
+  }
+
+  /// Returns the element at @c addr of the current section.
+  T load(uint64_t addr) const { return data_[index(addr)]; }
+
+  /// Sets the element at @c addr of the current section to @c value.
+  void store(uint64_t addr, const T& value) { data_[index(addr)] = value; }
+
+  // scheduling helpers
+  std::vector<channel_t> get_channels() const {
+    return {acquire_.get_channel(), release_.get_channel()};
+  }
+
+ protected:
+  basic_buffer(T* data, const istream<uint64_t>& acquire,
+               const ostream<uint64_t>& release)
+      : acquire_(acquire), release_(release), data_(data) {}
+
+ private:
+  static constexpr uint64_t kNone = ~uint64_t(0);
+
+  bool is_acquired() const { return section_ != kNone; }
+
+  uint64_t index(uint64_t addr) const {
+    CHECK(is_acquired()) << "no section of the buffer is acquired";
+    CHECK_LT(addr, Size);
+    return section_ * Size + addr;
+  }
+
+  istream<uint64_t> acquire_;
+  ostream<uint64_t> release_;
+  T* data_;
+  uint64_t section_ = kNone;
+};
+
+#endif  // __SYNTHESIS__
+
+}  // namespace internal
+
+/// Defines the consumer endpoint of a @c tapa::buffer.
+///
+/// The consumer acquires sections in the order the producer releases them.
+/// Loads and stores access the acquired section; in hardware, each load waits
+/// for its data, so loads are not pipelined.
+template <typename T, uint64_t Size>
+#ifdef __SYNTHESIS__
+struct ibuffer {
+  tapa::ostream<internal::buffer_request<T>> request;
+  tapa::istream<T> response;
+
+  void acquire() {
+    request.write({internal::kBufferAcquire, 0, T()});
+    response.read();
+  }
+  void release() { request.write({internal::kBufferRelease, 0, T()}); }
+  T load(uint64_t addr) {
+    request.write({internal::kBufferLoad, uint32_t(addr), T()});
+    return response.read();
+  }
+  void store(uint64_t addr, const T& value) {
+    request.write({internal::kBufferStore, uint32_t(addr), value});
+  }
+};
+#else   // __SYNTHESIS__
+class ibuffer : public internal::basic_buffer<T, Size> {
+ protected:
+  ibuffer(T* data, const istream<uint64_t>& full,
+          const ostream<uint64_t>& free)
+      : internal::basic_buffer<T, Size>(data, full, free) {}
+};
+#endif  // __SYNTHESIS__
+
+/// Defines the producer endpoint of a @c tapa::buffer.
+///
+/// The producer acquires free sections, fills them, and releases them to the
+/// consumer. Loads and stores access the acquired section.
+template <typename T, uint64_t Size>
+#ifdef __SYNTHESIS__
+struct obuffer {
+  tapa::ostream<internal::buffer_request<T>> request;
+  tapa::istream<T> response;
+
+  void acquire() {
+    request.write({internal::kBufferAcquire, 0, T()});
+    response.read();
+  }
+  void release() { request.write({internal::kBufferRelease, 0, T()}); }
+  T load(uint64_t addr) {
+    request.write({internal::kBufferLoad, uint32_t(addr), T()});
+    return response.read();
+  }
+  void store(uint64_t addr, const T& value) {
+    request.write({internal::kBufferStore, uint32_t(addr), value});
+  }
+};
+#else   // __SYNTHESIS__
+class obuffer : public internal::basic_buffer<T, Size> {
+ protected:
+  obuffer(T* data, const istream<uint64_t>& free,
+          const ostream<uint64_t>& full)
+      : internal::basic_buffer<T, Size>(data, free, full) {}
+};
+#endif  // __SYNTHESIS__
+
+/// Defines an on-chip buffer shared by a producer task and a consumer task.
+///
+/// The buffer holds @c Sections sections of @c Size elements each, so that the
+/// producer fills one section while the consumer drains another (ping-pong
+/// buffering with the default two sections). Pass the buffer to a
+/// @c tapa::obuffer parameter of the producer and to a @c tapa::ibuffer
+/// parameter of the consumer. In hardware, the buffer is a dual-port memory
+/// instantiated in the upper-level task, with one port for each endpoint.
+///
+/// @tparam T        Type of each element.
+/// @tparam Size     Number of elements of each section.
+/// @tparam Sections Number of sections.
+template <typename T, uint64_t Size, uint64_t Sections = 2>
+#ifdef __SYNTHESIS__
+class buffer;
+#else  // __SYNTHESIS__
+class buffer : private internal::buffer_storage<T, Size, Sections>,
+               public ibuffer<T, Size>,
+               public obuffer<T, Size> {
+  static_assert(Size > 0, "buffer sections must not be empty");
+  static_assert(Sections > 0, "buffer must have at least one section");
+
+  using storage = internal::buffer_storage<T, Size, Sections>;
+
+ public:
+  buffer()
+      : ibuffer<T, Size>(storage::data.data(), storage::full, storage::free),
+        obuffer<T, Size>(storage::data.data(), storage::free, storage::full) {
+  }
+
+  buffer(const buffer&) = delete;
+  buffer& operator=(const buffer&) = delete;
+};
+#endif  // __SYNTHESIS__
+
+#ifndef __SYNTHESIS__
+
+namespace internal {
+
+template <typename T, uint64_t Size>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const ibuffer<T, Size>& arg) {
+  for (const auto& channel : arg.get_channels()) channels.push_back(channel);
+}
+
+template <typename T, uint64_t Size>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const obuffer<T, Size>& arg) {
+  for (const auto& channel : arg.get_channels()) channels.push_back(channel);
+}
+
+}  // namespace internal
+
+#endif  // __SYNTHESIS__
+
+}  // namespace tapa
+
+#endif  // TAPA_BUFFER_H_
@@ -0,0 +1,205 @@
+#ifndef TAPA_CAPTURE_H_
+#define TAPA_CAPTURE_H_
+
+#ifndef __SYNTHESIS__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "tapa/coroutine.h"
+#include "tapa/mmap.h"
+#include "tapa/stream.h"
+
+namespace tapa {
+namespace internal {
+
+// A file to which captured tokens are appended. Writes are buffered until the
+// file is destroyed or the top-level task finishes.
+class capture_file {
+ public:
+  explicit capture_file(const std::string& path);
+  capture_file(const capture_file&) = delete;
+  capture_file& operator=(const capture_file&) = delete;
+  ~capture_file();
+
+  void write(const void* data, size_t size);
+  void flush();
+
+ private:
+  std::mutex mtx;
+  std::string path;
+  int fd;
+  std::vector<char> buffer;
+};
+
+// Traffic of a task instance captured into its own directory, which is created
+// if the task is selected by environment variable `TAPA_CAPTURE`; see
+// `tapa/replay.h`. For argument `i`, the directory contains:
+//
+// - `arg<i>.data` and `arg<i>.eot` of a stream, which store the value and the
+//   EoT flag (one byte) of each token, respectively;
+// - `arg<i>.in` and `arg<i>.out` of an mmap, which store its content when the
+//   task starts and finishes, respectively;
+// - `arg<i>.value` of any other trivially copyable argument.
+class capture {
+ public:
+  // Returns the capture of a new instance of task `id`, or null if it is not
+  // captured.
+  static std::shared_ptr<capture> create(const task_id& id);
+
+  explicit capture(const std::string& dir) : dir(dir) {}
+
+  // Returns the path of the file of argument `index` with `suffix`.
+  std::string get_path(int index, const char* suffix) const;
+
+  // Writes `size` bytes at `data` to the file of argument `index`.
+  void write_file(int index, const char* suffix, const void* data,
+                  size_t size) const;
+
+  // Snapshots `size` bytes at `data` of argument `index` when the task starts,
+  // and also when it finishes if it may be written.
+  void add_region(int index, const void* data, size_t size, bool is_written);
+
+  // Writes the snapshots of all regions.
+  void snapshot(bool is_finished) const;
+
+ private:
+  struct region {
+    int index;
+    const void* data;
+    size_t size;
+    bool is_written;
+  };
+
+  const std::string dir;
+  std::vector<region> regions;
+};
+
+// Forwards tokens from `in` to `out`, appending them to `data` and `eot`.
+template <typename T>
+void relay_captured(istream<T>& in, ostream<T>& out, capture_file& data,
+                    capture_file& eot) {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "captured tokens must be trivially copyable");
+  for (;;) {
+    bool is_eot;
+    if (!in.try_eot(is_eot)) continue;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type value = {};
+    if (is_eot) {
+      in.open();
+      out.close();
+    } else {
+      const T token = in.read();
+      out.write(token);
+      new (&value) T(token);
+    }
+    data.write(&value, sizeof(T));
+    const uint8_t flag = is_eot;
+    eot.write(&flag, sizeof(flag));
+  }
+}
+
+// A stream handle that can be used as both an `istream` and an `ostream`.
+template <typename T>
+class captured_stream : public unbound_stream<T> {
+ public:
+  explicit captured_stream(const basic_stream<T>& base)
+      : basic_stream<T>(base) {}
+};
+
+// Inserts a relay between a stream argument and the task, so that the tokens
+// crossing the port are captured. The task reads `port` from a new stream fed
+// by the relay if `is_input`, or writes it to a new stream drained by the relay
+// otherwise.
+template <typename T>
+void capture_stream(const capture& capture, int index, basic_stream<T>& port,
+                    bool is_input) {
+  auto owner = make_queue<T>(port.get_depth(), port.get_name());
+  const captured_stream<T> original(port);
+  const captured_stream<T> tap(basic_stream<T>(owner.get()));
+  port = tap;
+  istream<T> in = is_input ? original : tap;
+  ostream<T> out = is_input ? tap : original;
+  auto data = std::make_shared<capture_file>(capture.get_path(index, ".data"));
+  auto eot = std::make_shared<capture_file>(capture.get_path(index, ".eot"));
+  const std::vector<channel_t> channels = {in.get_channel(),
+                                           out.get_channel()};
+  schedule(
+      /*detach=*/true,
+      [in, out, owner = std::move(owner), data = std::move(data),
+       eot = std::move(eot)]() mutable {
+        relay_captured(in, out, *data, *eot);
+      },
+      channels, {"(capture)"});
+}
+
+// Captures an argument of a task; see `capture`.
+template <typename T>
+inline void capture_arg(capture& capture, int index, T& arg) {
+  if (std::is_trivially_copyable<T>::value) {
+    capture.write_file(index, ".value", &arg, sizeof(arg));
+  } else {
+    LOG(WARNING) << "argument #" << index << " is not captured";
+  }
+}
+
+template <typename T>
+inline void capture_arg(capture& capture, int index, istream<T>& arg) {
+  capture_stream(capture, index, arg, /*is_input=*/true);
+}
+
+template <typename T>
+inline void capture_arg(capture& capture, int index, ostream<T>& arg) {
+  capture_stream(capture, index, arg, /*is_input=*/false);
+}
+
+template <typename T>
+inline void capture_arg(capture& capture, int index, mmap<T>& arg) {
+  capture.add_region(index, arg.get(), arg.size() * sizeof(T),
+                     /*is_written=*/!std::is_const<T>::value);
+}
+
+template <typename T>
+inline void capture_arg(capture& capture, int index, async_mmap<T>& arg) {
+  capture_arg(capture, index, static_cast<mmap<T>&>(arg));
+}
+
+template <typename T, uint64_t Lines, uint64_t Ways>
+inline void capture_arg(capture& capture, int index,
+                        cached_async_mmap<T, Lines, Ways>& arg) {
+  capture_arg(capture, index, static_cast<mmap<T>&>(arg));
+}
+
+template <typename T, uint64_t BurstLen, uint64_t WaitCycles>
+inline void capture_arg(capture& capture, int index,
+                        burst_async_mmap<T, BurstLen, WaitCycles>& arg) {
+  capture_arg(capture, index, static_cast<mmap<T>&>(arg));
+}
+
+template <typename T>
+inline void capture_arg(capture& capture, int index,
+                        atomic_async_mmap<T>& arg) {
+  capture_arg(capture, index, static_cast<mmap<T>&>(arg));
+}
+
+// Captures the arguments bound to a task.
+template <typename Tuple, size_t... Is>
+inline void capture_args(capture& capture, Tuple& args,
+                         std::index_sequence<Is...>) {
+  (capture_arg(capture, Is, std::get<Is>(args)), ...);
+}
+
+}  // namespace internal
+}  // namespace tapa
+
+#endif  // __SYNTHESIS__
+
+#endif  // TAPA_CAPTURE_H_
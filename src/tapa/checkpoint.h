@@ -0,0 +1,133 @@
+#ifndef TAPA_CHECKPOINT_H_
+#define TAPA_CHECKPOINT_H_
+
+#ifndef __SYNTHESIS__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "tapa/mmap.h"
+
+namespace tapa {
+namespace internal {
+
+// Checkpoint of an invocation of the top-level task in software simulation,
+// which is enabled by setting environment variable `TAPA_CHECKPOINT_DIR` to a
+// directory. Invocations are the quiescent points of the simulation: no task
+// or stream outlives them, so the state between invocations is the content of
+// the mmaps only. Each invocation is identified by a digest of the task, its
+// scalar arguments, and the content of the mmaps it may read; once simulated,
+// the content of the mmaps it may write is dumped into `<digest>.ckpt` under
+// the directory. Simulating the same invocation again, e.g., after a
+// long-running simulation is restarted, restores the dump instead. Arguments
+// that cannot be digested, e.g., streams, may carry different inputs under the
+// same digest, so their invocations are neither restored nor dumped.
+class checkpoint {
+ public:
+  // Returns the checkpoint of an invocation of top-level task `func`, or null
+  // if checkpoints are disabled.
+  static std::unique_ptr<checkpoint> create(const void* func);
+
+  checkpoint(const std::string& dir, uint64_t digest)
+      : dir(dir), digest(digest) {}
+
+  // Adds `size` bytes at `data` of argument `index`, which identify the
+  // invocation.
+  void add_value(int index, const void* data, size_t size);
+
+  // Adds argument `index`, which cannot identify the invocation; this disables
+  // both restoring and dumping it.
+  void add_opaque(int index);
+
+  // Adds `size` bytes at `data` of argument `index`, which identify the
+  // invocation if `is_read`, and are dumped if `is_written`.
+  void add_region(int index, void* data, size_t size, bool is_read,
+                  bool is_written);
+
+  // Restores the written regions and sets `time_ns` to the time of the
+  // invocation if it has been dumped and is enabled; returns whether it has.
+  bool restore(int64_t& time_ns) const;
+
+  // Dumps the written regions and `time_ns` if enabled.
+  void save(int64_t time_ns) const;
+
+ private:
+  struct region {
+    void* data;
+    size_t size;
+  };
+
+  std::string get_path() const;
+
+  const std::string dir;
+  uint64_t digest;
+  std::vector<region> regions;
+  bool is_enabled = true;
+};
+
+// Adds an argument of the top-level task to a checkpoint; see `checkpoint`.
+// Pointers are opaque since the digest would not cover what they point to.
+template <typename T>
+inline void checkpoint_arg(checkpoint& checkpoint, int index, const T& arg) {
+  if (std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value) {
+    checkpoint.add_value(index, &arg, sizeof(arg));
+  } else {
+    checkpoint.add_opaque(index);
+  }
+}
+
+template <typename T>
+inline void checkpoint_mmap(checkpoint& checkpoint, int index,
+                            const mmap<T>& arg, bool is_read,
+                            bool is_written) {
+  checkpoint.add_region(index, const_cast<std::remove_const_t<T>*>(arg.get()),
+                        arg.size() * sizeof(T), is_read, is_written);
+}
+
+template <typename T, uint64_t S>
+inline void checkpoint_mmaps(checkpoint& checkpoint, int index,
+                             mmaps<T, S> arg, bool is_read, bool is_written) {
+  for (uint64_t i = 0; i < S; ++i) {
+    checkpoint_mmap(checkpoint, index, arg[i], is_read, is_written);
+  }
+}
+
+// Placeholder mmaps are accessed directly by the simulated tasks.
+#define TAPA_DEFINE_CHECKPOINT_ARG(tag, is_read, is_written)            \
+  template <typename T>                                                 \
+  inline void checkpoint_arg(checkpoint& checkpoint, int index,         \
+                             const tag##_mmap<T>& arg) {                \
+    checkpoint_mmap(checkpoint, index, arg, is_read, is_written);       \
+  }                                                                     \
+  template <typename T, uint64_t S>                                     \
+  inline void checkpoint_arg(checkpoint& checkpoint, int index,         \
+                             const tag##_mmaps<T, S>& arg) {            \
+    checkpoint_mmaps<T, S>(checkpoint, index, arg, is_read, is_written); \
+  }
+TAPA_DEFINE_CHECKPOINT_ARG(placeholder, true, true)
+TAPA_DEFINE_CHECKPOINT_ARG(read_only, true, false)
+TAPA_DEFINE_CHECKPOINT_ARG(write_only, false, true)
+TAPA_DEFINE_CHECKPOINT_ARG(read_write, true, true)
+TAPA_DEFINE_CHECKPOINT_ARG(host, true, true)
+#undef TAPA_DEFINE_CHECKPOINT_ARG
+
+// Adds the arguments of the top-level task to a checkpoint.
+template <typename... Args>
+inline void checkpoint_args(checkpoint& checkpoint, const Args&... args) {
+  int index = 0;
+  (checkpoint_arg(checkpoint, index++, args), ...);
+}
+
+}  // namespace internal
+}  // namespace tapa
+
+#endif  // __SYNTHESIS__
+
+#endif  // TAPA_CHECKPOINT_H_
@@ -0,0 +1,108 @@
+#ifndef TAPA_COMMAND_H_
+#define TAPA_COMMAND_H_
+
+#include <cstdint>
+
+#ifndef __SYNTHESIS__
+
+#include "tapa/coroutine.h"
+
+#endif  // __SYNTHESIS__
+
+#include "tapa/mmap.h"
+#include "tapa/stream.h"
+#include "tapa/util.h"
+
+namespace tapa {
+
+namespace internal {
+
+// Bit of the doorbell of a `tapa::command_ring` set once no command follows.
+constexpr uint64_t kCommandRingStop = uint64_t(1) << 63;
+
+}  // namespace internal
+
+/// Receives the commands that the host submits via a @c tapa::command_ring to
+/// a persistent kernel, i.e., a kernel invoked once that serves requests until
+/// the host stops it, so that no request pays for launching the kernel and
+/// state such as loaded weights or hash tables is kept on chip.
+///
+/// The doorbell is polled until the host submits more commands, which are
+/// then read from the ring and written to @c commands in order. Once the host
+/// stops the ring and all commands are received, EoT is written to
+/// @c commands. On a device, both mmaps should be in host memory, e.g., via
+/// `tapac --host-mmap`, and each poll is a read over PCIe.
+///
+/// Canonical usage in the top-level task of a persistent kernel:
+/// @code{.cpp}
+///  void Receive(tapa::mmap<const uint64_t> doorbell,
+///               tapa::mmap<const Request> ring, uint64_t capacity,
+///               tapa::ostream<Request>& requests) {
+///    tapa::receive_commands(doorbell, ring, capacity, requests);
+///  }
+/// @endcode
+///
+/// @param doorbell Number of commands submitted, i.e., the doorbell of the
+///                 @c tapa::command_ring.
+/// @param ring     Commands in a ring buffer of @c capacity entries.
+/// @param capacity Number of entries of @c ring.
+/// @param commands Commands received.
+template <typename T>
+void receive_commands(mmap<const uint64_t> doorbell, mmap<const T> ring,
+                      uint64_t capacity, ostream<T>& commands) {
+  uint64_t head = 0;
+  uint64_t idx = 0;  // head % capacity
+  for (;;) {
+    // The doorbell is written after the commands before it.
+#ifdef __SYNTHESIS__
+    const uint64_t bell = *reinterpret_cast<const volatile uint64_t*>(doorbell);
+#else   // __SYNTHESIS__
+    const uint64_t bell = __atomic_load_n(doorbell.get(), __ATOMIC_ACQUIRE);
+#endif  // __SYNTHESIS__
+    const uint64_t tail = bell & ~internal::kCommandRingStop;
+    if (head == tail) {
+      if (bell & internal::kCommandRingStop) break;
+#ifndef __SYNTHESIS__
+      // The host is not a task, so polling must not starve other tasks.
+      internal::yield("command ring");
+#endif  // __SYNTHESIS__
+      continue;
+    }
+    for (; head < tail; ++head) {
+#pragma HLS pipeline II = 1
+      commands.write(ring[idx]);
+      idx = idx + 1 == capacity ? 0 : idx + 1;
+    }
+  }
+  commands.close();
+}
+
+/// Reports the commands completed by a persistent kernel to the host via a
+/// @c tapa::command_ring.
+///
+/// Each token of @c done completes the next command, whose results must be
+/// written before the token; the number of completed commands is written to
+/// @c completions after each token. Returns once @c done reaches EoT, which is
+/// consumed.
+///
+/// @param done        One token per completed command, in order.
+/// @param completions Number of commands completed, i.e., the completions of
+///                    the @c tapa::command_ring.
+template <typename T>
+void complete_commands(istream<T>& done, mmap<uint64_t> completions) {
+  uint64_t count = 0;
+  TAPA_WHILE_NOT_EOT(done) {
+    done.read(nullptr);
+    ++count;
+#ifdef __SYNTHESIS__
+    *reinterpret_cast<volatile uint64_t*>(completions) = count;
+#else   // __SYNTHESIS__
+    __atomic_store_n(completions.get(), count, __ATOMIC_RELEASE);
+#endif  // __SYNTHESIS__
+  }
+  done.open();
+}
+
+}  // namespace tapa
+
+#endif  // TAPA_COMMAND_H_
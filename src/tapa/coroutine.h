@@ -1,13 +1,203 @@
 #ifndef TAPA_COROUTINE_H_
 #define TAPA_COROUTINE_H_
 
-#include <functional>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace tapa {
 namespace internal {
-void schedule(bool detach, const std::function<void()>&);
+
+// Number of channel operations that succeeded on the current thread.
+extern thread_local uint64_t op_count;
+
+// Whether all tasks run on one thread, in which case channels notify their
+// waiters without memory fences.
+extern bool is_sequential;
+
+// Coroutines waiting for a channel to change its state.
+class wait_list {
+ public:
+  // Wakes up all waiting coroutines. This is cheap if nobody waits.
+  void notify() {
+    // Pairs with the fence in `add` so that either the waiter sees the change
+    // of the channel when it polls again, or the change sees the waiter.
+    if (!is_sequential) std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->has_waiters.load(std::memory_order_relaxed)) this->notify_all();
+  }
+
+  // Wakes up all waiting coroutines because one of them finds the channel
+  // ready, which cancels its waiting. No fence is needed since the waiter
+  // itself has added to the list.
+  void cancel() {
+    if (this->has_waiters.load(std::memory_order_relaxed)) this->notify_all();
+  }
+
+  void add(void* waiter);
+  void remove(void* waiter);
+
+ private:
+  void notify_all();
+
+  std::atomic_bool has_waiters{false};
+  std::mutex mtx;
+  std::vector<void*> waiters;
+};
+
+// Which end of a channel a task accesses, if known.
+enum class channel_end : uint8_t { kUnknown, kProducer, kConsumer };
+
+// A channel accessed by a task, which is used as a hint for scheduling. The id
+// of a stream is its `base_queue`.
+struct channel_t {
+  const void* id;
+  uint64_t depth;
+  channel_end end = channel_end::kUnknown;
+};
+
+// Identifies the instances of a task in the stats of tasks.
+struct task_id {
+  const char* name = "";       // Instance name given to `invoke`, if any.
+  const void* func = nullptr;  // Task function, if known.
+};
+
+// A move-only `void()` callable. Unlike `std::function`, it is never copied,
+// and a callable that is small enough is stored inline without allocation.
+class thunk {
+ public:
+  thunk() = default;
+
+  template <typename F, typename Fn = typename std::decay<F>::type,
+            typename = typename std::enable_if<
+                !std::is_same<Fn, thunk>::value>::type>
+  thunk(F&& f) : vtable(get_vtable<Fn>()) {
+    ops<Fn>::create(this->storage, std::forward<F>(f));
+  }
+
+  thunk(thunk&& other) noexcept : vtable(other.vtable) {
+    if (this->vtable != nullptr) {
+      this->vtable->move(this->storage, other.storage);
+      other.vtable = nullptr;
+    }
+  }
+
+  thunk& operator=(thunk&& other) noexcept {
+    if (this != &other) {
+      this->~thunk();
+      new (this) thunk(std::move(other));
+    }
+    return *this;
+  }
+
+  thunk(const thunk&) = delete;
+  thunk& operator=(const thunk&) = delete;
+
+  ~thunk() {
+    if (this->vtable != nullptr) this->vtable->destroy(this->storage);
+  }
+
+  explicit operator bool() const { return this->vtable != nullptr; }
+
+  void operator()() { this->vtable->invoke(this->storage); }
+
+ private:
+  static constexpr size_t kInlineSize = 192;
+
+  struct vtable_t {
+    void (*invoke)(void* storage);
+    void (*move)(void* dst, void* src);  // Leaves `src` destroyed.
+    void (*destroy)(void* storage);
+  };
+
+  template <typename Fn>
+  static constexpr bool is_inline() {
+    return sizeof(Fn) <= kInlineSize &&
+           alignof(Fn) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible<Fn>::value;
+  }
+
+  template <typename Fn, bool = is_inline<Fn>()>
+  struct ops {
+    static Fn& get(void* storage) { return *static_cast<Fn*>(storage); }
+    template <typename F>
+    static void create(void* storage, F&& f) {
+      new (storage) Fn(std::forward<F>(f));
+    }
+    static void invoke(void* storage) { get(storage)(); }
+    static void move(void* dst, void* src) {
+      new (dst) Fn(std::move(get(src)));
+      get(src).~Fn();
+    }
+    static void destroy(void* storage) { get(storage).~Fn(); }
+  };
+
+  template <typename Fn>
+  struct ops<Fn, false> {
+    static Fn*& get(void* storage) { return *static_cast<Fn**>(storage); }
+    template <typename F>
+    static void create(void* storage, F&& f) {
+      get(storage) = new Fn(std::forward<F>(f));
+    }
+    static void invoke(void* storage) { (*get(storage))(); }
+    static void move(void* dst, void* src) { get(dst) = get(src); }
+    static void destroy(void* storage) { delete get(storage); }
+  };
+
+  template <typename Fn>
+  static const vtable_t* get_vtable() {
+    static const vtable_t vtable = {&ops<Fn>::invoke, &ops<Fn>::move,
+                                    &ops<Fn>::destroy};
+    return &vtable;
+  }
+
+  const vtable_t* vtable = nullptr;
+  alignas(std::max_align_t) unsigned char storage[kInlineSize];
+};
+
+void schedule(bool detach, thunk&& f,
+              const std::vector<channel_t>& channels = {},
+              const task_id& id = {});
+
+// Schedules a non-detached task that runs on its own thread.
+void schedule_thread(thunk&& f, const std::vector<channel_t>& channels = {},
+                     const task_id& id = {});
+
+// Schedules a detached task that accesses no channels other than `channels`,
+// which it owns. Unlike other detached tasks, it does not delay deleting
+// released channels.
+void schedule_service(thunk&& f, const std::vector<channel_t>& channels);
 void yield(const std::string& msg);
+
+// Why a channel is not ready.
+enum class channel_state { kEmpty, kFull };
+
+class base_queue;
+
+// Yields because `channel` named `name` is not ready. The scheduler may suspend
+// the current coroutine until `channel` is notified, and may defer resuming it
+// while `queue`, if any, is still in `state`. The debug message is built only
+// if it is printed.
+void yield(wait_list* channel, const std::string& name, channel_state state,
+           const base_queue* queue = nullptr);
+
+// Returns whether tasks are simulated with virtual clocks, which is enabled by
+// setting environment variable `TAPA_CYCLE_SIM` to 1.
+bool is_cycle_sim_enabled();
+
+// Returns the virtual clock of the current task, i.e., the cycle of its latest
+// read, in cycle-approximate simulation.
+uint64_t get_cycle();
+
+// Delays tokens written by the current task until `cycle` in cycle-approximate
+// simulation, e.g., responses of a memory model.
+void set_ready_cycle(uint64_t cycle);
+
 }  // namespace internal
 }  // namespace tapa
 
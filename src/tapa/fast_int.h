@@ -0,0 +1,331 @@
+#ifndef TAPA_FAST_INT_H_
+#define TAPA_FAST_INT_H_
+
+// Native-integer emulation of `ap_int<W>` and `ap_uint<W>` for `W <= 64` in
+// software simulation, enabled by defining `TAPA_FAST_AP_INT` before including
+// `tapa.h`. The vendor classes store each value as an arbitrary-precision
+// integer and are much slower than native integers, especially in `vec_t`
+// loops. With this header, `ap_int<W>` and `ap_uint<W>` for `W <= 64` are
+// specialized to keep the bits in a `uint64_t`, with the width of the result
+// of each operator following the vendor classes, capped at 64 bits. Wider
+// types, and fixed-point types, are not affected.
+//
+// Since the specializations must precede any use of the types, `tapa.h` must
+// be included before code that uses them.
+
+#ifndef __SYNTHESIS__
+
+#include <climits>
+#include <cstdint>
+
+#include <ostream>
+#include <type_traits>
+
+#include <ap_int.h>
+
+namespace tapa {
+namespace internal {
+
+constexpr int fast_int_width(int width) { return width < 64 ? width : 64; }
+
+template <int W, bool S>
+class fast_int_base;
+
+template <typename T>
+struct is_fast_int {
+  template <int W, bool S>
+  static std::true_type test(const fast_int_base<W, S>*);
+  static std::false_type test(...);
+  static constexpr bool value = decltype(test(std::declval<T*>()))::value;
+};
+
+template <int W, bool S>
+class fast_int_base {
+  static_assert(W >= 1 && W <= 64, "fast_int_base supports 1 to 64 bits");
+
+ public:
+  static constexpr int width = W;
+
+  // Type to which the value converts, which holds every value of a type
+  // narrower than 64 bits, so that comparisons of signed and unsigned values
+  // follow their mathematical values as with the vendor classes.
+  using native_type =
+      typename std::conditional<S || W < 64, int64_t, uint64_t>::type;
+
+  // Reference to a single bit.
+  class bit_ref {
+   public:
+    bit_ref(fast_int_base* parent, int index)
+        : parent_(parent), index_(index) {}
+    operator bool() const { return parent_->get_bit(index_); }
+    bit_ref& operator=(bool value) {
+      parent_->set_bit(index_, value);
+      return *this;
+    }
+    bit_ref& operator=(const bit_ref& other) { return *this = bool(other); }
+
+   private:
+    fast_int_base* parent_;
+    int index_;
+  };
+
+  // Reference to bits `hi` down to `lo`.
+  class range_ref {
+   public:
+    range_ref(fast_int_base* parent, int hi, int lo)
+        : parent_(parent), hi_(hi), lo_(lo) {}
+    operator uint64_t() const { return to_uint64(); }
+    uint64_t to_uint64() const { return (parent_->bits_ >> lo_) & mask(); }
+    int64_t to_int64() const { return to_uint64(); }
+    unsigned to_uint() const { return to_uint64(); }
+    int to_int() const { return to_uint64(); }
+    int length() const { return hi_ - lo_ + 1; }
+    range_ref& operator=(uint64_t value) {
+      parent_->bits_ = normalize((parent_->bits_ & ~(mask() << lo_)) |
+                                 ((value & mask()) << lo_));
+      return *this;
+    }
+    range_ref& operator=(const range_ref& other) {
+      return *this = other.to_uint64();
+    }
+
+   private:
+    uint64_t mask() const {
+      return length() >= 64 ? ~uint64_t(0) : (uint64_t(1) << length()) - 1;
+    }
+
+    fast_int_base* parent_;
+    int hi_;
+    int lo_;
+  };
+
+  constexpr fast_int_base() = default;
+
+  template <typename T, typename std::enable_if<std::is_integral<T>::value,
+                                                int>::type = 0>
+  constexpr fast_int_base(T value) : bits_(normalize(uint64_t(value))) {}
+
+  template <typename T, typename std::enable_if<
+                            std::is_floating_point<T>::value, int>::type = 0>
+  constexpr fast_int_base(T value)
+      : bits_(normalize(uint64_t(int64_t(value)))) {}
+
+  template <int W2, bool S2>
+  constexpr fast_int_base(const fast_int_base<W2, S2>& other)
+      : bits_(normalize(other.extended_bits())) {}
+
+  // Converts from the vendor classes, e.g., ranges of a wide `ap_uint`.
+  template <typename T,
+            typename = decltype(std::declval<const T&>().to_uint64()),
+            typename std::enable_if<!is_fast_int<T>::value, int>::type = 0>
+  fast_int_base(const T& other) : bits_(normalize(other.to_uint64())) {}
+
+  constexpr operator native_type() const { return native_type(value()); }
+
+  int64_t to_int64() const { return value(); }
+  uint64_t to_uint64() const { return value(); }
+  int to_int() const { return value(); }
+  unsigned to_uint() const { return value(); }
+  long to_long() const { return value(); }
+  unsigned long to_ulong() const { return value(); }
+  double to_double() const { return double(native_type(value())); }
+  static constexpr int length() { return W; }
+
+  bool get_bit(int index) const { return (bits_ >> index) & 1; }
+  bool test(int index) const { return get_bit(index); }
+  void set_bit(int index, bool value) {
+    bits_ = normalize((bits_ & ~(uint64_t(1) << index)) |
+                      (uint64_t(value) << index));
+  }
+  void set(int index) { set_bit(index, true); }
+  void clear(int index) { set_bit(index, false); }
+  bit_ref operator[](int index) { return {this, index}; }
+  bool operator[](int index) const { return get_bit(index); }
+
+  range_ref range(int hi, int lo) const {
+    return {const_cast<fast_int_base*>(this), hi, lo};
+  }
+  range_ref range() const { return range(W - 1, 0); }
+  range_ref operator()(int hi, int lo) const { return range(hi, lo); }
+
+  bool and_reduce() const { return bits_ == kMask; }
+  bool or_reduce() const { return bits_ != 0; }
+  bool xor_reduce() const { return __builtin_parityll(bits_); }
+  bool nand_reduce() const { return !and_reduce(); }
+  bool nor_reduce() const { return !or_reduce(); }
+  bool xnor_reduce() const { return !xor_reduce(); }
+  bool iszero() const { return bits_ == 0; }
+  bool sign() const { return S && get_bit(W - 1); }
+  int countLeadingZeros() const {
+    return bits_ == 0 ? W : __builtin_clzll(bits_) - (64 - W);
+  }
+
+  void lrotate(int n) {
+    n %= W;
+    if (n != 0) bits_ = normalize((bits_ << n) | (bits_ >> (W - n)));
+  }
+  void rrotate(int n) {
+    n %= W;
+    if (n != 0) bits_ = normalize((bits_ >> n) | (bits_ << (W - n)));
+  }
+  void reverse() {
+    uint64_t reversed = 0;
+    for (int i = 0; i < W; ++i) {
+      reversed |= uint64_t(get_bit(i)) << (W - 1 - i);
+    }
+    bits_ = reversed;
+  }
+
+  // Shifts keep the width of the shifted value, as with the vendor classes.
+  fast_int_base operator<<(int n) const {
+    return n >= 64 ? fast_int_base() : from_bits(bits_ << n);
+  }
+  fast_int_base operator>>(int n) const {
+    if (S) return from_bits(uint64_t(value() >> (n >= 64 ? 63 : n)));
+    return n >= 64 ? fast_int_base() : from_bits(bits_ >> n);
+  }
+  fast_int_base operator~() const { return from_bits(~bits_); }
+  fast_int_base<fast_int_width(W + 1), true> operator-() const {
+    return -value();
+  }
+  fast_int_base operator+() const { return *this; }
+
+  template <typename T>
+  fast_int_base& operator<<=(const T& n) {
+    return *this = *this << int(n);
+  }
+  template <typename T>
+  fast_int_base& operator>>=(const T& n) {
+    return *this = *this >> int(n);
+  }
+#define TAPA_DEFINE_FAST_INT_ASSIGN(op)              \
+  template <typename T>                              \
+  fast_int_base& operator op##=(const T& rhs) {      \
+    return *this = fast_int_base(*this op rhs);      \
+  }
+  TAPA_DEFINE_FAST_INT_ASSIGN(+)
+  TAPA_DEFINE_FAST_INT_ASSIGN(-)
+  TAPA_DEFINE_FAST_INT_ASSIGN(*)
+  TAPA_DEFINE_FAST_INT_ASSIGN(/)
+  TAPA_DEFINE_FAST_INT_ASSIGN(%)
+  TAPA_DEFINE_FAST_INT_ASSIGN(&)
+  TAPA_DEFINE_FAST_INT_ASSIGN(|)
+  TAPA_DEFINE_FAST_INT_ASSIGN(^)
+#undef TAPA_DEFINE_FAST_INT_ASSIGN
+
+  fast_int_base& operator++() { return *this = from_bits(bits_ + 1); }
+  fast_int_base& operator--() { return *this = from_bits(bits_ - 1); }
+  fast_int_base operator++(int) {
+    const fast_int_base old = *this;
+    ++*this;
+    return old;
+  }
+  fast_int_base operator--(int) {
+    const fast_int_base old = *this;
+    --*this;
+    return old;
+  }
+
+  // Returns the value, sign-extended if signed.
+  constexpr int64_t value() const {
+    return S && W < 64 ? int64_t(bits_ << (64 - W)) >> (64 - W)
+                       : int64_t(bits_);
+  }
+
+  // Returns the bits extended to 64 bits.
+  constexpr uint64_t extended_bits() const { return uint64_t(value()); }
+
+ private:
+  static constexpr uint64_t kMask =
+      W == 64 ? ~uint64_t(0) : (uint64_t(1) << W) - 1;
+
+  static constexpr uint64_t normalize(uint64_t bits) { return bits & kMask; }
+
+  static fast_int_base from_bits(uint64_t bits) {
+    fast_int_base result;
+    result.bits_ = normalize(bits);
+    return result;
+  }
+
+  uint64_t bits_ = 0;
+};
+
+template <typename T>
+using fast_int_of =
+    fast_int_base<sizeof(T) * CHAR_BIT, std::is_signed<T>::value>;
+
+// Binary operators return the widths and signedness of the vendor classes,
+// e.g., `ap_uint<W + 1>` for the sum of two `ap_uint<W>`, capped at 64 bits.
+#define TAPA_DEFINE_FAST_INT_BINARY_OP(op, width, is_signed)                 \
+  template <int W1, bool S1, int W2, bool S2>                               \
+  inline fast_int_base<fast_int_width(width), is_signed> operator op(       \
+      const fast_int_base<W1, S1>& lhs, const fast_int_base<W2, S2>& rhs) { \
+    return lhs.value() op rhs.value();                                      \
+  }                                                                         \
+  template <int W1, bool S1, typename T,                                    \
+            typename std::enable_if<std::is_integral<T>::value,             \
+                                    int>::type = 0>                         \
+  inline auto operator op(const fast_int_base<W1, S1>& lhs, T rhs) {        \
+    return lhs op fast_int_of<T>(rhs);                                      \
+  }                                                                         \
+  template <int W2, bool S2, typename T,                                    \
+            typename std::enable_if<std::is_integral<T>::value,             \
+                                    int>::type = 0>                         \
+  inline auto operator op(T lhs, const fast_int_base<W2, S2>& rhs) {        \
+    return fast_int_of<T>(lhs) op rhs;                                      \
+  }
+TAPA_DEFINE_FAST_INT_BINARY_OP(+, (W1 > W2 ? W1 : W2) + 1, S1 || S2)
+TAPA_DEFINE_FAST_INT_BINARY_OP(-, (W1 > W2 ? W1 : W2) + 1, true)
+TAPA_DEFINE_FAST_INT_BINARY_OP(*, W1 + W2, S1 || S2)
+TAPA_DEFINE_FAST_INT_BINARY_OP(/, W1 + S2, S1 || S2)
+TAPA_DEFINE_FAST_INT_BINARY_OP(%, W1 < W2 ? W1 : W2, S1)
+TAPA_DEFINE_FAST_INT_BINARY_OP(&, W1 > W2 ? W1 : W2, S1 && S2)
+TAPA_DEFINE_FAST_INT_BINARY_OP(|, W1 > W2 ? W1 : W2, S1 && S2)
+TAPA_DEFINE_FAST_INT_BINARY_OP(^, W1 > W2 ? W1 : W2, S1 && S2)
+#undef TAPA_DEFINE_FAST_INT_BINARY_OP
+
+template <int W, bool S>
+inline std::ostream& operator<<(std::ostream& os,
+                                const fast_int_base<W, S>& obj) {
+  return S ? os << obj.value() : os << uint64_t(obj.value());
+}
+
+}  // namespace internal
+}  // namespace tapa
+
+#define TAPA_DEFINE_FAST_AP_INT(w)                                        \
+  template <>                                                             \
+  struct ap_int<w> : ::tapa::internal::fast_int_base<w, true> {           \
+    using fast_int_base::fast_int_base;                                   \
+    constexpr ap_int() = default;                                         \
+    constexpr ap_int(const fast_int_base& obj) : fast_int_base(obj) {}    \
+  };                                                                      \
+  template <>                                                             \
+  struct ap_uint<w> : ::tapa::internal::fast_int_base<w, false> {         \
+    using fast_int_base::fast_int_base;                                   \
+    constexpr ap_uint() = default;                                        \
+    constexpr ap_uint(const fast_int_base& obj) : fast_int_base(obj) {}   \
+  };
+#define TAPA_DEFINE_FAST_AP_INT_X8(n)   \
+  TAPA_DEFINE_FAST_AP_INT(8 * n + 1) \
+  TAPA_DEFINE_FAST_AP_INT(8 * n + 2) \
+  TAPA_DEFINE_FAST_AP_INT(8 * n + 3) \
+  TAPA_DEFINE_FAST_AP_INT(8 * n + 4) \
+  TAPA_DEFINE_FAST_AP_INT(8 * n + 5) \
+  TAPA_DEFINE_FAST_AP_INT(8 * n + 6) \
+  TAPA_DEFINE_FAST_AP_INT(8 * n + 7) \
+  TAPA_DEFINE_FAST_AP_INT(8 * n + 8)
+TAPA_DEFINE_FAST_AP_INT_X8(0)
+TAPA_DEFINE_FAST_AP_INT_X8(1)
+TAPA_DEFINE_FAST_AP_INT_X8(2)
+TAPA_DEFINE_FAST_AP_INT_X8(3)
+TAPA_DEFINE_FAST_AP_INT_X8(4)
+TAPA_DEFINE_FAST_AP_INT_X8(5)
+TAPA_DEFINE_FAST_AP_INT_X8(6)
+TAPA_DEFINE_FAST_AP_INT_X8(7)
+#undef TAPA_DEFINE_FAST_AP_INT_X8
+#undef TAPA_DEFINE_FAST_AP_INT
+
+#endif  // __SYNTHESIS__
+
+#endif  // TAPA_FAST_INT_H_
@@ -0,0 +1,322 @@
+#ifndef TAPA_HASH_TABLE_H_
+#define TAPA_HASH_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef __SYNTHESIS__
+
+#include <array>
+#include <vector>
+
+#endif  // __SYNTHESIS__
+
+#include "tapa/stream.h"
+
+namespace tapa {
+
+/// Result of a lookup in a @c tapa::hash_table.
+template <typename V>
+struct hash_result {
+  bool found;  ///< Whether the key is in the table.
+  V value;     ///< Value of the key if @c found.
+};
+
+namespace internal {
+
+// Fibonacci hashing of keys convertible to `uint64_t`, whose high bits are
+// well mixed even if the keys are consecutive.
+struct multiplicative_hash {
+  template <typename K>
+  uint64_t operator()(const K& key) const {
+#pragma HLS inline
+    return static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+  }
+};
+
+// Entries of a bucket, which are stored as one word so that a bucket is read
+// or written in one access.
+template <typename K, typename V, int Ways>
+struct hash_bucket {
+  K keys[Ways];
+  V values[Ways];
+  bool valid[Ways];
+};
+
+// Returns `rhs`, so that an update with it is an insertion.
+struct hash_assign {
+  template <typename V>
+  V operator()(const V& lhs, const V& rhs) const {
+#pragma HLS inline
+    return rhs;
+  }
+};
+
+}  // namespace internal
+
+/// On-chip hash table for join and aggregation tasks, whose lookups and
+/// updates are pipelined at II=1.
+///
+/// The table has @c Buckets buckets of @c Ways entries each; a key is stored
+/// in the bucket selected by the high bits of <tt>Hash()(key)</tt>, and an
+/// insertion fails if that bucket is full. A bucket is a single word of BRAM
+/// or URAM, read and written back in one access. Since the write of an update
+/// is not visible to the reads of the next few iterations of a pipelined loop,
+/// the last @c kForwardDistance buckets written are kept in registers and
+/// forwarded to accesses of the same buckets, so back-to-back updates of the
+/// same key do not stall. In software simulation, the buckets are on the heap
+/// and no forwarding is needed.
+///
+/// A table is a local variable of a task, whose constructor clears the table
+/// in @c Buckets cycles, e.g.,
+/// @code
+/// void Count(tapa::istream<uint32_t>& keys, tapa::ostream<bool>& ok) {
+///   tapa::hash_table<uint32_t, uint32_t, 4096> counts;
+///   for (;;) {
+/// #pragma HLS pipeline II = 1
+///     ok.write(counts.update(keys.read(), 1, std::plus<uint32_t>()));
+///   }
+/// }
+/// @endcode
+///
+/// @tparam K       Type of the keys, which is converted to @c uint64_t by the
+///                 default @c Hash, e.g., an integer or an @c ap_uint of up to
+///                 64 bits.
+/// @tparam V       Type of the values.
+/// @tparam Buckets Number of buckets; must be a power of 2 and at least 2.
+/// @tparam Ways    Number of entries in each bucket.
+/// @tparam Hash    Function object that returns a @c uint64_t hash of a key,
+///                 whose high bits select the bucket.
+template <typename K, typename V, uint64_t Buckets, int Ways = 4,
+          typename Hash = internal::multiplicative_hash>
+class hash_table {
+  static_assert(Buckets >= 2 && (Buckets & (Buckets - 1)) == 0,
+                "Buckets must be a power of 2 and at least 2");
+  static_assert(Ways >= 1, "Ways must be positive");
+
+  using bucket_t = internal::hash_bucket<K, V, Ways>;
+
+ public:
+  /// Number of recently written buckets forwarded to later accesses, which
+  /// covers the read and write latencies of BRAM and URAM.
+  static constexpr int kForwardDistance = 4;
+
+  /// Constructs an empty table.
+  hash_table()
+#ifndef __SYNTHESIS__
+      : buckets_(Buckets)
+#endif  // __SYNTHESIS__
+  {
+#pragma HLS inline
+#pragma HLS aggregate variable = buckets_
+#pragma HLS array_partition variable = recent_idx_ complete
+#pragma HLS array_partition variable = recent_ complete
+    clear();
+  }
+
+  /// Removes all entries, in @c Buckets cycles in hardware.
+  void clear() {
+#pragma HLS inline
+    for (uint64_t i = 0; i < Buckets; ++i) {
+#pragma HLS pipeline II = 1
+      for (int j = 0; j < Ways; ++j) {
+#pragma HLS unroll
+        buckets_[i].valid[j] = false;
+      }
+    }
+#ifdef __SYNTHESIS__
+    for (int i = 0; i < kForwardDistance; ++i) {
+#pragma HLS unroll
+      recent_idx_[i] = -1;
+    }
+#endif  // __SYNTHESIS__
+  }
+
+  /// Looks up @c key.
+  ///
+  /// @param[in]  key   Key to look up.
+  /// @param[out] value Value of @c key, updated only if found.
+  /// @return           Whether @c key is in the table.
+  bool lookup(const K& key, V& value) const {
+#pragma HLS inline
+    const bucket_t bucket = load(bucket_of(key));
+    bool found = false;
+    for (int j = 0; j < Ways; ++j) {
+#pragma HLS unroll
+      if (bucket.valid[j] && bucket.keys[j] == key) {
+        value = bucket.values[j];
+        found = true;
+      }
+    }
+    return found;
+  }
+
+  /// Inserts @c key with @c value, or replaces the value if @c key exists.
+  ///
+  /// @return Whether @c key is in the table afterwards, which is false only if
+  ///         its bucket is full.
+  bool insert(const K& key, const V& value) {
+#pragma HLS inline
+    return update(key, value, internal::hash_assign());
+  }
+
+  /// Sets the value of @c key to <tt>op(old, value)</tt> if @c key exists, or
+  /// inserts @c key with @c value otherwise, e.g., to aggregate with
+  /// <tt>std::plus<V>()</tt>.
+  ///
+  /// @return Whether @c key is in the table afterwards, which is false only if
+  ///         its bucket is full.
+  template <typename Op>
+  bool update(const K& key, const V& value, const Op& op) {
+#pragma HLS inline
+    const uint64_t idx = bucket_of(key);
+    bucket_t bucket = load(idx);
+    int hit = -1;
+    int vacancy = -1;
+    for (int j = Ways - 1; j >= 0; --j) {
+#pragma HLS unroll
+      if (bucket.valid[j] && bucket.keys[j] == key) hit = j;
+      if (!bucket.valid[j]) vacancy = j;
+    }
+    if (hit >= 0) {
+      bucket.values[hit] = op(bucket.values[hit], value);
+    } else if (vacancy >= 0) {
+      bucket.keys[vacancy] = key;
+      bucket.values[vacancy] = value;
+      bucket.valid[vacancy] = true;
+    } else {
+      return false;
+    }
+    store(idx, bucket);
+    return true;
+  }
+
+  /// Serves lookups and insertions requested on streams, like the channels
+  /// of a @c tapa::async_mmap, until both @c read_key and @c write_key reach
+  /// EoT.
+  ///
+  /// Each key of @c read_key is looked up and answered on @c read_data, and
+  /// each key of @c write_key is inserted with the next value of
+  /// @c write_data and acknowledged on @c write_resp with the result of
+  /// @c insert. Responses are in the order of the requests on each side, but
+  /// lookups are not ordered with insertions; wait for the response of an
+  /// insertion before looking up its key. One request is served per cycle in
+  /// hardware, and requests are served in batches in simulation. EoT tokens
+  /// are consumed from the request streams and written to the response
+  /// streams.
+  void serve(istream<K>& read_key, ostream<hash_result<V>>& read_data,
+             istream<K>& write_key, istream<V>& write_data,
+             ostream<bool>& write_resp) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+    bool is_read_done = false;
+    bool is_write_done = false;
+  serve:
+    while (!is_read_done || !is_write_done) {
+#pragma HLS pipeline II = 1
+      bool is_eot;
+      if (!is_write_done && write_key.try_eot(is_eot)) {
+        if (is_eot) {
+          is_write_done = true;
+        } else if (!write_data.empty() && !write_resp.full()) {
+          const K key = write_key.read(nullptr);
+          write_resp.write(insert(key, write_data.read(nullptr)));
+          continue;
+        }
+      }
+      if (!is_read_done && read_key.try_eot(is_eot)) {
+        if (is_eot) {
+          is_read_done = true;
+        } else if (!read_data.full()) {
+          hash_result<V> result;
+          result.found = lookup(read_key.read(nullptr), result.value);
+          read_data.write(result);
+        }
+      }
+    }
+#else   // __SYNTHESIS__
+    constexpr size_t kBatch = 64;  // requests per copy on each side
+    std::array<K, kBatch> keys;
+    std::array<V, kBatch> values;
+    std::array<hash_result<V>, kBatch> results;
+    std::array<bool, kBatch> resps;
+    bool is_read_done = false;
+    bool is_write_done = false;
+    while (!is_read_done || !is_write_done) {
+      bool is_eot;
+      if (!is_write_done) {
+        const size_t n = write_key.try_read_burst(keys.data(), kBatch);
+        write_data.read(values.data(), n);
+        for (size_t i = 0; i < n; ++i) resps[i] = insert(keys[i], values[i]);
+        write_resp.write(resps.data(), n);
+        is_write_done = n == 0 && write_key.try_eot(is_eot) && is_eot;
+      }
+      if (!is_read_done) {
+        const size_t n = read_key.try_read_burst(keys.data(), kBatch);
+        for (size_t i = 0; i < n; ++i) {
+          results[i].found = lookup(keys[i], results[i].value);
+        }
+        read_data.write(results.data(), n);
+        is_read_done = n == 0 && read_key.try_eot(is_eot) && is_eot;
+      }
+    }
+#endif  // __SYNTHESIS__
+    read_key.open();
+    write_key.open();
+    read_data.close();
+    write_resp.close();
+  }
+
+ private:
+  static uint64_t bucket_of(const K& key) {
+#pragma HLS inline
+    constexpr int kBucketBits = __builtin_ctzll(Buckets);
+    return Hash()(key) >> (64 - kBucketBits);
+  }
+
+  // Reads bucket `idx`, taking the newest of the recently written copies.
+  bucket_t load(uint64_t idx) const {
+#pragma HLS inline
+#ifdef __SYNTHESIS__
+#pragma HLS dependence variable = buckets_ inter false
+    bucket_t bucket = buckets_[idx];
+    for (int i = kForwardDistance - 1; i >= 0; --i) {
+#pragma HLS unroll
+      if (recent_idx_[i] == int64_t(idx)) bucket = recent_[i];
+    }
+    return bucket;
+#else   // __SYNTHESIS__
+    return buckets_[idx];
+#endif  // __SYNTHESIS__
+  }
+
+  // Writes bucket `idx` and keeps it as the newest recently written copy.
+  void store(uint64_t idx, const bucket_t& bucket) {
+#pragma HLS inline
+#ifdef __SYNTHESIS__
+#pragma HLS dependence variable = buckets_ inter false
+    buckets_[idx] = bucket;
+    for (int i = kForwardDistance - 1; i > 0; --i) {
+#pragma HLS unroll
+      recent_idx_[i] = recent_idx_[i - 1];
+      recent_[i] = recent_[i - 1];
+    }
+    recent_idx_[0] = idx;
+    recent_[0] = bucket;
+#else   // __SYNTHESIS__
+    buckets_[idx] = bucket;
+#endif  // __SYNTHESIS__
+  }
+
+#ifdef __SYNTHESIS__
+  bucket_t buckets_[Buckets];
+  int64_t recent_idx_[kForwardDistance];  // -1 if unused
+  bucket_t recent_[kForwardDistance];
+#else   // __SYNTHESIS__
+  std::vector<bucket_t> buckets_;
+#endif  // __SYNTHESIS__
+};
+
+}  // namespace tapa
+
+#endif  // TAPA_HASH_TABLE_H_
@@ -0,0 +1,200 @@
+#ifndef TAPA_HOST_LAYOUT_H_
+#define TAPA_HOST_LAYOUT_H_
+
+#ifndef __SYNTHESIS__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+
+#include <glog/logging.h>
+
+#include "tapa/interleave.h"
+#include "tapa/mmap.h"
+#include "tapa/vec.h"
+
+namespace tapa {
+
+namespace internal {
+
+// Calls `f(begin, end)` on disjoint ranges that cover [0, n) on up to as many
+// host threads as there are cores, each with at least `grain` items unless it
+// is the only one. Returns after all calls return.
+void parallel_for(uint64_t n, uint64_t grain,
+                  const std::function<void(uint64_t, uint64_t)>& f);
+
+// Number of elements of `T` worth a host thread of their own.
+template <typename T>
+constexpr uint64_t host_grain() {
+  return std::max<uint64_t>((uint64_t(1) << 20) / sizeof(T), 1);
+}
+
+// Copies `n` elements between `ptr` and `banks`, which hold every `S`-th
+// granule of `Granule` elements in turn.
+template <uint64_t Granule, typename T, uint64_t S>
+void copy_banks(T* ptr, uint64_t n, const std::array<T*, S>& banks,
+                bool is_scatter) {
+  using addr = interleaved_addr<S, Granule>;
+  const uint64_t granules = (n + Granule - 1) / Granule;
+  const uint64_t grain = std::max<uint64_t>(host_grain<T>() / Granule, 1);
+  parallel_for(granules, grain, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin * Granule; i < std::min(end * Granule, n);
+         i += Granule) {
+      T* bank = banks[addr::bank(i)] + addr::local(i);
+      const uint64_t len = std::min(Granule, n - i);
+      if (is_scatter) {
+        std::copy_n(ptr + i, len, bank);
+      } else {
+        std::copy_n(bank, len, ptr + i);
+      }
+    }
+  });
+}
+
+// Returns pointers to the banks of `banks` after checking that they hold `n`
+// elements.
+template <uint64_t Granule, typename T, uint64_t S>
+std::array<T*, S> get_banks(mmaps<T, S>& banks, uint64_t n) {
+  using addr = interleaved_addr<S, Granule>;
+  std::array<T*, S> ptrs;
+  for (uint64_t i = 0; i < S; ++i) ptrs[i] = banks[i].get();
+  // The last granule of each bank is among the last `S` granules.
+  for (uint64_t i = 0; i < S && i * Granule < n; ++i) {
+    const uint64_t last = (n - 1) / Granule * Granule - i * Granule;
+    CHECK_GE(banks[addr::bank(last)].size(),
+             addr::local(last) + std::min(Granule, n - last))
+        << "bank " << addr::bank(last) << " cannot hold its elements";
+  }
+  return ptrs;
+}
+
+}  // namespace internal
+
+/// Copies the @c n elements at @c src to <tt>(n + N - 1) / N</tt> vectors at
+/// @c dst, filling the elements after the last one with @c pad. The inverse is
+/// @c tapa::unpack_from_vec.
+///
+/// This and the other layout transforms of host data run on as many threads as
+/// there are cores if the data are large enough, and their loops are simple
+/// enough for the compiler to vectorize, so that preparing the arguments of
+/// @c tapa::invoke is bound by the bandwidth of host memory.
+template <int N, typename T>
+void pack_to_vec(const T* src, uint64_t n, vec_t<T, N>* dst,
+                 const T& pad = T()) {
+  static_assert(sizeof(vec_t<T, N>) == sizeof(T) * N,
+                "vector must be packed");
+  T* out = reinterpret_cast<T*>(dst);
+  internal::parallel_for(
+      n, internal::host_grain<T>(),
+      [&](uint64_t begin, uint64_t end) {
+        std::copy(src + begin, src + end, out + begin);
+      });
+  std::fill(out + n, out + (n + N - 1) / N * N, pad);
+}
+
+/// Copies the first @c n elements of the vectors at @c src to @c dst.
+template <int N, typename T>
+void unpack_from_vec(const vec_t<T, N>* src, uint64_t n, T* dst) {
+  static_assert(sizeof(vec_t<T, N>) == sizeof(T) * N,
+                "vector must be packed");
+  const T* in = reinterpret_cast<const T*>(src);
+  internal::parallel_for(
+      n, internal::host_grain<T>(),
+      [&](uint64_t begin, uint64_t end) {
+        std::copy(in + begin, in + end, dst + begin);
+      });
+}
+
+/// Splits the @c n elements at @c src to the @c S banks of @c banks, each
+/// holding every @c S-th granule of @c Granule elements in turn, i.e., in the
+/// layout of @c tapa::interleaved_mmap. Each bank must hold its elements. The
+/// inverse is @c tapa::merge_banks.
+///
+/// @tparam Granule Number of consecutive elements in each bank; must be a
+///                 power of 2.
+template <uint64_t Granule, typename T, uint64_t S>
+void split_to_banks(const T* src, uint64_t n, mmaps<T, S> banks) {
+  internal::copy_banks<Granule>(const_cast<T*>(src), n,
+                                internal::get_banks<Granule>(banks, n),
+                                /*is_scatter=*/true);
+}
+
+/// Merges the @c n elements split by @c tapa::split_to_banks from @c banks
+/// back to @c dst.
+template <uint64_t Granule, typename T, uint64_t S>
+void merge_banks(mmaps<T, S> banks, T* dst, uint64_t n) {
+  internal::copy_banks<Granule>(dst, n, internal::get_banks<Granule>(banks, n),
+                                /*is_scatter=*/false);
+}
+
+/// Interleaves arrays of @c n elements at @c srcs to @c dst, i.e., element
+/// @c i of the @c k-th array becomes element <tt>i * K + k</tt> of @c dst,
+/// where @c K is the number of arrays, e.g., to pack the fields of a structure
+/// of arrays into a @c tapa::vec_t<T, K>. The inverse is
+/// @c tapa::deinterleave.
+template <typename T, typename... Srcs>
+void interleave(uint64_t n, T* dst, const Srcs*... srcs) {
+  constexpr uint64_t K = sizeof...(Srcs);
+  const std::array<const T*, K> in = {srcs...};
+  internal::parallel_for(
+      n, internal::host_grain<T>() / K + 1,
+      [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+          for (uint64_t k = 0; k < K; ++k) dst[i * K + k] = in[k][i];
+        }
+      });
+}
+
+/// Deinterleaves @c n groups of elements at @c src to @c dsts, i.e., element
+/// <tt>i * K + k</tt> of @c src becomes element @c i of the @c k-th array,
+/// where @c K is the number of arrays.
+template <typename T, typename... Dsts>
+void deinterleave(uint64_t n, const T* src, Dsts*... dsts) {
+  constexpr uint64_t K = sizeof...(Dsts);
+  const std::array<T*, K> out = {dsts...};
+  internal::parallel_for(
+      n, internal::host_grain<T>() / K + 1,
+      [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+          for (uint64_t k = 0; k < K; ++k) out[k][i] = src[i * K + k];
+        }
+      });
+}
+
+/// Transposes the row-major matrix of @c rows x @c cols elements at @c src to
+/// the row-major matrix of @c cols x @c rows elements at @c dst, e.g., to
+/// store a matrix column by column. The inverse is a transpose with @c rows
+/// and @c cols swapped.
+template <typename T>
+void transpose(const T* src, uint64_t rows, uint64_t cols, T* dst) {
+  // Tiles of the matrix fit in the cache so that neither side is accessed
+  // with a large stride one element at a time.
+  constexpr uint64_t kTile = 32;
+  const uint64_t tile_rows = (rows + kTile - 1) / kTile;
+  const uint64_t tile_size = kTile * std::max<uint64_t>(cols, 1);
+  const uint64_t grain =
+      std::max<uint64_t>(internal::host_grain<T>() / tile_size, 1);
+  internal::parallel_for(tile_rows, grain, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t r0 = begin * kTile; r0 < std::min(end * kTile, rows);
+         r0 += kTile) {
+      const uint64_t r1 = std::min(r0 + kTile, rows);
+      for (uint64_t c0 = 0; c0 < cols; c0 += kTile) {
+        const uint64_t c1 = std::min(c0 + kTile, cols);
+        for (uint64_t r = r0; r < r1; ++r) {
+          for (uint64_t c = c0; c < c1; ++c) {
+            dst[c * rows + r] = src[r * cols + c];
+          }
+        }
+      }
+    }
+  });
+}
+
+}  // namespace tapa
+
+#endif  // __SYNTHESIS__
+
+#endif  // TAPA_HOST_LAYOUT_H_
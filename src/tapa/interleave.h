@@ -0,0 +1,239 @@
+#ifndef TAPA_INTERLEAVE_H_
+#define TAPA_INTERLEAVE_H_
+
+#include <cstdint>
+
+#include "tapa/mmap.h"
+#include "tapa/stream.h"
+
+namespace tapa {
+
+namespace internal {
+
+// Location of element `addr` of an interleaved mmap whose granules of
+// `Granule` elements are dealt to `S` banks in turn.
+template <uint64_t S, uint64_t Granule>
+struct interleaved_addr {
+  static_assert(S >= 1 && (S & (S - 1)) == 0, "S must be a power of 2");
+  static_assert(Granule >= 1 && (Granule & (Granule - 1)) == 0,
+                "Granule must be a power of 2");
+
+  static uint64_t bank(uint64_t addr) {
+#pragma HLS inline
+    return (addr / Granule) % S;
+  }
+
+  static uint64_t local(uint64_t addr) {
+#pragma HLS inline
+    return addr / Granule / S * Granule + addr % Granule;
+  }
+
+  // Number of elements from `addr` to the end of its granule.
+  static uint64_t granule_left(uint64_t addr) {
+#pragma HLS inline
+    return Granule - addr % Granule;
+  }
+};
+
+}  // namespace internal
+
+/// Routes the requests of one @c tapa::async_mmap interface on streams to @c S
+/// banks that hold the granules of an interleaved memory in turn, e.g., the
+/// HBM channels of a @c tapa::interleaved_mmap, so that a task reads and
+/// writes the aggregate bandwidth of all banks through a single interface.
+///
+/// Element @c a of the interleaved memory is element
+/// <tt>a / Granule / S * Granule + a % Granule</tt> of bank
+/// <tt>a / Granule % S</tt>. Explicit burst requests are split at granule
+/// boundaries, and read data are returned in the order of the requests.
+/// Write responses of all banks are forwarded as is, i.e., each acknowledges
+/// one more write than its value, but not necessarily in the order of the
+/// requests. At most 64 pieces of read requests are outstanding.
+///
+/// Never returns; call it in a detached task, and forward each bank with
+/// @c tapa::forward_requests in another, e.g.,
+/// @code{.cpp}
+///  void Route(tapa::istream<int64_t>& read_addr, tapa::ostream<float>& ...,
+///             tapa::ostreams<int64_t, 4>& bank_read_addr, ...) {
+///    tapa::interleave_requests<1024>(read_addr, ..., bank_read_addr, ...);
+///  }
+///  void Bank(tapa::async_mmap<float>& mem, tapa::istream<int64_t>& read_addr,
+///            ...) {
+///    tapa::forward_requests(mem, read_addr, ...);
+///  }
+///  void Top(tapa::mmaps<float, 4> mems, ...) {
+///    ...
+///    tapa::task()
+///        .invoke<tapa::detach>(Route, read_addr, ..., bank_read_addr, ...)
+///        .invoke<tapa::detach, 4>(Bank, mems, bank_read_addr, ...)
+///        .invoke(Compute, read_addr, read_data, ...);
+///  }
+/// @endcode
+///
+/// @tparam Granule Number of consecutive elements in each bank; must be a
+///                 power of 2.
+/// @tparam S       Number of banks; must be a power of 2.
+template <uint64_t Granule, typename T, uint64_t S>
+void interleave_requests(istream<int64_t>& read_addr, ostream<T>& read_data,
+                         istream<int64_t>& write_addr, istream<T>& write_data,
+                         ostream<uint8_t>& write_resp,
+                         ostreams<int64_t, S>& bank_read_addr,
+                         istreams<T, S>& bank_read_data,
+                         ostreams<int64_t, S>& bank_write_addr,
+                         ostreams<T, S>& bank_write_data,
+                         istreams<uint8_t, S>& bank_write_resp) {
+  using addr = internal::interleaved_addr<S, Granule>;
+  constexpr int kTags = 64;  // must be a power of 2
+
+  // Pieces of read requests sent to the banks, whose data are returned in
+  // order.
+  uint8_t tag_bank[kTags];
+  uint16_t tag_len[kTags];
+#pragma HLS array_partition variable = tag_bank complete
+#pragma HLS array_partition variable = tag_len complete
+  uint8_t tag_head = 0;
+  uint8_t tag_tail = 0;
+  uint8_t tag_count = 0;
+
+  uint64_t read_next = 0;  // address of the read request being split
+  uint64_t read_len = 0;   // elements of it not sent yet
+  uint8_t read_bank = 0;   // bank of the data being returned
+  uint64_t read_left = 0;  // elements of it not returned yet
+
+  uint64_t write_next = 0;  // address of the write request being split
+  uint64_t write_len = 0;   // elements of it not sent yet
+  uint8_t write_bank = 0;   // bank of the data being forwarded
+  uint64_t write_left = 0;  // elements of it not forwarded yet
+
+  for (;;) {
+#pragma HLS pipeline II = 1
+    int64_t req;
+
+    // Split read requests at granule boundaries.
+    if (read_len == 0 && read_addr.try_read(req)) {
+      read_next = internal::decode_burst_addr(req);
+      read_len = internal::decode_burst_len(req);
+    }
+    bool is_tag_pushed = false;
+    if (read_len > 0 && tag_count < kTags) {
+      const uint64_t bank = addr::bank(read_next);
+      const uint64_t left = addr::granule_left(read_next);
+      const uint64_t n = read_len < left ? read_len : left;
+      const int64_t local = addr::local(read_next);
+      const int64_t piece = n > 1 ? internal::encode_burst(local, n) : local;
+      for (uint64_t b = 0; b < S; ++b) {
+#pragma HLS unroll
+        if (b == bank && bank_read_addr[b].try_write(piece)) {
+          is_tag_pushed = true;
+        }
+      }
+      if (is_tag_pushed) {
+        tag_bank[tag_tail % kTags] = bank;
+        tag_len[tag_tail % kTags] = n;
+        ++tag_tail;
+        read_next += n;
+        read_len -= n;
+      }
+    }
+
+    // Return read data in the order of the pieces. A piece is popped with its
+    // first element so that every change of state comes with a channel
+    // access, which software simulation relies on to wake the task up.
+    bool is_tag_popped = false;
+    if ((read_left > 0 || tag_count > 0) && !read_data.full()) {
+      const bool is_new = read_left == 0;
+      const uint8_t bank = is_new ? tag_bank[tag_head % kTags] : read_bank;
+      for (uint64_t b = 0; b < S; ++b) {
+#pragma HLS unroll
+        if (b == bank && !bank_read_data[b].empty()) {
+          read_data.write(bank_read_data[b].read(nullptr));
+          if (is_new) {
+            read_bank = bank;
+            read_left = tag_len[tag_head % kTags];
+            ++tag_head;
+            is_tag_popped = true;
+          }
+          --read_left;
+        }
+      }
+    }
+    tag_count += is_tag_pushed;
+    tag_count -= is_tag_popped;
+
+    // Split write requests at granule boundaries, each followed by its data.
+    if (write_len == 0 && write_left == 0 && write_addr.try_read(req)) {
+      write_next = internal::decode_burst_addr(req);
+      write_len = internal::decode_burst_len(req);
+    }
+    if (write_len > 0 && write_left == 0) {
+      const uint64_t bank = addr::bank(write_next);
+      const uint64_t left = addr::granule_left(write_next);
+      const uint64_t n = write_len < left ? write_len : left;
+      const int64_t local = addr::local(write_next);
+      const int64_t piece = n > 1 ? internal::encode_burst(local, n) : local;
+      for (uint64_t b = 0; b < S; ++b) {
+#pragma HLS unroll
+        if (b == bank && bank_write_addr[b].try_write(piece)) {
+          write_bank = bank;
+          write_left = n;
+          write_next += n;
+          write_len -= n;
+        }
+      }
+    } else if (write_left > 0) {
+      for (uint64_t b = 0; b < S; ++b) {
+#pragma HLS unroll
+        if (b == write_bank && !bank_write_data[b].full() &&
+            !write_data.empty()) {
+          bank_write_data[b].write(write_data.read(nullptr));
+          --write_left;
+        }
+      }
+    }
+
+    // Forward one write response per cycle, from the lowest bank that has one.
+    // Each stream is polled at most once per iteration, or a task polling a
+    // full stream twice in a row sleeps on that stream only in simulation.
+    if (!write_resp.full()) {
+      bool is_resp_forwarded = false;
+      for (uint64_t b = 0; b < S; ++b) {
+#pragma HLS unroll
+        if (!is_resp_forwarded && !bank_write_resp[b].empty()) {
+          write_resp.write(bank_write_resp[b].read(nullptr));
+          is_resp_forwarded = true;
+        }
+      }
+    }
+  }
+}
+
+/// Forwards the requests of a @c tapa::async_mmap interface on streams to
+/// @c mem and its responses back, e.g., for one bank of
+/// @c tapa::interleave_requests. Never returns; call it in a detached task.
+template <typename T>
+void forward_requests(async_mmap<T>& mem, istream<int64_t>& read_addr,
+                      ostream<T>& read_data, istream<int64_t>& write_addr,
+                      istream<T>& write_data, ostream<uint8_t>& write_resp) {
+  for (;;) {
+#pragma HLS pipeline II = 1
+    if (!mem.read_addr.full() && !read_addr.empty()) {
+      mem.read_addr.write(read_addr.read(nullptr));
+    }
+    if (!read_data.full() && !mem.read_data.empty()) {
+      read_data.write(mem.read_data.read(nullptr));
+    }
+    if (!mem.write_addr.full() && !write_addr.empty()) {
+      mem.write_addr.write(write_addr.read(nullptr));
+    }
+    if (!mem.write_data.full() && !write_data.empty()) {
+      mem.write_data.write(write_data.read(nullptr));
+    }
+    if (!write_resp.full() && !mem.write_resp.empty()) {
+      write_resp.write(mem.write_resp.read(nullptr));
+    }
+  }
+}
+
+}  // namespace tapa
+
+#endif  // TAPA_INTERLEAVE_H_
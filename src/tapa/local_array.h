@@ -0,0 +1,112 @@
+#ifndef TAPA_LOCAL_ARRAY_H_
+#define TAPA_LOCAL_ARRAY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#ifndef __SYNTHESIS__
+
+#include <memory>
+
+#endif  // __SYNTHESIS__
+
+#include "tapa/stream.h"
+
+namespace tapa {
+
+#ifndef __SYNTHESIS__
+
+namespace internal {
+
+// Alignment of the memory of local arrays.
+constexpr size_t kLocalArrayAlignment = 64;
+
+// Returns memory of `bytes` bytes for a local array, reusing memory freed by
+// local arrays of the same size if any, so that tasks started over and over do
+// not allocate each time.
+void* allocate_local_array(size_t bytes);
+
+// Keeps the memory of a local array for later local arrays of the same size.
+void free_local_array(void* ptr, size_t bytes);
+
+}  // namespace internal
+
+#endif  // __SYNTHESIS__
+
+/// Defines an on-chip array local to a task, to be used like a C array.
+///
+/// In hardware, @c tapacc declares it as a C array of @c N elements bound to
+/// the memory given by @c Impl, which may be partitioned with
+/// <tt>[[tapa::partition]]</tt> like a C array. In software simulation, its
+/// elements live on the heap instead of the stack of the task, so that large
+/// tiles and buffers do not require large coroutine stacks (see environment
+/// variable @c TAPA_COROUTINE_STACK_SIZE); memory is pooled for later local
+/// arrays of the same size. Software simulation value-initializes the elements,
+/// i.e., zeroes those of trivial types; declare the array with <tt>= {}</tt>
+/// for hardware to do the same, as for a C array.
+///
+/// @code{.cpp}
+///  void Conv(tapa::istream<float>& in, tapa::ostream<float>& out) {
+///    [[tapa::partition(cyclic, 4)]] tapa::local_array<float, 4096,
+///                                                     tapa::impl::uram> tile;
+///    for (int i = 0; i < 4096; ++i) tile[i] = in.read();
+///    ...
+///  }
+/// @endcode
+///
+/// @tparam T    Type of each element, which may be an array itself.
+/// @tparam N    Number of elements.
+/// @tparam Impl Memory of the array in hardware; one of @c tapa::impl except
+///              @c tapa::impl::srl.
+template <typename T, uint64_t N, typename Impl = impl::automatic>
+class local_array {
+  static_assert(N > 0, "local array must not be empty");
+  static_assert(!std::is_same<Impl, impl::srl>::value,
+                "local array cannot be implemented with shift registers");
+
+ public:
+#ifndef __SYNTHESIS__
+  static_assert(alignof(T) <= internal::kLocalArrayAlignment,
+                "element type of local array is over-aligned");
+
+  local_array()
+      : data_(static_cast<T*>(internal::allocate_local_array(sizeof(T) * N))) {
+    std::uninitialized_value_construct_n(data_, N);
+  }
+
+  ~local_array() {
+    if constexpr (!std::is_trivially_destructible<T>::value) {
+      std::destroy_n(data_, N);
+    }
+    internal::free_local_array(data_, sizeof(T) * N);
+  }
+
+  local_array(const local_array&) = delete;
+  local_array& operator=(const local_array&) = delete;
+#endif  // __SYNTHESIS__
+
+  /// Decays to a pointer to the first element, like a C array does.
+  operator T*() { return data_; }
+  operator const T*() const { return data_; }
+
+  /// Returns a pointer to the first element.
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+
+  /// Returns the number of elements.
+  static constexpr uint64_t size() { return N; }
+
+ private:
+#ifdef __SYNTHESIS__
+  // Declarations are rewritten as C arrays by tapacc; this keeps the code valid
+  // for tools that see it as is.
+  T data_[N];
+#else   // __SYNTHESIS__
+  T* const data_;
+#endif  // __SYNTHESIS__
+};
+
+}  // namespace tapa
+
+#endif  // TAPA_LOCAL_ARRAY_H_
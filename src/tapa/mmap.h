@@ -2,17 +2,30 @@
 #define TAPA_MMAP_H_
 
 #include <cstddef>
+#include <cstdint>
 
 #ifndef __SYNTHESIS__
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <queue>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <typeinfo>
+#include <utility>
 #include <vector>
 
 #include <frt.h>
 
 #include "tapa/coroutine.h"
+#include "tapa/probe.h"
 
 #endif  // __SYNTHESIS__
 
@@ -28,13 +41,530 @@ namespace internal {
 template <typename Param, typename Arg>
 struct accessor;
 
+// Whether an FRT buffer is copied to the device before the kernel runs and
+// back to the host after the kernel finishes.
+template <typename Buffer>
+struct buffer_direction {
+  static constexpr bool to_device = false;
+  static constexpr bool from_device = false;
+};
+template <typename T>
+struct buffer_direction<fpga::WriteOnlyBuffer<T>> {
+  static constexpr bool to_device = true;
+  static constexpr bool from_device = false;
+};
+template <typename T>
+struct buffer_direction<fpga::ReadOnlyBuffer<T>> {
+  static constexpr bool to_device = false;
+  static constexpr bool from_device = true;
+};
+template <typename T>
+struct buffer_direction<fpga::ReadWriteBuffer<T>> {
+  static constexpr bool to_device = true;
+  static constexpr bool from_device = true;
+};
+
+// Host memory that the kernel accesses directly, e.g., via the slave bridge of
+// the platform; see `tapa::host_mmap`. FRT sees a placeholder buffer, which is
+// never copied, and allocates it in host memory as the connectivity of the
+// bitstream binds the argument to `HOST[0]`.
+template <typename T>
+struct host_buffer {
+  fpga::PlaceholderBuffer<T> buffer;
+};
+
+template <typename T>
+inline host_buffer<T> make_host_buffer(T* ptr, size_t size) {
+  return {fpga::Placeholder(ptr, size)};
+}
+
+// Returns the buffer passed to FRT.
+template <typename Buffer>
+inline const Buffer& get_frt_buffer(const Buffer& buf) {
+  return buf;
+}
+template <typename T>
+inline const fpga::PlaceholderBuffer<T>& get_frt_buffer(
+    const host_buffer<T>& buf) {
+  return buf.buffer;
+}
+
+// Whether an FRT buffer is in host memory.
+template <typename Buffer>
+struct is_host_buffer : std::false_type {};
+template <typename T>
+struct is_host_buffer<host_buffer<T>> : std::true_type {};
+
+// Logs a warning if buffer argument `idx` of `bytes` bytes at `ptr` cannot be
+// transferred in place, i.e., if it is not page-aligned.
+void log_if_copied(int idx, const void* ptr, uint64_t bytes);
+
+// Runs the RTL simulator generated by `tapac --verilator` in a child process
+// instead of a bitstream. Arguments are passed via files in a temporary
+// directory; see `tapa_verilator.h` of tapac for the simulator side.
+class rtl_sim {
+ public:
+  explicit rtl_sim(const std::string& executable);
+  ~rtl_sim();
+
+  rtl_sim(const rtl_sim&) = delete;
+  rtl_sim& operator=(const rtl_sim&) = delete;
+
+  void set_scalar_arg(int idx, const void* ptr, size_t bytes);
+  void set_buffer_arg(int idx, void* ptr, uint64_t bytes, bool to_device,
+                      bool from_device);
+
+  // Same as the methods of `fpga::Instance`. The simulation runs to
+  // completion in `Exec`.
+  void WriteToDevice();
+  void Exec();
+  void ReadFromDevice();
+  void Finish() {}
+  int64_t LoadTimeNanoSeconds() const { return load_ns_; }
+  int64_t ComputeTimeNanoSeconds() const { return compute_ns_; }
+  int64_t StoreTimeNanoSeconds() const { return store_ns_; }
+
+  // Whether `bitstream` is a simulator generated by `tapac --verilator`.
+  static bool is_rtl_sim(const std::string& bitstream);
+
+ private:
+  struct arg_t {
+    std::string value;  // Bytes of a scalar argument.
+    void* ptr = nullptr;  // Host memory of a buffer argument.
+    uint64_t bytes = 0;
+    bool to_device = false;
+    bool from_device = false;
+  };
+
+  std::string get_buffer_path(int idx) const;
+
+  std::string executable_;
+  std::string dir_;
+  std::vector<arg_t> args_;
+  int64_t load_ns_ = 0;
+  int64_t compute_ns_ = 0;
+  int64_t store_ns_ = 0;
+};
+
+// An FRT instance that remembers the buffers set as its arguments, so that an
+// argument set to the same host memory again reuses its device buffer.
+class instance {
+ public:
+  // An argument recorded instead of being set, which `set` sets on another
+  // instance, possibly in a forked process.
+  struct arg_t {
+    void (*set)(instance& instance, int idx, const arg_t& arg) = nullptr;
+    const void* ptr = nullptr;  // Host memory of a buffer argument.
+    uint64_t size = 0;          // Number of elements of a buffer argument.
+    alignas(std::max_align_t) unsigned char value[64];  // Copied bitwise.
+  };
+
+  explicit instance(const std::string& bitstream) {
+    if (rtl_sim::is_rtl_sim(bitstream)) {
+      this->sim.reset(new rtl_sim(bitstream));
+    } else {
+      this->frt.reset(new fpga::Instance(bitstream));
+    }
+  }
+
+  // Records arguments to `args` instead of setting them. No bitstream is
+  // loaded.
+  explicit instance(std::vector<arg_t>* args) : args(args) {}
+
+  // Sets a scalar argument.
+  template <typename T>
+  void set_arg(int idx, const T& arg) {
+    if (this->args != nullptr) {
+      this->record(idx, arg, nullptr, 0,
+                   [](instance& instance, int idx, const arg_t& arg) {
+                     instance.set_arg(idx, load<T>(arg));
+                   });
+      return;
+    }
+    if (size_t(idx) < this->buffers.size()) this->buffers[idx] = {};
+    if (this->sim != nullptr) {
+      this->sim->set_scalar_arg(idx, &arg, sizeof(arg));
+      return;
+    }
+    this->frt->SetArg(idx, arg);
+  }
+
+  // Sets a buffer argument that refers to `size` elements at `ptr`. Nothing is
+  // done if the same buffer is already set.
+  template <typename T, typename Buffer>
+  void set_buffer_arg(int idx, const Buffer& buf, const T* ptr, uint64_t size) {
+    if (this->args != nullptr) {
+      this->record(idx, buf, ptr, size,
+                   [](instance& instance, int idx, const arg_t& arg) {
+                     instance.set_buffer_arg(idx, load<Buffer>(arg),
+                                             static_cast<const T*>(arg.ptr),
+                                             arg.size);
+                   });
+      return;
+    }
+    const buffer_t buffer = {ptr, size * sizeof(T), &typeid(Buffer),
+                             buffer_direction<Buffer>::to_device,
+                             buffer_direction<Buffer>::from_device};
+    if (size_t(idx) >= this->buffers.size()) this->buffers.resize(idx + 1);
+    if (this->buffers[idx] == buffer) return;
+    this->buffers[idx] = buffer;
+    if (this->sim != nullptr) {
+      // The simulator has no host memory, so host buffers are copied both
+      // ways.
+      constexpr bool is_host = is_host_buffer<Buffer>::value;
+      this->sim->set_buffer_arg(idx, const_cast<T*>(ptr), buffer.bytes,
+                                buffer.to_device || is_host,
+                                buffer.from_device || is_host);
+      return;
+    }
+    if (buffer.to_device || buffer.from_device) {
+      log_if_copied(idx, ptr, buffer.bytes);
+    }
+    this->frt->SetArg(idx, get_frt_buffer(buf));
+  }
+
+  // Sets a stream argument, which is connected to `stream` while the kernel
+  // runs. Streams cannot be recorded because they are not copied.
+  template <typename Stream>
+  void set_stream_arg(int idx, Stream& stream) {
+    CHECK(this->args == nullptr)
+        << "argument #" << idx << " is a host stream, which cannot be passed "
+        << "to another process";
+    CHECK(this->sim == nullptr)
+        << "argument #" << idx << " is a host stream, which is not supported "
+        << "in RTL simulation";
+    if (size_t(idx) < this->buffers.size()) this->buffers[idx] = {};
+    this->frt->SetArg(idx, stream);
+  }
+
+  // Calls `f` with `sim` in RTL simulation, or `frt` otherwise, which have the
+  // same methods.
+  template <typename Func>
+  auto visit(Func&& f) const -> decltype(f(std::declval<fpga::Instance&>())) {
+    if (this->sim != nullptr) return f(*this->sim);
+    return f(*this->frt);
+  }
+
+  void write_to_device() {
+    this->visit([](auto& device) { device.WriteToDevice(); });
+  }
+  void exec() {
+    this->visit([](auto& device) { device.Exec(); });
+  }
+  void read_from_device() {
+    this->visit([](auto& device) { device.ReadFromDevice(); });
+  }
+  void finish() {
+    this->visit([](auto& device) { device.Finish(); });
+  }
+  int64_t load_time_ns() const {
+    return this->visit(
+        [](auto& device) -> int64_t { return device.LoadTimeNanoSeconds(); });
+  }
+  int64_t compute_time_ns() const {
+    return this->visit([](auto& device) -> int64_t {
+      return device.ComputeTimeNanoSeconds();
+    });
+  }
+  int64_t store_time_ns() const {
+    return this->visit(
+        [](auto& device) -> int64_t { return device.StoreTimeNanoSeconds(); });
+  }
+
+  // At most one of them is non-null, and neither if arguments are recorded.
+  std::unique_ptr<fpga::Instance> frt;
+  std::unique_ptr<rtl_sim> sim;
+
+  struct buffer_t {
+    const void* ptr = nullptr;
+    uint64_t bytes = 0;
+    const std::type_info* type = nullptr;  // Type of the FRT buffer.
+    bool to_device = false;                // Implied by `type`.
+    bool from_device = false;              // Implied by `type`.
+
+    bool operator==(const buffer_t& other) const {
+      return this->ptr == other.ptr && this->bytes == other.bytes &&
+             this->type != nullptr && other.type != nullptr &&
+             *this->type == *other.type;
+    }
+  };
+
+  // Buffer arguments last set, indexed by argument; others are null.
+  const std::vector<buffer_t>& get_buffers() const { return this->buffers; }
+
+ private:
+
+  template <typename T>
+  void record(int idx, const T& value, const void* ptr, uint64_t size,
+              void (*set)(instance& instance, int idx, const arg_t& arg)) {
+    CHECK_LE(sizeof(T), sizeof(arg_t::value))
+        << "argument #" << idx << " is too large to be recorded";
+    CHECK_LE(alignof(T), alignof(std::max_align_t));
+    if (size_t(idx) >= this->args->size()) this->args->resize(idx + 1);
+    auto& arg = (*this->args)[idx];
+    arg.set = set;
+    arg.ptr = ptr;
+    arg.size = size;
+    std::memcpy(arg.value, static_cast<const void*>(&value),
+                std::min(sizeof(T), sizeof(arg.value)));
+  }
+
+  template <typename T>
+  static const T& load(const arg_t& arg) {
+    return *reinterpret_cast<const T*>(arg.value);
+  }
+
+  std::vector<buffer_t> buffers;      // Indexed by argument.
+  std::vector<arg_t>* args = nullptr;  // Non-null if arguments are recorded.
+};
+
 #endif  // __SYNTHESIS__
 
+// An explicit burst request of an async_mmap carries its length minus 1 in the
+// top bits of the address, which are 0 for single-element requests;
+// `detect_burst.v` issues it as is instead of inferring a burst.
+constexpr int kBurstLenLsb = 56;
+constexpr uint64_t kMaxExplicitBurstLen = 256;
+
+inline int64_t encode_burst(int64_t addr, uint64_t len) {
+  return addr | int64_t(len - 1) << kBurstLenLsb;
+}
+
+inline int64_t decode_burst_addr(int64_t addr) {
+  return addr & ((int64_t(1) << kBurstLenLsb) - 1);
+}
+
+inline uint64_t decode_burst_len(int64_t addr) {
+  return (uint64_t(addr) >> kBurstLenLsb) + 1;
+}
+
+}  // namespace internal
+
+#ifndef __SYNTHESIS__
+
+/// Describes the timing of a memory port in software simulation.
+///
+/// Requests to a @c tapa::async_mmap with a memory model attached are still
+/// served immediately, but are also accounted for in a simulated cycle counter
+/// (see @c tapa::simulated_cycles). The model assumes that requests are issued
+/// as early as possible, so the counter estimates how many kernel cycles the
+/// memory system needs to serve them, i.e., a lower bound of the execution time
+/// of a memory-bound design. Reads and writes use independent channels, like
+/// AXI does. Synchronous @c tapa::mmap accesses are not accounted for.
+struct memory_model {
+  /// Cycles from issuing a burst until its first element is transferred.
+  uint64_t latency = 0;
+
+  /// Bytes transferred per cycle, or 0 for one element per cycle. At most one
+  /// element is transferred per cycle regardless.
+  uint64_t bytes_per_cycle = 0;
+
+  /// Maximum number of bursts in flight per channel, or 0 for unlimited. Set
+  /// it to `--async-mmap-max-outstanding` of tapac to model the read channel
+  /// of `async_mmap.v`. Read responses are returned in order, as the reorder
+  /// buffer of `async_mmap.v` does regardless of the AXI IDs used.
+  uint64_t max_outstanding = 0;
+
+  /// Maximum number of elements in a burst, i.e., `max_burst_len + 1` of
+  /// `async_mmap.v`, or 0 for bursts up to 4 KiB and 256 elements.
+  uint64_t max_burst_len = 0;
+
+  /// Models a DDR4 channel accessed at 300 MHz, roughly.
+  static memory_model ddr() {
+    return {/*latency=*/64, /*bytes_per_cycle=*/64, /*max_outstanding=*/32,
+            /*max_burst_len=*/0};
+  }
+
+  /// Models an HBM pseudo channel accessed at 300 MHz, roughly.
+  static memory_model hbm() {
+    return {/*latency=*/100, /*bytes_per_cycle=*/32, /*max_outstanding=*/32,
+            /*max_burst_len=*/0};
+  }
+};
+
+/// Returns the number of cycles that memory models estimate for the ongoing or
+/// last invocation of the top-level task, i.e., the latest completion of any
+/// modeled memory request.
+///
+/// If environment variable @c TAPA_CYCLE_SIM is set to 1, each task also
+/// carries a virtual clock and each stream token a timestamp, so this is the
+/// cycle of the latest channel operation instead. Each task is modeled as a
+/// pipeline with II=1 that accesses each channel at most once per cycle, and
+/// stream depths are enforced. Responses of memory models are delayed by the
+/// estimated latency. Synchronous @c tapa::mmap accesses and computation are
+/// free. @c [[tapa::pipeline(II)]] is not visible in software simulation, so
+/// loops with a larger II are estimated to be faster than they are.
+uint64_t simulated_cycles();
+
+/// Access pattern of a piece of mapped memory collected in software simulation
+/// if environment variable @c TAPA_MMAP_PROFILE is set to the path of a JSON
+/// report, which is written and logged when the top-level task finishes.
+///
+/// Requests of all @c tapa::async_mmap ports of the same host memory are
+/// accounted for, in the order each port issues them. Synchronous
+/// @c tapa::mmap accesses are not, since they are plain pointer accesses.
+/// Histograms are keyed by the lower bound of power-of-2 buckets, e.g., a run
+/// of 5 elements is counted in bucket 4, and a stride of -3 in bucket -2.
+struct mmap_access_stats {
+  /// Accesses in one direction.
+  struct direction {
+    uint64_t requests = 0;   ///< Number of requests, explicit bursts included.
+    uint64_t elements = 0;   ///< Number of elements accessed.
+    uint64_t footprint = 0;  ///< Number of distinct elements accessed.
+
+    /// Differences between the first addresses of consecutive requests of a
+    /// port, in elements.
+    std::map<int64_t, uint64_t> strides;
+
+    /// Lengths of runs of consecutive addresses, i.e., the bursts that
+    /// `detect_burst.v` coalesces before splitting them at the maximum burst
+    /// length of the port.
+    std::map<uint64_t, uint64_t> runs;
+  };
+
+  const void* ptr = nullptr;  ///< Start of the host memory.
+  uint64_t size = 0;          ///< Number of elements, or 0 if unknown.
+  uint64_t width = 0;         ///< Bytes of each element.
+  direction read;
+  direction write;
+
+  /// Number of elements accessed in between two accesses of the same element,
+  /// in either direction, i.e., how far apart reuse is.
+  std::map<uint64_t, uint64_t> reuse;
+
+  /// Returns the mean length of the runs in @c dir, in elements.
+  static double mean_run(const direction& dir);
+
+  /// Writes the stats as a JSON object.
+  void write_json(std::ostream& os) const;
+};
+
+/// Returns the access stats of each piece of memory accessed via
+/// @c tapa::async_mmap so far, sorted by address.
+///
+/// @return Stats of each memory, or nothing if the profile is disabled.
+std::vector<mmap_access_stats> access_stats();
+
+namespace internal {
+
+// Simulated state of a memory port with a model attached.
+//
+// All memory_timings created for the same memory_model at the same time share
+// the address and data channels, like the AXI interconnect that tapac inserts
+// when several tasks access one mmap does. Their requests are therefore served
+// one burst at a time, interleaved in the order they arrive.
+class memory_timing {
+ public:
+  // A cache of `cache_lines` elements in `cache_ways`-way sets is modeled if
+  // `cache_lines` is not 0. `max_burst_len` overrides that of `model` if it is
+  // not 0.
+  memory_timing(const memory_model& model, uint64_t width,
+                uint64_t cache_lines = 0, uint64_t cache_ways = 1,
+                uint64_t max_burst_len = 0);
+
+  // Accounts for `n` elements at consecutive addresses starting from `addr`,
+  // requested no earlier than `cycle`, and returns the cycle by which all of
+  // them are transferred. Reads that hit the cache are free; writes invalidate
+  // the cache sets.
+  uint64_t on_read(int64_t addr, uint64_t n, uint64_t cycle = 0);
+  uint64_t on_write(int64_t addr, uint64_t n, uint64_t cycle = 0);
+
+ private:
+  struct channel_t {
+    uint64_t issue_cycle = 0;  // When the next burst can be issued.
+    uint64_t data_cycle = 0;   // When the next element can be transferred.
+    int64_t next_addr = -1;    // Address that extends the open burst.
+    uint64_t burst_len = 0;    // Length of the open burst.
+    std::deque<uint64_t> outstanding;  // Completion of bursts in flight.
+  };
+
+  // Channels of a memory port, guarded by `mtx`.
+  struct port_t {
+    std::mutex mtx;
+    channel_t read;
+    channel_t write;
+  };
+
+  // Returns the port shared by the memory_timings of `model` that are alive.
+  static std::shared_ptr<port_t> acquire_port(const memory_model* model);
+
+  uint64_t access(channel_t port_t::*channel, int64_t addr, uint64_t n,
+                  uint64_t cycle);
+
+  // Looks up `addr` in the cache, filling it on a miss. Returns whether it hit.
+  bool lookup(int64_t addr);
+
+  const memory_model model;
+  const uint64_t width;
+  const uint64_t max_burst_len;
+  const uint64_t cache_sets;
+  const uint64_t cache_ways;
+  std::vector<int64_t> cache_tags;  // Address held by each line, or -1.
+  uint64_t cache_victim = 0;        // Way filled next, round-robin.
+  const std::shared_ptr<port_t> port;
+};
+
+// Returns whether accesses via async_mmaps are profiled in simulation, which is
+// enabled by setting environment variable `TAPA_MMAP_PROFILE` to the path of a
+// JSON report.
+bool is_mmap_profile_enabled();
+
+// Records the requests of an async_mmap port to the stats of its memory, which
+// all ports of the same memory share. Strides and runs are tracked per port so
+// that ports served at the same time do not break each other's runs.
+class mmap_profiler {
+ public:
+  mmap_profiler(const void* ptr, uint64_t size, uint64_t width);
+
+  // Records the `n` requests at `addrs`, in the encoding of the address
+  // channels of async_mmap.
+  void on_read(const int64_t* addrs, uint64_t n);
+  void on_write(const int64_t* addrs, uint64_t n);
+
+  struct memory_t;
+
+ private:
+  struct port_t {
+    int64_t last_addr = -1;  // First address of the last request.
+    int64_t next_addr = -1;  // Address that extends the open run.
+    uint64_t run_len = 0;    // Length of the open run.
+  };
+
+  void on_requests(bool is_write, const int64_t* addrs, uint64_t n);
+
+  const std::shared_ptr<memory_t> memory;
+  port_t read;
+  port_t write;
+};
+
 }  // namespace internal
 
+#endif  // __SYNTHESIS__
+
 #ifndef __SYNTHESIS__
 template <typename T>
 class async_mmap;
+
+/// Policies of @c tapa::mmap::vectorized for the elements after the last whole
+/// vector.
+enum class vector_tail {
+  /// The size of the mapped memory must be a multiple of the vector length.
+  exact,
+
+  /// The last vector is partial and the host memory is padded to hold it, so
+  /// the kernel may read and write it as a whole.
+  pad,
+
+  /// The last vector is partial and only its valid elements exist in host
+  /// memory. Reads via @c tapa::async_mmap see zeros past the valid elements,
+  /// and writes via @c tapa::async_mmap update the valid elements only.
+  /// Supported in software simulation only.
+  mask,
+
+  /// Only whole vectors are viewed. Use @c tapa::mmap::tail to view the
+  /// remaining elements.
+  split,
+};
 #endif  // __SYNTHESIS__
 
 /// Defines a view of a piece of consecutive memory with synchronous random
@@ -60,7 +590,9 @@ class mmap {
   ///
   /// @param container Container holding a @c tapa::mmap. Must implement
   ///                  @c data() and @c size().
-  template <typename Container>
+  template <typename Container,
+            typename = typename std::enable_if<
+                !std::is_base_of<mmap, Container>::value>::type>
   explicit mmap(Container& container)
       : ptr_{container.data()}, size_{container.size()} {}
 
@@ -109,19 +641,84 @@ class mmap {
   /// @return The size of the mapped memory (in unit of element count).
   uint64_t size() const { return size_; }
 
+  /// Attaches a timing model to the mapped memory.
+  ///
+  /// This should be used on the host only.
+  /// The model is effective only in software simulation, and only if the
+  /// mapped memory is accessed via @c tapa::async_mmap.
+  ///
+  /// @param model Timing model of the memory port.
+  /// @return This @c tapa::mmap.
+  mmap& set_memory_model(const memory_model& model) {
+    model_ = std::make_shared<const memory_model>(model);
+    return *this;
+  }
+
+  /// Retrieves the timing model attached to the mapped memory.
+  ///
+  /// This should be used on the host only.
+  ///
+  /// @return The attached timing model, or @c nullptr if there is none.
+  const memory_model* get_memory_model() const { return model_.get(); }
+
+  /// Creates a view of part of the mapped memory.
+  ///
+  /// This should be used on the host only.
+  /// When passed to a kernel, only the viewed elements are transferred to and
+  /// from the device, and the kernel sees them as the whole mapped memory.
+  ///
+  /// @param offset Index of the first viewed element.
+  /// @param length Number of viewed elements.
+  /// @return       @c tapa::mmap of the viewed elements.
+  mmap slice(uint64_t offset, uint64_t length) const {
+    if (size_ != 0) {
+      CHECK_LE(offset + length, size_) << "slice exceeds the mapped memory";
+    }
+    mmap result(ptr_ + offset, length);
+    result.model_ = model_;
+    if (offset + length == size_) result.tail_bytes_ = tail_bytes_;
+    return result;
+  }
+
   /// Reinterprets the element type of the mapped memory as
   /// <tt>tapa::vec_t<T, N></tt>.
   ///
   /// This should be used on the host only.
-  /// The size of mapped memory must be a multiple of @c N.
+  /// Unless @c tail says otherwise, the size of mapped memory must be a
+  /// multiple of @c N.
   ///
-  /// @tparam N  Vector length of the new element type.
+  /// @tparam N    Vector length of the new element type.
+  /// @param  tail How to handle the elements after the last whole vector.
   /// @return @c tapa::mmap of the same piece of memory but of type
   ///         <tt>tapa::vec_t<T, N></tt>.
   template <uint64_t N>
-  mmap<vec_t<T, N>> vectorized() const {
-    CHECK_EQ(size_ % N, 0) << "size must be a multiple of N";
-    return mmap<vec_t<T, N>>(reinterpret_cast<vec_t<T, N>*>(ptr_), size_ / N);
+  mmap<vec_t<T, N>> vectorized(vector_tail tail = vector_tail::exact) const {
+    CHECK_EQ(tail_bytes_, 0) << "cannot vectorize a partial element";
+    const uint64_t remainder = size_ % N;
+    if (tail == vector_tail::exact) {
+      CHECK_EQ(remainder, 0) << "size must be a multiple of N";
+    }
+    const bool has_tail = remainder != 0 && (tail == vector_tail::pad ||
+                                             tail == vector_tail::mask);
+    mmap<vec_t<T, N>> result(reinterpret_cast<vec_t<T, N>*>(ptr_),
+                             size_ / N + has_tail);
+    result.model_ = model_;
+    if (has_tail && tail == vector_tail::mask) {
+      result.tail_bytes_ = remainder * sizeof(T);
+    }
+    return result;
+  }
+
+  /// Creates a view of the elements after the last whole vector of length
+  /// @c N, i.e., those not viewed by <tt>vectorized<N>(vector_tail::split)</tt>.
+  ///
+  /// This should be used on the host only.
+  ///
+  /// @tparam N  Vector length.
+  /// @return    @c tapa::mmap of the remaining <tt>size() % N</tt> elements.
+  template <uint64_t N>
+  mmap tail() const {
+    return slice(size_ / N * N, size_ % N);
   }
 
   /// Reinterprets the element type of the mapped memory as @c U.
@@ -140,19 +737,365 @@ class mmap {
     static_assert(std::is_standard_layout<U>::value,
                   "U must have standard layout");
 
+    CHECK_EQ(tail_bytes_, 0) << "cannot reinterpret a partial element";
     if (sizeof(U) > sizeof(T)) {
       constexpr auto N = sizeof(U) / sizeof(T);
       CHECK_EQ(size() % N, 0) << "size must be a multiple of N = " << N;
     }
     CHECK_EQ(reinterpret_cast<size_t>(get()) % alignof(U), 0)
         << "pointer must be " << alignof(U) << "-byte aligned";
-    return mmap<U>(reinterpret_cast<U*>(get()), size() * sizeof(T) / sizeof(U));
+    mmap<U> result(reinterpret_cast<U*>(get()), size() * sizeof(T) / sizeof(U));
+    if (model_ != nullptr) result.set_memory_model(*model_);
+    return result;
   }
 
  protected:
+  template <typename U>
+  friend class mmap;
+
+  template <typename Param, typename Arg>
+  friend struct internal::accessor;
+
   T* ptr_;
   uint64_t size_;
+  std::shared_ptr<const memory_model> model_;
+
+  // Number of valid bytes in the last element if it is partial, or 0.
+  uint64_t tail_bytes_ = 0;
+};
+#endif  // __SYNTHESIS__
+
+#ifndef __SYNTHESIS__
+namespace internal {
+
+// Channels of an async_mmap. They are recycled for later async_mmaps of the
+// same type once no task accesses them, so that invoking a task repeatedly does
+// not allocate them over and over.
+template <typename T>
+struct async_mmap_channels {
+  using addr_t = int64_t;
+  using resp_t = uint8_t;
+
+  template <typename U>
+  class channel : public tapa::stream<U, 64> {
+   public:
+    template <size_t S>
+    explicit channel(const char (&name)[S])
+        : channel(make_queue<U>(64, name)) {}
+
+    // Tests whether the channel is empty without yielding.
+    bool is_empty() const { return this->ptr->empty(); }
+
+    // Wakes up tasks waiting for the channel.
+    void notify() {
+      this->ptr->consumers.notify();
+      this->ptr->producers.notify();
+    }
+
+   private:
+    channel(std::shared_ptr<queue<elem_t<U>>> owner)
+        : basic_stream<U>(owner.get()), tapa::stream<U, 64>(std::move(owner)) {}
+  };
+
+  channel<addr_t> read_addr{"read_addr"};
+  channel<T> read_data{"read_data"};
+  channel<addr_t> write_addr{"write_addr"};
+  channel<T> write_data{"write_data"};
+  channel<resp_t> write_resp{"write_resp"};
+
+  // Set once no `tapa::async_mmap` given to tasks refers to the channels.
+  std::atomic_bool is_unused{false};
+
+  bool is_empty() const {
+    return this->read_addr.is_empty() && this->read_data.is_empty() &&
+           this->write_addr.is_empty() && this->write_data.is_empty() &&
+           this->write_resp.is_empty();
+  }
+
+  // Marks the channels unused and wakes up the service task.
+  void release() {
+    this->is_unused = true;
+    this->read_addr.notify();
+    this->read_data.notify();
+    this->write_addr.notify();
+    this->write_data.notify();
+    this->write_resp.notify();
+  }
+
+  // Returns recycled channels if any, or new channels otherwise.
+  static std::shared_ptr<async_mmap_channels> acquire() {
+    auto& pool = get_pool();
+    async_mmap_channels* channels = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(pool.mtx);
+      if (!pool.channels.empty()) {
+        channels = pool.channels.back();
+        pool.channels.pop_back();
+      }
+    }
+    if (channels == nullptr) channels = new async_mmap_channels;
+    channels->is_unused = false;
+    return {channels, recycle};
+  }
+
+ private:
+  struct pool_t {
+    std::mutex mtx;
+    std::vector<async_mmap_channels*> channels;
+  };
+
+  // Never destructed, so that channels can be recycled at any time.
+  static pool_t& get_pool() {
+    static auto pool = new pool_t;
+    return *pool;
+  }
+
+  static void recycle(async_mmap_channels* channels) {
+    // Channels with leftovers are destructed, which warns about them.
+    if (!channels->is_empty()) {
+      delete channels;
+      return;
+    }
+    auto& pool = get_pool();
+    std::unique_lock<std::mutex> lock(pool.mtx);
+    pool.channels.push_back(channels);
+  }
+};
+
+// Task that serves the memory requests of an async_mmap. It finishes once no
+// task accesses the async_mmap, after finishing the writes requested.
+template <typename T>
+class async_mmap_service : public mmap<T> {
+ public:
+  using addr_t = int64_t;
+  using resp_t = uint8_t;
+  using update_t = void (*)(T* elems, const T* data, uint64_t n);
+
+  async_mmap_service(const mmap<T>& mem,
+                     std::shared_ptr<async_mmap_channels<T>> channels,
+                     uint64_t cache_lines, uint64_t cache_ways,
+                     uint64_t max_burst_len, update_t update)
+      : mmap<T>(mem),
+        channels(std::move(channels)),
+        cache_lines(cache_lines),
+        cache_ways(cache_ways),
+        max_burst_len(max_burst_len),
+        update(update) {}
+
+  void operator()() {
+    auto& read_addr_q = this->channels->read_addr;
+    auto& read_data_q = this->channels->read_data;
+    auto& write_addr_q = this->channels->write_addr;
+    auto& write_data_q = this->channels->write_data;
+    auto& write_resp_q = this->channels->write_resp;
+
+    // Addresses are drained in batches; each run of consecutive addresses is
+    // checked once and served by a single burst operation on the data channel.
+    constexpr uint64_t kBatchSize = 64;
+    addr_t read_addrs[kBatchSize];
+    uint64_t read_begin = 0;
+    uint64_t read_end = 0;
+    uint64_t read_offset = 0;  // Elements served of an explicit burst.
+    uint64_t read_timed = 0;  // Reads before it are accounted for by `timing`.
+    uint64_t read_done_cycle = 0;  // When the current burst is transferred.
+    addr_t write_addrs[kBatchSize];
+    uint64_t write_begin = 0;
+    uint64_t write_end = 0;
+    uint64_t write_offset = 0;  // Elements served of an explicit burst.
+    int16_t write_count = 0;
+    uint64_t write_done_cycle = 0;  // When the writes so far are transferred.
+    std::unique_ptr<memory_timing> timing;
+    if (this->model_ != nullptr) {
+      timing.reset(new memory_timing(*this->model_, sizeof(T),
+                                     this->cache_lines, this->cache_ways,
+                                     this->max_burst_len));
+    }
+    std::unique_ptr<mmap_profiler> profiler;
+    if (is_mmap_profile_enabled()) {
+      profiler.reset(new mmap_profiler(this->ptr_, this->size_, sizeof(T)));
+    }
+    for (;;) {
+      // Requests made before the channels are released are all visible.
+      const bool is_unused = this->channels->is_unused;
+
+      if (read_begin == read_end) {
+        read_begin = read_timed = 0;
+        read_end = read_addr_q.try_read_burst(read_addrs, kBatchSize);
+        if (read_end != 0) {
+          TAPA_PROBE(mmap_request, this->ptr_, 0,
+                     decode_burst_addr(read_addrs[0]), read_end);
+        }
+        if (profiler != nullptr) profiler->on_read(read_addrs, read_end);
+      }
+      if (read_begin != read_end) {
+        const uint64_t burst_len = get_explicit_length(read_addrs[read_begin]);
+        const addr_t addr =
+            decode_burst_addr(read_addrs[read_begin]) + read_offset;
+        const uint64_t length =
+            burst_len > 1 ? burst_len - read_offset
+                          : get_burst_length(read_addrs + read_begin,
+                                             read_end - read_begin);
+        check_burst(addr, length);
+        // A burst is accounted for once, before any of its data is returned,
+        // so that responses are delayed in cycle-approximate simulation.
+        if (timing != nullptr && read_begin == read_timed) {
+          read_done_cycle = timing->on_read(addr, length, get_cycle());
+          read_timed = read_begin + (burst_len > 1 ? 1 : length);
+        }
+        set_ready_cycle(read_done_cycle);
+        const bool is_partial = is_partial_burst(addr, length);
+        uint64_t count =
+            read_data_q.try_write_burst(this->ptr_ + addr, length - is_partial);
+        if (is_partial && count == length - 1 &&
+            read_data_q.try_write(load_tail())) {
+          ++count;
+        }
+        if (count > 0) TAPA_PROBE(mmap_response, this->ptr_, 0, addr, count);
+        if (burst_len == 1) {
+          read_begin += count;
+        } else if ((read_offset += count) == burst_len) {
+          ++read_begin;
+          read_offset = 0;
+        }
+      }
+
+      uint64_t written = 0;
+      if (write_count != 256) {
+        if (write_begin == write_end) {
+          write_begin = 0;
+          write_end = write_addr_q.try_read_burst(write_addrs, kBatchSize);
+          if (write_end != 0) {
+            TAPA_PROBE(mmap_request, this->ptr_, 1,
+                       decode_burst_addr(write_addrs[0]), write_end);
+          }
+          if (profiler != nullptr) profiler->on_write(write_addrs, write_end);
+        }
+        if (write_begin != write_end) {
+          const uint64_t burst_len =
+              get_explicit_length(write_addrs[write_begin]);
+          const addr_t addr =
+              decode_burst_addr(write_addrs[write_begin]) + write_offset;
+          const uint64_t length = std::min<uint64_t>(
+              burst_len > 1 ? burst_len - write_offset
+                            : get_burst_length(write_addrs + write_begin,
+                                               write_end - write_begin),
+              256 - write_count);
+          check_burst(addr, length);
+          const bool is_partial = is_partial_burst(addr, length);
+          written = this->update != nullptr
+                        ? try_update(addr, length)
+                        : write_data_q.try_read_burst(this->ptr_ + addr,
+                                                      length - is_partial);
+          T elem;
+          if (is_partial && written == length - 1 &&
+              write_data_q.try_read(elem)) {
+            std::memcpy(this->ptr_ + addr + written, &elem, this->tail_bytes_);
+            ++written;
+          }
+          if (written > 0) {
+            TAPA_PROBE(mmap_response, this->ptr_, 1, addr, written);
+          }
+          if (timing != nullptr && written > 0) {
+            // An update reads the elements before writing them back.
+            uint64_t cycle = get_cycle();
+            if (this->update != nullptr) {
+              cycle = timing->on_read(addr, written, cycle);
+            }
+            write_done_cycle = std::max(write_done_cycle,
+                                        timing->on_write(addr, written, cycle));
+          }
+          if (burst_len == 1) {
+            write_begin += written;
+          } else if ((write_offset += written) == burst_len) {
+            ++write_begin;
+            write_offset = 0;
+          }
+          write_count += written;
+        }
+      }
+      if (is_unused && written == 0 && write_count == 0) break;
+
+      // Responses are dropped if nobody is going to read them.
+      if (written == 0 && write_count > 0) set_ready_cycle(write_done_cycle);
+      if (written == 0 && write_count > 0 &&
+          (write_resp_q.try_write(resp_t(write_count - 1)) || is_unused)) {
+        CHECK_LE(write_count, 256);
+        write_count = 0;
+      }
+    }
+  }
+
+ private:
+  // Returns the length of the run of consecutive addresses at `addrs`, like
+  // `detect_burst.v` does in hardware.
+  static uint64_t get_burst_length(const addr_t* addrs, uint64_t n) {
+    uint64_t length = 1;
+    while (length < n && addrs[length] == addrs[length - 1] + 1) ++length;
+    return length;
+  }
+
+  // Returns the length of an explicit burst request, or 1 for a single-element
+  // request, whose consecutive requests are coalesced.
+  uint64_t get_explicit_length(addr_t addr) const {
+    const uint64_t length = decode_burst_len(addr);
+    if (internal::kCheckEachBurst && length > 1) {
+      CHECK_EQ(this->cache_lines, 0)
+          << "explicit bursts are not supported by cached_async_mmap";
+      CHECK(this->update == nullptr)
+          << "explicit bursts are not supported by atomic_async_mmap";
+    }
+    return length;
+  }
+
+  // Checks all `length` addresses starting from `addr` at once.
+  void check_burst(addr_t addr, uint64_t length) const {
+    if (!internal::kCheckEachBurst) return;
+    CHECK_GE(addr, 0);
+    const addr_t last = addr + addr_t(length) - 1;
+    if (last != 0) {
+      CHECK_LT(last, this->size_);
+    }
+  }
+
+  // Tests whether the burst ends with a partial last element, which is
+  // transferred on its own.
+  bool is_partial_burst(addr_t addr, uint64_t length) const {
+    return this->tail_bytes_ != 0 &&
+           addr + addr_t(length) == addr_t(this->size_);
+  }
+
+  // Applies up to `length` updates from the write data channel to the elements
+  // starting from `addr`, and returns the number of updates applied.
+  uint64_t try_update(addr_t addr, uint64_t length) {
+    T data[256];
+    const uint64_t n = this->channels->write_data.try_read_burst(
+        data, std::min<uint64_t>(length, 256));
+    this->update(this->ptr_ + addr, data, n);
+    return n;
+  }
+
+  // Loads the partial last element, with the bytes past the tail zeroed.
+  T load_tail() const {
+    T elem;
+    std::memset(&elem, 0, sizeof(elem));
+    std::memcpy(&elem, this->ptr_ + this->size_ - 1, this->tail_bytes_);
+    return elem;
+  }
+
+  std::shared_ptr<async_mmap_channels<T>> channels;
+
+  // Geometry of the cache of a cached_async_mmap, which only affects timing.
+  uint64_t cache_lines;
+  uint64_t cache_ways;
+
+  // Burst length of a burst_async_mmap, or 0 for that of the memory model.
+  uint64_t max_burst_len;
+
+  // Applies the updates of an atomic_async_mmap, or null for plain writes.
+  update_t update;
 };
+
+}  // namespace internal
 #endif  // __SYNTHESIS__
 
 /// Defines a view of a piece of consecutive memory with asynchronous random
@@ -168,6 +1111,16 @@ struct async_mmap {
   tapa::ostream<addr_t> write_addr;
   tapa::ostream<T> write_data;
   tapa::istream<resp_t> write_resp;
+
+  static addr_t burst_addr(addr_t addr, uint64_t len) {
+    return internal::encode_burst(addr, len);
+  }
+  void read_burst(addr_t addr, uint64_t len) {
+    read_addr.write(burst_addr(addr, len));
+  }
+  void write_burst(addr_t addr, uint64_t len) {
+    write_addr.write(burst_addr(addr, len));
+  }
 };
 #else   // __SYNTHESIS__
 class async_mmap : public mmap<T> {
@@ -181,20 +1134,17 @@ class async_mmap : public mmap<T> {
  private:
   using super = mmap<T>;
 
-  tapa::stream<addr_t, 64> read_addr_q_{"read_addr"};
-  tapa::stream<T, 64> read_data_q_{"read_data"};
-  tapa::stream<addr_t, 64> write_addr_q_{"write_addr"};
-  tapa::stream<T, 64> write_data_q_{"write_data"};
-  tapa::stream<resp_t, 64> write_resp_q_{"write_resp"};
+  using channels_t = internal::async_mmap_channels<T>;
 
   // Only convert when scheduled.
-  async_mmap(const super& mem)
+  async_mmap(const super& mem, const std::shared_ptr<channels_t>& channels)
       : super(mem),
-        read_addr(read_addr_q_),
-        read_data(read_data_q_),
-        write_addr(write_addr_q_),
-        write_data(write_data_q_),
-        write_resp(write_resp_q_) {}
+        user_(nullptr, [channels](void*) { channels->release(); }),
+        read_addr(channels->read_addr),
+        read_data(channels->read_data),
+        write_addr(channels->write_addr),
+        write_data(channels->write_data),
+        write_resp(channels->write_resp) {}
 
   // Must be operated via the read/write addr/data stream APIs.
   operator T*() { return super::ptr_; }
@@ -216,11 +1166,15 @@ class async_mmap : public mmap<T> {
   async_mmap<T> operator-(std::ptrdiff_t diff) { return super::ptr_ - diff; }
   std::ptrdiff_t operator-(async_mmap<T> ptr) { return super::ptr_ - ptr; }
 
+  // Releases the channels once all copies given to tasks are gone.
+  std::shared_ptr<void> user_;
+
  public:
   /// Provides access to the <i>read address</i> channel.
   ///
   /// Each value written to this channel triggers an asynchronous memory read
   /// request. Consecutive requests may be coalesced into a long burst request.
+  /// See @c burst_addr for explicit burst requests.
   tapa::ostream<addr_t> read_addr;
 
   /// Provides access to the read data channel.
@@ -233,6 +1187,7 @@ class async_mmap : public mmap<T> {
   ///
   /// Each value written to this channel triggers an asynchronous memory write
   /// request. Consecutive requests may be coalesced into a long burst request.
+  /// See @c burst_addr for explicit burst requests.
   tapa::ostream<addr_t> write_addr;
 
   /// Provides access to the write data channel.
@@ -247,39 +1202,210 @@ class async_mmap : public mmap<T> {
   /// by the underlying memory system.
   tapa::istream<resp_t> write_resp;
 
-  void operator()() {
-    int16_t write_count = 0;
-    for (;;) {
-      if (!read_addr_q_.empty() && !read_data_q_.full()) {
-        const auto addr = read_addr_q_.read();
-        CHECK_GE(addr, 0);
-        if (addr != 0) {
-          CHECK_LT(addr, this->size_);
-        }
-        read_data_q_.write(this->ptr_[addr]);
-      }
-      if (write_count != 256 && !write_addr_q_.empty() &&
-          !write_data_q_.empty()) {
-        const auto addr = write_addr_q_.read();
-        CHECK_GE(addr, 0);
-        if (addr != 0) {
-          CHECK_LT(addr, this->size_);
-        }
-        this->ptr_[addr] = write_data_q_.read();
-        ++write_count;
-      } else if (write_count > 0 &&
-                 this->write_resp_q_.try_write(resp_t(write_count - 1))) {
-        CHECK_LE(write_count, 256);
-        write_count = 0;
-      }
+  /// Returns the request of an explicit burst of @c len elements starting from
+  /// @c addr, to be written to the read or write address channel.
+  ///
+  /// An explicit burst is issued as is instead of being inferred from
+  /// consecutive requests, so that a single request transfers up to 256
+  /// elements; bursts longer than the burst length of the port are split in
+  /// hardware. Explicit bursts are not supported by @c tapa::cached_async_mmap,
+  /// by ports widened by <tt>--async-mmap-bus-width</tt>, or with
+  /// <tt>--async-mmap-write-combine-window</tt>.
+  ///
+  /// @param addr Address of the first element.
+  /// @param len  Number of elements; must be in [1, 256].
+  static addr_t burst_addr(addr_t addr, uint64_t len) {
+    if (internal::kCheckEachBurst) {
+      CHECK_GE(len, 1);
+      CHECK_LE(len, internal::kMaxExplicitBurstLen);
     }
+    return internal::encode_burst(addr, len);
+  }
+
+  /// Requests to read @c len elements starting from @c addr as an explicit
+  /// burst, whose data are returned on the read data channel.
+  void read_burst(addr_t addr, uint64_t len) {
+    read_addr.write(burst_addr(addr, len));
+  }
+
+  /// Requests to write @c len elements starting from @c addr as an explicit
+  /// burst, whose data are then written to the write data channel.
+  void write_burst(addr_t addr, uint64_t len) {
+    write_addr.write(burst_addr(addr, len));
+  }
+
+  static async_mmap schedule(super mem) { return schedule(mem, 0, 1); }
+
+ protected:
+  static async_mmap schedule(
+      super mem, uint64_t cache_lines, uint64_t cache_ways,
+      uint64_t max_burst_len = 0,
+      typename internal::async_mmap_service<T>::update_t update = nullptr) {
+    auto channels = channels_t::acquire();
+    internal::schedule_service(
+        internal::async_mmap_service<T>(mem, channels, cache_lines,
+                                        cache_ways, max_burst_len, update),
+        {channels->read_addr.get_channel(), channels->read_data.get_channel(),
+         channels->write_addr.get_channel(), channels->write_data.get_channel(),
+         channels->write_resp.get_channel()});
+    return async_mmap(mem, channels);
+  }
+};
+#endif  // __SYNTHESIS__
+
+/// Defines a @c tapa::async_mmap whose reads are served by an on-chip cache.
+///
+/// The cache holds @c Lines elements in @c Ways -way sets, using round-robin
+/// replacement, and is placed in front of the read channels of @c async_mmap.v
+/// in hardware, keeping the same channels. Each line holds one element, so
+/// vectorized element types make better use of the cache. The cache is
+/// invalidated when the parent task starts, and a write invalidates the set of
+/// its address; reads in flight when a write is issued may still fill the cache
+/// with the data before the write, so the cache is meant for data that is not
+/// written during the invocation. In software simulation, the cache only
+/// affects the timing estimated by a @c tapa::memory_model.
+///
+/// @tparam T     Type of each element.
+/// @tparam Lines Number of cached elements; must be a power of 2.
+/// @tparam Ways  Associativity; must be a power of 2 and at most Lines / 2.
+template <typename T, uint64_t Lines, uint64_t Ways = 1>
+#ifdef __SYNTHESIS__
+struct cached_async_mmap {
+  using addr_t = int64_t;
+  using resp_t = uint8_t;
+
+  tapa::ostream<addr_t> read_addr;
+  tapa::istream<T> read_data;
+  tapa::ostream<addr_t> write_addr;
+  tapa::ostream<T> write_data;
+  tapa::istream<resp_t> write_resp;
+};
+#else   // __SYNTHESIS__
+class cached_async_mmap : public async_mmap<T> {
+  static_assert(Lines != 0 && (Lines & (Lines - 1)) == 0,
+                "Lines must be a power of 2");
+  static_assert(Ways != 0 && (Ways & (Ways - 1)) == 0 && Ways * 2 <= Lines,
+                "Ways must be a power of 2 and at most Lines / 2");
+
+  explicit cached_async_mmap(const async_mmap<T>& base)
+      : async_mmap<T>(base) {}
+
+ public:
+  static cached_async_mmap schedule(mmap<T> mem) {
+    return cached_async_mmap(async_mmap<T>::schedule(mem, Lines, Ways));
+  }
+};
+#endif  // __SYNTHESIS__
+
+/// Defines a @c tapa::async_mmap with its own burst policy.
+///
+/// Consecutive requests of @c async_mmap.v are coalesced into bursts of at
+/// most @c BurstLen beats, and a burst is issued once no consecutive request
+/// arrives for @c WaitCycles cycles. Streaming scans benefit from long bursts,
+/// whereas latency-sensitive accesses, e.g., pointer chasing, are better
+/// served by single beats without waiting, i.e., <tt>BurstLen = 1</tt> and
+/// <tt>WaitCycles = 0</tt>. Each beat is an element unless the port is widened
+/// by <tt>--async-mmap-bus-width</tt> of tapac. A @c tapa::async_mmap uses up
+/// to 4 KiB of elements and 3 wait cycles. In software simulation, the burst
+/// length only affects the timing estimated by a @c tapa::memory_model.
+///
+/// @tparam T          Type of each element.
+/// @tparam BurstLen   Maximum number of beats in a burst; at most 256, and
+///                    bursts are at most 4 KiB.
+/// @tparam WaitCycles Cycles to wait for a consecutive request.
+template <typename T, uint64_t BurstLen, uint64_t WaitCycles = 0>
+#ifdef __SYNTHESIS__
+struct burst_async_mmap {
+  using addr_t = int64_t;
+  using resp_t = uint8_t;
+
+  tapa::ostream<addr_t> read_addr;
+  tapa::istream<T> read_data;
+  tapa::ostream<addr_t> write_addr;
+  tapa::ostream<T> write_data;
+  tapa::istream<resp_t> write_resp;
+
+  static addr_t burst_addr(addr_t addr, uint64_t len) {
+    return internal::encode_burst(addr, len);
+  }
+  void read_burst(addr_t addr, uint64_t len) {
+    read_addr.write(burst_addr(addr, len));
+  }
+  void write_burst(addr_t addr, uint64_t len) {
+    write_addr.write(burst_addr(addr, len));
+  }
+};
+#else   // __SYNTHESIS__
+class burst_async_mmap : public async_mmap<T> {
+  static_assert(BurstLen != 0 && BurstLen <= 256,
+                "BurstLen must be in [1, 256]");
+  static_assert(BurstLen * sizeof(T) <= 4096, "bursts must be at most 4 KiB");
+  static_assert(WaitCycles < 256, "WaitCycles must be less than 256");
+
+  explicit burst_async_mmap(const async_mmap<T>& base) : async_mmap<T>(base) {}
+
+ public:
+  static burst_async_mmap schedule(mmap<T> mem) {
+    return burst_async_mmap(
+        async_mmap<T>::schedule(mem, 0, 1, /*max_burst_len=*/BurstLen));
+  }
+};
+#endif  // __SYNTHESIS__
+
+/// Defines a @c tapa::async_mmap whose writes atomically add to memory.
+///
+/// Each request on the write channels is an update that adds its data to the
+/// element at its address, i.e., <tt>mem[addr] += data</tt>, and is
+/// acknowledged on the write response channel like a write; the responses must
+/// be read, or the updates in flight stall. In hardware, a read-modify-write
+/// unit in front of @c async_mmap.v keeps up to 16 updates in flight; an update
+/// to an address with an update in flight takes the result of the latter
+/// instead of reading memory, so that no update is lost. Updates are atomic
+/// among those of the same port only. Reads are served in order with the
+/// updates, but may not see the updates in flight.
+///
+/// @tparam T Type of each element; must be an integral type, which is added as
+///           an unsigned integer of the same width in hardware.
+template <typename T>
+#ifdef __SYNTHESIS__
+struct atomic_async_mmap {
+  using addr_t = int64_t;
+  using resp_t = uint8_t;
+
+  tapa::ostream<addr_t> read_addr;
+  tapa::istream<T> read_data;
+  tapa::ostream<addr_t> write_addr;
+  tapa::ostream<T> write_data;
+  tapa::istream<resp_t> write_resp;
+
+  void atomic_add(addr_t addr, const T& value) {
+    write_addr.write(addr);
+    write_data.write(value);
+  }
+};
+#else   // __SYNTHESIS__
+class atomic_async_mmap : public async_mmap<T> {
+  static_assert(std::is_integral<T>::value, "T must be an integral type");
+
+  using addr_t = typename async_mmap<T>::addr_t;
+
+  explicit atomic_async_mmap(const async_mmap<T>& base)
+      : async_mmap<T>(base) {}
+
+  static void add(T* elems, const T* data, uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) elems[i] += data[i];
+  }
+
+ public:
+  /// Requests to add @c value to the element at @c addr.
+  void atomic_add(addr_t addr, const T& value) {
+    this->write_addr.write(addr);
+    this->write_data.write(value);
   }
 
-  static async_mmap schedule(super mem) {
-    // a copy of async_mem is stored in std::function<void()>
-    async_mmap async_mem(mem);
-    internal::schedule(/*detach=*/true, async_mem);
-    return async_mem;
+  static atomic_async_mmap schedule(mmap<T> mem) {
+    return atomic_async_mmap(
+        async_mmap<T>::schedule(mem, 0, 1, /*max_burst_len=*/0, add));
   }
 };
 #endif  // __SYNTHESIS__
@@ -343,22 +1469,31 @@ class mmaps {
   /// <tt>tapa::vec_t<T, N></tt>.
   ///
   /// This should be used on the host only.
-  /// The size of each mapped memory must be a multiple of @c N.
+  /// Unless @c tail says otherwise, the size of each mapped memory must be a
+  /// multiple of @c N.
   ///
-  /// @tparam N  Vector length of the new element type.
+  /// @tparam N    Vector length of the new element type.
+  /// @param  tail How to handle the elements after the last whole vector.
   /// @return @c tapa::mmap of the same pieces of memory but of type
   ///         <tt>tapa::vec_t<T, N></tt>.
   template <uint64_t N>
-  mmaps<vec_t<T, N>, S> vectorized() const {
+  mmaps<vec_t<T, N>, S> vectorized(
+      vector_tail tail = vector_tail::exact) const {
     std::array<vec_t<T, N>*, S> ptrs;
     std::array<uint64_t, S> sizes;
     for (uint64_t i = 0; i < S; ++i) {
-      CHECK_EQ(mmaps_[i].size() % N, 0)
-          << "size[" << i << "] must be a multiple of N";
+      if (tail == vector_tail::exact) {
+        CHECK_EQ(mmaps_[i].size() % N, 0)
+            << "size[" << i << "] must be a multiple of N";
+      }
       ptrs[i] = reinterpret_cast<vec_t<T, N>*>(mmaps_[i].get());
-      sizes[i] = mmaps_[i].size() / N;
+      sizes[i] = 0;
     }
-    return mmaps<vec_t<T, N>, S>(ptrs, sizes);
+    mmaps<vec_t<T, N>, S> result(ptrs, sizes);
+    for (uint64_t i = 0; i < S; ++i) {
+      result[i] = mmaps_[i].template vectorized<N>(tail);
+    }
+    return result;
   }
 
   /// Reinterprets the element type of each mapped memory as @c U.
@@ -418,9 +1553,23 @@ class mmaps {
     using mmap<T>::mmap;                               \
     tag##_mmap(const mmap<T>& base) : mmap<T>(base) {} \
                                                        \
+    tag##_mmap& set_memory_model(                      \
+        const memory_model& model) {                   \
+      mmap<T>::set_memory_model(model);                \
+      return *this;                                    \
+    }                                                  \
+    tag##_mmap slice(uint64_t offset,                  \
+                     uint64_t length) const {          \
+      return mmap<T>::slice(offset, length);           \
+    }                                                  \
     template <uint64_t N>                              \
-    tag##_mmap<vec_t<T, N>> vectorized() const {       \
-      return mmap<T>::template vectorized<N>();        \
+    tag##_mmap<vec_t<T, N>> vectorized(                \
+        vector_tail tail = vector_tail::exact) const { \
+      return mmap<T>::template vectorized<N>(tail);    \
+    }                                                  \
+    template <uint64_t N>                              \
+    tag##_mmap tail() const {                          \
+      return mmap<T>::template tail<N>();              \
     }                                                  \
     template <typename U>                              \
     tag##_mmap<U> reinterpret() const {                \
@@ -431,6 +1580,12 @@ TAPA_DEFINE_MMAP(placeholder);
 TAPA_DEFINE_MMAP(read_only);
 TAPA_DEFINE_MMAP(write_only);
 TAPA_DEFINE_MMAP(read_write);
+// Accessed by the kernel in host memory without being copied, e.g., for data
+// scanned once or passed from a kernel on another card, which FRT cannot
+// access directly; the argument must be bound to `HOST[0]`, e.g., via
+// `tapac --host-mmap`, on a platform with a slave bridge. Allocate it via
+// `tapa::aligned_allocator` so that it is used in place.
+TAPA_DEFINE_MMAP(host);
 #undef TAPA_DEFINE_MMAP
 #define TAPA_DEFINE_MMAPS(tag)                                        \
   template <typename T, uint64_t S>                                   \
@@ -442,8 +1597,9 @@ TAPA_DEFINE_MMAP(read_write);
     tag##_mmaps(const mmaps<T, S>& base) : mmaps<T, S>(base) {}       \
                                                                       \
     template <uint64_t N>                                             \
-    tag##_mmaps<vec_t<T, N>, S> vectorized() const {                  \
-      return mmaps<T, S>::template vectorized<N>();                   \
+    tag##_mmaps<vec_t<T, N>, S> vectorized(                           \
+        vector_tail tail = vector_tail::exact) const {                \
+      return mmaps<T, S>::template vectorized<N>(tail);               \
     }                                                                 \
     template <typename U>                                             \
     tag##_mmaps<U, S> reinterpret() const {                           \
@@ -454,6 +1610,7 @@ TAPA_DEFINE_MMAPS(placeholder);
 TAPA_DEFINE_MMAPS(read_only);
 TAPA_DEFINE_MMAPS(write_only);
 TAPA_DEFINE_MMAPS(read_write);
+TAPA_DEFINE_MMAPS(host);
 #undef TAPA_DEFINE_MMAPS
 
 namespace internal {
@@ -497,45 +1654,128 @@ struct accessor<async_mmap<T>&, mmaps<T, S>&> {
   }
 };
 
-#define TAPA_DEFINE_ACCESSER(tag, frt_tag)                     \
-  template <typename T>                                        \
-  struct accessor<mmap<T>, tag##_mmap<T>> {                    \
-    static mmap<T> access(tag##_mmap<T> arg) { return arg; }   \
-    static void access(fpga::Instance& instance, int& idx,     \
-                       tag##_mmap<T> arg) {                    \
-      auto buf = fpga::frt_tag(arg.get(), arg.size());         \
-      instance.SetArg(idx++, buf);                             \
-    }                                                          \
-  };                                                           \
-  template <typename T, uint64_t S>                            \
-  struct accessor<mmaps<T, S>, tag##_mmaps<T, S>> {            \
-    static void access(fpga::Instance& instance, int& idx,     \
-                       tag##_mmaps<T, S> arg) {                \
-      for (uint64_t i = 0; i < S; ++i) {                       \
-        auto buf = fpga::frt_tag(arg[i].get(), arg[i].size()); \
-        instance.SetArg(idx++, buf);                           \
-      }                                                        \
-    }                                                          \
-  }
-TAPA_DEFINE_ACCESSER(placeholder, Placeholder);
+template <typename T, uint64_t Lines, uint64_t Ways>
+struct accessor<cached_async_mmap<T, Lines, Ways>&, mmap<T>&> {
+  static cached_async_mmap<T, Lines, Ways> access(mmap<T>& arg) {
+    return cached_async_mmap<T, Lines, Ways>::schedule(arg);
+  }
+};
+
+template <typename T, uint64_t S, uint64_t Lines, uint64_t Ways>
+struct accessor<cached_async_mmap<T, Lines, Ways>&, mmaps<T, S>&> {
+  static cached_async_mmap<T, Lines, Ways> access(mmaps<T, S>& arg) {
+    return cached_async_mmap<T, Lines, Ways>::schedule(arg.access());
+  }
+};
+
+template <typename T, uint64_t BurstLen, uint64_t WaitCycles>
+struct accessor<burst_async_mmap<T, BurstLen, WaitCycles>&, mmap<T>&> {
+  static burst_async_mmap<T, BurstLen, WaitCycles> access(mmap<T>& arg) {
+    return burst_async_mmap<T, BurstLen, WaitCycles>::schedule(arg);
+  }
+};
+
+template <typename T, uint64_t S, uint64_t BurstLen, uint64_t WaitCycles>
+struct accessor<burst_async_mmap<T, BurstLen, WaitCycles>&, mmaps<T, S>&> {
+  static burst_async_mmap<T, BurstLen, WaitCycles> access(mmaps<T, S>& arg) {
+    return burst_async_mmap<T, BurstLen, WaitCycles>::schedule(arg.access());
+  }
+};
+
+template <typename T>
+struct accessor<atomic_async_mmap<T>&, mmap<T>&> {
+  static atomic_async_mmap<T> access(mmap<T>& arg) {
+    return atomic_async_mmap<T>::schedule(arg);
+  }
+};
+
+template <typename T, uint64_t S>
+struct accessor<atomic_async_mmap<T>&, mmaps<T, S>&> {
+  static atomic_async_mmap<T> access(mmaps<T, S>& arg) {
+    return atomic_async_mmap<T>::schedule(arg.access());
+  }
+};
+
+template <typename T>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const async_mmap<T>& arg) {
+  channels.insert(channels.end(),
+                  {arg.read_addr.get_channel(), arg.read_data.get_channel(),
+                   arg.write_addr.get_channel(), arg.write_data.get_channel(),
+                   arg.write_resp.get_channel()});
+}
+
+template <typename T, uint64_t Lines, uint64_t Ways>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const cached_async_mmap<T, Lines, Ways>& arg) {
+  add_channels(channels, static_cast<const async_mmap<T>&>(arg));
+}
+
+template <typename T, uint64_t BurstLen, uint64_t WaitCycles>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const burst_async_mmap<T, BurstLen, WaitCycles>& arg) {
+  add_channels(channels, static_cast<const async_mmap<T>&>(arg));
+}
+
+template <typename T>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const atomic_async_mmap<T>& arg) {
+  add_channels(channels, static_cast<const async_mmap<T>&>(arg));
+}
+
+// Devices transfer whole elements, which a masked partial element lacks.
+template <typename T>
+struct accessor<void, mmap<T>> {
+  static void check_whole(const mmap<T>& arg) {
+    CHECK_EQ(arg.tail_bytes_, 0)
+        << "vector_tail::mask is supported in software simulation only";
+  }
+};
+
+#define TAPA_DEFINE_ACCESSER(tag, make_buffer)                     \
+  template <typename T>                                            \
+  struct accessor<mmap<T>, tag##_mmap<T>> {                        \
+    static mmap<T> access(tag##_mmap<T> arg) { return arg; }       \
+    static void access(instance& instance, int& idx,               \
+                       tag##_mmap<T> arg) {                        \
+      accessor<void, mmap<T>>::check_whole(arg);                   \
+      auto buf = make_buffer(arg.get(), arg.size());               \
+      instance.set_buffer_arg(idx++, buf, arg.get(),               \
+                              arg.size());                         \
+    }                                                              \
+  };                                                               \
+  template <typename T, uint64_t S>                                \
+  struct accessor<mmaps<T, S>, tag##_mmaps<T, S>> {                \
+    static void access(instance& instance, int& idx,               \
+                       tag##_mmaps<T, S> arg) {                    \
+      for (uint64_t i = 0; i < S; ++i) {                           \
+        accessor<void, mmap<T>>::check_whole(arg[i]);              \
+        auto buf = make_buffer(arg[i].get(), arg[i].size());       \
+        instance.set_buffer_arg(idx++, buf, arg[i].get(),          \
+                                arg[i].size());                    \
+      }                                                            \
+    }                                                              \
+  }
+TAPA_DEFINE_ACCESSER(placeholder, fpga::Placeholder);
 // read/write are with respect to the kernel in tapa but host in frt
-TAPA_DEFINE_ACCESSER(read_only, WriteOnly);
-TAPA_DEFINE_ACCESSER(write_only, ReadOnly);
-TAPA_DEFINE_ACCESSER(read_write, ReadWrite);
+TAPA_DEFINE_ACCESSER(read_only, fpga::WriteOnly);
+TAPA_DEFINE_ACCESSER(write_only, fpga::ReadOnly);
+TAPA_DEFINE_ACCESSER(read_write, fpga::ReadWrite);
+TAPA_DEFINE_ACCESSER(host, make_host_buffer);
 #undef TAPA_DEFINE_ACCESSER
 template <typename T>
 struct accessor<mmap<T>, mmap<T>> {
   static_assert(!std::is_same<T, T>::value,
                 "must use one of "
                 "placeholder_mmap/read_only_mmap/write_only_mmap/"
-                "read_write_mmap in tapa::invoke");
+                "read_write_mmap/host_mmap in tapa::invoke");
 };
 template <typename T, int64_t S>
 struct accessor<mmaps<T, S>, mmaps<T, S>> {
   static_assert(!std::is_same<T, T>::value,
                 "must use one of "
                 "placeholder_mmaps/read_only_mmaps/write_only_mmaps/"
-                "read_write_mmaps in tapa::invoke");
+                "read_write_mmaps/host_mmaps in tapa::invoke");
 };
 
 }  // namespace internal
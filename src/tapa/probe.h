@@ -0,0 +1,39 @@
+#ifndef TAPA_PROBE_H_
+#define TAPA_PROBE_H_
+
+// Static tracepoints (USDT) of software simulation, compiled in if
+// `<sys/sdt.h>` of SystemTap is available and `TAPA_DISABLE_PROBES` is not
+// defined. A probe is a single `nop` unless a tracer such as `perf` or
+// `bpftrace` attaches to it. All probes belong to provider `tapa`:
+//
+//   task_spawn(id, name, detach)    a task is scheduled
+//   task_finish(id, name)           a task returns
+//   coroutine_resume(id, name)      a worker resumes the coroutine of a task
+//   coroutine_suspend(id, channel)  the coroutine yields, on a channel if any
+//   stream_push(name, n)            `n` tokens are written to a stream
+//   stream_pop(name, n)             `n` tokens are read from a stream
+//   stream_block(name, is_full)     a stream is accessed when empty or full
+//   mmap_request(base, is_write, addr, n)   `n` addresses are received
+//   mmap_response(base, is_write, addr, n)  `n` elements are transferred
+//
+// Task ids number the coroutines of a process from 1, and are 0 for tasks on
+// dedicated threads. Names are C strings that live as long as the probe fires.
+// For example, the following counts the tokens pushed to each stream:
+//
+//   bpftrace -e 'usdt:./a.out:tapa:stream_push { @[str(arg0)] = sum(arg1); }'
+
+#if !defined(__SYNTHESIS__) && !defined(TAPA_DISABLE_PROBES) && \
+    defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TAPA_PROBE(...) STAP_PROBEV(tapa, __VA_ARGS__)
+#endif  // __has_include(<sys/sdt.h>)
+#endif
+
+#ifndef TAPA_PROBE
+#define TAPA_PROBE(...) \
+  do {                  \
+  } while (0)
+#endif  // TAPA_PROBE
+
+#endif  // TAPA_PROBE_H_
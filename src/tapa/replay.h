@@ -0,0 +1,276 @@
+#ifndef TAPA_REPLAY_H_
+#define TAPA_REPLAY_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "tapa.h"
+
+namespace tapa {
+
+namespace internal {
+
+// Number of mismatches logged per argument.
+constexpr uint64_t kMaxLoggedMismatches = 10;
+
+// Files of an argument captured into `dir`; see `capture`.
+struct replay_source {
+  std::string dir;
+  int index;
+
+  std::string get_path(const char* suffix) const {
+    return dir + "/arg" + std::to_string(index) + suffix;
+  }
+};
+
+// Writes `n` captured tokens to `out`.
+template <typename T>
+void replay_tokens(ostream<T>& out, const T* data, const uint8_t* eot,
+                   uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+    if (eot[i]) {
+      out.close();
+    } else {
+      out.write(data[i]);
+    }
+  }
+}
+
+// Reads `n` tokens from `in` and counts those that differ from the captured
+// tokens in `mismatches`.
+template <typename T>
+void verify_tokens(istream<T>& in, const T* data, const uint8_t* eot,
+                   uint64_t n, int index, uint64_t* mismatches) {
+  for (uint64_t i = 0; i < n; ++i) {
+    bool is_eot;
+    while (!in.try_eot(is_eot)) {
+    }
+    bool is_match = is_eot == static_cast<bool>(eot[i]);
+    if (is_eot) {
+      in.open();
+    } else {
+      const T token = in.read();
+      is_match = is_match && memcmp(&token, &data[i], sizeof(T)) == 0;
+    }
+    if (!is_match && ++*mismatches <= kMaxLoggedMismatches) {
+      LOG(ERROR) << "argument #" << index << ": token #" << i
+                 << " differs from the captured one";
+    }
+  }
+}
+
+// An argument of a replayed task, which is a trivially copyable value unless
+// specialized.
+template <typename Param>
+class replay_arg {
+  static_assert(std::is_trivially_copyable<Param>::value,
+                "argument cannot be replayed");
+
+ public:
+  explicit replay_arg(const replay_source& source) : value(load(source)) {}
+
+  Param& get() { return value; }
+  void start(task& task) {}
+  uint64_t finish() const { return 0; }
+
+ private:
+  static Param load(const replay_source& source) {
+    mapped_file<const Param> file(source.get_path(".value"));
+    CHECK_EQ(file.size(), 1) << source.get_path(".value");
+    return *file.data();
+  }
+
+  Param value;
+};
+
+template <typename T>
+class replay_arg<istream<T>> {
+ public:
+  explicit replay_arg(const replay_source& source)
+      : data(source.get_path(".data")), eot(source.get_path(".eot")) {
+    CHECK_EQ(data.size(), eot.size()) << source.get_path(".data");
+  }
+
+  stream<T>& get() { return channel; }
+  void start(task& task) {
+    task.invoke<detach>(replay_tokens<T>, channel, data.data(), eot.data(),
+                        eot.size());
+  }
+  uint64_t finish() const { return 0; }
+
+ private:
+  mapped_file<const T> data;
+  mapped_file<const uint8_t> eot;
+  stream<T> channel;
+};
+
+template <typename T>
+class replay_arg<ostream<T>> {
+ public:
+  explicit replay_arg(const replay_source& source)
+      : index(source.index),
+        data(source.get_path(".data")),
+        eot(source.get_path(".eot")) {
+    CHECK_EQ(data.size(), eot.size()) << source.get_path(".data");
+  }
+
+  stream<T>& get() { return channel; }
+  void start(task& task) {
+    task.invoke(verify_tokens<T>, channel, data.data(), eot.data(), eot.size(),
+                index, &mismatches);
+  }
+  uint64_t finish() const { return mismatches; }
+
+ private:
+  const int index;
+  mapped_file<const T> data;
+  mapped_file<const uint8_t> eot;
+  stream<T> channel;
+  uint64_t mismatches = 0;
+};
+
+// An mmap argument, which is loaded with its content when the task started and
+// compared with that when the task finished.
+template <typename T>
+class replay_mmap {
+  using elem_t = typename std::remove_const<T>::type;
+
+ public:
+  explicit replay_mmap(const replay_source& source)
+      : source(source),
+        buffer(load(source)),
+        view(buffer.data(), buffer.size()) {}
+
+  mmap<T>& get() { return view; }
+  void start(task& task) {}
+  uint64_t finish() const {
+    if (std::is_const<T>::value) return 0;
+    mapped_file<const elem_t> file(source.get_path(".out"));
+    CHECK_EQ(file.size(), buffer.size()) << source.get_path(".out");
+    uint64_t mismatches = 0;
+    for (uint64_t i = 0; i < buffer.size(); ++i) {
+      if (memcmp(&buffer[i], &file.data()[i], sizeof(elem_t)) != 0 &&
+          ++mismatches <= kMaxLoggedMismatches) {
+        LOG(ERROR) << "argument #" << source.index << ": element #" << i
+                   << " differs from the captured one";
+      }
+    }
+    return mismatches;
+  }
+
+ private:
+  static std::vector<elem_t> load(const replay_source& source) {
+    mapped_file<const elem_t> file(source.get_path(".in"));
+    return {file.data(), file.data() + file.size()};
+  }
+
+  const replay_source source;
+  std::vector<elem_t> buffer;
+  mmap<T> view;
+};
+
+template <typename T>
+class replay_arg<mmap<T>> : public replay_mmap<T> {
+  using replay_mmap<T>::replay_mmap;
+};
+
+template <typename T>
+class replay_arg<async_mmap<T>> : public replay_mmap<T> {
+  using replay_mmap<T>::replay_mmap;
+};
+
+template <typename T, uint64_t Lines, uint64_t Ways>
+class replay_arg<cached_async_mmap<T, Lines, Ways>> : public replay_mmap<T> {
+  using replay_mmap<T>::replay_mmap;
+};
+
+template <typename T, uint64_t BurstLen, uint64_t WaitCycles>
+class replay_arg<burst_async_mmap<T, BurstLen, WaitCycles>>
+    : public replay_mmap<T> {
+  using replay_mmap<T>::replay_mmap;
+};
+
+template <typename T>
+class replay_arg<atomic_async_mmap<T>> : public replay_mmap<T> {
+  using replay_mmap<T>::replay_mmap;
+};
+
+template <typename T>
+struct replayer;
+
+template <typename... Params>
+struct replayer<void (&)(Params...)> {
+  static uint64_t replay(void (&f)(Params...), const std::string& dir) {
+    return replay(f, dir, std::index_sequence_for<Params...>());
+  }
+
+  template <size_t... Is>
+  static uint64_t replay(void (&f)(Params...), const std::string& dir,
+                         std::index_sequence<Is...>) {
+    std::tuple<replay_arg<typename std::decay<Params>::type>...> args(
+        replay_source{dir, Is}...);
+    std::apply(
+        [&f](auto&... args) {
+          task task;
+          (args.start(task), ...);
+          task.invoke(f, args.get()...);
+        },
+        args);
+    uint64_t mismatches = 0;
+    std::apply(
+        [&mismatches](const auto&... args) {
+          ((mismatches += args.finish()), ...);
+        },
+        args);
+    LOG(INFO) << "replayed " << dir << " with " << mismatches
+              << " mismatch(es)";
+    return mismatches;
+  }
+};
+
+}  // namespace internal
+
+/// Replays the traffic of a task instance captured by software simulation into
+/// the task alone, so that it can be debugged and optimized without running
+/// the rest of the design.
+///
+/// Setting environment variable @c TAPA_CAPTURE to the instance name of a task,
+/// or the name of its function if it is not named (which requires
+/// @c TAPA_ENABLE_STACKTRACE), captures each instance of the task into a new
+/// directory under @c TAPA_CAPTURE_DIR (default: @c tapa-capture), e.g.,
+/// @c tapa-capture/Conv.0 for the first instance of @c Conv. Its tokens are
+/// stored as flat arrays, which are mapped into memory when replayed.
+///
+/// Tokens of @c tapa::istream are replayed to the task, and those that it
+/// writes to @c tapa::ostream and the content of writable mmaps are compared
+/// with the captured ones. Other arguments must be trivially copyable, and
+/// tokens and mmap elements are compared bytewise.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  // run the design with TAPA_CAPTURE=Conv first
+///  #include <tapa/replay.h>
+///  void Conv(tapa::istream<float>& in, tapa::ostream<float>& out, int n);
+///  int main() { return tapa::replay(Conv, "tapa-capture/Conv.0") != 0; }
+/// @endcode
+///
+/// @param f   Task function, which must be the captured one.
+/// @param dir Directory of the captured instance.
+/// @return    Number of tokens and mmap elements that differ from the captured
+///            ones.
+template <typename Func>
+inline uint64_t replay(Func&& f, const std::string& dir) {
+  return internal::replayer<Func>::replay(f, dir);
+}
+
+}  // namespace tapa
+
+#endif  // TAPA_REPLAY_H_
@@ -5,29 +5,59 @@
 #include <cstdint>
 #include <cstring>
 
+#include <functional>
+
 #ifdef __SYNTHESIS__
 
 #include <hls_stream.h>
 
 #else  // __SYNTHESIS__
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <deque>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <glog/logging.h>
 
 #include "tapa/coroutine.h"
+#include "tapa/probe.h"
+
+// How thoroughly software simulation checks channel and memory accesses, set
+// by defining `TAPA_SIM_CHECK_LEVEL` to one of the following before including
+// `tapa.h`. Checks made once per binding, e.g., when a slice of channels is
+// passed to a task, are always on.
+//
+// Full: every token and element accessed is checked, e.g., that no token
+// read is EoT and that each channel in an array exists. This is the default.
+#define TAPA_SIM_CHECK_FULL 2
+// Boundary: only each burst of tokens or addresses is checked, e.g., that an
+// `async_mmap` burst is in range.
+#define TAPA_SIM_CHECK_BOUNDARY 1
+// None: accesses are not checked, for long runs of designs known to be
+// correct.
+#define TAPA_SIM_CHECK_NONE 0
+
+#ifndef TAPA_SIM_CHECK_LEVEL
+#define TAPA_SIM_CHECK_LEVEL TAPA_SIM_CHECK_FULL
+#endif  // TAPA_SIM_CHECK_LEVEL
 
 #endif  // __SYNTHESIS__
 
 namespace tapa {
 
+template <typename T, int N>
+struct vec_t;
+
 #ifndef __SYNTHESIS__
 
 template <typename T>
@@ -42,6 +72,26 @@ class istreams;
 template <typename T, uint64_t S>
 class ostreams;
 
+/// Counters of a stream collected in software simulation if environment
+/// variable @c TAPA_STREAM_STATS is set to 1.
+struct stream_stats {
+  std::string name;
+  uint64_t depth = 0;
+  uint64_t pushes = 0;        ///< Number of tokens written.
+  uint64_t pops = 0;          ///< Number of tokens read.
+  uint64_t full_stalls = 0;   ///< Number of writes attempted when full.
+  uint64_t empty_stalls = 0;  ///< Number of reads attempted when empty.
+  double occupancy = 0.;      ///< Time-weighted average number of tokens.
+  double seconds = 0.;        ///< Lifetime of the stream.
+};
+
+/// Returns stats of all streams destructed so far, sorted by name. Stats of
+/// streams with the same name are accumulated. If stream stats are enabled,
+/// this is also logged when the top-level task finishes.
+///
+/// @return Stats of each stream, or nothing if stream stats are disabled.
+std::vector<stream_stats> stats();
+
 #endif  // __SYNTHESIS__
 
 namespace internal {
@@ -54,23 +104,299 @@ struct elem_t {
 
 #ifndef __SYNTHESIS__
 
+// Whether each token or element accessed is checked in simulation.
+constexpr bool kCheckEachAccess = TAPA_SIM_CHECK_LEVEL >= TAPA_SIM_CHECK_FULL;
+// Whether each burst of tokens or addresses is checked in simulation.
+constexpr bool kCheckEachBurst =
+    TAPA_SIM_CHECK_LEVEL >= TAPA_SIM_CHECK_BOUNDARY;
+
+// Token in a queue that stores the value and the EoT flag apart.
+template <typename T>
+struct elem_ref_t {
+  T& val;
+  bool eot;
+};
+
+// Returns whether a token of a queue is EoT, which a distributing queue sends
+// to all of its peers; tokens other than elem_t never are.
+template <typename T>
+bool is_eot(const T&) {
+  return false;
+}
+template <typename T>
+bool is_eot(const elem_t<T>& elem) {
+  return elem.eot;
+}
+
+// Returns a copy of a token referenced in a queue.
+template <typename T>
+const T& get_token(const T& token) {
+  return token;
+}
+template <typename T>
+elem_t<T> get_token(const elem_ref_t<T>& ref) {
+  return {ref.val, ref.eot};
+}
+
+// Copies up to `n` tokens of type `T` from `queue` to `dst` and pops them.
+// Returns the number of tokens popped.
+template <typename T, typename Queue>
+uint64_t pop_bytes(Queue& queue, void* dst, uint64_t n) {
+  n = std::min(n, queue.readable());
+  for (uint64_t i = 0; i < n; ++i) {
+    const T token = get_token(queue.at(i));
+    std::memcpy(static_cast<char*>(dst) + i * sizeof(T), &token, sizeof(T));
+  }
+  if (n != 0) queue.pop(n);
+  return n;
+}
+
+// Pushes up to `n` tokens of type `T` copied from `src` into `queue`. Returns
+// the number of tokens pushed.
+template <typename T, typename Queue>
+uint64_t push_bytes(Queue& queue, const void* src, uint64_t n) {
+  n = std::min(n, queue.writable());
+  if (n == 0) return 0;
+  return queue.push(n, [src](uint64_t i) {
+    T token;
+    std::memcpy(&token, static_cast<const char*>(src) + i * sizeof(T),
+                sizeof(T));
+    return token;
+  });
+}
+
+// Slots of the ring buffer of a lock_free_queue, which are either placed in
+// storage provided by the queue or allocated. Tokens are stored as they are by
+// default.
+template <typename T>
+class slot_array {
+ public:
+  using reference = T&;
+
+  // Bytes of storage that each slot takes.
+  static constexpr size_t kSlotBytes = sizeof(T);
+
+  void init(void* storage, uint64_t size) {
+    if (storage == nullptr) {
+      this->heap_vals.reset(new T[size]());
+      this->vals = this->heap_vals.get();
+    } else {
+      this->vals = static_cast<T*>(storage);
+      std::uninitialized_value_construct_n(this->vals, size);
+      this->size = size;
+    }
+  }
+  ~slot_array() {
+    if (this->heap_vals == nullptr) std::destroy_n(this->vals, this->size);
+  }
+
+  static reference ref(T& elem) { return elem; }
+  reference operator[](uint64_t i) const { return this->vals[i]; }
+  void assign(uint64_t i, const T& elem) const { this->vals[i] = elem; }
+
+ private:
+  T* vals = nullptr;
+  uint64_t size = 0;  // of `vals` if placed in storage
+  std::unique_ptr<T[]> heap_vals;
+};
+
+// EoT tokens are rare, so their flags are kept in a separate array and the
+// values are packed without the padding that `elem_t` would take.
+template <typename T>
+class slot_array<elem_t<T>> {
+ public:
+  using reference = elem_ref_t<T>;
+
+  static constexpr size_t kSlotBytes = sizeof(T) + sizeof(bool);
+
+  void init(void* storage, uint64_t size) {
+    if (storage == nullptr) {
+      this->heap_vals.reset(new T[size]());
+      this->heap_eots.reset(new bool[size]());
+      this->vals = this->heap_vals.get();
+      this->eots = this->heap_eots.get();
+    } else {
+      this->vals = static_cast<T*>(storage);
+      std::uninitialized_value_construct_n(this->vals, size);
+      this->eots = reinterpret_cast<bool*>(this->vals + size);
+      std::uninitialized_value_construct_n(this->eots, size);
+      this->size = size;
+    }
+  }
+  ~slot_array() {
+    if (this->heap_vals == nullptr) std::destroy_n(this->vals, this->size);
+  }
+
+  static reference ref(elem_t<T>& elem) { return {elem.val, elem.eot}; }
+  reference operator[](uint64_t i) const {
+    return {this->vals[i], this->eots[i]};
+  }
+  void assign(uint64_t i, const elem_t<T>& elem) const {
+    this->vals[i] = elem.val;
+    this->eots[i] = elem.eot;
+  }
+
+ private:
+  T* vals = nullptr;
+  bool* eots = nullptr;
+  uint64_t size = 0;
+  std::unique_ptr<T[]> heap_vals;
+  std::unique_ptr<bool[]> heap_eots;
+};
+
 template <typename Param, typename Arg>
 struct accessor;
 
+// Returns whether streams are unbounded in simulation. This is enabled by
+// setting environment variable `TAPA_ELASTIC_STREAMS` to the path of a JSON
+// report, which records the maximum number of tokens buffered in each stream.
+bool is_elastic();
+
+// Adds a stream to the report of elastic streams.
+void report_high_water_mark(const std::string& name, uint64_t depth,
+                            uint64_t high_water_mark);
+
+// Returns whether stream stats are collected in simulation. This is enabled by
+// setting environment variable `TAPA_STREAM_STATS` to 1.
+bool is_stats_enabled();
+
+class base_queue;
+
+// Counters of a queue. Tokens buffered are integrated over time so that the
+// average occupancy can be reported. Counters of live queues are included in
+// `tapa::stats()` as well.
+class stats_counter {
+ public:
+  stats_counter(const base_queue* queue);
+  ~stats_counter();
+  void on_push(uint64_t n);
+  void on_pop(uint64_t n);
+  void on_stall(channel_state state);
+
+  // Returns the counters accumulated so far.
+  stream_stats get() const;
+
+ private:
+  void integrate(std::chrono::steady_clock::time_point now);
+
+  const base_queue* const queue;
+  mutable std::mutex mtx;
+  stream_stats counters;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point last_change;
+  uint64_t occupancy = 0;
+  double occupancy_integral = 0.;  // in tokens * seconds
+};
+
+// Timestamps of the tokens of a queue in cycle-approximate simulation. Each
+// token is readable the cycle after it is written, and a slot is writable the
+// cycle after the token in it is read, so the depth of the queue is enforced.
+class cycle_counter {
+ public:
+  cycle_counter(const base_queue* queue) : queue(queue) {}
+  void on_push(uint64_t n);
+  void on_pop(uint64_t n);
+
+ private:
+  const base_queue* const queue;
+  std::mutex mtx;
+  uint64_t pushes = 0;
+  uint64_t pops = 0;
+  std::deque<uint64_t> readable;  // When each token in the queue is readable.
+  std::deque<uint64_t> writable;  // When each of the last slots freed is.
+};
+
 class base_queue {
  public:
   // debug helpers
   const std::string& get_name() const { return this->name; }
   void set_name(const std::string& name) { this->name = name; }
 
+  // coroutines waiting for this queue to become non-empty and non-full
+  wait_list consumers;
+  wait_list producers;
+
+  virtual ~base_queue() = default;
+
+  virtual uint64_t get_depth() const = 0;
+  virtual bool empty() const = 0;
+
+  // Returns whether the queue is no longer empty (or full) per `state`, i.e.,
+  // whether a task that yielded on it may make progress.
+  virtual bool is_ready(channel_state state) const = 0;
+
+  // Counts a failed attempt to access this queue because it is not ready.
+  void on_stall(channel_state state) {
+    TAPA_PROBE(stream_block, this->name.c_str(),
+               int(state == channel_state::kFull));
+    if (this->stats != nullptr) this->stats->on_stall(state);
+  }
+
+  // Returns the queue written by the producer of this queue, which is not this
+  // queue if it belongs to a broadcast_stream or distribute_stream.
+  const base_queue* get_origin() const {
+    return this->origin != nullptr ? this->origin : this;
+  }
+
+  // Byte-wise access, with which tokens are carried to another process. Tokens
+  // are copied as they are, so the token size is 0 unless they are trivially
+  // copyable; it is 0 as well if the queue is MPMC, broadcast, or distributed.
+  virtual size_t get_token_size() const { return 0; }
+  // Copies up to `n` tokens to `dst` and pops them; returns the number popped.
+  virtual uint64_t pop_bytes(void* /*dst*/, uint64_t /*n*/) { return 0; }
+  // Pushes up to `n` tokens copied from `src`; returns the number pushed.
+  virtual uint64_t push_bytes(const void* /*src*/, uint64_t /*n*/) {
+    return 0;
+  }
+
  protected:
   std::string name;
 
-  base_queue(const std::string& name) : name(name) {}
+  // If true, the queue is unbounded and its high water mark is reported.
+  const bool elastic = is_elastic();
+  uint64_t high_water_mark = 0;  // written by the producer
 
-  virtual bool empty() const = 0;
+  // Counters of this queue; null unless stream stats are enabled.
+  std::unique_ptr<stats_counter> stats;
+
+  // Timestamps of this queue; null unless cycle-approximate simulation is
+  // enabled.
+  std::unique_ptr<cycle_counter> cycles;
+
+  // Queue written by the producer of the broadcast_stream or
+  // distribute_stream that this queue belongs to, which waits for this queue
+  // as well; null if this queue is written directly.
+  base_queue* origin = nullptr;
 
+  base_queue(const std::string& name) : name(name) {
+    if (is_stats_enabled()) this->stats.reset(new stats_counter(this));
+    if (is_cycle_sim_enabled()) this->cycles.reset(new cycle_counter(this));
+  }
+
+  void on_push(uint64_t n = 1) {
+    ++op_count;
+    TAPA_PROBE(stream_push, this->name.c_str(), n);
+    if (this->stats != nullptr) this->stats->on_push(n);
+    if (this->cycles != nullptr) this->cycles->on_push(n);
+    this->consumers.notify();
+  }
+  void on_pop(uint64_t n = 1) {
+    ++op_count;
+    TAPA_PROBE(stream_pop, this->name.c_str(), n);
+    if (this->stats != nullptr) this->stats->on_pop(n);
+    if (this->cycles != nullptr) this->cycles->on_pop(n);
+    this->producers.notify();
+    if (this->origin != nullptr) this->origin->producers.notify();
+  }
+
+  // Must be called by the destructor of derived classes.
   void check_leftover() {
+    // Counters refer to this queue, which is no longer valid after this.
+    this->stats.reset();
+    if (this->elastic) {
+      report_high_water_mark(this->name, this->get_depth(),
+                             this->high_water_mark);
+    }
     if (!this->empty()) {
       LOG(WARNING) << "channel '" << this->name
                    << "' destructed with leftovers; hardware behavior may be "
@@ -79,55 +405,434 @@ class base_queue {
   }
 };
 
+// Bounded ring buffer. By default, it allows a single producer and a single
+// consumer. If `mpmc` is set, each slot carries a sequence number so that
+// multiple producers and consumers can claim slots via compare-and-swap.
 template <typename T>
 class lock_free_queue : public base_queue {
-  // producer writes to head and consumer reads from tail
-  // okay to keep incrementing because it'll take > 100 yr to overflow uint64_t
-  std::atomic<uint64_t> tail{0};
-  std::atomic<uint64_t> head{0};
+  static constexpr size_t kCacheLineSize = 64;
+
+  // Indices keep incrementing; it'll take > 100 yr to overflow uint64_t. Each
+  // side caches the index of the other side and reloads it only if the queue
+  // looks empty (or full), so that the other side's cache line is touched only
+  // when necessary.
+
+  // written by the consumer(s)
+  alignas(kCacheLineSize) std::atomic<uint64_t> tail{0};
+  mutable uint64_t cached_head = 0;
+
+  // written by the producer(s)
+  alignas(kCacheLineSize) std::atomic<uint64_t> head{0};
+  mutable uint64_t cached_tail = 0;
+
+  alignas(kCacheLineSize) const uint64_t depth;
+  const uint64_t mask;  // buffer size is a power of 2 no less than depth
+  slot_array<T> buffer;  // `mask + 1` slots
+
+  // Sequence number of each slot, used only if the queue is MPMC. The slot of
+  // index `pos` is writable if its sequence number is `pos`, and readable if it
+  // is `pos + 1`.
+  std::unique_ptr<std::atomic<uint64_t>[]> seq;
+
+  // used instead of the ring buffer if the queue is elastic
+  mutable std::mutex elastic_mtx;
+  std::deque<T> elastic_buffer;
+
+  // Other queues of a broadcast_stream or a distribute_stream, which are
+  // written via this one. Each token pushed is copied to all of them in lock
+  // step, or if `is_distributing`, is sent to one of this queue and them that
+  // is not full in round-robin order, except that EoT is sent to all.
+  std::vector<lock_free_queue*> peers;
+  bool is_distributing = false;
+  size_t next_receiver = 0;  // 0 for this queue and `i + 1` for `peers[i]`
+
+  // An MPMC queue needs 2 slots at least to tell a popped slot from a ready one.
+  static uint64_t get_buffer_size(uint64_t depth, bool mpmc) {
+    uint64_t size = mpmc ? 2 : 1;
+    while (size < depth) size <<= 1;
+    return size;
+  }
+
+  bool is_mpmc() const { return this->seq != nullptr; }
 
-  std::vector<T> buffer;
+ protected:
+  // Places the buffer in `storage` if it has room, i.e., `capacity` slots, or
+  // allocates the buffer otherwise.
+  lock_free_queue(size_t depth, const std::string& name, bool mpmc,
+                  void* storage, uint64_t capacity)
+      : base_queue(name),
+        depth(depth),
+        mask(this->elastic ? 0 : get_buffer_size(depth, mpmc) - 1) {
+    this->buffer.init(this->mask < capacity ? storage : nullptr,
+                      this->mask + 1);
+    if (mpmc && !this->elastic) {
+      this->seq.reset(new std::atomic<uint64_t>[this->mask + 1]);
+      for (uint64_t i = 0; i <= this->mask; ++i) {
+        this->seq[i].store(i, std::memory_order_relaxed);
+      }
+    }
+  }
 
  public:
   // constructors
-  lock_free_queue(size_t depth, const std::string& name = "")
-      : base_queue(name) {
-    this->buffer.resize(depth);
-  }
+  lock_free_queue(size_t depth, const std::string& name = "",
+                  bool mpmc = false)
+      : lock_free_queue(depth, name, mpmc, nullptr, 0) {}
 
   // debug helpers
-  uint64_t get_depth() const { return this->buffer.size(); }
+  uint64_t get_depth() const override { return this->depth; }
 
   // basic queue operations
-  bool empty() const override { return this->head - this->tail <= 0; }
-  bool full() const { return this->head - this->tail >= this->buffer.size(); }
-  const T& front() const { return this->buffer[this->tail % buffer.size()]; }
-  T pop() {
-    auto val = this->front();
-    ++this->tail;
-    return val;
+  bool empty() const override {
+    if (this->elastic) {
+      std::unique_lock<std::mutex> lock(this->elastic_mtx);
+      return this->elastic_buffer.empty();
+    }
+    if (this->is_mpmc()) {
+      for (;;) {
+        const uint64_t tail = this->tail.load(std::memory_order_acquire);
+        const int64_t diff =
+            this->seq[tail & this->mask].load(std::memory_order_acquire) -
+            (tail + 1);
+        if (diff == 0) return false;
+        if (diff < 0) return true;
+        // Otherwise, `tail` has been popped by another consumer.
+      }
+    }
+    const uint64_t tail = this->tail.load(std::memory_order_relaxed);
+    if (this->cached_head == tail) {
+      this->cached_head = this->head.load(std::memory_order_acquire);
+    }
+    return this->cached_head == tail;
+  }
+  bool full() const {
+    return this->is_distributing ? this->is_all_full() : this->is_any_full();
+  }
+  bool is_ready(channel_state state) const override {
+    return state == channel_state::kEmpty ? !this->lock_free_queue::empty()
+                                          : !this->full();
+  }
+  // Returns whether an EoT token cannot be pushed, which a distributing queue
+  // sends to all of its peers.
+  bool full_for_eot() const { return this->is_any_full(); }
+  // Returns whether this queue itself is full, regardless of its peers.
+  bool is_self_full() const {
+    if (this->elastic) return false;
+    if (this->is_mpmc()) {
+      for (;;) {
+        const uint64_t head = this->head.load(std::memory_order_acquire);
+        const int64_t diff =
+            this->seq[head & this->mask].load(std::memory_order_acquire) -
+            head;
+        if (diff < 0) return true;
+        if (diff > 0) continue;  // `head` has been pushed by another producer
+        const int64_t size =
+            head - this->tail.load(std::memory_order_acquire);
+        if (size >= 0) return static_cast<uint64_t>(size) >= this->depth;
+      }
+    }
+    const uint64_t head = this->head.load(std::memory_order_relaxed);
+    if (head - this->cached_tail >= this->depth) {
+      this->cached_tail = this->tail.load(std::memory_order_acquire);
+    }
+    return head - this->cached_tail >= this->depth;
+  }
+
+  using reference = typename slot_array<T>::reference;
+
+  // Returns the next token, which is stable only with a single consumer.
+  reference front() {
+    if (this->elastic) {
+      std::unique_lock<std::mutex> lock(this->elastic_mtx);
+      return slot_array<T>::ref(this->elastic_buffer.front());
+    }
+    return this->buffer[this->tail.load(std::memory_order_relaxed) &
+                        this->mask];
+  }
+
+  // Passes the next token to `consume` and pops it if the queue is not empty,
+  // which has been tested by the caller. Returns false only if another
+  // consumer takes the token first.
+  template <typename Fn>
+  bool try_pop(Fn&& consume) {
+    if (this->elastic) {
+      {
+        std::unique_lock<std::mutex> lock(this->elastic_mtx);
+        if (this->elastic_buffer.empty()) return false;
+        consume(slot_array<T>::ref(this->elastic_buffer.front()));
+        this->elastic_buffer.pop_front();
+      }
+      this->on_pop();
+      return true;
+    }
+    if (this->is_mpmc()) {
+      uint64_t tail = this->tail.load(std::memory_order_relaxed);
+      for (;;) {
+        auto& seq = this->seq[tail & this->mask];
+        const int64_t diff = seq.load(std::memory_order_acquire) - (tail + 1);
+        if (diff < 0) return false;
+        if (diff > 0) {
+          tail = this->tail.load(std::memory_order_relaxed);
+        } else if (this->tail.compare_exchange_weak(
+                       tail, tail + 1, std::memory_order_relaxed)) {
+          consume(this->buffer[tail & this->mask]);
+          seq.store(tail + this->mask + 1, std::memory_order_release);
+          this->on_pop();
+          return true;
+        }
+      }
+    }
+    consume(this->front());
+    this->pop(1);
+    return true;
+  }
+
+  // Pushes `val` if the queue is not full, which has been tested by the
+  // caller. Returns false only if another producer takes the slot first.
+  bool try_push(const T& val) {
+    if (this->is_distributing && !is_eot(val)) {
+      const size_t count = this->peers.size() + 1;
+      for (size_t i = 0; i < count; ++i) {
+        const size_t pos = (this->next_receiver + i) % count;
+        const auto receiver = pos == 0 ? this : this->peers[pos - 1];
+        if (!receiver->is_self_full()) {
+          this->next_receiver = pos + 1;
+          return receiver->try_push_to_self(val);
+        }
+      }
+      return false;
+    }
+    for (const auto peer : this->peers) peer->try_push_to_self(val);
+    return this->try_push_to_self(val);
+  }
+
+  // Pushes `val` into this queue but not its peers.
+  bool try_push_to_self(const T& val) {
+    if (this->elastic) {
+      this->push_to_self(1, [&val](uint64_t) -> const T& { return val; });
+      return true;
+    }
+    if (this->is_mpmc()) {
+      uint64_t head = this->head.load(std::memory_order_relaxed);
+      for (;;) {
+        auto& seq = this->seq[head & this->mask];
+        const int64_t diff = seq.load(std::memory_order_acquire) - head;
+        const int64_t size =
+            head - this->tail.load(std::memory_order_acquire);
+        if (diff < 0 || size >= static_cast<int64_t>(this->depth)) {
+          return false;
+        }
+        if (diff > 0) {
+          head = this->head.load(std::memory_order_relaxed);
+        } else if (this->head.compare_exchange_weak(
+                       head, head + 1, std::memory_order_relaxed)) {
+          this->buffer.assign(head & this->mask, val);
+          seq.store(head + 1, std::memory_order_release);
+          this->on_push();
+          return true;
+        }
+      }
+    }
+    const uint64_t head = this->head.load(std::memory_order_relaxed);
+    this->buffer.assign(head & this->mask, val);
+    this->head.store(head + 1, std::memory_order_release);
+    this->on_push();
+    return true;
+  }
+
+  // Batch queue operations. If the queue is MPMC, tokens are transferred one at
+  // a time, and the tokens inspected via `at` are stable only with a single
+  // consumer.
+  uint64_t readable() const {
+    if (this->elastic) {
+      std::unique_lock<std::mutex> lock(this->elastic_mtx);
+      return this->elastic_buffer.size();
+    }
+    if (this->is_mpmc()) return this->lock_free_queue::empty() ? 0 : 1;
+    this->cached_head = this->head.load(std::memory_order_acquire);
+    return this->cached_head - this->tail.load(std::memory_order_relaxed);
+  }
+  uint64_t writable() const {
+    if (this->elastic) return std::numeric_limits<uint64_t>::max();
+    if (this->is_mpmc() || !this->peers.empty()) {
+      return this->full() ? 0 : 1;
+    }
+    this->cached_tail = this->tail.load(std::memory_order_acquire);
+    return this->depth -
+           (this->head.load(std::memory_order_relaxed) - this->cached_tail);
+  }
+  reference at(uint64_t pos) {
+    if (this->elastic) {
+      std::unique_lock<std::mutex> lock(this->elastic_mtx);
+      return slot_array<T>::ref(this->elastic_buffer[pos]);
+    }
+    return this->buffer[(this->tail.load(std::memory_order_relaxed) + pos) &
+                        this->mask];
+  }
+  void pop(uint64_t n) {
+    if (this->elastic) {
+      {
+        std::unique_lock<std::mutex> lock(this->elastic_mtx);
+        this->elastic_buffer.erase(this->elastic_buffer.begin(),
+                                   this->elastic_buffer.begin() + n);
+      }
+      this->on_pop(n);
+      return;
+    }
+    if (this->is_mpmc()) {
+      for (uint64_t i = 0; i < n && this->try_pop([](reference) {}); ++i) {
+      }
+      return;
+    }
+    const uint64_t tail = this->tail.load(std::memory_order_relaxed);
+    this->tail.store(tail + n, std::memory_order_release);
+    this->on_pop(n);
+  }
+  // Returns the number of tokens pushed.
+  template <typename Fn>
+  uint64_t push(uint64_t n, Fn&& elem_at) {
+    if (!this->peers.empty()) {
+      // One at a time, since `elem_at` may not be called twice for a token.
+      uint64_t i = 0;
+      for (; i < n && !this->full() && this->try_push(elem_at(i)); ++i) {
+      }
+      return i;
+    }
+    return this->push_to_self(n, std::forward<Fn>(elem_at));
+  }
+
+  // Makes `peer` written via this queue, which either copies each token to it
+  // or, if `distribute` is set, sends some tokens to it.
+  void add_peer(lock_free_queue* peer, bool distribute) {
+    CHECK(!this->is_mpmc() && !peer->is_mpmc())
+        << "channel '" << this->name
+        << "' cannot be both MPMC and broadcast or distributed";
+    this->peers.push_back(peer);
+    this->is_distributing = distribute;
+    peer->origin = this;
   }
-  void push(const T& val) {
-    this->buffer[this->head % buffer.size()] = val;
-    ++this->head;
+
+  // byte-wise queue operations
+  size_t get_token_size() const override {
+    if (!std::is_trivially_copyable<T>::value || this->is_mpmc() ||
+        !this->peers.empty() || this->origin != nullptr) {
+      return 0;
+    }
+    return sizeof(T);
+  }
+  uint64_t pop_bytes(void* dst, uint64_t n) override {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+      return internal::pop_bytes<T>(*this, dst, n);
+    } else {
+      return 0;
+    }
+  }
+  uint64_t push_bytes(const void* src, uint64_t n) override {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+      return internal::push_bytes<T>(*this, src, n);
+    } else {
+      return 0;
+    }
   }
 
   ~lock_free_queue() { this->check_leftover(); }
+
+  // Returns the number of slots of the buffer for `depth` that a
+  // fixed_lock_free_queue places inline.
+  static constexpr uint64_t get_inline_capacity(uint64_t depth) {
+    uint64_t size = 2;  // as an MPMC queue needs
+    while (size < depth) size <<= 1;
+    return size * slot_array<T>::kSlotBytes <= kMaxInlineBytes ? size : 0;
+  }
+
+ private:
+  // Buffers larger than this are allocated separately even if the depth is
+  // known at compile time, since they may not be used by elastic streams.
+  static constexpr uint64_t kMaxInlineBytes = 64 * 1024;
+
+  bool is_any_full() const {
+    for (const auto peer : this->peers) {
+      if (peer->is_self_full()) return true;
+    }
+    return this->is_self_full();
+  }
+  bool is_all_full() const {
+    for (const auto peer : this->peers) {
+      if (!peer->is_self_full()) return false;
+    }
+    return this->is_self_full();
+  }
+
+  // Pushes tokens into this queue but not its peers.
+  template <typename Fn>
+  uint64_t push_to_self(uint64_t n, Fn&& elem_at) {
+    if (this->elastic) {
+      {
+        std::unique_lock<std::mutex> lock(this->elastic_mtx);
+        for (uint64_t i = 0; i < n; ++i) {
+          this->elastic_buffer.push_back(elem_at(i));
+        }
+        this->high_water_mark =
+            std::max<uint64_t>(this->high_water_mark,
+                               this->elastic_buffer.size());
+      }
+      this->on_push(n);
+      return n;
+    }
+    if (this->is_mpmc()) {
+      uint64_t i = 0;
+      for (; i < n && this->try_push_to_self(elem_at(i)); ++i) {
+      }
+      return i;
+    }
+    const uint64_t head = this->head.load(std::memory_order_relaxed);
+    for (uint64_t i = 0; i < n; ++i) {
+      this->buffer.assign((head + i) & this->mask, elem_at(i));
+    }
+    this->head.store(head + n, std::memory_order_release);
+    this->on_push(n);
+    return n;
+  }
+};
+
+// A lock_free_queue whose depth is known at compile time. Small buffers are
+// placed at the end of the queue itself, which saves an allocation and a
+// pointer dereference away from the indices per stream.
+template <typename T, uint64_t N>
+class fixed_lock_free_queue : public lock_free_queue<T> {
+  static constexpr uint64_t kCapacity =
+      lock_free_queue<T>::get_inline_capacity(N);
+
+  // The slots are constructed and destructed by lock_free_queue.
+  alignas(T) unsigned char storage[slot_array<T>::kSlotBytes *
+                                   std::max<uint64_t>(kCapacity, 1)];
+
+ public:
+  fixed_lock_free_queue(const std::string& name = "", bool mpmc = false)
+      : lock_free_queue<T>(N, name, mpmc, this->storage, kCapacity) {}
 };
 
+// Mutex-protected queue, which allows multiple producers and consumers.
 template <typename T>
 class locked_queue : public base_queue {
   size_t depth;
   mutable std::mutex mtx;
   std::deque<T> buffer;
 
+  // Other queues of a broadcast_stream or a distribute_stream, which are
+  // written via this one as in lock_free_queue.
+  std::vector<locked_queue*> peers;
+  bool is_distributing = false;
+  size_t next_receiver = 0;  // 0 for this queue and `i + 1` for `peers[i]`
+
  public:
   // constructors
-  locked_queue(size_t depth, const std::string& name = "")
+  locked_queue(size_t depth, const std::string& name = "",
+               bool /*mpmc*/ = false)
       : base_queue(name), depth(depth) {}
 
   // debug helpers
-  uint64_t get_depth() const { return this->depth; }
+  uint64_t get_depth() const override { return this->depth; }
 
   // basic queue operations
   bool empty() const override {
@@ -135,6 +840,15 @@ class locked_queue : public base_queue {
     return this->buffer.empty();
   }
   bool full() const {
+    return this->is_distributing ? this->is_all_full() : this->is_any_full();
+  }
+  bool is_ready(channel_state state) const override {
+    return state == channel_state::kEmpty ? !this->locked_queue::empty()
+                                          : !this->full();
+  }
+  bool full_for_eot() const { return this->is_any_full(); }
+  bool is_self_full() const {
+    if (this->elastic) return false;
     std::unique_lock<std::mutex> lock(this->mtx);
     return this->buffer.size() >= this->depth;
   }
@@ -142,18 +856,140 @@ class locked_queue : public base_queue {
     std::unique_lock<std::mutex> lock(this->mtx);
     return this->buffer.front();
   }
-  T pop() {
+  T& front() {
     std::unique_lock<std::mutex> lock(this->mtx);
-    auto val = this->buffer.front();
-    this->buffer.pop_front();
-    return val;
+    return this->buffer.front();
+  }
+  template <typename Fn>
+  bool try_pop(Fn&& consume) {
+    {
+      std::unique_lock<std::mutex> lock(this->mtx);
+      if (this->buffer.empty()) return false;
+      consume(this->buffer.front());
+      this->buffer.pop_front();
+    }
+    this->on_pop();
+    return true;
+  }
+  bool try_push(const T& val) {
+    const auto val_at = [&val](uint64_t) -> const T& { return val; };
+    if (this->is_distributing && !is_eot(val)) {
+      const size_t count = this->peers.size() + 1;
+      for (size_t i = 0; i < count; ++i) {
+        const size_t pos = (this->next_receiver + i) % count;
+        const auto receiver = pos == 0 ? this : this->peers[pos - 1];
+        if (!receiver->is_self_full()) {
+          this->next_receiver = pos + 1;
+          return receiver->push_to_self(1, val_at) == 1;
+        }
+      }
+      return false;
+    }
+    for (const auto peer : this->peers) peer->push_to_self(1, val_at);
+    return this->push_to_self(1, val_at) == 1;
+  }
+
+  // batch queue operations
+  uint64_t readable() const {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    return this->buffer.size();
+  }
+  uint64_t writable() const {
+    if (this->elastic) return std::numeric_limits<uint64_t>::max();
+    if (!this->peers.empty()) return this->full() ? 0 : 1;
+    std::unique_lock<std::mutex> lock(this->mtx);
+    return this->depth - this->buffer.size();
+  }
+  const T& at(uint64_t pos) const {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    return this->buffer[pos];
   }
-  void push(const T& val) {
+  T& at(uint64_t pos) {
     std::unique_lock<std::mutex> lock(this->mtx);
-    this->buffer.push_back(val);
+    return this->buffer[pos];
+  }
+  void pop(uint64_t n) {
+    {
+      std::unique_lock<std::mutex> lock(this->mtx);
+      this->buffer.erase(this->buffer.begin(), this->buffer.begin() + n);
+    }
+    this->on_pop(n);
+  }
+  template <typename Fn>
+  uint64_t push(uint64_t n, Fn&& elem_at) {
+    if (!this->peers.empty()) {
+      // One at a time, since `elem_at` may not be called twice for a token.
+      uint64_t i = 0;
+      for (; i < n && !this->full() && this->try_push(elem_at(i)); ++i) {
+      }
+      return i;
+    }
+    return this->push_to_self(n, std::forward<Fn>(elem_at));
+  }
+
+  // Makes `peer` written via this queue, which either copies each token to it
+  // or, if `distribute` is set, sends some tokens to it.
+  void add_peer(locked_queue* peer, bool distribute) {
+    this->peers.push_back(peer);
+    this->is_distributing = distribute;
+    peer->origin = this;
+  }
+
+  // byte-wise queue operations
+  size_t get_token_size() const override {
+    if (!std::is_trivially_copyable<T>::value || !this->peers.empty() ||
+        this->origin != nullptr) {
+      return 0;
+    }
+    return sizeof(T);
+  }
+  uint64_t pop_bytes(void* dst, uint64_t n) override {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+      return internal::pop_bytes<T>(*this, dst, n);
+    } else {
+      return 0;
+    }
+  }
+  uint64_t push_bytes(const void* src, uint64_t n) override {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+      return internal::push_bytes<T>(*this, src, n);
+    } else {
+      return 0;
+    }
   }
 
   ~locked_queue() { this->check_leftover(); }
+
+ private:
+  bool is_any_full() const {
+    for (const auto peer : this->peers) {
+      if (peer->is_self_full()) return true;
+    }
+    return this->is_self_full();
+  }
+  bool is_all_full() const {
+    for (const auto peer : this->peers) {
+      if (!peer->is_self_full()) return false;
+    }
+    return this->is_self_full();
+  }
+
+  // Pushes tokens into this queue but not its peers.
+  template <typename Fn>
+  uint64_t push_to_self(uint64_t n, Fn&& elem_at) {
+    {
+      std::unique_lock<std::mutex> lock(this->mtx);
+      if (!this->elastic) {
+        n = std::min<uint64_t>(n, this->depth - this->buffer.size());
+      }
+      if (n == 0) return 0;
+      for (uint64_t i = 0; i < n; ++i) this->buffer.push_back(elem_at(i));
+      this->high_water_mark =
+          std::max<uint64_t>(this->high_water_mark, this->buffer.size());
+    }
+    this->on_push(n);
+    return n;
+  }
 };
 
 template <typename T>
@@ -163,7 +999,42 @@ using queue = locked_queue<T>;
 using queue = lock_free_queue<T>;
 #endif  // TAPA_USE_LOCKED_QUEUE
 
-// shared pointer of a queue
+// Queue of depth `N`, which is a constant.
+template <typename T, uint64_t N>
+#ifdef TAPA_USE_LOCKED_QUEUE
+using fixed_queue = locked_queue<T>;
+#else   // TAPA_USE_LOCKED_QUEUE
+using fixed_queue = fixed_lock_free_queue<T, N>;
+#endif  // TAPA_USE_LOCKED_QUEUE
+
+// Deletes a queue whose owner has gone. If any task may still access the
+// queue, it is deleted once all tasks have finished instead.
+void release(base_queue* queue);
+
+// Creates a queue owned by the object that declares a stream. Handles passed to
+// tasks refer to the queue without owning it, so they are copied without
+// touching any reference count.
+template <typename T>
+inline std::shared_ptr<queue<elem_t<T>>> make_queue(uint64_t depth,
+                                                    const std::string& name,
+                                                    bool mpmc = false) {
+  return {new queue<elem_t<T>>(depth, name, mpmc),
+          [](base_queue* queue) { release(queue); }};
+}
+
+// Creates a queue of depth `N` like `make_queue` does.
+template <typename T, uint64_t N>
+inline std::shared_ptr<queue<elem_t<T>>> make_queue(const std::string& name,
+                                                    bool mpmc = false) {
+#ifdef TAPA_USE_LOCKED_QUEUE
+  return make_queue<T>(N, name, mpmc);
+#else   // TAPA_USE_LOCKED_QUEUE
+  return {new fixed_queue<elem_t<T>, N>(name, mpmc),
+          [](base_queue* queue) { release(queue); }};
+#endif  // TAPA_USE_LOCKED_QUEUE
+}
+
+// non-owning pointer of a queue
 template <typename T>
 class basic_stream {
  public:
@@ -172,15 +1043,56 @@ class basic_stream {
   void set_name(const std::string& name) { ptr->set_name(name); }
   uint64_t get_depth() const { return this->ptr->get_depth(); }
 
+  // scheduling helpers
+  channel_t get_channel(channel_end end = channel_end::kUnknown) const {
+    return {static_cast<const base_queue*>(this->ptr), get_depth(), end};
+  }
+
+  // Tests whether the queue is empty (or full). If so, the current task yields
+  // until the queue may be ready.
+  bool poll_empty() const {
+    const bool is_empty = this->ptr->empty();
+    if (is_empty) {
+      this->ptr->on_stall(channel_state::kEmpty);
+      yield(&this->ptr->consumers, this->get_name(), channel_state::kEmpty,
+            this->ptr);
+    } else {
+      // Cancel waiting if the current coroutine waits on this channel.
+      this->ptr->consumers.cancel();
+    }
+    return is_empty;
+  }
+  // An EoT token may need room in more queues than other tokens do.
+  bool poll_full(bool eot = false) const {
+    const bool is_full =
+        eot ? this->ptr->full_for_eot() : this->ptr->full();
+    if (is_full) {
+      this->ptr->on_stall(channel_state::kFull);
+      yield(&this->ptr->producers, this->get_name(), channel_state::kFull,
+            this->ptr);
+    } else {
+      // Cancel waiting if the current coroutine waits on this channel.
+      this->ptr->producers.cancel();
+    }
+    return is_full;
+  }
+
   // not protected since we'll use std::vector<basic_stream<T>>
-  basic_stream(const std::shared_ptr<queue<elem_t<T>>>& ptr) : ptr(ptr) {}
+  basic_stream(queue<elem_t<T>>* ptr) : ptr(ptr) {}
   basic_stream(const basic_stream&) = default;
   basic_stream(basic_stream&&) = default;
   basic_stream& operator=(const basic_stream&) = default;
   basic_stream& operator=(basic_stream&&) = delete;  // -Wvirtual-move-assign
 
  protected:
-  std::shared_ptr<queue<elem_t<T>>> ptr;
+  // allow istreams and ostreams to access all channels at once
+  template <typename U, uint64_t S>
+  friend class tapa::istreams;
+  template <typename U, uint64_t S>
+  friend class tapa::ostreams;
+
+  // Not owned; see `make_queue`.
+  queue<elem_t<T>>* ptr;
 };
 
 // shared pointer of multiple queues
@@ -201,9 +1113,11 @@ class basic_streams {
   basic_streams& operator=(basic_streams&&) = delete;  // -Wvirtual-move-assign
 
   basic_stream<T> operator[](int pos) const {
-    CHECK_NOTNULL(ptr.get());
-    CHECK_GE(pos, 0);
-    CHECK_LT(pos, ptr->refs.size());
+    if (kCheckEachAccess) {
+      CHECK_NOTNULL(ptr.get());
+      CHECK_GE(pos, 0);
+      CHECK_LT(pos, ptr->refs.size());
+    }
     return ptr->refs[pos];
   }
 
@@ -229,6 +1143,11 @@ class unbound_streams : public istreams<T, S>, public ostreams<T, S> {
   unbound_streams() : basic_streams<T>(nullptr) {}
 };
 
+// Appends channels accessed via a task argument to `channels`.
+template <typename T>
+inline void add_channels(std::vector<channel_t>& /*channels*/,
+                         const T& /*arg*/) {}
+
 #endif  // __SYNTHESIS__
 
 }  // namespace internal
@@ -255,11 +1174,7 @@ class istream
 #pragma HLS inline
     return _.empty();
 #else   // __SYNTHESIS__
-    bool is_empty = this->ptr->empty();
-    if (is_empty) {
-      internal::yield("channel '" + this->get_name() + "' is empty");
-    }
-    return is_empty;
+    return this->poll_empty();
 #endif  // __SYNTHESIS__
   }
 
@@ -337,8 +1252,8 @@ class istream
     return is_success;
 #else   // __SYNTHESIS__
     if (!empty()) {
-      auto& elem = this->ptr->front();
-      if (elem.eot) {
+      const auto& elem = this->ptr->front();
+      if (internal::kCheckEachAccess && elem.eot) {
         LOG(FATAL) << "channel '" << this->get_name() << "' peeked when closed";
       }
       value = elem.val;
@@ -386,15 +1301,40 @@ class istream
 
   /// Peeks the stream.
   ///
-  /// This is a @a non-blocking and @a non-destructive operation.
+  /// This is a @a blocking and @a non-destructive operation.
   ///
-  /// @param[out] is_success Whether the next token is available.
-  /// @param[out] is_eot     Set to @c false if the stream is empty. Otherwise,
-  ///                        updated to indicate whether the next token is EoT.
-  /// @return                The value of the next token is returned if it is
-  ///                        available. Otherwise, default-constructed @c T() is
-  ///                        returned.
-  T peek(bool& is_success, bool& is_eot) const {
+  /// The next token must not be EoT.
+  ///
+  /// @return The value of the next token. In simulation, this is a reference
+  ///         into the stream that remains valid until the token is read.
+#ifdef __SYNTHESIS__
+  T peek() const {
+#pragma HLS inline
+    return _peek.read().val;
+  }
+#else   // __SYNTHESIS__
+  const T& peek() const {
+    while (empty()) {
+    }
+    const auto& elem = this->ptr->front();
+    if (internal::kCheckEachAccess && elem.eot) {
+      LOG(FATAL) << "channel '" << this->get_name() << "' peeked when closed";
+    }
+    return elem.val;
+  }
+#endif  // __SYNTHESIS__
+
+  /// Peeks the stream.
+  ///
+  /// This is a @a non-blocking and @a non-destructive operation.
+  ///
+  /// @param[out] is_success Whether the next token is available.
+  /// @param[out] is_eot     Set to @c false if the stream is empty. Otherwise,
+  ///                        updated to indicate whether the next token is EoT.
+  /// @return                The value of the next token is returned if it is
+  ///                        available. Otherwise, default-constructed @c T() is
+  ///                        returned.
+  T peek(bool& is_success, bool& is_eot) const {
 #ifdef __SYNTHESIS__
 #pragma HLS inline
     internal::elem_t<T> peek_val;
@@ -403,7 +1343,7 @@ class istream
     return peek_val.val;
 #else   // __SYNTHESIS__
     if (!empty()) {
-      auto& elem = this->ptr->front();
+      const auto& elem = this->ptr->front();
       is_success = true;
       is_eot = elem.eot;
       return elem.val;
@@ -431,15 +1371,13 @@ class istream
     value = elem.val;
     return is_success;
 #else   // __SYNTHESIS__
-    if (!empty()) {
-      auto elem = this->ptr->pop();
-      if (elem.eot) {
+    // Move the value out of the queue without copying the token.
+    return !empty() && this->ptr->try_pop([&](auto&& elem) {
+      if (internal::kCheckEachAccess && elem.eot) {
         LOG(FATAL) << "channel '" << this->get_name() << "' read when closed";
       }
-      value = elem.val;
-      return true;
-    }
-    return false;
+      value = std::move(elem.val);
+    });
 #endif  // __SYNTHESIS__
   }
 
@@ -534,6 +1472,103 @@ class istream
     return succeeded ? val : default_value;
   }
 
+  /// Reads up to @c n tokens that are available in the stream.
+  ///
+  /// This is a @a non-blocking and @a destructive operation.
+  ///
+  /// Reading stops before an EoT token.
+  ///
+  /// @param[out] dst Array to store the values of the tokens.
+  /// @param[in] n    Maximum number of tokens to read.
+  /// @return         Number of tokens read.
+  size_t try_read_burst(T* dst, size_t n) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+    size_t i = 0;
+    for (; i < n; ++i) {
+#pragma HLS pipeline II = 1
+      internal::elem_t<T> elem;
+      if (!_.read_nb(elem)) break;
+      dst[i] = elem.val;
+    }
+    return i;
+#else   // __SYNTHESIS__
+    if (empty()) return 0;
+    const uint64_t count = std::min<uint64_t>(n, this->ptr->readable());
+    uint64_t i = 0;
+    for (; i < count; ++i) {
+      const auto& elem = this->ptr->at(i);
+      if (elem.eot) break;
+      dst[i] = elem.val;
+    }
+    if (i > 0) this->ptr->pop(i);
+    return i;
+#endif  // __SYNTHESIS__
+  }
+
+  /// Reads @c n tokens from the stream.
+  ///
+  /// This is a @a blocking and @a destructive operation.
+  ///
+  /// The next @c n tokens must not be EoT.
+  ///
+  /// @param[out] dst Array to store the values of the tokens.
+  /// @param[in] n    Number of tokens to read.
+  void read(T* dst, size_t n) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+    for (size_t i = 0; i < n; ++i) {
+#pragma HLS pipeline II = 1
+      dst[i] = _.read().val;
+    }
+#else   // __SYNTHESIS__
+    for (size_t i = 0; i < n;) {
+      const size_t count = try_read_burst(dst + i, n - i);
+      if (count == 0 && !this->ptr->empty() && this->ptr->front().eot) {
+        LOG(FATAL) << "channel '" << this->get_name() << "' read when closed";
+      }
+      i += count;
+    }
+#endif  // __SYNTHESIS__
+  }
+
+  /// Reads a transaction, i.e., all tokens before the next EoT token, and
+  /// consumes the EoT token.
+  ///
+  /// This is a @a blocking and @a destructive operation.
+  ///
+  /// @param[out] values Container to which the values of the tokens are
+  ///                    appended via @c push_back.
+  /// @return            Number of tokens read, excluding the EoT token.
+  template <typename Container>
+  size_t read_transaction(Container& values) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+    size_t n = 0;
+    for (internal::elem_t<T> elem = _.read(); !elem.eot; elem = _.read()) {
+#pragma HLS pipeline II = 1
+      values.push_back(elem.val);
+      ++n;
+    }
+    return n;
+#else   // __SYNTHESIS__
+    for (size_t n = 0;;) {
+      if (empty()) continue;
+      const uint64_t count = this->ptr->readable();
+      for (uint64_t i = 0; i < count; ++i) {
+        auto&& elem = this->ptr->at(i);
+        if (elem.eot) {
+          this->ptr->pop(i + 1);
+          return n + i;
+        }
+        values.push_back(std::move(elem.val));
+      }
+      this->ptr->pop(count);
+      n += count;
+    }
+#endif  // __SYNTHESIS__
+  }
+
   /// Consumes an EoT token.
   ///
   /// This is a @a non-blocking and @a destructive operation.
@@ -549,15 +1584,12 @@ class istream
     assert(!succeeded || elem.eot);
     return succeeded;
 #else   // __SYNTHESIS__
-    if (!empty()) {
-      auto elem = this->ptr->pop();
-      if (!elem.eot) {
+    return !empty() && this->ptr->try_pop([&](auto&& elem) {
+      if (internal::kCheckEachAccess && !elem.eot) {
         LOG(FATAL) << "channel '" << this->get_name()
                    << "' opened when not closed";
       }
-      return true;
-    }
-    return false;
+    });
 #endif  // __SYNTHESIS__
   }
 
@@ -589,8 +1621,14 @@ class istream
   // allow istreams and streams to return istream
   template <typename U, uint64_t S>
   friend class istreams;
-  template <typename U, uint64_t S, uint64_t N>
+  template <typename U, uint64_t S, uint64_t N, typename Impl>
   friend class streams;
+  template <typename U, uint64_t S, uint64_t N, typename Impl>
+  friend class broadcast_stream;
+  template <typename U, uint64_t S, uint64_t N, typename Impl>
+  friend class merge_stream;
+  template <typename U, uint64_t S, uint64_t N, typename Impl>
+  friend class distribute_stream;
   istream(const internal::basic_stream<T>& base)
       : internal::basic_stream<T>(base) {}
 #endif  // __SYNTHESIS__
@@ -618,11 +1656,7 @@ class ostream
 #pragma HLS inline
     return _.full();
 #else   // __SYNTHESIS__
-    bool is_full = this->ptr->full();
-    if (is_full) {
-      internal::yield("channel '" + this->get_name() + "' is full");
-    }
-    return is_full;
+    return this->poll_full();
 #endif  // __SYNTHESIS__
   }
 
@@ -637,11 +1671,7 @@ class ostream
 #pragma HLS inline
     return _.write_nb({value, false});
 #else   // __SYNTHESIS__
-    if (!full()) {
-      this->ptr->push({value, false});
-      return true;
-    }
-    return false;
+    return !full() && this->ptr->try_push({value, false});
 #endif  // __SYNTHESIS__
   }
 
@@ -660,6 +1690,81 @@ class ostream
 #endif  // __SYNTHESIS__
   }
 
+  /// Writes up to @c n values to the stream, as many as there is space for.
+  ///
+  /// This is a @a non-blocking and @a destructive operation.
+  ///
+  /// @param[in] src Array of the values to write.
+  /// @param[in] n   Maximum number of values to write.
+  /// @return        Number of values written.
+  size_t try_write_burst(const T* src, size_t n) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+    size_t i = 0;
+    for (; i < n; ++i) {
+#pragma HLS pipeline II = 1
+      if (!_.write_nb({src[i], false})) break;
+    }
+    return i;
+#else   // __SYNTHESIS__
+    if (full()) return 0;
+    const uint64_t count = std::min<uint64_t>(n, this->ptr->writable());
+    return this->ptr->push(count, [src](uint64_t i) {
+      return internal::elem_t<T>{src[i], false};
+    });
+#endif  // __SYNTHESIS__
+  }
+
+  /// Writes @c n values to the stream.
+  ///
+  /// This is a @a blocking and @a destructive operation.
+  ///
+  /// @param[in] src Array of the values to write.
+  /// @param[in] n   Number of values to write.
+  void write(const T* src, size_t n) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+    for (size_t i = 0; i < n; ++i) {
+#pragma HLS pipeline II = 1
+      _.write({src[i], false});
+    }
+#else   // __SYNTHESIS__
+    for (size_t i = 0; i < n;) {
+      i += try_write_burst(src + i, n - i);
+    }
+#endif  // __SYNTHESIS__
+  }
+
+  /// Writes a transaction, i.e., all values in @c values followed by an EoT
+  /// token.
+  ///
+  /// This is a @a blocking and @a destructive operation.
+  ///
+  /// @param[in] values Range of the values to write.
+  template <typename Range>
+  void write_transaction(const Range& values) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+    for (const auto& value : values) {
+#pragma HLS pipeline II = 1
+      _.write({value, false});
+    }
+    close();
+#else   // __SYNTHESIS__
+    auto it = std::begin(values);
+    for (uint64_t n = std::distance(it, std::end(values)); n > 0;) {
+      if (full()) continue;
+      auto next = it;
+      const uint64_t count = this->ptr->push(
+          std::min<uint64_t>(n, this->ptr->writable()),
+          [&next](uint64_t) { return internal::elem_t<T>{*next++, false}; });
+      std::advance(it, count);
+      n -= count;
+    }
+    close();
+#endif  // __SYNTHESIS__
+  }
+
   /// Produces an EoT token to the stream.
   ///
   /// This is a @a non-blocking and @a destructive operation.
@@ -673,11 +1778,7 @@ class ostream
     elem.eot = true;
     return _.write_nb(elem);
 #else   // __SYNTHESIS__
-    if (!full()) {
-      this->ptr->push({{}, true});
-      return true;
-    }
-    return false;
+    return !this->poll_full(/*eot=*/true) && this->ptr->try_push({{}, true});
 #endif  // __SYNTHESIS__
   }
 
@@ -707,15 +1808,52 @@ class ostream
   // allow ostreams and streams to return ostream
   template <typename U, uint64_t S>
   friend class ostreams;
-  template <typename U, uint64_t S, uint64_t N>
+  template <typename U, uint64_t S, uint64_t N, typename Impl>
   friend class streams;
+  template <typename U, uint64_t S, uint64_t N, typename Impl>
+  friend class broadcast_stream;
+  template <typename U, uint64_t S, uint64_t N, typename Impl>
+  friend class merge_stream;
+  template <typename U, uint64_t S, uint64_t N, typename Impl>
+  friend class distribute_stream;
   ostream(const internal::basic_stream<T>& base)
       : internal::basic_stream<T>(base) {}
 #endif  // __SYNTHESIS__
 };
 
+/// Depth of a @c tapa::stream or @c tapa::streams whose depth is not
+/// specified. @c tapac may replace it with an inferred depth if
+/// @c --auto-fifo-depth is set.
+constexpr uint64_t kStreamDefaultDepth = 2;
+
+/// Memories that implement the FIFO of a @c tapa::stream or @c tapa::streams in
+/// hardware. They have no effect in software simulation.
+namespace impl {
+
+/// Chosen by @c tapac from the width and depth of the FIFO.
+struct automatic {};
+
+/// Shift registers, which are the cheapest for shallow FIFOs of any width.
+struct srl {};
+
+/// Distributed RAM in LUTs.
+struct lutram {};
+
+/// Block RAM.
+struct bram {};
+
+/// UltraRAM.
+struct uram {};
+
+}  // namespace impl
+
 /// Defines a communication channel between two task instances.
-template <typename T, uint64_t N>
+///
+/// @tparam T    Type of the tokens.
+/// @tparam N    Depth of the channel.
+/// @tparam Impl Memory of the FIFO in hardware; one of @c tapa::impl.
+template <typename T, uint64_t N = kStreamDefaultDepth,
+          typename Impl = impl::automatic>
 class stream
 #ifndef __SYNTHESIS__
     : public internal::unbound_stream<T> {
@@ -724,30 +1862,80 @@ class stream
   constexpr static int depth = N;
 
   /// Constructs a @c tapa::stream.
-  stream()
-      : internal::basic_stream<T>(
-            std::make_shared<internal::queue<internal::elem_t<T>>>(N)) {}
+  stream() : stream(internal::make_queue<T, N>("")) {}
 
   /// Constructs a @c tapa::stream with the given name for debugging.
   ///
   /// @param[in] name Name of the communication channel (for debugging only).
   template <size_t S>
-  stream(const char (&name)[S])
-      : internal::basic_stream<T>(
-            std::make_shared<internal::queue<internal::elem_t<T>>>(N, name)) {}
+  stream(const char (&name)[S]) : stream(internal::make_queue<T, N>(name)) {}
+
+ protected:
+  stream(std::shared_ptr<internal::queue<internal::elem_t<T>>> owner)
+      : internal::basic_stream<T>(owner.get()), owner(std::move(owner)) {}
 
  private:
-  template <typename U, uint64_t friend_length, uint64_t friend_depth>
+  template <typename U, uint64_t friend_length, uint64_t friend_depth,
+            typename friend_impl>
   friend class streams;
   stream(const internal::basic_stream<T>& base)
       : internal::basic_stream<T>(base) {}
+
+  // null if this references a stream in a `tapa::streams` array
+  std::shared_ptr<internal::queue<internal::elem_t<T>>> owner;
 }
 #endif  // __SYNTHESIS__
 ;
 
 /// Alternative name of @c tapa::stream.
-template <typename T, uint64_t depth>
-using channel = stream<T, depth>;
+template <typename T, uint64_t depth = kStreamDefaultDepth,
+          typename Impl = impl::automatic>
+using channel = stream<T, depth, Impl>;
+
+#ifdef __SYNTHESIS__
+namespace internal {
+
+// A FIFO local to a task fused by `tapacc -fuse-tasks`, connecting two of its
+// dataflow processes. The consumer must not peek, because `_peek` is connected
+// to the FIFO only by tapac.
+template <typename T>
+class fused_stream : public istream<T> {
+ public:
+  // Returns the producer-side interface of the same FIFO, which is the first
+  // and only member of `ostream`.
+  ostream<T>& producer() { return *reinterpret_cast<ostream<T>*>(&this->_); }
+};
+
+}  // namespace internal
+#endif  // __SYNTHESIS__
+
+#ifndef __SYNTHESIS__
+/// Defines a communication channel that allows multiple producers and multiple
+/// consumers in software simulation, e.g., for testbenches that fan in.
+///
+/// Writes and destructive single-token reads may happen concurrently from any
+/// number of task instances. Peeks and burst reads see stable tokens only if
+/// there is a single consumer. This is not synthesizable.
+template <typename T, uint64_t N>
+class mpmc_stream : public stream<T, N> {
+ public:
+  /// Constructs a @c tapa::mpmc_stream.
+  mpmc_stream()
+      : mpmc_stream(internal::make_queue<T, N>("", /*mpmc=*/true)) {}
+
+  /// Constructs a @c tapa::mpmc_stream with the given name for debugging.
+  ///
+  /// @param[in] name Name of the communication channel (for debugging only).
+  template <size_t S>
+  mpmc_stream(const char (&name)[S])
+      : mpmc_stream(internal::make_queue<T, N>(name, /*mpmc=*/true)) {}
+
+ private:
+  mpmc_stream(std::shared_ptr<internal::queue<internal::elem_t<T>>> owner)
+      : internal::basic_stream<T>(owner.get()),
+        stream<T, N>(std::move(owner)) {}
+};
+#endif  // __SYNTHESIS__
 
 /// Provides consumer-side operations to an array of @c tapa::stream where they
 /// are used as @a inputs.
@@ -771,12 +1959,55 @@ class istreams : virtual public internal::basic_streams<T> {
     return internal::basic_streams<T>::operator[](pos);
   }
 
+  /// Reads one token from each stream in the array if all of them are
+  /// available.
+  ///
+  /// This is a @a non-blocking and @a destructive operation.
+  ///
+  /// None of the next tokens may be EoT.
+  ///
+  /// @param[out] values Uninitialized if any stream is empty. Otherwise,
+  ///                    updated so that lane @c i holds the token read from
+  ///                    stream @c i.
+  /// @return            Whether @c values is updated.
+  bool try_read_all(vec_t<T, S>& values) {
+    const auto& refs = this->ptr->refs;
+    for (uint64_t i = 0; i < S; ++i) {
+      if (refs[i].poll_empty()) return false;
+    }
+    for (uint64_t i = 0; i < S; ++i) {
+      refs[i].ptr->try_pop([&](auto&& elem) {
+        if (internal::kCheckEachAccess && elem.eot) {
+          LOG(FATAL) << "channel '" << refs[i].get_name()
+                     << "' read when closed";
+        }
+        values.set(i, std::move(elem.val));
+      });
+    }
+    return true;
+  }
+
+  /// Reads one token from each stream in the array.
+  ///
+  /// This is a @a blocking and @a destructive operation.
+  ///
+  /// None of the next tokens may be EoT.
+  ///
+  /// @return Tokens read, where lane @c i is read from stream @c i.
+  vec_t<T, S> read_all() {
+    vec_t<T, S> values;
+    while (!try_read_all(values)) {
+    }
+    return values;
+  }
+
  protected:
   // allow derived class to omit initialization
   istreams() : internal::basic_streams<T>(nullptr) {}
 
   // allow streams of any length to return istreams
-  template <typename U, uint64_t friend_length, uint64_t friend_depth>
+  template <typename U, uint64_t friend_length, uint64_t friend_depth,
+            typename friend_impl>
   friend class streams;
 
   // allow istreams of any length to return istreams
@@ -835,12 +2066,42 @@ class ostreams : virtual public internal::basic_streams<T> {
     return internal::basic_streams<T>::operator[](pos);
   }
 
+  /// Writes one token to each stream in the array if none of them is full.
+  ///
+  /// This is a @a non-blocking and @a destructive operation.
+  ///
+  /// @param[in] values Values to write, where lane @c i is written to stream
+  ///                   @c i.
+  /// @return           Whether @c values has been written successfully.
+  bool try_write_all(const vec_t<T, S>& values) {
+    const auto& refs = this->ptr->refs;
+    for (uint64_t i = 0; i < S; ++i) {
+      if (refs[i].poll_full()) return false;
+    }
+    for (uint64_t i = 0; i < S; ++i) {
+      refs[i].ptr->try_push({values[i], false});
+    }
+    return true;
+  }
+
+  /// Writes one token to each stream in the array.
+  ///
+  /// This is a @a blocking and @a destructive operation.
+  ///
+  /// @param[in] values Values to write, where lane @c i is written to stream
+  ///                   @c i.
+  void write_all(const vec_t<T, S>& values) {
+    while (!try_write_all(values)) {
+    }
+  }
+
  protected:
   // allow derived class to omit initialization
   ostreams() : internal::basic_streams<T>(nullptr) {}
 
   // allow streams of any length to return ostreams
-  template <typename U, uint64_t friend_length, uint64_t friend_depth>
+  template <typename U, uint64_t friend_length, uint64_t friend_depth,
+            typename friend_impl>
   friend class streams;
 
   // allow ostreams of any length to return istreams
@@ -877,8 +2138,358 @@ class ostreams : virtual public internal::basic_streams<T> {
 };
 #endif  // __SYNTHESIS__
 
+/// Reads one token from each stream of @c in if all of them are available.
+///
+/// This is a @a non-blocking and @a destructive operation, and is the
+/// synthesizable spelling of @c tapa::istreams::try_read_all. All streams are
+/// checked together and then read together.
+///
+/// @param[in] in      Streams to read from.
+/// @param[out] values Uninitialized if any stream is empty. Otherwise, updated
+///                    so that lane @c i holds the token read from
+///                    <tt>in[i]</tt>.
+/// @return            Whether @c values is updated.
+template <typename T, uint64_t S>
+inline bool try_read_all(istreams<T, S>& in, vec_t<T, int(S)>& values) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+  bool is_ready = true;
+  for (uint64_t i = 0; i < S; ++i) {
+#pragma HLS unroll
+    is_ready &= !in[i].empty();
+  }
+  if (is_ready) {
+    for (uint64_t i = 0; i < S; ++i) {
+#pragma HLS unroll
+      values.set(i, in[i].read(nullptr));
+    }
+  }
+  return is_ready;
+#else   // __SYNTHESIS__
+  return in.try_read_all(values);
+#endif  // __SYNTHESIS__
+}
+
+/// Reads one token from each stream of @c in.
+///
+/// This is a @a blocking and @a destructive operation, and is the
+/// synthesizable spelling of @c tapa::istreams::read_all.
+///
+/// @param[in] in Streams to read from.
+/// @return       Tokens read, where lane @c i is read from <tt>in[i]</tt>.
+template <typename T, uint64_t S>
+inline vec_t<T, int(S)> read_all(istreams<T, S>& in) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+  vec_t<T, int(S)> values;
+  for (uint64_t i = 0; i < S; ++i) {
+#pragma HLS unroll
+    values.set(i, in[i].read());
+  }
+  return values;
+#else   // __SYNTHESIS__
+  return in.read_all();
+#endif  // __SYNTHESIS__
+}
+
+/// Writes one token to each stream of @c out if none of them is full.
+///
+/// This is a @a non-blocking and @a destructive operation, and is the
+/// synthesizable spelling of @c tapa::ostreams::try_write_all. All streams are
+/// checked together and then written together.
+///
+/// @param[in] out    Streams to write to.
+/// @param[in] values Values to write, where lane @c i is written to
+///                   <tt>out[i]</tt>.
+/// @return           Whether @c values has been written successfully.
+template <typename T, uint64_t S>
+inline bool try_write_all(ostreams<T, S>& out, const vec_t<T, int(S)>& values) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+  bool is_ready = true;
+  for (uint64_t i = 0; i < S; ++i) {
+#pragma HLS unroll
+    is_ready &= !out[i].full();
+  }
+  if (is_ready) {
+    for (uint64_t i = 0; i < S; ++i) {
+#pragma HLS unroll
+      out[i].try_write(values[i]);
+    }
+  }
+  return is_ready;
+#else   // __SYNTHESIS__
+  return out.try_write_all(values);
+#endif  // __SYNTHESIS__
+}
+
+/// Writes one token to each stream of @c out.
+///
+/// This is a @a blocking and @a destructive operation, and is the
+/// synthesizable spelling of @c tapa::ostreams::write_all.
+///
+/// @param[in] out    Streams to write to.
+/// @param[in] values Values to write, where lane @c i is written to
+///                   <tt>out[i]</tt>.
+template <typename T, uint64_t S>
+inline void write_all(ostreams<T, S>& out, const vec_t<T, int(S)>& values) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+  for (uint64_t i = 0; i < S; ++i) {
+#pragma HLS unroll
+    out[i].write(values[i]);
+  }
+#else   // __SYNTHESIS__
+  out.write_all(values);
+#endif  // __SYNTHESIS__
+}
+
+/// Repacks a transaction of narrow vectors into wide vectors, e.g., to feed
+/// tokens from a 4-lane producer to a 16-lane consumer.
+///
+/// This is a @a blocking and @a destructive operation, which reads all tokens
+/// of @c in before the next EoT token, writes them to @c out in the same
+/// order, and then forwards the EoT token. Each token of @c out holds
+/// <tt>M / N</tt> consecutive tokens of @c in, where the earliest token takes
+/// the lowest lanes. If the number of tokens read is not a multiple of
+/// <tt>M / N</tt>, the unfilled lanes of the last token are @c T().
+///
+/// One token is read per cycle in hardware. Tasks must not be templates, so
+/// this is called from a task of concrete types, e.g.,
+/// @code
+/// void Widen(tapa::istream<tapa::vec_t<float, 4>>& in,
+///            tapa::ostream<tapa::vec_t<float, 16>>& out) {
+///   tapa::widen(in, out);
+/// }
+/// @endcode
+///
+/// @param[in] in   Stream of narrow vectors to read from.
+/// @param[in] out  Stream of wide vectors to write to.
+template <int N, int M, typename T>
+inline void widen(istream<vec_t<T, N>>& in, ostream<vec_t<T, M>>& out) {
+  static_assert(M % N == 0, "M must be a multiple of N");
+  constexpr int kRatio = M / N;
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+  vec_t<T, M> buf;
+  int pos = 0;  // index of the next narrow token in `buf`
+widen:
+  for (;;) {
+#pragma HLS pipeline II = 1
+    bool is_eot;
+    if (in.try_eot(is_eot)) {
+      if (is_eot) break;
+      const vec_t<T, N> val = in.read(nullptr);
+      for (int i = 0; i < M; ++i) {
+#pragma HLS unroll
+        if (i / N == pos) buf.set(i, val[i % N]);
+      }
+      if (pos == kRatio - 1) {
+        out.write(buf);
+        pos = 0;
+      } else {
+        ++pos;
+      }
+    }
+  }
+  if (pos > 0) {
+    for (int i = 0; i < M; ++i) {
+#pragma HLS unroll
+      if (i / N >= pos) buf.set(i, T());
+    }
+    out.write(buf);
+  }
+#else   // __SYNTHESIS__
+  constexpr int kBatch = 64;  // wide tokens per copy
+  std::vector<vec_t<T, N>> narrow_buf(kBatch * kRatio);
+  std::vector<vec_t<T, M>> wide_buf(kBatch);
+  for (size_t n = 0;;) {  // n: number of narrow tokens in `narrow_buf`
+    n += in.try_read_burst(narrow_buf.data() + n, narrow_buf.size() - n);
+    bool is_eot;
+    const bool is_done = in.try_eot(is_eot) && is_eot;
+    const size_t count = is_done ? (n + kRatio - 1) / kRatio : n / kRatio;
+    for (size_t i = 0; i < count * kRatio; ++i) {
+      vec_t<T, N> val{};
+      if (i < n) val = narrow_buf[i];
+      for (int j = 0; j < N; ++j) {
+        wide_buf[i / kRatio].set(i % kRatio * N + j, val[j]);
+      }
+    }
+    out.write(wide_buf.data(), count);
+    if (is_done) break;
+    std::copy(narrow_buf.begin() + count * kRatio, narrow_buf.begin() + n,
+              narrow_buf.begin());
+    n -= count * kRatio;
+  }
+#endif  // __SYNTHESIS__
+  in.open();
+  out.close();
+}
+
+/// Splits a transaction of wide vectors into narrow vectors, e.g., to feed
+/// tokens from a 16-lane memory reader to a 4-lane compute task.
+///
+/// This is a @a blocking and @a destructive operation, which reads all tokens
+/// of @c in before the next EoT token, writes each of them to @c out as
+/// <tt>M / N</tt> consecutive tokens, lowest lanes first, and then forwards
+/// the EoT token.
+///
+/// One token is written per cycle in hardware. As with @c tapa::widen, this is
+/// called from a task of concrete types.
+///
+/// @param[in] in   Stream of wide vectors to read from.
+/// @param[in] out  Stream of narrow vectors to write to.
+template <int M, int N, typename T>
+inline void narrow(istream<vec_t<T, M>>& in, ostream<vec_t<T, N>>& out) {
+  static_assert(M % N == 0, "M must be a multiple of N");
+  constexpr int kRatio = M / N;
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+  vec_t<T, M> buf;
+  int pos = 0;  // index of the next narrow token in `buf`
+narrow:
+  for (;;) {
+#pragma HLS pipeline II = 1
+    if (pos == 0) {
+      bool is_eot;
+      if (!in.try_eot(is_eot)) continue;
+      if (is_eot) break;
+      buf = in.read(nullptr);
+    }
+    vec_t<T, N> val;
+    for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+      val.set(i, buf[i]);
+    }
+    out.write(val);
+    // Shift the next narrow token into the lowest lanes, which is pure wiring.
+    for (int i = 0; i < M - N; ++i) {
+#pragma HLS unroll
+      buf.set(i, buf[i + N]);
+    }
+    pos = pos == kRatio - 1 ? 0 : pos + 1;
+  }
+#else   // __SYNTHESIS__
+  constexpr int kBatch = 64;  // wide tokens per copy
+  std::vector<vec_t<T, M>> wide_buf(kBatch);
+  std::vector<vec_t<T, N>> narrow_buf(kBatch * kRatio);
+  for (;;) {
+    const size_t count = in.try_read_burst(wide_buf.data(), kBatch);
+    for (size_t i = 0; i < count * kRatio; ++i) {
+      for (int j = 0; j < N; ++j) {
+        narrow_buf[i].set(j, wide_buf[i / kRatio][i % kRatio * N + j]);
+      }
+    }
+    out.write(narrow_buf.data(), count * kRatio);
+    bool is_eot;
+    if (in.try_eot(is_eot) && is_eot) break;
+  }
+#endif  // __SYNTHESIS__
+  in.open();
+  out.close();
+}
+
+/// Merges a sorted transaction from each of two streams into one sorted
+/// transaction, e.g., as a stage of a merge sort.
+///
+/// This is a @a blocking and @a destructive operation, which reads all tokens
+/// of @c lhs and @c rhs before their next EoT tokens, writes them to @c out in
+/// the order given by @c comp, and then writes one EoT token. Tokens of
+/// @c lhs precede equal tokens of @c rhs, so the merge is stable. A token is
+/// read only once it is known to be the next output, so if both inputs are
+/// written by the same task, their depths must cover how far one input may
+/// run ahead of the other.
+///
+/// One token is written per cycle in hardware. As with @c tapa::widen, this is
+/// called from a task of concrete types, e.g., a detached task that merges
+/// runs forever:
+/// @code
+/// void Merge(tapa::istream<int>& lhs, tapa::istream<int>& rhs,
+///            tapa::ostream<int>& out) {
+///   for (;;) tapa::merge(lhs, rhs, out);
+/// }
+/// @endcode
+///
+/// @param[in] lhs  Stream of sorted tokens to read from.
+/// @param[in] rhs  Stream of sorted tokens to read from.
+/// @param[in] out  Stream to write the merged tokens to.
+/// @param[in] comp Strict weak ordering by which both inputs are sorted.
+template <typename T, typename Compare = std::less<T>>
+inline void merge(istream<T>& lhs, istream<T>& rhs, ostream<T>& out,
+                  const Compare& comp = Compare()) {
+#ifdef __SYNTHESIS__
+#pragma HLS inline
+merge:
+  for (;;) {
+#pragma HLS pipeline II = 1
+    bool is_lhs_valid, is_lhs_eot, is_rhs_valid, is_rhs_eot;
+    const T lhs_val = lhs.peek(is_lhs_valid, is_lhs_eot);
+    const T rhs_val = rhs.peek(is_rhs_valid, is_rhs_eot);
+    const bool is_lhs_done = is_lhs_valid && is_lhs_eot;
+    const bool is_rhs_done = is_rhs_valid && is_rhs_eot;
+    if (is_lhs_done && is_rhs_done) break;
+    const bool has_lhs = is_lhs_valid && !is_lhs_eot;
+    const bool has_rhs = is_rhs_valid && !is_rhs_eot;
+    if (has_lhs && (is_rhs_done || (has_rhs && !comp(rhs_val, lhs_val)))) {
+      lhs.read(nullptr);
+      out.write(lhs_val);
+    } else if (has_rhs && (is_lhs_done || has_lhs)) {
+      rhs.read(nullptr);
+      out.write(rhs_val);
+    }
+  }
+#else   // __SYNTHESIS__
+  constexpr size_t kBatch = 64;  // tokens per copy from each side
+  std::vector<T> lhs_buf(kBatch);
+  std::vector<T> rhs_buf(kBatch);
+  std::vector<T> out_buf(kBatch * 2);
+  size_t lhs_pos = 0, lhs_n = 0, rhs_pos = 0, rhs_n = 0;
+  bool is_lhs_done = false, is_rhs_done = false;
+  for (;;) {
+    bool is_eot;
+    if (lhs_pos == lhs_n && !is_lhs_done) {
+      lhs_pos = 0;
+      lhs_n = lhs.try_read_burst(lhs_buf.data(), kBatch);
+      is_lhs_done = lhs_n == 0 && lhs.try_eot(is_eot) && is_eot;
+    }
+    if (rhs_pos == rhs_n && !is_rhs_done) {
+      rhs_pos = 0;
+      rhs_n = rhs.try_read_burst(rhs_buf.data(), kBatch);
+      is_rhs_done = rhs_n == 0 && rhs.try_eot(is_eot) && is_eot;
+    }
+    if (is_lhs_done && is_rhs_done) break;
+    // Merge until either side runs out of buffered tokens before its EoT.
+    size_t n = 0;
+    for (;;) {
+      const bool has_lhs = lhs_pos < lhs_n;
+      const bool has_rhs = rhs_pos < rhs_n;
+      if (!(has_lhs || is_lhs_done) || !(has_rhs || is_rhs_done) ||
+          !(has_lhs || has_rhs)) {
+        break;
+      }
+      if (!has_rhs ||
+          (has_lhs && !comp(rhs_buf[rhs_pos], lhs_buf[lhs_pos]))) {
+        out_buf[n++] = lhs_buf[lhs_pos++];
+      } else {
+        out_buf[n++] = rhs_buf[rhs_pos++];
+      }
+    }
+    out.write(out_buf.data(), n);
+  }
+#endif  // __SYNTHESIS__
+  lhs.open();
+  rhs.open();
+  out.close();
+}
+
 /// Defines an array of @c tapa::stream.
-template <typename T, uint64_t S, uint64_t N>
+///
+/// @tparam T    Type of the tokens.
+/// @tparam S    Count of @c tapa::stream in the array.
+/// @tparam N    Depth of each @c tapa::stream.
+/// @tparam Impl Memory of the FIFOs in hardware; one of @c tapa::impl.
+template <typename T, uint64_t S, uint64_t N = kStreamDefaultDepth,
+          typename Impl = impl::automatic>
 class streams
 #ifndef __SYNTHESIS__
     : public internal::unbound_streams<T, S> {
@@ -895,8 +2506,8 @@ class streams
             std::make_shared<typename internal::basic_streams<T>::metadata_t>(
                 "", 0)) {
     for (int i = 0; i < S; ++i) {
-      this->ptr->refs.emplace_back(
-          std::make_shared<internal::queue<internal::elem_t<T>>>(N));
+      this->owners.push_back(internal::make_queue<T, N>(""));
+      this->ptr->refs.emplace_back(this->owners.back().get());
     }
   }
 
@@ -912,9 +2523,9 @@ class streams
             std::make_shared<typename internal::basic_streams<T>::metadata_t>(
                 name, 0)) {
     for (int i = 0; i < S; ++i) {
-      this->ptr->refs.emplace_back(
-          std::make_shared<internal::queue<internal::elem_t<T>>>(
-              N, this->ptr->name + "[" + std::to_string(i) + "]"));
+      this->owners.push_back(internal::make_queue<T, N>(
+          this->ptr->name + "[" + std::to_string(i) + "]"));
+      this->ptr->refs.emplace_back(this->owners.back().get());
     }
   }
 
@@ -922,7 +2533,7 @@ class streams
   ///
   /// @param pos Position of the array reference.
   /// @return @c tapa::stream referenced in the array.
-  stream<T, N> operator[](int pos) const {
+  stream<T, N, Impl> operator[](int pos) const {
     return internal::basic_streams<T>::operator[](pos);
   };
 
@@ -933,6 +2544,8 @@ class streams
   int istream_access_pos_ = 0;
   int ostream_access_pos_ = 0;
 
+  std::vector<std::shared_ptr<internal::queue<internal::elem_t<T>>>> owners;
+
   istream<T> access_as_istream() {
     CHECK_LT(istream_access_pos_, this->ptr->refs.size())
         << "channels '" << this->ptr->name << "' accessed as istream for "
@@ -978,18 +2591,286 @@ class streams
 ;
 
 /// Alternative name of @c tapa::streams.
-template <typename T, uint64_t S, uint64_t N>
-using channels = streams<T, S, N>;
+template <typename T, uint64_t S, uint64_t N = kStreamDefaultDepth,
+          typename Impl = impl::automatic>
+using channels = streams<T, S, N, Impl>;
+
+/// Defines a communication channel from one task instance to @c S task
+/// instances, each of which receives every token.
+///
+/// The producer is the only task instance that uses it as a
+/// @c tapa::ostream, and the consumers are the next @c S task instances that
+/// use it as a @c tapa::istream. A token is written to all consumers at once,
+/// which replaces a task that copies each token to @c S streams. In hardware,
+/// each consumer has a FIFO, and the producer writes all of them in lock
+/// step.
+///
+/// @tparam T    Type of the tokens.
+/// @tparam S    Count of consumers.
+/// @tparam N    Depth of the FIFO of each consumer.
+/// @tparam Impl Memory of the FIFOs in hardware; one of @c tapa::impl.
+template <typename T, uint64_t S, uint64_t N = kStreamDefaultDepth,
+          typename Impl = impl::automatic>
+class broadcast_stream
+#ifndef __SYNTHESIS__
+{
+ public:
+  /// Count of consumers.
+  constexpr static int fanout = S;
+
+  /// Depth of the FIFO of each consumer.
+  constexpr static int depth = N;
+
+  /// Constructs a @c tapa::broadcast_stream.
+  broadcast_stream() : broadcast_stream("") {}
+
+  /// Constructs a @c tapa::broadcast_stream with the given base name for
+  /// debugging.
+  ///
+  /// The actual name of the channel to each consumer would be
+  /// <tt>name[i]</tt>.
+  ///
+  /// @param[in] name Base name of the channel (for debugging only).
+  template <size_t name_length>
+  broadcast_stream(const char (&name)[name_length]) : name(name) {
+    static_assert(S > 0, "broadcast_stream needs at least one consumer");
+    for (int i = 0; i < S; ++i) {
+      this->owners.push_back(internal::make_queue<T, N>(
+          this->name + "[" + std::to_string(i) + "]"));
+      if (i > 0) {
+        this->owners[0]->add_peer(this->owners[i].get(), /*distribute=*/false);
+      }
+    }
+  }
+
+ private:
+  template <typename Param, typename Arg>
+  friend struct internal::accessor;
+
+  const std::string name;
+  int istream_access_pos_ = 0;
+  bool is_accessed_as_ostream_ = false;
+
+  // The producer writes the first queue, which copies each token to the
+  // others.
+  std::vector<std::shared_ptr<internal::queue<internal::elem_t<T>>>> owners;
+
+  istream<T> access_as_istream() {
+    CHECK_LT(istream_access_pos_, S)
+        << "broadcast channel '" << this->name << "' accessed as istream for "
+        << istream_access_pos_ + 1 << " times but it only has " << S
+        << " consumers";
+    return internal::basic_stream<T>(
+        this->owners[istream_access_pos_++].get());
+  }
+  ostream<T> access_as_ostream() {
+    CHECK(!is_accessed_as_ostream_)
+        << "broadcast channel '" << this->name
+        << "' accessed as ostream more than once";
+    is_accessed_as_ostream_ = true;
+    return internal::basic_stream<T>(this->owners[0].get());
+  }
+}
+#endif  // __SYNTHESIS__
+;
+
+/// Defines a communication channel from @c S task instances to one task
+/// instance, which receives the tokens of all producers.
+///
+/// The producers are the next @c S task instances that use it as a
+/// @c tapa::ostream, and the consumer is the only task instance that uses it
+/// as a @c tapa::istream. Tokens of the same producer are received in order,
+/// and tokens of different producers are interleaved in round-robin order in
+/// hardware, where each producer has a FIFO and an arbiter forwards their
+/// tokens to the consumer. EoT tokens are forwarded as well, so the consumer
+/// receives one EoT token per producer per transaction.
+///
+/// @tparam T    Type of the tokens.
+/// @tparam S    Count of producers.
+/// @tparam N    Depth of the FIFO of each producer.
+/// @tparam Impl Memory of the FIFOs in hardware; one of @c tapa::impl.
+template <typename T, uint64_t S, uint64_t N = kStreamDefaultDepth,
+          typename Impl = impl::automatic>
+class merge_stream
+#ifndef __SYNTHESIS__
+{
+ public:
+  /// Count of producers.
+  constexpr static int fanin = S;
+
+  /// Depth of the FIFO of each producer.
+  constexpr static int depth = N;
+
+  /// Constructs a @c tapa::merge_stream.
+  merge_stream() : merge_stream("") {}
+
+  /// Constructs a @c tapa::merge_stream with the given name for debugging.
+  ///
+  /// @param[in] name Name of the channel (for debugging only).
+  template <size_t name_length>
+  merge_stream(const char (&name)[name_length])
+      : name(name),
+        owner(internal::make_queue<T, S * N>(name, /*mpmc=*/true)) {
+    static_assert(S > 0, "merge_stream needs at least one producer");
+  }
+
+ private:
+  template <typename Param, typename Arg>
+  friend struct internal::accessor;
+
+  const std::string name;
+  int ostream_access_pos_ = 0;
+  bool is_accessed_as_istream_ = false;
+
+  // All producers write the same queue, which holds as many tokens as their
+  // FIFOs do in hardware.
+  std::shared_ptr<internal::queue<internal::elem_t<T>>> owner;
+
+  istream<T> access_as_istream() {
+    CHECK(!is_accessed_as_istream_)
+        << "merge channel '" << this->name
+        << "' accessed as istream more than once";
+    is_accessed_as_istream_ = true;
+    return internal::basic_stream<T>(this->owner.get());
+  }
+  ostream<T> access_as_ostream() {
+    CHECK_LT(ostream_access_pos_, S)
+        << "merge channel '" << this->name << "' accessed as ostream for "
+        << ostream_access_pos_ + 1 << " times but it only has " << S
+        << " producers";
+    ++ostream_access_pos_;
+    return internal::basic_stream<T>(this->owner.get());
+  }
+}
+#endif  // __SYNTHESIS__
+;
+
+/// Defines a communication channel from one task instance to @c S task
+/// instances, each of which receives some of the tokens.
+///
+/// The producer is the only task instance that uses it as a
+/// @c tapa::ostream, and the consumers are the next @c S task instances that
+/// use it as a @c tapa::istream. Each consumer has a FIFO, and each token is
+/// written to the first FIFO that is not full, in round-robin order, so that
+/// faster consumers receive more tokens. An EoT token is written to all FIFOs
+/// at once, so each consumer sees the end of each transaction. Tokens that
+/// must reach a particular consumer, e.g., by key, should be written to
+/// @c tapa::ostreams instead.
+///
+/// @tparam T    Type of the tokens.
+/// @tparam S    Count of consumers.
+/// @tparam N    Depth of the FIFO of each consumer.
+/// @tparam Impl Memory of the FIFOs in hardware; one of @c tapa::impl.
+template <typename T, uint64_t S, uint64_t N = kStreamDefaultDepth,
+          typename Impl = impl::automatic>
+class distribute_stream
+#ifndef __SYNTHESIS__
+{
+ public:
+  /// Count of consumers.
+  constexpr static int fanout = S;
+
+  /// Depth of the FIFO of each consumer.
+  constexpr static int depth = N;
+
+  /// Constructs a @c tapa::distribute_stream.
+  distribute_stream() : distribute_stream("") {}
+
+  /// Constructs a @c tapa::distribute_stream with the given base name for
+  /// debugging.
+  ///
+  /// The actual name of the channel to each consumer would be
+  /// <tt>name[i]</tt>.
+  ///
+  /// @param[in] name Base name of the channel (for debugging only).
+  template <size_t name_length>
+  distribute_stream(const char (&name)[name_length]) : name(name) {
+    static_assert(S > 0, "distribute_stream needs at least one consumer");
+    for (int i = 0; i < S; ++i) {
+      this->owners.push_back(internal::make_queue<T, N>(
+          this->name + "[" + std::to_string(i) + "]"));
+      if (i > 0) {
+        this->owners[0]->add_peer(this->owners[i].get(), /*distribute=*/true);
+      }
+    }
+  }
+
+ private:
+  template <typename Param, typename Arg>
+  friend struct internal::accessor;
+
+  const std::string name;
+  int istream_access_pos_ = 0;
+  bool is_accessed_as_ostream_ = false;
+
+  // The producer writes the first queue, which sends each token to one of the
+  // queues.
+  std::vector<std::shared_ptr<internal::queue<internal::elem_t<T>>>> owners;
+
+  istream<T> access_as_istream() {
+    CHECK_LT(istream_access_pos_, S)
+        << "distribute channel '" << this->name << "' accessed as istream for "
+        << istream_access_pos_ + 1 << " times but it only has " << S
+        << " consumers";
+    return internal::basic_stream<T>(
+        this->owners[istream_access_pos_++].get());
+  }
+  ostream<T> access_as_ostream() {
+    CHECK(!is_accessed_as_ostream_)
+        << "distribute channel '" << this->name
+        << "' accessed as ostream more than once";
+    is_accessed_as_ostream_ = true;
+    return internal::basic_stream<T>(this->owners[0].get());
+  }
+}
+#endif  // __SYNTHESIS__
+;
 
 #ifndef __SYNTHESIS__
 
 namespace internal {
 
 #define TAPA_DEFINE_ACCESSER(io, reference)                              \
+  /* param = i/ostream, arg = broadcast_stream */                        \
+  template <typename T, uint64_t fanout, uint64_t depth,                 \
+            typename impl_t>                                             \
+  struct accessor<io##stream<T> reference,                               \
+                  broadcast_stream<T, fanout, depth, impl_t>&> {         \
+    static io##stream<T> access(                                         \
+        broadcast_stream<T, fanout, depth, impl_t>& arg) {               \
+      return arg.access_as_##io##stream();                               \
+    }                                                                    \
+  };                                                                     \
+                                                                         \
+  /* param = i/ostream, arg = merge_stream */                            \
+  template <typename T, uint64_t fanin, uint64_t depth,                  \
+            typename impl_t>                                             \
+  struct accessor<io##stream<T> reference,                               \
+                  merge_stream<T, fanin, depth, impl_t>&> {              \
+    static io##stream<T> access(                                         \
+        merge_stream<T, fanin, depth, impl_t>& arg) {                    \
+      return arg.access_as_##io##stream();                               \
+    }                                                                    \
+  };                                                                     \
+                                                                         \
+  /* param = i/ostream, arg = distribute_stream */                       \
+  template <typename T, uint64_t fanout, uint64_t depth,                 \
+            typename impl_t>                                             \
+  struct accessor<io##stream<T> reference,                               \
+                  distribute_stream<T, fanout, depth, impl_t>&> {        \
+    static io##stream<T> access(                                         \
+        distribute_stream<T, fanout, depth, impl_t>& arg) {              \
+      return arg.access_as_##io##stream();                               \
+    }                                                                    \
+  };                                                                     \
+                                                                         \
   /* param = i/ostream, arg = streams */                                 \
-  template <typename T, uint64_t length, uint64_t depth>                 \
-  struct accessor<io##stream<T> reference, streams<T, length, depth>&> { \
-    static io##stream<T> access(streams<T, length, depth>& arg) {        \
+  template <typename T, uint64_t length, uint64_t depth,                 \
+            typename impl_t>                                             \
+  struct accessor<io##stream<T> reference,                               \
+                  streams<T, length, depth, impl_t>&> {                  \
+    static io##stream<T> access(                                         \
+        streams<T, length, depth, impl_t>& arg) {                        \
       return arg.access_as_##io##stream();                               \
     }                                                                    \
   };                                                                     \
@@ -1004,11 +2885,11 @@ namespace internal {
                                                                          \
   /* param = i/ostreams, arg = streams */                                \
   template <typename T, uint64_t param_length, uint64_t arg_length,      \
-            uint64_t depth>                                              \
+            uint64_t depth, typename impl_t>                             \
   struct accessor<io##streams<T, param_length> reference,                \
-                  streams<T, arg_length, depth>&> {                      \
+                  streams<T, arg_length, depth, impl_t>&> {              \
     static io##streams<T, param_length> access(                          \
-        streams<T, arg_length, depth>& arg) {                            \
+        streams<T, arg_length, depth, impl_t>& arg) {                    \
       return arg.template access_as_##io##streams<param_length>();       \
     }                                                                    \
   };                                                                     \
@@ -1032,6 +2913,34 @@ TAPA_DEFINE_ACCESSER(o, &&)
 
 #undef TAPA_DEFINE_ACCESSER
 
+template <typename T>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const istream<T>& arg) {
+  channels.push_back(arg.get_channel(channel_end::kConsumer));
+}
+
+template <typename T>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const ostream<T>& arg) {
+  channels.push_back(arg.get_channel(channel_end::kProducer));
+}
+
+template <typename T, uint64_t S>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const istreams<T, S>& arg) {
+  for (uint64_t pos = 0; pos < S; ++pos) {
+    channels.push_back(arg[pos].get_channel(channel_end::kConsumer));
+  }
+}
+
+template <typename T, uint64_t S>
+inline void add_channels(std::vector<channel_t>& channels,
+                         const ostreams<T, S>& arg) {
+  for (uint64_t pos = 0; pos < S; ++pos) {
+    channels.push_back(arg[pos].get_channel(channel_end::kProducer));
+  }
+}
+
 }  // namespace internal
 
 #endif  // __SYNTHESIS__
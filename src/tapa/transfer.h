@@ -0,0 +1,496 @@
+#ifndef TAPA_TRANSFER_H_
+#define TAPA_TRANSFER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef __SYNTHESIS__
+
+#include <algorithm>
+#include <vector>
+
+#include <glog/logging.h>
+
+#endif  // __SYNTHESIS__
+
+#include "tapa/mmap.h"
+#include "tapa/stream.h"
+#include "tapa/util.h"
+#include "tapa/vec.h"
+
+namespace tapa {
+
+namespace internal {
+
+// Addresses `offset`, `offset + stride`, `offset + 2 * stride`, ...
+template <typename Addr>
+class strided_addrs {
+ public:
+  strided_addrs(Addr offset, Addr stride) : next_(offset), stride_(stride) {}
+
+  bool try_peek(Addr& addr) const {
+#pragma HLS inline
+    addr = next_;
+    return true;
+  }
+
+  void pop() {
+#pragma HLS inline
+    next_ += stride_;
+  }
+
+  size_t try_read_burst(Addr* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      dst[i] = next_;
+      next_ += stride_;
+    }
+    return n;
+  }
+
+ private:
+  Addr next_;
+  const Addr stride_;
+};
+
+// Explicit burst requests that cover `rows` rows of `cols` elements, where
+// row `r` starts at `offset + r * stride`. Each row is split into bursts of
+// at most `kMaxExplicitBurstLen` elements.
+template <typename Addr>
+class row_bursts {
+ public:
+  row_bursts(Addr offset, uint64_t cols, int64_t stride)
+      : row_(offset), cols_(cols), stride_(stride) {}
+
+  // Number of requests that cover `rows` rows.
+  static uint64_t count(uint64_t rows, uint64_t cols) {
+    return rows * ((cols + kMaxExplicitBurstLen - 1) / kMaxExplicitBurstLen);
+  }
+
+  bool try_peek(Addr& addr) const {
+#pragma HLS inline
+    addr = encode_burst(row_ + col_, length());
+    return true;
+  }
+
+  void pop() {
+#pragma HLS inline
+    col_ += length();
+    if (col_ == cols_) {
+      col_ = 0;
+      row_ += stride_;
+    }
+  }
+
+  size_t try_read_burst(Addr* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      try_peek(dst[i]);
+      pop();
+    }
+    return n;
+  }
+
+ private:
+  uint64_t length() const {
+    return cols_ - col_ < kMaxExplicitBurstLen ? cols_ - col_
+                                               : kMaxExplicitBurstLen;
+  }
+
+  Addr row_;
+  uint64_t col_ = 0;
+  const uint64_t cols_;
+  const Addr stride_;
+};
+
+// Addresses read from a stream of indices.
+template <typename Addr>
+class indexed_addrs {
+ public:
+  explicit indexed_addrs(istream<Addr>& indices) : indices_(indices) {}
+
+  bool try_peek(Addr& addr) const {
+#pragma HLS inline
+    return indices_.try_peek(addr);
+  }
+
+  void pop() {
+#pragma HLS inline
+    indices_.read(nullptr);
+  }
+
+  size_t try_read_burst(Addr* dst, size_t n) {
+    return indices_.try_read_burst(dst, n);
+  }
+
+ private:
+  istream<Addr>& indices_;
+};
+
+#ifndef __SYNTHESIS__
+
+// Moves tokens from a source with `try_read_burst` to an ostream in batches,
+// without blocking on either side. A whole batch is moved by a single channel
+// operation on each side, which is much cheaper than moving token by token in
+// simulation.
+template <typename T>
+class batch_relay {
+ public:
+  static constexpr size_t kBatchSize = 64;
+
+  // Moves as many of the remaining `n` tokens as possible without blocking
+  // and returns the number of tokens written to `dst`.
+  template <typename Src>
+  uint64_t step(Src& src, ostream<T>& dst, uint64_t n) {
+    if (begin_ == end_ && n > 0) {
+      begin_ = 0;
+      end_ = src.try_read_burst(buf_, std::min<uint64_t>(n, kBatchSize));
+    }
+    if (begin_ == end_) return 0;
+    const size_t written = dst.try_write_burst(buf_ + begin_, end_ - begin_);
+    begin_ += written;
+    return written;
+  }
+
+ private:
+  T buf_[kBatchSize];
+  size_t begin_ = 0;
+  size_t end_ = 0;
+};
+
+#endif  // __SYNTHESIS__
+
+// Reads `n` elements requested by the first `n_req` requests of `addrs` and
+// writes them to `out` in order.
+template <typename T, typename Mem, typename Addrs>
+void read_to_stream(Mem& mem, Addrs& addrs, ostream<T>& out, uint64_t n,
+                    uint64_t n_req) {
+#pragma HLS inline
+#ifdef __SYNTHESIS__
+  // Requests are issued as long as the memory accepts them, so the number of
+  // requests in flight is bounded by the async_mmap only. Neither side blocks
+  // the other, so the loop is deadlock-free and runs at II=1.
+  for (uint64_t i_req = 0, i_resp = 0; i_resp < n;) {
+#pragma HLS pipeline II = 1
+    typename Mem::addr_t addr;
+    if (i_req < n_req && !mem.read_addr.full() && addrs.try_peek(addr)) {
+      mem.read_addr.write(addr);
+      addrs.pop();
+      ++i_req;
+    }
+    if (!mem.read_data.empty() && !out.full()) {
+      out.write(mem.read_data.read(nullptr));
+      ++i_resp;
+    }
+  }
+#else   // __SYNTHESIS__
+  batch_relay<typename Mem::addr_t> req;
+  batch_relay<T> resp;
+  for (uint64_t i_req = 0, i_resp = 0; i_resp < n;) {
+    i_req += req.step(addrs, mem.read_addr, n_req - i_req);
+    i_resp += resp.step(mem.read_data, out, n - i_resp);
+  }
+#endif  // __SYNTHESIS__
+}
+
+// Writes `n` elements read from `in` to the addresses given by the first
+// `n_req` requests of `addrs`, and returns once all writes are acknowledged.
+template <typename T, typename Mem, typename Addrs>
+void write_from_stream(istream<T>& in, Addrs& addrs, Mem& mem, uint64_t n,
+                       uint64_t n_req) {
+#pragma HLS inline
+#ifdef __SYNTHESIS__
+  // Addresses and data are written independently, since a burst request
+  // carries many elements.
+  for (uint64_t i_req = 0, i_data = 0, i_resp = 0; i_resp < n;) {
+#pragma HLS pipeline II = 1
+    typename Mem::addr_t addr;
+    if (i_req < n_req && !mem.write_addr.full() && addrs.try_peek(addr)) {
+      mem.write_addr.write(addr);
+      addrs.pop();
+      ++i_req;
+    }
+    if (i_data < n && !in.empty() && !mem.write_data.full()) {
+      mem.write_data.write(in.read(nullptr));
+      ++i_data;
+    }
+    if (!mem.write_resp.empty()) {
+      i_resp += mem.write_resp.read(nullptr) + 1;
+    }
+  }
+#else   // __SYNTHESIS__
+  // The addresses and data are paired by the async_mmap, so they are relayed
+  // independently.
+  batch_relay<typename Mem::addr_t> addr_req;
+  batch_relay<T> data_req;
+  for (uint64_t i_addr = 0, i_data = 0, i_resp = 0; i_resp < n;) {
+    i_addr += addr_req.step(addrs, mem.write_addr, n_req - i_addr);
+    i_data += data_req.step(in, mem.write_data, n - i_data);
+    typename Mem::resp_t resp;
+    if (mem.write_resp.try_read(resp)) i_resp += uint64_t(resp) + 1;
+  }
+#endif  // __SYNTHESIS__
+}
+
+// Element type of the read data channel of an async_mmap.
+template <typename Mem>
+using word_t = typename std::decay<decltype(
+    std::declval<Mem&>().read_data.read(nullptr))>::type;
+
+// Reads `n` elements packed as `P` in words of `mem` starting from word
+// `offset`, and writes them to `out`, each accumulated to the previous
+// elements if `is_delta`.
+template <typename P, bool is_delta, typename T, typename Mem>
+void decode_to_stream(Mem& mem, ostream<T>& out, uint64_t n, uint64_t offset,
+                      T base) {
+#pragma HLS inline
+  using Word = word_t<Mem>;
+  constexpr int N = ::tapa::widthof<Word>() / ::tapa::widthof<P>();
+  static_assert(N > 0, "packed element is wider than the word");
+  const uint64_t n_words = (n + N - 1) / N;
+  T acc = base;
+#ifdef __SYNTHESIS__
+  vec_t<P, N> lanes;
+  int lane = N;  // Next lane of `lanes` to write; N if none is left.
+  for (uint64_t i_req = 0, i_resp = 0; i_resp < n;) {
+#pragma HLS pipeline II = 1
+    if (i_req < n_words && !mem.read_addr.full()) {
+      mem.read_addr.write(offset + i_req);
+      ++i_req;
+    }
+    Word word;
+    if (lane == N && mem.read_data.try_read(word)) {
+      lanes = unpack<P, N>(word);
+      lane = 0;
+    }
+    if (lane < N && !out.full()) {
+      const T elem = is_delta ? T(acc + T(lanes[lane])) : T(lanes[lane]);
+      out.write(elem);
+      acc = elem;
+      ++lane;
+      ++i_resp;
+    }
+  }
+#else   // __SYNTHESIS__
+  // Each word is decoded at once and its elements are written in a batch.
+  strided_addrs<typename Mem::addr_t> addrs(offset, 1);
+  batch_relay<typename Mem::addr_t> req;
+  T elems[N];
+  size_t begin = 0;
+  size_t end = 0;
+  for (uint64_t i_req = 0, i_resp = 0; i_resp < n;) {
+    i_req += req.step(addrs, mem.read_addr, n_words - i_req);
+    Word word;
+    if (begin == end && mem.read_data.try_read(word)) {
+      const vec_t<P, N> lanes = unpack<P, N>(word);
+      begin = 0;
+      end = std::min<uint64_t>(N, n - i_resp);
+      for (size_t i = 0; i < end; ++i) {
+        elems[i] = acc = is_delta ? T(acc + T(lanes[i])) : T(lanes[i]);
+      }
+    }
+    const size_t written = out.try_write_burst(elems + begin, end - begin);
+    begin += written;
+    i_resp += written;
+  }
+#endif  // __SYNTHESIS__
+}
+
+}  // namespace internal
+
+/// Reads elements @c offset, ..., <tt>offset + n - 1</tt> of @c mem and writes
+/// them to @c out in order.
+///
+/// This and the other transfer functions below run one pipelined loop at II=1
+/// that keeps as many requests in flight as @c mem accepts, so they saturate
+/// the memory bandwidth available to @c mem. They never block on @c mem and
+/// the streams at the same time, so they do not deadlock as long as the
+/// streams make progress. In simulation, elements are moved in batches.
+///
+/// They are not tasks themselves; call them in a lower-level task, e.g.,
+///
+/// @code{.cpp}
+/// void Load(tapa::async_mmap<float>& mem, tapa::ostream<float>& out,
+///           uint64_t n) {
+///   tapa::mem_to_stream(mem, out, n);
+/// }
+/// @endcode
+///
+/// @param mem    An @c async_mmap or @c cached_async_mmap.
+/// @param out    Stream to write the elements to.
+/// @param n      Number of elements.
+/// @param offset Index of the first element.
+template <typename T, typename Mem>
+inline void mem_to_stream(Mem& mem, ostream<T>& out, uint64_t n,
+                          uint64_t offset = 0) {
+#pragma HLS inline
+  internal::strided_addrs<typename Mem::addr_t> addrs(offset, 1);
+  internal::read_to_stream(mem, addrs, out, n, n);
+}
+
+/// Reads elements @c offset, <tt>offset + stride</tt>, ...,
+/// <tt>offset + (n - 1) * stride</tt> of @c mem and writes them to @c out in
+/// order. See @c mem_to_stream.
+template <typename T, typename Mem>
+inline void strided_mem_to_stream(Mem& mem, ostream<T>& out, uint64_t n,
+                                  uint64_t offset, int64_t stride) {
+#pragma HLS inline
+  internal::strided_addrs<typename Mem::addr_t> addrs(offset, stride);
+  internal::read_to_stream(mem, addrs, out, n, n);
+}
+
+/// Reads a tile of @c rows x @c cols elements of @c mem, whose row @c r starts
+/// at element <tt>offset + r * stride</tt>, and writes them to @c out in
+/// row-major order. See @c mem_to_stream.
+///
+/// Each row is requested as explicit bursts of up to 256 elements (see
+/// @c async_mmap::burst_addr), so bursts never break within a row, and the
+/// address logic is a counter per burst rather than per element. In
+/// simulation, each burst is copied at once. Like explicit bursts, this is not
+/// supported by @c tapa::cached_async_mmap, by ports widened by
+/// <tt>--async-mmap-bus-width</tt>, or with
+/// <tt>--async-mmap-write-combine-window</tt>.
+template <typename T, typename Mem>
+inline void tile_mem_to_stream(Mem& mem, ostream<T>& out, uint64_t rows,
+                               uint64_t cols, uint64_t offset,
+                               int64_t stride) {
+#pragma HLS inline
+  internal::row_bursts<typename Mem::addr_t> addrs(offset, cols, stride);
+  internal::read_to_stream(mem, addrs, out, rows * cols,
+                           addrs.count(rows, cols));
+}
+
+/// Reads @c n indices from @c indices, and writes the elements of @c mem at
+/// these indices to @c out in order. See @c mem_to_stream.
+template <typename T, typename Mem>
+inline void gather_mem_to_stream(Mem& mem,
+                                 istream<typename Mem::addr_t>& indices,
+                                 ostream<T>& out, uint64_t n) {
+#pragma HLS inline
+  internal::indexed_addrs<typename Mem::addr_t> addrs(indices);
+  internal::read_to_stream(mem, addrs, out, n, n);
+}
+
+/// Reads @c n elements bit-packed by @c tapa::bit_pack in the words of
+/// @c mem, starting from word @c offset, and writes them to @c out in order.
+/// See @c mem_to_stream.
+///
+/// Each word holds <tt>W / widthof<P>()</tt> elements, where @c W is the width
+/// of the word, so that narrow elements, e.g., indices known to fit in 16 bits,
+/// take proportionally less memory bandwidth. The word is unpacked by wiring,
+/// and one element is written to @c out per cycle.
+///
+/// @tparam P     Type of the packed elements, e.g., @c ap_uint<16>, which is
+///               converted to @c T after unpacking.
+template <typename P, typename T, typename Mem>
+inline void unpack_mem_to_stream(Mem& mem, ostream<T>& out, uint64_t n,
+                                 uint64_t offset = 0) {
+#pragma HLS inline
+  internal::decode_to_stream<P, /*is_delta=*/false>(mem, out, n, offset, T());
+}
+
+/// Reads @c n elements delta-encoded by @c tapa::delta_pack in the words of
+/// @c mem, starting from word @c offset, and writes them to @c out in order.
+/// Element @c i is @c base plus the deltas up to @c i. See
+/// @c unpack_mem_to_stream.
+///
+/// This suits sorted indices, e.g., the column indices of a row of a sparse
+/// matrix, whose deltas are much narrower than the indices themselves.
+///
+/// @tparam P     Type of the packed deltas, which should be signed if the
+///               elements are not sorted.
+template <typename P, typename T, typename Mem>
+inline void delta_mem_to_stream(Mem& mem, ostream<T>& out, uint64_t n,
+                                uint64_t offset = 0, T base = T()) {
+#pragma HLS inline
+  internal::decode_to_stream<P, /*is_delta=*/true>(mem, out, n, offset, base);
+}
+
+/// Reads @c n elements from @c in and writes them to elements @c offset, ...,
+/// <tt>offset + n - 1</tt> of @c mem. Returns once all writes are acknowledged.
+/// See @c mem_to_stream.
+template <typename T, typename Mem>
+inline void stream_to_mem(istream<T>& in, Mem& mem, uint64_t n,
+                          uint64_t offset = 0) {
+#pragma HLS inline
+  internal::strided_addrs<typename Mem::addr_t> addrs(offset, 1);
+  internal::write_from_stream(in, addrs, mem, n, n);
+}
+
+/// Reads @c n elements from @c in and writes them to elements @c offset,
+/// <tt>offset + stride</tt>, ..., <tt>offset + (n - 1) * stride</tt> of
+/// @c mem. See @c stream_to_mem.
+template <typename T, typename Mem>
+inline void strided_stream_to_mem(istream<T>& in, Mem& mem, uint64_t n,
+                                  uint64_t offset, int64_t stride) {
+#pragma HLS inline
+  internal::strided_addrs<typename Mem::addr_t> addrs(offset, stride);
+  internal::write_from_stream(in, addrs, mem, n, n);
+}
+
+/// Reads <tt>rows * cols</tt> elements from @c in and writes them in row-major
+/// order to a tile of @c rows x @c cols elements of @c mem, whose row @c r
+/// starts at element <tt>offset + r * stride</tt>. See @c stream_to_mem and
+/// @c tile_mem_to_stream.
+template <typename T, typename Mem>
+inline void tile_stream_to_mem(istream<T>& in, Mem& mem, uint64_t rows,
+                               uint64_t cols, uint64_t offset,
+                               int64_t stride) {
+#pragma HLS inline
+  internal::row_bursts<typename Mem::addr_t> addrs(offset, cols, stride);
+  internal::write_from_stream(in, addrs, mem, rows * cols,
+                              addrs.count(rows, cols));
+}
+
+/// Reads @c n elements from @c in and @c n indices from @c indices, and writes
+/// each element to @c mem at its index. See @c stream_to_mem.
+template <typename T, typename Mem>
+inline void scatter_stream_to_mem(istream<typename Mem::addr_t>& indices,
+                                  istream<T>& in, Mem& mem, uint64_t n) {
+#pragma HLS inline
+  internal::indexed_addrs<typename Mem::addr_t> addrs(indices);
+  internal::write_from_stream(in, addrs, mem, n, n);
+}
+
+#ifndef __SYNTHESIS__
+
+/// Packs @c n elements as @c P in words of type @c Word on the host, to be
+/// read by @c tapa::unpack_mem_to_stream. The last word is padded with zeros.
+///
+/// @tparam Word  Type of the words of the memory, e.g., @c ap_uint<512>.
+/// @tparam P     Type of the packed elements; each element must fit in it.
+template <typename Word, typename P, typename T>
+std::vector<Word> bit_pack(const T* elems, size_t n) {
+  constexpr int N = widthof<Word>() / widthof<P>();
+  static_assert(N > 0, "packed element is wider than the word");
+  std::vector<Word> words;
+  words.reserve((n + N - 1) / N);
+  for (size_t i = 0; i < n; i += N) {
+    vec_t<P, N> lanes;
+    for (int j = 0; j < N; ++j) {
+      const T elem = i + j < n ? elems[i + j] : T();
+      lanes.set(j, P(elem));
+      CHECK(T(lanes[j]) == elem)
+          << "element " << i + j << " does not fit in " << widthof<P>()
+          << " bits";
+    }
+    words.push_back(pack<Word>(lanes));
+  }
+  return words;
+}
+
+/// Packs the deltas between @c n consecutive elements as @c P in words of type
+/// @c Word on the host, to be read by @c tapa::delta_mem_to_stream with the
+/// same @c base. See @c tapa::bit_pack.
+template <typename Word, typename P, typename T>
+std::vector<Word> delta_pack(const T* elems, size_t n, T base = T()) {
+  std::vector<T> deltas(n);
+  for (size_t i = 0; i < n; ++i) {
+    deltas[i] = T(elems[i] - (i > 0 ? elems[i - 1] : base));
+  }
+  return bit_pack<Word, P>(deltas.data(), n);
+}
+
+#endif  // __SYNTHESIS__
+
+}  // namespace tapa
+
+#endif  // TAPA_TRANSFER_H_
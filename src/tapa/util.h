@@ -12,6 +12,12 @@ namespace tapa {
 constexpr int join = 0;
 constexpr int detach = -1;
 
+// Runs a joined child on its own thread in software simulation, e.g.,
+// `invoke<tapa::join | tapa::dedicated_thread>`. This is useful for tasks that
+// compute for a long time between channel operations. Ignored in synthesis and
+// for detached children.
+constexpr int dedicated_thread = 1;
+
 namespace internal {
 
 template <typename T, int width = T::width>
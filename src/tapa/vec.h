@@ -10,11 +10,349 @@
 #include <array>
 #include <functional>
 #include <ostream>
+#include <type_traits>
+#include <utility>
 
 #include "tapa/util.h"
 
+// `vec_t` is usable in constant expressions if mutating `std::array` is
+// (C++17), and if the host SIMD path can be skipped in constant evaluation.
+#if __cplusplus >= 201703L && defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define TAPA_VEC_CONSTEXPR constexpr
+#endif
+#endif
+#ifndef TAPA_VEC_CONSTEXPR
+#define TAPA_VEC_CONSTEXPR
+#define TAPA_VEC_CONSTEXPR_DISABLED
+#endif
+
 namespace tapa {
 
+namespace internal {
+
+// Returns `lhs + rhs`, or `lhs - rhs` if `is_sub`, saturated to the range of a
+// `bits`-bit integer that is signed if `is_signed`. Operands and the result
+// are the bits as `U`, which is the unsigned integer `E` or a vector of them,
+// and overflows are detected with bitwise operations only, so that the same
+// code applies to each lane of a vector.
+template <bool is_signed, bool is_sub, int bits, typename E, typename U>
+inline U saturate(const U& lhs, const U& rhs) {
+#pragma HLS inline
+  const U result = U(is_sub ? lhs - rhs : lhs + rhs);
+  const U zero = U(result ^ result);
+  U overflow;  // 1 if overflown, 0 otherwise
+  U saturated;
+  if (is_signed) {
+    // Overflown if the operands of the addition have the same sign, which
+    // differs from that of the result.
+    overflow = U((is_sub ? (lhs ^ rhs) & (lhs ^ result)
+                         : (lhs ^ result) & (rhs ^ result)) >>
+                 (bits - 1));
+    // The maximum if `lhs` is non-negative, or the minimum otherwise.
+    saturated = U((lhs >> (bits - 1)) + E((E(1) << (bits - 1)) - E(1)));
+  } else {
+    // Carry or borrow out of the most significant bit.
+    overflow = U((is_sub ? (~lhs & rhs) | (~(lhs ^ rhs) & result)
+                         : (lhs & rhs) | ((lhs | rhs) & ~result)) >>
+                 (bits - 1));
+    saturated = U(zero + E(is_sub ? E(0) : E(~E(0))));
+  }
+  const U mask = U(zero - overflow);
+  return U((result & ~mask) | (saturated & mask));
+}
+
+#ifndef __SYNTHESIS__
+
+// Returns whether the call is evaluated at compile time, in which case the host
+// SIMD path is not an option.
+constexpr bool is_constant_evaluated() {
+#ifdef TAPA_VEC_CONSTEXPR_DISABLED
+  return false;
+#else   // TAPA_VEC_CONSTEXPR_DISABLED
+  return __builtin_is_constant_evaluated();
+#endif  // TAPA_VEC_CONSTEXPR_DISABLED
+}
+
+// Element-wise operations of `vec_t<T, N>` on the host using GCC vector
+// extensions, which compile to the SIMD instructions of the target, e.g., SSE,
+// AVX2, AVX-512, or NEON. This is used only if `N` is a power of 2 and `T` is a
+// float or integer type.
+template <typename T, int N, typename = void>
+struct vec_simd {
+  template <typename Op>
+  static constexpr bool supports() {
+    return false;
+  }
+  template <typename Op>
+  static constexpr bool reduces() {
+    return false;
+  }
+  template <typename I>
+  static constexpr bool gathers() {
+    return false;
+  }
+  template <typename Compare>
+  static constexpr bool sorts() {
+    return false;
+  }
+  static constexpr bool saturates() { return false; }
+};
+
+template <typename T, int N>
+struct vec_simd<
+    T, N,
+    typename std::enable_if<
+        (std::is_same<T, float>::value || std::is_same<T, double>::value ||
+         (std::is_integral<T>::value && !std::is_same<T, bool>::value)) &&
+        N >= 2 && (N & (N - 1)) == 0 && sizeof(T) * N >= 8 &&
+        sizeof(T) * N <= 128>::type> {
+  // Integers are operated on as unsigned so that they wrap around like scalars
+  // narrowed back to `T`.
+  using elem_type = typename std::conditional<std::is_integral<T>::value,
+                                              std::make_unsigned<T>,
+                                              std::common_type<T>>::type::type;
+
+  // Vectors are no wider than SIMD registers, or they are spilled to memory
+  // and passing them across functions changes the ABI.
+#if defined(__AVX512F__)
+  static constexpr size_t kMaxBytes = 64;
+#elif defined(__AVX__)
+  static constexpr size_t kMaxBytes = 32;
+#else
+  static constexpr size_t kMaxBytes = 16;
+#endif
+  static constexpr size_t kBytes = std::min(sizeof(T) * N, kMaxBytes);
+  static constexpr int kLength = kBytes / sizeof(T);
+  typedef elem_type type __attribute__((vector_size(kBytes)));
+
+  template <typename Op>
+  static constexpr bool supports() {
+    return std::is_same<Op, std::plus<>>::value ||
+           std::is_same<Op, std::minus<>>::value ||
+           std::is_same<Op, std::multiplies<>>::value ||
+           (std::is_floating_point<T>::value
+                ? std::is_same<Op, std::divides<>>::value
+                : std::is_same<Op, std::bit_and<>>::value ||
+                      std::is_same<Op, std::bit_or<>>::value ||
+                      std::is_same<Op, std::bit_xor<>>::value);
+  }
+
+  // `std::plus<>` for `std::plus<T>`, etc.
+  template <typename Op>
+  struct transparent_of;
+  template <template <typename> class Op, typename U>
+  struct transparent_of<Op<U>> {
+    using type = Op<void>;
+  };
+  template <typename Op>
+  using transparent = typename transparent_of<Op>::type;
+
+  // Returns `lhs op rhs` element-wise.
+  template <typename Op>
+  static type combine(const type& lhs, const type& rhs) {
+    if constexpr (std::is_same<Op, std::plus<>>::value) {
+      return lhs + rhs;
+    } else if constexpr (std::is_same<Op, std::minus<>>::value) {
+      return lhs - rhs;
+    } else if constexpr (std::is_same<Op, std::multiplies<>>::value) {
+      return lhs * rhs;
+    } else if constexpr (std::is_same<Op, std::divides<>>::value) {
+      return lhs / rhs;
+    } else if constexpr (std::is_same<Op, std::bit_and<>>::value) {
+      return lhs & rhs;
+    } else if constexpr (std::is_same<Op, std::bit_or<>>::value) {
+      return lhs | rhs;
+    } else {
+      static_assert(std::is_same<Op, std::bit_xor<>>::value, "unsupported");
+      return lhs ^ rhs;
+    }
+  }
+
+  // Sets `result` to `lhs op rhs` element-wise, where `rhs` points to a vector
+  // or is a scalar. `vec_t` may not be aligned to its size, e.g., if
+  // reinterpreted from a buffer of `T`.
+  template <typename Op, typename RHS>
+  static void apply(T* result, const T* lhs, const RHS& rhs) {
+    type rhs_vec;
+    if constexpr (!std::is_pointer<RHS>::value) {
+      for (int i = 0; i < kLength; ++i) rhs_vec[i] = rhs;
+    }
+#pragma GCC unroll 16
+    for (int i = 0; i < N; i += kLength) {
+      type lhs_vec;
+      std::memcpy(&lhs_vec, lhs + i, kBytes);
+      if constexpr (std::is_pointer<RHS>::value) {
+        std::memcpy(&rhs_vec, rhs + i, kBytes);
+      }
+      const type result_vec = combine<Op>(lhs_vec, rhs_vec);
+      std::memcpy(result + i, &result_vec, kBytes);
+    }
+  }
+
+  // Sets `result` to `lhs * rhs + addend` element-wise in a single pass, where
+  // `rhs` points to a vector or is a scalar. Products are rounded before being
+  // added, just like the scalar expression.
+  template <typename RHS>
+  static void multiply_add(T* result, const T* lhs, const RHS& rhs,
+                           const T* addend) {
+    type rhs_vec;
+    if constexpr (!std::is_pointer<RHS>::value) {
+      for (int i = 0; i < kLength; ++i) rhs_vec[i] = rhs;
+    }
+#pragma GCC unroll 16
+    for (int i = 0; i < N; i += kLength) {
+      type lhs_vec;
+      type addend_vec;
+      std::memcpy(&lhs_vec, lhs + i, kBytes);
+      std::memcpy(&addend_vec, addend + i, kBytes);
+      if constexpr (std::is_pointer<RHS>::value) {
+        std::memcpy(&rhs_vec, rhs + i, kBytes);
+      }
+      const type result_vec = lhs_vec * rhs_vec + addend_vec;
+      std::memcpy(result + i, &result_vec, kBytes);
+    }
+  }
+
+  static constexpr bool saturates() { return std::is_integral<T>::value; }
+
+  // Sets `result` to `lhs + rhs`, or `lhs - rhs` if `is_sub`, element-wise
+  // with saturation.
+  template <bool is_sub>
+  static void saturate(T* result, const T* lhs, const T* rhs) {
+#pragma GCC unroll 16
+    for (int i = 0; i < N; i += kLength) {
+      type lhs_vec;
+      type rhs_vec;
+      std::memcpy(&lhs_vec, lhs + i, kBytes);
+      std::memcpy(&rhs_vec, rhs + i, kBytes);
+      const type result_vec =
+          internal::saturate<std::is_signed<T>::value, is_sub,
+                             sizeof(T) * CHAR_BIT, elem_type>(lhs_vec,
+                                                              rhs_vec);
+      std::memcpy(result + i, &result_vec, kBytes);
+    }
+  }
+
+  // Returns whether `reduce<Op>` gives the same result as a tree of scalars
+  // reduced with `Op<T>`, which requires an associative and commutative `Op`.
+  template <typename Op>
+  static constexpr bool reduces() {
+    return std::is_integral<T>::value &&
+           (std::is_same<Op, std::plus<T>>::value ||
+            std::is_same<Op, std::multiplies<T>>::value ||
+            std::is_same<Op, std::bit_and<T>>::value ||
+            std::is_same<Op, std::bit_or<T>>::value ||
+            std::is_same<Op, std::bit_xor<T>>::value);
+  }
+
+  // Returns whether `gather` is supported with indices of type `I`, which
+  // requires a single vector and a variable permutation (GCC only).
+  template <typename I>
+  static constexpr bool gathers() {
+#if defined(__GNUC__) && !defined(__clang__)
+    return std::is_integral<I>::value && kLength == N;
+#else
+    return false;
+#endif
+  }
+
+  // Returns whether `sort` is supported with `Compare`, which requires a
+  // single vector and constant permutations (GCC only).
+  template <typename Compare>
+  static constexpr bool sorts() {
+#if defined(__GNUC__) && !defined(__clang__)
+    return kLength == N && (std::is_same<Compare, std::less<T>>::value ||
+                            std::is_same<Compare, std::greater<T>>::value);
+#else
+    return false;
+#endif
+  }
+
+#if defined(__GNUC__) && !defined(__clang__)
+  // Vector of unsigned integers as wide as `T`, for permutations and masks.
+  using index_type = typename std::conditional<
+      sizeof(T) == 1, uint8_t,
+      typename std::conditional<
+          sizeof(T) == 2, uint16_t,
+          typename std::conditional<sizeof(T) == 4, uint32_t,
+                                    uint64_t>::type>::type>::type;
+  typedef index_type index_vec_type __attribute__((vector_size(kBytes)));
+
+  // Sets each `result[i]` to `vec[idx[i]]`.
+  template <typename I>
+  static void gather(T* result, const T* vec, const I* idx) {
+    type vec_vec;
+    index_vec_type idx_vec;
+    std::memcpy(&vec_vec, vec, kBytes);
+    for (int i = 0; i < N; ++i) idx_vec[i] = idx[i];
+    const type result_vec = __builtin_shuffle(vec_vec, idx_vec);
+    std::memcpy(result, &result_vec, kBytes);
+  }
+
+  // Sorts `data` in place with the same bitonic network as `tapa::sort`, each
+  // stage of which is a shuffle, a min, a max, and a select of whole vectors.
+  // Elements are compared as `T`, not as `elem_type`.
+  template <bool is_descending>
+  static void sort(T* data) {
+    typedef T value_vec_type __attribute__((vector_size(kBytes)));
+    value_vec_type vec;
+    std::memcpy(&vec, data, kBytes);
+    for (int k = 2; k <= N; k *= 2) {
+      for (int j = k / 2; j > 0; j /= 2) {
+        index_vec_type partner_idx;
+        index_vec_type is_min;  // whether lane `i` keeps the lesser element
+        for (int i = 0; i < N; ++i) {
+          partner_idx[i] = i ^ j;
+          is_min[i] = ((i & j) == 0) == ((i & k) == 0) ? index_type(-1) : 0;
+        }
+        if (is_descending) is_min = ~is_min;
+        const value_vec_type partner = __builtin_shuffle(vec, partner_idx);
+        const value_vec_type min_vec = vec < partner ? vec : partner;
+        const value_vec_type max_vec = vec < partner ? partner : vec;
+        vec = is_min != 0 ? min_vec : max_vec;
+      }
+    }
+    std::memcpy(data, &vec, kBytes);
+  }
+#endif
+
+  // Reduces all elements at `data` with `Op`, e.g., `std::plus<T>`, whose
+  // transparent version is used on the vectors.
+  template <typename Op>
+  static T reduce(const T* data) {
+    type acc;
+    std::memcpy(&acc, data, kBytes);
+#pragma GCC unroll 16
+    for (int i = kLength; i < N; i += kLength) {
+      type vec;
+      std::memcpy(&vec, data + i, kBytes);
+      acc = combine<transparent<Op>>(acc, vec);
+    }
+    elem_type lanes[kLength];
+    std::memcpy(lanes, &acc, kBytes);
+    for (int n = kLength / 2; n > 0; n /= 2) {
+      for (int i = 0; i < n; ++i) {
+        lanes[i] = transparent<Op>()(lanes[i], lanes[i + n]);
+      }
+    }
+    return static_cast<T>(lanes[0]);
+  }
+};
+
+#endif  // __SYNTHESIS__
+
+}  // namespace internal
+
+#ifdef __SYNTHESIS__
+#define TAPA_VEC_SIMD(func, result, rhs)
+#else  // __SYNTHESIS__
+#define TAPA_VEC_SIMD(func, result, rhs)    \
+  if (!internal::is_constant_evaluated() && \
+      simd_apply<func>(result, *this, rhs)) \
+    return result
+#endif  // __SYNTHESIS__
+
 template <typename T, int N>
 struct vec_t : protected std::array<T, N> {
  private:
@@ -44,7 +382,7 @@ struct vec_t : protected std::array<T, N> {
 #pragma HLS aggregate variable = this bit
     return base_type::operator[](pos);
   }
-  reference operator[](size_type pos) {
+  TAPA_VEC_CONSTEXPR reference operator[](size_type pos) {
 #pragma HLS inline
 #pragma HLS aggregate variable = this bit
     return base_type::operator[](pos);
@@ -53,7 +391,7 @@ struct vec_t : protected std::array<T, N> {
 #pragma HLS inline
     return (*this)[pos];
   }
-  void set(size_type pos, const T& value) {
+  TAPA_VEC_CONSTEXPR void set(size_type pos, const T& value) {
 #pragma HLS inline
     (*this)[pos] = value;
   }
@@ -63,14 +401,25 @@ struct vec_t : protected std::array<T, N> {
   using base_type::operator=;
 
   // constructors from base_type
-  explicit vec_t(const base_type& other) : base_type(other) {}
-  explicit vec_t(base_type&& other) : base_type(other) {}
+  constexpr explicit vec_t(const base_type& other) : base_type(other) {}
+  constexpr explicit vec_t(base_type&& other) : base_type(other) {}
+
+  // constructor from all N elements, e.g., vec_t<float, 3>{0.25, 0.5, 0.25}
+  template <typename... Args,
+            typename = typename std::enable_if<sizeof...(Args) == N &&
+                                               (N > 1)>::type>
+  constexpr explicit vec_t(const Args&... args)
+      : base_type{{static_cast<T>(args)...}} {}
+
+  // default constructor, which leaves the elements uninitialized (use `{}` to
+  // zero them, e.g., in constant expressions)
+  vec_t() = default;
 
   // static cast to vec_t of another type
   template <typename U>
-  explicit operator vec_t<U, N>() const {
+  TAPA_VEC_CONSTEXPR explicit operator vec_t<U, N>() const {
 #pragma HLS inline
-    vec_t<U, N> result;
+    vec_t<U, N> result{};
     for (size_type i = 0; i < N; ++i) {
       result.set(i, static_cast<U>(get(i)));
     }
@@ -78,13 +427,13 @@ struct vec_t : protected std::array<T, N> {
   }
 
   // all-element setter
-  void set(T val) {
+  TAPA_VEC_CONSTEXPR void set(T val) {
 #pragma HLS inline
     *this = val;
   }
 
   // all-element assignment operator
-  vec_t& operator=(T val) {
+  TAPA_VEC_CONSTEXPR vec_t& operator=(T val) {
 #pragma HLS inline
     for (size_type i = 0; i < N; ++i) {
 #pragma HLS unroll
@@ -94,46 +443,48 @@ struct vec_t : protected std::array<T, N> {
   }
 
 // assignment operators
-#define DEFINE_OP(op)                                    \
-  template <typename T2>                                 \
-  vec_t<T, N>& operator op##=(const vec_t<T2, N>& rhs) { \
-    _Pragma("HLS inline");                               \
-    for (size_type i = 0; i < N; ++i) {                  \
-      _Pragma("HLS unroll");                             \
-      set(i, get(i) op rhs[i]);                          \
-    }                                                    \
-    return *this;                                        \
-  }                                                      \
-  template <typename T2>                                 \
-  vec_t<T, N>& operator op##=(const T2& rhs) {           \
-    _Pragma("HLS inline");                               \
-    for (size_type i = 0; i < N; ++i) {                  \
-      _Pragma("HLS unroll");                             \
-      set(i, get(i) op rhs);                             \
-    }                                                    \
-    return *this;                                        \
+#define DEFINE_OP(op, func)                                                 \
+  template <typename T2>                                                    \
+  TAPA_VEC_CONSTEXPR vec_t<T, N>& operator op##=(const vec_t<T2, N>& rhs) { \
+    _Pragma("HLS inline");                                                  \
+    TAPA_VEC_SIMD(func, *this, rhs);                                        \
+    for (size_type i = 0; i < N; ++i) {                                     \
+      _Pragma("HLS unroll");                                                \
+      set(i, get(i) op rhs[i]);                                             \
+    }                                                                       \
+    return *this;                                                           \
+  }                                                                         \
+  template <typename T2>                                                    \
+  TAPA_VEC_CONSTEXPR vec_t<T, N>& operator op##=(const T2& rhs) {           \
+    _Pragma("HLS inline");                                                  \
+    TAPA_VEC_SIMD(func, *this, rhs);                                        \
+    for (size_type i = 0; i < N; ++i) {                                     \
+      _Pragma("HLS unroll");                                                \
+      set(i, get(i) op rhs);                                                \
+    }                                                                       \
+    return *this;                                                           \
   }
-  DEFINE_OP(+)
-  DEFINE_OP(-)
-  DEFINE_OP(*)
-  DEFINE_OP(/)
-  DEFINE_OP(%)
-  DEFINE_OP(&)
-  DEFINE_OP(|)
-  DEFINE_OP(^)
-  DEFINE_OP(<<)
-  DEFINE_OP(>>)
+  DEFINE_OP(+, std::plus<>)
+  DEFINE_OP(-, std::minus<>)
+  DEFINE_OP(*, std::multiplies<>)
+  DEFINE_OP(/, std::divides<>)
+  DEFINE_OP(%, void)
+  DEFINE_OP(&, std::bit_and<>)
+  DEFINE_OP(|, std::bit_or<>)
+  DEFINE_OP(^, std::bit_xor<>)
+  DEFINE_OP(<<, void)
+  DEFINE_OP(>>, void)
 #undef DEFINE_OP
 
 // unary arithemetic operators
-#define DEFINE_OP(op)                   \
-  vec_t<T, N> operator op() {           \
-    _Pragma("HLS inline");              \
-    for (size_type i = 0; i < N; ++i) { \
-      _Pragma("HLS unroll");            \
-      set(i, op get(i));                \
-    }                                   \
-    return *this;                       \
+#define DEFINE_OP(op)                            \
+  TAPA_VEC_CONSTEXPR vec_t<T, N> operator op() { \
+    _Pragma("HLS inline");                       \
+    for (size_type i = 0; i < N; ++i) {          \
+      _Pragma("HLS unroll");                     \
+      set(i, op get(i));                         \
+    }                                            \
+    return *this;                                \
   }
   DEFINE_OP(+)
   DEFINE_OP(-)
@@ -141,37 +492,39 @@ struct vec_t : protected std::array<T, N> {
 #undef DEFINE_OP
 
 // binary arithemetic operators
-#define DEFINE_OP(op)                                \
-  template <typename T2>                             \
-  vec_t<T, N> operator op(const vec_t<T2, N>& rhs) { \
-    _Pragma("HLS inline");                           \
-    vec_t<T, N> result;                              \
-    for (size_type i = 0; i < N; ++i) {              \
-      _Pragma("HLS unroll");                         \
-      result.set(i, get(i) op rhs[i]);               \
-    }                                                \
-    return result;                                   \
-  }                                                  \
-  template <typename T2>                             \
-  vec_t<T, N> operator op(const T2& rhs) {           \
-    _Pragma("HLS inline");                           \
-    vec_t<T, N> result;                              \
-    for (size_type i = 0; i < N; ++i) {              \
-      _Pragma("HLS unroll");                         \
-      result.set(i, get(i) op rhs);                  \
-    }                                                \
-    return result;                                   \
+#define DEFINE_OP(op, func)                                                   \
+  template <typename T2>                                                      \
+  TAPA_VEC_CONSTEXPR vec_t<T, N> operator op(const vec_t<T2, N>& rhs) const { \
+    _Pragma("HLS inline");                                                    \
+    vec_t<T, N> result{};                                                     \
+    TAPA_VEC_SIMD(func, result, rhs);                                         \
+    for (size_type i = 0; i < N; ++i) {                                       \
+      _Pragma("HLS unroll");                                                  \
+      result.set(i, get(i) op rhs[i]);                                        \
+    }                                                                         \
+    return result;                                                            \
+  }                                                                           \
+  template <typename T2>                                                      \
+  TAPA_VEC_CONSTEXPR vec_t<T, N> operator op(const T2& rhs) const {           \
+    _Pragma("HLS inline");                                                    \
+    vec_t<T, N> result{};                                                     \
+    TAPA_VEC_SIMD(func, result, rhs);                                         \
+    for (size_type i = 0; i < N; ++i) {                                       \
+      _Pragma("HLS unroll");                                                  \
+      result.set(i, get(i) op rhs);                                           \
+    }                                                                         \
+    return result;                                                            \
   }
-  DEFINE_OP(+)
-  DEFINE_OP(-)
-  DEFINE_OP(*)
-  DEFINE_OP(/)
-  DEFINE_OP(%)
-  DEFINE_OP(&)
-  DEFINE_OP(|)
-  DEFINE_OP(^)
-  DEFINE_OP(<<)
-  DEFINE_OP(>>)
+  DEFINE_OP(+, std::plus<>)
+  DEFINE_OP(-, std::minus<>)
+  DEFINE_OP(*, std::multiplies<>)
+  DEFINE_OP(/, std::divides<>)
+  DEFINE_OP(%, void)
+  DEFINE_OP(&, std::bit_and<>)
+  DEFINE_OP(|, std::bit_or<>)
+  DEFINE_OP(^, std::bit_xor<>)
+  DEFINE_OP(<<, void)
+  DEFINE_OP(>>, void)
 #undef DEFINE_OP
 
   // shift all elements by 1, put val at [N-1], and through away [0]
@@ -194,14 +547,51 @@ struct vec_t : protected std::array<T, N> {
     }
     return result;
   }
+
+#ifndef __SYNTHESIS__
+ private:
+  using simd = internal::vec_simd<T, N>;
+
+  // Sets `result` to `lhs op rhs` element-wise using SIMD instructions and
+  // returns true if `Op` is supported on `T` with the same results as the
+  // scalar loop.
+  template <typename Op, typename T2>
+  static bool simd_apply(vec_t& result, const vec_t& lhs,
+                         const vec_t<T2, N>& rhs) {
+    if constexpr (std::is_same<T, T2>::value &&
+                  simd::template supports<Op>()) {
+      simd::template apply<Op>(result.data(), lhs.data(), rhs.data());
+      return true;
+    }
+    return false;
+  }
+
+  // Same as above, but with a scalar `rhs`. An integer `rhs` is converted to
+  // `T` first, which does not change the results.
+  template <typename Op, typename T2>
+  static bool simd_apply(vec_t& result, const vec_t& lhs, const T2& rhs) {
+    if constexpr ((std::is_same<T, T2>::value ||
+                   std::is_integral<T2>::value) &&
+                  simd::template supports<Op>()) {
+      simd::template apply<Op>(
+          result.data(), lhs.data(),
+          static_cast<typename simd::elem_type>(static_cast<T>(rhs)));
+      return true;
+    }
+    return false;
+  }
+#endif  // __SYNTHESIS__
 };
 
+#undef TAPA_VEC_SIMD
+
 // return vec[begin:end]
 template <int begin, int end, typename T, int N>
-inline vec_t<T, end - begin> truncated(const vec_t<T, N>& vec) {
+inline TAPA_VEC_CONSTEXPR vec_t<T, end - begin> truncated(
+    const vec_t<T, N>& vec) {
   static_assert(begin >= 0, "cannot truncate before 0");
   static_assert(end <= N, "cannot truncate after N");
-  vec_t<T, end - begin> result;
+  vec_t<T, end - begin> result{};
 #pragma HLS inline
   for (int i = 0; i < end - begin; ++i) {
 #pragma HLS unroll
@@ -212,7 +602,7 @@ inline vec_t<T, end - begin> truncated(const vec_t<T, N>& vec) {
 
 // return vec[:length]
 template <int length, typename T, int N>
-inline vec_t<T, length> truncated(const vec_t<T, N>& vec) {
+inline TAPA_VEC_CONSTEXPR vec_t<T, length> truncated(const vec_t<T, N>& vec) {
 #pragma HLS inline
   return truncated<0, length>(vec);
 }
@@ -235,8 +625,9 @@ inline vec_t<T, length> truncated(const vec_t<T, N>& vec, int begin) {
 
 // return vec[:] + [val]
 template <typename T, int N>
-inline vec_t<T, N + 1> cat(const vec_t<T, N>& vec, const T& val) {
-  vec_t<T, N + 1> result;
+inline TAPA_VEC_CONSTEXPR vec_t<T, N + 1> cat(const vec_t<T, N>& vec,
+                                             const T& val) {
+  vec_t<T, N + 1> result{};
 #pragma HLS inline
   for (int i = 0; i < N; ++i) {
 #pragma HLS unroll
@@ -248,8 +639,9 @@ inline vec_t<T, N + 1> cat(const vec_t<T, N>& vec, const T& val) {
 
 // return [val] + vec[:]
 template <typename T, int N>
-inline vec_t<T, N + 1> cat(const T& val, const vec_t<T, N>& vec) {
-  vec_t<T, N + 1> result;
+inline TAPA_VEC_CONSTEXPR vec_t<T, N + 1> cat(const T& val,
+                                             const vec_t<T, N>& vec) {
+  vec_t<T, N + 1> result{};
 #pragma HLS inline
   result.set(0, val);
   for (int i = 0; i < N; ++i) {
@@ -261,8 +653,9 @@ inline vec_t<T, N + 1> cat(const T& val, const vec_t<T, N>& vec) {
 
 // return v1[:] + v2[:]
 template <typename T, int N1, int N2>
-inline vec_t<T, N1 + N2> cat(const vec_t<T, N1>& v1, const vec_t<T, N2>& v2) {
-  vec_t<T, N1 + N2> result;
+inline TAPA_VEC_CONSTEXPR vec_t<T, N1 + N2> cat(const vec_t<T, N1>& v1,
+                                               const vec_t<T, N2>& v2) {
+  vec_t<T, N1 + N2> result{};
 #pragma HLS inline
   for (int i = 0; i < N1; ++i) {
 #pragma HLS unroll
@@ -277,23 +670,109 @@ inline vec_t<T, N1 + N2> cat(const vec_t<T, N1>& v1, const vec_t<T, N2>& v2) {
 
 #if __cplusplus >= 201402L
 template <typename T, typename... Args>
-inline auto cat(T arg, Args... args) {
+inline TAPA_VEC_CONSTEXPR auto cat(T arg, Args... args) {
 #pragma HLS inline
   return cat(arg, cat(args...));
 }
 #endif  // __cplusplus >= 201402L
 
+namespace internal {
+
+constexpr bool lanes_in_range(int /*n*/) { return true; }
+
+template <typename... Ints>
+constexpr bool lanes_in_range(int n, int lane, Ints... lanes) {
+  return lane >= 0 && lane < n && lanes_in_range(n, lanes...);
+}
+
+}  // namespace internal
+
+// return {vec[idx[0]], vec[idx[1]], ...}, which is pure wiring in hardware
+template <int... idx, typename T, int N>
+inline vec_t<T, sizeof...(idx)> shuffle(const vec_t<T, N>& vec) {
+  static_assert(internal::lanes_in_range(N, idx...), "lane out of range");
+  constexpr int indices[] = {idx...};
+  vec_t<T, sizeof...(idx)> result;
+#pragma HLS inline
+  for (int i = 0; i < int(sizeof...(idx)); ++i) {
+#pragma HLS unroll
+    result.set(i, vec[indices[i]]);
+  }
+  return result;
+}
+
+// return vec[k:] + vec[:k]; vec[N+k:] + vec[:N+k] if k is negative
+template <int k, typename T, int N>
+inline vec_t<T, N> rotate(const vec_t<T, N>& vec) {
+  constexpr int shift = (k % N + N) % N;
+  vec_t<T, N> result;
+#pragma HLS inline
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i, vec[(i + shift) % N]);
+  }
+  return result;
+}
+
+// return vec with each vec[i] swapped with vec[i ^ stride], as in a butterfly
+// stage of a stride-`stride` network
+template <int stride, typename T, int N>
+inline vec_t<T, N> butterfly(const vec_t<T, N>& vec) {
+  static_assert(stride > 0 && (stride & (stride - 1)) == 0,
+                "stride must be a power of 2");
+  static_assert(N % (stride * 2) == 0, "N must be a multiple of 2 * stride");
+  vec_t<T, N> result;
+#pragma HLS inline
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i, vec[i ^ stride]);
+  }
+  return result;
+}
+
+// return {vec[idx[0]], vec[idx[1]], ...}; each idx[i] must be in [0, N)
+template <typename T, int N, typename I>
+inline vec_t<T, N> gather(const vec_t<T, N>& vec, const vec_t<I, N>& idx) {
+  vec_t<T, N> result;
+#pragma HLS inline
+#ifndef __SYNTHESIS__
+  if constexpr (internal::vec_simd<T, N>::template gathers<I>()) {
+    internal::vec_simd<T, N>::gather(&result[0], &vec[0], &idx[0]);
+    return result;
+  }
+#endif  // __SYNTHESIS__
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i, vec[idx[i]]);
+  }
+  return result;
+}
+
+// return {mask[0] ? lhs[0] : rhs[0], mask[1] ? lhs[1] : rhs[1], ...}
+template <typename T, int N, typename M>
+inline vec_t<T, N> select(const vec_t<M, N>& mask, const vec_t<T, N>& lhs,
+                          const vec_t<T, N>& rhs) {
+  vec_t<T, N> result;
+#pragma HLS inline
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i, mask[i] ? lhs[i] : rhs[i]);
+  }
+  return result;
+}
+
 // binary arithemetic operators, vector on the right-hand side
-#define DEFINE_OP(op)                                              \
-  template <typename T, int N, typename T2>                        \
-  vec_t<T, N> operator op(const T2& lhs, const vec_t<T, N>& rhs) { \
-    _Pragma("HLS inline");                                         \
-    vec_t<T, N> result;                                            \
-    for (int i = 0; i < N; ++i) {                                  \
-      _Pragma("HLS unroll");                                       \
-      result.set(i, lhs op rhs[i]);                                \
-    }                                                              \
-    return result;                                                 \
+#define DEFINE_OP(op)                                                  \
+  template <typename T, int N, typename T2>                            \
+  TAPA_VEC_CONSTEXPR vec_t<T, N> operator op(const T2& lhs,            \
+                                             const vec_t<T, N>& rhs) { \
+    _Pragma("HLS inline");                                             \
+    vec_t<T, N> result{};                                              \
+    for (int i = 0; i < N; ++i) {                                      \
+      _Pragma("HLS unroll");                                           \
+      result.set(i, lhs op rhs[i]);                                    \
+    }                                                                  \
+    return result;                                                     \
   }
 DEFINE_OP(+)
 DEFINE_OP(-)
@@ -308,9 +787,9 @@ DEFINE_OP(>>)
 #undef DEFINE_OP
 
 template <int N, typename T>
-vec_t<T, N> make_vec(T val) {
+TAPA_VEC_CONSTEXPR vec_t<T, N> make_vec(T val) {
 #pragma HLS inline
-  vec_t<T, N> result;
+  vec_t<T, N> result{};
   result.set(val);
   return result;
 }
@@ -359,22 +838,439 @@ DEFINE_FUNC(max)
 DEFINE_FUNC(min)
 #undef DEFINE_FUNC
 
-// reduction operation functions
-#define DEFINE_FUNC(func, op)                                             \
-  template <typename T>                                                   \
-  T func(const vec_t<T, 1>& vec) {                                        \
-    _Pragma("HLS inline");                                                \
-    return vec[0];                                                        \
-  }                                                                       \
-  template <typename T, int N>                                            \
-  T func(const vec_t<T, N>& vec) {                                        \
-    _Pragma("HLS inline");                                                \
-    return func(truncated<N / 2>(vec)) op func(truncated<N / 2, N>(vec)); \
-  }
-DEFINE_FUNC(sum, +)
-DEFINE_FUNC(product, *)
+namespace internal {
+
+template <typename T>
+struct max_op {
+  T operator()(const T& lhs, const T& rhs) const {
+#pragma HLS inline
+    return std::max(lhs, rhs);
+  }
+};
+
+template <typename T>
+struct min_op {
+  T operator()(const T& lhs, const T& rhs) const {
+#pragma HLS inline
+    return std::min(lhs, rhs);
+  }
+};
+
+// Balanced trees over `vec[begin:begin+length]`, whose depth is logarithmic in
+// `length`. A tree is split into halves of `length / 2` and the rest.
+template <int begin, int length>
+struct vec_tree {
+  using lhs_tree = vec_tree<begin, length / 2>;
+  using rhs_tree = vec_tree<begin + length / 2, length - length / 2>;
+
+  template <typename T, int N, typename Op>
+  static T reduce(const vec_t<T, N>& vec, const Op& op) {
+#pragma HLS inline
+    return op(lhs_tree::reduce(vec, op), rhs_tree::reduce(vec, op));
+  }
+
+  // Returns the index of the first element that `comp` finds no other element
+  // should precede, e.g., the first maximum if `comp` is `std::less`.
+  template <typename T, int N, typename Compare>
+  static int arg(const vec_t<T, N>& vec, const Compare& comp, T& value) {
+#pragma HLS inline
+    T rhs_value;
+    const int lhs = lhs_tree::arg(vec, comp, value);
+    const int rhs = rhs_tree::arg(vec, comp, rhs_value);
+    if (comp(value, rhs_value)) {
+      value = rhs_value;
+      return rhs;
+    }
+    return lhs;
+  }
+};
+
+template <int begin>
+struct vec_tree<begin, 1> {
+  template <typename T, int N, typename Op>
+  static T reduce(const vec_t<T, N>& vec, const Op& /*op*/) {
+#pragma HLS inline
+    return vec[begin];
+  }
+
+  template <typename T, int N, typename Compare>
+  static int arg(const vec_t<T, N>& vec, const Compare& /*comp*/, T& value) {
+#pragma HLS inline
+    value = vec[begin];
+    return begin;
+  }
+};
+
+template <typename T, int N, typename Op>
+inline T reduce(const vec_t<T, N>& vec, const Op& op) {
+#pragma HLS inline
+#ifndef __SYNTHESIS__
+  if constexpr (vec_simd<T, N>::template reduces<Op>()) {
+    return vec_simd<T, N>::template reduce<Op>(&vec[0]);
+  }
+#endif  // __SYNTHESIS__
+  return vec_tree<0, N>::reduce(vec, op);
+}
+
+// Sets each `vec[i]` to `vec[0] op vec[1] op ... op vec[i]` in log2(N) levels
+// of `op`.
+template <typename T, int N, typename Op>
+inline vec_t<T, N> scan(vec_t<T, N> vec, const Op& op) {
+#pragma HLS inline
+  for (int stride = 1; stride < N; stride *= 2) {
+#pragma HLS unroll
+    // Descending so that `vec[i - stride]` is from the previous level.
+    for (int i = N - 1; i >= stride; --i) {
+#pragma HLS unroll
+      vec.set(i, op(vec[i - stride], vec[i]));
+    }
+  }
+  return vec;
+}
+
+// `Acc` if specified, or `T` otherwise.
+template <typename Acc, typename T>
+using accumulator_type =
+    typename std::conditional<std::is_void<Acc>::value, T, Acc>::type;
+
+}  // namespace internal
+
+// reduction operation functions, which are balanced trees of log2(N) levels
+#define DEFINE_FUNC(func, op)           \
+  template <typename T, int N>          \
+  T func(const vec_t<T, N>& vec) {      \
+    _Pragma("HLS inline");              \
+    return internal::reduce(vec, op()); \
+  }
+DEFINE_FUNC(sum, std::plus<T>)
+DEFINE_FUNC(product, std::multiplies<T>)
+DEFINE_FUNC(max, internal::max_op<T>)
+DEFINE_FUNC(min, internal::min_op<T>)
+DEFINE_FUNC(reduce_and, std::bit_and<T>)
+DEFINE_FUNC(reduce_or, std::bit_or<T>)
+DEFINE_FUNC(reduce_xor, std::bit_xor<T>)
 #undef DEFINE_FUNC
 
+// return the index of the first maximum element
+template <typename T, int N>
+inline int argmax(const vec_t<T, N>& vec) {
+#pragma HLS inline
+  T value;
+  return internal::vec_tree<0, N>::arg(vec, std::less<T>(), value);
+}
+
+// return the index of the first minimum element
+template <typename T, int N>
+inline int argmin(const vec_t<T, N>& vec) {
+#pragma HLS inline
+  T value;
+  return internal::vec_tree<0, N>::arg(vec, std::greater<T>(), value);
+}
+
+// prefix scan functions, which return inclusive scans in log2(N) levels
+#define DEFINE_FUNC(func, op)                \
+  template <typename T, int N>               \
+  vec_t<T, N> func(const vec_t<T, N>& vec) { \
+    _Pragma("HLS inline");                   \
+    return internal::scan(vec, op());        \
+  }
+DEFINE_FUNC(prefix_sum, std::plus<T>)
+DEFINE_FUNC(prefix_product, std::multiplies<T>)
+DEFINE_FUNC(prefix_max, internal::max_op<T>)
+DEFINE_FUNC(prefix_min, internal::min_op<T>)
+#undef DEFINE_FUNC
+
+/// Multiplies and accumulates element-wise, i.e., returns
+/// <tt>a[i] * b[i] + c[i]</tt> for each @c i.
+///
+/// The products are not rounded differently from <tt>a * b + c</tt>, so the
+/// results are the same, but no temporary vector is materialized and each
+/// element maps to a multiply-accumulate DSP in hardware.
+///
+/// @param a Vector of multiplicands.
+/// @param b Vector of multipliers.
+/// @param c Vector of addends.
+/// @return  Vector of <tt>a[i] * b[i] + c[i]</tt>.
+template <typename T, int N>
+inline vec_t<T, N> fma(const vec_t<T, N>& a, const vec_t<T, N>& b,
+                       const vec_t<T, N>& c) {
+#pragma HLS inline
+  vec_t<T, N> result;
+#ifndef __SYNTHESIS__
+  if constexpr (internal::vec_simd<T, N>::template supports<
+                    std::multiplies<>>()) {
+    internal::vec_simd<T, N>::multiply_add(&result[0], &a[0], &b[0], &c[0]);
+    return result;
+  }
+#endif  // __SYNTHESIS__
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i, a[i] * b[i] + c[i]);
+  }
+  return result;
+}
+
+/// Same as above, but with a scalar multiplier, i.e., returns
+/// <tt>a[i] * b + c[i]</tt> for each @c i.
+template <typename T, int N>
+inline vec_t<T, N> fma(const vec_t<T, N>& a,
+                       const typename vec_t<T, N>::value_type& b,
+                       const vec_t<T, N>& c) {
+#pragma HLS inline
+  vec_t<T, N> result;
+#ifndef __SYNTHESIS__
+  if constexpr (internal::vec_simd<T, N>::template supports<
+                    std::multiplies<>>()) {
+    internal::vec_simd<T, N>::multiply_add(
+        &result[0], &a[0],
+        static_cast<typename internal::vec_simd<T, N>::elem_type>(b), &c[0]);
+    return result;
+  }
+#endif  // __SYNTHESIS__
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i, a[i] * b + c[i]);
+  }
+  return result;
+}
+
+/// Computes the dot product of two vectors, accumulated in type @c Acc.
+///
+/// The products are accumulated one by one, i.e.,
+/// <tt>init + a[0] * b[0] + a[1] * b[1] + ...</tt>, which maps to a cascade of
+/// multiply-accumulate DSPs in hardware. @c Acc can be wider than @c T to
+/// avoid overflow, e.g., <tt>tapa::dot<int32_t>(a, b)</tt> for @c int8_t
+/// vectors.
+///
+/// @tparam Acc  Type of the products and the accumulator, @c T by default.
+/// @param  a    Vector of multiplicands.
+/// @param  b    Vector of multipliers.
+/// @param  init Initial value of the accumulator.
+/// @return      The accumulated value.
+template <typename Acc = void, typename T, int N>
+inline internal::accumulator_type<Acc, T> dot(
+    const vec_t<T, N>& a, const vec_t<T, N>& b,
+    const internal::accumulator_type<Acc, T>& init =
+        internal::accumulator_type<Acc, T>()) {
+#pragma HLS inline
+  using R = internal::accumulator_type<Acc, T>;
+#ifndef __SYNTHESIS__
+  // Integers wrap around, so the products can be computed and summed as
+  // vectors without changing the result.
+  if constexpr (std::is_same<R, T>::value && std::is_integral<T>::value &&
+                internal::vec_simd<T, N>::template supports<
+                    std::multiplies<>>()) {
+    vec_t<T, N> products;
+    internal::vec_simd<T, N>::template apply<std::multiplies<>>(
+        &products[0], &a[0], &b[0]);
+    return init + internal::vec_simd<T, N>::template reduce<std::plus<T>>(
+                      &products[0]);
+  }
+#endif  // __SYNTHESIS__
+  R result = init;
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result += R(a[i]) * R(b[i]);
+  }
+  return result;
+}
+
+namespace internal {
+
+template <typename T, int N, bool is_sub>
+inline vec_t<T, N> saturate(const vec_t<T, N>& lhs, const vec_t<T, N>& rhs) {
+#pragma HLS inline
+  static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                "saturating arithmetic requires an integer type");
+  vec_t<T, N> result;
+#ifndef __SYNTHESIS__
+  if constexpr (vec_simd<T, N>::saturates()) {
+    vec_simd<T, N>::template saturate<is_sub>(&result[0], &lhs[0], &rhs[0]);
+    return result;
+  }
+#endif  // __SYNTHESIS__
+  using U = typename std::make_unsigned<T>::type;
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i, T(saturate<std::is_signed<T>::value, is_sub,
+                             sizeof(T) * CHAR_BIT, U>(U(lhs[i]), U(rhs[i]))));
+  }
+  return result;
+}
+
+// Integer type twice as wide as `T` if `T` is a built-in integer of up to 32
+// bits, or the type of `T * T` otherwise, e.g., `ap_int<2 * W>` for
+// `ap_int<W>`.
+template <typename T, typename = void>
+struct widened {
+  using type = decltype(std::declval<T>() * std::declval<T>());
+};
+
+template <typename T>
+struct widened<T, typename std::enable_if<std::is_integral<T>::value &&
+                                          sizeof(T) <= 4>::type> {
+  using type = typename std::conditional<
+      std::is_signed<T>::value,
+      typename std::conditional<
+          sizeof(T) == 1, int16_t,
+          typename std::conditional<sizeof(T) == 2, int32_t,
+                                    int64_t>::type>::type,
+      typename std::conditional<
+          sizeof(T) == 1, uint16_t,
+          typename std::conditional<sizeof(T) == 2, uint32_t,
+                                    uint64_t>::type>::type>::type;
+};
+
+// `Wide` if specified, or `widened<T>` otherwise.
+template <typename Wide, typename T>
+using wide_type = typename std::conditional<std::is_void<Wide>::value,
+                                            typename widened<T>::type,
+                                            Wide>::type;
+
+}  // namespace internal
+
+/// Adds element-wise with saturation, i.e., results out of the range of @c T
+/// are clamped to its minimum or maximum instead of wrapping around.
+///
+/// @param lhs Vector of integers.
+/// @param rhs Vector of integers.
+/// @return    Vector of saturated <tt>lhs[i] + rhs[i]</tt>.
+template <typename T, int N>
+inline vec_t<T, N> adds(const vec_t<T, N>& lhs, const vec_t<T, N>& rhs) {
+#pragma HLS inline
+  return internal::saturate<T, N, false>(lhs, rhs);
+}
+
+/// Subtracts element-wise with saturation, i.e., results out of the range of
+/// @c T are clamped to its minimum or maximum instead of wrapping around.
+///
+/// @param lhs Vector of integers.
+/// @param rhs Vector of integers.
+/// @return    Vector of saturated <tt>lhs[i] - rhs[i]</tt>.
+template <typename T, int N>
+inline vec_t<T, N> subs(const vec_t<T, N>& lhs, const vec_t<T, N>& rhs) {
+#pragma HLS inline
+  return internal::saturate<T, N, true>(lhs, rhs);
+}
+
+/// Multiplies element-wise into a wider type, so that the products never
+/// overflow, e.g., <tt>tapa::mul_wide<int32_t>(a, b)</tt> for @c int8_t
+/// vectors @c a and @c b.
+///
+/// @tparam Wide Type of the products, which is twice as wide as @c T by
+///              default.
+/// @param  lhs  Vector of multiplicands.
+/// @param  rhs  Vector of multipliers.
+/// @return      Vector of <tt>Wide(lhs[i]) * Wide(rhs[i])</tt>.
+template <typename Wide = void, typename T, int N>
+inline vec_t<internal::wide_type<Wide, T>, N> mul_wide(const vec_t<T, N>& lhs,
+                                                       const vec_t<T, N>& rhs) {
+#pragma HLS inline
+  using W = internal::wide_type<Wide, T>;
+  vec_t<W, N> result;
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i, W(W(lhs[i]) * W(rhs[i])));
+  }
+  return result;
+}
+
+/// Packs the elements of a vector densely into a word.
+///
+/// Element @c i occupies bits <tt>[i * W, (i + 1) * W)</tt> of the word, where
+/// @c W is <tt>tapa::widthof<T>()</tt>, e.g., a
+/// <tt>tapa::vec_t<ap_uint<4>, 128></tt> is packed into an
+/// <tt>ap_uint<512></tt>. This is pure wiring in hardware. Floating-point
+/// elements should be converted via @c tapa::bit_cast first.
+///
+/// @tparam Word Type of the word, which must be at least <tt>W * N</tt> bits
+///              wide and support @c range(hi, lo) like @c ap_uint.
+/// @param vec   Vector to pack.
+/// @return      Packed word, whose bits above <tt>W * N</tt> are zero.
+template <typename Word, typename T, int N>
+inline Word pack(const vec_t<T, N>& vec) {
+  static_assert(!std::is_floating_point<T>::value,
+                "floating-point elements must be bit_cast first");
+  constexpr int width = widthof<T>();
+  static_assert(widthof<Word>() >= width * N, "word is too narrow");
+  Word word = 0;
+#pragma HLS inline
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    word.range((i + 1) * width - 1, i * width) = vec[i];
+  }
+  return word;
+}
+
+/// Unpacks a vector from a word packed by @c tapa::pack.
+///
+/// @tparam T    Element type of the vector.
+/// @tparam N    Vector length.
+/// @param word  Packed word, which must be at least <tt>W * N</tt> bits wide
+///              and support @c range(hi, lo) like @c ap_uint.
+/// @return      Vector whose element @c i is from bits
+///              <tt>[i * W, (i + 1) * W)</tt> of @c word.
+template <typename T, int N, typename Word>
+inline vec_t<T, N> unpack(const Word& word) {
+  static_assert(!std::is_floating_point<T>::value,
+                "floating-point elements must be bit_cast after unpacking");
+  constexpr int width = widthof<T>();
+  static_assert(widthof<Word>() >= width * N, "word is too narrow");
+  vec_t<T, N> vec;
+#pragma HLS inline
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    vec.set(i, T(word.range((i + 1) * width - 1, i * width)));
+  }
+  return vec;
+}
+
+/// Sorts a vector in place with a bitonic sorting network.
+///
+/// The network has <tt>log2(N) * (log2(N) + 1) / 2</tt> stages of
+/// <tt>N / 2</tt> compare-and-swaps each, all generated at compile time, so it
+/// is pure logic in hardware and can sort a vector per cycle in a pipelined
+/// loop. Unlike @c std::sort, equal elements may be reordered. In simulation,
+/// vectors of built-in types that fit in a SIMD register are sorted with SIMD
+/// instructions if @c comp is @c std::less or @c std::greater.
+///
+/// @tparam N    Vector length, which must be a power of 2.
+/// @param vec   Vector to sort.
+/// @param comp  Strict weak ordering, e.g., <tt>std::greater<T>()</tt> to sort
+///              in descending order.
+template <typename T, int N, typename Compare = std::less<T>>
+inline void sort(vec_t<T, N>& vec, const Compare& comp = Compare()) {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+#pragma HLS inline
+#ifndef __SYNTHESIS__
+  if constexpr (internal::vec_simd<T, N>::template sorts<Compare>()) {
+    internal::vec_simd<T, N>::template sort<
+        std::is_same<Compare, std::greater<T>>::value>(&vec[0]);
+    return;
+  }
+#endif  // __SYNTHESIS__
+  // Stage (k, j) sorts pairs `j` apart, ascending if bit `k` of the lower
+  // index is 0, so that runs of `k` elements are sorted after stage (k, 1).
+  for (int k = 2; k <= N; k *= 2) {
+#pragma HLS unroll
+    for (int j = k / 2; j > 0; j /= 2) {
+#pragma HLS unroll
+      for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+        const int l = i ^ j;
+        if (l > i) {
+          const T lhs = vec[i];
+          const T rhs = vec[l];
+          if ((i & k) == 0 ? comp(rhs, lhs) : comp(lhs, rhs)) {
+            vec.set(i, rhs);
+            vec.set(l, lhs);
+          }
+        }
+      }
+    }
+  }
+}
+
 template <typename T, int N>
 inline std::ostream& operator<<(std::ostream& os, const vec_t<T, N>& obj) {
   os << "{";
@@ -387,4 +1283,7 @@ inline std::ostream& operator<<(std::ostream& os, const vec_t<T, N>& obj) {
 
 }  // namespace tapa
 
+#undef TAPA_VEC_CONSTEXPR_DISABLED
+#undef TAPA_VEC_CONSTEXPR
+
 #endif  // TAPA_VEC_H_
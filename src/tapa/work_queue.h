@@ -0,0 +1,118 @@
+#ifndef TAPA_WORK_QUEUE_H_
+#define TAPA_WORK_QUEUE_H_
+
+#include <cstdint>
+
+#include "tapa/stream.h"
+
+namespace tapa {
+
+/// Dispatches the work items of @c items to @c P processing elements (PEs) on
+/// demand, so that PEs that finish early take more items and the time to
+/// finish follows the total work rather than the largest static partition,
+/// e.g., for power-law graphs or sparse rows of irregular lengths.
+///
+/// Dispatching is credit-based: each PE starts with @c Credits credits, spends
+/// one for each item written to its stream of @c work, and earns one back for
+/// each token it writes to its stream of @c done, i.e., after it finishes an
+/// item. Among the PEs with credits, items go to the next one after the PE
+/// that got the last item. With streams of @c work at least @c Credits deep,
+/// writing an item never blocks, and @c Credits of 2 or more hides the round
+/// trip of the handshake. Once @c items reaches EoT, which is consumed, EoT is
+/// written to each stream of @c work; returns once every stream of @c done
+/// reaches EoT, which is consumed.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  void Dispatch(tapa::istream<Row>& rows, tapa::ostreams<Row, 8>& work,
+///                tapa::istreams<bool, 8>& done) {
+///    tapa::dispatch_work(rows, work, done);
+///  }
+///  void Pe(tapa::istream<Row>& work, tapa::ostream<bool>& done, ...) {
+///    TAPA_WHILE_NOT_EOT(work) {
+///      Process(work.read(nullptr), ...);
+///      done.write(true);
+///    }
+///    work.open();
+///    done.close();
+///  }
+/// @endcode
+///
+/// @tparam Credits Number of items dispatched to each PE ahead of its
+///                 requests; between 1 and 255.
+template <int Credits = 2, typename T, uint64_t P>
+void dispatch_work(istream<T>& items, ostreams<T, P>& work,
+                   istreams<bool, P>& done) {
+  static_assert(Credits >= 1 && Credits <= 255,
+                "Credits must be between 1 and 255");
+
+  uint8_t credits[P];
+  bool is_closed[P];
+#pragma HLS array_partition variable = credits complete
+#pragma HLS array_partition variable = is_closed complete
+  for (uint64_t p = 0; p < P; ++p) {
+#pragma HLS unroll
+    credits[p] = Credits;
+    is_closed[p] = false;
+  }
+  uint64_t next = 0;  // PE that has priority for the next item
+  uint64_t num_closed = 0;
+  bool is_dispatched = false;
+
+  while (num_closed < P) {
+#pragma HLS pipeline II = 1
+    // Choose the first PE with credits in round-robin order.
+    uint64_t pe = P;
+    for (uint64_t i = 0; i < P; ++i) {
+#pragma HLS unroll
+      const uint64_t p = next + i < P ? next + i : next + i - P;
+      if (pe == P && credits[p] > 0) pe = p;
+    }
+
+    // Items are only polled when a PE can take one, and dispatching stops at
+    // EoT.
+    bool is_eot;
+    if (!is_dispatched && pe < P && items.try_eot(is_eot)) {
+      if (is_eot) {
+        items.open();
+        for (uint64_t p = 0; p < P; ++p) {
+#pragma HLS unroll
+          work[p].close();
+        }
+        is_dispatched = true;
+      } else {
+        const T item = items.read(nullptr);
+        for (uint64_t p = 0; p < P; ++p) {
+#pragma HLS unroll
+          if (p == pe) {
+            work[p].write(item);
+            --credits[p];
+          }
+        }
+        next = pe + 1 == P ? 0 : pe + 1;
+      }
+    }
+
+    // Each PE returns one credit per finished item, and EoT once it is done.
+    // Each stream is polled at most once per iteration, or a task polling an
+    // empty stream twice in a row sleeps on that stream only in simulation.
+    for (uint64_t p = 0; p < P; ++p) {
+#pragma HLS unroll
+      bool is_done;
+      if (!is_closed[p] && done[p].try_eot(is_done)) {
+        if (is_done) {
+          done[p].open();
+          is_closed[p] = true;
+          ++num_closed;
+        } else {
+          done[p].read(nullptr);
+          ++credits[p];
+        }
+      }
+    }
+  }
+}
+
+}  // namespace tapa
+
+#endif  // TAPA_WORK_QUEUE_H_